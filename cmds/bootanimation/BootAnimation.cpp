@@ -17,6 +17,10 @@
 #define LOG_NDEBUG 0
 #define LOG_TAG "BootAnimation"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <vector>
 
 #include <stdint.h>
@@ -111,6 +115,29 @@ static const char DISPLAYS_PROP_NAME[] = "persist.service.bootanim.displays";
 static const int ANIM_ENTRY_NAME_MAX = ANIM_PATH_MAX + 1;
 static constexpr size_t TEXT_POS_LEN_MAX = 16;
 
+// Frames may be stored as KTX 1.1 containers of textures that are already compressed.
+static constexpr uint8_t KTX_IDENTIFIER[] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+static constexpr uint32_t KTX_ENDIANNESS = 0x04030201;
+
+struct KtxHeader {
+    uint8_t identifier[sizeof(KTX_IDENTIFIER)];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
 // ---------------------------------------------------------------------------
 
 BootAnimation::BootAnimation(sp<Callbacks> callbacks)
@@ -181,6 +208,9 @@ status_t BootAnimation::initTexture(Texture* texture, AssetManager& assets,
     const int w = bitmap.width();
     const int h = bitmap.height();
     const void* p = bitmap.getPixels();
+    if (w <= 0 || h <= 0) {
+        return NO_INIT;
+    }
 
     GLint crop[4] = { 0, h, w, -h };
     texture->w = w;
@@ -219,18 +249,29 @@ status_t BootAnimation::initTexture(Texture* texture, AssetManager& assets,
     return NO_ERROR;
 }
 
-status_t BootAnimation::initTexture(FileMap* map, int* width, int* height) {
-    SkBitmap bitmap;
+static void decodeFrame(FileMap* map, SkBitmap* bitmap) {
     sk_sp<SkData> data = SkData::MakeWithoutCopy(map->getDataPtr(),
             map->getDataLength());
     sk_sp<SkImage> image = SkImage::MakeFromEncoded(data);
-    image->asLegacyBitmap(&bitmap, SkImage::kRO_LegacyBitmapMode);
+    if (image != nullptr) {
+        image->asLegacyBitmap(bitmap, SkImage::kRO_LegacyBitmapMode);
+    } else {
+        SLOGE("Failed to decode frame image");
+    }
 
     // FileMap memory is never released until application exit.
-    // Release it now as the texture is already loaded and the memory used for
+    // Release it now as the image is already decoded and the memory used for
     // the packed resource can be released.
     delete map;
+}
+
+status_t BootAnimation::initTexture(FileMap* map, int* width, int* height) {
+    SkBitmap bitmap;
+    decodeFrame(map, &bitmap);
+    return initTexture(bitmap, width, height);
+}
 
+status_t BootAnimation::initTexture(const SkBitmap& bitmap, int* width, int* height) {
     const int w = bitmap.width();
     const int h = bitmap.height();
     const void* p = bitmap.getPixels();
@@ -277,6 +318,131 @@ status_t BootAnimation::initTexture(FileMap* map, int* width, int* height) {
     return NO_ERROR;
 }
 
+// Decoding a frame of a high resolution animation can take longer than a frame period, so the
+// frames of a part are decoded on a background thread while the previous ones are displayed.
+// Only a few decoded frames are kept ahead of playback so memory use does not grow with the
+// size of the part; the upload to a texture stays on the render thread, which owns the context.
+class BootAnimation::FrameDecodeThread : public Thread {
+public:
+    // The number of decoded frames that may be waiting for playback.
+    static constexpr size_t MAX_DECODED_FRAMES = 2;
+
+    explicit FrameDecodeThread(const Animation::Part& part) : Thread(false), mPart(part) {}
+
+    // Waits for the next frame of the part that is not compressed to be decoded and moves it
+    // to bitmap.
+    // Returns false if the decoder has been stopped or all frames were already taken.
+    bool takeFrame(SkBitmap* bitmap) {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCondition.wait(lock, [this] { return !mFrames.empty() || mDone; });
+        if (mFrames.empty()) {
+            return false;
+        }
+        *bitmap = std::move(mFrames.front());
+        mFrames.pop_front();
+        mCondition.notify_all();
+        return true;
+    }
+
+    // Stops decoding and waits for the thread to exit.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mDone = true;
+        }
+        mCondition.notify_all();
+        requestExitAndWait();
+    }
+
+private:
+    bool threadLoop() override {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mCondition.wait(lock, [this] {
+                return mFrames.size() < MAX_DECODED_FRAMES || mDone;
+            });
+            // Compressed frames are uploaded as they are stored, without decoding.
+            while (mNextFrame < mPart.frames.size() && mPart.frames[mNextFrame].compressed) {
+                mNextFrame++;
+            }
+            if (mDone || exitPending() || mNextFrame >= mPart.frames.size()) {
+                mDone = true;
+                mCondition.notify_all();
+                return false;
+            }
+        }
+
+        SkBitmap bitmap;
+        decodeFrame(mPart.frames[mNextFrame++].map, &bitmap);
+
+        std::lock_guard<std::mutex> lock(mLock);
+        mFrames.push_back(std::move(bitmap));
+        mCondition.notify_all();
+        return true;
+    }
+
+    const Animation::Part& mPart;
+    // Only accessed by the decode thread.
+    size_t mNextFrame = 0;
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::deque<SkBitmap> mFrames;
+    bool mDone = false;
+};
+
+static bool isKtxFile(const FileMap* map) {
+    return map->getDataLength() >= sizeof(KtxHeader) &&
+            memcmp(map->getDataPtr(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) == 0;
+}
+
+bool BootAnimation::isCompressedTextureFormatSupported(GLenum format) const {
+    return std::find(mCompressedTextureFormats.begin(), mCompressedTextureFormats.end(),
+            static_cast<GLint>(format)) != mCompressedTextureFormats.end();
+}
+
+// Uploads the first mipmap level of a KTX container as is, without decoding it.
+status_t BootAnimation::initCompressedTexture(FileMap* map, int* width, int* height) {
+    const uint8_t* data = static_cast<const uint8_t*>(map->getDataPtr());
+    const size_t length = map->getDataLength();
+    status_t status = BAD_VALUE;
+
+    KtxHeader header;
+    memcpy(&header, data, sizeof(header));
+    // In 64 bits, so a huge bytesOfKeyValueData can't wrap around on 32-bit devices.
+    const uint64_t imageSizeOffset = uint64_t(sizeof(header)) + header.bytesOfKeyValueData;
+    uint32_t imageSize = 0;
+    if (header.endianness != KTX_ENDIANNESS || header.glType != 0 || header.pixelDepth > 1 ||
+            header.pixelWidth == 0 || header.pixelHeight == 0 ||
+            imageSizeOffset + sizeof(imageSize) > length) {
+        SLOGE("Invalid compressed frame");
+    } else if (!isCompressedTextureFormatSupported(header.glInternalFormat)) {
+        SLOGE("Compressed texture format 0x%x is not supported", header.glInternalFormat);
+    } else {
+        memcpy(&imageSize, data + imageSizeOffset, sizeof(imageSize));
+        const int w = header.pixelWidth;
+        const int h = header.pixelHeight;
+        const bool pot = (w & (w - 1)) == 0 && (h & (h - 1)) == 0;
+        if (imageSize > length - imageSizeOffset - sizeof(imageSize)) {
+            SLOGE("Truncated compressed frame");
+        } else if (!mUseNpotTextures && !pot) {
+            // Unlike decoded images, compressed ones can't be padded to a power of two size.
+            SLOGE("Compressed frame of %dx%d needs npot texture support", w, h);
+        } else {
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, header.glInternalFormat, w, h, 0,
+                    imageSize, data + imageSizeOffset + sizeof(imageSize));
+            GLint crop[4] = { 0, h, w, -h };
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
+            *width = w;
+            *height = h;
+            status = NO_ERROR;
+        }
+    }
+
+    // As for decoded frames, the packed resource isn't needed once uploaded.
+    delete map;
+    return status;
+}
+
 class BootAnimation::DisplayEventCallback : public LooperCallback {
     BootAnimation* mBootAnimation;
 
@@ -1024,6 +1190,7 @@ bool BootAnimation::preloadZip(Animation& animation) {
                                     frame.trimHeight = animation.height;
                                     frame.trimX = 0;
                                     frame.trimY = 0;
+                                    frame.compressed = isKtxFile(map);
                                     part.frames.add(frame);
                                 }
                             }
@@ -1109,6 +1276,14 @@ bool BootAnimation::movie() {
         }
     }
 
+    // Query the formats compressed frames may be uploaded in
+    GLint numCompressedFormats = 0;
+    glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &numCompressedFormats);
+    mCompressedTextureFormats.resize(std::max(numCompressedFormats, 0));
+    if (!mCompressedTextureFormats.empty()) {
+        glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, mCompressedTextureFormats.data());
+    }
+
     // Blend required to draw time on top of animation frames.
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glShadeModel(GL_FLAT);
@@ -1158,13 +1333,43 @@ bool BootAnimation::shouldStopPlayingPart(const Animation::Part& part, const int
     return exitPending() && !part.playUntilComplete && fadedFramesCount >= part.framesToFadeCount;
 }
 
+// Where the time to show the frames of a part went, to tell stutter caused by decoding from
+// stutter caused by uploading or presenting the frames.
+struct FrameTimings {
+    size_t frames = 0;
+    // Frames that were late enough to miss at least one frame period.
+    size_t droppedFrames = 0;
+    nsecs_t maxGap = 0;
+    // Time spent waiting for the decode thread.
+    nsecs_t decodeWait = 0;
+    nsecs_t upload = 0;
+    nsecs_t present = 0;
+
+    void add(const FrameTimings& other) {
+        frames += other.frames;
+        droppedFrames += other.droppedFrames;
+        maxGap = std::max(maxGap, other.maxGap);
+        decodeWait += other.decodeWait;
+        upload += other.upload;
+        present += other.present;
+    }
+};
+
+static void logFrameTimings(const char* prefix, const char* what, const FrameTimings& timings) {
+    SLOGD("%sAnimationFrameTiming %s: frames=%zu dropped=%zu maxGap=%" PRId64 "ms"
+            " decodeWait=%" PRId64 "ms upload=%" PRId64 "ms present=%" PRId64 "ms",
+            prefix, what, timings.frames, timings.droppedFrames, ns2ms(timings.maxGap),
+            ns2ms(timings.decodeWait), ns2ms(timings.upload), ns2ms(timings.present));
+}
+
 bool BootAnimation::playAnimation(const Animation& animation) {
     const size_t pcount = animation.parts.size();
     nsecs_t frameDuration = s2ns(1) / animation.fps;
 
-    SLOGD("%sAnimationShownTiming start time: %" PRId64 "ms", mShuttingDown ? "Shutdown" : "Boot",
-            elapsedRealtime());
+    const char* timingPrefix = mShuttingDown ? "Shutdown" : "Boot";
+    SLOGD("%sAnimationShownTiming start time: %" PRId64 "ms", timingPrefix, elapsedRealtime());
 
+    FrameTimings totalTimings;
     int fadedFramesCount = 0;
     for (size_t i=0 ; i<pcount ; i++) {
         const Animation::Part& part(animation.parts[i]);
@@ -1179,6 +1384,21 @@ bool BootAnimation::playAnimation(const Animation& animation) {
             continue; //to next part
         }
 
+        // The frames are decoded ahead of the first play of the part. Looping parts keep their
+        // textures for the following plays.
+        sp<FrameDecodeThread> decoder;
+        if (fcount > 0) {
+            decoder = new FrameDecodeThread(part);
+            status_t err = decoder->run("BootAnimation::FrameDecodeThread", PRIORITY_DISPLAY);
+            if (err != NO_ERROR) {
+                // The frames are then decoded on this thread as they are uploaded.
+                SLOGE("Failed to start the frame decoder: %s", strerror(-err));
+                decoder.clear();
+            }
+        }
+        FrameTimings timings;
+        nsecs_t lastPresent = 0;
+
         // process the part not only while the count allows but also if already fading
         for (int r=0 ; !part.count || r<part.count || fadedFramesCount > 0 ; r++) {
             if (shouldStopPlayingPart(part, fadedFramesCount)) break;
@@ -1211,8 +1431,20 @@ bool BootAnimation::playAnimation(const Animation& animation) {
                         glTexParameterx(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
                         glTexParameterx(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                     }
+                    SkBitmap bitmap;
                     int w, h;
-                    initTexture(frame.map, &w, &h);
+                    nsecs_t uploadStart = systemTime();
+                    if (frame.compressed) {
+                        initCompressedTexture(frame.map, &w, &h);
+                    } else if (decoder == nullptr) {
+                        initTexture(frame.map, &w, &h);
+                    } else if (decoder->takeFrame(&bitmap)) {
+                        const nsecs_t decoded = systemTime();
+                        timings.decodeWait += decoded - uploadStart;
+                        uploadStart = decoded;
+                        initTexture(bitmap, &w, &h);
+                    }
+                    timings.upload += systemTime() - uploadStart;
                 }
 
                 const int xc = animationX + frame.trimX;
@@ -1250,9 +1482,25 @@ bool BootAnimation::playAnimation(const Animation& animation) {
 
                 handleViewport(frameDuration);
 
+                const nsecs_t presentStart = systemTime();
                 eglSwapBuffers(mDisplay, mSurface);
 
                 nsecs_t now = systemTime();
+                timings.frames++;
+                timings.present += now - presentStart;
+                if (lastPresent != 0) {
+                    const nsecs_t gap = now - lastPresent;
+                    timings.maxGap = std::max(timings.maxGap, gap);
+                    if (gap > frameDuration * 3 / 2) {
+                        timings.droppedFrames += (gap + frameDuration / 2) / frameDuration - 1;
+                    }
+                }
+                lastPresent = now;
+                if (!mFirstFramePresented) {
+                    mFirstFramePresented = true;
+                    SLOGD("%sAnimationFirstFrameTiming start time: %" PRId64 "ms", timingPrefix,
+                            elapsedRealtime());
+                }
                 nsecs_t delay = frameDuration - (now - lastFrame);
                 //SLOGD("%lld, %lld", ns2ms(now - lastFrame), ns2ms(delay));
                 lastFrame = now;
@@ -1271,14 +1519,27 @@ bool BootAnimation::playAnimation(const Animation& animation) {
             }
 
             usleep(part.pause * ns2us(frameDuration));
+            // The pause between plays is not a gap in the animation.
+            lastPresent = 0;
 
             if (exitPending() && !part.count && mCurrentInset >= mTargetInset &&
                 !part.hasFadingPhase()) {
                 break; // exit the infinite non-fading part when it has been played at least once
             }
         }
+
+        if (decoder != nullptr) {
+            decoder->stop();
+        }
+
+        if (timings.frames > 0) {
+            logFrameTimings(timingPrefix, part.path.string(), timings);
+            totalTimings.add(timings);
+        }
     }
 
+    logFrameTimings(timingPrefix, "total", totalTimings);
+
     // Free textures created for looping parts now that the animation is done.
     for (const Animation::Part& part : animation.parts) {
         if (part.count != 1) {
@@ -70,6 +70,8 @@ public:
             int trimWidth;
             int trimHeight;
             mutable GLuint tid;
+            // Whether the frame is a KTX container of a compressed texture rather than an image.
+            bool compressed;
             bool operator < (const Frame& rhs) const {
                 return name < rhs.name;
             }
@@ -156,6 +158,9 @@ private:
         BootAnimation* mBootAnimation;
     };
 
+    // Decodes the frames of a part on a background thread, a few frames ahead of playback.
+    class FrameDecodeThread;
+
     // Display event handling
     class DisplayEventCallback;
     int displayEventCallback(int fd, int events, void* data);
@@ -163,6 +168,9 @@ private:
 
     status_t initTexture(Texture* texture, AssetManager& asset, const char* name);
     status_t initTexture(FileMap* map, int* width, int* height);
+    status_t initTexture(const SkBitmap& bitmap, int* width, int* height);
+    status_t initCompressedTexture(FileMap* map, int* width, int* height);
+    bool isCompressedTextureFormatSupported(GLenum format) const;
     status_t initFont(Font* font, const char* fallback);
     bool android();
     bool movie();
@@ -199,6 +207,8 @@ private:
     int         mCurrentInset;
     int         mTargetInset;
     bool        mUseNpotTextures = false;
+    bool        mFirstFramePresented = false;
+    std::vector<GLint> mCompressedTextureFormats;
     EGLDisplay  mDisplay;
     EGLDisplay  mContext;
     EGLDisplay  mSurface;
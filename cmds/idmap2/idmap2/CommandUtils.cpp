@@ -22,11 +22,14 @@
 #include "idmap2/Idmap.h"
 #include "idmap2/Result.h"
 #include "idmap2/SysTrace.h"
+#include "idmap2/ZipFile.h"
 
 using android::idmap2::Error;
+using android::idmap2::GetPackageCrc;
 using android::idmap2::IdmapHeader;
 using android::idmap2::Result;
 using android::idmap2::Unit;
+using android::idmap2::ZipFile;
 
 Result<Unit> Verify(const std::string& idmap_path, const std::string& target_path,
                     const std::string& overlay_path, PolicyBitmask fulfilled_policies,
@@ -47,3 +50,33 @@ Result<Unit> Verify(const std::string& idmap_path, const std::string& target_pat
 
   return Unit{};
 }
+
+Result<Unit> Verify(const std::string& idmap_path, const std::string& target_path,
+                    uint32_t target_crc, const std::string& overlay_path,
+                    PolicyBitmask fulfilled_policies, bool enforce_overlayable) {
+  SYSTRACE << "Verify " << idmap_path;
+  std::ifstream fin(idmap_path);
+  const std::unique_ptr<const IdmapHeader> header = IdmapHeader::FromBinaryStream(fin);
+  fin.close();
+  if (!header) {
+    return Error("failed to parse idmap header");
+  }
+
+  const std::unique_ptr<const ZipFile> overlay_zip = ZipFile::Open(overlay_path);
+  if (!overlay_zip) {
+    return Error("failed to open overlay %s", overlay_path.c_str());
+  }
+
+  const Result<uint32_t> overlay_crc = GetPackageCrc(*overlay_zip);
+  if (!overlay_crc) {
+    return Error(overlay_crc.GetError(), "failed to get overlay crc");
+  }
+
+  const auto header_ok = header->IsUpToDate(target_path.c_str(), overlay_path.c_str(), target_crc,
+                                            *overlay_crc, fulfilled_policies, enforce_overlayable);
+  if (!header_ok) {
+    return Error(header_ok.GetError(), "idmap not up to date");
+  }
+
+  return Unit{};
+}
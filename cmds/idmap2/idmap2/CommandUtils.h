@@ -26,4 +26,12 @@ android::idmap2::Result<android::idmap2::Unit> Verify(const std::string& idmap_p
                                                       PolicyBitmask fulfilled_policies,
                                                       bool enforce_overlayable);
 
+// Same as above, with the GetPackageCrc() of the target already computed.
+android::idmap2::Result<android::idmap2::Unit> Verify(const std::string& idmap_path,
+                                                      const std::string& target_path,
+                                                      uint32_t target_crc,
+                                                      const std::string& overlay_path,
+                                                      PolicyBitmask fulfilled_policies,
+                                                      bool enforce_overlayable);
+
 #endif  // IDMAP2_IDMAP2_COMMAND_UTILS_H_
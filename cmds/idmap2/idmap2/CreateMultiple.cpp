@@ -17,9 +17,12 @@
 #include <sys/stat.h>   // umask
 #include <sys/types.h>  // umask
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <memory>
 #include <ostream>
+#include <thread>
 #include <vector>
 
 #include "Commands.h"
@@ -32,15 +35,18 @@
 #include "idmap2/Policies.h"
 #include "idmap2/PolicyUtils.h"
 #include "idmap2/SysTrace.h"
+#include "idmap2/ZipFile.h"
 
 using android::ApkAssets;
 using android::base::StringPrintf;
 using android::idmap2::BinaryStreamVisitor;
 using android::idmap2::CommandLineOptions;
 using android::idmap2::Error;
+using android::idmap2::GetPackageCrc;
 using android::idmap2::Idmap;
 using android::idmap2::Result;
 using android::idmap2::Unit;
+using android::idmap2::ZipFile;
 using android::idmap2::utils::kIdmapCacheDir;
 using android::idmap2::utils::kIdmapFilePermissionMask;
 using android::idmap2::utils::PoliciesToBitmaskResult;
@@ -95,51 +101,90 @@ Result<Unit> CreateMultiple(const std::vector<std::string>& args) {
     return Error("failed to load apk %s", target_apk_path.c_str());
   }
 
-  std::vector<std::string> idmap_paths;
-  for (const std::string& overlay_apk_path : overlay_apk_paths) {
-    const std::string idmap_path = Idmap::CanonicalIdmapPathFor(idmap_dir, overlay_apk_path);
-    const uid_t uid = getuid();
+  const std::unique_ptr<const ZipFile> target_zip = ZipFile::Open(target_apk_path);
+  if (!target_zip) {
+    return Error("failed to open target %s", target_apk_path.c_str());
+  }
+
+  // The target is the same for every overlay, so only read its CRC once.
+  const Result<uint32_t> target_crc = GetPackageCrc(*target_zip);
+  if (!target_crc) {
+    return Error(target_crc.GetError(), "failed to get target crc");
+  }
+
+  umask(kIdmapFilePermissionMask);
+
+  // Creates the idmap of one overlay, unless its existing idmap is up to date. Returns whether the
+  // idmap path should be reported.
+  const uid_t uid = getuid();
+  auto create_idmap = [&](const std::string& overlay_apk_path,
+                          const std::string& idmap_path) -> bool {
     if (!UidHasWriteAccessToPath(uid, idmap_path)) {
       LOG(WARNING) << "uid " << uid << "does not have write access to " << idmap_path.c_str();
-      continue;
+      return false;
+    }
+
+    if (Verify(idmap_path, target_apk_path, *target_crc, overlay_apk_path, fulfilled_policies,
+               !ignore_overlayable)) {
+      return true;
+    }
+
+    const std::unique_ptr<const ApkAssets> overlay_apk = ApkAssets::Load(overlay_apk_path);
+    if (!overlay_apk) {
+      LOG(WARNING) << "failed to load apk " << overlay_apk_path.c_str();
+      return false;
+    }
+
+    const auto idmap = Idmap::FromApkAssets(*target_apk, *target_crc, *overlay_apk,
+                                            fulfilled_policies, !ignore_overlayable);
+    if (!idmap) {
+      LOG(WARNING) << "failed to create idmap";
+      return false;
+    }
+
+    std::ofstream fout(idmap_path);
+    if (fout.fail()) {
+      LOG(WARNING) << "failed to open idmap path " << idmap_path.c_str();
+      return false;
     }
 
-    if (!Verify(idmap_path, target_apk_path, overlay_apk_path, fulfilled_policies,
-                !ignore_overlayable)) {
-      const std::unique_ptr<const ApkAssets> overlay_apk = ApkAssets::Load(overlay_apk_path);
-      if (!overlay_apk) {
-        LOG(WARNING) << "failed to load apk " << overlay_apk_path.c_str();
-        continue;
-      }
-
-      const auto idmap =
-          Idmap::FromApkAssets(*target_apk, *overlay_apk, fulfilled_policies, !ignore_overlayable);
-      if (!idmap) {
-        LOG(WARNING) << "failed to create idmap";
-        continue;
-      }
-
-      umask(kIdmapFilePermissionMask);
-      std::ofstream fout(idmap_path);
-      if (fout.fail()) {
-        LOG(WARNING) << "failed to open idmap path " << idmap_path.c_str();
-        continue;
-      }
-
-      BinaryStreamVisitor visitor(fout);
-      (*idmap)->accept(&visitor);
-      fout.close();
-      if (fout.fail()) {
-        LOG(WARNING) << "failed to write to idmap path %s" << idmap_path.c_str();
-        continue;
-      }
+    BinaryStreamVisitor visitor(fout);
+    (*idmap)->accept(&visitor);
+    fout.close();
+    if (fout.fail()) {
+      LOG(WARNING) << "failed to write to idmap path %s" << idmap_path.c_str();
+      return false;
+    }
+    return true;
+  };
+
+  // The overlays only share the target, which is only read, so their idmaps are created
+  // concurrently. The idmap paths are still reported in the order of the overlays.
+  std::vector<std::string> idmap_paths(overlay_apk_paths.size());
+  std::unique_ptr<bool[]> created(new bool[overlay_apk_paths.size()]());
+  std::atomic<size_t> next_overlay(0);
+  auto worker = [&]() {
+    for (size_t i = next_overlay++; i < overlay_apk_paths.size(); i = next_overlay++) {
+      idmap_paths[i] = Idmap::CanonicalIdmapPathFor(idmap_dir, overlay_apk_paths[i]);
+      created[i] = create_idmap(overlay_apk_paths[i], idmap_paths[i]);
     }
+  };
 
-    idmap_paths.emplace_back(idmap_path);
+  const size_t thread_count =
+      std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), overlay_apk_paths.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
   }
 
-  for (const std::string& idmap_path : idmap_paths) {
-    std::cout << idmap_path << std::endl;
+  for (size_t i = 0; i < idmap_paths.size(); i++) {
+    if (created[i]) {
+      std::cout << idmap_paths[i] << std::endl;
+    }
   }
 
   return Unit{};
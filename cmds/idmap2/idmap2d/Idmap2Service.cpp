@@ -55,6 +55,10 @@ using PolicyBitmask = android::ResTable_overlayable_policy_header::PolicyBitmask
 namespace {
 
 constexpr const char* kFrameworkPath = "/system/framework/framework-res.apk";
+constexpr size_t kMaxCachedTargets = 4;
+// Updated APKs are installed under new paths, so the crcs of the old paths are never looked up
+// again. This bounds how many of them the cache can hold.
+constexpr size_t kMaxCachedCrcs = 256;
 
 Status ok() {
   return Status::ok();
@@ -69,7 +73,17 @@ PolicyBitmask ConvertAidlArgToPolicyBitmask(int32_t arg) {
   return static_cast<PolicyBitmask>(arg);
 }
 
-Status GetCrc(const std::string& apk_path, uint32_t* out_crc) {
+bool GetFileStamp(const std::string& path, int64_t* out_mtime_ns, off_t* out_size) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+  *out_mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  *out_size = st.st_size;
+  return true;
+}
+
+Status ComputeCrc(const std::string& apk_path, uint32_t* out_crc) {
   const auto zip = ZipFile::Open(apk_path);
   if (!zip) {
     return error(StringPrintf("failed to open apk %s", apk_path.c_str()));
@@ -88,6 +102,91 @@ Status GetCrc(const std::string& apk_path, uint32_t* out_crc) {
 
 namespace android::os {
 
+Status Idmap2Service::GetCrc(const std::string& apk_path, uint32_t* out_crc) {
+  FileStamp stamp;
+  const bool has_stamp = GetFileStamp(apk_path, &stamp.mtime_ns, &stamp.size);
+  if (has_stamp) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    auto iter = crcs_.find(apk_path);
+    if (iter != crcs_.end() && iter->second.stamp == stamp) {
+      *out_crc = iter->second.crc;
+      return ok();
+    }
+  }
+
+  auto status = ComputeCrc(apk_path, out_crc);
+  if (status.isOk() && has_stamp) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    if (crcs_.size() >= kMaxCachedCrcs && crcs_.find(apk_path) == crcs_.end()) {
+      // Drop the crcs of the APKs that were removed or changed first, and an arbitrary one if
+      // every cached APK is still current.
+      for (auto iter = crcs_.begin(); iter != crcs_.end();) {
+        FileStamp current;
+        if (!GetFileStamp(iter->first, &current.mtime_ns, &current.size) ||
+            !(current == iter->second.stamp)) {
+          iter = crcs_.erase(iter);
+        } else {
+          ++iter;
+        }
+      }
+      if (crcs_.size() >= kMaxCachedCrcs) {
+        crcs_.erase(crcs_.begin());
+      }
+    }
+    crcs_[apk_path] = CachedCrc{stamp, *out_crc};
+  }
+  return status;
+}
+
+Status Idmap2Service::GetTargetCrc(const std::string& target_apk_path, uint32_t* out_crc) {
+  if (target_apk_path == kFrameworkPath) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    if (android_crc_) {
+      *out_crc = *android_crc_;
+      return ok();
+    }
+  }
+
+  auto status = GetCrc(target_apk_path, out_crc);
+
+  // Loading the framework zip can take several milliseconds. Cache the crc of the framework
+  // resource APK to reduce repeated work during boot.
+  if (status.isOk() && target_apk_path == kFrameworkPath) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    android_crc_ = *out_crc;
+  }
+  return status;
+}
+
+std::shared_ptr<const ApkAssets> Idmap2Service::GetTargetApkAssets(
+    const std::string& target_apk_path) {
+  FileStamp stamp;
+  const bool has_stamp = GetFileStamp(target_apk_path, &stamp.mtime_ns, &stamp.size);
+  if (has_stamp) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    for (auto iter = targets_.begin(); iter != targets_.end(); ++iter) {
+      if (iter->path == target_apk_path) {
+        if (!(iter->stamp == stamp)) {
+          targets_.erase(iter);
+          break;
+        }
+        targets_.splice(targets_.begin(), targets_, iter);
+        return targets_.front().apk_assets;
+      }
+    }
+  }
+
+  std::shared_ptr<const ApkAssets> target_apk = ApkAssets::Load(target_apk_path);
+  if (target_apk && has_stamp) {
+    std::lock_guard<std::mutex> lock(cache_lock_);
+    targets_.push_front(CachedApkAssets{target_apk_path, stamp, target_apk});
+    if (targets_.size() > kMaxCachedTargets) {
+      targets_.pop_back();
+    }
+  }
+  return target_apk;
+}
+
 Status Idmap2Service::getIdmapPath(const std::string& overlay_apk_path,
                                    int32_t user_id ATTRIBUTE_UNUSED, std::string* _aidl_return) {
   assert(_aidl_return);
@@ -132,20 +231,10 @@ Status Idmap2Service::verifyIdmap(const std::string& target_apk_path,
   }
 
   uint32_t target_crc;
-  if (target_apk_path == kFrameworkPath && android_crc_) {
-    target_crc = *android_crc_;
-  } else {
-    auto target_crc_status = GetCrc(target_apk_path, &target_crc);
-    if (!target_crc_status.isOk()) {
-      *_aidl_return = false;
-      return target_crc_status;
-    }
-
-    // Loading the framework zip can take several milliseconds. Cache the crc of the framework
-    // resource APK to reduce repeated work during boot.
-    if (target_apk_path == kFrameworkPath) {
-      android_crc_ = target_crc;
-    }
+  auto target_crc_status = GetTargetCrc(target_apk_path, &target_crc);
+  if (!target_crc_status.isOk()) {
+    *_aidl_return = false;
+    return target_crc_status;
   }
 
   uint32_t overlay_crc;
@@ -180,18 +269,24 @@ Status Idmap2Service::createIdmap(const std::string& target_apk_path,
                                     idmap_path.c_str(), uid));
   }
 
-  const std::unique_ptr<const ApkAssets> target_apk = ApkAssets::Load(target_apk_path);
+  const std::shared_ptr<const ApkAssets> target_apk = GetTargetApkAssets(target_apk_path);
   if (!target_apk) {
     return error("failed to load apk " + target_apk_path);
   }
 
+  uint32_t target_crc;
+  auto target_crc_status = GetTargetCrc(target_apk_path, &target_crc);
+  if (!target_crc_status.isOk()) {
+    return target_crc_status;
+  }
+
   const std::unique_ptr<const ApkAssets> overlay_apk = ApkAssets::Load(overlay_apk_path);
   if (!overlay_apk) {
     return error("failed to load apk " + overlay_apk_path);
   }
 
-  const auto idmap =
-      Idmap::FromApkAssets(*target_apk, *overlay_apk, policy_bitmask, enforce_overlayable);
+  const auto idmap = Idmap::FromApkAssets(*target_apk, target_crc, *overlay_apk, policy_bitmask,
+                                          enforce_overlayable);
   if (!idmap) {
     return error(idmap.GetErrorMessage());
   }
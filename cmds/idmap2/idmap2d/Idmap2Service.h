@@ -20,8 +20,17 @@
 #include <android-base/unique_fd.h>
 #include <binder/BinderService.h>
 #include <binder/Nullable.h>
+#include <sys/types.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 
 #include "android/os/BnIdmap2.h"
+#include "androidfw/ApkAssets.h"
 
 namespace android::os {
 
@@ -48,8 +57,50 @@ class Idmap2Service : public BinderService<Idmap2Service>, public BnIdmap2 {
                              aidl::nullable<std::string>* _aidl_return) override;
 
  private:
+  // The size and modification time of a file, to tell whether it changed since it was cached.
+  struct FileStamp {
+    off_t size = 0;
+    int64_t mtime_ns = 0;
+
+    bool operator==(const FileStamp& rhs) const {
+      return size == rhs.size && mtime_ns == rhs.mtime_ns;
+    }
+  };
+
+  struct CachedCrc {
+    FileStamp stamp;
+    uint32_t crc;
+  };
+
+  struct CachedApkAssets {
+    std::string path;
+    FileStamp stamp;
+    std::shared_ptr<const ApkAssets> apk_assets;
+  };
+
+  // Retrieves the crc of the APK, from the cache if the APK did not change since it was computed.
+  binder::Status GetCrc(const std::string& apk_path, uint32_t* out_crc);
+
+  // Same as GetCrc(), but never checks the framework again once its crc is known.
+  binder::Status GetTargetCrc(const std::string& target_apk_path, uint32_t* out_crc);
+
+  // Loads the target APK, or reuses it if it was loaded recently and did not change since.
+  std::shared_ptr<const ApkAssets> GetTargetApkAssets(const std::string& target_apk_path);
+
+  // Guards the caches below; binder calls are served on several threads.
+  std::mutex cache_lock_;
+
   // Cache the crc of the android framework package since the crc cannot change without a reboot.
   std::optional<uint32_t> android_crc_;
+
+  // The crcs of the APKs seen so far. Overlay manager verifies every idmap on each package change
+  // and user switch, so this spares reading the zip of every APK over and over. Holds at most
+  // kMaxCachedCrcs entries.
+  std::map<std::string, CachedCrc> crcs_;
+
+  // The most recently loaded target APKs, most recent first. A few targets, like the framework and
+  // SystemUI, have most of the overlays.
+  std::list<CachedApkAssets> targets_;
 };
 
 }  // namespace android::os
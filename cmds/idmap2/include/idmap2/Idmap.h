@@ -274,6 +274,14 @@ class Idmap {
                                                             const PolicyBitmask& fulfilled_policies,
                                                             bool enforce_overlayable);
 
+  // Same as above, with the GetPackageCrc() of the target already computed. Meant for creating the
+  // idmaps of many overlays of the same target without reading the target zip for each of them.
+  static Result<std::unique_ptr<const Idmap>> FromApkAssets(const ApkAssets& target_apk_assets,
+                                                            uint32_t target_crc,
+                                                            const ApkAssets& overlay_apk_assets,
+                                                            const PolicyBitmask& fulfilled_policies,
+                                                            bool enforce_overlayable);
+
   inline const std::unique_ptr<const IdmapHeader>& GetHeader() const {
     return header_;
   }
@@ -20,6 +20,7 @@
 #include <map>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "androidfw/ApkAssets.h"
 #include "idmap2/LogInfo.h"
@@ -44,6 +45,10 @@ struct TargetValue {
 using TargetResourceMap = std::map<ResourceId, TargetValue>;
 using OverlayResourceMap = std::map<ResourceId, ResourceId>;
 
+// The same mappings as above, as vectors sorted by their first resource id.
+using TargetResourceEntries = std::vector<std::pair<ResourceId, TargetValue>>;
+using OverlayResourceEntries = std::vector<std::pair<ResourceId, ResourceId>>;
+
 class ResourceMapping {
  public:
   // Creates a ResourceMapping using the target and overlay APKs. Setting enforce_overlayable to
@@ -57,12 +62,24 @@ class ResourceMapping {
 
   // Retrieves the mapping of target resource id to overlay value.
   inline TargetResourceMap GetTargetToOverlayMap() const {
-    return target_map_;
+    return TargetResourceMap(target_entries_.begin(), target_entries_.end());
   }
 
   // Retrieves the mapping of overlay resource id to target resource id. This allows a reference to
   // an overlay resource to appear as a reference to its corresponding target resource at runtime.
-  OverlayResourceMap GetOverlayToTargetMap() const;
+  inline OverlayResourceMap GetOverlayToTargetMap() const {
+    return OverlayResourceMap(overlay_entries_.begin(), overlay_entries_.end());
+  }
+
+  // Same as GetTargetToOverlayMap(), sorted by target resource id, without copying.
+  inline const TargetResourceEntries& GetTargetEntries() const {
+    return target_entries_;
+  }
+
+  // Same as GetOverlayToTargetMap(), sorted by overlay resource id, without copying.
+  inline const OverlayResourceEntries& GetOverlayEntries() const {
+    return overlay_entries_;
+  }
 
   // Retrieves the build-time package id of the target package.
   inline uint32_t GetTargetPackageId() const {
@@ -88,19 +105,32 @@ class ResourceMapping {
  private:
   ResourceMapping() = default;
 
-  // Apps a mapping of target resource id to the type and value of the data that overlays the
+  // A mapping added with AddMapping().
+  struct Mapping {
+    ResourceId target_resource;
+    TargetValue value;
+    bool rewrite_overlay_reference;
+    // The number of mappings added before this one.
+    uint32_t order;
+  };
+
+  // Adds a mapping of target resource id to the type and value of the data that overlays the
   // target resource. The data_type is the runtime format of the data value (see
   // Res_value::dataType). If rewrite_overlay_reference is `true` then references to an overlay
   // resource should appear as a reference to its corresponding target resource at runtime.
-  Result<Unit> AddMapping(ResourceId target_resource, TargetValue::DataType data_type,
-                          TargetValue::DataValue data_value, bool rewrite_overlay_reference);
+  // If the target resource is mapped more than once, only the first mapping is kept.
+  void AddMapping(ResourceId target_resource, TargetValue::DataType data_type,
+                  TargetValue::DataValue data_value, bool rewrite_overlay_reference);
 
-  // Removes the overlay value mapping for the target resource.
-  void RemoveMapping(ResourceId target_resource);
+  // Sorts the added mappings by target resource id, and drops the extra mappings of target
+  // resources that are mapped more than once.
+  void SortMappings();
+
+  // Builds the target and overlay entries from the sorted mappings.
+  void BuildEntries();
 
   // Parses the mapping of target resources to overlay resources to generate a ResourceMapping.
-  static Result<ResourceMapping> CreateResourceMapping(const AssetManager2* target_am,
-                                                       const LoadedPackage* target_package,
+  static Result<ResourceMapping> CreateResourceMapping(const LoadedPackage* target_package,
                                                        const LoadedPackage* overlay_package,
                                                        size_t string_pool_offset,
                                                        const XmlParser& overlay_parser,
@@ -109,20 +139,24 @@ class ResourceMapping {
   // Generates a ResourceMapping that maps target resources to overlay resources by name. To overlay
   // a target resource, a resource must exist in the overlay with the same type and entry name as
   // the target resource.
-  static Result<ResourceMapping> CreateResourceMappingLegacy(const AssetManager2* target_am,
-                                                             const AssetManager2* overlay_am,
+  static Result<ResourceMapping> CreateResourceMappingLegacy(const AssetManager2* overlay_am,
                                                              const LoadedPackage* target_package,
                                                              const LoadedPackage* overlay_package);
 
-  // Removes resources that do not pass policy or overlayable checks of the target package.
+  // Removes resources that do not pass policy or overlayable checks of the target package. Must be
+  // called between SortMappings() and BuildEntries().
   void FilterOverlayableResources(const AssetManager2* target_am,
                                   const LoadedPackage* target_package,
                                   const LoadedPackage* overlay_package,
                                   const OverlayManifestInfo& overlay_info,
                                   const PolicyBitmask& fulfilled_policies, LogInfo& log_info);
 
-  TargetResourceMap target_map_;
-  std::multimap<ResourceId, ResourceId> overlay_map_;
+  // The mappings in the order they were added, until SortMappings() sorts them. Emptied by
+  // BuildEntries().
+  std::vector<Mapping> mappings_;
+
+  TargetResourceEntries target_entries_;
+  OverlayResourceEntries overlay_entries_;
 
   uint32_t target_package_id_ = 0;
   uint32_t overlay_package_id_ = 0;
@@ -285,17 +285,22 @@ Result<std::unique_ptr<const Idmap>> Idmap::FromBinaryStream(std::istream& strea
 
 Result<std::unique_ptr<const IdmapData>> IdmapData::FromResourceMapping(
     const ResourceMapping& resource_mapping) {
-  if (resource_mapping.GetTargetToOverlayMap().empty()) {
+  const TargetResourceEntries& target_entries = resource_mapping.GetTargetEntries();
+  if (target_entries.empty()) {
     return Error("no resources were overlaid");
   }
 
+  // The entries are already sorted by resource id, as the idmap stores them.
   std::unique_ptr<IdmapData> data(new IdmapData());
-  for (const auto& mappings : resource_mapping.GetTargetToOverlayMap()) {
+  data->target_entries_.reserve(target_entries.size());
+  for (const auto& mappings : target_entries) {
     data->target_entries_.emplace_back(IdmapData::TargetEntry{
         mappings.first, mappings.second.data_type, mappings.second.data_value});
   }
 
-  for (const auto& mappings : resource_mapping.GetOverlayToTargetMap()) {
+  const OverlayResourceEntries& overlay_entries = resource_mapping.GetOverlayEntries();
+  data->overlay_entries_.reserve(overlay_entries.size());
+  for (const auto& mappings : overlay_entries) {
     data->overlay_entries_.emplace_back(IdmapData::OverlayEntry{mappings.first, mappings.second});
   }
 
@@ -319,15 +324,29 @@ Result<std::unique_ptr<const Idmap>> Idmap::FromApkAssets(const ApkAssets& targe
                                                           const ApkAssets& overlay_apk_assets,
                                                           const PolicyBitmask& fulfilled_policies,
                                                           bool enforce_overlayable) {
-  SYSTRACE << "Idmap::FromApkAssets";
-  const std::string& target_apk_path = target_apk_assets.GetPath();
-  const std::string& overlay_apk_path = overlay_apk_assets.GetPath();
-
-  const std::unique_ptr<const ZipFile> target_zip = ZipFile::Open(target_apk_path);
+  const std::unique_ptr<const ZipFile> target_zip = ZipFile::Open(target_apk_assets.GetPath());
   if (!target_zip) {
     return Error("failed to open target as zip");
   }
 
+  const Result<uint32_t> target_crc = GetPackageCrc(*target_zip);
+  if (!target_crc) {
+    return Error(target_crc.GetError(), "failed to get zip CRC for target");
+  }
+
+  return FromApkAssets(target_apk_assets, *target_crc, overlay_apk_assets, fulfilled_policies,
+                       enforce_overlayable);
+}
+
+Result<std::unique_ptr<const Idmap>> Idmap::FromApkAssets(const ApkAssets& target_apk_assets,
+                                                          uint32_t target_crc,
+                                                          const ApkAssets& overlay_apk_assets,
+                                                          const PolicyBitmask& fulfilled_policies,
+                                                          bool enforce_overlayable) {
+  SYSTRACE << "Idmap::FromApkAssets";
+  const std::string& target_apk_path = target_apk_assets.GetPath();
+  const std::string& overlay_apk_path = overlay_apk_assets.GetPath();
+
   const std::unique_ptr<const ZipFile> overlay_zip = ZipFile::Open(overlay_apk_path);
   if (!overlay_zip) {
     return Error("failed to open overlay as zip");
@@ -337,13 +356,9 @@ Result<std::unique_ptr<const Idmap>> Idmap::FromApkAssets(const ApkAssets& targe
   header->magic_ = kIdmapMagic;
   header->version_ = kIdmapCurrentVersion;
 
-  Result<uint32_t> crc = GetPackageCrc(*target_zip);
-  if (!crc) {
-    return Error(crc.GetError(), "failed to get zip CRC for target");
-  }
-  header->target_crc_ = *crc;
+  header->target_crc_ = target_crc;
 
-  crc = GetPackageCrc(*overlay_zip);
+  const Result<uint32_t> crc = GetPackageCrc(*overlay_zip);
   if (!crc) {
     return Error(crc.GetError(), "failed to get zip CRC for overlay");
   }
@@ -16,15 +16,16 @@
 
 #include "idmap2/ResourceMapping.h"
 
-#include <map>
+#include <algorithm>
 #include <memory>
-#include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "android-base/stringprintf.h"
 #include "androidfw/ResourceTypes.h"
+#include "androidfw/ResourceUtils.h"
+#include "androidfw/Util.h"
 #include "idmap2/PolicyUtils.h"
 #include "idmap2/ResourceUtils.h"
 
@@ -147,10 +148,36 @@ Result<std::unique_ptr<Asset>> OpenNonAssetFromResource(const ResourceId& resour
   return asset;
 }
 
+// Finds the resource named `resource_name`, of the format [[package:]type/]entry, in the target
+// package. This looks the name up in the hashed name index of the package directly, instead of
+// going through an AssetManager2. Returns 0 if the target package has no such resource.
+ResourceId FindTargetResource(const LoadedPackage& target_package,
+                              const StringPiece& resource_name) {
+  StringPiece package;
+  StringPiece type;
+  StringPiece entry;
+  if (!ExtractResourceName(resource_name, &package, &type, &entry) || entry.empty()) {
+    return 0U;
+  }
+
+  if (!package.empty() && package != target_package.GetPackageName()) {
+    return 0U;
+  }
+
+  const std::u16string entry16 = util::Utf8ToUtf16(entry);
+  uint32_t resid = target_package.FindEntryByName(util::Utf8ToUtf16(type), entry16);
+  if (resid == 0U && type == "attr") {
+    // Private attributes of libraries are sometimes encoded under the type '^attr-private'.
+    resid = target_package.FindEntryByName(u"^attr-private", entry16);
+  }
+
+  // Use the compile-time resource id of the target resource.
+  return resid != 0U ? REWRITE_PACKAGE(resid, target_package.GetPackageId()) : 0U;
+}
+
 }  // namespace
 
-Result<ResourceMapping> ResourceMapping::CreateResourceMapping(const AssetManager2* target_am,
-                                                               const LoadedPackage* target_package,
+Result<ResourceMapping> ResourceMapping::CreateResourceMapping(const LoadedPackage* target_package,
                                                                const LoadedPackage* overlay_package,
                                                                size_t string_pool_offset,
                                                                const XmlParser& overlay_parser,
@@ -161,7 +188,6 @@ Result<ResourceMapping> ResourceMapping::CreateResourceMapping(const AssetManage
     return Error("root element is not <overlay> tag");
   }
 
-  const uint8_t target_package_id = target_package->GetPackageId();
   const uint8_t overlay_package_id = overlay_package->GetPackageId();
   auto overlay_it_end = root_it.end();
   for (auto overlay_it = root_it.begin(); overlay_it != overlay_it_end; ++overlay_it) {
@@ -187,17 +213,13 @@ Result<ResourceMapping> ResourceMapping::CreateResourceMapping(const AssetManage
       return Error(R"(<item> tag missing expected attribute "value")");
     }
 
-    ResourceId target_id =
-        target_am->GetResourceId(*target_resource, "", target_package->GetPackageName());
+    const ResourceId target_id = FindTargetResource(*target_package, *target_resource);
     if (target_id == 0U) {
       log_info.Warning(LogMessage() << "failed to find resource \"" << *target_resource
                                     << "\" in target resources");
       continue;
     }
 
-    // Retrieve the compile-time resource id of the target resource.
-    target_id = REWRITE_PACKAGE(target_id, target_package_id);
-
     if (overlay_resource->dataType == Res_value::TYPE_STRING) {
       overlay_resource->data += string_pool_offset;
     }
@@ -221,10 +243,9 @@ Result<ResourceMapping> ResourceMapping::CreateResourceMapping(const AssetManage
 }
 
 Result<ResourceMapping> ResourceMapping::CreateResourceMappingLegacy(
-    const AssetManager2* target_am, const AssetManager2* overlay_am,
-    const LoadedPackage* target_package, const LoadedPackage* overlay_package) {
+    const AssetManager2* overlay_am, const LoadedPackage* target_package,
+    const LoadedPackage* overlay_package) {
   ResourceMapping resource_mapping;
-  const uint8_t target_package_id = target_package->GetPackageId();
   const auto end = overlay_package->end();
   for (auto iter = overlay_package->begin(); iter != end; ++iter) {
     const ResourceId overlay_resid = *iter;
@@ -234,16 +255,11 @@ Result<ResourceMapping> ResourceMapping::CreateResourceMappingLegacy(
     }
 
     // Find the resource with the same type and entry name within the target package.
-    const std::string full_name =
-        base::StringPrintf("%s:%s", target_package->GetPackageName().c_str(), name->c_str());
-    ResourceId target_resource = target_am->GetResourceId(full_name);
+    const ResourceId target_resource = FindTargetResource(*target_package, *name);
     if (target_resource == 0U) {
       continue;
     }
 
-    // Retrieve the compile-time resource id of the target resource.
-    target_resource = REWRITE_PACKAGE(target_resource, target_package_id);
-
     resource_mapping.AddMapping(target_resource, Res_value::TYPE_REFERENCE, overlay_resid,
                                 /* rewrite_overlay_reference */ false);
   }
@@ -257,13 +273,12 @@ void ResourceMapping::FilterOverlayableResources(const AssetManager2* target_am,
                                                  const OverlayManifestInfo& overlay_info,
                                                  const PolicyBitmask& fulfilled_policies,
                                                  LogInfo& log_info) {
-  std::set<ResourceId> remove_ids;
-  for (const auto& target_map : target_map_) {
-    const ResourceId target_resid = target_map.first;
+  auto new_end = std::remove_if(mappings_.begin(), mappings_.end(), [&](const Mapping& mapping) {
+    const ResourceId target_resid = mapping.target_resource;
     Result<Unit> success =
         CheckOverlayable(*target_package, overlay_info, fulfilled_policies, target_resid);
     if (success) {
-      continue;
+      return false;
     }
 
     // Attempting to overlay a resource that is not allowed to be overlaid is treated as a
@@ -276,13 +291,9 @@ void ResourceMapping::FilterOverlayableResources(const AssetManager2* target_am,
     log_info.Warning(LogMessage() << "overlay \"" << overlay_package->GetPackageName()
                                   << "\" is not allowed to overlay resource \"" << *name
                                   << "\" in target: " << success.GetErrorMessage());
-
-    remove_ids.insert(target_resid);
-  }
-
-  for (const ResourceId target_resid : remove_ids) {
-    RemoveMapping(target_resid);
-  }
+    return true;
+  });
+  mappings_.erase(new_end, mappings_.end());
 }
 
 Result<ResourceMapping> ResourceMapping::FromApkAssets(const ApkAssets& target_apk_assets,
@@ -355,19 +366,21 @@ Result<ResourceMapping> ResourceMapping::FromApkAssets(const ApkAssets& target_a
     // Offset string indices by the size of the overlay resource table string pool.
     string_pool_offset = overlay_arsc->GetStringPool()->size();
 
-    resource_mapping = CreateResourceMapping(&target_asset_manager, target_pkg, overlay_pkg,
-                                             string_pool_offset, *(*parser), log_info);
+    resource_mapping = CreateResourceMapping(target_pkg, overlay_pkg, string_pool_offset,
+                                             *(*parser), log_info);
   } else {
     // If no file is specified using android:resourcesMap, it is assumed that the overlay only
     // defines resources intended to override target resources of the same type and name.
-    resource_mapping = CreateResourceMappingLegacy(&target_asset_manager, &overlay_asset_manager,
-                                                   target_pkg, overlay_pkg);
+    resource_mapping =
+        CreateResourceMappingLegacy(&overlay_asset_manager, target_pkg, overlay_pkg);
   }
 
   if (!resource_mapping) {
     return resource_mapping.GetError();
   }
 
+  resource_mapping->SortMappings();
+
   if (enforce_overlayable) {
     // Filter out resources the overlay is not allowed to override.
     (*resource_mapping)
@@ -375,6 +388,7 @@ Result<ResourceMapping> ResourceMapping::FromApkAssets(const ApkAssets& target_a
                                     fulfilled_policies, log_info);
   }
 
+  resource_mapping->BuildEntries();
   resource_mapping->target_package_id_ = target_pkg->GetPackageId();
   resource_mapping->overlay_package_id_ = overlay_pkg->GetPackageId();
   resource_mapping->string_pool_offset_ = string_pool_offset;
@@ -383,56 +397,58 @@ Result<ResourceMapping> ResourceMapping::FromApkAssets(const ApkAssets& target_a
   return std::move(*resource_mapping);
 }
 
-OverlayResourceMap ResourceMapping::GetOverlayToTargetMap() const {
-  // An overlay resource can override multiple target resources at once. Rewrite the overlay
-  // resource as the first target resource it overrides.
-  OverlayResourceMap map;
-  for (const auto& mappings : overlay_map_) {
-    map.insert(std::make_pair(mappings.first, mappings.second));
-  }
-  return map;
-}
-
-Result<Unit> ResourceMapping::AddMapping(ResourceId target_resource,
-                                         TargetValue::DataType data_type,
-                                         TargetValue::DataValue data_value,
-                                         bool rewrite_overlay_reference) {
-  if (target_map_.find(target_resource) != target_map_.end()) {
-    return Error(R"(target resource id "0x%08x" mapped to multiple values)", target_resource);
-  }
-
+void ResourceMapping::AddMapping(ResourceId target_resource, TargetValue::DataType data_type,
+                                 TargetValue::DataValue data_value,
+                                 bool rewrite_overlay_reference) {
   // TODO(141485591): Ensure that the overlay type is compatible with the target type. If the
   // runtime types are not compatible, it could cause runtime crashes when the resource is resolved.
+  mappings_.push_back(Mapping{target_resource, TargetValue{data_type, data_value},
+                              rewrite_overlay_reference, static_cast<uint32_t>(mappings_.size())});
+}
 
-  target_map_.insert(std::make_pair(target_resource, TargetValue{data_type, data_value}));
-
-  if (rewrite_overlay_reference && IsReference(data_type)) {
-    overlay_map_.insert(std::make_pair(data_value, target_resource));
-  }
-
-  return Result<Unit>({});
+void ResourceMapping::SortMappings() {
+  // The sort is stable, so the first mapping of each target resource comes first among its
+  // duplicates.
+  std::stable_sort(mappings_.begin(), mappings_.end(), [](const Mapping& a, const Mapping& b) {
+    return a.target_resource < b.target_resource;
+  });
+  auto new_end = std::unique(mappings_.begin(), mappings_.end(),
+                             [](const Mapping& a, const Mapping& b) {
+                               return a.target_resource == b.target_resource;
+                             });
+  mappings_.erase(new_end, mappings_.end());
 }
 
-void ResourceMapping::RemoveMapping(ResourceId target_resource) {
-  auto target_iter = target_map_.find(target_resource);
-  if (target_iter == target_map_.end()) {
-    return;
+void ResourceMapping::BuildEntries() {
+  target_entries_.clear();
+  target_entries_.reserve(mappings_.size());
+  for (const Mapping& mapping : mappings_) {
+    target_entries_.emplace_back(mapping.target_resource, mapping.value);
   }
 
-  const TargetValue value = target_iter->second;
-  target_map_.erase(target_iter);
-
-  if (!IsReference(value.data_type)) {
-    return;
+  // An overlay resource can override multiple target resources at once. Rewrite the overlay
+  // resource as the first target resource it was mapped to.
+  std::vector<const Mapping*> rewritten;
+  for (const Mapping& mapping : mappings_) {
+    if (mapping.rewrite_overlay_reference && IsReference(mapping.value.data_type)) {
+      rewritten.push_back(&mapping);
+    }
   }
-
-  auto overlay_iter = overlay_map_.equal_range(value.data_value);
-  for (auto i = overlay_iter.first; i != overlay_iter.second; ++i) {
-    if (i->second == target_resource) {
-      overlay_map_.erase(i);
-      return;
+  std::sort(rewritten.begin(), rewritten.end(), [](const Mapping* a, const Mapping* b) {
+    return a->value.data_value != b->value.data_value ? a->value.data_value < b->value.data_value
+                                                      : a->order < b->order;
+  });
+
+  overlay_entries_.clear();
+  overlay_entries_.reserve(rewritten.size());
+  for (const Mapping* mapping : rewritten) {
+    if (overlay_entries_.empty() || overlay_entries_.back().first != mapping->value.data_value) {
+      overlay_entries_.emplace_back(mapping->value.data_value, mapping->target_resource);
     }
   }
+
+  mappings_.clear();
+  mappings_.shrink_to_fit();
 }
 
 }  // namespace android::idmap2
@@ -193,6 +193,35 @@ TEST(IdmapTests, CreateIdmapHeaderFromApkAssets) {
   ASSERT_EQ(idmap->GetHeader()->GetOverlayPath(), overlay_apk_path);
 }
 
+TEST(IdmapTests, CreateIdmapFromApkAssetsWithTargetCrc) {
+  std::string target_apk_path = GetTestDataPath() + "/target/target.apk";
+  std::string overlay_apk_path = GetTestDataPath() + "/overlay/overlay.apk";
+
+  std::unique_ptr<const ApkAssets> target_apk = ApkAssets::Load(target_apk_path);
+  ASSERT_THAT(target_apk, NotNull());
+
+  std::unique_ptr<const ApkAssets> overlay_apk = ApkAssets::Load(overlay_apk_path);
+  ASSERT_THAT(overlay_apk, NotNull());
+
+  auto expected = Idmap::FromApkAssets(*target_apk, *overlay_apk, PolicyFlags::PUBLIC,
+                                       /* enforce_overlayable */ true);
+  ASSERT_TRUE(expected) << expected.GetErrorMessage();
+  auto actual = Idmap::FromApkAssets(*target_apk, android::idmap2::TestConstants::TARGET_CRC,
+                                     *overlay_apk, PolicyFlags::PUBLIC,
+                                     /* enforce_overlayable */ true);
+  ASSERT_TRUE(actual) << actual.GetErrorMessage();
+
+  std::stringstream expected_stream;
+  BinaryStreamVisitor expected_visitor(expected_stream);
+  (*expected)->accept(&expected_visitor);
+
+  std::stringstream actual_stream;
+  BinaryStreamVisitor actual_visitor(actual_stream);
+  (*actual)->accept(&actual_visitor);
+
+  ASSERT_EQ(actual_stream.str(), expected_stream.str());
+}
+
 Result<std::unique_ptr<const IdmapData>> TestIdmapDataFromApkAssets(
     const android::StringPiece& local_target_apk_path,
     const android::StringPiece& local_overlay_apk_path, const OverlayManifestInfo& overlay_info,
@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <sstream>
+#include <strings.h>
 #include <unistd.h>
 
 bool isValidChar(char c) {
@@ -38,60 +39,72 @@ std::string trim(const std::string& s, const std::string& charset) {
     return s.substr(head, tail - head + 1);
 }
 
-static inline std::string toLowerStr(const std::string& s) {
-    std::string res(s);
-    std::transform(res.begin(), res.end(), res.begin(), ::tolower);
-    return res;
-}
-
 static inline std::string trimDefault(const std::string& s) {
     return trim(s, DEFAULT_WHITESPACE);
 }
 
-static inline std::string trimHeader(const std::string& s) {
-    return toLowerStr(trimDefault(s));
-}
-
 static inline bool isNumber(const std::string& s) {
     std::string::const_iterator it = s.begin();
     while (it != s.end() && std::isdigit(*it)) ++it;
     return !s.empty() && it == s.end();
 }
 
-// This is similiar to Split in android-base/file.h, but it won't add empty string
-static void split(const std::string& line, std::vector<std::string>& words,
-        const trans_func& func, const std::string& delimiters) {
-    words.clear();  // clear the buffer before split
+static inline bool isWhitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Trims line[begin, end) with DEFAULT_WHITESPACE and stores it in (*words)[index], reusing the
+// string already there if any. Returns false without storing anything if nothing is left.
+static bool assignTrimmed(std::vector<std::string>* words, size_t index,
+        const std::string& line, size_t begin, size_t end, bool keepEmpty) {
+    while (begin < end && isWhitespace(line[begin])) begin++;
+    while (end > begin && isWhitespace(line[end - 1])) end--;
+    if (begin == end && !keepEmpty) return false;
+    if (index < words->size()) {
+        (*words)[index].assign(line, begin, end - begin);
+    } else {
+        words->emplace_back(line, begin, end - begin);
+    }
+    return true;
+}
 
+// This is similiar to Split in android-base/file.h, but it won't add empty string
+static void split(const std::string& line, std::vector<std::string>* words,
+        bool lowerCase, const std::string& delimiters) {
+    size_t count = 0;
     size_t base = 0;
-    size_t found;
     while (true) {
-        found = line.find_first_of(delimiters, base);
-        if (found != base) {
-            std::string word = (*func) (line.substr(base, found - base));
-            if (!word.empty()) {
-                words.push_back(word);
+        size_t found = line.find_first_of(delimiters, base);
+        size_t end = found == line.npos ? line.size() : found;
+        if (assignTrimmed(words, count, line, base, end, false)) {
+            if (lowerCase) {
+                std::string& word = (*words)[count];
+                std::transform(word.begin(), word.end(), word.begin(), ::tolower);
             }
+            count++;
         }
         if (found == line.npos) break;
         base = found + 1;
     }
+    words->resize(count);
 }
 
 header_t parseHeader(const std::string& line, const std::string& delimiters) {
     header_t header;
-    trans_func f = &trimHeader;
-    split(line, header, f, delimiters);
+    split(line, &header, true, delimiters);
     return header;
 }
 
 record_t parseRecord(const std::string& line, const std::string& delimiters) {
     record_t record;
-    trans_func f = &trimDefault;
-    split(line, record, f, delimiters);
+    split(line, &record, false, delimiters);
     return record;
 }
 
+void parseRecord(const std::string& line, record_t* record, const std::string& delimiters) {
+    split(line, record, false, delimiters);
+}
+
 bool getColumnIndices(std::vector<int>& indices, const char** headerNames, const std::string& line) {
     indices.clear();
 
@@ -114,6 +127,13 @@ bool getColumnIndices(std::vector<int>& indices, const char** headerNames, const
 
 record_t parseRecordByColumns(const std::string& line, const std::vector<int>& indices, const std::string& delimiters) {
     record_t record;
+    parseRecordByColumns(line, indices, &record, delimiters);
+    return record;
+}
+
+void parseRecordByColumns(const std::string& line, const std::vector<int>& indices,
+        record_t* record, const std::string& delimiters) {
+    size_t count = 0;
     int lastIndex = 0;
     int lastBeginning = 0;
     int lineSize = (int)line.size();
@@ -132,25 +152,25 @@ record_t parseRecordByColumns(const std::string& line, const std::vector<int>& i
             }
             // If we're past the end of the line AND we've already saved everything up to the end.
             fprintf(stderr, "index wrong: lastIndex: %d, idx: %d, lineSize: %d\n", lastIndex, idx, lineSize);
-            record.clear(); // The indices are wrong, return empty.
-            return record;
+            record->clear(); // The indices are wrong, return empty.
+            return;
         }
         while (idx < lineSize && delimiters.find(line[idx++]) == std::string::npos);
-        record.push_back(trimDefault(line.substr(lastIndex, idx - lastIndex)));
+        assignTrimmed(record, count++, line, lastIndex, idx, true);
         lastBeginning = lastIndex;
         lastIndex = idx;
     }
     if (lineSize - lastIndex > 0) {
         int beginning = lastIndex;
-        if (record.size() == indices.size() && !record.empty()) {
+        if (count == indices.size() && count > 0) {
             // We've already encountered all of the columns...put whatever is
             // left in the last column.
-            record.pop_back();
+            count--;
             beginning = lastBeginning;
         }
-        record.push_back(trimDefault(line.substr(beginning, lineSize - beginning)));
+        assignTrimmed(record, count++, line, beginning, lineSize, true);
     }
-    return record;
+    record->resize(count);
 }
 
 void printRecord(const record_t& record) {
@@ -237,24 +257,28 @@ double toDouble(const std::string& s) {
 Reader::Reader(const int fd)
 {
     mFile = fdopen(fd, "r");
-    mBuffer = new char[1024];
+    mBuffer = nullptr;
+    mBufferSize = 0;
     mStatus = mFile == nullptr ? "Invalid fd " + std::to_string(fd) : "";
 }
 
 Reader::~Reader()
 {
     if (mFile != nullptr) fclose(mFile);
-    delete[] mBuffer;
+    free(mBuffer);
 }
 
 bool Reader::readLine(std::string* line) {
     if (mFile == nullptr) return false;
 
-    size_t len = 0;
-    ssize_t read = getline(&mBuffer, &len, mFile);
+    ssize_t read = getline(&mBuffer, &mBufferSize, mFile);
     if (read != -1) {
-        std::string s(mBuffer);
-        line->assign(trim(s, DEFAULT_NEWLINE));
+        // Trim the newlines in place rather than copying the line first.
+        const char* head = mBuffer;
+        const char* tail = mBuffer + read;
+        while (head < tail && (*head == '\r' || *head == '\n')) head++;
+        while (tail > head && (tail[-1] == '\r' || tail[-1] == '\n')) tail--;
+        line->assign(head, tail - head);
         return true;
     }
     if (!feof(mFile)) {
@@ -308,12 +332,42 @@ Table::addEnumNameToValue(const char* enumName, const int enumValue)
     mEnumValuesByName[enumName] = enumValue;
 }
 
+Table::Field
+Table::findField(const std::string& name) const
+{
+    Field field = {0, nullptr};
+    auto it = mFields.find(name);
+    if (it != mFields.end()) {
+        field.id = it->second;
+        auto enu = mEnums.find(name);
+        if (enu != mEnums.end()) {
+            field.enums = &enu->second;
+        }
+    }
+    return field;
+}
+
+void
+Table::resolveFields(const header_t& header, std::vector<Field>* fields) const
+{
+    fields->clear();
+    for (const std::string& name : header) {
+        fields->push_back(findField(name));
+    }
+}
+
 bool
 Table::insertField(ProtoOutputStream* proto, const std::string& name, const std::string& value)
 {
-    if (mFields.find(name) == mFields.end()) return false;
+    return insertField(proto, findField(name), value);
+}
+
+bool
+Table::insertField(ProtoOutputStream* proto, const Field& field, const std::string& value)
+{
+    if (field.id == 0) return false;
 
-    uint64_t found = mFields[name];
+    uint64_t found = field.id;
     record_t repeats; // used for repeated fields
     switch ((found & FIELD_COUNT_MASK) | (found & FIELD_TYPE_MASK)) {
         case FIELD_COUNT_SINGLE | FIELD_TYPE_DOUBLE:
@@ -332,20 +386,21 @@ Table::insertField(ProtoOutputStream* proto, const std::string& name, const std:
             proto->write(found, toLongLong(value));
             break;
         case FIELD_COUNT_SINGLE | FIELD_TYPE_BOOL:
-            if (strcmp(toLowerStr(value).c_str(), "true") == 0 || strcmp(value.c_str(), "1") == 0) {
+            if (strcasecmp(value.c_str(), "true") == 0 || strcmp(value.c_str(), "1") == 0) {
                 proto->write(found, true);
                 break;
             }
-            if (strcmp(toLowerStr(value).c_str(), "false") == 0 || strcmp(value.c_str(), "0") == 0) {
+            if (strcasecmp(value.c_str(), "false") == 0 || strcmp(value.c_str(), "0") == 0) {
                 proto->write(found, false);
                 break;
             }
             return false;
         case FIELD_COUNT_SINGLE | FIELD_TYPE_ENUM:
             // if the field has its own enum mapping, use this, otherwise use general name to value mapping.
-            if (mEnums.find(name) != mEnums.end()) {
-                if (mEnums[name].find(value) != mEnums[name].end()) {
-                    proto->write(found, mEnums[name][value]);
+            if (field.enums != nullptr) {
+                auto enu = field.enums->find(value);
+                if (enu != field.enums->end()) {
+                    proto->write(found, enu->second);
                 } else {
                     proto->write(found, 0); // TODO: should get the default enum value (Unknown)
                 }
@@ -366,13 +421,13 @@ Table::insertField(ProtoOutputStream* proto, const std::string& name, const std:
             break;
         // REPEATED TYPE below:
         case FIELD_COUNT_REPEATED | FIELD_TYPE_INT32:
-            repeats = parseRecord(value, COMMA_DELIMITER);
+            parseRecord(value, &repeats, COMMA_DELIMITER);
             for (size_t i=0; i<repeats.size(); i++) {
                 proto->write(found, toInt(repeats[i]));
             }
             break;
         case FIELD_COUNT_REPEATED | FIELD_TYPE_STRING:
-            repeats = parseRecord(value, COMMA_DELIMITER);
+            parseRecord(value, &repeats, COMMA_DELIMITER);
             for (size_t i=0; i<repeats.size(); i++) {
                 proto->write(found, repeats[i]);
             }
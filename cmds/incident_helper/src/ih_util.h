@@ -57,6 +57,13 @@ std::string trim(const std::string& s, const std::string& charset);
 header_t parseHeader(const std::string& line, const std::string& delimiters = DEFAULT_WHITESPACE);
 record_t parseRecord(const std::string& line, const std::string& delimiters = DEFAULT_WHITESPACE);
 
+/**
+ * Same as parseRecord, but parses into the given record and reuses its strings, so parsing a
+ * table line by line stops allocating once the record has grown to the widest line.
+ */
+void parseRecord(const std::string& line, record_t* record,
+        const std::string& delimiters = DEFAULT_WHITESPACE);
+
 /**
  * Gets the list of end indices of each word in the line and places it in the given vector,
  * clearing out the vector beforehand. These indices can be used with parseRecordByColumns.
@@ -72,6 +79,12 @@ bool getColumnIndices(std::vector<int>& indices, const char* headerNames[], cons
  */
 record_t parseRecordByColumns(const std::string& line, const std::vector<int>& indices, const std::string& delimiters = DEFAULT_WHITESPACE);
 
+/**
+ * Same as parseRecordByColumns, but parses into the given record and reuses its strings.
+ */
+void parseRecordByColumns(const std::string& line, const std::vector<int>& indices,
+        record_t* record, const std::string& delimiters = DEFAULT_WHITESPACE);
+
 /** Prints record_t to stderr */
 void printRecord(const record_t& record);
 
@@ -117,7 +130,9 @@ public:
 
 private:
     FILE* mFile;
+    // Owned by getline, which grows it as needed.
     char* mBuffer;
+    size_t mBufferSize;
     std::string mStatus;
 };
 
@@ -137,6 +152,14 @@ class Table
 {
 friend class Message;
 public:
+    // A field looked up by name, see resolveFields.
+    struct Field {
+        // The streaming proto field id, or 0 if the name isn't a field of the table.
+        uint64_t id;
+        // The field's own enum mapping, if it has one.
+        const std::map<std::string, int>* enums;
+    };
+
     Table(const char* names[], const uint64_t ids[], const int count);
     ~Table();
 
@@ -150,7 +173,16 @@ public:
     // Based on given name, find the right field id, parse the text value and insert to proto.
     // Return false if the given name can't be found.
     bool insertField(ProtoOutputStream* proto, const std::string& name, const std::string& value);
+
+    // Looks up each name in the header once, so that table rows can be inserted column by
+    // column instead of looking up every cell by name. Enum mappings must be added first.
+    void resolveFields(const header_t& header, std::vector<Field>* fields) const;
+
+    // Same as insertField by name, for a field returned by resolveFields.
+    bool insertField(ProtoOutputStream* proto, const Field& field, const std::string& value);
 private:
+    Field findField(const std::string& name) const;
+
     std::map<std::string, uint64_t> mFields;
     std::map<std::string, std::map<std::string, int>> mEnums;
     std::map<std::string, int> mEnumValuesByName;
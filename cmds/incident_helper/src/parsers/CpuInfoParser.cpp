@@ -48,6 +48,7 @@ CpuInfoParser::Parse(const int in, const int out) const
     header_t header;
     vector<int> columnIndices; // task table can't be split by purely delimiter, needs column positions.
     record_t record;
+    vector<Table::Field> fields;  // the table field of each header column
     int nline = 0;
     int diff = 0;
     bool nextToSwap = false;
@@ -107,6 +108,7 @@ CpuInfoParser::Parse(const int in, const int out) const
             // After parsing, header = { PID, TID, USER, PR, NI, CPU, S, VIRT, RES, PCY, CMD, NAME }
             // And columnIndices will contain end index of each word.
             header = parseHeader(line, "[ %]");
+            table.resolveFields(header, &fields);
             nextToUsage = false;
 
             // NAME is not in the list since we need to modify the end of the CMD index.
@@ -127,7 +129,7 @@ CpuInfoParser::Parse(const int in, const int out) const
             continue;
         }
 
-        record = parseRecordByColumns(line, columnIndices);
+        parseRecordByColumns(line, columnIndices, &record);
         diff = record.size() - header.size();
         if (diff < 0) {
             fprintf(stderr, "[%s]Line %d has %d missing fields\n%s\n", this->name.string(), nline, -diff, line.c_str());
@@ -141,7 +143,7 @@ CpuInfoParser::Parse(const int in, const int out) const
 
         uint64_t token = proto.start(CpuInfoProto::TASKS);
         for (int i=0; i<(int)record.size(); i++) {
-            if (!table.insertField(&proto, header[i], record[i])) {
+            if (!table.insertField(&proto, fields[i], record[i])) {
                 fprintf(stderr, "[%s]Line %d fails to insert field %s with value %s\n",
                         this->name.string(), nline, header[i].c_str(), record[i].c_str());
             }
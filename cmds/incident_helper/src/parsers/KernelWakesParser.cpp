@@ -30,6 +30,7 @@ KernelWakesParser::Parse(const int in, const int out) const
     string line;
     header_t header;  // the header of /d/wakeup_sources
     record_t record;  // retain each record
+    vector<Table::Field> fields;  // the table field of each header column
     int nline = 0;
 
     ProtoOutputStream proto;
@@ -43,11 +44,12 @@ KernelWakesParser::Parse(const int in, const int out) const
         // parse head line
         if (nline++ == 0) {
             header = parseHeader(line, TAB_DELIMITER);
+            table.resolveFields(header, &fields);
             continue;
         }
 
         // parse for each record, the line delimiter is \t only!
-        record = parseRecord(line, TAB_DELIMITER);
+        parseRecord(line, &record, TAB_DELIMITER);
 
         if (record.size() < header.size()) {
             // TODO: log this to incident report!
@@ -61,7 +63,7 @@ KernelWakesParser::Parse(const int in, const int out) const
 
         uint64_t token = proto.start(KernelWakeSourcesProto::WAKEUP_SOURCES);
         for (int i=0; i<(int)record.size(); i++) {
-            if (!table.insertField(&proto, header[i], record[i])) {
+            if (!table.insertField(&proto, fields[i], record[i])) {
                 fprintf(stderr, "[%s]Line %d has bad value %s of %s\n",
                         this->name.string(), nline, header[i].c_str(), record[i].c_str());
             }
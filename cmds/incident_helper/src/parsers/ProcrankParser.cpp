@@ -30,6 +30,7 @@ ProcrankParser::Parse(const int in, const int out) const
     string line;
     header_t header;  // the header of /d/wakeup_sources
     record_t record;  // retain each record
+    vector<Table::Field> fields;  // the table field of each header column
     int nline = 0;
 
     ProtoOutputStream proto;
@@ -43,6 +44,7 @@ ProcrankParser::Parse(const int in, const int out) const
         // parse head line
         if (nline++ == 0) {
             header = parseHeader(line);
+            table.resolveFields(header, &fields);
             continue;
         }
 
@@ -55,7 +57,7 @@ ProcrankParser::Parse(const int in, const int out) const
             continue;
         }
 
-        record = parseRecord(line);
+        parseRecord(line, &record);
         if (record.size() != header.size()) {
             if (record[record.size() - 1] == "TOTAL") { // TOTAL record
                 total = line;
@@ -68,7 +70,7 @@ ProcrankParser::Parse(const int in, const int out) const
 
         uint64_t token = proto.start(ProcrankProto::PROCESSES);
         for (int i=0; i<(int)record.size(); i++) {
-            if (!table.insertField(&proto, header[i], record[i])) {
+            if (!table.insertField(&proto, fields[i], record[i])) {
                 fprintf(stderr, "[%s]Line %d has bad value %s of %s\n",
                         this->name.string(), nline, header[i].c_str(), record[i].c_str());
             }
@@ -21,6 +21,7 @@
 #include <gtest/gtest.h>
 #include <string>
 
+using namespace android;
 using namespace android::base;
 using namespace std;
 using ::testing::StrEq;
@@ -99,6 +100,74 @@ TEST(IhUtilTest, ParseRecordByColumns) {
     EXPECT_EQ(expected, result);
 }
 
+TEST(IhUtilTest, ParseRecordReusesRecord) {
+    record_t result, expected;
+    parseRecord("a bb ccc dddd", &result);
+    expected = { "a", "bb", "ccc", "dddd" };
+    EXPECT_EQ(expected, result);
+
+    // Fewer words than last time, the rest of the record is dropped.
+    parseRecord(" x \t y ", &result);
+    expected = { "x", "y" };
+    EXPECT_EQ(expected, result);
+
+    parseRecord(" \t ", &result);
+    expected = {};
+    EXPECT_EQ(expected, result);
+}
+
+TEST(IhUtilTest, ParseRecordByColumnsReusesRecord) {
+    record_t result, expected;
+    std::vector<int> indices = { 3, 10 };
+
+    parseRecordByColumns("abc \t23456789 bob", indices, &result);
+    expected = { "abc", "23456789 bob" };
+    EXPECT_EQ(expected, result);
+
+    parseRecordByColumns("abcdefgt\t     bob", indices, &result);
+    expected = { "abcdefgt", "bob" };
+    EXPECT_EQ(expected, result);
+
+    parseRecordByColumns("12345", indices, &result);
+    expected = {};
+    EXPECT_EQ(expected, result);
+}
+
+static std::string protoBytes(ProtoOutputStream* proto) {
+    std::string bytes;
+    sp<ProtoReader> reader = proto->data();
+    while (reader->hasNext()) {
+        bytes.push_back(reader->next());
+    }
+    return bytes;
+}
+
+TEST(IhUtilTest, TableResolveFields) {
+    const char* names[] = { "pid", "s" };
+    const uint64_t ids[] = { FIELD_TYPE_INT32 | FIELD_COUNT_SINGLE | 1,
+                             FIELD_TYPE_ENUM | FIELD_COUNT_SINGLE | 2 };
+    Table table(names, ids, 2);
+    const char* sNames[] = { "R", "S" };
+    const int sValues[] = { 1, 2 };
+    table.addEnumTypeMap("s", sNames, sValues, 2);
+
+    std::vector<Table::Field> fields;
+    table.resolveFields({ "pid", "unknown", "s" }, &fields);
+    ASSERT_EQ(3u, fields.size());
+    EXPECT_EQ(ids[0], fields[0].id);
+    EXPECT_EQ(0u, fields[1].id);
+    EXPECT_EQ(ids[1], fields[2].id);
+
+    ProtoOutputStream byName, byField;
+    EXPECT_TRUE(table.insertField(&byName, "pid", "42"));
+    EXPECT_TRUE(table.insertField(&byName, "s", "S"));
+    EXPECT_TRUE(table.insertField(&byField, fields[0], "42"));
+    EXPECT_FALSE(table.insertField(&byField, fields[1], "42"));
+    EXPECT_TRUE(table.insertField(&byField, fields[2], "S"));
+    EXPECT_EQ(std::string("\x08\x2a\x10\x02", 4), protoBytes(&byField));
+    EXPECT_EQ(protoBytes(&byName), protoBytes(&byField));
+}
+
 TEST(IhUtilTest, stripPrefix) {
     string data1 = "Swap: abc ";
     EXPECT_TRUE(stripPrefix(&data1, "Swap:"));
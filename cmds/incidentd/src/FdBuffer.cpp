@@ -157,6 +157,11 @@ status_t FdBuffer::readProcessedDataInStream(int fd, unique_fd toFd, unique_fd f
     fcntl(toFd.get(), F_SETFL, fcntl(toFd.get(), F_GETFL, 0) | O_NONBLOCK);
     fcntl(fromFd.get(), F_SETFL, fcntl(fromFd.get(), F_GETFL, 0) | O_NONBLOCK);
 
+    // Data is moved from fd to the parsing process with splice(), so that it never passes through
+    // user space. If fd doesn't support splicing, fall back to copying through the circular
+    // buffer below. sysfs files are always copied, since they don't behave like regular files.
+    bool useSplice = !isSysfs;
+
     // A circular buffer holds data read from fd and writes to parsing process
     uint8_t cirBuf[BUFFER_SIZE];
     size_t cirSize = 0;
@@ -204,8 +209,26 @@ status_t FdBuffer::readProcessedDataInStream(int fd, unique_fd toFd, unique_fd f
             }
         }
 
+        // move data from fd to parsing process without copying it
+        if (useSplice && pfds[0].fd != -1 && pfds[1].fd != -1) {
+            ssize_t amt = TEMP_FAILURE_RETRY(splice(fd, NULL, toFd.get(), NULL, BUFFER_SIZE,
+                                                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK));
+            if (amt < 0) {
+                if (errno == EINVAL || errno == ENOSYS) {
+                    VLOG("fd %d can't be spliced, copying instead", fd);
+                    useSplice = false;
+                } else if (!(errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    VLOG("Fail to splice fd %d: %s", fd, strerror(errno));
+                    return -errno;
+                }  // otherwise just continue
+            } else if (amt == 0) {
+                VLOG("Reached EOF of input file %d", fd);
+                pfds[0].fd = -1;  // reach EOF so don't have to poll pfds[0].
+            }
+        }
+
         // read from fd
-        if (cirSize != BUFFER_SIZE && pfds[0].fd != -1) {
+        if (!useSplice && cirSize != BUFFER_SIZE && pfds[0].fd != -1) {
             ssize_t amt;
             if (rpos >= wpos) {
                 amt = TEMP_FAILURE_RETRY(::read(fd, cirBuf + rpos, BUFFER_SIZE - rpos));
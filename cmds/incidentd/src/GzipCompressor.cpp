@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define DEBUG false
+#include "Log.h"
+
+#include "GzipCompressor.h"
+
+#include <android-base/file.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+using android::base::WriteFully;
+
+// Size of the independently deflated blocks. Large enough that losing the dictionary at
+// each block boundary costs little compression, small enough to spread a section over
+// several threads.
+static const size_t BLOCK_SIZE = 128 * 1024;
+
+// incidentd runs while the device may already be struggling, so keep this small.
+static const size_t MAX_GZIP_THREADS = 4;
+
+// Magic, CM_DEFLATE, no flags, no mtime, no extra flags, OS_UNIX.
+static const uint8_t GZIP_HEADER[] = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
+
+// Input is compressed a block for every thread at a time, so each batch keeps them all busy.
+static const size_t BATCH_SIZE = BLOCK_SIZE * MAX_GZIP_THREADS;
+
+// A sync flush leaves 5 bytes of empty stored block past what deflateBound() accounts for.
+static const size_t SYNC_FLUSH_SLACK = 16;
+
+struct DeflateBlock {
+    const uint8_t* data;
+    size_t size;
+    // Whether this is the end of the stream, rather than ending on a sync flush.
+    bool finish;
+
+    uint32_t crc;
+    std::vector<uint8_t> output;
+    status_t err;
+};
+
+static void deflate_block(DeflateBlock* block) {
+    block->crc = crc32(0L, block->data, block->size);
+
+    z_stream zs = {};
+    // Negative window bits for raw deflate; the gzip wrapper is written once for all blocks.
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        block->err = NO_MEMORY;
+        return;
+    }
+    block->output.resize(deflateBound(&zs, block->size) + SYNC_FLUSH_SLACK);
+    zs.next_in = const_cast<Bytef*>(block->data);
+    zs.avail_in = block->size;
+    zs.next_out = block->output.data();
+    zs.avail_out = block->output.size();
+
+    int ret = deflate(&zs, block->finish ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = block->finish ? ret == Z_STREAM_END
+                            : ret == Z_OK && zs.avail_in == 0 && zs.avail_out > 0;
+    block->output.resize(zs.total_out);
+    deflateEnd(&zs);
+    block->err = ok ? NO_ERROR : UNKNOWN_ERROR;
+}
+
+static void write_le32(uint32_t val, std::vector<uint8_t>* out) {
+    for (int i = 0; i < 4; i++) {
+        out->push_back((val >> (8 * i)) & 0xff);
+    }
+}
+
+// ================================================================================
+GzipCompressor::GzipCompressor() : mCrc(crc32(0L, Z_NULL, 0)), mInputSize(0),
+                                   mHeaderWritten(false) {}
+
+GzipCompressor::~GzipCompressor() {}
+
+status_t GzipCompressor::compress(const uint8_t* data, size_t size, bool last,
+                                  std::vector<uint8_t>* out) {
+    if (!mHeaderWritten) {
+        out->insert(out->end(), std::begin(GZIP_HEADER), std::end(GZIP_HEADER));
+        mHeaderWritten = true;
+    }
+
+    size_t blockCount = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (blockCount == 0 && last) {
+        // The stream still has to end with a final deflate block, even an empty one.
+        blockCount = 1;
+    }
+    std::vector<DeflateBlock> blocks(blockCount);
+    for (size_t i = 0; i < blockCount; i++) {
+        DeflateBlock& block = blocks[i];
+        block.data = data + i * BLOCK_SIZE;
+        block.size = std::min(BLOCK_SIZE, size - i * BLOCK_SIZE);
+        block.finish = last && i == blockCount - 1;
+        block.err = NO_ERROR;
+    }
+
+    size_t threadCount = std::min(blockCount, MAX_GZIP_THREADS);
+    if (threadCount <= 1) {
+        for (DeflateBlock& block : blocks) {
+            deflate_block(&block);
+        }
+    } else {
+        std::atomic<size_t> next(0);
+        auto worker = [&blocks, &next, blockCount]() {
+            for (size_t i = next++; i < blockCount; i = next++) {
+                deflate_block(&blocks[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    for (const DeflateBlock& block : blocks) {
+        if (block.err != NO_ERROR) {
+            ALOGW("GzipCompressor failed to deflate a block of %zu bytes", block.size);
+            return block.err;
+        }
+        out->insert(out->end(), block.output.begin(), block.output.end());
+        mCrc = crc32_combine(mCrc, block.crc, block.size);
+        mInputSize += block.size;
+    }
+
+    if (last) {
+        write_le32(mCrc, out);
+        write_le32((uint32_t)mInputSize, out);  // ISIZE is the input size modulo 2^32.
+    }
+    return NO_ERROR;
+}
+
+status_t GzipCompressor::compressStream(int inFd, int outFd, const std::atomic<bool>* abort) {
+    std::vector<uint8_t> input(BATCH_SIZE);
+    std::vector<uint8_t> output;
+    bool eof = false;
+    while (!eof) {
+        if (abort != nullptr && *abort) {
+            return TIMED_OUT;
+        }
+        size_t filled = 0;
+        while (filled < input.size()) {
+            ssize_t amt = TEMP_FAILURE_RETRY(
+                    ::read(inFd, input.data() + filled, input.size() - filled));
+            if (amt < 0) {
+                return -errno;
+            }
+            if (amt == 0) {
+                eof = true;
+                break;
+            }
+            filled += amt;
+        }
+
+        output.clear();
+        status_t err = compress(input.data(), filled, eof, &output);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (!WriteFully(outFd, output.data(), output.size())) {
+            return -errno;
+        }
+    }
+    return NO_ERROR;
+}
+
+// ================================================================================
+GzipThread::GzipThread() : mPipe(), mThread(), mState(std::make_shared<State>()) {}
+
+GzipThread::~GzipThread() { finish(); }
+
+status_t GzipThread::start(int outFd) {
+    unique_fd out(outFd);
+    if (!mPipe.init()) {
+        return -errno;
+    }
+    unique_fd in(mPipe.readFd().release());
+    // The thread owns both fds, so the output is closed as soon as the stream is complete
+    // and writers see EPIPE if compression fails, as they would if gzip had died.
+    mThread = std::thread([state = mState, in = std::move(in), out = std::move(out)]() mutable {
+        GzipCompressor compressor;
+        status_t status = compressor.compressStream(in.get(), out.get(), &state->abort);
+        VLOG("GzipThread finished: %s", strerror(-status));
+        in.reset();
+        out.reset();
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            state->status = status;
+            state->done = true;
+        }
+        state->cv.notify_all();
+    });
+    return NO_ERROR;
+}
+
+bool GzipThread::running() {
+    if (!started()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mState->lock);
+    return !mState->done;
+}
+
+status_t GzipThread::finish(int64_t timeoutMs) {
+    if (!started()) {
+        return NO_ERROR;
+    }
+    mPipe.writeFd().reset();
+    std::unique_lock<std::mutex> lock(mState->lock);
+    if (!mState->cv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                             [this] { return mState->done; })) {
+        ALOGW("GzipThread did not finish within %lld ms", (long long)timeoutMs);
+        mState->abort = true;
+        lock.unlock();
+        mThread.detach();
+        return TIMED_OUT;
+    }
+    lock.unlock();
+    mThread.join();
+    return mState->status;
+}
+
+}  // namespace incidentd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "incidentd_util.h"
+
+#include <utils/Errors.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+namespace android {
+namespace os {
+namespace incidentd {
+
+/**
+ * Compresses data to gzip in-process, instead of piping it through /system/bin/gzip.
+ *
+ * Input is cut into fixed-size blocks that are deflated independently on a few worker
+ * threads and concatenated in order, the same way pigz does it, so the result is a single
+ * ordinary gzip member that any gunzip can read. Not thread safe; use one per stream.
+ */
+class GzipCompressor {
+public:
+    GzipCompressor();
+    ~GzipCompressor();
+
+    /**
+     * Compress size bytes of data and append the result to out. The first call also writes
+     * the gzip header. The call with last set writes the trailer, after which the compressor
+     * must not be used again.
+     */
+    status_t compress(const uint8_t* data, size_t size, bool last, std::vector<uint8_t>* out);
+
+    /**
+     * Compress everything read from inFd until EOF, and write it to outFd as one gzip stream.
+     * Only one batch of input and its output are held at a time. Stops with TIMED_OUT if abort
+     * is set.
+     */
+    status_t compressStream(int inFd, int outFd, const std::atomic<bool>* abort = nullptr);
+
+private:
+    // CRC32 of all the input so far.
+    uint32_t mCrc;
+
+    // Number of input bytes so far.
+    uint64_t mInputSize;
+
+    bool mHeaderWritten;
+};
+
+/**
+ * Runs a GzipCompressor on a background thread, compressing everything written to writeFd()
+ * into the fd given to start(). Used for report bodies and sections that are written
+ * incrementally.
+ */
+class GzipThread {
+public:
+    GzipThread();
+    ~GzipThread();
+
+    /**
+     * Start compressing into outFd. Takes ownership of outFd, even on failure.
+     */
+    status_t start(int outFd);
+
+    /**
+     * Whether start() succeeded. Once started, data goes to writeFd() only.
+     */
+    bool started() const { return mThread.joinable(); }
+
+    /**
+     * Whether the compressor is still accepting input.
+     */
+    bool running();
+
+    /**
+     * The write end of the pipe into the compressor, or -1 when not started.
+     */
+    int writeFd() { return mPipe.writeFd().get(); }
+
+    /**
+     * Hands the write end of the pipe into the compressor over to the caller, who closes it
+     * once all the input is written.
+     */
+    unique_fd releaseWriteFd() { return unique_fd(mPipe.writeFd().release()); }
+
+    /**
+     * Close the input and wait up to timeoutMs for the compressor to write out the rest of the
+     * data, and return how it went. On timeout the compressor is told to stop and left to finish
+     * on its own, and TIMED_OUT is returned. Does nothing if not started.
+     */
+    status_t finish(int64_t timeoutMs = 10 * 1000);
+
+private:
+    // Shared with the compressor thread, which may outlive this object after a timeout.
+    struct State {
+        std::mutex lock;
+        std::condition_variable cv;
+        bool done = false;
+        status_t status = NO_ERROR;
+        std::atomic<bool> abort{false};
+    };
+
+    Fpipe mPipe;
+    std::thread mThread;
+    std::shared_ptr<State> mState;
+};
+
+}  // namespace incidentd
+}  // namespace os
+}  // namespace android
@@ -21,6 +21,8 @@
 #include "proto_util.h"
 #include "Section.h"
 
+#include <algorithm>
+
 #include <android-base/file.h>
 #include <android/util/protobuf.h>
 #include <android/util/ProtoFileReader.h>
@@ -120,17 +122,48 @@ status_t strip_field(ProtoOutputStream* out, const sp<ProtoReader>& in,
     return NO_ERROR;
 }
 
+/**
+ * Strip the next size bytes of in, which must hold a sequence of complete protobuf fields,
+ * writing the fields permitted by spec to out. On success the iterator points just past
+ * those size bytes; BAD_VALUE means the data ran over or ended short of that boundary.
+ */
+status_t strip_fields(ProtoOutputStream* out, const sp<ProtoReader>& in, size_t size,
+        const Privacy* restrictions, const PrivacySpec& spec) {
+    size_t start = in->bytesRead();
+    while (in->bytesRead() - start < size) {
+        status_t err = strip_field(out, in, restrictions, spec, 0);
+        if (err != NO_ERROR) {
+            return err; // Error logged in strip_field.
+        }
+    }
+    if (in->bytesRead() - start != size) {
+        ALOGW("Buffer corrupted: expect %zu bytes, read %zu bytes", size,
+                in->bytesRead() - start);
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
+/**
+ * Whether stripping to spec would keep every field, so the data can be passed through as is.
+ */
+static bool strip_is_noop(const Privacy* restrictions, const PrivacySpec& spec) {
+    return restrictions == NULL || spec.RequireAll();
+}
+
 // ================================================================================
 class FieldStripper {
 public:
-    FieldStripper(const Privacy* restrictions, const sp<ProtoReader>& data,
+    FieldStripper(const Privacy* restrictions, const sp<EncodedBuffer>& data,
             uint8_t bufferLevel);
 
     ~FieldStripper();
 
     /**
      * Take the data that we have, and filter it down so that no fields
-     * are more sensitive than the given privacy policy.
+     * are more sensitive than the given privacy policy. Each call filters
+     * the output of the previous one, so callers should go from the least
+     * to the most restrictive policy.
      */
     status_t strip(uint8_t privacyPolicy);
 
@@ -141,6 +174,7 @@ public:
 
     /**
      * Write the data from the current filter level to the file descriptor.
+     * May be called any number of times per level.
      */
     status_t writeData(int fd);
 
@@ -151,12 +185,18 @@ private:
     const Privacy* mRestrictions;
 
     /**
-     * The current buffer.
+     * The unfiltered section data. Owned by the caller's FdBuffer, so it is
+     * never cleared or returned to the pool.
      */
-    sp<ProtoReader> mData;
+    sp<EncodedBuffer> mOriginal;
 
     /**
-     * The current size of the buffer inside mData.
+     * The data at the current filter level. Either mOriginal or a pool buffer.
+     */
+    sp<EncodedBuffer> mData;
+
+    /**
+     * The current size of the data inside mData.
      */
     ssize_t mSize;
 
@@ -166,24 +206,30 @@ private:
      */
     uint8_t mCurrentLevel;
 
-    sp<EncodedBuffer> mEncodedBuffer;
+    /**
+     * The pool buffer that held the previous filter level, reused as the
+     * destination of the next strip. At most two pool buffers are live.
+     */
+    sp<EncodedBuffer> mSpare;
 };
 
-FieldStripper::FieldStripper(const Privacy* restrictions, const sp<ProtoReader>& data,
+FieldStripper::FieldStripper(const Privacy* restrictions, const sp<EncodedBuffer>& data,
             uint8_t bufferLevel)
         :mRestrictions(restrictions),
+         mOriginal(data),
          mData(data),
          mSize(data->size()),
          mCurrentLevel(bufferLevel),
-         mEncodedBuffer(get_buffer_from_pool()) {
-    if (mSize < 0) {
-        ALOGW("FieldStripper constructed with a ProtoReader that doesn't support size."
-                " Data will be missing.");
-    }
+         mSpare() {
 }
 
 FieldStripper::~FieldStripper() {
-    return_buffer_to_pool(mEncodedBuffer);
+    if (mData != mOriginal) {
+        return_buffer_to_pool(mData);
+    }
+    if (mSpare != nullptr) {
+        return_buffer_to_pool(mSpare);
+    }
 }
 
 status_t FieldStripper::strip(const uint8_t privacyPolicy) {
@@ -191,32 +237,28 @@ status_t FieldStripper::strip(const uint8_t privacyPolicy) {
     // buffer, then we can skip it.
     if (mCurrentLevel < privacyPolicy) {
         PrivacySpec spec(privacyPolicy);
-        mEncodedBuffer->clear();
-        ProtoOutputStream proto(mEncodedBuffer);
 
         // Optimization when no strip happens.
-        if (mRestrictions == NULL || spec.RequireAll()) {
-            if (spec.CheckPremission(mRestrictions)) {
-                mSize = mData->size();
-            }
+        if (strip_is_noop(mRestrictions, spec)) {
             return NO_ERROR;
         }
 
-        while (mData->hasNext()) {
-            status_t err = strip_field(&proto, mData, mRestrictions, spec, 0);
-            if (err != NO_ERROR) {
-                return err; // Error logged in strip_field.
-            }
-        }
+        sp<EncodedBuffer> stripped = mSpare != nullptr ? mSpare : get_buffer_from_pool();
+        mSpare = nullptr;
+        stripped->clear();
+        ProtoOutputStream proto(stripped);
 
-        if (mData->bytesRead() != mData->size()) {
-            ALOGW("Buffer corrupted: expect %zu bytes, read %zu bytes", mData->size(),
-                    mData->bytesRead());
-            return BAD_VALUE;
+        status_t err = strip_fields(&proto, mData->read(), mSize, mRestrictions, spec);
+        if (err != NO_ERROR) {
+            return_buffer_to_pool(stripped);
+            return err;
         }
 
-        mData = proto.data();
         mSize = proto.size();
+        if (mData != mOriginal) {
+            mSpare = mData;
+        }
+        mData = stripped;
         mCurrentLevel = privacyPolicy;
     }
     return NO_ERROR;
@@ -224,12 +266,8 @@ status_t FieldStripper::strip(const uint8_t privacyPolicy) {
 
 status_t FieldStripper::writeData(int fd) {
     status_t err = NO_ERROR;
-    sp<ProtoReader> reader = mData;
-    if (mData == nullptr) {
-        // There had been an error processing the data. We won't write anything,
-        // but we also won't return an error, because errors are fatal.
-        return NO_ERROR;
-    }
+    // A fresh reader per call, so every output at this level gets the whole buffer.
+    sp<ProtoReader> reader = mData->read();
     while (reader->readBuffer() != NULL) {
         err = WriteFully(fd, reader->readBuffer(), reader->currentToRead()) ? NO_ERROR : -errno;
         reader->move(reader->currentToRead());
@@ -270,15 +308,15 @@ status_t PrivacyFilter::writeData(const FdBuffer& buffer, uint8_t bufferLevel,
         *maxSize = 0;
     }
 
-    // Order the writes by privacy filter, with increasing levels of filtration,k
-    // so we can do the filter once, and then write many times.
+    // Order the writes by privacy filter, with increasing levels of filtration,
+    // so we filter once per distinct level, and then write to every output at that level.
     sort(mOutputs.begin(), mOutputs.end(),
         [](const sp<FilterFd>& a, const sp<FilterFd>& b) -> bool {
             return a->getPrivacyPolicy() < b->getPrivacyPolicy();
         });
 
     uint8_t privacyPolicy = PRIVACY_POLICY_LOCAL; // a.k.a. no filtering
-    FieldStripper fieldStripper(mRestrictions, buffer.data()->read(), bufferLevel);
+    FieldStripper fieldStripper(mRestrictions, buffer.data(), bufferLevel);
     for (const sp<FilterFd>& output: mOutputs) {
         // Do another level of filtering if necessary
         if (privacyPolicy != output->getPrivacyPolicy()) {
@@ -318,31 +356,79 @@ status_t PrivacyFilter::writeData(const FdBuffer& buffer, uint8_t bufferLevel,
 }
 
 // ================================================================================
-class ReadbackFilterFd : public FilterFd {
-public:
-    ReadbackFilterFd(uint8_t privacyPolicy, int fd);
-
-    virtual void onWriteError(status_t err);
-    status_t getError() { return mError; }
+/**
+ * Filter the next sectionSize bytes of reader, the body of section sectionId, to privacyPolicy
+ * and write it to the fd with its section header. Bad section data drops just that section.
+ */
+static status_t filter_section_from_reader(int to, const sp<ProtoReader>& reader,
+        uint32_t sectionId, size_t sectionSize, uint8_t bufferLevel, uint8_t privacyPolicy) {
+    status_t err;
+    const Privacy* restrictions = get_privacy_of_section(sectionId);
+    PrivacySpec spec(privacyPolicy);
 
-private:
-    status_t mError;
-};
+    // Nothing to strip: the section can be copied through untouched.
+    if (bufferLevel >= privacyPolicy || strip_is_noop(restrictions, spec)) {
+        if (sectionSize == 0) {
+            return NO_ERROR;
+        }
+        err = write_section_header(to, sectionId, sectionSize);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        size_t remaining = sectionSize;
+        while (remaining > 0 && reader->readBuffer() != NULL) {
+            size_t chunk = std::min(remaining, reader->currentToRead());
+            if (!WriteFully(to, reader->readBuffer(), chunk)) {
+                return -errno;
+            }
+            reader->move(chunk);
+            remaining -= chunk;
+        }
+        // A short section ends the report; the caller checks the reader for errors.
+        return NO_ERROR;
+    }
 
-ReadbackFilterFd::ReadbackFilterFd(uint8_t privacyPolicy, int fd)
-        :FilterFd(privacyPolicy, fd),
-         mError(NO_ERROR) {
-}
+    sp<EncodedBuffer> stripped = get_buffer_from_pool();
+    ProtoOutputStream proto(stripped);
+    size_t start = reader->bytesRead();
+    err = strip_fields(&proto, reader, sectionSize, restrictions, spec);
+    if (err != NO_ERROR) {
+        return_buffer_to_pool(stripped);
+        // Skip what's left of the section. If the corrupted data ran past the
+        // end of the section we can't resynchronize with the rest of the report.
+        size_t consumed = reader->bytesRead() - start;
+        if (consumed > sectionSize) {
+            return err;
+        }
+        reader->move(sectionSize - consumed);
+        return NO_ERROR;
+    }
 
-void ReadbackFilterFd::onWriteError(status_t err) {
-    mError = err;
+    size_t dataSize = proto.size();
+    if (dataSize > 0) {
+        err = write_section_header(to, sectionId, dataSize);
+        if (err == NO_ERROR) {
+            err = proto.flush(to) ? NO_ERROR : -errno;
+        }
+    }
+    return_buffer_to_pool(stripped);
+    return err;
 }
 
-// ================================================================================
 status_t filter_and_write_report(int to, int from, uint8_t bufferLevel,
         const IncidentReportArgs& args) {
     status_t err;
-    sp<ProtoFileReader> reader = new ProtoFileReader(from);
+    // Map the report if we can, so skipped sections cost nothing and fields are parsed
+    // straight out of the page cache. Fall back to reading it through a buffer.
+    sp<ProtoMappedFileReader> mapped = new ProtoMappedFileReader(from);
+    sp<ProtoFileReader> streamed;
+    sp<ProtoReader> reader = mapped;
+    if (mapped->getError() != NO_ERROR) {
+        VLOG("filter_and_write_report can't map the report: %s", strerror(-mapped->getError()));
+        mapped = NULL;
+        streamed = new ProtoFileReader(from);
+        reader = streamed;
+    }
 
     while (reader->hasNext()) {
         uint64_t fieldTag = reader->readRawVarint();
@@ -351,33 +437,26 @@ status_t filter_and_write_report(int to, int from, uint8_t bufferLevel,
         if (wireType == WIRE_TYPE_LENGTH_DELIMITED
                 && args.containsSection(fieldId, section_requires_specific_mention(fieldId))) {
             // We need this field, but we need to strip it to the level provided in args.
-            PrivacyFilter filter(fieldId, get_privacy_of_section(fieldId));
-            filter.addFd(new ReadbackFilterFd(args.getPrivacyPolicy(), to));
-
-            // Read this section from the reader into an FdBuffer
+            // Filter it straight off the reader rather than copying it into an FdBuffer first.
             size_t sectionSize = reader->readRawVarint();
-            FdBuffer sectionData;
-            err = sectionData.write(reader, sectionSize);
+            err = filter_section_from_reader(to, reader, fieldId, sectionSize, bufferLevel,
+                    args.getPrivacyPolicy());
             if (err != NO_ERROR) {
-                ALOGW("filter_and_write_report FdBuffer.write failed (this shouldn't happen): %s",
+                ALOGW("filter_and_write_report filter_section_from_reader had an error: %s",
                         strerror(-err));
                 return err;
             }
-
-            // Do the filter and write.
-            err = filter.writeData(sectionData, bufferLevel, nullptr);
-            if (err != NO_ERROR) {
-                ALOGW("filter_and_write_report filter.writeData had an error: %s", strerror(-err));
-                return err;
-            }
-        } else {
+        } else if (!reader->skipField(fieldTag)) {
             // We don't need this field.  Incident does not have any direct children
-            // other than sections.  So just skip them.
-            write_field_or_skip(NULL, reader, fieldTag, true);
+            // other than sections.  So just skip them, unless there's no telling how.
+            ALOGW("filter_and_write_report can't skip field %d of wire type %d", fieldId,
+                    wireType);
+            clear_buffer_pool();
+            return BAD_VALUE;
         }
     }
     clear_buffer_pool();
-    err = reader->getError();
+    err = mapped != NULL ? mapped->getError() : streamed->getError();
     if (err != NO_ERROR) {
         ALOGW("filter_and_write_report reader had an error: %s", strerror(-err));
         return err;
@@ -38,7 +38,9 @@
 #include <sys/prctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <memory>
 #include <string>
+#include <thread>
 #include <time.h>
 #include <wait.h>
 
@@ -53,8 +55,14 @@ using namespace android::util;
  *      frameworks/base/core/proto/android/os/incident.proto
  */
 const int FIELD_ID_METADATA = 2;
-// Args for exec gzip
-static const char* GZIP[] = {"/system/bin/gzip", NULL};
+
+// How many sections run at once, in total and for each SectionClass.
+const int MAX_CONCURRENT_SECTIONS = 4;
+const int MAX_CONCURRENT_SECTIONS_BY_CLASS[SECTION_CLASS_COUNT] = {
+    MAX_CONCURRENT_SECTIONS,  // SECTION_CLASS_DEFAULT
+    2,                        // SECTION_CLASS_DUMPSYS
+    1,                        // SECTION_CLASS_EXCLUSIVE
+};
 
 IncidentMetadata_Destination privacy_policy_to_dest(uint8_t privacyPolicy) {
     switch (privacyPolicy) {
@@ -147,7 +155,7 @@ ReportRequest::ReportRequest(const IncidentReportArgs& a,
          mFd(fd),
          mIsStreaming(fd >= 0),
          mStatus(OK),
-         mZipPid(-1) {
+         mZip() {
 }
 
 ReportRequest::~ReportRequest() {
@@ -164,8 +172,7 @@ bool ReportRequest::ok() {
     if (!args.gzip()) {
         return mFd >= 0;
     }
-    // Send a blank signal to check if mZipPid is alive
-    return mZipPid > 0 && kill(mZipPid, 0) == 0;
+    return mZip.running();
 }
 
 bool ReportRequest::containsSection(int sectionId) const {
@@ -180,37 +187,30 @@ void ReportRequest::closeFd() {
         close(mFd);
         mFd = -1;
     }
-    if (mZipPid > 0) {
-        mZipPipe.close();
-        // Gzip may take some time.
-        status_t err = wait_child(mZipPid, /* timeout_ms= */ 10 * 1000);
-        if (err != 0) {
-            ALOGW("[ReportRequest] abnormal child process: %s", strerror(-err));
+    if (mZip.started()) {
+        status_t err = mZip.finish();
+        if (err != NO_ERROR) {
+            ALOGW("[ReportRequest] gzip failed: %s", strerror(-err));
         }
     }
 }
 
 int ReportRequest::getFd() {
-    return mZipPid > 0 ? mZipPipe.writeFd().get() : mFd;
+    return mZip.started() ? mZip.writeFd() : mFd;
 }
 
 status_t ReportRequest::initGzipIfNecessary() {
     if (!mIsStreaming || !args.gzip()) {
         return OK;
     }
-    if (!mZipPipe.init()) {
-        ALOGE("[ReportRequest] Failed to setup pipe for gzip");
-        mStatus = -errno;
-        return mStatus;
-    }
-    int status = 0;
-    pid_t pid = fork_execute_cmd((char* const*)GZIP, mZipPipe.readFd().release(), mFd, &status);
-    if (pid < 0 || status != 0) {
-        mStatus = status;
+    // The compressor takes over mFd whether or not it starts.
+    status_t err = mZip.start(mFd);
+    mFd = -1;
+    if (err != NO_ERROR) {
+        ALOGE("[ReportRequest] Failed to start gzip: %s", strerror(-err));
+        mStatus = err;
         return mStatus;
     }
-    mZipPid = pid;
-    mFd = -1;
     return OK;
 }
 
@@ -385,7 +385,8 @@ void ReportBatch::removeRequest(const sp<ReportRequest>& request) {
 ReportWriter::ReportWriter(const sp<ReportBatch>& batch)
         :mBatch(batch),
          mPersistedFile(),
-         mMaxPersistedPrivacyPolicy(PRIVACY_POLICY_UNSET) {
+         mMaxPersistedPrivacyPolicy(PRIVACY_POLICY_UNSET),
+         mMaxSectionDataFilteredSize(0) {
 }
 
 ReportWriter::~ReportWriter() {
@@ -411,6 +412,7 @@ void ReportWriter::startSection(int sectionId) {
     mSectionBufferSuccess = false;
     mHadError = false;
     mSectionErrors.clear();
+    mMaxSectionDataFilteredSize = 0;
 }
 
 void ReportWriter::setSectionStats(const FdBuffer& buffer) {
@@ -491,8 +493,19 @@ void ReportWriter::vflog(const Section* section, status_t err, int level, const
     }
 }
 
-// Reads data from FdBuffer and writes it to the requests file descriptor.
 status_t ReportWriter::writeSection(const FdBuffer& buffer) {
+    if (mWriteHandler) {
+        return mWriteHandler(buffer);
+    }
+    return writeSectionData(buffer);
+}
+
+void ReportWriter::setWriteHandler(const function<status_t (const FdBuffer&)>& handler) {
+    mWriteHandler = handler;
+}
+
+// Reads data from FdBuffer and writes it to the requests file descriptor.
+status_t ReportWriter::writeSectionData(const FdBuffer& buffer) {
     PrivacyFilter filter(mCurrentSectionId, get_privacy_of_section(mCurrentSectionId));
 
     // Add the fd for the persisted requests
@@ -515,6 +528,38 @@ status_t ReportWriter::writeSection(const FdBuffer& buffer) {
 }
 
 
+// ================================================================================
+/**
+ * A section being run on its own thread. The state is guarded by the lock passed to
+ * Reporter::start_section.
+ */
+struct Reporter::SectionJob {
+    enum State {
+        PENDING,          // Not started yet.
+        RUNNING,          // Collecting data.
+        WRITE_REQUESTED,  // Waiting in writeSection() for its turn to write.
+        WRITTEN,          // Its data has been written, writeResult is set.
+        DONE,             // Execute() returned, result is set.
+    };
+
+    SectionJob(const Section* s, const ReportWriter& w)
+            :section(s),
+             writer(w) {
+    }
+
+    const Section* section;
+    ReportWriter writer;
+    thread worker;
+
+    State state = PENDING;
+    const FdBuffer* pendingBuffer = nullptr;
+    status_t writeResult = NO_ERROR;
+    status_t result = NO_ERROR;
+
+    // Whether the job's concurrency slot was given back. Only used by the reporting thread.
+    bool reaped = false;
+};
+
 // ================================================================================
 Reporter::Reporter(const sp<WorkDirectory>& workDirectory,
                    const sp<ReportBatch>& batch,
@@ -612,7 +657,7 @@ void Reporter::runReport(size_t* reportByteSize) {
     mBatch->forEachStreamingRequest([](const sp<ReportRequest>& request) {
         status_t err = request->initGzipIfNecessary();
         if (err != 0) {
-            ALOGW("Error forking gzip: %s", strerror(err));
+            ALOGW("Error starting gzip: %s", strerror(-err));
         }
     });
 
@@ -635,19 +680,15 @@ void Reporter::runReport(size_t* reportByteSize) {
 
     // For each of the report fields, see if we need it, and if so, execute the command
     // and report to those that care that we're doing it.
-    for (const Section** section = SECTION_LIST; *section; section++) {
-        if (execute_section(*section, &metadata, reportByteSize) != NO_ERROR) {
-            goto DONE;
+    {
+        vector<const Section*> sections;
+        for (const Section** section = SECTION_LIST; *section; section++) {
+            sections.push_back(*section);
         }
+        sections.insert(sections.end(), mRegisteredSections.begin(), mRegisteredSections.end());
+        execute_sections(sections, &metadata, reportByteSize);
     }
 
-    for (const Section* section : mRegisteredSections) {
-        if (execute_section(section, &metadata, reportByteSize) != NO_ERROR) {
-            goto DONE;
-        }
-    }
-
-DONE:
     // Finish up the persisted file.
     if (mPersistedFile != nullptr) {
         mPersistedFile->closeDataFile();
@@ -702,17 +743,98 @@ DONE:
     ALOGI("Done taking incident report err=%s", strerror(-err));
 }
 
-status_t Reporter::execute_section(const Section* section, IncidentMetadata* metadata,
-        size_t* reportByteSize) {
-    const int sectionId = section->id;
+status_t Reporter::execute_sections(const vector<const Section*>& sections,
+        IncidentMetadata* metadata, size_t* reportByteSize) {
+    // If nobody wants a section, skip it.
+    vector<unique_ptr<SectionJob>> jobs;
+    for (const Section* section : sections) {
+        if (mBatch->containsSection(section->id)) {
+            jobs.push_back(make_unique<SectionJob>(section, mWriter));
+        }
+    }
 
-    // If nobody wants this section, skip it.
-    if (!mBatch->containsSection(sectionId)) {
-        return NO_ERROR;
+    mutex lock;
+    condition_variable cond;
+    int running = 0;
+    int runningByClass[SECTION_CLASS_COUNT] = {};
+    size_t next = 0;
+    status_t err = NO_ERROR;
+
+    // Sections are started in order, so every section that is running or waiting to write
+    // comes before the next one to start, and the section being written is never starved.
+    auto startJobs = [&]() {
+        while (next < jobs.size() && running < MAX_CONCURRENT_SECTIONS) {
+            const SectionClass sectionClass = jobs[next]->section->sectionClass();
+            if (runningByClass[sectionClass] >= MAX_CONCURRENT_SECTIONS_BY_CLASS[sectionClass]) {
+                break;
+            }
+            running++;
+            runningByClass[sectionClass]++;
+            start_section(jobs[next++].get(), &lock, &cond);
+        }
+    };
+
+    // Gives back the slots of finished sections. Returns true if any slot was freed.
+    auto reapJobsLocked = [&](size_t first) {
+        bool freed = false;
+        for (size_t i = first; i < next; i++) {
+            SectionJob* job = jobs[i].get();
+            if (job->state == SectionJob::DONE && !job->reaped) {
+                job->reaped = true;
+                running--;
+                runningByClass[job->section->sectionClass()]--;
+                freed = true;
+            }
+        }
+        return freed;
+    };
+
+    // Write the sections in order, as each one becomes ready. After a fatal error, the
+    // sections that are already running are still waited for, but nothing is written.
+    for (size_t i = 0; i < next || (err == NO_ERROR && i < jobs.size()); i++) {
+        SectionJob* job = jobs[i].get();
+        while (true) {
+            if (err == NO_ERROR) {
+                startJobs();
+            }
+            unique_lock<mutex> l(lock);
+            if (reapJobsLocked(i) && err == NO_ERROR) {
+                continue;
+            }
+            if (job->state == SectionJob::WRITE_REQUESTED) {
+                const FdBuffer* buffer = job->pendingBuffer;
+                l.unlock();
+                status_t writeResult = NO_ERROR;
+                if (err == NO_ERROR) {
+                    // A persisted file that failed during an earlier section is gone by now.
+                    job->writer.setPersistedFile(mPersistedFile);
+                    writeResult = job->writer.writeSectionData(*buffer);
+                }
+                l.lock();
+                job->writeResult = writeResult;
+                job->state = SectionJob::WRITTEN;
+                cond.notify_all();
+                continue;
+            }
+            if (job->state == SectionJob::DONE) {
+                break;
+            }
+            cond.wait(l);
+        }
+
+        job->worker.join();
+        if (err == NO_ERROR) {
+            err = finish_section(job, metadata, reportByteSize);
+        }
     }
+    return err;
+}
+
+void Reporter::start_section(SectionJob* job, mutex* lock, condition_variable* cond) {
+    const Section* section = job->section;
+    const int sectionId = section->id;
 
     ALOGD("Start incident report section %d '%s'", sectionId, section->name.string());
-    IncidentMetadata::SectionStats* sectionMetadata = metadata->add_sections();
 
     // Notify listener of starting
     mBatch->forEachListener(sectionId, [sectionId](const auto& listener) {
@@ -720,14 +842,43 @@ status_t Reporter::execute_section(const Section* section, IncidentMetadata* met
                 sectionId, IIncidentReportStatusListener::STATUS_STARTING);
     });
 
+    // The data is written by the reporting thread when it is this section's turn. The section's
+    // thread waits for that, so the buffer stays valid until it has been written.
+    job->writer.setWriteHandler([job, lock, cond](const FdBuffer& buffer) {
+        unique_lock<mutex> l(*lock);
+        job->pendingBuffer = &buffer;
+        job->state = SectionJob::WRITE_REQUESTED;
+        cond->notify_all();
+        cond->wait(l, [job]() { return job->state == SectionJob::WRITTEN; });
+        job->pendingBuffer = nullptr;
+        job->state = SectionJob::RUNNING;
+        return job->writeResult;
+    });
+
     // Go get the data and write it into the file descriptors.
-    mWriter.startSection(sectionId);
-    status_t err = section->Execute(&mWriter);
-    mWriter.endSection(sectionMetadata);
+    job->writer.startSection(sectionId);
+    job->state = SectionJob::RUNNING;
+    job->worker = thread([job, lock, cond]() {
+        status_t err = job->section->Execute(&job->writer);
+        scoped_lock<mutex> l(*lock);
+        job->result = err;
+        job->state = SectionJob::DONE;
+        cond->notify_all();
+    });
+}
+
+status_t Reporter::finish_section(SectionJob* job, IncidentMetadata* metadata,
+        size_t* reportByteSize) {
+    const Section* section = job->section;
+    const int sectionId = section->id;
+
+    IncidentMetadata::SectionStats* sectionMetadata = metadata->add_sections();
+    job->writer.endSection(sectionMetadata);
 
     // Sections returning errors are fatal. Most errors should not be fatal.
+    status_t err = job->result;
     if (err != NO_ERROR) {
-        mWriter.error(section, err, "Section failed. Stopping report.");
+        job->writer.error(section, err, "Section failed. Stopping report.");
         return err;
     }
 
@@ -17,6 +17,7 @@
 
 #include "incidentd_util.h"
 #include "FdBuffer.h"
+#include "GzipCompressor.h"
 #include "WorkDirectory.h"
 
 #include "frameworks/base/core/proto/android/os/metadata.pb.h"
@@ -26,7 +27,10 @@
 #include <android/os/IncidentReportArgs.h>
 #include <android/util/protobuf.h>
 
+#include <condition_variable>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -77,8 +81,7 @@ private:
     int mFd;
     bool mIsStreaming;
     status_t mStatus;
-    pid_t mZipPid;
-    Fpipe mZipPipe;
+    GzipThread mZip;
 };
 
 // ================================================================================
@@ -207,6 +210,18 @@ public:
 
     status_t writeSection(const FdBuffer& buffer);
 
+    /**
+     * Routes writeSection() through the given function, which must call writeSectionData()
+     * once the section's data may be written. Used while sections run concurrently, so that
+     * the data still reaches the requests in section order.
+     */
+    void setWriteHandler(const function<status_t (const FdBuffer&)>& handler);
+
+    /**
+     * Filters the buffer and writes it to the requests, bypassing the write handler.
+     */
+    status_t writeSectionData(const FdBuffer& buffer);
+
 private:
     // Data about all requests
     sp<ReportBatch> mBatch;
@@ -251,6 +266,8 @@ private:
     string mSectionErrors;
     size_t mMaxSectionDataFilteredSize;
 
+    function<status_t (const FdBuffer&)> mWriteHandler;
+
     void vflog(const Section* section, status_t err, int level, const char* levelText,
         const char* format, va_list args);
 };
@@ -274,7 +291,15 @@ private:
     sp<ReportFile> mPersistedFile;
     const vector<BringYourOwnSection*>& mRegisteredSections;
 
-    status_t execute_section(const Section* section, IncidentMetadata* metadata,
+    struct SectionJob;
+
+    // Runs the requested sections, several at a time, and writes them in the given order.
+    status_t execute_sections(const vector<const Section*>& sections,
+        IncidentMetadata* metadata, size_t* reportByteSize);
+
+    void start_section(SectionJob* job, mutex* lock, condition_variable* cond);
+
+    status_t finish_section(SectionJob* job, IncidentMetadata* metadata,
         size_t* reportByteSize);
 
     void cancel_and_remove_failed_requests();
@@ -39,6 +39,7 @@
 #include <sys/mman.h>
 
 #include "FdBuffer.h"
+#include "GzipCompressor.h"
 #include "Privacy.h"
 #include "frameworks/base/core/proto/android/os/backtrace.proto.h"
 #include "frameworks/base/core/proto/android/os/data.proto.h"
@@ -58,7 +59,6 @@ const int FIELD_ID_INCIDENT_METADATA = 2;
 
 // incident section parameters
 const char INCIDENT_HELPER[] = "/system/bin/incident_helper";
-const char* GZIP[] = {"/system/bin/gzip", NULL};
 
 static pid_t fork_execute_incident_helper(const int id, Fpipe* p2cPipe, Fpipe* c2pPipe) {
     const char* ihArgs[]{INCIDENT_HELPER, "-s", String8::format("%d", id).string(), NULL};
@@ -173,31 +173,29 @@ status_t GZipSection::Execute(ReportWriter* writer) const {
         ALOGW("[%s] can't open all the files", this->name.string());
         return NO_ERROR;  // e.g. LAST_KMSG will reach here in user build.
     }
-    FdBuffer buffer;
-    Fpipe p2cPipe;
+    // Compress in-process rather than forking gzip, which is slow when the device is
+    // already in trouble. The file is streamed through the compressor, so only the
+    // compressed data is kept.
     Fpipe c2pPipe;
-    // initiate pipes to pass data to/from gzip
-    if (!p2cPipe.init() || !c2pPipe.init()) {
+    if (!c2pPipe.init()) {
         ALOGW("[%s] failed to setup pipes", this->name.string());
         return -errno;
     }
-
-    pid_t pid = fork_execute_cmd((char* const*)GZIP, &p2cPipe, &c2pPipe);
-    if (pid == -1) {
-        ALOGW("[%s] failed to fork", this->name.string());
-        return -errno;
+    GzipThread zip;
+    status_t startStatus = zip.start(c2pPipe.writeFd().release());
+    if (startStatus != NO_ERROR) {
+        ALOGW("[%s] failed to start gzip: %s", this->name.string(), strerror(-startStatus));
+        return startStatus;
     }
-    // parent process
 
     // construct Fdbuffer to output GZippedfileProto, the reason to do this instead of using
     // ProtoOutputStream is to avoid allocation of another buffer inside ProtoOutputStream.
+    FdBuffer buffer;
     sp<EncodedBuffer> internalBuffer = buffer.data();
     internalBuffer->writeHeader((uint32_t)GZippedFileProto::FILENAME, WIRE_TYPE_LENGTH_DELIMITED);
     size_t fileLen = strlen(mFilenames[index]);
     internalBuffer->writeRawVarint32(fileLen);
-    for (size_t i = 0; i < fileLen; i++) {
-        internalBuffer->writeRawByte(mFilenames[index][i]);
-    }
+    internalBuffer->writeRaw(reinterpret_cast<const uint8_t*>(mFilenames[index]), fileLen);
     internalBuffer->writeHeader((uint32_t)GZippedFileProto::GZIPPED_DATA,
                                 WIRE_TYPE_LENGTH_DELIMITED);
     size_t editPos = internalBuffer->wp()->pos();
@@ -206,21 +204,22 @@ status_t GZipSection::Execute(ReportWriter* writer) const {
     VLOG("[%s] editPos=%zu, dataBeginAt=%zu", this->name.string(), editPos, dataBeginAt);
 
     status_t readStatus = buffer.readProcessedDataInStream(
-            fd.get(), std::move(p2cPipe.writeFd()), std::move(c2pPipe.readFd()), this->timeoutMs,
+            fd.get(), zip.releaseWriteFd(), std::move(c2pPipe.readFd()), this->timeoutMs,
             isSysfs(mFilenames[index]));
     writer->setSectionStats(buffer);
     if (readStatus != NO_ERROR || buffer.timedOut()) {
-        ALOGW("[%s] failed to read data from gzip: %s, timedout: %s", this->name.string(),
+        ALOGW("[%s] failed to read data: %s, timedout: %s", this->name.string(),
               strerror(-readStatus), buffer.timedOut() ? "true" : "false");
-        kill_child(pid);
+        zip.finish();
         return readStatus;
     }
 
-    status_t gzipStatus = wait_child(pid);
+    status_t gzipStatus = zip.finish();
     if (gzipStatus != NO_ERROR) {
-        ALOGW("[%s] abnormal child process: %s", this->name.string(), strerror(-gzipStatus));
+        ALOGW("[%s] failed to gzip: %s", this->name.string(), strerror(-gzipStatus));
         return gzipStatus;
     }
+
     // Revisit the actual size from gzip result and edit the internal buffer accordingly.
     size_t dataSize = buffer.size() - dataBeginAt;
     internalBuffer->wp()->rewind()->move(editPos);
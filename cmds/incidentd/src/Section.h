@@ -35,6 +35,19 @@ namespace incidentd {
 
 const int64_t REMOTE_CALL_TIMEOUT_MS = 30 * 1000;  // 30 seconds
 
+/**
+ * Sections of the same class share a limit on how many of them the Reporter runs at once.
+ */
+enum SectionClass {
+    // Only limited by the total number of concurrent sections.
+    SECTION_CLASS_DEFAULT = 0,
+    // Sections that dump system services, so they don't all land on system_server at once.
+    SECTION_CLASS_DUMPSYS,
+    // Sections that share process global state and must never overlap.
+    SECTION_CLASS_EXCLUSIVE,
+    SECTION_CLASS_COUNT
+};
+
 /**
  * Base class for sections
  */
@@ -48,6 +61,8 @@ public:
     virtual ~Section();
 
     virtual status_t Execute(ReportWriter* writer) const = 0;
+
+    virtual SectionClass sectionClass() const { return SECTION_CLASS_DEFAULT; }
 };
 
 /**
@@ -122,6 +137,8 @@ public:
 
     virtual status_t BlockingCall(unique_fd& pipeWriteFd) const;
 
+    virtual SectionClass sectionClass() const { return SECTION_CLASS_DUMPSYS; }
+
 private:
     String16 mService;
     Vector<String16> mArgs;
@@ -137,6 +154,8 @@ public:
 
     virtual status_t Execute(ReportWriter* writer) const;
 
+    virtual SectionClass sectionClass() const { return SECTION_CLASS_DUMPSYS; }
+
 private:
     String16 mService;
     Vector<String16> mArgs;
@@ -152,6 +171,8 @@ public:
 
     virtual status_t BlockingCall(unique_fd& pipeWriteFd) const;
 
+    virtual SectionClass sectionClass() const { return SECTION_CLASS_DUMPSYS; }
+
 private:
     String16 mService;
     Vector<String16> mArgs;
@@ -173,6 +194,8 @@ public:
 
     virtual status_t BlockingCall(unique_fd& pipeWriteFd) const;
 
+    virtual SectionClass sectionClass() const { return SECTION_CLASS_EXCLUSIVE; }
+
 private:
     log_id_t mLogID;
     bool mBinary;
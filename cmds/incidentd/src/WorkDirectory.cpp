@@ -16,6 +16,7 @@
 
 #include "Log.h"
 
+#include "GzipCompressor.h"
 #include "incidentd_util.h"
 #include "proto_util.h"
 #include "PrivacyFilter.h"
@@ -30,6 +31,7 @@
 #include <thread>
 #include <vector>
 
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -68,9 +70,6 @@ const ComponentName DROPBOX_SENTINEL("android", "DROPBOX");
 /** metadata field id in IncidentProto */
 const int FIELD_ID_INCIDENT_METADATA = 2;
 
-// Args for exec gzip
-static const char* GZIP[] = {"/system/bin/gzip", NULL};
-
 /**
  * Read a protobuf from disk into the message.
  */
@@ -218,26 +217,17 @@ void log_envelope(const ReportFileProto& envelope) {
 }
 
 // ================================================================================
-struct WorkDirectoryEntry {
-    WorkDirectoryEntry();
-    explicit WorkDirectoryEntry(const WorkDirectoryEntry& that);
-    ~WorkDirectoryEntry();
-
-    string envelope;
-    string data;
-    int64_t timestampNs;
-    off_t size;
-};
-
 WorkDirectoryEntry::WorkDirectoryEntry()
         :envelope(),
          data(),
+         timestampNs(0),
          size(0) {
 }
 
 WorkDirectoryEntry::WorkDirectoryEntry(const WorkDirectoryEntry& that)
         :envelope(that.envelope),
          data(that.data),
+         timestampNs(that.timestampNs),
          size(that.size) {
 }
 
@@ -402,6 +392,8 @@ status_t ReportFile::startFilteringData(int writeFd, const IncidentReportArgs& a
         close(writeFd);
         return -errno;
     }
+    // The data file is read once front to back, so ask for aggressive readahead.
+    posix_fadvise(dataFd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
     // Check that the size on disk is what we thought we wrote.
     struct stat st;
@@ -421,22 +413,15 @@ status_t ReportFile::startFilteringData(int writeFd, const IncidentReportArgs& a
         return BAD_VALUE;
     }
 
-    pid_t zipPid = 0;
+    GzipThread zip;
     if (args.gzip()) {
-        Fpipe zipPipe;
-        if (!zipPipe.init()) {
-            ALOGE("[ReportFile] Failed to setup pipe for gzip");
-            close(writeFd);
-            return -errno;
-        }
-        int status = 0;
-        zipPid = fork_execute_cmd((char* const*)GZIP, zipPipe.readFd().release(), writeFd, &status);
-        close(writeFd);
-        if (zipPid < 0 || status != 0) {
-            ALOGE("[ReportFile] Failed to fork and exec gzip");
-            return status;
+        // The compressor takes over writeFd whether or not it starts.
+        status_t err = zip.start(writeFd);
+        if (err != NO_ERROR) {
+            ALOGE("[ReportFile] Failed to start gzip: %s", strerror(-err));
+            return err;
         }
-        writeFd = zipPipe.writeFd().release();
+        writeFd = zip.writeFd();
     }
 
     status_t err;
@@ -458,14 +443,15 @@ status_t ReportFile::startFilteringData(int writeFd, const IncidentReportArgs& a
                 strerror(-err));
     }
 
-    close(writeFd);
-    if (zipPid > 0) {
-        status_t err = wait_child(zipPid, /* timeout_ms= */ 10 * 1000);
-        if (err != 0) {
-            ALOGE("[ReportFile] abnormal child process: %s", strerror(-err));
+    if (zip.started()) {
+        // Closes the pipe, and waits for the rest of the data to be compressed.
+        status_t err = zip.finish();
+        if (err != NO_ERROR) {
+            ALOGE("[ReportFile] gzip failed: %s", strerror(-err));
         }
         return err;
     }
+    close(writeFd);
     return NO_ERROR;
 }
 
@@ -530,6 +516,8 @@ WorkDirectory::WorkDirectory()
          mMaxDiskUsageBytes(100 * 1024 * 1024) {  // Incident reports can take up to 100MB on disk.
                                                  // TODO: Should be a flag.
     create_directory(mDirectory.c_str());
+    unique_lock<mutex> lock(mLock);
+    load_index_locked();
 }
 
 WorkDirectory::WorkDirectory(const string& dir, int maxFileCount, long maxDiskUsageBytes)
@@ -537,6 +525,8 @@ WorkDirectory::WorkDirectory(const string& dir, int maxFileCount, long maxDiskUs
          mMaxFileCount(maxFileCount),
          mMaxDiskUsageBytes(maxDiskUsageBytes) {
     create_directory(mDirectory.c_str());
+    unique_lock<mutex> lock(mLock);
+    load_index_locked();
 }
 
 sp<ReportFile> WorkDirectory::createReportFile() {
@@ -557,6 +547,11 @@ sp<ReportFile> WorkDirectory::createReportFile() {
         return nullptr;
     }
 
+    WorkDirectoryEntry& entry = mIndex[timestampNs];
+    entry.envelope = envelopeFileName;
+    entry.data = dataFileName;
+    entry.timestampNs = timestampNs;
+
     return result;
 }
 
@@ -569,10 +564,8 @@ status_t WorkDirectory::getReports(vector<sp<ReportFile>>* result, int64_t after
         ALOGD("WorkDirectory::getReports");
     }
 
-    map<string,WorkDirectoryEntry> files;
-    get_directory_contents_locked(&files, after);
-    for (map<string,WorkDirectoryEntry>::iterator it = files.begin();
-            it != files.end(); it++) {
+    for (map<int64_t, WorkDirectoryEntry>::const_iterator it = mIndex.upper_bound(after);
+            it != mIndex.end(); it++) {
         sp<ReportFile> reportFile = new ReportFile(this, it->second.timestampNs,
                 it->second.envelope, it->second.data);
         if (DBG) {
@@ -592,6 +585,10 @@ sp<ReportFile> WorkDirectory::getReport(const string& pkg, const string& cls, co
     if (!parse_timestamp_ns(id, &timestampNs)) {
         return nullptr;
     }
+    if (mIndex.find(timestampNs) == mIndex.end()) {
+        ALOGW("No such report %s/%s %s", pkg.c_str(), cls.c_str(), id.c_str());
+        return nullptr;
+    }
 
     // Make the ReportFile object, and then see if it's valid and for pkg and cls.
     sp<ReportFile> result = new ReportFile(this, timestampNs,
@@ -623,9 +620,7 @@ sp<ReportFile> WorkDirectory::getReport(const string& pkg, const string& cls, co
 bool WorkDirectory::hasMore(int64_t after) {
     unique_lock<mutex> lock(mLock);
 
-    map<string,WorkDirectoryEntry> files;
-    get_directory_contents_locked(&files, after);
-    return files.size() > 0;
+    return mIndex.upper_bound(after) != mIndex.end();
 }
 
 void WorkDirectory::commit(const sp<ReportFile>& report, const string& pkg, const string& cls) {
@@ -648,10 +643,10 @@ void WorkDirectory::commitAll(const string& pkg) {
 
     unique_lock<mutex> lock(mLock);
 
-    map<string,WorkDirectoryEntry> files;
-    get_directory_contents_locked(&files, 0);
+    // Copy, since finished reports are erased from the index as we go.
+    const map<int64_t, WorkDirectoryEntry> files(mIndex);
 
-    for (map<string,WorkDirectoryEntry>::iterator it = files.begin();
+    for (map<int64_t, WorkDirectoryEntry>::const_iterator it = files.begin();
             it != files.end(); it++) {
         sp<ReportFile> reportFile = new ReportFile(this, it->second.timestampNs,
                 it->second.envelope, it->second.data);
@@ -669,11 +664,7 @@ void WorkDirectory::commitAll(const string& pkg) {
 
 void WorkDirectory::remove(const sp<ReportFile>& report) {
     unique_lock<mutex> lock(mLock);
-    // Set this to false to leave files around for debugging.
-    if (DO_UNLINK) {
-        unlink(report->getDataFileName().c_str());
-        unlink(report->getEnvelopeFileName().c_str());
-    }
+    unlink_report_locked(report);
 }
 
 int64_t WorkDirectory::make_timestamp_ns_locked() {
@@ -703,9 +694,7 @@ int64_t WorkDirectory::make_timestamp_ns_locked() {
  * our result is still correct for the caller.
  */
 bool WorkDirectory::file_exists_locked(int64_t timestampNs) {
-    const string filename = make_filename(timestampNs, EXTENSION_ENVELOPE);
-    struct stat st;
-    return stat(filename.c_str(), &st) == 0;
+    return mIndex.find(timestampNs) != mIndex.end();
 }
 
 string WorkDirectory::make_filename(int64_t timestampNs, const string& extension) {
@@ -795,19 +784,36 @@ off_t WorkDirectory::get_directory_contents_locked(map<string,WorkDirectoryEntry
     return totalSize;
 }
 
-void WorkDirectory::clean_directory_locked() {
-    DIR* dir;
-    struct dirent* entry;
-    struct stat st;
-
+void WorkDirectory::load_index_locked() {
     // Map of filename without extension to the entries about it.  Conveniently,
     // this also keeps the list sorted by filename, which is a timestamp.
     map<string,WorkDirectoryEntry> files;
-    off_t totalSize = get_directory_contents_locked(&files, 0);
-    if (totalSize < 0) {
+    mIndex.clear();
+    if (get_directory_contents_locked(&files, 0) < 0) {
         return;
     }
-    int totalCount = files.size();
+    for (map<string,WorkDirectoryEntry>::const_iterator it = files.begin();
+            it != files.end(); it++) {
+        mIndex.emplace(it->second.timestampNs, it->second);
+    }
+}
+
+void WorkDirectory::clean_directory_locked() {
+    // Refresh the sizes, since data files grow after they are indexed.
+    off_t totalSize = 0;
+    for (map<int64_t, WorkDirectoryEntry>::iterator it = mIndex.begin();
+            it != mIndex.end(); it++) {
+        struct stat st;
+        it->second.size = 0;
+        if (stat(it->second.envelope.c_str(), &st) == 0) {
+            it->second.size += st.st_size;
+        }
+        if (stat(it->second.data.c_str(), &st) == 0) {
+            it->second.size += st.st_size;
+        }
+        totalSize += it->second.size;
+    }
+    int totalCount = mIndex.size();
 
     // Count or size is less than max, then we're done.
     if (totalSize < mMaxDiskUsageBytes && totalCount < mMaxFileCount) {
@@ -816,14 +822,14 @@ void WorkDirectory::clean_directory_locked() {
 
     // Remove files until we're under our limits.
     if (DO_UNLINK) {
-        for (map<string, WorkDirectoryEntry>::const_iterator it = files.begin();
-                it != files.end() && (totalSize >= mMaxDiskUsageBytes
-                    || totalCount >= mMaxFileCount);
-                it++) {
+        map<int64_t, WorkDirectoryEntry>::iterator it = mIndex.begin();
+        while (it != mIndex.end()
+                && (totalSize >= mMaxDiskUsageBytes || totalCount >= mMaxFileCount)) {
             unlink(it->second.envelope.c_str());
             unlink(it->second.data.c_str());
             totalSize -= it->second.size;
             totalCount--;
+            it = mIndex.erase(it);
         }
     }
 }
@@ -831,10 +837,16 @@ void WorkDirectory::clean_directory_locked() {
 void WorkDirectory::delete_files_for_report_if_necessary(const sp<ReportFile>& report) {
     if (report->getEnvelope().report_size() == 0) {
         ALOGI("Report %s is finished. Deleting from storage.", report->getId().c_str());
-        if (DO_UNLINK) {
-            unlink(report->getDataFileName().c_str());
-            unlink(report->getEnvelopeFileName().c_str());
-        }
+        unlink_report_locked(report);
+    }
+}
+
+void WorkDirectory::unlink_report_locked(const sp<ReportFile>& report) {
+    // Set this to false to leave files around for debugging.
+    if (DO_UNLINK) {
+        unlink(report->getDataFileName().c_str());
+        unlink(report->getEnvelopeFileName().c_str());
+        mIndex.erase(report->getTimestampNs());
     }
 }
 
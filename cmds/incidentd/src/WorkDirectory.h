@@ -23,6 +23,7 @@
 
 #include <utils/RefBase.h>
 
+#include <map>
 #include <mutex>
 #include <string>
 
@@ -37,7 +38,20 @@ using namespace std;
 extern const ComponentName DROPBOX_SENTINEL;
 
 class WorkDirectory;
-struct WorkDirectoryEntry;
+
+/**
+ * The files on disk for one ReportFile.
+ */
+struct WorkDirectoryEntry {
+    WorkDirectoryEntry();
+    explicit WorkDirectoryEntry(const WorkDirectoryEntry& that);
+    ~WorkDirectoryEntry();
+
+    string envelope;
+    string data;
+    int64_t timestampNs;
+    off_t size;
+};
 
 void get_args_from_report(IncidentReportArgs* out, const ReportFileProto_Report& report);
 
@@ -260,11 +274,19 @@ private:
     // the directory consistent.
     mutex mLock;
 
+    // The reports in the directory, by timestamp. Incidentd is the only writer, so the
+    // directory is scanned once at startup and this is kept up to date after that,
+    // instead of listing and stat-ing every file on each binder call. Sizes are only
+    // refreshed when cleaning the directory.
+    map<int64_t, WorkDirectoryEntry> mIndex;
+
     int64_t make_timestamp_ns_locked();
     bool file_exists_locked(int64_t timestampNs);    
     off_t get_directory_contents_locked(map<string,WorkDirectoryEntry>* files, int64_t after);
+    void load_index_locked();
     void clean_directory_locked();
     void delete_files_for_report_if_necessary(const sp<ReportFile>& report);
+    void unlink_report_locked(const sp<ReportFile>& report);
 
     string make_filename(int64_t timestampNs, const string& extension);
 };
@@ -173,6 +173,47 @@ TEST_F(FdBufferTest, ReadInStreamAndWrite) {
     }
 }
 
+TEST_F(FdBufferTest, ReadInStreamFromPipe) {
+    // Larger than the buffers used to move the data, so it takes several rounds.
+    std::string testdata(3 * BUFFER_SIZE + 7, 'a');
+    for (size_t i = 0; i < testdata.size(); i += 13) {
+        testdata[i] = 'b';
+    }
+    std::string expected = HEAD + testdata;
+
+    Fpipe inputPipe;
+    ASSERT_TRUE(inputPipe.init());
+
+    int pid = fork();
+    ASSERT_TRUE(pid != -1);
+
+    if (pid == 0) {
+        inputPipe.readFd().reset();
+        p2cPipe.writeFd().reset();
+        c2pPipe.readFd().reset();
+        ASSERT_TRUE(WriteStringToFd(testdata, inputPipe.writeFd()));
+        inputPipe.writeFd().reset();
+        ASSERT_TRUE(WriteStringToFd(HEAD, c2pPipe.writeFd()));
+        ASSERT_TRUE(DoDataStream(p2cPipe.readFd(), c2pPipe.writeFd()));
+        p2cPipe.readFd().reset();
+        c2pPipe.writeFd().reset();
+        // Must exit here otherwise the child process will continue executing the test binary.
+        _exit(EXIT_SUCCESS);
+    } else {
+        inputPipe.writeFd().reset();
+        p2cPipe.readFd().reset();
+        c2pPipe.writeFd().reset();
+
+        ASSERT_EQ(NO_ERROR,
+                  buffer.readProcessedDataInStream(inputPipe.readFd().get(),
+                                                   std::move(p2cPipe.writeFd()),
+                                                   std::move(c2pPipe.readFd()), READ_TIMEOUT));
+        AssertBufferReadSuccessful(HEAD.size() + testdata.size());
+        AssertBufferContent(expected.c_str());
+        wait(&pid);
+    }
+}
+
 TEST_F(FdBufferTest, ReadInStreamAndWriteAllAtOnce) {
     std::string testdata = "child process flushes only after all data are read.";
     std::string expected = HEAD + testdata;
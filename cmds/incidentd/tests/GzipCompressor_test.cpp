@@ -0,0 +1,117 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#define DEBUG false
+#include "Log.h"
+
+#include "GzipCompressor.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+using namespace android;
+using namespace android::base;
+using namespace android::os::incidentd;
+
+// Spans several compression blocks and isn't a multiple of the block size.
+const size_t LARGE_INPUT_SIZE = 1024 * 1024 + 17;
+
+static std::string gunzip(const std::vector<uint8_t>& gzipped) {
+    z_stream zs = {};
+    // 16 + MAX_WBITS to expect a gzip wrapper.
+    EXPECT_EQ(Z_OK, inflateInit2(&zs, 16 + MAX_WBITS));
+    std::string out;
+    uint8_t chunk[16 * 1024];
+    zs.next_in = const_cast<Bytef*>(gzipped.data());
+    zs.avail_in = gzipped.size();
+    int ret;
+    do {
+        zs.next_out = chunk;
+        zs.avail_out = sizeof(chunk);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(reinterpret_cast<char*>(chunk), sizeof(chunk) - zs.avail_out);
+    } while (ret == Z_OK);
+    EXPECT_EQ(Z_STREAM_END, ret);
+    EXPECT_EQ(0u, zs.avail_in);
+    inflateEnd(&zs);
+    return out;
+}
+
+static std::string make_input(size_t size) {
+    std::string input;
+    input.reserve(size);
+    for (size_t i = 0; input.size() < size; i++) {
+        input += "line " + std::to_string(i) + " of the incident\n";
+    }
+    input.resize(size);
+    return input;
+}
+
+TEST(GzipCompressorTest, CompressEmpty) {
+    GzipCompressor compressor;
+    std::vector<uint8_t> out;
+    ASSERT_EQ(NO_ERROR, compressor.compress(nullptr, 0, true, &out));
+    EXPECT_EQ("", gunzip(out));
+}
+
+TEST(GzipCompressorTest, CompressParallelBlocks) {
+    std::string input = make_input(LARGE_INPUT_SIZE);
+    GzipCompressor compressor;
+    std::vector<uint8_t> out;
+    ASSERT_EQ(NO_ERROR, compressor.compress(reinterpret_cast<const uint8_t*>(input.data()),
+                                            input.size(), true, &out));
+    EXPECT_LT(out.size(), input.size());
+    EXPECT_EQ(input, gunzip(out));
+}
+
+TEST(GzipCompressorTest, CompressInBatches) {
+    std::string input = make_input(LARGE_INPUT_SIZE);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(input.data());
+    size_t half = input.size() / 2;
+    GzipCompressor compressor;
+    std::vector<uint8_t> out;
+    ASSERT_EQ(NO_ERROR, compressor.compress(data, half, false, &out));
+    ASSERT_EQ(NO_ERROR, compressor.compress(data + half, input.size() - half, true, &out));
+    EXPECT_EQ(input, gunzip(out));
+}
+
+TEST(GzipCompressorTest, GzipThread) {
+    std::string input = make_input(LARGE_INPUT_SIZE);
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+
+    GzipThread zip;
+    ASSERT_EQ(NO_ERROR, zip.start(dup(tf.fd)));
+    ASSERT_TRUE(zip.started());
+    ASSERT_TRUE(WriteFully(zip.writeFd(), input.data(), input.size()));
+    ASSERT_EQ(NO_ERROR, zip.finish());
+
+    std::string gzipped;
+    ASSERT_TRUE(ReadFileToString(tf.path, &gzipped));
+    EXPECT_EQ(input, gunzip(std::vector<uint8_t>(gzipped.begin(), gzipped.end())));
+}
+
+TEST(GzipCompressorTest, GzipThreadFinishTimesOut) {
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+
+    GzipThread zip;
+    ASSERT_EQ(NO_ERROR, zip.start(dup(tf.fd)));
+    // A writer that never closes its end keeps the compressor waiting for input.
+    unique_fd writer(dup(zip.writeFd()));
+    ASSERT_NE(writer.get(), -1);
+
+    EXPECT_EQ(TIMED_OUT, zip.finish(100));
+    EXPECT_FALSE(zip.started());
+}
@@ -19,6 +19,7 @@
 
 #include <android-base/file.h>
 #include <android-base/test_utils.h>
+#include <android-base/unique_fd.h>
 #include <android/os/IncidentReportArgs.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -300,3 +301,45 @@ TEST_F(PrivacyFilterTest, AutoMessage) {
 }
 
 #endif
+
+// Section 3 of the test section list: a local varint, and a nested message holding a local
+// string and an automatic one.
+const std::string NESTED_MESSAGE = "\x0a\x06secret\x12\x06public";
+const std::string SECTION_3 =
+        "\x1a\x15" + VARINT_FIELD_1 + "\x12\x10" + NESTED_MESSAGE;
+// Section 1, which isn't requested.
+const std::string SECTION_1 = "\x0a\x02\x08\x01";
+
+static void filterReport(int from, std::string* output) {
+    IncidentReportArgs args;
+    args.addSection(3);
+    args.setPrivacyPolicy(PRIVACY_POLICY_EXPLICIT);
+
+    TemporaryFile out;
+    ASSERT_NE(out.fd, -1);
+    ASSERT_EQ(NO_ERROR, filter_and_write_report(out.fd, from, PRIVACY_POLICY_LOCAL, args));
+    ASSERT_TRUE(ReadFileToString(out.path, output));
+}
+
+TEST(FilterAndWriteReportTest, StripNestedMessageFromFile) {
+    TemporaryFile report;
+    ASSERT_NE(report.fd, -1);
+    ASSERT_TRUE(WriteStringToFd(SECTION_1 + SECTION_3, report.fd));
+    ASSERT_EQ(0, lseek(report.fd, 0, SEEK_SET));
+
+    std::string output;
+    filterReport(report.fd, &output);
+    EXPECT_EQ(std::string("\x1a\x0a\x12\x08\x12\x06public"), output);
+}
+
+TEST(FilterAndWriteReportTest, StripNestedMessageFromPipe) {
+    // A pipe can't be mapped, so the report is streamed through a ProtoFileReader.
+    unique_fd readEnd, writeEnd;
+    ASSERT_TRUE(Pipe(&readEnd, &writeEnd));
+    ASSERT_TRUE(WriteStringToFd(SECTION_1 + SECTION_3, writeEnd));
+    writeEnd.reset();
+
+    std::string output;
+    filterReport(readEnd, &output);
+    EXPECT_EQ(std::string("\x1a\x0a\x12\x08\x12\x06public"), output);
+}
@@ -98,3 +98,33 @@ TEST(ProtoFileReaderTest, ParseOneLevel) {
     ASSERT_EQ(msg2Size, msg_size[1]);
     close(fd);
 }
+
+TEST(ProtoFileReaderTest, SkipLargeField) {
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    size_t bigSize = 100 * 1024;
+    {
+        ProtoOutputStream proto;
+        string big;
+        big.resize(bigSize, 'b');
+        proto.write(FIELD_TYPE_MESSAGE | 1, big.data(), big.length());
+        proto.write(FIELD_TYPE_INT32 | 2, 42);
+        ASSERT_TRUE(proto.flush(tf.fd));
+    }
+    ASSERT_EQ(0, lseek(tf.fd, 0, SEEK_SET));
+
+    sp<ProtoFileReader> reader = new ProtoFileReader(tf.fd);
+    uint32_t fieldTag = reader->readRawVarint();
+    ASSERT_EQ(1u, read_field_id(fieldTag));
+    ASSERT_TRUE(reader->skipField(fieldTag));
+    // One byte of tag and three of size before the field itself.
+    EXPECT_EQ(4 + bigSize, reader->bytesRead());
+
+    ASSERT_TRUE(reader->hasNext());
+    fieldTag = reader->readRawVarint();
+    EXPECT_EQ(2u, read_field_id(fieldTag));
+    EXPECT_EQ(42u, reader->readRawVarint());
+    EXPECT_FALSE(reader->hasNext());
+    EXPECT_EQ((size_t)reader->size(), reader->bytesRead());
+    EXPECT_EQ(NO_ERROR, reader->getError());
+}
@@ -396,3 +396,16 @@ TEST_F(SectionTest, TestMultipleRequestsBySpec) {
     EXPECT_THAT(content, StrEq(string("\x02") + c + STRING_FIELD_2));
 }
 */
+
+TEST_F(SectionTest, SectionClass) {
+    CommandSection cs(1, "echo", "\"this is a test\"", NULL);
+    DumpsysSection ds(2, "fingerprint", "--proto", "--incident", NULL);
+    TextDumpsysSection tds(3, "fingerprint", NULL);
+    LogSection ls(4, "main", NULL);
+
+    EXPECT_EQ(SECTION_CLASS_DEFAULT, cs.sectionClass());
+    EXPECT_EQ(SECTION_CLASS_DUMPSYS, ds.sectionClass());
+    EXPECT_EQ(SECTION_CLASS_DUMPSYS, tds.sectionClass());
+    // LogSections share the last retrieved log timestamps, so they never run concurrently.
+    EXPECT_EQ(SECTION_CLASS_EXCLUSIVE, ls.sectionClass());
+}
@@ -61,11 +61,21 @@ Privacy* list[] = {&sub_field_1, &sub_field_2, NULL};
 Privacy field_0{0, 11, list, PRIVACY_POLICY_EXPLICIT, NULL};
 Privacy field_1{1, 9, NULL, PRIVACY_POLICY_AUTOMATIC, NULL};
 
-Privacy* final_list[] = {&field_0, &field_1};
+// Section 3 has a nested message with a local field of its own.
+Privacy nested_field_1{1, 9, NULL, PRIVACY_POLICY_LOCAL, NULL};
+Privacy* nested_list[] = {&nested_field_1, NULL};
+
+Privacy section_3_field_1{1, 1, NULL, PRIVACY_POLICY_LOCAL, NULL};
+Privacy section_3_field_2{2, 11, nested_list, PRIVACY_POLICY_AUTOMATIC, NULL};
+Privacy* section_3_list[] = {&section_3_field_1, &section_3_field_2, NULL};
+
+Privacy field_3{3, 11, section_3_list, PRIVACY_POLICY_AUTOMATIC, NULL};
+
+Privacy* final_list[] = {&field_0, &field_1, &field_3};
 
 const Privacy** PRIVACY_POLICY_LIST = const_cast<const Privacy**>(final_list);
 
-const int PRIVACY_POLICY_COUNT = 2;
+const int PRIVACY_POLICY_COUNT = 3;
 
 }  // namespace incidentd
 }  // namespace os
@@ -45,6 +45,31 @@ static void BM_LogEventCreation(benchmark::State& state) {
 }
 BENCHMARK(BM_LogEventCreation);
 
+static void BM_LogEventCreationDeferred(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    size_t size = createAndParseStatsEvent(msg);
+    LogEvent event(/*uid=*/ 1000, /*pid=*/ 1001);
+    while (state.KeepRunning()) {
+        // Most atoms are dropped after looking at the atom id only.
+        event.reset(/*uid=*/ 1000, /*pid=*/ 1001);
+        benchmark::DoNotOptimize(event.parseBufferDeferred(msg, size));
+        benchmark::DoNotOptimize(event.GetTagId());
+    }
+}
+BENCHMARK(BM_LogEventCreationDeferred);
+
+static void BM_LogEventCreationDeferredAndUsed(benchmark::State& state) {
+    uint8_t msg[LOGGER_ENTRY_MAX_PAYLOAD];
+    size_t size = createAndParseStatsEvent(msg);
+    LogEvent event(/*uid=*/ 1000, /*pid=*/ 1001);
+    while (state.KeepRunning()) {
+        event.reset(/*uid=*/ 1000, /*pid=*/ 1001);
+        benchmark::DoNotOptimize(event.parseBufferDeferred(msg, size));
+        benchmark::DoNotOptimize(event.isValid());
+    }
+}
+BENCHMARK(BM_LogEventCreationDeferredAndUsed);
+
 }  //  namespace statsd
 }  //  namespace os
 }  //  namespace android
@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// End to end benchmark of the pushed atom path: datagrams are written to a socket read by
+// StatsSocketListener, queued in LogEventQueue, and consumed by StatsLogProcessor the same way
+// StatsService::readLogs does.
+//
+// By default a synthetic stream of wakelock, scheduled job, sync and screen atoms from many uids
+// is replayed. Set STATSD_BENCHMARK_REPLAY_FILE to replay a recorded stream instead. The file is
+// a sequence of records, each a 32-bit little-endian length followed by one datagram exactly as
+// written to the statsdw socket (android_log_header_t, StatsEventTag, then the atom).
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "logd/LogEventQueue.h"
+#include "metric_util.h"
+#include "socket/StatsSocketListener.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// Written by libstatssocket in front of every atom, and skipped by StatsSocketListener.
+const uint32_t kStatsEventTag = 1937006964;
+
+// Not a real atom. Tells the reader that the whole stream has been sent.
+const int kEndOfStreamAtomId = 99999;
+
+// Same limits as statsd itself, see main.cpp and StatsService.cpp.
+const size_t kQueueSize = 2000;
+const size_t kReadBatchSize = 64;
+
+const size_t kNumSyntheticEvents = 100000;
+const int kNumUids = 500;
+const int kNumTagsPerUid = 4;
+const int kNumExtraCountMetrics = 20;
+
+string makeDatagram(AStatsEvent* statsEvent) {
+    AStatsEvent_build(statsEvent);
+    size_t size;
+    uint8_t* buf = AStatsEvent_getBuffer(statsEvent, &size);
+
+    android_log_header_t header = {};
+    header.id = LOG_ID_STATS;
+    string datagram(reinterpret_cast<const char*>(&header), sizeof(header));
+    datagram.append(reinterpret_cast<const char*>(&kStatsEventTag), sizeof(kStatsEventTag));
+    datagram.append(reinterpret_cast<const char*>(buf), size);
+
+    AStatsEvent_release(statsEvent);
+    return datagram;
+}
+
+AStatsEvent* obtainAttributedEvent(int atomId, int64_t timestampNs, int uid) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, atomId);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    writeAttribution(statsEvent, {uid}, {""});
+    return statsEvent;
+}
+
+string makeWakelockDatagram(int64_t timestampNs, int uid, const string& tag,
+                            WakelockStateChanged::State state) {
+    AStatsEvent* statsEvent =
+            obtainAttributedEvent(android::util::WAKELOCK_STATE_CHANGED, timestampNs, uid);
+    AStatsEvent_writeInt32(statsEvent, 1 /* PARTIAL_WAKE_LOCK */);
+    AStatsEvent_writeString(statsEvent, tag.c_str());
+    AStatsEvent_writeInt32(statsEvent, state);
+    return makeDatagram(statsEvent);
+}
+
+string makeScheduledJobDatagram(int64_t timestampNs, int uid, const string& name,
+                                ScheduledJobStateChanged::State state) {
+    AStatsEvent* statsEvent =
+            obtainAttributedEvent(android::util::SCHEDULED_JOB_STATE_CHANGED, timestampNs, uid);
+    AStatsEvent_writeString(statsEvent, name.c_str());
+    AStatsEvent_writeInt32(statsEvent, state);
+    return makeDatagram(statsEvent);
+}
+
+string makeSyncDatagram(int64_t timestampNs, int uid, const string& name,
+                        SyncStateChanged::State state) {
+    AStatsEvent* statsEvent =
+            obtainAttributedEvent(android::util::SYNC_STATE_CHANGED, timestampNs, uid);
+    AStatsEvent_writeString(statsEvent, name.c_str());
+    AStatsEvent_writeInt32(statsEvent, state);
+    return makeDatagram(statsEvent);
+}
+
+string makeScreenDatagram(int64_t timestampNs, android::view::DisplayStateEnum state) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, android::util::SCREEN_STATE_CHANGED);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    AStatsEvent_writeInt32(statsEvent, state);
+    return makeDatagram(statsEvent);
+}
+
+string makeEndOfStreamDatagram() {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, kEndOfStreamAtomId);
+    return makeDatagram(statsEvent);
+}
+
+// A mix of start/stop pairs from many uids, with the screen flipping now and then. One event
+// per millisecond, starting at startTimeNs.
+vector<string> createSyntheticStream(int64_t startTimeNs) {
+    vector<string> datagrams;
+    datagrams.reserve(kNumSyntheticEvents);
+    std::mt19937 random(0);
+    bool screenOn = true;
+    for (int i = 0; datagrams.size() < kNumSyntheticEvents; i++) {
+        const int64_t timestampNs = startTimeNs + i * NS_PER_SEC / 1000;
+        const int uid = 10000 + random() % kNumUids;
+        const string tag = "tag" + std::to_string(random() % kNumTagsPerUid);
+        const bool start = random() % 2;
+        const int kind = random() % 8;
+        if (kind == 0 && i % 100 == 0) {
+            screenOn = !screenOn;
+            datagrams.push_back(makeScreenDatagram(
+                    timestampNs, screenOn ? android::view::DISPLAY_STATE_ON
+                                          : android::view::DISPLAY_STATE_OFF));
+        } else if (kind < 4) {
+            datagrams.push_back(makeWakelockDatagram(
+                    timestampNs, uid, tag,
+                    start ? WakelockStateChanged::ACQUIRE : WakelockStateChanged::RELEASE));
+        } else if (kind < 6) {
+            const auto state =
+                    start ? ScheduledJobStateChanged::STARTED : ScheduledJobStateChanged::FINISHED;
+            datagrams.push_back(makeScheduledJobDatagram(timestampNs, uid, tag, state));
+        } else {
+            datagrams.push_back(makeSyncDatagram(
+                    timestampNs, uid, tag, start ? SyncStateChanged::ON : SyncStateChanged::OFF));
+        }
+    }
+    return datagrams;
+}
+
+bool readRecordedStream(const string& path, vector<string>* datagrams) {
+    string content;
+    if (!android::base::ReadFileToString(path, &content)) {
+        return false;
+    }
+    size_t pos = 0;
+    while (pos + sizeof(uint32_t) <= content.size()) {
+        uint32_t length;
+        memcpy(&length, content.data() + pos, sizeof(length));
+        pos += sizeof(length);
+        if (length > content.size() - pos) {
+            // Truncated recording, replay what is complete.
+            break;
+        }
+        datagrams->push_back(content.substr(pos, length));
+        pos += length;
+    }
+    return !datagrams->empty();
+}
+
+// Returns the elapsed timestamp of the first atom in the stream, used as the config time base.
+int64_t getStreamStartTimeNs(const vector<string>& datagrams) {
+    const size_t offset = sizeof(android_log_header_t) + sizeof(kStatsEventTag);
+    if (datagrams.empty() || datagrams[0].size() <= offset) {
+        return 0;
+    }
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    event.parseBuffer((uint8_t*)datagrams[0].data() + offset, datagrams[0].size() - offset);
+    return event.GetElapsedTimestampNs();
+}
+
+// Roughly the shape of a production config: a few duration metrics sliced by uid and
+// conditioned on the screen, and a larger number of cheap count metrics.
+StatsdConfig createPipelineConfig() {
+    StatsdConfig config;
+    *config.add_atom_matcher() = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = CreateReleaseWakelockAtomMatcher();
+    *config.add_atom_matcher() = CreateStartScheduledJobAtomMatcher();
+    *config.add_atom_matcher() = CreateFinishScheduledJobAtomMatcher();
+    *config.add_atom_matcher() = CreateSyncStartAtomMatcher();
+    *config.add_atom_matcher() = CreateSyncEndAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+
+    auto screenIsOffPredicate = CreateScreenIsOffPredicate();
+    *config.add_predicate() = screenIsOffPredicate;
+
+    auto holdingWakelockPredicate = CreateHoldingWakelockPredicate();
+    *holdingWakelockPredicate.mutable_simple_predicate()->mutable_dimensions() =
+            CreateAttributionUidDimensions(android::util::WAKELOCK_STATE_CHANGED,
+                                           {Position::FIRST});
+    *config.add_predicate() = holdingWakelockPredicate;
+
+    auto scheduledJobPredicate = CreateScheduledJobPredicate();
+    auto jobDimensions = scheduledJobPredicate.mutable_simple_predicate()->mutable_dimensions();
+    *jobDimensions = CreateAttributionUidDimensions(android::util::SCHEDULED_JOB_STATE_CHANGED,
+                                                    {Position::FIRST});
+    jobDimensions->add_child()->set_field(2);  // job name field.
+    *config.add_predicate() = scheduledJobPredicate;
+
+    auto wakelockDuration = config.add_duration_metric();
+    wakelockDuration->set_id(StringToId("WakelockDurationScreenOff"));
+    wakelockDuration->set_what(holdingWakelockPredicate.id());
+    wakelockDuration->set_condition(screenIsOffPredicate.id());
+    wakelockDuration->set_aggregation_type(DurationMetric::SUM);
+    wakelockDuration->set_bucket(FIVE_MINUTES);
+    *wakelockDuration->mutable_dimensions_in_what() = CreateAttributionUidDimensions(
+            android::util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+
+    auto jobDuration = config.add_duration_metric();
+    jobDuration->set_id(StringToId("ScheduledJobMaxDuration"));
+    jobDuration->set_what(scheduledJobPredicate.id());
+    jobDuration->set_aggregation_type(DurationMetric::MAX_SPARSE);
+    jobDuration->set_bucket(FIVE_MINUTES);
+    *jobDuration->mutable_dimensions_in_what() = CreateAttributionUidDimensions(
+            android::util::SCHEDULED_JOB_STATE_CHANGED, {Position::FIRST});
+
+    auto syncCount = config.add_count_metric();
+    syncCount->set_id(StringToId("SyncCount"));
+    syncCount->set_what(StringToId("SyncStart"));
+    syncCount->set_bucket(FIVE_MINUTES);
+    *syncCount->mutable_dimensions_in_what() = CreateAttributionUidAndTagDimensions(
+            android::util::SYNC_STATE_CHANGED, {Position::FIRST});
+
+    for (int i = 0; i < kNumExtraCountMetrics; i++) {
+        auto wakelockCount = config.add_count_metric();
+        wakelockCount->set_id(StringToId("WakelockCount" + std::to_string(i)));
+        wakelockCount->set_what(StringToId("AcquireWakelock"));
+        wakelockCount->set_bucket(i % 2 ? FIVE_MINUTES : ONE_HOUR);
+        if (i % 4 == 0) {
+            wakelockCount->set_condition(screenIsOffPredicate.id());
+        }
+        *wakelockCount->mutable_dimensions_in_what() = CreateAttributionUidDimensions(
+                android::util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    }
+
+    auto screenEvents = config.add_event_metric();
+    screenEvents->set_id(StringToId("ScreenEvents"));
+    screenEvents->set_what(StringToId("ScreenTurnedOn"));
+    return config;
+}
+
+// Number of dimension keys with data, summed over all metrics of the report.
+size_t countDimensions(const ConfigMetricsReportList& reports) {
+    size_t count = 0;
+    for (const auto& report : reports.reports()) {
+        for (const auto& metric : report.metrics()) {
+            count += metric.count_metrics().data_size() + metric.duration_metrics().data_size() +
+                     metric.event_metrics().data_size() + metric.value_metrics().data_size() +
+                     metric.gauge_metrics().data_size();
+        }
+    }
+    return count;
+}
+
+struct ReplayResult {
+    size_t processedEvents = 0;
+    vector<int64_t> latenciesNs;
+    size_t metricsBytes = 0;
+    size_t dimensions = 0;
+};
+
+// Replays the stream once through a new socket, queue and processor.
+void replayStream(const vector<string>& datagrams, int64_t startTimeNs, bool dumpReport,
+                  ReplayResult* result) {
+    const ConfigKey key(1000, StringToId("pipeline_benchmark"));
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(startTimeNs / NS_PER_SEC, createPipelineConfig(), key);
+    auto queue = std::make_shared<LogEventQueue>(kQueueSize);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        return;
+    }
+    int on = 1;
+    setsockopt(fds[0], SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+    sp<StatsSocketListener> listener = new StatsSocketListener(queue, fds[0]);
+    listener->startListener(600);
+
+    std::atomic<bool> endOfStream(false);
+    result->latenciesNs.reserve(result->latenciesNs.size() + datagrams.size());
+    std::thread reader([&] {
+        vector<std::unique_ptr<LogEvent>> events;
+        events.reserve(kReadBatchSize);
+        while (!endOfStream) {
+            queue->waitPopBatch(&events, kReadBatchSize);
+            for (auto& event : events) {
+                if (event->GetTagId() == kEndOfStreamAtomId) {
+                    endOfStream = true;
+                } else if (!endOfStream) {
+                    const int64_t beginNs = getElapsedRealtimeNs();
+                    processor->OnLogEvent(event.get());
+                    result->latenciesNs.push_back(getElapsedRealtimeNs() - beginNs);
+                    result->processedEvents++;
+                }
+                queue->recycle(std::move(event));
+            }
+            events.clear();
+        }
+    });
+
+    for (const auto& datagram : datagrams) {
+        // Blocks while the socket buffer is full, so drops only happen when the queue is full.
+        send(fds[1], datagram.data(), datagram.size(), 0);
+    }
+    // The marker itself may be dropped if the queue is full, keep sending until it is seen.
+    const string endOfStreamDatagram = makeEndOfStreamDatagram();
+    while (!endOfStream) {
+        send(fds[1], endOfStreamDatagram.data(), endOfStreamDatagram.size(), 0);
+        usleep(1000);
+    }
+    reader.join();
+    listener->stopListener();
+    close(fds[1]);
+    close(fds[0]);
+
+    if (dumpReport) {
+        result->metricsBytes = processor->GetMetricsSize(key);
+        vector<uint8_t> output;
+        processor->onDumpReport(key, getElapsedRealtimeNs(), true /* include partial bucket */,
+                                false /* erase data */, ADB_DUMP, FAST, &output);
+        ConfigMetricsReportList reports;
+        reports.ParseFromArray(output.data(), output.size());
+        result->dimensions = countDimensions(reports);
+    }
+}
+
+}  // namespace
+
+static void BM_PipelineReplay(benchmark::State& state) {
+    vector<string> datagrams;
+    const char* replayFile = getenv("STATSD_BENCHMARK_REPLAY_FILE");
+    if (replayFile == nullptr || !readRecordedStream(replayFile, &datagrams)) {
+        datagrams = createSyntheticStream(10 * NS_PER_SEC);
+    }
+    const int64_t startTimeNs = getStreamStartTimeNs(datagrams);
+
+    ReplayResult result;
+    size_t sentEvents = 0;
+    while (state.KeepRunning()) {
+        replayStream(datagrams, startTimeNs, false, &result);
+        sentEvents += datagrams.size();
+    }
+
+    // One more untimed replay to measure the memory held by the metrics.
+    ReplayResult memory;
+    replayStream(datagrams, startTimeNs, true, &memory);
+
+    int64_t p99LatencyNs = 0;
+    if (!result.latenciesNs.empty()) {
+        auto p99 = result.latenciesNs.begin() + result.latenciesNs.size() * 99 / 100;
+        std::nth_element(result.latenciesNs.begin(), p99, result.latenciesNs.end());
+        p99LatencyNs = *p99;
+    }
+
+    state.counters["events_per_sec"] =
+            benchmark::Counter(result.processedEvents, benchmark::Counter::kIsRate);
+    state.counters["p99_latency_ns"] = p99LatencyNs;
+    state.counters["dropped_events"] = sentEvents - result.processedEvents;
+    state.counters["dimensions"] = memory.dimensions;
+    state.counters["bytes_per_dimension"] =
+            memory.dimensions > 0 ? memory.metricsBytes / memory.dimensions : 0;
+}
+BENCHMARK(BM_PipelineReplay)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -19,6 +19,10 @@
 #include "HashableDimensionKey.h"
 #include "FieldValue.h"
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -104,25 +108,25 @@ static void populateStatsDimensionsValueParcelChildren(StatsDimensionsValueParce
 
 StatsDimensionsValueParcel HashableDimensionKey::toStatsDimensionsValueParcel() const {
     StatsDimensionsValueParcel root;
-    if (mValues.size() == 0) {
+    if (getValues().size() == 0) {
         return root;
     }
 
-    root.field = mValues[0].mField.getTag();
+    root.field = getValues()[0].mField.getTag();
     root.valueType = STATS_DIMENSIONS_VALUE_TUPLE_TYPE;
 
     // Children of the root correspond to top-level (depth = 0) FieldValues.
     int childDepth = 0;
     int childPrefix = 0;
     size_t index = 0;
-    populateStatsDimensionsValueParcelChildren(root, childDepth, childPrefix, mValues, index);
+    populateStatsDimensionsValueParcelChildren(root, childDepth, childPrefix, getValues(), index);
 
     return root;
 }
 
-android::hash_t hashDimension(const HashableDimensionKey& value) {
+static android::hash_t hashValues(const vector<FieldValue>& values) {
     android::hash_t hash = 0;
-    for (const auto& fieldValue : value.getValues()) {
+    for (const auto& fieldValue : values) {
         hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
         hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
         hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
@@ -151,6 +155,120 @@ android::hash_t hashDimension(const HashableDimensionKey& value) {
     return JenkinsHashWhiten(hash);
 }
 
+static bool equalValues(const vector<FieldValue>& values, const vector<FieldValue>& thatValues) {
+    if (values.size() != thatValues.size()) {
+        return false;
+    }
+    size_t count = values.size();
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] != thatValues[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+android::hash_t hashDimension(const HashableDimensionKey& value) {
+    return value.hash();
+}
+
+const vector<FieldValue> HashableDimensionKey::kNoValues;
+
+/**
+ * The storage of all interned keys, by hash. Entries are weak, so that storage is freed along with
+ * the last key using it: expired entries are dropped whenever they are found, and all at once
+ * whenever a shard has doubled in size.
+ *
+ * Every MetricDimensionKey built from a key that is not interned yet goes through here, from any
+ * thread pushing events, so the pool is split into shards by hash, each with its own lock.
+ */
+class DimensionKeyPool {
+public:
+    static DimensionKeyPool& getInstance() {
+        static DimensionKeyPool pool;
+        return pool;
+    }
+
+    void intern(HashableDimensionKey* key);
+
+private:
+    using Storage = HashableDimensionKey::Storage;
+
+    static constexpr size_t kShardCount = 16;
+
+    struct Shard {
+        void removeExpiredLocked();
+
+        std::mutex mMutex;
+        std::unordered_multimap<android::hash_t, std::weak_ptr<Storage>> mStorages;
+        size_t mNextSweepSize = 64;
+    };
+
+    Shard mShards[kShardCount];
+};
+
+void DimensionKeyPool::intern(HashableDimensionKey* key) {
+    std::shared_ptr<Storage>& storage = key->mStorage;
+    if (storage == nullptr || storage->interned.load(std::memory_order_acquire)) {
+        return;
+    }
+    const android::hash_t hash = hashValues(storage->values);
+    Shard& shard = mShards[hash % kShardCount];
+
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+    auto range = shard.mStorages.equal_range(hash);
+    for (auto it = range.first; it != range.second;) {
+        std::shared_ptr<Storage> interned = it->second.lock();
+        if (interned == nullptr) {
+            it = shard.mStorages.erase(it);
+        } else if (equalValues(interned->values, storage->values)) {
+            storage = interned;
+            return;
+        } else {
+            it++;
+        }
+    }
+
+    // Other keys sharing this storage see it become immutable too, and copy it before any change.
+    storage->hash = hash;
+    storage->interned.store(true, std::memory_order_release);
+    shard.mStorages.emplace(hash, storage);
+    if (shard.mStorages.size() >= shard.mNextSweepSize) {
+        shard.removeExpiredLocked();
+        shard.mNextSweepSize = std::max(shard.mNextSweepSize, shard.mStorages.size() * 2);
+    }
+}
+
+void DimensionKeyPool::Shard::removeExpiredLocked() {
+    for (auto it = mStorages.begin(); it != mStorages.end();) {
+        if (it->second.expired()) {
+            it = mStorages.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+HashableDimensionKey::Storage* HashableDimensionKey::mutableStorage() {
+    if (mStorage == nullptr) {
+        mStorage = std::make_shared<Storage>(kNoValues);
+    } else if (mStorage->interned.load(std::memory_order_acquire) || mStorage.use_count() > 1) {
+        mStorage = std::make_shared<Storage>(mStorage->values);
+    }
+    return mStorage.get();
+}
+
+void HashableDimensionKey::intern() {
+    DimensionKeyPool::getInstance().intern(this);
+}
+
+android::hash_t HashableDimensionKey::hash() const {
+    if (mStorage != nullptr && mStorage->interned.load(std::memory_order_acquire)) {
+        return mStorage->hash;
+    }
+    return hashValues(getValues());
+}
+
 bool filterValues(const Matcher& matcherField, const vector<FieldValue>& values,
                   FieldValue* output) {
     for (const auto& value : values) {
@@ -307,16 +425,15 @@ bool HashableDimensionKey::operator!=(const HashableDimensionKey& that) const {
 }
 
 bool HashableDimensionKey::operator==(const HashableDimensionKey& that) const {
-    if (mValues.size() != that.getValues().size()) {
-        return false;
+    if (mStorage == that.mStorage) {
+        return true;
     }
-    size_t count = mValues.size();
-    for (size_t i = 0; i < count; i++) {
-        if (mValues[i] != (that.getValues())[i]) {
-            return false;
-        }
+    if (mStorage != nullptr && that.mStorage != nullptr && mStorage->interned &&
+        that.mStorage->interned) {
+        // There is only one interned storage for any given values.
+        return false;
     }
-    return true;
+    return equalValues(getValues(), that.getValues());
 };
 
 bool HashableDimensionKey::operator<(const HashableDimensionKey& that) const {
@@ -324,17 +441,17 @@ bool HashableDimensionKey::operator<(const HashableDimensionKey& that) const {
 };
 
 bool HashableDimensionKey::contains(const HashableDimensionKey& that) const {
-    if (mValues.size() < that.getValues().size()) {
+    if (getValues().size() < that.getValues().size()) {
         return false;
     }
 
-    if (mValues.size() == that.getValues().size()) {
+    if (getValues().size() == that.getValues().size()) {
         return (*this) == that;
     }
 
     for (const auto& value : that.getValues()) {
         bool found = false;
-        for (const auto& myValue : mValues) {
+        for (const auto& myValue : getValues()) {
             if (value.mField == myValue.mField && value.mValue == myValue.mValue) {
                 found = true;
                 break;
@@ -350,7 +467,7 @@ bool HashableDimensionKey::contains(const HashableDimensionKey& that) const {
 
 string HashableDimensionKey::toString() const {
     std::string output;
-    for (const auto& value : mValues) {
+    for (const auto& value : getValues()) {
         output += StringPrintf("(%d)%#x->%s ", value.mField.getTag(), value.mField.getField(),
                                value.mValue.toString().c_str());
     }
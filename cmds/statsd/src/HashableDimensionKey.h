@@ -18,6 +18,8 @@
 
 #include <aidl/android/os/StatsDimensionsValueParcel.h>
 #include <utils/JenkinsHash.h>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include "android-base/stringprintf.h"
 #include "FieldValue.h"
@@ -41,35 +43,50 @@ struct Metric2State {
     std::vector<Matcher> stateFields;
 };
 
+/**
+ * The values of a dimension. Copies share the same immutable storage, which is only copied when a
+ * shared key is modified, and intern() makes equal keys share one storage with a precomputed
+ * hash, so that keys held by many metric maps take memory once and hash in constant time.
+ */
 class HashableDimensionKey {
 public:
-    explicit HashableDimensionKey(const std::vector<FieldValue>& values) {
-        mValues = values;
+    explicit HashableDimensionKey(const std::vector<FieldValue>& values)
+        : mStorage(values.empty() ? nullptr : std::make_shared<Storage>(values)) {
     }
 
     HashableDimensionKey() {};
 
-    HashableDimensionKey(const HashableDimensionKey& that) : mValues(that.getValues()){};
+    HashableDimensionKey(const HashableDimensionKey& that) : mStorage(that.mStorage){};
+
+    HashableDimensionKey& operator=(const HashableDimensionKey& from) = default;
 
     inline void addValue(const FieldValue& value) {
-        mValues.push_back(value);
+        mutableStorage()->values.push_back(value);
     }
 
     inline const std::vector<FieldValue>& getValues() const {
-        return mValues;
+        return mStorage != nullptr ? mStorage->values : kNoValues;
     }
 
     inline std::vector<FieldValue>* mutableValues() {
-        return &mValues;
+        return &mutableStorage()->values;
     }
 
     inline FieldValue* mutableValue(size_t i) {
-        if (i >= 0 && i < mValues.size()) {
-            return &(mValues[i]);
+        if (i >= 0 && i < getValues().size()) {
+            return &(mutableStorage()->values[i]);
         }
         return nullptr;
     }
 
+    /**
+     * Makes this key share the storage of an equal interned key, interning it if there is none.
+     */
+    void intern();
+
+    // Returns the hash of the values, which is only computed once for interned keys.
+    android::hash_t hash() const;
+
     StatsDimensionsValueParcel toStatsDimensionsValueParcel() const;
 
     std::string toString() const;
@@ -83,14 +100,36 @@ public:
     bool contains(const HashableDimensionKey& that) const;
 
 private:
-    std::vector<FieldValue> mValues;
+    struct Storage {
+        explicit Storage(const std::vector<FieldValue>& values) : values(values) {
+        }
+
+        std::vector<FieldValue> values;
+        // Only set once the storage is interned, after which it is never modified.
+        std::atomic<bool> interned{false};
+        android::hash_t hash = 0;
+    };
+
+    // Returns storage that is only referenced by this key, copying the shared one if needed.
+    Storage* mutableStorage();
+
+    static const std::vector<FieldValue> kNoValues;
+
+    // nullptr for a key without values.
+    std::shared_ptr<Storage> mStorage;
+
+    friend class DimensionKeyPool;
 };
 
 class MetricDimensionKey {
 public:
+    // Metric producers key their maps on MetricDimensionKeys, so both keys are interned.
     explicit MetricDimensionKey(const HashableDimensionKey& dimensionKeyInWhat,
                                 const HashableDimensionKey& stateValuesKey)
-        : mDimensionKeyInWhat(dimensionKeyInWhat), mStateValuesKey(stateValuesKey){};
+        : mDimensionKeyInWhat(dimensionKeyInWhat), mStateValuesKey(stateValuesKey) {
+        mDimensionKeyInWhat.intern();
+        mStateValuesKey.intern();
+    };
 
     MetricDimensionKey(){};
 
@@ -116,6 +155,7 @@ public:
 
     inline void setStateValuesKey(const HashableDimensionKey& key) {
         mStateValuesKey = key;
+        mStateValuesKey.intern();
     }
 
     bool hasStateValuesKey() const {
@@ -223,15 +263,15 @@ using android::os::statsd::MetricDimensionKey;
 template <>
 struct hash<HashableDimensionKey> {
     std::size_t operator()(const HashableDimensionKey& key) const {
-        return hashDimension(key);
+        return key.hash();
     }
 };
 
 template <>
 struct hash<MetricDimensionKey> {
     std::size_t operator()(const MetricDimensionKey& key) const {
-        android::hash_t hash = hashDimension(key.getDimensionKeyInWhat());
-        hash = android::JenkinsHashMix(hash, hashDimension(key.getStateValuesKey()));
+        android::hash_t hash = key.getDimensionKeyInWhat().hash();
+        hash = android::JenkinsHashMix(hash, key.getStateValuesKey().hash());
         return android::JenkinsHashWhiten(hash);
     }
 };
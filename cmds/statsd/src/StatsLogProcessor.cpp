@@ -20,6 +20,8 @@
 #include "StatsLogProcessor.h"
 
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <android/util/protobuf.h>
 #include <cutils/multiuser.h>
 #include <frameworks/base/cmds/statsd/src/active_config_list.pb.h>
 #include <frameworks/base/cmds/statsd/src/experiment_ids.pb.h>
@@ -38,6 +40,7 @@
 
 using namespace android;
 using android::base::StringPrintf;
+using android::util::EncodedBuffer;
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
 using android::util::FIELD_TYPE_FLOAT;
@@ -46,6 +49,7 @@ using android::util::FIELD_TYPE_INT64;
 using android::util::FIELD_TYPE_MESSAGE;
 using android::util::FIELD_TYPE_STRING;
 using android::util::ProtoOutputStream;
+using android::util::write_length_delimited_tag_header;
 using std::vector;
 
 namespace android {
@@ -158,6 +162,39 @@ void StatsLogProcessor::mapIsolatedUidToHostUidIfNecessaryLocked(LogEvent* event
     }
 }
 
+bool StatsLogProcessor::isAtomUsedLocked(int atomId) const {
+    if (atomId == android::os::statsd::util::BINARY_PUSH_STATE_CHANGED ||
+        atomId == android::os::statsd::util::WATCHDOG_ROLLBACK_OCCURRED ||
+        atomId == android::os::statsd::util::ISOLATED_UID_CHANGED) {
+        return true;
+    }
+    if (StateManager::getInstance().getListenersCount(atomId) > 0) {
+        return true;
+    }
+    return mMetricsManagersByAtom.find(atomId) != mMetricsManagersByAtom.end();
+}
+
+void StatsLogProcessor::updateAtomDispatchLocked() {
+    mMetricsManagersByAtom.clear();
+    mMetricsManagersWithActivation.clear();
+    for (const auto& pair : mMetricsManagers) {
+        for (int atomId : pair.second->getTagIds()) {
+            mMetricsManagersByAtom[atomId];
+        }
+        if (pair.second->hasActivations()) {
+            mMetricsManagersWithActivation.emplace_back(pair.first, pair.second);
+        }
+    }
+    for (auto& atom : mMetricsManagersByAtom) {
+        for (const auto& pair : mMetricsManagers) {
+            if (pair.second->hasActivations() ||
+                pair.second->getTagIds().find(atom.first) != pair.second->getTagIds().end()) {
+                atom.second.emplace_back(pair.first, pair.second);
+            }
+        }
+    }
+}
+
 void StatsLogProcessor::onIsolatedUidChangedEventLocked(const LogEvent& event) {
     status_t err = NO_ERROR, err2 = NO_ERROR, err3 = NO_ERROR;
     bool is_create = event.GetBool(3, &err);
@@ -392,7 +429,12 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     const int64_t eventElapsedTimeNs = event->GetElapsedTimestampNs();
     int atomId = event->GetTagId();
     StatsdStats::getInstance().noteAtomLogged(atomId, eventElapsedTimeNs / NS_PER_SEC);
-    if (!event->isValid()) {
+    mLargestTimestampSeen = std::max(mLargestTimestampSeen, eventElapsedTimeNs);
+    // The fields of events parsed with deferred parsing are only parsed, and validated, if
+    // something is going to look at them. Most atoms are dropped by every config's tag id filter,
+    // and are still passed down below only for the activation and ttl bookkeeping.
+    const bool fieldsUsed = !event->hasDeferredFields() || isAtomUsedLocked(atomId);
+    if (fieldsUsed && !event->isValid()) {
         StatsdStats::getInstance().noteAtomError(atomId);
         return;
     }
@@ -420,7 +462,7 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
     // The field numbers need to be currently updated by hand with atoms.proto
     if (atomId == android::os::statsd::util::ISOLATED_UID_CHANGED) {
         onIsolatedUidChangedEventLocked(*event);
-    } else {
+    } else if (fieldsUsed) {
         // Map the isolated uid to host uid if necessary.
         mapIsolatedUidToHostUidIfNecessaryLocked(event);
     }
@@ -439,8 +481,12 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
 
     std::unordered_set<int> uidsWithActiveConfigsChanged;
     std::unordered_map<int, std::vector<int64_t>> activeConfigsPerUid;
-    // pass the event to metrics managers.
-    for (auto& pair : mMetricsManagers) {
+    // pass the event to the metrics managers that use it.
+    auto atomManagers = mMetricsManagersByAtom.find(atomId);
+    const auto& metricsManagers = atomManagers != mMetricsManagersByAtom.end()
+                                          ? atomManagers->second
+                                          : mMetricsManagersWithActivation;
+    for (auto& pair : metricsManagers) {
         int uid = pair.first.GetUid();
         int64_t configId = pair.first.GetId();
         bool isPrevActive = pair.second->isActive();
@@ -515,13 +561,23 @@ void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const ConfigK
     OnConfigUpdatedLocked(timestampNs, key, config);
 }
 
-void StatsLogProcessor::OnConfigUpdatedLocked(
-        const int64_t timestampNs, const ConfigKey& key, const StatsdConfig& config) {
+void StatsLogProcessor::OnConfigUpdatedLocked(const int64_t timestampNs, const ConfigKey& key,
+                                              const StatsdConfig& config, bool reuseMetrics) {
     VLOG("Updated configuration for key %s", key.ToString().c_str());
+    // Metrics the update leaves unchanged are taken over from the current manager with their
+    // state, instead of starting again from nothing.
+    const auto it = mMetricsManagers.find(key);
+    const sp<MetricsManager> previousMetricsManager =
+            reuseMetrics && it != mMetricsManagers.end() ? it->second : nullptr;
     sp<MetricsManager> newMetricsManager =
             new MetricsManager(key, config, mTimeBaseNs, timestampNs, mUidMap, mPullerManager,
-                               mAnomalyAlarmMonitor, mPeriodicAlarmMonitor);
+                               mAnomalyAlarmMonitor, mPeriodicAlarmMonitor,
+                               previousMetricsManager);
     if (newMetricsManager->isConfigValid()) {
+        if (previousMetricsManager != nullptr) {
+            previousMetricsManager->releaseMetricProducers(
+                    newMetricsManager->getReusedMetricIds());
+        }
         newMetricsManager->init();
         mUidMap->OnConfigUpdated(key);
         newMetricsManager->refreshTtl(timestampNs);
@@ -533,6 +589,7 @@ void StatsLogProcessor::OnConfigUpdatedLocked(
         ALOGE("StatsdConfig NOT valid");
         mMetricsManagers.erase(key);
     }
+    updateAtomDispatchLocked();
 }
 
 size_t StatsLogProcessor::GetMetricsSize(const ConfigKey& key) const {
@@ -570,25 +627,9 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      ProtoOutputStream* proto) {
     std::lock_guard<std::mutex> lock(mMetricsMutex);
 
-    // Start of ConfigKey.
-    uint64_t configKeyToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
-    proto->write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
-    proto->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
-    proto->end(configKeyToken);
-    // End of ConfigKey.
+    writeReportPrefixLocked(key, erase_data, dumpReportReason, proto);
 
-    bool keepFile = false;
     auto it = mMetricsManagers.find(key);
-    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
-        keepFile = true;
-    }
-
-    // Then, check stats-data directory to see there's any file containing
-    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
-    StorageManager::appendConfigMetricsReport(
-            key, proto, erase_data && !keepFile /* should remove file after appending it */,
-            dumpReportReason == ADB_DUMP /*if caller is adb*/);
-
     if (it != mMetricsManagers.end()) {
         // This allows another broadcast to be sent within the rate-limit period if we get close to
         // filling the buffer again soon.
@@ -626,6 +667,181 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
     StatsdStats::getInstance().noteMetricsReportSent(key, proto.size());
 }
 
+// Copies the first size bytes of spoolFd to outFd.
+static bool copySpoolFile(int spoolFd, size_t size, int outFd) {
+    vector<uint8_t> buffer(64 * 1024);
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t amt = TEMP_FAILURE_RETRY(
+                pread(spoolFd, buffer.data(), std::min(buffer.size(), size - offset), offset));
+        if (amt <= 0 || !android::base::WriteFully(outFd, buffer.data(), amt)) {
+            return false;
+        }
+        offset += amt;
+    }
+    return true;
+}
+
+/*
+ * streamDumpReport writes serialized ConfigMetricsReportList to outFd.
+ */
+ssize_t StatsLogProcessor::streamDumpReport(const ConfigKey& key, const int64_t dumpTimeStampNs,
+                                            const bool include_current_partial_bucket,
+                                            const bool erase_data,
+                                            const DumpReportReason dumpReportReason,
+                                            const DumpLatency dumpLatency, const int outFd,
+                                            const uint32_t wrapperFieldId) {
+    ProtoOutputStream prefix;
+    sp<MetricsManager> metricsManager;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        writeReportPrefixLocked(key, erase_data, dumpReportReason, &prefix);
+        auto it = mMetricsManagers.find(key);
+        if (it != mMetricsManagers.end()) {
+            // This allows another broadcast to be sent within the rate-limit period if we get
+            // close to filling the buffer again soon.
+            mLastBroadcastTimes.erase(key);
+            metricsManager = it->second;
+        } else {
+            ALOGW("Config source %s does not exist", key.ToString().c_str());
+        }
+    }
+
+    // The report's length has to be written before it, so it cannot go out until every metric
+    // is dumped. Each metric is serialized into its own chunk, which fills in its message sizes
+    // as it goes, and is then moved to an unnamed spool file right away, so that only one metric
+    // is held in memory at a time. If the spool file can't be created, the chunks are kept in
+    // memory until the report is written.
+    auto newReportChunk = []() {
+        return std::make_unique<ProtoOutputStream>(new EncodedBuffer(), true /* inPlaceSizes */);
+    };
+    android::base::unique_fd spoolFd;
+    vector<std::unique_ptr<ProtoOutputStream>> reportChunks;
+    size_t reportSize = 0;
+    bool ok = true;
+    auto addReportChunk = [&](std::unique_ptr<ProtoOutputStream> chunk) {
+        reportSize += chunk->size();
+        if (spoolFd.ok()) {
+            ok = ok && chunk->flush(spoolFd.get());
+        } else {
+            reportChunks.push_back(std::move(chunk));
+        }
+    };
+    // Writes the chunks of the report, in order, to fd.
+    auto writeReportChunks = [&](int fd) {
+        if (spoolFd.ok()) {
+            return copySpoolFile(spoolFd.get(), reportSize, fd);
+        }
+        for (const auto& chunk : reportChunks) {
+            if (!chunk->flush(fd)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (metricsManager != nullptr) {
+        spoolFd.reset(StorageManager::openSpoolFile());
+        int64_t lastReportTimeNs = 0;
+        int64_t lastReportWallClockNs = 0;
+        int64_t reportTimeNs = dumpTimeStampNs;
+        std::set<string> str_set;
+        for (size_t i = 0;; i++) {
+            std::unique_lock<std::mutex> lock(mMetricsMutex);
+            if (i == 0) {
+                lastReportTimeNs = metricsManager->getLastReportTimeNs();
+                lastReportWallClockNs = metricsManager->getLastReportWallClockNs();
+                // Every metric is dumped at the same time. It is no earlier than the newest
+                // event seen, so no metric is dumped at a time before the events it holds.
+                reportTimeNs = std::max(dumpTimeStampNs, mLargestTimestampSeen);
+            }
+            auto it = mMetricsManagers.find(key);
+            if (i == metricsManager->getNumMetrics() || it == mMetricsManagers.end() ||
+                it->second != metricsManager) {
+                // Done, or the config was updated or removed while the lock was released. In
+                // that case the metrics not dumped yet were written to disk, and are reported
+                // next time.
+                std::unique_ptr<ProtoOutputStream> chunk = newReportChunk();
+                metricsManager->onDumpReportFinished(reportTimeNs, erase_data, chunk.get());
+                writeReportSuffixLocked(key, metricsManager, reportTimeNs, lastReportTimeNs,
+                                        lastReportWallClockNs, erase_data, dumpReportReason,
+                                        &str_set, chunk.get());
+                lock.unlock();
+                addReportChunk(std::move(chunk));
+                break;
+            }
+
+            std::unique_ptr<ProtoOutputStream> chunk = newReportChunk();
+            metricsManager->onDumpMetricReport(i, reportTimeNs, include_current_partial_bucket,
+                                               erase_data, dumpLatency, &str_set, chunk.get());
+            lock.unlock();
+            // Widening any sizes that didn't fit moves data, so do it without the lock.
+            addReportChunk(std::move(chunk));
+        }
+
+        if (ok && erase_data && metricsManager->shouldPersistLocalHistory()) {
+            VLOG("save history to disk");
+            string file_name = StorageManager::getDataHistoryFileName(
+                    (long)getWallClockSec(), key.GetUid(), key.GetId());
+            StorageManager::writeFile(file_name.c_str(), writeReportChunks);
+        }
+    }
+
+    // Room for the largest tag and length of a length-delimited field.
+    uint8_t reportHeader[20];
+    size_t reportHeaderSize = 0;
+    if (metricsManager != nullptr) {
+        reportHeaderSize =
+                write_length_delimited_tag_header(reportHeader, FIELD_ID_REPORTS, reportSize) -
+                reportHeader;
+    }
+    const size_t listSize = prefix.size() + reportHeaderSize + reportSize;
+
+    if (ok && wrapperFieldId != 0) {
+        uint8_t wrapperHeader[20];
+        size_t wrapperHeaderSize =
+                write_length_delimited_tag_header(wrapperHeader, wrapperFieldId, listSize) -
+                wrapperHeader;
+        ok = android::base::WriteFully(outFd, wrapperHeader, wrapperHeaderSize);
+    }
+    ok = ok && prefix.flush(outFd);
+    ok = ok && android::base::WriteFully(outFd, reportHeader, reportHeaderSize);
+    ok = ok && writeReportChunks(outFd);
+    if (!ok) {
+        ALOGE("Failed to write the report of config %s", key.ToString().c_str());
+        return -1;
+    }
+    VLOG("streamed report size %zu", listSize);
+    return listSize;
+}
+
+/*
+ * writeReportPrefixLocked writes the ConfigKey and the reports saved on disk, which come before
+ * the current report in ConfigMetricsReportList.
+ */
+void StatsLogProcessor::writeReportPrefixLocked(const ConfigKey& key, const bool erase_data,
+                                                const DumpReportReason dumpReportReason,
+                                                ProtoOutputStream* proto) {
+    // Start of ConfigKey.
+    uint64_t configKeyToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
+    proto->end(configKeyToken);
+    // End of ConfigKey.
+
+    bool keepFile = false;
+    auto it = mMetricsManagers.find(key);
+    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
+        keepFile = true;
+    }
+
+    // Then, check stats-data directory to see there's any file containing
+    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
+    StorageManager::appendConfigMetricsReport(
+            key, proto, erase_data && !keepFile /* should remove file after appending it */,
+            dumpReportReason == ADB_DUMP /*if caller is adb*/);
+}
+
 /*
  * onConfigMetricsReportLocked dumps serialized ConfigMetricsReport into outData.
  */
@@ -651,31 +867,9 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
     it->second->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
                              dumpLatency, &str_set, &tempProto);
 
-    // Fill in UidMap if there is at least one metric to report.
-    // This skips the uid map if it's an empty config.
-    if (it->second->getNumMetrics() > 0) {
-        uint64_t uidMapToken = tempProto.start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
-        mUidMap->appendUidMap(
-                dumpTimeStampNs, key, it->second->hashStringInReport() ? &str_set : nullptr,
-                it->second->versionStringsInReport(), it->second->installerInReport(), &tempProto);
-        tempProto.end(uidMapToken);
-    }
-
-    // Fill in the timestamps.
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                    (long long)lastReportTimeNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                    (long long)dumpTimeStampNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                    (long long)lastReportWallClockNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
-                    (long long)getWallClockNs());
-    // Dump report reason
-    tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
-
-    for (const auto& str : str_set) {
-        tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
-    }
+    writeReportSuffixLocked(key, it->second, dumpTimeStampNs, lastReportTimeNs,
+                            lastReportWallClockNs, erase_data, dumpReportReason, &str_set,
+                            &tempProto);
 
     flushProtoToBuffer(tempProto, buffer);
 
@@ -688,12 +882,53 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
     }
 }
 
+/*
+ * writeReportSuffixLocked writes the fields of ConfigMetricsReport that follow the metrics.
+ */
+void StatsLogProcessor::writeReportSuffixLocked(const ConfigKey& key,
+                                                const sp<MetricsManager>& metricsManager,
+                                                const int64_t dumpTimeStampNs,
+                                                const int64_t lastReportTimeNs,
+                                                const int64_t lastReportWallClockNs,
+                                                const bool erase_data,
+                                                const DumpReportReason dumpReportReason,
+                                                std::set<string>* str_set,
+                                                ProtoOutputStream* proto) {
+    // Fill in UidMap if there is at least one metric to report.
+    // This skips the uid map if it's an empty config.
+    if (metricsManager->getNumMetrics() > 0) {
+        uint64_t uidMapToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
+        mUidMap->appendUidMap(
+                dumpTimeStampNs, key, metricsManager->hashStringInReport() ? str_set : nullptr,
+                metricsManager->versionStringsInReport(), metricsManager->installerInReport(),
+                metricsManager->deltaUidMapInReport(), erase_data, proto);
+        proto->end(uidMapToken);
+    }
+
+    // Fill in the timestamps.
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
+                 (long long)lastReportTimeNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
+                 (long long)dumpTimeStampNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
+                 (long long)lastReportWallClockNs);
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
+                 (long long)getWallClockNs());
+    // Dump report reason
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+
+    for (const auto& str : *str_set) {
+        proto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
+    }
+}
+
 void StatsLogProcessor::resetConfigsLocked(const int64_t timestampNs,
                                            const std::vector<ConfigKey>& configs) {
     for (const auto& key : configs) {
         StatsdConfig config;
         if (StorageManager::readConfigFromDisk(key, &config)) {
-            OnConfigUpdatedLocked(timestampNs, key, config);
+            // A reset starts every metric again from nothing.
+            OnConfigUpdatedLocked(timestampNs, key, config, false /* reuseMetrics */);
             StatsdStats::getInstance().noteConfigReset(key);
         } else {
             ALOGE("Failed to read backup config from disk for : %s", key.ToString().c_str());
@@ -725,6 +960,7 @@ void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
         WriteDataToDiskLocked(key, getElapsedRealtimeNs(), CONFIG_REMOVED,
                               NO_TIME_CONSTRAINTS);
         mMetricsManagers.erase(it);
+        updateAtomDispatchLocked();
         mUidMap->OnConfigRemoved(key);
     }
     StatsdStats::getInstance().noteConfigRemoved(key);
@@ -806,9 +1042,7 @@ void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key,
     onConfigMetricsReportLocked(key, timestampNs, true /* include_current_partial_bucket*/,
                                 true /* erase_data */, dumpReportReason, dumpLatency, true,
                                 &buffer);
-    string file_name =
-            StorageManager::getDataFileName((long)getWallClockSec(), key.GetUid(), key.GetId());
-    StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
+    StorageManager::appendReportToSegment(key, (long)getWallClockSec(), buffer);
 
     // We were able to write the ConfigMetricsReport to disk, so we should trigger collection ASAP.
     mOnDiskDataConfigs.insert(key);
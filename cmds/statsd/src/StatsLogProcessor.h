@@ -66,6 +66,17 @@ public:
                       const DumpLatency dumpLatency,
                       ProtoOutputStream* proto);
 
+    // Writes the serialized ConfigMetricsReportList to outFd without building it in one buffer.
+    // The report is dumped one metric at a time, and mMetricsMutex is released in between so
+    // that events keep being processed. Every metric is dumped at the same time. If
+    // wrapperFieldId is not 0, the list is written as that length-delimited field. Returns the
+    // size of the list, or -1 if writing failed.
+    ssize_t streamDumpReport(const ConfigKey& key, const int64_t dumpTimeNs,
+                             const bool include_current_partial_bucket, const bool erase_data,
+                             const DumpReportReason dumpReportReason,
+                             const DumpLatency dumpLatency, const int outFd,
+                             const uint32_t wrapperFieldId = 0);
+
     /* Tells MetricsManager that the alarms in alarmSet have fired. Modifies anomaly alarmSet. */
     void onAnomalyAlarmFired(
             const int64_t& timestampNs,
@@ -162,6 +173,14 @@ private:
 
     std::unordered_map<ConfigKey, sp<MetricsManager>> mMetricsManagers;
 
+    // The metrics managers that an event of a given atom is dispatched to: the ones using the
+    // atom and the ones with activations. Rebuilt whenever mMetricsManagers changes.
+    std::unordered_map<int, std::vector<std::pair<ConfigKey, sp<MetricsManager>>>>
+            mMetricsManagersByAtom;
+
+    // The metrics managers that events of atoms no config uses are dispatched to.
+    std::vector<std::pair<ConfigKey, sp<MetricsManager>>> mMetricsManagersWithActivation;
+
     std::unordered_map<ConfigKey, int64_t> mLastBroadcastTimes;
 
     // Last time we sent a broadcast to this uid that the active configs had changed.
@@ -185,8 +204,11 @@ private:
 
     void resetIfConfigTtlExpiredLocked(const int64_t timestampNs);
 
+    // Unchanged metrics are taken over from the current manager of the config, unless
+    // reuseMetrics is false, as when the config is reset.
     void OnConfigUpdatedLocked(
-        const int64_t currentTimestampNs, const ConfigKey& key, const StatsdConfig& config);
+        const int64_t currentTimestampNs, const ConfigKey& key, const StatsdConfig& config,
+        bool reuseMetrics = true);
 
     void GetActiveConfigsLocked(const int uid, vector<int64_t>& outActiveConfigs);
 
@@ -219,10 +241,30 @@ private:
              (e.g., before reboot). So no need to further persist local history.*/
             const bool dataSavedToDisk, vector<uint8_t>* proto);
 
+    // Writes the ConfigKey and the reports saved on disk, which come before the current report
+    // in ConfigMetricsReportList.
+    void writeReportPrefixLocked(const ConfigKey& key, const bool erase_data,
+                                 const DumpReportReason dumpReportReason,
+                                 ProtoOutputStream* proto);
+
+    // Writes the fields of ConfigMetricsReport that follow the metrics.
+    void writeReportSuffixLocked(const ConfigKey& key, const sp<MetricsManager>& metricsManager,
+                                 const int64_t dumpTimeStampNs, const int64_t lastReportTimeNs,
+                                 const int64_t lastReportWallClockNs, const bool erase_data,
+                                 const DumpReportReason dumpReportReason,
+                                 std::set<string>* str_set, ProtoOutputStream* proto);
+
     /* Check if we should send a broadcast if approaching memory limits and if we're over, we
      * actually delete the data. */
     void flushIfNecessaryLocked(const ConfigKey& key, MetricsManager& metricsManager);
 
+    // Rebuilds the per atom dispatch lists from mMetricsManagers.
+    void updateAtomDispatchLocked();
+
+    // Returns whether any config, state tracker or hard-coded handler looks at the fields of
+    // the given atom.
+    bool isAtomUsedLocked(int atomId) const;
+
     // Maps the isolated uid in the log event to host uid if the log event contains uid fields.
     void mapIsolatedUidToHostUidIfNecessaryLocked(LogEvent* event) const;
 
@@ -285,6 +327,9 @@ private:
     FRIEND_TEST(StatsLogProcessorTest, TestRateLimitBroadcast);
     FRIEND_TEST(StatsLogProcessorTest, TestDropWhenByteSizeTooLarge);
     FRIEND_TEST(StatsLogProcessorTest, InvalidConfigRemoved);
+    FRIEND_TEST(StatsLogProcessorTest, TestConfigUpdateReusesUnchangedMetrics);
+    FRIEND_TEST(StatsLogProcessorTest, TestConfigUpdateRebuildsGaugeWithChangedTrigger);
+    FRIEND_TEST(StatsLogProcessorTest, TestAtomDispatch);
     FRIEND_TEST(StatsLogProcessorTest, TestActiveConfigMetricDiskWriteRead);
     FRIEND_TEST(StatsLogProcessorTest, TestActivationOnBoot);
     FRIEND_TEST(StatsLogProcessorTest, TestActivationOnBootMultipleActivations);
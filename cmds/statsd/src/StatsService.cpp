@@ -42,8 +42,6 @@
 using namespace android;
 
 using android::base::StringPrintf;
-using android::util::FIELD_COUNT_REPEATED;
-using android::util::FIELD_TYPE_MESSAGE;
 
 using Status = ::ndk::ScopedAStatus;
 
@@ -57,6 +55,9 @@ constexpr const char* kPermissionRegisterPullAtom = "android.permission.REGISTER
 
 #define STATS_SERVICE_DIR "/data/misc/stats-service"
 
+// Maximum number of pushed events taken off the LogEventQueue at once.
+#define LOG_EVENT_BATCH_SIZE 64
+
 // for StatsDataDumpProto
 const int FIELD_ID_REPORTS_LIST = 1;
 
@@ -173,18 +174,29 @@ StatsService::~StatsService() {
 
 /* Runs on a dedicated thread to process pushed events. */
 void StatsService::readLogs() {
+    std::vector<std::unique_ptr<LogEvent>> events;
+    events.reserve(LOG_EVENT_BATCH_SIZE);
     // Read forever..... long live statsd
     while (1) {
-        // Block until an event is available.
-        auto event = mEventQueue->waitPop();
-        // Pass it to StatsLogProcess to all configs/metrics
-        // At this point, the LogEventQueue is not blocked, so that the socketListener
-        // can read events from the socket and write to buffer to avoid data drop.
-        mProcessor->OnLogEvent(event.get());
-        // The ShellSubscriber is only used by shell for local debugging.
-        if (mShellSubscriber != nullptr) {
-            mShellSubscriber->onLogEvent(*event);
+        // Block until at least one event is available, then take everything queued so far.
+        mEventQueue->waitPopBatch(&events, LOG_EVENT_BATCH_SIZE);
+        for (auto& event : events) {
+            if (mShellSubscriber != nullptr) {
+                // The shell may be subscribed to any atom, make sure its fields are parsed (and
+                // its uids mapped) by StatsLogProcessor.
+                event->isValid();
+            }
+            // Pass it to StatsLogProcess to all configs/metrics
+            // At this point, the LogEventQueue is not blocked, so that the socketListener
+            // can read events from the socket and write to buffer to avoid data drop.
+            mProcessor->OnLogEvent(event.get());
+            // The ShellSubscriber is only used by shell for local debugging.
+            if (mShellSubscriber != nullptr) {
+                mShellSubscriber->onLogEvent(*event);
+            }
+            mEventQueue->recycle(std::move(event));
         }
+        events.clear();
     }
 }
 
@@ -263,21 +275,13 @@ void StatsService::dumpStatsdStats(int out, bool verbose, bool proto) {
  * Write stats report data in StatsDataDumpProto incident section format.
  */
 void StatsService::dumpIncidentSection(int out) {
-    ProtoOutputStream proto;
     for (const ConfigKey& configKey : mConfigManager->GetAllConfigKeys()) {
-        uint64_t reportsListToken =
-                proto.start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS_LIST);
         // Don't include the current bucket to avoid skipping buckets.
         // If we need to include the current bucket later, consider changing to NO_TIME_CONSTRAINTS
         // or other alternatives to avoid skipping buckets for pulled metrics.
-        mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(),
-                                 false /* includeCurrentBucket */, false /* erase_data */,
-                                 ADB_DUMP,
-                                 FAST,
-                                 &proto);
-        proto.end(reportsListToken);
-        proto.flush(out);
-        proto.clear();
+        mProcessor->streamDumpReport(configKey, getElapsedRealtimeNs(),
+                                     false /* includeCurrentBucket */, false /* erase_data */,
+                                     ADB_DUMP, FAST, out, FIELD_ID_REPORTS_LIST);
     }
 }
 
@@ -682,16 +686,18 @@ status_t StatsService::cmd_dump_report(int out, const Vector<String8>& args) {
             name.assign(args[2].c_str(), args[2].size());
         }
         if (good) {
-            vector<uint8_t> data;
-            mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
-                                     includeCurrentBucket, eraseData, ADB_DUMP,
-                                     NO_TIME_CONSTRAINTS,
-                                     &data);
+            ConfigKey configKey(uid, StrToInt64(name));
             if (proto) {
-                for (size_t i = 0; i < data.size(); i ++) {
-                    dprintf(out, "%c", data[i]);
+                ssize_t size = mProcessor->streamDumpReport(configKey, getElapsedRealtimeNs(),
+                                                            includeCurrentBucket, eraseData,
+                                                            ADB_DUMP, NO_TIME_CONSTRAINTS, out);
+                if (size >= 0) {
+                    StatsdStats::getInstance().noteMetricsReportSent(configKey, size);
                 }
             } else {
+                vector<uint8_t> data;
+                mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(), includeCurrentBucket,
+                                         eraseData, ADB_DUMP, NO_TIME_CONSTRAINTS, &data);
                 dprintf(out, "Non-proto stats data dump not currently supported.\n");
             }
             return android::OK;
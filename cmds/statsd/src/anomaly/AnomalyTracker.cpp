@@ -114,7 +114,9 @@ void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
         } else {
             bucket->insert({key, bucketValue});
         }
-        mSumOverPastBuckets[key] += bucketValue;
+        if (bucketValue != 0) {
+            mSumOverPastBuckets[key] += bucketValue;
+        }
     } else {
         // Bucket does not exist yet (in future or was never made), so we must make it.
         std::shared_ptr<DimToValMap> bucket = std::make_shared<DimToValMap>();
@@ -147,7 +149,10 @@ void AnomalyTracker::subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket
         return;
     }
     for (const auto& keyValuePair : *bucket) {
-        subtractValueFromSum(keyValuePair.first, keyValuePair.second);
+        // Zero values were never added to the sums, so skip looking them up.
+        if (keyValuePair.second != 0) {
+            subtractValueFromSum(keyValuePair.first, keyValuePair.second);
+        }
     }
 }
 
@@ -168,9 +173,13 @@ void AnomalyTracker::addBucketToSum(const shared_ptr<DimToValMap>& bucket) {
     if (bucket == nullptr) {
         return;
     }
-    // For each dimension present in the bucket, add its value to its corresponding sum.
+    // For each dimension present in the bucket, add its value to its corresponding sum. Zero
+    // values are skipped so that mSumOverPastBuckets never holds entries of 0.
+    mSumOverPastBuckets.reserve(mSumOverPastBuckets.size() + bucket->size());
     for (const auto& keyValuePair : *bucket) {
-        mSumOverPastBuckets[keyValuePair.first] += keyValuePair.second;
+        if (keyValuePair.second != 0) {
+            mSumOverPastBuckets[keyValuePair.first] += keyValuePair.second;
+        }
     }
 }
 
@@ -50,8 +50,9 @@ void triggerSubscribers(int64_t ruleId, int64_t metricId, const MetricDimensionK
                 }
                 break;
             case Subscription::SubscriberInformationCase::kPerfettoDetails:
-                if (!CollectPerfettoTraceAndUploadToDropbox(subscription.perfetto_details(),
-                                                            subscription.id(), ruleId, configKey)) {
+                if (!CollectPerfettoTraceAndUploadToDropboxAsync(subscription.perfetto_details(),
+                                                                 subscription.id(), ruleId,
+                                                                 configKey)) {
                     ALOGW("Failed to generate perfetto traces.");
                 }
                 break;
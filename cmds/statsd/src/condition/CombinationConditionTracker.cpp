@@ -85,13 +85,22 @@ bool CombinationConditionTracker::init(const vector<Predicate>& allConditionConf
             VLOG("Child initialization success %lld ", (long long)child);
         }
 
+        const ConditionState initialChildCondition = initialConditionCache[childIndex];
         if (allConditionTrackers[childIndex]->isSliced()) {
             setSliced(true);
             mSlicedChildren.push_back(childIndex);
+            mChildSliced.push_back(true);
         } else {
             mUnSlicedChildren.push_back(childIndex);
+            mChildSliced.push_back(false);
+            mUnSlicedChildCounts.add(initialChildCondition);
+            if (mFirstUnSlicedChild < 0) {
+                mFirstUnSlicedChild = mChildren.size();
+            }
         }
         mChildren.push_back(childIndex);
+        mChildConditions.push_back(initialChildCondition);
+        mChildCounts.add(initialChildCondition);
         mTrackerIndex.insert(childTracker->getLogTrackerIndex().begin(),
                              childTracker->getLogTrackerIndex().end());
     }
@@ -135,17 +144,28 @@ void CombinationConditionTracker::evaluateCondition(
         return;
     }
 
-    for (const int childIndex : mChildren) {
+    for (size_t i = 0; i < mChildren.size(); i++) {
+        const int childIndex = mChildren[i];
         // So far, this is fine as there is at most one child having sliced output.
         if (nonSlicedConditionCache[childIndex] == ConditionState::kNotEvaluated) {
             const sp<ConditionTracker>& child = mAllConditions[childIndex];
             child->evaluateCondition(event, eventMatcherValues, mAllConditions,
                                      nonSlicedConditionCache, conditionChangedCache);
         }
+        // Only the children whose state changed need to be propagated into the counts.
+        const ConditionState newChildCondition = nonSlicedConditionCache[childIndex];
+        if (newChildCondition != mChildConditions[i]) {
+            mChildCounts.remove(mChildConditions[i]);
+            mChildCounts.add(newChildCondition);
+            if (!mChildSliced[i]) {
+                mUnSlicedChildCounts.remove(mChildConditions[i]);
+                mUnSlicedChildCounts.add(newChildCondition);
+            }
+            mChildConditions[i] = newChildCondition;
+        }
     }
 
-    ConditionState newCondition =
-            evaluateCombinationCondition(mChildren, mLogicalOperation, nonSlicedConditionCache);
+    ConditionState newCondition = mChildCounts.evaluate(mLogicalOperation, childCondition(0));
     if (!mSliced) {
         bool nonSlicedChanged = (mUnSlicedPartCondition != newCondition);
         mUnSlicedPartCondition = newCondition;
@@ -153,8 +173,8 @@ void CombinationConditionTracker::evaluateCondition(
         nonSlicedConditionCache[mIndex] = mUnSlicedPartCondition;
         conditionChangedCache[mIndex] = nonSlicedChanged;
     } else {
-        mUnSlicedPartCondition = evaluateCombinationCondition(mUnSlicedChildren, mLogicalOperation,
-                                                              nonSlicedConditionCache);
+        mUnSlicedPartCondition = mUnSlicedChildCounts.evaluate(
+                mLogicalOperation, childCondition(mFirstUnSlicedChild));
 
         for (const int childIndex : mChildren) {
             // If any of the sliced condition in children condition changes, the combination
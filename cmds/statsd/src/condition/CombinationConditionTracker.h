@@ -102,6 +102,22 @@ private:
     std::vector<int> mSlicedChildren;
     std::vector<int> mUnSlicedChildren;
 
+    // The non-sliced state of each child as of the last evaluation, in the order of mChildren.
+    // evaluateCondition only propagates the children whose state changed into the counts, and
+    // evaluates the combination from the counts instead of walking all the children.
+    std::vector<ConditionState> mChildConditions;
+    // Whether each child, in the order of mChildren, is sliced.
+    std::vector<bool> mChildSliced;
+    ConditionStateCounts mChildCounts;
+    ConditionStateCounts mUnSlicedChildCounts;
+    // Position in mChildren of the first unsliced child, or -1.
+    int mFirstUnSlicedChild = -1;
+
+    ConditionState childCondition(int position) const {
+        return position < 0 || position >= (int)mChildConditions.size()
+                       ? ConditionState::kUnknown
+                       : mChildConditions[position];
+    }
 };
 
 }  // namespace statsd
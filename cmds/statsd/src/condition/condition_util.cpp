@@ -85,6 +85,54 @@ ConditionState evaluateCombinationCondition(const std::vector<int>& children,
     return newCondition;
 }
 
+void ConditionStateCounts::add(ConditionState state) {
+    mNumChildren++;
+    if (state == ConditionState::kUnknown) {
+        mNumUnknown++;
+    } else if (state == ConditionState::kFalse) {
+        mNumFalse++;
+    } else if (state == ConditionState::kTrue) {
+        mNumTrue++;
+    }
+}
+
+void ConditionStateCounts::remove(ConditionState state) {
+    mNumChildren--;
+    if (state == ConditionState::kUnknown) {
+        mNumUnknown--;
+    } else if (state == ConditionState::kFalse) {
+        mNumFalse--;
+    } else if (state == ConditionState::kTrue) {
+        mNumTrue--;
+    }
+}
+
+ConditionState ConditionStateCounts::evaluate(const LogicalOperation& operation,
+                                              ConditionState firstChildState) const {
+    // If any child condition is in unknown state, the condition is unknown too.
+    if (mNumUnknown > 0) {
+        return ConditionState::kUnknown;
+    }
+
+    switch (operation) {
+        case LogicalOperation::AND:
+            return mNumFalse > 0 ? ConditionState::kFalse : ConditionState::kTrue;
+        case LogicalOperation::OR:
+            return mNumTrue > 0 ? ConditionState::kTrue : ConditionState::kFalse;
+        case LogicalOperation::NOT:
+            return mNumChildren == 0 ? ConditionState::kUnknown :
+                      ((firstChildState == ConditionState::kFalse) ?
+                          ConditionState::kTrue : ConditionState::kFalse);
+        case LogicalOperation::NAND:
+            return mNumFalse > 0 ? ConditionState::kTrue : ConditionState::kFalse;
+        case LogicalOperation::NOR:
+            return mNumTrue > 0 ? ConditionState::kFalse : ConditionState::kTrue;
+        case LogicalOperation::LOGICAL_OPERATION_UNSPECIFIED:
+            return ConditionState::kFalse;
+    }
+    return ConditionState::kFalse;
+}
+
 ConditionState operator|(ConditionState l, ConditionState r) {
     return l >= r ? l : r;
 }
@@ -37,6 +37,26 @@ ConditionState operator|(ConditionState l, ConditionState r);
 ConditionState evaluateCombinationCondition(const std::vector<int>& children,
                                             const LogicalOperation& operation,
                                             const std::vector<ConditionState>& conditionCache);
+
+// Number of children of a combination condition in each state. Lets the combination be
+// re-evaluated in constant time, updating only the children whose state changed.
+class ConditionStateCounts {
+public:
+    void add(ConditionState state);
+
+    void remove(ConditionState state);
+
+    // Same as evaluateCombinationCondition over the counted children. firstChildState is the
+    // state of the first child, which is the only one NOT looks at.
+    ConditionState evaluate(const LogicalOperation& operation,
+                            ConditionState firstChildState) const;
+
+private:
+    int mNumChildren = 0;
+    int mNumUnknown = 0;
+    int mNumFalse = 0;
+    int mNumTrue = 0;
+};
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
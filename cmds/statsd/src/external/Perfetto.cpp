@@ -24,7 +24,11 @@
 #include <inttypes.h>
 #include <sys/wait.h>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace {
 const char kDropboxTag[] = "perfetto";
@@ -134,6 +138,94 @@ bool CollectPerfettoTraceAndUploadToDropbox(const PerfettoDetails& config,
     return true;
 }
 
+namespace {
+
+// Maximum number of trace launches waiting for the launcher thread. Further requests are dropped
+// until it catches up, so a storm of anomalies cannot queue up an unbounded number of forks.
+const size_t kMaxPendingTraceLaunches = 8;
+
+struct TraceLaunch {
+    PerfettoDetails config;
+    int64_t subscriptionId;
+    int64_t alertId;
+    ConfigKey configKey;
+};
+
+// Launches perfetto on a thread of its own, one trace at a time, so that the fork, the config
+// write and the wait for perfetto to detach stay out of the event processing path.
+class PerfettoTraceLauncher {
+public:
+    static PerfettoTraceLauncher& getInstance() {
+        static PerfettoTraceLauncher launcher;
+        return launcher;
+    }
+
+    bool enqueue(const PerfettoDetails& config, int64_t subscriptionId, int64_t alertId,
+                 const ConfigKey& configKey) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const TraceLaunch& pending : mPending) {
+            if (pending.subscriptionId == subscriptionId && pending.alertId == alertId &&
+                pending.configKey == configKey) {
+                VLOG("Perfetto trace for alert %" PRId64 " is already pending", alertId);
+                return true;
+            }
+        }
+        if (mPending.size() >= kMaxPendingTraceLaunches) {
+            ALOGW("Too many pending perfetto traces, dropping the trace for alert %" PRId64,
+                  alertId);
+            return false;
+        }
+
+        mPending.push_back({config, subscriptionId, alertId, configKey});
+        if (!mThreadStarted) {
+            // Detached, the launcher lives as long as statsd.
+            std::thread([this] { run(); }).detach();
+            mThreadStarted = true;
+        }
+        mPendingCondition.notify_one();
+        return true;
+    }
+
+private:
+    PerfettoTraceLauncher() = default;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mPendingCondition.wait(lock, [this] { return !mPending.empty(); });
+            // Stays in the queue while it is launched, so that the same trace is not launched
+            // again by the alerts fired in the meantime.
+            const TraceLaunch& launch = mPending.front();
+            lock.unlock();
+            if (!CollectPerfettoTraceAndUploadToDropbox(launch.config, launch.subscriptionId,
+                                                        launch.alertId, launch.configKey)) {
+                ALOGW("Failed to generate perfetto traces.");
+            }
+            lock.lock();
+            mPending.pop_front();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mPendingCondition;
+    std::deque<TraceLaunch> mPending;
+    bool mThreadStarted = false;
+};
+
+}  // namespace
+
+bool CollectPerfettoTraceAndUploadToDropboxAsync(const PerfettoDetails& config,
+                                                 int64_t subscription_id,
+                                                 int64_t alert_id,
+                                                 const ConfigKey& configKey) {
+    if (!config.has_trace_config()) {
+        ALOGE("The perfetto trace config is empty, aborting");
+        return false;
+    }
+    return PerfettoTraceLauncher::getInstance().enqueue(config, subscription_id, alert_id,
+                                                        configKey);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -32,6 +32,14 @@ bool CollectPerfettoTraceAndUploadToDropbox(const PerfettoDetails& config,
                                             int64_t alert_id,
                                             const ConfigKey& configKey);
 
+// Like CollectPerfettoTraceAndUploadToDropbox(), but starts the collection on a dedicated thread
+// and returns right away. A trace that is already waiting to be started for the same
+// subscription, alert and config is not started again. Returns false if the trace was dropped.
+bool CollectPerfettoTraceAndUploadToDropboxAsync(const PerfettoDetails& config,
+                                                 int64_t subscription_id,
+                                                 int64_t alert_id,
+                                                 const ConfigKey& configKey);
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
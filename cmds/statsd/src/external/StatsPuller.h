@@ -61,6 +61,10 @@ public:
 
     static void SetUidMap(const sp<UidMap>& uidMap);
 
+    int64_t getPullTimeoutNs() const {
+        return mPullTimeoutNs;
+    }
+
     virtual void SetStatsCompanionService(
             shared_ptr<IStatsCompanionService> statsCompanionService) {};
 
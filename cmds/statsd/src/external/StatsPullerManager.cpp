@@ -24,7 +24,12 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <set>
+#include <thread>
 
 #include "../StatsService.h"
 #include "../logd/LogEvent.h"
@@ -41,6 +46,122 @@ namespace android {
 namespace os {
 namespace statsd {
 
+// Number of threads that run alarm triggered pulls. They are shared by every alarm.
+#define ALARM_PULL_THREAD_COUNT 4
+
+namespace {
+
+// The pulls triggered by one alarm. It is shared between OnAlarmFired and the pull threads, so
+// that a pull which overruns its deadline can still finish after the alarm has been handled.
+struct AlarmPullBatch {
+    struct Task {
+        sp<StatsPuller> puller;
+        int tagId;
+        // Elapsed time by which the pull must finish, counted from when it is scheduled so that
+        // a pull waiting behind slow ones on the pull threads also times out.
+        int64_t deadlineNs = 0;
+        bool done = false;
+        bool abandoned = false;
+        bool success = false;
+        vector<shared_ptr<LogEvent>> data;
+    };
+
+    explicit AlarmPullBatch(int64_t eventTimeNs) : eventTimeNs(eventTimeNs) {
+    }
+
+    const int64_t eventTimeNs;
+
+    std::mutex lock;
+    std::condition_variable cv;
+
+    // Not resized once the pulls are scheduled.
+    vector<Task> tasks;
+
+    // Indices of the tasks that finished and are not yet delivered.
+    std::deque<size_t> finished;
+};
+
+// A fixed set of threads that run the pulls of every alarm. A puller has at most one pull
+// scheduled or running here at a time, so a pull that overran its deadline on one alarm is not
+// started again by the next one.
+class AlarmPullThreads {
+public:
+    static AlarmPullThreads& getInstance() {
+        // Never destroyed, the threads may still be running a pull at exit.
+        static AlarmPullThreads* sInstance = new AlarmPullThreads();
+        return *sInstance;
+    }
+
+    // Returns false, without scheduling anything, if the task's puller still has a pull from an
+    // earlier alarm scheduled or running.
+    bool schedule(const shared_ptr<AlarmPullBatch>& batch, size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            const StatsPuller* puller = batch->tasks[index].puller.get();
+            if (!mBusyPullers.insert(puller).second) {
+                return false;
+            }
+            mQueue.emplace_back(batch, index);
+            while (mThreadCount < ALARM_PULL_THREAD_COUNT) {
+                std::thread([this] { run(); }).detach();
+                mThreadCount++;
+            }
+        }
+        mCv.notify_one();
+        return true;
+    }
+
+private:
+    AlarmPullThreads() = default;
+
+    void run() {
+        while (true) {
+            shared_ptr<AlarmPullBatch> batch;
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                mCv.wait(lock, [this] { return !mQueue.empty(); });
+                batch = std::move(mQueue.front().first);
+                index = mQueue.front().second;
+                mQueue.pop_front();
+            }
+
+            sp<StatsPuller> puller;
+            bool abandoned;
+            {
+                std::lock_guard<std::mutex> lock(batch->lock);
+                AlarmPullBatch::Task& task = batch->tasks[index];
+                puller = task.puller;
+                abandoned = task.abandoned;
+            }
+
+            vector<shared_ptr<LogEvent>> data;
+            // Nobody waits for a pull that timed out before it could start
+            bool success = !abandoned && puller->Pull(batch->eventTimeNs, &data);
+            {
+                std::lock_guard<std::mutex> lock(batch->lock);
+                AlarmPullBatch::Task& task = batch->tasks[index];
+                task.data = std::move(data);
+                task.success = success;
+                task.done = true;
+                batch->finished.push_back(index);
+            }
+            batch->cv.notify_all();
+
+            std::lock_guard<std::mutex> lock(mLock);
+            mBusyPullers.erase(puller.get());
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::deque<std::pair<shared_ptr<AlarmPullBatch>, size_t>> mQueue;
+    std::set<const StatsPuller*> mBusyPullers;
+    int mThreadCount = 0;
+};
+
+}  // namespace
+
 // Stores the puller as a wp to avoid holding a reference in case it is unregistered and
 // pullAtomCallbackDied is never called.
 struct PullAtomCallbackDeathCookie {
@@ -107,22 +228,8 @@ bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
                                     const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
                                     bool useUids) {
     vector<int32_t> uids;
-    if (useUids) {
-        auto uidProviderIt = mPullUidProviders.find(configKey);
-        if (uidProviderIt == mPullUidProviders.end()) {
-            ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
-                  configKey.ToString().c_str());
-            StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-            return false;
-        }
-        sp<PullUidProvider> pullUidProvider = uidProviderIt->second.promote();
-        if (pullUidProvider == nullptr) {
-            ALOGE("Error pulling tag %d, pull uid provider for config %s is gone.", tagId,
-                  configKey.ToString().c_str());
-            StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-            return false;
-        }
-        uids = pullUidProvider->getPullAtomUids(tagId);
+    if (useUids && !getPullUidsLocked(tagId, configKey, &uids)) {
+        return false;
     }
     return PullLocked(tagId, uids, eventTimeNs, data, useUids);
 }
@@ -131,36 +238,58 @@ bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
                                     const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
                                     bool useUids) {
     VLOG("Initiating pulling %d", tagId);
+    sp<StatsPuller> puller = findPullerLocked(tagId, uids, useUids);
+    if (puller == nullptr) {
+        return false;  // Return early since we don't know what to pull.
+    }
+    bool ret = puller->Pull(eventTimeNs, data);
+    VLOG("pulled %zu items", data->size());
+    if (!ret) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    return ret;
+}
+
+bool StatsPullerManager::getPullUidsLocked(int tagId, const ConfigKey& configKey,
+                                           vector<int32_t>* uids) {
+    auto uidProviderIt = mPullUidProviders.find(configKey);
+    if (uidProviderIt == mPullUidProviders.end()) {
+        ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
+              configKey.ToString().c_str());
+        StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
+        return false;
+    }
+    sp<PullUidProvider> pullUidProvider = uidProviderIt->second.promote();
+    if (pullUidProvider == nullptr) {
+        ALOGE("Error pulling tag %d, pull uid provider for config %s is gone.", tagId,
+              configKey.ToString().c_str());
+        StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
+        return false;
+    }
+    *uids = pullUidProvider->getPullAtomUids(tagId);
+    return true;
+}
+
+sp<StatsPuller> StatsPullerManager::findPullerLocked(int tagId, const vector<int32_t>& uids,
+                                                     bool useUids) {
     if (useUids) {
         for (int32_t uid : uids) {
             PullerKey key = {.atomTag = tagId, .uid = uid};
             auto pullerIt = kAllPullAtomInfo.find(key);
             if (pullerIt != kAllPullAtomInfo.end()) {
-                bool ret = pullerIt->second->Pull(eventTimeNs, data);
-                VLOG("pulled %zu items", data->size());
-                if (!ret) {
-                    StatsdStats::getInstance().notePullFailed(tagId);
-                }
-                return ret;
+                return pullerIt->second;
             }
         }
         StatsdStats::getInstance().notePullerNotFound(tagId);
-        ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-        return false;  // Return early since we don't know what to pull.
     } else {
         PullerKey key = {.atomTag = tagId, .uid = -1};
         auto pullerIt = kAllPullAtomInfo.find(key);
         if (pullerIt != kAllPullAtomInfo.end()) {
-            bool ret = pullerIt->second->Pull(eventTimeNs, data);
-            VLOG("pulled %zu items", data->size());
-            if (!ret) {
-                StatsdStats::getInstance().notePullFailed(tagId);
-            }
-            return ret;
+            return pullerIt->second;
         }
-        ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-        return false;  // Return early since we don't know what to pull.
     }
+    ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
+    return nullptr;
 }
 
 bool StatsPullerManager::PullerForMatcherExists(int tagId) const {
@@ -266,6 +395,44 @@ void StatsPullerManager::UnregisterPullUidProvider(const ConfigKey& configKey,
     }
 }
 
+void StatsPullerManager::onAlarmPullFinishedLocked(const vector<ReceiverInfo*>& receivers,
+                                                   const vector<shared_ptr<LogEvent>>& data,
+                                                   bool pullSuccess, int64_t elapsedTimeNs,
+                                                   int64_t wallClockNs,
+                                                   int64_t* minNextPullTimeNs) {
+    if (!pullSuccess) {
+        VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
+    }
+
+    // Convention is to mark pull atom timestamp at request time.
+    // If we pull at t0, puller starts at t1, finishes at t2, and send back
+    // at t3, we mark t0 as its timestamp, which should correspond to its
+    // triggering event, such as condition change at t0.
+    // Here the triggering event is alarm fired from AlarmManager.
+    // In ValueMetricProducer and GaugeMetricProducer we do same thing
+    // when pull on condition change, etc.
+    for (auto& event : data) {
+        event->setElapsedTimestampNs(elapsedTimeNs);
+        event->setLogdWallClockTimestampNs(wallClockNs);
+    }
+
+    for (const auto& receiverInfo : receivers) {
+        sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
+        if (receiverPtr != nullptr) {
+            receiverPtr->onDataPulled(data, pullSuccess, elapsedTimeNs);
+            // We may have just come out of a coma, compute next pull time.
+            int numBucketsAhead =
+                    (elapsedTimeNs - receiverInfo->nextPullTimeNs) / receiverInfo->intervalNs;
+            receiverInfo->nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo->intervalNs;
+            if (receiverInfo->nextPullTimeNs < *minNextPullTimeNs) {
+                *minNextPullTimeNs = receiverInfo->nextPullTimeNs;
+            }
+        } else {
+            VLOG("receiver already gone.");
+        }
+    }
+}
+
 void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
     std::lock_guard<std::mutex> _l(mLock);
     int64_t wallClockNs = getWallClockNs();
@@ -290,42 +457,123 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
             }
         }
     }
-    for (const auto& pullInfo : needToPull) {
-        vector<shared_ptr<LogEvent>> data;
-        bool pullSuccess = PullLocked(pullInfo.first->atomTag, pullInfo.first->configKey,
-                                      elapsedTimeNs, &data);
-        if (!pullSuccess) {
-            VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
+    // The pullers are resolved while holding mLock. The pulls themselves only touch the
+    // puller, which has its own lock, so independent pulls can run concurrently. Receivers that
+    // resolve to the same puller share one pull.
+    shared_ptr<AlarmPullBatch> batch = std::make_shared<AlarmPullBatch>(elapsedTimeNs);
+    vector<vector<size_t>> taskToPullInfo;
+    std::map<const StatsPuller*, size_t> pullerToTask;
+    for (size_t i = 0; i < needToPull.size(); i++) {
+        const ReceiverKey* receiverKey = needToPull[i].first;
+        vector<int32_t> uids;
+        sp<StatsPuller> puller;
+        if (getPullUidsLocked(receiverKey->atomTag, receiverKey->configKey, &uids)) {
+            puller = findPullerLocked(receiverKey->atomTag, uids, /*useUids=*/true);
         }
+        if (puller == nullptr) {
+            onAlarmPullFinishedLocked(needToPull[i].second, {}, /*pullSuccess=*/false,
+                                      elapsedTimeNs, wallClockNs, &minNextPullTimeNs);
+            continue;
+        }
+        auto taskIt = pullerToTask.find(puller.get());
+        if (taskIt != pullerToTask.end()) {
+            taskToPullInfo[taskIt->second].push_back(i);
+            continue;
+        }
+        pullerToTask[puller.get()] = batch->tasks.size();
+        AlarmPullBatch::Task task;
+        task.puller = puller;
+        task.tagId = receiverKey->atomTag;
+        task.deadlineNs = getElapsedRealtimeNs() + puller->getPullTimeoutNs();
+        batch->tasks.push_back(std::move(task));
+        taskToPullInfo.push_back({i});
+    }
 
-        // Convention is to mark pull atom timestamp at request time.
-        // If we pull at t0, puller starts at t1, finishes at t2, and send back
-        // at t3, we mark t0 as its timestamp, which should correspond to its
-        // triggering event, such as condition change at t0.
-        // Here the triggering event is alarm fired from AlarmManager.
-        // In ValueMetricProducer and GaugeMetricProducer we do same thing
-        // when pull on condition change, etc.
-        for (auto& event : data) {
-            event->setElapsedTimestampNs(elapsedTimeNs);
-            event->setLogdWallClockTimestampNs(wallClockNs);
+    size_t outstanding = batch->tasks.size();
+    for (size_t index = 0; index < batch->tasks.size(); index++) {
+        if (AlarmPullThreads::getInstance().schedule(batch, index)) {
+            continue;
         }
+        // The pull from an earlier alarm has not returned yet. Don't stack another one on the
+        // same puller, its receivers are told this pull failed instead.
+        ALOGW("Skipping pull for atom %d, the previous pull is still running",
+              batch->tasks[index].tagId);
+        StatsdStats::getInstance().notePullFailed(batch->tasks[index].tagId);
+        for (size_t pullInfo : taskToPullInfo[index]) {
+            onAlarmPullFinishedLocked(needToPull[pullInfo].second, {}, /*pullSuccess=*/false,
+                                      elapsedTimeNs, wallClockNs, &minNextPullTimeNs);
+        }
+        std::lock_guard<std::mutex> batchLock(batch->lock);
+        batch->tasks[index].abandoned = true;
+        outstanding--;
+    }
 
-        for (const auto& receiverInfo : pullInfo.second) {
-            sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
-            if (receiverPtr != nullptr) {
-                receiverPtr->onDataPulled(data, pullSuccess, elapsedTimeNs);
-                // We may have just come out of a coma, compute next pull time.
-                int numBucketsAhead =
-                        (elapsedTimeNs - receiverInfo->nextPullTimeNs) / receiverInfo->intervalNs;
-                receiverInfo->nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo->intervalNs;
-                if (receiverInfo->nextPullTimeNs < minNextPullTimeNs) {
-                    minNextPullTimeNs = receiverInfo->nextPullTimeNs;
-                }
+    std::unique_lock<std::mutex> batchLock(batch->lock);
+    while (outstanding > 0) {
+        if (!batch->finished.empty()) {
+            size_t index = batch->finished.front();
+            batch->finished.pop_front();
+            AlarmPullBatch::Task& task = batch->tasks[index];
+            if (task.abandoned) {
+                continue;
+            }
+            vector<shared_ptr<LogEvent>> data = std::move(task.data);
+            bool pullSuccess = task.success;
+            outstanding--;
+            batchLock.unlock();
+            if (!pullSuccess) {
+                StatsdStats::getInstance().notePullFailed(task.tagId);
+            }
+            for (size_t pullInfo : taskToPullInfo[index]) {
+                onAlarmPullFinishedLocked(needToPull[pullInfo].second, data, pullSuccess,
+                                          elapsedTimeNs, wallClockNs, &minNextPullTimeNs);
+            }
+            batchLock.lock();
+            continue;
+        }
+
+        // Give up on pulls that have run past their timeout, so that one slow puller cannot
+        // delay the receivers of all the others. StatsPuller discards the late data itself.
+        const int64_t nowNs = getElapsedRealtimeNs();
+        int64_t nextDeadlineNs = INT64_MAX;
+        vector<size_t> expired;
+        for (size_t i = 0; i < batch->tasks.size(); i++) {
+            AlarmPullBatch::Task& task = batch->tasks[i];
+            if (task.done || task.abandoned) {
+                continue;
+            }
+            if (task.deadlineNs <= nowNs) {
+                task.abandoned = true;
+                expired.push_back(i);
             } else {
-                VLOG("receiver already gone.");
+                nextDeadlineNs = std::min(nextDeadlineNs, task.deadlineNs);
+            }
+        }
+        if (!expired.empty()) {
+            outstanding -= expired.size();
+            batchLock.unlock();
+            for (size_t index : expired) {
+                ALOGW("Pull for atom %d did not finish within its timeout",
+                      batch->tasks[index].tagId);
+                StatsdStats::getInstance().notePullFailed(batch->tasks[index].tagId);
+                for (size_t pullInfo : taskToPullInfo[index]) {
+                    onAlarmPullFinishedLocked(needToPull[pullInfo].second, {},
+                                              /*pullSuccess=*/false, elapsedTimeNs, wallClockNs,
+                                              &minNextPullTimeNs);
+                }
             }
+            batchLock.lock();
+            continue;
+        }
+
+        // The pull threads notify when a pull finishes.
+        if (nextDeadlineNs == INT64_MAX) {
+            batch->cv.wait(batchLock);
+        } else {
+            batch->cv.wait_for(batchLock, std::chrono::nanoseconds(nextDeadlineNs - nowNs));
         }
     }
+    batchLock.unlock();
 
     VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
          (long long)minNextPullTimeNs);
@@ -158,6 +158,20 @@ private:
     bool PullLocked(int tagId, const vector<int32_t>& uids, const int64_t eventTimeNs,
                     vector<std::shared_ptr<LogEvent>>* data, bool useUids);
 
+    // Fills uids with the uids to pull tagId from for configKey. Returns false if the config
+    // has no live PullUidProvider.
+    bool getPullUidsLocked(int tagId, const ConfigKey& configKey, vector<int32_t>* uids);
+
+    // Returns the puller registered for tagId and the first uid that has one, or nullptr.
+    sp<StatsPuller> findPullerLocked(int tagId, const vector<int32_t>& uids, bool useUids);
+
+    // Hands the result of an alarm triggered pull to its receivers and schedules their next
+    // pull.
+    void onAlarmPullFinishedLocked(const vector<ReceiverInfo*>& receivers,
+                                   const vector<std::shared_ptr<LogEvent>>& data,
+                                   bool pullSuccess, int64_t elapsedTimeNs, int64_t wallClockNs,
+                                   int64_t* minNextPullTimeNs);
+
     // locks for data receiver and StatsCompanionService changes
     std::mutex mLock;
 
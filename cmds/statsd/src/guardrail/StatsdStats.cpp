@@ -121,7 +121,7 @@ const std::map<int, std::pair<size_t, size_t>> StatsdStats::kAtomDimensionKeySiz
 };
 
 StatsdStats::StatsdStats() {
-    mPushedAtomStats.resize(kMaxPushedAtomId + 1);
+    std::fill(mPushedAtomStats.begin(), mPushedAtomStats.end(), 0);
     mStartTimeSec = getWallClockSec();
 }
 
@@ -170,6 +170,7 @@ void StatsdStats::noteConfigReceived(
 }
 
 void StatsdStats::noteConfigRemovedInternalLocked(const ConfigKey& key) {
+    foldMatcherStatsLocked();
     auto it = mConfigStats.find(key);
     if (it != mConfigStats.end()) {
         int32_t nowTimeSec = getWallClockSec();
@@ -369,13 +370,29 @@ void StatsdStats::noteMetricDimensionInConditionSize(
 }
 
 void StatsdStats::noteMatcherMatched(const ConfigKey& key, const int64_t& id) {
-    lock_guard<std::mutex> lock(mLock);
-
-    auto statsIt = mConfigStats.find(key);
-    if (statsIt == mConfigStats.end()) {
-        return;
+    // This is called for every matched event, so it only touches the calling thread's shard.
+    static std::atomic<size_t> nextShard(0);
+    thread_local const size_t shardIndex = nextShard++ % kMatcherStatsShardCount;
+
+    MatcherStatsShard& shard = mMatcherStatsShards[shardIndex];
+    lock_guard<std::mutex> lock(shard.mutex);
+    shard.counts[key][id]++;
+}
+
+void StatsdStats::foldMatcherStatsLocked() const {
+    for (MatcherStatsShard& shard : mMatcherStatsShards) {
+        lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& configCounts : shard.counts) {
+            auto statsIt = mConfigStats.find(configCounts.first);
+            if (statsIt == mConfigStats.end()) {
+                continue;
+            }
+            for (const auto& count : configCounts.second) {
+                statsIt->second->matcher_stats[count.first] += count.second;
+            }
+        }
+        shard.counts.clear();
     }
-    statsIt->second->matcher_stats[id]++;
 }
 
 void StatsdStats::noteAnomalyDeclared(const ConfigKey& key, const int64_t& id) {
@@ -457,11 +474,10 @@ void StatsdStats::notePullExceedMaxDelay(int pullAtomId) {
 }
 
 void StatsdStats::noteAtomLogged(int atomId, int32_t timeSec) {
-    lock_guard<std::mutex> lock(mLock);
-
     if (atomId >= 0 && atomId <= kMaxPushedAtomId) {
-        mPushedAtomStats[atomId]++;
+        mPushedAtomStats[atomId].fetch_add(1, std::memory_order_relaxed);
     } else {
+        lock_guard<std::mutex> lock(mLock);
         if (atomId < 0) {
             android_errorWriteLog(0x534e4554, "187957589");
         }
@@ -599,6 +615,7 @@ void StatsdStats::reset() {
 void StatsdStats::resetInternalLocked() {
     // Reset the historical data, but keep the active ConfigStats
     mStartTimeSec = getWallClockSec();
+    foldMatcherStatsLocked();
     mIceBox.clear();
     std::fill(mPushedAtomStats.begin(), mPushedAtomStats.end(), 0);
     mNonPlatformPushedAtomStats.clear();
@@ -669,6 +686,7 @@ int StatsdStats::getPushedAtomErrors(int atomId) const {
 
 void StatsdStats::dumpStats(int out) const {
     lock_guard<std::mutex> lock(mLock);
+    foldMatcherStatsLocked();
     time_t t = mStartTimeSec;
     struct tm* tm = localtime(&t);
     char timeBuffer[80];
@@ -770,8 +788,9 @@ void StatsdStats::dumpStats(int out) const {
     dprintf(out, "********Pushed Atom stats***********\n");
     const size_t atomCounts = mPushedAtomStats.size();
     for (size_t i = 2; i < atomCounts; i++) {
-        if (mPushedAtomStats[i] > 0) {
-            dprintf(out, "Atom %zu->(total count)%d, (error count)%d\n", i, mPushedAtomStats[i],
+        const int count = mPushedAtomStats[i].load(std::memory_order_relaxed);
+        if (count > 0) {
+            dprintf(out, "Atom %zu->(total count)%d, (error count)%d\n", i, count,
                     getPushedAtomErrors((int)i));
         }
     }
@@ -969,6 +988,7 @@ void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* pr
 
 void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
     lock_guard<std::mutex> lock(mLock);
+    foldMatcherStatsLocked();
 
     ProtoOutputStream proto;
     proto.write(FIELD_TYPE_INT32 | FIELD_ID_BEGIN_TIME, mStartTimeSec);
@@ -984,11 +1004,12 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
 
     const size_t atomCounts = mPushedAtomStats.size();
     for (size_t i = 2; i < atomCounts; i++) {
-        if (mPushedAtomStats[i] > 0) {
+        const int count = mPushedAtomStats[i].load(std::memory_order_relaxed);
+        if (count > 0) {
             uint64_t token =
                     proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_STATS | FIELD_COUNT_REPEATED);
             proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_TAG, (int32_t)i);
-            proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, mPushedAtomStats[i]);
+            proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_COUNT, count);
             int errors = getPushedAtomErrors(i);
             if (errors > 0) {
                 proto.write(FIELD_TYPE_INT32 | FIELD_ID_ATOM_STATS_ERROR_COUNT, errors);
@@ -19,6 +19,8 @@
 
 #include <gtest/gtest_prod.h>
 #include <log/log_time.h>
+#include <array>
+#include <atomic>
 #include <list>
 #include <mutex>
 #include <string>
@@ -563,10 +565,26 @@ private:
     std::list<const std::shared_ptr<ConfigStats>> mIceBox;
 
     // Stores the number of times a pushed atom is logged.
-    // The size of the vector is the largest pushed atom id in atoms.proto + 1. Atoms
+    // The size of the array is the largest pushed atom id in atoms.proto + 1. Atoms
     // out of that range will be put in mNonPlatformPushedAtomStats.
-    // This is a vector, not a map because it will be accessed A LOT -- for each stats log.
-    std::vector<int> mPushedAtomStats;
+    // This is an array of atomics, not a map because it will be accessed A LOT -- for each stats
+    // log -- and incrementing it must not contend on mLock.
+    std::array<std::atomic<int>, kMaxPushedAtomId + 1> mPushedAtomStats;
+
+    // Number of shards for the matcher counters. Each thread that notes a matched matcher always
+    // uses the same shard, so concurrent writers rarely share a shard lock.
+    static const size_t kMatcherStatsShardCount = 8;
+
+    // Matched counts noted since the last fold, by config key and matcher id.
+    struct MatcherStatsShard {
+        std::mutex mutex;
+        std::unordered_map<ConfigKey, std::unordered_map<int64_t, int>> counts;
+    };
+    mutable std::array<MatcherStatsShard, kMatcherStatsShardCount> mMatcherStatsShards;
+
+    // Adds the counts pending in mMatcherStatsShards to the matcher_stats of mConfigStats.
+    // Counts for configs that are no longer tracked are dropped.
+    void foldMatcherStatsLocked() const;
 
     // Stores the number of times a pushed atom is logged for atom ids above kMaxPushedAtomId.
     // The max size of the map is kMaxNonPlatformPushedAtoms.
@@ -71,6 +71,24 @@ LogEvent::LogEvent(int32_t uid, int32_t pid)
     : mLogdTimestampNs(time(nullptr)), mLogUid(uid), mLogPid(pid) {
 }
 
+void LogEvent::reset(int32_t uid, int32_t pid) {
+    mValues.clear();
+    mValid = true;
+    mRawBuffer.clear();
+    mFieldsDeferred = false;
+    mLogdTimestampNs = time(nullptr);
+    mElapsedTimestampNs = 0;
+    mTagId = 0;
+    mLogUid = uid;
+    mLogPid = pid;
+    mTruncateTimestamp = false;
+    mResetState = -1;
+    mUidFieldIndex = -1;
+    mAttributionChainStartIndex = -1;
+    mAttributionChainEndIndex = -1;
+    mExclusiveStateFieldIndex = -1;
+}
+
 LogEvent::LogEvent(const string& trainName, int64_t trainVersionCode, bool requiresStaging,
                    bool rollbackEnabled, bool requiresLowLatencyMonitor, int32_t state,
                    const std::vector<uint8_t>& experimentIds, int32_t userId) {
@@ -365,9 +383,38 @@ bool LogEvent::parseBuffer(uint8_t* buf, size_t len) {
     mBuf = buf;
     mRemainingLen = (uint32_t)len;
 
-    int32_t pos[] = {1, 1, 1};
-    bool last[] = {false, false, false};
+    uint8_t numElements = parseHeader();
+    parseFields(numElements);
+
+    mBuf = nullptr;
+    return mValid;
+}
+
+bool LogEvent::parseBufferDeferred(const uint8_t* buf, size_t len) {
+    mRawBuffer.assign(buf, buf + len);
+    mBuf = mRawBuffer.data();
+    mRemainingLen = (uint32_t)len;
+
+    mNumDeferredElements = parseHeader();
+    mDeferredFieldsOffset = (uint32_t)(mBuf - mRawBuffer.data());
+    // An invalid header is reported right away, like parseBuffer does.
+    mFieldsDeferred = mValid;
+
+    mBuf = nullptr;
+    return mValid;
+}
+
+void LogEvent::parseDeferredFields() {
+    mFieldsDeferred = false;
+    mBuf = mRawBuffer.data() + mDeferredFieldsOffset;
+    mRemainingLen = (uint32_t)mRawBuffer.size() - mDeferredFieldsOffset;
+
+    parseFields(mNumDeferredElements);
+
+    mBuf = nullptr;
+}
 
+uint8_t LogEvent::parseHeader() {
     // Beginning of buffer is OBJECT_TYPE | NUM_FIELDS | TIMESTAMP | ATOM_ID
     uint8_t typeInfo = readNextValue<uint8_t>();
     if (getTypeId(typeInfo) != OBJECT_TYPE) mValid = false;
@@ -385,6 +432,13 @@ bool LogEvent::parseBuffer(uint8_t* buf, size_t len) {
     mTagId = readNextValue<int32_t>();
     numElements--;
     parseAnnotations(getNumAnnotations(typeInfo));  // atom-level annotations
+    return numElements;
+}
+
+void LogEvent::parseFields(uint8_t numElements) {
+    int32_t pos[] = {1, 1, 1};
+    bool last[] = {false, false, false};
+    uint8_t typeInfo;
 
     for (pos[0] = 1; pos[0] <= numElements && mValid; pos[0]++) {
         last[0] = (pos[0] == numElements);
@@ -428,8 +482,6 @@ bool LogEvent::parseBuffer(uint8_t* buf, size_t len) {
     }
 
     if (mRemainingLen != 0) mValid = false;
-    mBuf = nullptr;
-    return mValid;
 }
 
 uint8_t LogEvent::getTypeId(uint8_t typeInfo) {
@@ -441,6 +493,7 @@ uint8_t LogEvent::getNumAnnotations(uint8_t typeInfo) {
 }
 
 int64_t LogEvent::GetLong(size_t key, status_t* err) const {
+    ensureFieldsParsed();
     // TODO(b/110561208): encapsulate the magical operations in Field struct as static functions
     int field = getSimpleField(key);
     for (const auto& value : mValues) {
@@ -464,6 +517,7 @@ int64_t LogEvent::GetLong(size_t key, status_t* err) const {
 }
 
 int LogEvent::GetInt(size_t key, status_t* err) const {
+    ensureFieldsParsed();
     int field = getSimpleField(key);
     for (const auto& value : mValues) {
         if (value.mField.getField() == field) {
@@ -484,6 +538,7 @@ int LogEvent::GetInt(size_t key, status_t* err) const {
 }
 
 const char* LogEvent::GetString(size_t key, status_t* err) const {
+    ensureFieldsParsed();
     int field = getSimpleField(key);
     for (const auto& value : mValues) {
         if (value.mField.getField() == field) {
@@ -504,6 +559,7 @@ const char* LogEvent::GetString(size_t key, status_t* err) const {
 }
 
 bool LogEvent::GetBool(size_t key, status_t* err) const {
+    ensureFieldsParsed();
     int field = getSimpleField(key);
     for (const auto& value : mValues) {
         if (value.mField.getField() == field) {
@@ -526,6 +582,7 @@ bool LogEvent::GetBool(size_t key, status_t* err) const {
 }
 
 float LogEvent::GetFloat(size_t key, status_t* err) const {
+    ensureFieldsParsed();
     int field = getSimpleField(key);
     for (const auto& value : mValues) {
         if (value.mField.getField() == field) {
@@ -546,6 +603,7 @@ float LogEvent::GetFloat(size_t key, status_t* err) const {
 }
 
 std::vector<uint8_t> LogEvent::GetStorage(size_t key, status_t* err) const {
+    ensureFieldsParsed();
     int field = getSimpleField(key);
     for (const auto& value : mValues) {
         if (value.mField.getField() == field) {
@@ -566,6 +624,7 @@ std::vector<uint8_t> LogEvent::GetStorage(size_t key, status_t* err) const {
 }
 
 string LogEvent::ToString() const {
+    ensureFieldsParsed();
     string result;
     result += StringPrintf("{ uid(%d) %lld %lld (%d)", mLogUid, (long long)mLogdTimestampNs,
                            (long long)mElapsedTimestampNs, mTagId);
@@ -578,10 +637,12 @@ string LogEvent::ToString() const {
 }
 
 void LogEvent::ToProto(ProtoOutputStream& protoOutput) const {
+    ensureFieldsParsed();
     writeFieldValueTreeToStream(mTagId, getValues(), &protoOutput);
 }
 
 bool LogEvent::hasAttributionChain(std::pair<int, int>* indexRange) const {
+    ensureFieldsParsed();
     if (mAttributionChainStartIndex == -1 || mAttributionChainEndIndex == -1) {
         return false;
     }
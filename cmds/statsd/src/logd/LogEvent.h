@@ -50,6 +50,12 @@ public:
      */
     explicit LogEvent(int32_t uid, int32_t pid);
 
+    /**
+     * Returns the event to the state of a freshly constructed LogEvent(uid, pid), keeping the
+     * storage of mValues so that an event can be reused for the next atom.
+     */
+    void reset(int32_t uid, int32_t pid);
+
     /**
      * Parses the atomId, timestamp, and vector of values from a buffer
      * containing the StatsEvent/AStatsEvent encoding of an atom.
@@ -62,6 +68,24 @@ public:
      */
     bool parseBuffer(uint8_t* buf, size_t len);
 
+    /**
+     * Like parseBuffer, but only parses the timestamp, atom id and atom-level annotations right
+     * away. The buffer is copied into the event, and the fields are parsed from that copy the
+     * first time anything that depends on them (values, field indexes, validity) is accessed,
+     * so atoms nobody looks at never pay for materializing their FieldValues.
+     *
+     * \return success of parsing the header; isValid() also checks the fields
+     */
+    bool parseBufferDeferred(const uint8_t* buf, size_t len);
+
+    /**
+     * Returns true while the fields of an event parsed with parseBufferDeferred have not been
+     * parsed yet.
+     */
+    inline bool hasDeferredFields() const {
+        return mFieldsDeferred;
+    }
+
     // Constructs a BinaryPushStateChanged LogEvent from API call.
     explicit LogEvent(const std::string& trainName, int64_t trainVersionCode, bool requiresStaging,
                       bool rollbackEnabled, bool requiresLowLatencyMonitor, int32_t state,
@@ -133,19 +157,23 @@ public:
     }
 
     inline int size() const {
+        ensureFieldsParsed();
         return mValues.size();
     }
 
     const std::vector<FieldValue>& getValues() const {
+        ensureFieldsParsed();
         return mValues;
     }
 
     std::vector<FieldValue>* getMutableValues() {
+        ensureFieldsParsed();
         return &mValues;
     }
 
     // Default value = false
     inline bool shouldTruncateTimestamp() const {
+        ensureFieldsParsed();
         return mTruncateTimestamp;
     }
 
@@ -160,6 +188,7 @@ public:
     //    }
     // Note that atomIndex is 1-indexed.
     inline int getUidFieldIndex() {
+        ensureFieldsParsed();
         return static_cast<int>(mUidFieldIndex);
     }
 
@@ -179,21 +208,25 @@ public:
     //    }
     // Note that atomIndex is 1-indexed.
     inline int getExclusiveStateFieldIndex() const {
+        ensureFieldsParsed();
         return static_cast<int>(mExclusiveStateFieldIndex);
     }
 
     // If a reset state is not sent in the StatsEvent, returns -1. Note that a
     // reset state is sent if and only if a reset should be triggered.
     inline int getResetState() const {
+        ensureFieldsParsed();
         return mResetState;
     }
 
     inline LogEvent makeCopy() {
+        ensureFieldsParsed();
         return LogEvent(*this);
     }
 
     template <class T>
     status_t updateValue(size_t key, T& value, Type type) {
+        ensureFieldsParsed();
         int field = getSimpleField(key);
         for (auto& fieldValue : mValues) {
             if (fieldValue.mField.getField() == field) {
@@ -209,6 +242,7 @@ public:
     }
 
     bool isValid() const {
+        ensureFieldsParsed();
         return mValid;
     }
 
@@ -237,6 +271,18 @@ private:
     void parseStateNestedAnnotation(uint8_t annotationType);
     bool checkPreviousValueType(Type expected);
 
+    // Parses the beginning of mBuf up to the first field, returns the number of fields.
+    uint8_t parseHeader();
+    void parseFields(uint8_t numElements);
+    void parseDeferredFields();
+
+    inline void ensureFieldsParsed() const {
+        if (mFieldsDeferred) {
+            // Parsing on first access doesn't change the observable state of the event.
+            const_cast<LogEvent*>(this)->parseDeferredFields();
+        }
+    }
+
     /**
      * The below two variables are only valid during the execution of
      * parseBuffer. There are no guarantees about the state of these variables
@@ -247,6 +293,13 @@ private:
 
     bool mValid = true; // stores whether the event we received from the socket is valid
 
+    // Copy of the encoded atom kept by parseBufferDeferred until its fields are parsed. The
+    // storage is kept when the event is reset, so recycled events don't allocate it again.
+    std::vector<uint8_t> mRawBuffer;
+    uint32_t mDeferredFieldsOffset = 0;
+    uint8_t mNumDeferredElements = 0;
+    bool mFieldsDeferred = false;
+
     /**
      * Side-effects:
      *    If there is enough space in buffer to read value of type T
@@ -26,35 +26,181 @@ namespace statsd {
 using std::unique_lock;
 using std::unique_ptr;
 
-unique_ptr<LogEvent> LogEventQueue::waitPop() {
-    std::unique_lock<std::mutex> lock(mMutex);
+// Upper bound on the number of consumed events kept around to be reused.
+const size_t kMaxFreeEvents = 128;
+
+LogEventQueue::Ring::Ring(size_t capacity)
+    : mCapacity(capacity), mSlots(new Slot[capacity]), mHead(0), mTail(0) {
+    for (size_t i = 0; i < mCapacity; i++) {
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        mSlots[i].timestampNs.store(0, std::memory_order_relaxed);
+        mSlots[i].event = nullptr;
+    }
+}
+
+bool LogEventQueue::Ring::push(LogEvent* event, int64_t timestampNs) {
+    size_t pos = mTail.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &mSlots[pos % mCapacity];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The slot still holds the event pushed one lap ago.
+            return false;
+        } else {
+            pos = mTail.load(std::memory_order_relaxed);
+        }
+    }
+    slot->event = event;
+    slot->timestampNs.store(timestampNs, std::memory_order_relaxed);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
 
-    if (mQueue.empty()) {
-        mCondition.wait(lock, [this] { return !this->mQueue.empty(); });
+LogEvent* LogEventQueue::Ring::pop() {
+    size_t pos = mHead.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &mSlots[pos % mCapacity];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Nothing has been pushed to this position yet.
+            return nullptr;
+        } else {
+            pos = mHead.load(std::memory_order_relaxed);
+        }
     }
+    LogEvent* event = slot->event;
+    slot->event = nullptr;
+    slot->sequence.store(pos + mCapacity, std::memory_order_release);
+    return event;
+}
+
+int64_t LogEventQueue::Ring::oldestTimestampNs() const {
+    // The timestamp is kept in the slot, so this is safe even if the consumer pops, and frees,
+    // the oldest event concurrently. The result is then merely one event stale.
+    const Slot& slot = mSlots[mHead.load(std::memory_order_relaxed) % mCapacity];
+    return slot.timestampNs.load(std::memory_order_relaxed);
+}
 
-    unique_ptr<LogEvent> item = std::move(mQueue.front());
-    mQueue.pop();
+LogEventQueue::LogEventQueue(size_t maxSize)
+    : mEvents(maxSize), mFreeEvents(kMaxFreeEvents), mConsumerWaiting(false) {
+}
+
+LogEventQueue::~LogEventQueue() {
+    while (LogEvent* event = mEvents.pop()) {
+        delete event;
+    }
+    while (LogEvent* event = mFreeEvents.pop()) {
+        delete event;
+    }
+}
 
-    return item;
+size_t LogEventQueue::popAvailable(std::vector<unique_ptr<LogEvent>>* events, size_t maxCount) {
+    size_t count = 0;
+    while (count < maxCount) {
+        LogEvent* event = mEvents.pop();
+        if (event == nullptr) {
+            break;
+        }
+        events->emplace_back(event);
+        count++;
+    }
+    return count;
+}
+
+size_t LogEventQueue::waitPopBatch(std::vector<unique_ptr<LogEvent>>* events, size_t maxCount) {
+    size_t count = popAvailable(events, maxCount);
+    if (count > 0 || maxCount == 0) {
+        return count;
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mConsumerWaiting.store(true);
+    // Pairs with the fence in push(): either the producer sees mConsumerWaiting and wakes us up,
+    // or we see its event when checking the ring below.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    mCondition.wait(lock, [&] { return (count = popAvailable(events, maxCount)) > 0; });
+    mConsumerWaiting.store(false);
+    return count;
+}
+
+unique_ptr<LogEvent> LogEventQueue::waitPop() {
+    std::vector<unique_ptr<LogEvent>> events;
+    waitPopBatch(&events, 1);
+    return std::move(events.front());
+}
+
+bool LogEventQueue::pushOne(unique_ptr<LogEvent> item, int64_t* oldestTimestampNs) {
+    int64_t timestampNs = item->GetElapsedTimestampNs();
+    LogEvent* event = item.release();
+    if (!mEvents.push(event, timestampNs)) {
+        *oldestTimestampNs = mEvents.oldestTimestampNs();
+        recycle(unique_ptr<LogEvent>(event));
+        return false;
+    }
+    return true;
+}
+
+void LogEventQueue::wakeConsumer() {
+    // Pairs with the fence in waitPopBatch().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mConsumerWaiting.load()) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCondition.notify_one();
+    }
 }
 
 bool LogEventQueue::push(unique_ptr<LogEvent> item, int64_t* oldestTimestampNs) {
-    bool success;
-    {
-        std::unique_lock<std::mutex> lock(mMutex);
-        if (mQueue.size() < mQueueLimit) {
-            mQueue.push(std::move(item));
-            success = true;
-        } else {
-            // safe operation as queue must not be empty.
-            *oldestTimestampNs = mQueue.front()->GetElapsedTimestampNs();
-            success = false;
+    if (!pushOne(std::move(item), oldestTimestampNs)) {
+        return false;
+    }
+    wakeConsumer();
+    return true;
+}
+
+size_t LogEventQueue::pushBatch(std::vector<unique_ptr<LogEvent>>* events,
+                                int64_t* oldestTimestampNs) {
+    size_t dropped = 0;
+    for (auto& event : *events) {
+        if (!pushOne(std::move(event), oldestTimestampNs)) {
+            dropped++;
         }
     }
+    if (dropped < events->size()) {
+        wakeConsumer();
+    }
+    events->clear();
+    return dropped;
+}
 
-    mCondition.notify_one();
-    return success;
+unique_ptr<LogEvent> LogEventQueue::obtain(int32_t uid, int32_t pid) {
+    LogEvent* event = mFreeEvents.pop();
+    if (event == nullptr) {
+        return std::make_unique<LogEvent>(uid, pid);
+    }
+    event->reset(uid, pid);
+    return unique_ptr<LogEvent>(event);
+}
+
+void LogEventQueue::recycle(unique_ptr<LogEvent> event) {
+    if (event == nullptr) {
+        return;
+    }
+    LogEvent* raw = event.release();
+    if (!mFreeEvents.push(raw, 0)) {
+        delete raw;
+    }
 }
 
 }  // namespace statsd
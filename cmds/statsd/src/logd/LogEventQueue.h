@@ -18,9 +18,11 @@
 
 #include "LogEvent.h"
 
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -28,16 +30,27 @@ namespace statsd {
 
 /**
  * A zero copy thread safe queue buffer for producing and consuming LogEvent.
+ *
+ * Events are passed through a preallocated lock-free ring, so pushing never takes a lock unless
+ * the consumer is asleep waiting for events. Consumed events can be handed back with recycle(),
+ * and are then reused by obtain() instead of allocating a new LogEvent for every atom.
  */
 class LogEventQueue {
 public:
-    explicit LogEventQueue(size_t maxSize) : mQueueLimit(maxSize){};
+    explicit LogEventQueue(size_t maxSize);
+    ~LogEventQueue();
 
     /**
      * Blocking read one event from the queue.
      */
     std::unique_ptr<LogEvent> waitPop();
 
+    /**
+     * Blocks until the queue isn't empty, then moves up to maxCount events, oldest first, to the
+     * end of events. Returns the number of events that were moved.
+     */
+    size_t waitPopBatch(std::vector<std::unique_ptr<LogEvent>>* events, size_t maxCount);
+
     /**
      * Puts a LogEvent ptr to the end of the queue.
      * Returns false on failure when the queue is full, and output the oldest event timestamp
@@ -45,11 +58,67 @@ public:
      */
     bool push(std::unique_ptr<LogEvent> event, int64_t* oldestTimestampNs);
 
+    /**
+     * Puts all events to the end of the queue, in order, waking the consumer at most once. The
+     * events vector is left empty. Returns the number of events dropped because the queue was
+     * full, in which case oldestTimestampNs is set as in push().
+     */
+    size_t pushBatch(std::vector<std::unique_ptr<LogEvent>>* events, int64_t* oldestTimestampNs);
+
+    /**
+     * Returns an empty LogEvent for the given client to parse an atom into, reusing a recycled
+     * event when there is one.
+     */
+    std::unique_ptr<LogEvent> obtain(int32_t uid, int32_t pid);
+
+    /**
+     * Hands an event that has been fully processed back to the queue, so that obtain() can reuse
+     * it. The event is simply freed if enough events are already waiting to be reused.
+     */
+    void recycle(std::unique_ptr<LogEvent> event);
+
 private:
-    const size_t mQueueLimit;
+    /**
+     * A bounded ring of LogEvent pointers that any number of threads can push to and pop from
+     * without locking. Each slot carries a sequence number which tells whether it is ready to be
+     * written or read for a given position, see http://www.1024cores.net.
+     */
+    class Ring {
+    public:
+        explicit Ring(size_t capacity);
+
+        // Returns false if the ring is full.
+        bool push(LogEvent* event, int64_t timestampNs);
+        // Returns nullptr if the ring is empty.
+        LogEvent* pop();
+        // Returns the timestamp of the oldest event, only meaningful when push just failed.
+        int64_t oldestTimestampNs() const;
+
+    private:
+        struct Slot {
+            std::atomic<size_t> sequence;
+            std::atomic<int64_t> timestampNs;
+            LogEvent* event;
+        };
+
+        const size_t mCapacity;
+        std::unique_ptr<Slot[]> mSlots;
+        // Kept on separate cache lines, the producer only touches mTail and the consumer mHead.
+        alignas(64) std::atomic<size_t> mHead;
+        alignas(64) std::atomic<size_t> mTail;
+    };
+
+    bool pushOne(std::unique_ptr<LogEvent> event, int64_t* oldestTimestampNs);
+    void wakeConsumer();
+    size_t popAvailable(std::vector<std::unique_ptr<LogEvent>>* events, size_t maxCount);
+
+    Ring mEvents;
+    Ring mFreeEvents;
+
+    // Only used to sleep while the queue is empty, producers only lock it to wake the consumer.
+    std::atomic<bool> mConsumerWaiting;
     std::condition_variable mCondition;
     std::mutex mMutex;
-    std::queue<std::unique_ptr<LogEvent>> mQueue;
 };
 
 }  // namespace statsd
@@ -45,7 +45,8 @@ public:
                     std::vector<MatchingState>& matcherResults) override;
 
 private:
-    const SimpleAtomMatcher mMatcher;
+    // Compiled once here, since the matcher sees every event of its atom.
+    const CompiledAtomMatcher mMatcher;
     const UidMap& mUidMap;
 };
 
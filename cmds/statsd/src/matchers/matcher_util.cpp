@@ -81,22 +81,144 @@ bool combinationMatch(const vector<int>& children, const LogicalOperation& opera
     return matched;
 }
 
-bool tryMatchString(const UidMap& uidMap, const FieldValue& fieldValue, const string& str_match) {
+namespace {
+
+CompiledFieldValueMatcher compileFieldValueMatcher(const FieldValueMatcher& matcher) {
+    CompiledFieldValueMatcher compiled;
+    compiled.field = matcher.field();
+    compiled.position = matcher.has_position() ? matcher.position() : Position::POSITION_UNKNOWN;
+    compiled.hasPosition = matcher.has_position();
+    compiled.valueCase = matcher.value_matcher_case();
+
+    vector<string> strings;
+    switch (compiled.valueCase) {
+        case FieldValueMatcher::kMatchesTuple:
+            for (const auto& subMatcher : matcher.matches_tuple().field_value_matcher()) {
+                compiled.children.push_back(compileFieldValueMatcher(subMatcher));
+            }
+            break;
+        case FieldValueMatcher::kEqBool:
+            compiled.intValue = matcher.eq_bool();
+            break;
+        case FieldValueMatcher::kEqString:
+            strings.push_back(matcher.eq_string());
+            break;
+        case FieldValueMatcher::kEqAnyString:
+            strings.assign(matcher.eq_any_string().str_value().begin(),
+                           matcher.eq_any_string().str_value().end());
+            break;
+        case FieldValueMatcher::kNeqAnyString:
+            strings.assign(matcher.neq_any_string().str_value().begin(),
+                           matcher.neq_any_string().str_value().end());
+            break;
+        case FieldValueMatcher::kEqInt:
+            compiled.intValue = matcher.eq_int();
+            break;
+        case FieldValueMatcher::kLtInt:
+            compiled.intValue = matcher.lt_int();
+            break;
+        case FieldValueMatcher::kGtInt:
+            compiled.intValue = matcher.gt_int();
+            break;
+        case FieldValueMatcher::kLteInt:
+            compiled.intValue = matcher.lte_int();
+            break;
+        case FieldValueMatcher::kGteInt:
+            compiled.intValue = matcher.gte_int();
+            break;
+        case FieldValueMatcher::kLtFloat:
+            compiled.floatValue = matcher.lt_float();
+            break;
+        case FieldValueMatcher::kGtFloat:
+            compiled.floatValue = matcher.gt_float();
+            break;
+        default:
+            break;
+    }
+    for (const string& str : strings) {
+        compiled.strings.insert(str);
+        // Against a uid field, a string naming an AID only matches that AID's uid.
+        auto aidIt = UidMap::sAidToUidMapping.find(str);
+        if (aidIt != UidMap::sAidToUidMapping.end()) {
+            compiled.aidUids.insert(aidIt->second);
+        } else {
+            compiled.packageNames.insert(str);
+        }
+    }
+    return compiled;
+}
+
+// Returns true if the value matches any of the matcher's strings. Uid fields match by AID or by
+// the names of the packages running as that uid.
+bool matchesAnyString(const UidMap& uidMap, const FieldValue& fieldValue,
+                      const CompiledFieldValueMatcher& matcher) {
     if (isAttributionUidField(fieldValue) || isUidField(fieldValue)) {
         int uid = fieldValue.mValue.int_value;
-        auto aidIt = UidMap::sAidToUidMapping.find(str_match);
-        if (aidIt != UidMap::sAidToUidMapping.end()) {
-            return ((int)aidIt->second) == uid;
+        if (matcher.aidUids.find(uid) != matcher.aidUids.end()) {
+            return true;
+        }
+        if (matcher.packageNames.empty()) {
+            return false;
         }
-        std::set<string> packageNames = uidMap.getAppNamesFromUid(uid, true /* normalize*/);
-        return packageNames.find(str_match) != packageNames.end();
+        for (const string& packageName : uidMap.getAppNamesFromUid(uid, true /* normalize*/)) {
+            if (matcher.packageNames.find(packageName) != matcher.packageNames.end()) {
+                return true;
+            }
+        }
+        return false;
     } else if (fieldValue.mValue.getType() == STRING) {
-        return fieldValue.mValue.str_value == str_match;
+        return matcher.strings.find(fieldValue.mValue.str_value) != matcher.strings.end();
     }
     return false;
 }
 
-bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
+// Returns the value as a long if it is an int or a long, which all the integer comparisons cover.
+bool getIntegerValue(const FieldValue& fieldValue, int64_t* output) {
+    if (fieldValue.mValue.getType() == INT) {
+        *output = fieldValue.mValue.int_value;
+        return true;
+    }
+    if (fieldValue.mValue.getType() == LONG) {
+        *output = fieldValue.mValue.long_value;
+        return true;
+    }
+    return false;
+}
+
+bool matchesValue(const UidMap& uidMap, const CompiledFieldValueMatcher& matcher,
+                  const FieldValue& fieldValue) {
+    int64_t intValue;
+    switch (matcher.valueCase) {
+        case FieldValueMatcher::kEqBool:
+            return getIntegerValue(fieldValue, &intValue) &&
+                   (intValue != 0) == (matcher.intValue != 0);
+        case FieldValueMatcher::kEqString:
+        case FieldValueMatcher::kEqAnyString:
+            return matchesAnyString(uidMap, fieldValue, matcher);
+        case FieldValueMatcher::kNeqAnyString:
+            return !matchesAnyString(uidMap, fieldValue, matcher);
+        case FieldValueMatcher::kEqInt:
+            return getIntegerValue(fieldValue, &intValue) && intValue == matcher.intValue;
+        case FieldValueMatcher::kLtInt:
+            return getIntegerValue(fieldValue, &intValue) && intValue < matcher.intValue;
+        case FieldValueMatcher::kGtInt:
+            return getIntegerValue(fieldValue, &intValue) && intValue > matcher.intValue;
+        case FieldValueMatcher::kLteInt:
+            return getIntegerValue(fieldValue, &intValue) && intValue <= matcher.intValue;
+        case FieldValueMatcher::kGteInt:
+            return getIntegerValue(fieldValue, &intValue) && intValue >= matcher.intValue;
+        case FieldValueMatcher::kLtFloat:
+            return fieldValue.mValue.getType() == FLOAT &&
+                   fieldValue.mValue.float_value < matcher.floatValue;
+        case FieldValueMatcher::kGtFloat:
+            return fieldValue.mValue.getType() == FLOAT &&
+                   fieldValue.mValue.float_value > matcher.floatValue;
+        default:
+            return false;
+    }
+}
+
+bool matchesSimple(const UidMap& uidMap, const CompiledFieldValueMatcher& matcher,
                    const vector<FieldValue>& values, int start, int end, int depth) {
     if (depth > 2) {
         ALOGE("Depth > 3 not supported");
@@ -114,12 +236,12 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
     // break when pos is larger than the one we are searching for.
     for (int i = start; i < end; i++) {
         int pos = values[i].mField.getPosAtDepth(depth);
-        if (pos == matcher.field()) {
+        if (pos == matcher.field) {
             if (newStart == -1) {
                 newStart = i;
             }
             newEnd = i + 1;
-        } else if (pos > matcher.field()) {
+        } else if (pos > matcher.field) {
             break;
         }
     }
@@ -134,13 +256,13 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
     }
 
     vector<pair<int, int>> ranges; // the ranges are for matching ANY position
-    if (matcher.has_position()) {
+    if (matcher.hasPosition) {
         // Repeated fields position is stored as a node in the path.
         depth++;
         if (depth > 2) {
             return false;
         }
-        switch (matcher.position()) {
+        switch (matcher.position) {
             case Position::FIRST: {
                 for (int i = start; i < end; i++) {
                     int pos = values[i].mField.getPosAtDepth(depth);
@@ -194,172 +316,51 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
         ranges.push_back(std::make_pair(start, end));
     }
     // start and end are still pointing to the matched range.
-    switch (matcher.value_matcher_case()) {
-        case FieldValueMatcher::kMatchesTuple: {
-            ++depth;
-            // If any range matches all matchers, good.
-            for (const auto& range : ranges) {
-                bool matched = true;
-                for (const auto& subMatcher : matcher.matches_tuple().field_value_matcher()) {
-                    if (!matchesSimple(uidMap, subMatcher, values, range.first, range.second,
-                                       depth)) {
-                        matched = false;
-                        break;
-                    }
-                }
-                if (matched) return true;
-            }
-            return false;
-        }
-        // Finally, we get to the point of real value matching.
-        // If the field matcher ends with ANY, then we have [start, end) range > 1.
-        // In the following, we should return true, when ANY of the values matches.
-        case FieldValueMatcher::ValueMatcherCase::kEqBool: {
-            for (int i = start; i < end; i++) {
-                if ((values[i].mValue.getType() == INT &&
-                     (values[i].mValue.int_value != 0) == matcher.eq_bool()) ||
-                    (values[i].mValue.getType() == LONG &&
-                     (values[i].mValue.long_value != 0) == matcher.eq_bool())) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqString: {
-            for (int i = start; i < end; i++) {
-                if (tryMatchString(uidMap, values[i], matcher.eq_string())) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kNeqAnyString: {
-            const auto& str_list = matcher.neq_any_string();
-            for (int i = start; i < end; i++) {
-                bool notEqAll = true;
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
-                        notEqAll = false;
-                        break;
-                    }
-                }
-                if (notEqAll) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqAnyString: {
-            const auto& str_list = matcher.eq_any_string();
-            for (int i = start; i < end; i++) {
-                for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
-                        return true;
-                    }
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kEqInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (matcher.eq_int() == values[i].mValue.int_value)) {
-                    return true;
-                }
-                // eq_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (matcher.eq_int() == values[i].mValue.long_value)) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kLtInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value < matcher.lt_int())) {
-                    return true;
-                }
-                // lt_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value < matcher.lt_int())) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kGtInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value > matcher.gt_int())) {
-                    return true;
-                }
-                // gt_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value > matcher.gt_int())) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kLtFloat: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == FLOAT &&
-                    (values[i].mValue.float_value < matcher.lt_float())) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kGtFloat: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == FLOAT &&
-                    (values[i].mValue.float_value > matcher.gt_float())) {
-                    return true;
-                }
-            }
-            return false;
-        }
-        case FieldValueMatcher::ValueMatcherCase::kLteInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value <= matcher.lte_int())) {
-                    return true;
-                }
-                // lte_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value <= matcher.lte_int())) {
-                    return true;
+    if (matcher.valueCase == FieldValueMatcher::kMatchesTuple) {
+        ++depth;
+        // If any range matches all matchers, good.
+        for (const auto& range : ranges) {
+            bool matched = true;
+            for (const auto& subMatcher : matcher.children) {
+                if (!matchesSimple(uidMap, subMatcher, values, range.first, range.second,
+                                   depth)) {
+                    matched = false;
+                    break;
                 }
             }
-            return false;
+            if (matched) return true;
         }
-        case FieldValueMatcher::ValueMatcherCase::kGteInt: {
-            for (int i = start; i < end; i++) {
-                if (values[i].mValue.getType() == INT &&
-                    (values[i].mValue.int_value >= matcher.gte_int())) {
-                    return true;
-                }
-                // gte_int covers both int and long.
-                if (values[i].mValue.getType() == LONG &&
-                    (values[i].mValue.long_value >= matcher.gte_int())) {
-                    return true;
-                }
-            }
-            return false;
+        return false;
+    }
+    // Finally, we get to the point of real value matching.
+    // If the field matcher ends with ANY, then we have [start, end) range > 1.
+    // In the following, we should return true, when ANY of the values matches.
+    for (int i = start; i < end; i++) {
+        if (matchesValue(uidMap, matcher, values[i])) {
+            return true;
         }
-        default:
-            return false;
     }
+    return false;
 }
 
-bool matchesSimple(const UidMap& uidMap, const SimpleAtomMatcher& simpleMatcher,
+}  // namespace
+
+CompiledAtomMatcher compileSimpleMatcher(const SimpleAtomMatcher& simpleMatcher) {
+    CompiledAtomMatcher compiled;
+    compiled.atomId = simpleMatcher.atom_id();
+    for (const auto& matcher : simpleMatcher.field_value_matcher()) {
+        compiled.fieldValueMatchers.push_back(compileFieldValueMatcher(matcher));
+    }
+    return compiled;
+}
+
+bool matchesSimple(const UidMap& uidMap, const CompiledAtomMatcher& compiledMatcher,
                    const LogEvent& event) {
-    if (event.GetTagId() != simpleMatcher.atom_id()) {
+    if (event.GetTagId() != compiledMatcher.atomId) {
         return false;
     }
 
-    for (const auto& matcher : simpleMatcher.field_value_matcher()) {
+    for (const auto& matcher : compiledMatcher.fieldValueMatchers) {
         if (!matchesSimple(uidMap, matcher, event.getValues(), 0, event.getValues().size(), 0)) {
             return false;
         }
@@ -367,6 +368,11 @@ bool matchesSimple(const UidMap& uidMap, const SimpleAtomMatcher& simpleMatcher,
     return true;
 }
 
+bool matchesSimple(const UidMap& uidMap, const SimpleAtomMatcher& simpleMatcher,
+                   const LogEvent& event) {
+    return matchesSimple(uidMap, compileSimpleMatcher(simpleMatcher), event);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
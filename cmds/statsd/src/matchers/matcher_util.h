@@ -18,6 +18,8 @@
 
 #include "logd/LogEvent.h"
 
+#include <string>
+#include <unordered_set>
 #include <vector>
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "packages/UidMap.h"
@@ -36,6 +38,42 @@ enum MatchingState {
 bool combinationMatch(const std::vector<int>& children, const LogicalOperation& operation,
                       const std::vector<MatchingState>& matcherResults);
 
+// A FieldValueMatcher prepared once at config load, so that matching an event does not go back
+// to the proto. String lists are hash sets, and strings naming an AID are resolved to its uid.
+struct CompiledFieldValueMatcher {
+    int32_t field = 0;
+    bool hasPosition = false;
+    Position position = Position::POSITION_UNKNOWN;
+    FieldValueMatcher::ValueMatcherCase valueCase = FieldValueMatcher::VALUE_MATCHER_NOT_SET;
+
+    // The operand of bool and integer comparisons.
+    int64_t intValue = 0;
+    // The operand of float comparisons.
+    float floatValue = 0;
+
+    // All the strings of eq_string, eq_any_string or neq_any_string, compared with string fields.
+    std::unordered_set<std::string> strings;
+    // Compared with uid fields: the uids of the strings that name an AID, and the remaining
+    // strings as package names.
+    std::unordered_set<int32_t> aidUids;
+    std::unordered_set<std::string> packageNames;
+
+    // The sub matchers of matches_tuple.
+    std::vector<CompiledFieldValueMatcher> children;
+};
+
+struct CompiledAtomMatcher {
+    int32_t atomId = 0;
+    std::vector<CompiledFieldValueMatcher> fieldValueMatchers;
+};
+
+CompiledAtomMatcher compileSimpleMatcher(const SimpleAtomMatcher& simpleMatcher);
+
+bool matchesSimple(const UidMap& uidMap, const CompiledAtomMatcher& compiledMatcher,
+                   const LogEvent& event);
+
+// Compiles the matcher for a single use. Prefer compiling once with compileSimpleMatcher() for
+// matchers that see many events.
 bool matchesSimple(const UidMap& uidMap,
     const SimpleAtomMatcher& simpleMatcher, const LogEvent& wrapper);
 
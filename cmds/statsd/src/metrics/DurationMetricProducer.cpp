@@ -185,7 +185,74 @@ void DurationMetricProducer::onStateChanged(const int64_t eventTimeNs, const int
         if (!containsLinkedStateValues(whatIt.first, primaryKey, mMetric2StateLinks, atomId)) {
             continue;
         }
-        whatIt.second->onStateChanged(eventTimeNs, atomId, newStateCopy);
+        activateTrackerLocked(whatIt.first, whatIt.second)
+                ->onStateChanged(eventTimeNs, atomId, newStateCopy);
+    }
+}
+
+void DurationMetricProducer::onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                                            const vector<StateChange>& changes) {
+    if (changes.size() == 1) {
+        onStateChanged(eventTimeNs, atomId, changes[0].primaryKey, changes[0].oldState,
+                       changes[0].newState);
+        return;
+    }
+
+    vector<FieldValue> newStates;
+    newStates.reserve(changes.size());
+    for (const StateChange& change : changes) {
+        newStates.push_back(change.newState);
+        mapStateValue(atomId, &newStates.back());
+    }
+
+    flushIfNeededLocked(eventTimeNs);
+
+    const Metric2State* stateLink = nullptr;
+    for (const auto& link : mMetric2StateLinks) {
+        if (link.stateAtomId == atomId) {
+            stateLink = &link;
+            break;
+        }
+    }
+
+    // Same as onStateChanged, but walks the duration trackers once for the whole batch. The
+    // changes are indexed by primary key, so a tracker whose whatKey is linked to the state atom
+    // only visits the changes to its own primary key, in the order they occurred.
+    unordered_map<HashableDimensionKey, vector<size_t>> changesByPrimaryKey;
+    for (size_t i = 0; stateLink != nullptr && i < changes.size(); i++) {
+        if (changes[i].primaryKey.getValues().empty()) {
+            // A change without a primary key applies to every tracker.
+            stateLink = nullptr;
+            break;
+        }
+        changesByPrimaryKey[changes[i].primaryKey].push_back(i);
+    }
+    for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
+        if (stateLink != nullptr) {
+            HashableDimensionKey primaryKey;
+            getDimensionForState(whatIt.first.getValues(), *stateLink, &primaryKey);
+            if (primaryKey.getValues().size() == stateLink->stateFields.size()) {
+                const auto it = changesByPrimaryKey.find(primaryKey);
+                if (it == changesByPrimaryKey.end()) {
+                    continue;
+                }
+                DurationTracker* tracker = activateTrackerLocked(whatIt.first, whatIt.second);
+                for (const size_t i : it->second) {
+                    tracker->onStateChanged(eventTimeNs, atomId, newStates[i]);
+                }
+                continue;
+            }
+        }
+
+        // The whatKey doesn't hold every linked field, so test each change like onStateChanged.
+        for (size_t i = 0; i < changes.size(); i++) {
+            if (!containsLinkedStateValues(whatIt.first, changes[i].primaryKey,
+                                           mMetric2StateLinks, atomId)) {
+                continue;
+            }
+            activateTrackerLocked(whatIt.first, whatIt.second)
+                    ->onStateChanged(eventTimeNs, atomId, newStates[i]);
+        }
     }
 }
 
@@ -244,7 +311,8 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(bool conditio
                                      &linkedConditionDimensionKey);
             if (trueConditionDimensions.find(linkedConditionDimensionKey) !=
                     trueConditionDimensions.end()) {
-                whatIt.second->onConditionChanged(currentUnSlicedPartCondition, eventTime);
+                activateTrackerLocked(whatIt.first, whatIt.second)
+                        ->onConditionChanged(currentUnSlicedPartCondition, eventTime);
             }
         }
     } else {
@@ -256,11 +324,13 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(bool conditio
                                          &linkedConditionDimensionKey);
                 if (dimensionsChangedToTrue->find(linkedConditionDimensionKey) !=
                         dimensionsChangedToTrue->end()) {
-                    whatIt.second->onConditionChanged(true, eventTime);
+                    activateTrackerLocked(whatIt.first, whatIt.second)
+                            ->onConditionChanged(true, eventTime);
                 }
                 if (dimensionsChangedToFalse->find(linkedConditionDimensionKey) !=
                         dimensionsChangedToFalse->end()) {
-                    whatIt.second->onConditionChanged(false, eventTime);
+                    activateTrackerLocked(whatIt.first, whatIt.second)
+                            ->onConditionChanged(false, eventTime);
                 }
             }
         }
@@ -277,7 +347,8 @@ void DurationMetricProducer::onSlicedConditionMayChangeInternalLocked(bool overa
 
     // Now for each of the on-going event, check if the condition has changed for them.
     for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-        whatIt.second->onSlicedConditionMayChange(overallCondition, eventTimeNs);
+        activateTrackerLocked(whatIt.first, whatIt.second)
+                ->onSlicedConditionMayChange(overallCondition, eventTimeNs);
     }
 }
 
@@ -311,14 +382,16 @@ void DurationMetricProducer::onActiveStateChangedLocked(const int64_t& eventTime
         }
 
         for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-            whatIt.second->onConditionChanged(mIsActive, eventTimeNs);
+            activateTrackerLocked(whatIt.first, whatIt.second)
+                    ->onConditionChanged(mIsActive, eventTimeNs);
         }
     } else if (mIsActive) {
         flushIfNeededLocked(eventTimeNs);
         onSlicedConditionMayChangeInternalLocked(mIsActive, eventTimeNs);
     } else { // mConditionSliced == true && !mIsActive
         for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-            whatIt.second->onConditionChanged(mIsActive, eventTimeNs);
+            activateTrackerLocked(whatIt.first, whatIt.second)
+                    ->onConditionChanged(mIsActive, eventTimeNs);
         }
     }
 }
@@ -334,7 +407,8 @@ void DurationMetricProducer::onConditionChangedLocked(const bool conditionMet,
 
     flushIfNeededLocked(eventTime);
     for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-        whatIt.second->onConditionChanged(conditionMet, eventTime);
+        activateTrackerLocked(whatIt.first, whatIt.second)
+                ->onConditionChanged(conditionMet, eventTime);
     }
 }
 
@@ -452,19 +526,34 @@ void DurationMetricProducer::flushIfNeededLocked(const int64_t& eventTimeNs) {
 
 void DurationMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs,
                                                       const int64_t& nextBucketStartTimeNs) {
-    for (auto whatIt = mCurrentSlicedDurationTrackerMap.begin();
-            whatIt != mCurrentSlicedDurationTrackerMap.end();) {
-        if (whatIt->second->flushCurrentBucket(eventTimeNs, &mPastBuckets)) {
+    // Idle trackers would not emit anything, so only the active ones are flushed here. The idle
+    // ones are moved to the new bucket lazily in activateTrackerLocked.
+    for (auto keyIt = mActiveTrackerKeys.begin(); keyIt != mActiveTrackerKeys.end();) {
+        auto whatIt = mCurrentSlicedDurationTrackerMap.find(*keyIt);
+        if (whatIt == mCurrentSlicedDurationTrackerMap.end()) {
+            keyIt = mActiveTrackerKeys.erase(keyIt);
+        } else if (whatIt->second->flushCurrentBucket(eventTimeNs, &mPastBuckets)) {
             VLOG("erase bucket for key %s", whatIt->first.toString().c_str());
-            whatIt = mCurrentSlicedDurationTrackerMap.erase(whatIt);
+            mCurrentSlicedDurationTrackerMap.erase(whatIt);
+            keyIt = mActiveTrackerKeys.erase(keyIt);
+        } else if (whatIt->second->isIdle()) {
+            keyIt = mActiveTrackerKeys.erase(keyIt);
         } else {
-            ++whatIt;
+            ++keyIt;
         }
     }
     StatsdStats::getInstance().noteBucketCount(mMetricId);
     mCurrentBucketStartTimeNs = nextBucketStartTimeNs;
 }
 
+DurationTracker* DurationMetricProducer::activateTrackerLocked(
+        const HashableDimensionKey& whatKey, const unique_ptr<DurationTracker>& tracker) {
+    if (mActiveTrackerKeys.insert(whatKey).second) {
+        tracker->setCurrentBucket(mCurrentBucketStartTimeNs, mCurrentBucketNum);
+    }
+    return tracker.get();
+}
+
 void DurationMetricProducer::dumpStatesLocked(FILE* out, bool verbose) const {
     if (mCurrentSlicedDurationTrackerMap.size() == 0) {
         return;
@@ -513,19 +602,19 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
     }
 
     auto it = mCurrentSlicedDurationTrackerMap.find(whatKey);
+    DurationTracker* tracker = activateTrackerLocked(it->first, it->second);
     if (mUseWhatDimensionAsInternalDimension) {
-        it->second->noteStart(whatKey, condition, event.GetElapsedTimestampNs(), conditionKeys);
+        tracker->noteStart(whatKey, condition, event.GetElapsedTimestampNs(), conditionKeys);
         return;
     }
 
     if (mInternalDimensions.empty()) {
-        it->second->noteStart(DEFAULT_DIMENSION_KEY, condition, event.GetElapsedTimestampNs(),
-                              conditionKeys);
+        tracker->noteStart(DEFAULT_DIMENSION_KEY, condition, event.GetElapsedTimestampNs(),
+                           conditionKeys);
     } else {
         HashableDimensionKey dimensionKey = DEFAULT_DIMENSION_KEY;
         filterValues(mInternalDimensions, event.getValues(), &dimensionKey);
-        it->second->noteStart(dimensionKey, condition, event.GetElapsedTimestampNs(),
-                              conditionKeys);
+        tracker->noteStart(dimensionKey, condition, event.GetElapsedTimestampNs(), conditionKeys);
     }
 
 }
@@ -551,7 +640,8 @@ void DurationMetricProducer::onMatchedLogEventLocked(const size_t matcherIndex,
     // Handles Stopall events.
     if (matcherIndex == mStopAllIndex) {
         for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-            whatIt.second->noteStopAll(event.GetElapsedTimestampNs());
+            activateTrackerLocked(whatIt.first, whatIt.second)
+                    ->noteStopAll(event.GetElapsedTimestampNs());
         }
         return;
     }
@@ -601,7 +691,8 @@ void DurationMetricProducer::onMatchedLogEventLocked(const size_t matcherIndex,
         if (mUseWhatDimensionAsInternalDimension) {
             auto whatIt = mCurrentSlicedDurationTrackerMap.find(dimensionInWhat);
             if (whatIt != mCurrentSlicedDurationTrackerMap.end()) {
-                whatIt->second->noteStop(dimensionInWhat, event.GetElapsedTimestampNs(), false);
+                activateTrackerLocked(whatIt->first, whatIt->second)
+                        ->noteStop(dimensionInWhat, event.GetElapsedTimestampNs(), false);
             }
             return;
         }
@@ -613,7 +704,8 @@ void DurationMetricProducer::onMatchedLogEventLocked(const size_t matcherIndex,
 
         auto whatIt = mCurrentSlicedDurationTrackerMap.find(dimensionInWhat);
         if (whatIt != mCurrentSlicedDurationTrackerMap.end()) {
-            whatIt->second->noteStop(internalDimensionKey, event.GetElapsedTimestampNs(), false);
+            activateTrackerLocked(whatIt->first, whatIt->second)
+                    ->noteStop(internalDimensionKey, event.GetElapsedTimestampNs(), false);
         }
         return;
     }
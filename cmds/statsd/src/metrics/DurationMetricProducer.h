@@ -18,6 +18,7 @@
 
 
 #include <unordered_map>
+#include <unordered_set>
 
 #include <android/util/ProtoOutputStream.h>
 #include "../anomaly/DurationAnomalyTracker.h"
@@ -58,6 +59,9 @@ public:
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState) override;
 
+    void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                        const std::vector<StateChange>& changes) override;
+
 protected:
     void onMatchedLogEventLocked(const size_t matcherIndex, const LogEvent& event) override;
 
@@ -139,6 +143,16 @@ private:
     std::unordered_map<HashableDimensionKey, std::unique_ptr<DurationTracker>>
             mCurrentSlicedDurationTrackerMap;
 
+    // Keys of the trackers that must be flushed at the end of the current bucket. Trackers that
+    // are idle (see DurationTracker::isIdle) are left out so that bucket rollover only touches
+    // dimensions with running durations or data in the bucket.
+    std::unordered_set<HashableDimensionKey> mActiveTrackerKeys;
+
+    // Brings a possibly idle tracker up to the current bucket and marks it active. Must be
+    // called before any tracker is notified of an event.
+    DurationTracker* activateTrackerLocked(const HashableDimensionKey& whatKey,
+                                           const std::unique_ptr<DurationTracker>& tracker);
+
     // Helper function to create a duration tracker given the metric aggregation type.
     std::unique_ptr<DurationTracker> createDurationTracker(
             const MetricDimensionKey& eventKey) const;
@@ -156,6 +170,7 @@ private:
     FRIEND_TEST(DurationMetricTrackerTest, TestNonSlicedConditionUnknownState);
     FRIEND_TEST(WakelockDurationE2eTest, TestAggregatedPredicates);
     FRIEND_TEST(DurationMetricTrackerTest, TestFirstBucket);
+    FRIEND_TEST(DurationMetricTrackerTest, TestIdleTrackerSkippedDuringFlush);
 
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket, TestSumDuration);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket,
@@ -18,6 +18,7 @@
 #include "Log.h"
 
 #include "EventMetricProducer.h"
+#include "guardrail/StatsdStats.h"
 #include "stats_util.h"
 #include "stats_log_util.h"
 
@@ -51,6 +52,12 @@ const int FIELD_ID_DATA = 1;
 // for EventMetricData
 const int FIELD_ID_ELAPSED_TIMESTAMP_NANOS = 1;
 const int FIELD_ID_ATOMS = 2;
+const int FIELD_ID_AGGREGATED_ATOM_INFO = 4;
+// for AggregatedAtomInfo
+const int FIELD_ID_AGGREGATED_ATOM = 1;
+const int FIELD_ID_AGGREGATED_COUNT = 2;
+const int FIELD_ID_FIRST_ELAPSED_TIMESTAMP_NANOS = 3;
+const int FIELD_ID_LAST_ELAPSED_TIMESTAMP_NANOS = 4;
 
 EventMetricProducer::EventMetricProducer(
         const ConfigKey& key, const EventMetric& metric, const int conditionIndex,
@@ -61,7 +68,12 @@ EventMetricProducer::EventMetricProducer(
         const vector<int>& slicedStateAtoms,
         const unordered_map<int, unordered_map<int, int64_t>>& stateGroupMap)
     : MetricProducer(metric.id(), key, startTimeNs, conditionIndex, initialConditionCache, wizard,
-                     eventActivationMap, eventDeactivationMap, slicedStateAtoms, stateGroupMap) {
+                     eventActivationMap, eventDeactivationMap, slicedStateAtoms, stateGroupMap),
+      mSamplingPercentage(metric.sampling_percentage()),
+      mAggregateIdenticalAtoms(metric.aggregate_identical_atoms()) {
+    if (metric.has_sampled_fields()) {
+        translateFieldMatcher(metric.sampled_fields(), &mSampledFields);
+    }
     if (metric.links().size() > 0) {
         for (const auto& link : metric.links()) {
             Metric2Condition mc;
@@ -83,6 +95,9 @@ EventMetricProducer::~EventMetricProducer() {
 
 void EventMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     mProto->clear();
+    mAggregatedAtoms.clear();
+    mAggregatedAtomCount = 0;
+    mAggregatedAtomBytes = 0;
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
 }
 
@@ -109,6 +124,9 @@ std::unique_ptr<std::vector<uint8_t>> serializeProtoLocked(ProtoOutputStream& pr
 
 void EventMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mProto->clear();
+    mAggregatedAtoms.clear();
+    mAggregatedAtomCount = 0;
+    mAggregatedAtomBytes = 0;
 }
 
 void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
@@ -119,6 +137,41 @@ void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                                              ProtoOutputStream* protoOutput) {
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
     protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+    if (mAggregateIdenticalAtoms) {
+        if (mAggregatedAtomCount == 0) {
+            return;
+        }
+        uint64_t wrapperToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_METRICS);
+        for (const auto& [atomId, atoms] : mAggregatedAtoms) {
+            for (const auto& [values, aggregatedAtom] : atoms) {
+                uint64_t dataToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                        FIELD_ID_DATA);
+                uint64_t infoToken =
+                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_AGGREGATED_ATOM_INFO);
+                uint64_t atomToken =
+                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_AGGREGATED_ATOM);
+                writeFieldValueTreeToStream(atomId, values.getValues(), protoOutput);
+                protoOutput->end(atomToken);
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_AGGREGATED_COUNT,
+                                   (long long)aggregatedAtom.count);
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_FIRST_ELAPSED_TIMESTAMP_NANOS,
+                                   (long long)aggregatedAtom.firstElapsedTimestampNs);
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_ELAPSED_TIMESTAMP_NANOS,
+                                   (long long)aggregatedAtom.lastElapsedTimestampNs);
+                protoOutput->end(infoToken);
+                protoOutput->end(dataToken);
+            }
+        }
+        protoOutput->end(wrapperToken);
+
+        if (erase_data) {
+            mAggregatedAtoms.clear();
+            mAggregatedAtomCount = 0;
+            mAggregatedAtomBytes = 0;
+        }
+        return;
+    }
+
     if (mProto->size() <= 0) {
         return;
     }
@@ -150,6 +203,15 @@ void EventMetricProducer::onMatchedLogEventInternalLocked(
         return;
     }
 
+    if (!isSampledLocked(event)) {
+        return;
+    }
+
+    if (mAggregateIdenticalAtoms) {
+        aggregateAtomLocked(event);
+        return;
+    }
+
     uint64_t wrapperToken =
             mProto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
     const int64_t elapsedTimeNs = truncateTimestampIfNecessary(event);
@@ -161,8 +223,53 @@ void EventMetricProducer::onMatchedLogEventInternalLocked(
     mProto->end(wrapperToken);
 }
 
+bool EventMetricProducer::isSampledLocked(const LogEvent& event) const {
+    if (mSamplingPercentage >= 100) {
+        return true;
+    }
+
+    HashableDimensionKey sampledValues;
+    if (mSampledFields.empty()) {
+        sampledValues = HashableDimensionKey(event.getValues());
+    } else if (!filterValues(mSampledFields, event.getValues(), &sampledValues)) {
+        return false;
+    }
+    return hashDimension(sampledValues) % 100 < (uint32_t)mSamplingPercentage;
+}
+
+void EventMetricProducer::aggregateAtomLocked(const LogEvent& event) {
+    const int64_t elapsedTimeNs = truncateTimestampIfNecessary(event);
+    HashableDimensionKey values(event.getValues());
+    auto& atoms = mAggregatedAtoms[event.GetTagId()];
+
+    auto it = atoms.find(values);
+    if (it == atoms.end()) {
+        // Same guardrail as the dimension guardrail of the other metric types: each distinct
+        // atom is a key that stays in memory until the next report.
+        if (mAggregatedAtomCount > StatsdStats::kDimensionKeySizeSoftLimit - 1) {
+            const size_t newAtomCount = mAggregatedAtomCount + 1;
+            StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mMetricId,
+                                                               newAtomCount);
+            if (newAtomCount > StatsdStats::kDimensionKeySizeHardLimit) {
+                ALOGE("EventMetric %lld dropping data for atom %s", (long long)mMetricId,
+                      values.toString().c_str());
+                StatsdStats::getInstance().noteHardDimensionLimitReached(mMetricId);
+                return;
+            }
+        }
+        mAggregatedAtomCount++;
+        mAggregatedAtomBytes += sizeof(AggregatedAtom) + sizeof(HashableDimensionKey) +
+                                values.getValues().size() * sizeof(FieldValue);
+        it = atoms.emplace(std::move(values), AggregatedAtom()).first;
+        it->second.firstElapsedTimestampNs = elapsedTimeNs;
+    }
+
+    it->second.count++;
+    it->second.lastElapsedTimestampNs = elapsedTimeNs;
+}
+
 size_t EventMetricProducer::byteSizeLocked() const {
-    return mProto->bytesWritten();
+    return mProto->bytesWritten() + mAggregatedAtomBytes;
 }
 
 }  // namespace statsd
@@ -20,6 +20,7 @@
 #include <unordered_map>
 
 #include <android/util/ProtoOutputStream.h>
+#include <gtest/gtest_prod.h>
 
 #include "../condition/ConditionTracker.h"
 #include "../matchers/matcher_util.h"
@@ -72,9 +73,42 @@ private:
 
     void dumpStatesLocked(FILE* out, bool verbose) const override{};
 
+    // Returns true if the event's sampled field values fall in the sampled percentage.
+    bool isSampledLocked(const LogEvent& event) const;
+
+    void aggregateAtomLocked(const LogEvent& event);
+
     // Maps to a EventMetricDataWrapper. Storing atom events in ProtoOutputStream
     // is more space efficient than storing LogEvent.
     std::unique_ptr<android::util::ProtoOutputStream> mProto;
+
+    // Percentage of sampled field values whose events are kept.
+    const int32_t mSamplingPercentage;
+
+    // Fields whose values are hashed for sampling. All fields are used if empty.
+    std::vector<Matcher> mSampledFields;
+
+    const bool mAggregateIdenticalAtoms;
+
+    struct AggregatedAtom {
+        int64_t count = 0;
+        int64_t firstElapsedTimestampNs = 0;
+        int64_t lastElapsedTimestampNs = 0;
+    };
+
+    // Identical atoms seen since the last report, keyed by atom id and then by field values.
+    // Only used if mAggregateIdenticalAtoms is true.
+    std::unordered_map<int, std::unordered_map<HashableDimensionKey, AggregatedAtom>>
+            mAggregatedAtoms;
+
+    // Number of distinct atoms in mAggregatedAtoms.
+    size_t mAggregatedAtomCount = 0;
+
+    // Estimated memory used by mAggregatedAtoms.
+    size_t mAggregatedAtomBytes = 0;
+
+    FRIEND_TEST(EventMetricProducerTest, TestSampling);
+    FRIEND_TEST(EventMetricProducerTest, TestAggregateIdenticalAtoms);
 };
 
 }  // namespace statsd
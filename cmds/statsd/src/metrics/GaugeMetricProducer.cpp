@@ -173,6 +173,7 @@ void GaugeMetricProducer::dumpStatesLocked(FILE* out, bool verbose) const {
 void GaugeMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
     mPastBuckets.clear();
+    mArchivedBuckets.clear();
     mSkippedBuckets.clear();
 }
 
@@ -247,35 +248,14 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                                            FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set, protoOutput);
         }
 
-        // Then fill bucket_info (GaugeBucketInfo).
+        // Then fill bucket_info (GaugeBucketInfo), the archived buckets being the oldest.
+        mArchivedBuckets.writeToProto(
+                dimensionKey, FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO,
+                protoOutput);
         for (const auto& bucket : pair.second) {
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
-            } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
-            }
-
-            if (!bucket.mGaugeAtoms.empty()) {
-                for (const auto& atom : bucket.mGaugeAtoms) {
-                    uint64_t atomsToken =
-                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                           FIELD_ID_ATOM);
-                    writeFieldValueTreeToStream(mAtomId, *(atom.mFields), protoOutput);
-                    protoOutput->end(atomsToken);
-                }
-                for (const auto& atom : bucket.mGaugeAtoms) {
-                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED |
-                                               FIELD_ID_ELAPSED_ATOM_TIMESTAMP,
-                                       (long long)atom.mElapsedTimestampNs);
-                }
-            }
+            writeBucketInfoToProto(bucket, protoOutput);
             protoOutput->end(bucketInfoToken);
             VLOG("Gauge \t bucket [%lld - %lld] includes %d atoms.",
                  (long long)bucket.mBucketStartNs, (long long)bucket.mBucketEndNs,
@@ -288,10 +268,53 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 
     if (erase_data) {
         mPastBuckets.clear();
+        mArchivedBuckets.clear();
         mSkippedBuckets.clear();
     }
 }
 
+void GaugeMetricProducer::writeBucketInfoToProto(const GaugeBucket& bucket,
+                                                 ProtoOutputStream* protoOutput) {
+    if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                           (long long)NanoToMillis(bucket.mBucketStartNs));
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                           (long long)NanoToMillis(bucket.mBucketEndNs));
+    } else {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                           (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+    }
+
+    if (!bucket.mGaugeAtoms.empty()) {
+        for (const auto& atom : bucket.mGaugeAtoms) {
+            uint64_t atomsToken =
+                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                   FIELD_ID_ATOM);
+            writeFieldValueTreeToStream(mAtomId, *(atom.mFields), protoOutput);
+            protoOutput->end(atomsToken);
+        }
+        for (const auto& atom : bucket.mGaugeAtoms) {
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED |
+                                       FIELD_ID_ELAPSED_ATOM_TIMESTAMP,
+                               (long long)atom.mElapsedTimestampNs);
+        }
+    }
+}
+
+void GaugeMetricProducer::archivePastBucketsLocked(const MetricDimensionKey& key,
+                                                   std::vector<GaugeBucket>* buckets) {
+    if (buckets->size() <= kMaxDecodedPastBuckets) {
+        return;
+    }
+    const size_t count = buckets->size() - kMaxDecodedPastBuckets;
+    for (size_t i = 0; i < count; i++) {
+        ProtoOutputStream bucketInfo;
+        writeBucketInfoToProto((*buckets)[i], &bucketInfo);
+        mArchivedBuckets.append(key, bucketInfo);
+    }
+    buckets->erase(buckets->begin(), buckets->begin() + count);
+}
+
 void GaugeMetricProducer::prepareFirstBucketLocked() {
     if (mIsActive && mIsPulled && mSamplingType == GaugeMetric::RANDOM_ONE_SAMPLE) {
         pullAndMatchEventsLocked(mCurrentBucketStartTimeNs);
@@ -525,6 +548,7 @@ void GaugeMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
+    mArchivedBuckets.clear();
 }
 
 // When a new matched event comes in, we check if event falls into the current
@@ -568,6 +592,7 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs,
             info.mGaugeAtoms = slice.second;
             auto& bucketList = mPastBuckets[slice.first];
             bucketList.push_back(info);
+            archivePastBucketsLocked(slice.first, &bucketList);
             VLOG("Gauge gauge metric %lld, dump key value: %s", (long long)mMetricId,
                  slice.first.toString().c_str());
         }
@@ -612,6 +637,7 @@ size_t GaugeMetricProducer::byteSizeLocked() const {
             }
         }
     }
+    totalSize += mArchivedBuckets.byteSize();
     return totalSize;
 }
 
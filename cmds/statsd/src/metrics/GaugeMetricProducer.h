@@ -26,6 +26,7 @@
 #include "../matchers/matcher_util.h"
 #include "../matchers/EventMatcherWizard.h"
 #include "MetricProducer.h"
+#include "PastBucketArchive.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "../stats_util.h"
 
@@ -157,6 +158,9 @@ private:
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
     std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>> mPastBuckets;
 
+    // Older past buckets of dimensions with more than kMaxDecodedPastBuckets of them.
+    PastBucketArchive mArchivedBuckets;
+
     // The current partial bucket.
     std::shared_ptr<DimToGaugeAtomsMap> mCurrentSlicedBucket;
 
@@ -185,6 +189,13 @@ private:
 
     static const size_t kBucketSize = sizeof(GaugeBucket{});
 
+    // Writes the fields of the GaugeBucketInfo of a past bucket.
+    void writeBucketInfoToProto(const GaugeBucket& bucket,
+                                android::util::ProtoOutputStream* protoOutput);
+
+    // Moves all but the most recent kMaxDecodedPastBuckets buckets of a dimension to the archive.
+    void archivePastBucketsLocked(const MetricDimensionKey& key, std::vector<GaugeBucket>* buckets);
+
     const size_t mDimensionSoftLimit;
 
     const size_t mDimensionHardLimit;
@@ -20,6 +20,8 @@
 
 #include <private/android_filesystem_config.h>
 
+#include <algorithm>
+
 #include "CountMetricProducer.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
@@ -62,7 +64,8 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
                                const sp<UidMap>& uidMap,
                                const sp<StatsPullerManager>& pullerManager,
                                const sp<AlarmMonitor>& anomalyAlarmMonitor,
-                               const sp<AlarmMonitor>& periodicAlarmMonitor)
+                               const sp<AlarmMonitor>& periodicAlarmMonitor,
+                               const sp<MetricsManager>& previousManager)
     : mConfigKey(key),
       mUidMap(uidMap),
       mTtlNs(config.has_ttl_in_seconds() ? config.ttl_in_seconds() * NS_PER_SEC : -1),
@@ -76,17 +79,39 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
     // Init the ttl end timestamp.
     refreshTtl(timeBaseNs);
 
+    computeConfigHashes(config, mConfigHashes);
+    ConfigReusePlan reusePlan;
+    if (previousManager != nullptr) {
+        reusePlan = planConfigReuse(config, mConfigHashes, previousManager->mConfigHashes,
+                                    previousManager->mAllConditionTrackers,
+                                    previousManager->mAllMetricProducers);
+        for (const auto& it : reusePlan.metricProducers) {
+            mReusedMetricIds.insert(it.first);
+        }
+        VLOG("Config update reuses %d conditions and %zu metrics",
+             reusePlan.reuseConditions ? (int)reusePlan.conditionTrackers.size() : 0,
+             mReusedMetricIds.size());
+    }
+
     mConfigValid = initStatsdConfig(
             key, config, *uidMap, pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor,
             timeBaseNs, currentTimeNs, mTagIds, mAllAtomMatchers, mAllConditionTrackers,
             mAllMetricProducers, mAllAnomalyTrackers, mAllPeriodicAlarmTrackers,
             mConditionToMetricMap, mTrackerToMetricMap, mTrackerToConditionMap,
             mActivationAtomTrackerToMetricMap, mDeactivationAtomTrackerToMetricMap,
-            mAlertTrackerMap, mMetricIndexesWithActivation, mNoReportMetricIds);
+            mAlertTrackerMap, mMetricIndexesWithActivation, mNoReportMetricIds,
+            previousManager != nullptr ? &reusePlan : nullptr);
+
+    for (int i = 0; i < (int)mAllAtomMatchers.size(); i++) {
+        for (int atomId : mAllAtomMatchers[i]->getAtomIds()) {
+            mTagIdToMatcherIndices[atomId].push_back(i);
+        }
+    }
 
     mHashStringsInReport = config.hash_strings_in_metric_report();
     mVersionStringsInReport = config.version_strings_in_metric_report();
     mInstallerInReport = config.installer_in_metric_report();
+    mDeltaUidMapInReport = config.delta_uid_map_in_metric_report();
 
     // Init allowed pushed atom uids.
     if (config.allowed_log_source_size() == 0) {
@@ -182,6 +207,12 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
             break;
         }
     }
+
+    // The previous manager keeps the producers it shared unless this config is used.
+    if (!mConfigValid) {
+        releaseMetricProducers(mReusedMetricIds);
+        mReusedMetricIds.clear();
+    }
 }
 
 MetricsManager::~MetricsManager() {
@@ -292,10 +323,21 @@ void MetricsManager::onStatsdInitCompleted(const int64_t& eventTimeNs) {
 
 void MetricsManager::init() {
     for (const auto& producer : mAllMetricProducers) {
-        producer->prepareFirstBucket();
+        if (mReusedMetricIds.find(producer->getMetricId()) == mReusedMetricIds.end()) {
+            producer->prepareFirstBucket();
+        }
     }
 }
 
+void MetricsManager::releaseMetricProducers(const std::set<int64_t>& metricIds) {
+    mAllMetricProducers.erase(
+            std::remove_if(mAllMetricProducers.begin(), mAllMetricProducers.end(),
+                           [&metricIds](const sp<MetricProducer>& producer) {
+                               return metricIds.find(producer->getMetricId()) != metricIds.end();
+                           }),
+            mAllMetricProducers.end());
+}
+
 vector<int32_t> MetricsManager::getPullAtomUids(int32_t atomId) {
     std::lock_guard<std::mutex> lock(mAllowedLogSourcesMutex);
     vector<int32_t> uids;
@@ -335,22 +377,38 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs,
                                   ProtoOutputStream* protoOutput) {
     VLOG("=========================Metric Reports Start==========================");
     // one StatsLogReport per MetricProduer
-    for (const auto& producer : mAllMetricProducers) {
-        if (mNoReportMetricIds.find(producer->getMetricId()) == mNoReportMetricIds.end()) {
-            uint64_t token = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
-            if (mHashStringsInReport) {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, str_set, protoOutput);
-            } else {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, nullptr, protoOutput);
-            }
-            protoOutput->end(token);
+    for (size_t i = 0; i < mAllMetricProducers.size(); i++) {
+        onDumpMetricReport(i, dumpTimeStampNs, include_current_partial_bucket, erase_data,
+                           dumpLatency, str_set, protoOutput);
+    }
+    onDumpReportFinished(dumpTimeStampNs, erase_data, protoOutput);
+    VLOG("=========================Metric Reports End==========================");
+}
+
+void MetricsManager::onDumpMetricReport(const size_t metricIndex, const int64_t dumpTimeStampNs,
+                                        const bool include_current_partial_bucket,
+                                        const bool erase_data, const DumpLatency dumpLatency,
+                                        std::set<string>* str_set,
+                                        ProtoOutputStream* protoOutput) {
+    const sp<MetricProducer>& producer = mAllMetricProducers[metricIndex];
+    if (mNoReportMetricIds.find(producer->getMetricId()) == mNoReportMetricIds.end()) {
+        uint64_t token = protoOutput->start(
+                FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
+        if (mHashStringsInReport) {
+            producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
+                                   dumpLatency, str_set, protoOutput);
         } else {
-            producer->clearPastBuckets(dumpTimeStampNs);
+            producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
+                                   dumpLatency, nullptr, protoOutput);
         }
+        protoOutput->end(token);
+    } else {
+        producer->clearPastBuckets(dumpTimeStampNs);
     }
+}
+
+void MetricsManager::onDumpReportFinished(const int64_t dumpTimeStampNs, const bool erase_data,
+                                          ProtoOutputStream* protoOutput) {
     for (const auto& annotation : mAnnotations) {
         uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                             FIELD_ID_ANNOTATIONS);
@@ -366,7 +424,6 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs,
         mLastReportTimeNs = dumpTimeStampNs;
         mLastReportWallClockNs = getWallClockNs();
     }
-    VLOG("=========================Metric Reports End==========================");
 }
 
 
@@ -479,16 +536,17 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
 
     mIsActive = isActive || !activeMetricsIndices.empty();
 
-    if (mTagIds.find(tagId) == mTagIds.end()) {
+    auto matcherIndices = mTagIdToMatcherIndices.find(tagId);
+    if (matcherIndices == mTagIdToMatcherIndices.end()) {
         // Not interesting...
         return;
     }
 
     vector<MatchingState> matcherCache(mAllAtomMatchers.size(), MatchingState::kNotComputed);
 
-    // Evaluate all atom matchers.
-    for (auto& matcher : mAllAtomMatchers) {
-        matcher->onLogEvent(event, mAllAtomMatchers, matcherCache);
+    // Evaluate the atom matchers that can match this atom.
+    for (int matcherIndex : matcherIndices->second) {
+        mAllAtomMatchers[matcherIndex]->onLogEvent(event, mAllAtomMatchers, matcherCache);
     }
 
     // Set of metrics that received an activation cancellation.
@@ -27,6 +27,7 @@
 #include "logd/LogEvent.h"
 #include "matchers/LogMatchingTracker.h"
 #include "metrics/MetricProducer.h"
+#include "metrics/metrics_manager_util.h"
 #include "packages/UidMap.h"
 
 #include <unordered_map>
@@ -42,7 +43,8 @@ public:
                    const int64_t currentTimeNs, const sp<UidMap>& uidMap,
                    const sp<StatsPullerManager>& pullerManager,
                    const sp<AlarmMonitor>& anomalyAlarmMonitor,
-                   const sp<AlarmMonitor>& periodicAlarmMonitor);
+                   const sp<AlarmMonitor>& periodicAlarmMonitor,
+                   const sp<MetricsManager>& previousManager = nullptr);
 
     virtual ~MetricsManager();
 
@@ -55,6 +57,16 @@ public:
 
     void onLogEvent(const LogEvent& event);
 
+    // All atoms that the matchers of this config look at.
+    inline const std::set<int>& getTagIds() const {
+        return mTagIds;
+    }
+
+    // Metrics with activations need to see every event, so that they are deactivated on time.
+    inline bool hasActivations() const {
+        return !mMetricIndexesWithActivation.empty();
+    }
+
     void onAnomalyAlarmFired(
         const int64_t& timestampNs,
         unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>& alarmSet);
@@ -72,8 +84,20 @@ public:
 
     void onStatsdInitCompleted(const int64_t& elapsedTimeNs);
 
+    // Prepares the first bucket of every metric that was not carried over from the previous
+    // version of the config.
     void init();
 
+    // Metrics whose producers, with their state, were carried over from the previous version of
+    // the config.
+    inline const std::set<int64_t>& getReusedMetricIds() const {
+        return mReusedMetricIds;
+    }
+
+    // Forgets the producers of [metricIds], which a MetricsManager for an updated version of this
+    // config has taken over, so that destroying this manager leaves them registered.
+    void releaseMetricProducers(const std::set<int64_t>& metricIds);
+
     vector<int32_t> getPullAtomUids(int32_t atomId) override;
 
     bool shouldWriteToDisk() const {
@@ -102,6 +126,10 @@ public:
         return mInstallerInReport;
     };
 
+    inline bool deltaUidMapInReport() const {
+        return mDeltaUidMapInReport;
+    };
+
     void refreshTtl(const int64_t currentTimestampNs) {
         if (mTtlNs > 0) {
             mTtlEndNs = currentTimestampNs + mTtlNs;
@@ -131,6 +159,17 @@ public:
                               std::set<string> *str_set,
                               android::util::ProtoOutputStream* protoOutput);
 
+    // The two halves of onDumpReport, for callers that write the report one metric at a time.
+    // onDumpMetricReport writes the StatsLogReport of the metric at metricIndex, which must be
+    // less than getNumMetrics(). onDumpReportFinished writes the parts of the report that follow
+    // the metrics.
+    void onDumpMetricReport(const size_t metricIndex, const int64_t dumpTimeNs,
+                            const bool include_current_partial_bucket, const bool erase_data,
+                            const DumpLatency dumpLatency, std::set<string>* str_set,
+                            android::util::ProtoOutputStream* protoOutput);
+    void onDumpReportFinished(const int64_t dumpTimeNs, const bool erase_data,
+                              android::util::ProtoOutputStream* protoOutput);
+
     // Computes the total byte size of all metrics managed by a single config source.
     // Does not change the state.
     virtual size_t byteSize();
@@ -167,6 +206,7 @@ private:
     bool mHashStringsInReport = false;
     bool mVersionStringsInReport = false;
     bool mInstallerInReport = false;
+    bool mDeltaUidMapInReport = false;
 
     const int64_t mTtlNs;
     int64_t mTtlEndNs;
@@ -223,12 +263,22 @@ private:
     // Hold all the atom matchers from the config.
     std::vector<sp<LogMatchingTracker>> mAllAtomMatchers;
 
+    // Maps from an atom id to the index of the LogMatchingTrackers that can match it. Matchers
+    // that aren't listed for an event's atom are left kNotComputed, which no one treats as a
+    // match.
+    std::unordered_map<int, std::vector<int>> mTagIdToMatcherIndices;
+
     // Hold all the conditions from the config.
     std::vector<sp<ConditionTracker>> mAllConditionTrackers;
 
     // Hold all metrics from the config.
     std::vector<sp<MetricProducer>> mAllMetricProducers;
 
+    // Hashes of the config elements, used to find what the next update of the config can reuse.
+    ConfigHashes mConfigHashes;
+
+    std::set<int64_t> mReusedMetricIds;
+
     // Hold all alert trackers.
     std::vector<sp<AnomalyTracker>> mAllAnomalyTrackers;
 
@@ -311,6 +361,7 @@ private:
     FRIEND_TEST(MetricActivationE2eTest, TestCountMetricWithTwoMetricsTwoDeactivations);
 
     FRIEND_TEST(MetricsManagerTest, TestLogSources);
+    FRIEND_TEST(StatsLogProcessorTest, TestConfigUpdateReusesUnchangedMetrics);
 
     FRIEND_TEST(StatsLogProcessorTest, TestActiveConfigMetricDiskWriteRead);
     FRIEND_TEST(StatsLogProcessorTest, TestActivationOnBoot);
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "PastBucketArchive.h"
+
+using android::util::ProtoOutputStream;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+static void appendVarint(vector<uint8_t>* bytes, uint64_t value) {
+    while (value >= 0x80) {
+        bytes->push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    bytes->push_back((uint8_t)value);
+}
+
+static uint64_t readVarint(const vector<uint8_t>& bytes, size_t* pos) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (*pos < bytes.size()) {
+        uint8_t byte = bytes[(*pos)++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
+
+void PastBucketArchive::append(const MetricDimensionKey& key, ProtoOutputStream& bucketInfo) {
+    vector<uint8_t> encoded;
+    bucketInfo.serializeToVector(&encoded);
+
+    Arena& arena = mArenas[key];
+    const size_t previousCapacity = arena.bytes.capacity();
+    appendVarint(&arena.bytes, encoded.size());
+    arena.bytes.insert(arena.bytes.end(), encoded.begin(), encoded.end());
+    arena.bucketCount++;
+    mByteSize += arena.bytes.capacity() - previousCapacity;
+}
+
+void PastBucketArchive::writeToProto(const MetricDimensionKey& key, uint64_t fieldId,
+                                     ProtoOutputStream* protoOutput) const {
+    auto it = mArenas.find(key);
+    if (it == mArenas.end()) {
+        return;
+    }
+    const vector<uint8_t>& bytes = it->second.bytes;
+    size_t pos = 0;
+    while (pos < bytes.size()) {
+        size_t size = readVarint(bytes, &pos);
+        if (pos + size > bytes.size()) {
+            ALOGE("Corrupt archived bucket for %s", key.toString().c_str());
+            return;
+        }
+        protoOutput->write(fieldId, reinterpret_cast<const char*>(bytes.data() + pos), size);
+        pos += size;
+    }
+}
+
+size_t PastBucketArchive::bucketCount(const MetricDimensionKey& key) const {
+    auto it = mArenas.find(key);
+    return it != mArenas.end() ? it->second.bucketCount : 0;
+}
+
+size_t PastBucketArchive::byteSize() const {
+    return mByteSize;
+}
+
+void PastBucketArchive::clear() {
+    mArenas.clear();
+    mByteSize = 0;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "HashableDimensionKey.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Number of most recent past buckets of a dimension that metric producers keep decoded, the older
+// ones are archived. Metrics reported at least this often never pay for the encoding.
+const size_t kMaxDecodedPastBuckets = 8;
+
+/**
+ * Past buckets of a metric kept in the encoding of their bucket info message in the report, for
+ * metrics holding many buckets between reports. Each dimension has one byte arena in which the
+ * encoded buckets are appended back to back, each preceded by its varint encoded size. Bucket
+ * times are stored as bucket numbers (or millis for partial buckets) and values as varints, as in
+ * the report, and the arena is copied to the report without decoding.
+ */
+class PastBucketArchive {
+public:
+    // Appends the bucket info that was written to bucketInfo to the buckets of the dimension.
+    void append(const MetricDimensionKey& key, android::util::ProtoOutputStream& bucketInfo);
+
+    /**
+     * Writes the archived buckets of a dimension to the report, oldest first, as repeated
+     * messages of the given field id.
+     */
+    void writeToProto(const MetricDimensionKey& key, uint64_t fieldId,
+                      android::util::ProtoOutputStream* protoOutput) const;
+
+    // Returns the number of archived buckets of a dimension.
+    size_t bucketCount(const MetricDimensionKey& key) const;
+
+    size_t byteSize() const;
+
+    void clear();
+
+private:
+    struct Arena {
+        std::vector<uint8_t> bytes;
+        size_t bucketCount = 0;
+    };
+
+    std::unordered_map<MetricDimensionKey, Arena> mArenas;
+
+    size_t mByteSize = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
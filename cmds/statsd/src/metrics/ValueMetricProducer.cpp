@@ -239,6 +239,7 @@ void ValueMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
 
 void ValueMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
+    mArchivedBuckets.clear();
     mSkippedBuckets.clear();
 }
 
@@ -331,47 +332,14 @@ void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
             protoOutput->end(stateToken);
         }
 
-        // Then fill bucket_info (ValueBucketInfo).
+        // Then fill bucket_info (ValueBucketInfo), the archived buckets being the oldest.
+        mArchivedBuckets.writeToProto(
+                dimensionKey, FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO,
+                protoOutput);
         for (const auto& bucket : pair.second) {
             uint64_t bucketInfoToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
-            } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
-            }
-            // only write the condition timer value if the metric has a condition.
-            if (mConditionTrackerIndex >= 0) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
-                                   (long long)bucket.mConditionTrueNs);
-            }
-            for (int i = 0; i < (int)bucket.valueIndex.size(); i++) {
-                int index = bucket.valueIndex[i];
-                const Value& value = bucket.values[i];
-                uint64_t valueToken = protoOutput->start(
-                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_VALUES);
-                protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_VALUE_INDEX,
-                                   index);
-                if (value.getType() == LONG) {
-                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_VALUE_LONG,
-                                       (long long)value.long_value);
-                    VLOG("\t bucket [%lld - %lld] value %d: %lld", (long long)bucket.mBucketStartNs,
-                         (long long)bucket.mBucketEndNs, index, (long long)value.long_value);
-                } else if (value.getType() == DOUBLE) {
-                    protoOutput->write(FIELD_TYPE_DOUBLE | FIELD_ID_VALUE_DOUBLE,
-                                       value.double_value);
-                    VLOG("\t bucket [%lld - %lld] value %d: %.2f", (long long)bucket.mBucketStartNs,
-                         (long long)bucket.mBucketEndNs, index, value.double_value);
-                } else {
-                    VLOG("Wrong value type for ValueMetric output: %d", value.getType());
-                }
-                protoOutput->end(valueToken);
-            }
+            writeBucketInfoToProto(bucket, protoOutput);
             protoOutput->end(bucketInfoToken);
         }
         protoOutput->end(wrapperToken);
@@ -381,10 +349,65 @@ void ValueMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     VLOG("metric %lld dump report now...", (long long)mMetricId);
     if (erase_data) {
         mPastBuckets.clear();
+        mArchivedBuckets.clear();
         mSkippedBuckets.clear();
     }
 }
 
+void ValueMetricProducer::writeBucketInfoToProto(const ValueBucket& bucket,
+                                                 ProtoOutputStream* protoOutput) {
+    if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                           (long long)NanoToMillis(bucket.mBucketStartNs));
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                           (long long)NanoToMillis(bucket.mBucketEndNs));
+    } else {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                           (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+    }
+    // only write the condition timer value if the metric has a condition.
+    if (mConditionTrackerIndex >= 0) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
+                           (long long)bucket.mConditionTrueNs);
+    }
+    for (int i = 0; i < (int)bucket.valueIndex.size(); i++) {
+        int index = bucket.valueIndex[i];
+        const Value& value = bucket.values[i];
+        uint64_t valueToken = protoOutput->start(
+                FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_VALUES);
+        protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_VALUE_INDEX,
+                           index);
+        if (value.getType() == LONG) {
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_VALUE_LONG,
+                               (long long)value.long_value);
+            VLOG("\t bucket [%lld - %lld] value %d: %lld", (long long)bucket.mBucketStartNs,
+                 (long long)bucket.mBucketEndNs, index, (long long)value.long_value);
+        } else if (value.getType() == DOUBLE) {
+            protoOutput->write(FIELD_TYPE_DOUBLE | FIELD_ID_VALUE_DOUBLE,
+                               value.double_value);
+            VLOG("\t bucket [%lld - %lld] value %d: %.2f", (long long)bucket.mBucketStartNs,
+                 (long long)bucket.mBucketEndNs, index, value.double_value);
+        } else {
+            VLOG("Wrong value type for ValueMetric output: %d", value.getType());
+        }
+        protoOutput->end(valueToken);
+    }
+}
+
+void ValueMetricProducer::archivePastBucketsLocked(const MetricDimensionKey& key,
+                                                   std::vector<ValueBucket>* buckets) {
+    if (buckets->size() <= kMaxDecodedPastBuckets) {
+        return;
+    }
+    const size_t count = buckets->size() - kMaxDecodedPastBuckets;
+    for (size_t i = 0; i < count; i++) {
+        ProtoOutputStream bucketInfo;
+        writeBucketInfoToProto((*buckets)[i], &bucketInfo);
+        mArchivedBuckets.append(key, bucketInfo);
+    }
+    buckets->erase(buckets->begin(), buckets->begin() + count);
+}
+
 void ValueMetricProducer::invalidateCurrentBucketWithoutResetBase(const int64_t dropTimeNs,
                                                                   const BucketDropReason reason) {
     if (!mCurrentBucketIsSkipped) {
@@ -992,6 +1015,7 @@ void ValueMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs,
             if (bucket.valueIndex.size() > 0) {
                 auto& bucketList = mPastBuckets[slice.first];
                 bucketList.push_back(bucket);
+                archivePastBucketsLocked(slice.first, &bucketList);
                 bucketHasData = true;
             }
         }
@@ -1085,6 +1109,16 @@ void ValueMetricProducer::initCurrentSlicedBucket(int64_t nextBucketStartTimeNs)
          (long long)mCurrentBucketStartTimeNs);
 }
 
+void ValueMetricProducer::addPastBucketToAnomalyTrackersLocked(
+        const std::shared_ptr<DimToValMap>& bucket) {
+    // The trackers share the bucket, and each one adds it to its sums in a single pass.
+    for (auto& tracker : mAnomalyTrackers) {
+        if (tracker != nullptr) {
+            tracker->addPastBucket(bucket, mCurrentBucketNum);
+        }
+    }
+}
+
 void ValueMetricProducer::appendToFullBucket(const bool isFullBucketReached) {
     if (mCurrentBucketIsSkipped) {
         if (isFullBucketReached) {
@@ -1108,28 +1142,22 @@ void ValueMetricProducer::appendToFullBucket(const bool isFullBucketReached) {
                     mCurrentFullBucket[slice.first] += interval.value.long_value;
                 }
             }
-            for (const auto& slice : mCurrentFullBucket) {
-                for (auto& tracker : mAnomalyTrackers) {
-                    if (tracker != nullptr) {
-                        tracker->addPastBucket(slice.first, slice.second, mCurrentBucketNum);
-                    }
-                }
+            if (!mAnomalyTrackers.empty()) {
+                addPastBucketToAnomalyTrackersLocked(
+                        std::make_shared<DimToValMap>(std::move(mCurrentFullBucket)));
             }
             mCurrentFullBucket.clear();
-        } else {
+        } else if (!mAnomalyTrackers.empty()) {
             // Skip aggregating the partial buckets since there's no previous partial bucket.
+            std::shared_ptr<DimToValMap> bucket = std::make_shared<DimToValMap>();
             for (const auto& slice : mCurrentSlicedBucket) {
-                for (auto& tracker : mAnomalyTrackers) {
-                    if (tracker != nullptr) {
-                        // TODO: fix this when anomaly can accept double values
-                        auto& interval = slice.second[0];
-                        if (interval.hasValue) {
-                            tracker->addPastBucket(slice.first, interval.value.long_value,
-                                                   mCurrentBucketNum);
-                        }
-                    }
+                // TODO: fix this when anomaly can accept double values
+                auto& interval = slice.second[0];
+                if (interval.hasValue) {
+                    bucket->insert({slice.first, interval.value.long_value});
                 }
             }
+            addPastBucketToAnomalyTrackersLocked(bucket);
         }
     } else {
         // Accumulate partial bucket.
@@ -1148,6 +1176,7 @@ size_t ValueMetricProducer::byteSizeLocked() const {
     for (const auto& pair : mPastBuckets) {
         totalSize += pair.second.size() * kBucketSize;
     }
+    totalSize += mArchivedBuckets.byteSize();
     return totalSize;
 }
 
@@ -25,6 +25,7 @@
 #include "matchers/EventMatcherWizard.h"
 #include "stats_log_util.h"
 #include "MetricProducer.h"
+#include "PastBucketArchive.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 
 namespace android {
@@ -208,6 +209,9 @@ private:
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
     std::unordered_map<MetricDimensionKey, std::vector<ValueBucket>> mPastBuckets;
 
+    // Older past buckets of dimensions with more than kMaxDecodedPastBuckets of them.
+    PastBucketArchive mArchivedBuckets;
+
     const int64_t mMinBucketSizeNs;
 
     // Util function to check whether the specified dimension hits the guardrail.
@@ -229,11 +233,21 @@ private:
 
     void appendToFullBucket(const bool isFullBucketReached);
 
+    // Hands a completed full bucket to all anomaly trackers.
+    void addPastBucketToAnomalyTrackersLocked(const std::shared_ptr<DimToValMap>& bucket);
+
     // Reset diff base and mHasGlobalBase
     void resetBase();
 
     static const size_t kBucketSize = sizeof(ValueBucket{});
 
+    // Writes the fields of the ValueBucketInfo of a past bucket.
+    void writeBucketInfoToProto(const ValueBucket& bucket,
+                                android::util::ProtoOutputStream* protoOutput);
+
+    // Moves all but the most recent kMaxDecodedPastBuckets buckets of a dimension to the archive.
+    void archivePastBucketsLocked(const MetricDimensionKey& key, std::vector<ValueBucket>* buckets);
+
     const size_t mDimensionSoftLimit;
 
     const size_t mDimensionHardLimit;
@@ -113,6 +113,17 @@ public:
             const int64_t& eventTimeNs,
             std::unordered_map<MetricDimensionKey, std::vector<DurationBucket>>* output) = 0;
 
+    // Returns true if the tracker only holds paused durations and has recorded nothing in the
+    // current bucket. Flushing an idle tracker produces no buckets, so the owner may skip it and
+    // call setCurrentBucket() before the tracker is next used.
+    virtual bool isIdle() const = 0;
+
+    // Moves an idle tracker to the owner's current bucket.
+    void setCurrentBucket(const int64_t currentBucketStartNs, const int64_t currentBucketNum) {
+        mCurrentBucketStartTimeNs = currentBucketStartNs;
+        mCurrentBucketNum = currentBucketNum;
+    }
+
     // Predict the anomaly timestamp given the current status.
     virtual int64_t predictAnomalyTimestampNs(const DurationAnomalyTracker& anomalyTracker,
                                               const int64_t currentTimestamp) const = 0;
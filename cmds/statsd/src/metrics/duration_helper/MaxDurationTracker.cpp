@@ -221,6 +221,18 @@ bool MaxDurationTracker::flushIfNeeded(
     return flushCurrentBucket(eventTimeNs, output);
 }
 
+bool MaxDurationTracker::isIdle() const {
+    if (mDuration != 0) {
+        return false;
+    }
+    for (const auto& pair : mInfos) {
+        if (pair.second.state != DurationState::kPaused) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void MaxDurationTracker::onSlicedConditionMayChange(bool overallCondition,
                                                     const int64_t timestamp) {
     // Now for each of the on-going event, check if the condition has changed for them.
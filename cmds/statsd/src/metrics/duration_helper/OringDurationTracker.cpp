@@ -224,6 +224,18 @@ bool OringDurationTracker::flushIfNeeded(
     return flushCurrentBucket(eventTimeNs, output);
 }
 
+bool OringDurationTracker::isIdle() const {
+    if (!mStarted.empty()) {
+        return false;
+    }
+    for (const auto& durationIt : mStateKeyDurationMap) {
+        if (durationIt.second.mDuration != 0 || durationIt.second.mDurationFullBucket != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void OringDurationTracker::onSlicedConditionMayChange(bool overallCondition,
                                                       const int64_t timestamp) {
     vector<pair<HashableDimensionKey, int>> startedToPaused;
@@ -25,6 +25,7 @@
 #include "MetricProducer.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
+#include "hash.h"
 #include "external/StatsPullerManager.h"
 #include "matchers/CombinationLogMatchingTracker.h"
 #include "matchers/EventMatcherWizard.h"
@@ -59,8 +60,263 @@ bool hasLeafNode(const FieldMatcher& matcher) {
     return true;
 }
 
+uint64_t combineHash(const uint64_t hash, const uint64_t value) {
+    return Hash64(reinterpret_cast<const char*>(&value), sizeof(value), hash);
+}
+
+uint64_t findHash(const unordered_map<int64_t, uint64_t>& hashes, const int64_t id) {
+    const auto it = hashes.find(id);
+    return it == hashes.end() ? 0 : it->second;
+}
+
+// Returns the hash of matcher [id], hashing its children first. Unknown ids and cycles hash to 0;
+// initLogTrackers() rejects such configs anyway.
+uint64_t hashMatcher(const StatsdConfig& config, const int64_t id, ConfigHashes& hashes,
+                     set<int64_t>& visiting) {
+    const auto hashIt = hashes.matcherHashes.find(id);
+    if (hashIt != hashes.matcherHashes.end()) {
+        return hashIt->second;
+    }
+    const auto indexIt = hashes.matcherIndices.find(id);
+    if (indexIt == hashes.matcherIndices.end() || !visiting.insert(id).second) {
+        return 0;
+    }
+    const AtomMatcher& matcher = config.atom_matcher(indexIt->second);
+    uint64_t hash = Hash64(matcher.SerializeAsString());
+    for (const int64_t child : matcher.combination().matcher()) {
+        hash = combineHash(hash, hashMatcher(config, child, hashes, visiting));
+    }
+    visiting.erase(id);
+    hashes.matcherHashes[id] = hash;
+    return hash;
+}
+
+// Returns the hash of predicate [id], which covers the matchers and predicates it refers to.
+uint64_t hashPredicate(const StatsdConfig& config, const int64_t id,
+                       const unordered_map<int64_t, int>& predicateIndices, ConfigHashes& hashes,
+                       set<int64_t>& visiting) {
+    const auto hashIt = hashes.predicateHashes.find(id);
+    if (hashIt != hashes.predicateHashes.end()) {
+        return hashIt->second;
+    }
+    const auto indexIt = predicateIndices.find(id);
+    if (indexIt == predicateIndices.end() || !visiting.insert(id).second) {
+        return 0;
+    }
+    const Predicate& predicate = config.predicate(indexIt->second);
+    uint64_t hash = Hash64(predicate.SerializeAsString());
+    if (predicate.has_simple_predicate()) {
+        const SimplePredicate& simplePredicate = predicate.simple_predicate();
+        hash = combineHash(hash, findHash(hashes.matcherHashes, simplePredicate.start()));
+        hash = combineHash(hash, findHash(hashes.matcherHashes, simplePredicate.stop()));
+        hash = combineHash(hash, findHash(hashes.matcherHashes, simplePredicate.stop_all()));
+    }
+    for (const int64_t child : predicate.combination().predicate()) {
+        hash = combineHash(hash, hashPredicate(config, child, predicateIndices, hashes, visiting));
+    }
+    visiting.erase(id);
+    hashes.predicateHashes[id] = hash;
+    return hash;
+}
+
+// The parts of a metric definition that reuse decisions depend on, independently of its type.
+struct MetricDependencies {
+    int64_t id;
+    std::string definition;
+    // Matchers that the metric producer refers to by index.
+    vector<int64_t> matcherIds;
+    // Predicates that the metric producer refers to by index.
+    vector<int64_t> predicateIds;
+    vector<int64_t> stateIds;
+};
+
+template <typename T>
+MetricDependencies getMetricDependencies(const char* type, const T& metric) {
+    MetricDependencies dependencies;
+    dependencies.id = metric.id();
+    dependencies.definition = type + metric.SerializeAsString();
+    if (metric.has_condition()) {
+        dependencies.predicateIds.push_back(metric.condition());
+    }
+    return dependencies;
+}
+
+vector<MetricDependencies> getAllMetricDependencies(const StatsdConfig& config) {
+    vector<MetricDependencies> allDependencies;
+    for (const CountMetric& metric : config.count_metric()) {
+        allDependencies.push_back(getMetricDependencies("count", metric));
+        allDependencies.back().matcherIds.push_back(metric.what());
+        allDependencies.back().stateIds.assign(metric.slice_by_state().begin(),
+                                               metric.slice_by_state().end());
+    }
+    for (const DurationMetric& metric : config.duration_metric()) {
+        allDependencies.push_back(getMetricDependencies("duration", metric));
+        allDependencies.back().predicateIds.push_back(metric.what());
+        allDependencies.back().stateIds.assign(metric.slice_by_state().begin(),
+                                               metric.slice_by_state().end());
+    }
+    for (const EventMetric& metric : config.event_metric()) {
+        allDependencies.push_back(getMetricDependencies("event", metric));
+        allDependencies.back().matcherIds.push_back(metric.what());
+    }
+    for (const ValueMetric& metric : config.value_metric()) {
+        allDependencies.push_back(getMetricDependencies("value", metric));
+        allDependencies.back().matcherIds.push_back(metric.what());
+        allDependencies.back().stateIds.assign(metric.slice_by_state().begin(),
+                                               metric.slice_by_state().end());
+    }
+    for (const GaugeMetric& metric : config.gauge_metric()) {
+        allDependencies.push_back(getMetricDependencies("gauge", metric));
+        allDependencies.back().matcherIds.push_back(metric.what());
+        // The producer keeps the atom id of the trigger matcher.
+        if (metric.has_trigger_event()) {
+            allDependencies.back().matcherIds.push_back(metric.trigger_event());
+        }
+    }
+    for (const MetricActivation& activation : config.metric_activation()) {
+        for (auto& dependencies : allDependencies) {
+            if (dependencies.id != activation.metric_id()) {
+                continue;
+            }
+            dependencies.definition += activation.SerializeAsString();
+            for (const EventActivation& eventActivation : activation.event_activation()) {
+                dependencies.matcherIds.push_back(eventActivation.atom_matcher_id());
+                if (eventActivation.has_deactivation_atom_matcher_id()) {
+                    dependencies.matcherIds.push_back(
+                            eventActivation.deactivation_atom_matcher_id());
+                }
+            }
+        }
+    }
+    return allDependencies;
+}
+
+bool sameIndex(const unordered_map<int64_t, int>& indices,
+               const unordered_map<int64_t, int>& previousIndices, const int64_t id) {
+    const auto it = indices.find(id);
+    const auto previousIt = previousIndices.find(id);
+    return it != indices.end() && previousIt != previousIndices.end() &&
+           it->second == previousIt->second;
+}
+
+bool sameHash(const unordered_map<int64_t, uint64_t>& hashes,
+              const unordered_map<int64_t, uint64_t>& previousHashes, const int64_t id) {
+    const auto it = hashes.find(id);
+    const auto previousIt = previousHashes.find(id);
+    return it != hashes.end() && previousIt != previousHashes.end() &&
+           it->second == previousIt->second;
+}
+
+// Returns the producer that [reusePlan] carries over for [metricId], or nullptr.
+sp<MetricProducer> findReusedMetric(const ConfigReusePlan* reusePlan, const int64_t metricId) {
+    if (reusePlan == nullptr) {
+        return nullptr;
+    }
+    const auto it = reusePlan->metricProducers.find(metricId);
+    return it == reusePlan->metricProducers.end() ? nullptr : it->second;
+}
+
 }  // namespace
 
+void computeConfigHashes(const StatsdConfig& config, ConfigHashes& hashes) {
+    for (int i = 0; i < config.atom_matcher_size(); i++) {
+        hashes.matcherIndices[config.atom_matcher(i).id()] = i;
+    }
+    set<int64_t> visiting;
+    for (const AtomMatcher& matcher : config.atom_matcher()) {
+        hashMatcher(config, matcher.id(), hashes, visiting);
+    }
+
+    unordered_map<int64_t, int> predicateIndices;
+    for (int i = 0; i < config.predicate_size(); i++) {
+        hashes.predicateIds.push_back(config.predicate(i).id());
+        predicateIndices[config.predicate(i).id()] = i;
+    }
+    for (const Predicate& predicate : config.predicate()) {
+        hashPredicate(config, predicate.id(), predicateIndices, hashes, visiting);
+    }
+
+    unordered_map<int64_t, uint64_t> stateHashes;
+    for (const State& state : config.state()) {
+        stateHashes[state.id()] = Hash64(state.SerializeAsString());
+    }
+    for (const MetricDependencies& dependencies : getAllMetricDependencies(config)) {
+        uint64_t hash = Hash64(dependencies.definition);
+        for (const int64_t matcherId : dependencies.matcherIds) {
+            hash = combineHash(hash, findHash(hashes.matcherHashes, matcherId));
+        }
+        for (const int64_t predicateId : dependencies.predicateIds) {
+            hash = combineHash(hash, findHash(hashes.predicateHashes, predicateId));
+        }
+        for (const int64_t stateId : dependencies.stateIds) {
+            hash = combineHash(hash, findHash(stateHashes, stateId));
+        }
+        hashes.metricHashes[dependencies.id] = hash;
+    }
+
+    for (const Alert& alert : config.alert()) {
+        hashes.alertedMetricIds.insert(alert.metric_id());
+    }
+}
+
+ConfigReusePlan planConfigReuse(const StatsdConfig& config, const ConfigHashes& hashes,
+                                const ConfigHashes& previousHashes,
+                                const vector<sp<ConditionTracker>>& previousConditionTrackers,
+                                const vector<sp<MetricProducer>>& previousMetricProducers) {
+    ConfigReusePlan plan;
+
+    // Condition trackers refer to each other and to matchers by index, so they can only be reused
+    // if the predicates are identical and in the same order, and their matchers have not moved.
+    plan.reuseConditions = !hashes.predicateIds.empty() &&
+                           hashes.predicateIds == previousHashes.predicateIds &&
+                           previousConditionTrackers.size() == hashes.predicateIds.size();
+    for (const Predicate& predicate : config.predicate()) {
+        if (!plan.reuseConditions) {
+            break;
+        }
+        plan.reuseConditions =
+                sameHash(hashes.predicateHashes, previousHashes.predicateHashes, predicate.id());
+        if (plan.reuseConditions && predicate.has_simple_predicate()) {
+            const SimplePredicate& simplePredicate = predicate.simple_predicate();
+            for (const int64_t matcherId : {simplePredicate.start(), simplePredicate.stop(),
+                                            simplePredicate.stop_all()}) {
+                if (hashes.matcherIndices.count(matcherId) != 0 &&
+                    !sameIndex(hashes.matcherIndices, previousHashes.matcherIndices, matcherId)) {
+                    plan.reuseConditions = false;
+                }
+            }
+        }
+    }
+    if (plan.reuseConditions) {
+        plan.conditionTrackers = previousConditionTrackers;
+    }
+
+    unordered_map<int64_t, sp<MetricProducer>> previousProducers;
+    for (const auto& producer : previousMetricProducers) {
+        previousProducers[producer->getMetricId()] = producer;
+    }
+    for (const MetricDependencies& dependencies : getAllMetricDependencies(config)) {
+        const int64_t id = dependencies.id;
+        const auto producerIt = previousProducers.find(id);
+        if (producerIt == previousProducers.end() ||
+            !sameHash(hashes.metricHashes, previousHashes.metricHashes, id) ||
+            hashes.alertedMetricIds.count(id) != 0 ||
+            previousHashes.alertedMetricIds.count(id) != 0 ||
+            (!dependencies.predicateIds.empty() && !plan.reuseConditions)) {
+            continue;
+        }
+        bool matchersUnmoved = true;
+        for (const int64_t matcherId : dependencies.matcherIds) {
+            matchersUnmoved &=
+                    sameIndex(hashes.matcherIndices, previousHashes.matcherIndices, matcherId);
+        }
+        if (matchersUnmoved) {
+            plan.metricProducers[id] = producerIt->second;
+        }
+    }
+    return plan;
+}
+
 bool handleMetricWithLogTrackers(const int64_t what, const int metricIndex,
                                  const bool usedForDimension,
                                  const vector<sp<LogMatchingTracker>>& allAtomMatchers,
@@ -286,7 +542,9 @@ bool initConditions(const ConfigKey& key, const StatsdConfig& config,
                     unordered_map<int64_t, int>& conditionTrackerMap,
                     vector<sp<ConditionTracker>>& allConditionTrackers,
                     unordered_map<int, std::vector<int>>& trackerToConditionMap,
-                    vector<ConditionState>& initialConditionCache) {
+                    vector<ConditionState>& initialConditionCache,
+                    const ConfigReusePlan* reusePlan) {
+    const bool reuseConditions = reusePlan != nullptr && reusePlan->reuseConditions;
     vector<Predicate> conditionConfigs;
     const int conditionTrackerCount = config.predicate_size();
     conditionConfigs.reserve(conditionTrackerCount);
@@ -297,20 +555,26 @@ bool initConditions(const ConfigKey& key, const StatsdConfig& config,
     for (int i = 0; i < conditionTrackerCount; i++) {
         const Predicate& condition = config.predicate(i);
         int index = allConditionTrackers.size();
-        switch (condition.contents_case()) {
-            case Predicate::ContentsCase::kSimplePredicate: {
-                allConditionTrackers.push_back(new SimpleConditionTracker(
-                        key, condition.id(), index, condition.simple_predicate(), logTrackerMap));
-                break;
-            }
-            case Predicate::ContentsCase::kCombination: {
-                allConditionTrackers.push_back(
-                        new CombinationConditionTracker(condition.id(), index));
-                break;
+        if (reuseConditions) {
+            // The previous config had identical predicates, so its trackers keep their state.
+            allConditionTrackers.push_back(reusePlan->conditionTrackers[i]);
+        } else {
+            switch (condition.contents_case()) {
+                case Predicate::ContentsCase::kSimplePredicate: {
+                    allConditionTrackers.push_back(new SimpleConditionTracker(
+                            key, condition.id(), index, condition.simple_predicate(),
+                            logTrackerMap));
+                    break;
+                }
+                case Predicate::ContentsCase::kCombination: {
+                    allConditionTrackers.push_back(
+                            new CombinationConditionTracker(condition.id(), index));
+                    break;
+                }
+                default:
+                    ALOGE("Predicate \"%lld\" malformed", (long long)condition.id());
+                    return false;
             }
-            default:
-                ALOGE("Predicate \"%lld\" malformed", (long long)condition.id());
-                return false;
         }
         if (conditionTrackerMap.find(condition.id()) != conditionTrackerMap.end()) {
             ALOGE("Duplicate Predicate found!");
@@ -327,6 +591,9 @@ bool initConditions(const ConfigKey& key, const StatsdConfig& config,
                                     stackTracker, initialConditionCache)) {
             return false;
         }
+        if (reuseConditions) {
+            initialConditionCache[i] = conditionTracker->getUnSlicedPartConditionState();
+        }
         for (const int trackerIndex : conditionTracker->getLogTrackerIndex()) {
             auto& conditionList = trackerToConditionMap[trackerIndex];
             conditionList.push_back(i);
@@ -368,7 +635,7 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
                  unordered_map<int64_t, int>& metricMap, std::set<int64_t>& noReportMetricIds,
                  unordered_map<int, vector<int>>& activationAtomTrackerToMetricMap,
                  unordered_map<int, vector<int>>& deactivationAtomTrackerToMetricMap,
-                 vector<int>& metricsWithActivation) {
+                 vector<int>& metricsWithActivation, const ConfigReusePlan* reusePlan) {
     sp<ConditionWizard> wizard = new ConditionWizard(allConditionTrackers);
     sp<EventMatcherWizard> matcherWizard = new EventMatcherWizard(allAtomMatchers);
     const int allMetricsCount = config.count_metric_size() + config.duration_metric_size() +
@@ -444,10 +711,13 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
                 eventDeactivationMap);
         if (!success) return false;
 
-        sp<MetricProducer> countProducer =
-                new CountMetricProducer(key, metric, conditionIndex, initialConditionCache, wizard,
-                                        timeBaseTimeNs, currentTimeNs, eventActivationMap,
-                                        eventDeactivationMap, slicedStateAtoms, stateGroupMap);
+        sp<MetricProducer> countProducer = findReusedMetric(reusePlan, metric.id());
+        if (countProducer == nullptr) {
+            countProducer = new CountMetricProducer(
+                    key, metric, conditionIndex, initialConditionCache, wizard, timeBaseTimeNs,
+                    currentTimeNs, eventActivationMap, eventDeactivationMap, slicedStateAtoms,
+                    stateGroupMap);
+        }
         allMetricProducers.push_back(countProducer);
     }
 
@@ -550,11 +820,14 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
                 eventDeactivationMap);
         if (!success) return false;
 
-        sp<MetricProducer> durationMetric = new DurationMetricProducer(
-                key, metric, conditionIndex, initialConditionCache, trackerIndices[0],
-                trackerIndices[1], trackerIndices[2], nesting, wizard, internalDimensions,
-                timeBaseTimeNs, currentTimeNs, eventActivationMap, eventDeactivationMap,
-                slicedStateAtoms, stateGroupMap);
+        sp<MetricProducer> durationMetric = findReusedMetric(reusePlan, metric.id());
+        if (durationMetric == nullptr) {
+            durationMetric = new DurationMetricProducer(
+                    key, metric, conditionIndex, initialConditionCache, trackerIndices[0],
+                    trackerIndices[1], trackerIndices[2], nesting, wizard, internalDimensions,
+                    timeBaseTimeNs, currentTimeNs, eventActivationMap, eventDeactivationMap,
+                    slicedStateAtoms, stateGroupMap);
+        }
 
         allMetricProducers.push_back(durationMetric);
     }
@@ -568,6 +841,11 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
             ALOGW("cannot find the metric name or what in config");
             return false;
         }
+        if (metric.sampling_percentage() < 1 || metric.sampling_percentage() > 100) {
+            ALOGW("invalid sampling_percentage in EventMetric \"%lld\"",
+                  (long long)metric.id());
+            return false;
+        }
         int trackerIndex;
         if (!handleMetricWithLogTrackers(metric.what(), metricIndex, false, allAtomMatchers,
                                          logTrackerMap, trackerToMetricMap, trackerIndex)) {
@@ -597,9 +875,12 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
                 eventDeactivationMap);
         if (!success) return false;
 
-        sp<MetricProducer> eventMetric =
-                new EventMetricProducer(key, metric, conditionIndex, initialConditionCache, wizard,
-                                        timeBaseTimeNs, eventActivationMap, eventDeactivationMap);
+        sp<MetricProducer> eventMetric = findReusedMetric(reusePlan, metric.id());
+        if (eventMetric == nullptr) {
+            eventMetric = new EventMetricProducer(key, metric, conditionIndex,
+                                                  initialConditionCache, wizard, timeBaseTimeNs,
+                                                  eventActivationMap, eventDeactivationMap);
+        }
 
         allMetricProducers.push_back(eventMetric);
     }
@@ -686,10 +967,13 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
                 metricsWithActivation, eventActivationMap, eventDeactivationMap);
         if (!success) return false;
 
-        sp<MetricProducer> valueProducer = new ValueMetricProducer(
-                key, metric, conditionIndex, initialConditionCache, wizard, trackerIndex,
-                matcherWizard, pullTagId, timeBaseTimeNs, currentTimeNs, pullerManager,
-                eventActivationMap, eventDeactivationMap, slicedStateAtoms, stateGroupMap);
+        sp<MetricProducer> valueProducer = findReusedMetric(reusePlan, metric.id());
+        if (valueProducer == nullptr) {
+            valueProducer = new ValueMetricProducer(
+                    key, metric, conditionIndex, initialConditionCache, wizard, trackerIndex,
+                    matcherWizard, pullTagId, timeBaseTimeNs, currentTimeNs, pullerManager,
+                    eventActivationMap, eventDeactivationMap, slicedStateAtoms, stateGroupMap);
+        }
         allMetricProducers.push_back(valueProducer);
     }
 
@@ -781,10 +1065,13 @@ bool initMetrics(const ConfigKey& key, const StatsdConfig& config, const int64_t
                 eventDeactivationMap);
         if (!success) return false;
 
-        sp<MetricProducer> gaugeProducer = new GaugeMetricProducer(
-                key, metric, conditionIndex, initialConditionCache, wizard, trackerIndex,
-                matcherWizard, pullTagId, triggerAtomId, atomTagId, timeBaseTimeNs, currentTimeNs,
-                pullerManager, eventActivationMap, eventDeactivationMap);
+        sp<MetricProducer> gaugeProducer = findReusedMetric(reusePlan, metric.id());
+        if (gaugeProducer == nullptr) {
+            gaugeProducer = new GaugeMetricProducer(
+                    key, metric, conditionIndex, initialConditionCache, wizard, trackerIndex,
+                    matcherWizard, pullTagId, triggerAtomId, atomTagId, timeBaseTimeNs,
+                    currentTimeNs, pullerManager, eventActivationMap, eventDeactivationMap);
+        }
         allMetricProducers.push_back(gaugeProducer);
     }
     for (int i = 0; i < config.no_report_metric_size(); ++i) {
@@ -931,7 +1218,8 @@ bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap&
                       unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
                       unordered_map<int64_t, int>& alertTrackerMap,
                       vector<int>& metricsWithActivation,
-                      std::set<int64_t>& noReportMetricIds) {
+                      std::set<int64_t>& noReportMetricIds,
+                      const ConfigReusePlan* reusePlan) {
     unordered_map<int64_t, int> logTrackerMap;
     unordered_map<int64_t, int> conditionTrackerMap;
     vector<ConditionState> initialConditionCache;
@@ -946,7 +1234,7 @@ bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap&
     VLOG("initLogMatchingTrackers succeed...");
 
     if (!initConditions(key, config, logTrackerMap, conditionTrackerMap, allConditionTrackers,
-                        trackerToConditionMap, initialConditionCache)) {
+                        trackerToConditionMap, initialConditionCache, reusePlan)) {
         ALOGE("initConditionTrackers failed");
         return false;
     }
@@ -960,7 +1248,7 @@ bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap&
                      allConditionTrackers, initialConditionCache, allMetricProducers,
                      conditionToMetricMap, trackerToMetricMap, metricProducerMap, noReportMetricIds,
                      activationAtomTrackerToMetricMap, deactivationAtomTrackerToMetricMap,
-                     metricsWithActivation)) {
+                     metricsWithActivation, reusePlan)) {
         ALOGE("initMetricProducers failed");
         return false;
     }
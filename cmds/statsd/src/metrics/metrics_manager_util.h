@@ -30,6 +30,48 @@ namespace android {
 namespace os {
 namespace statsd {
 
+// Hashes of the matchers, predicates and metrics of a config, keyed by id. Each hash covers the
+// definition of the element and of everything it references, so an element with the same id and
+// hash in two versions of a config is built in exactly the same way.
+struct ConfigHashes {
+    std::unordered_map<int64_t, uint64_t> matcherHashes;
+    std::unordered_map<int64_t, uint64_t> predicateHashes;
+    std::unordered_map<int64_t, uint64_t> metricHashes;
+
+    // Position of each matcher in the config, which is its LogMatchingTracker index.
+    std::unordered_map<int64_t, int> matcherIndices;
+
+    // Predicate ids in config order, which is their ConditionTracker index.
+    std::vector<int64_t> predicateIds;
+
+    // Metrics that an Alert refers to.
+    std::set<int64_t> alertedMetricIds;
+};
+
+// The parts of the previous version of a config that an update carries over instead of building
+// them again, so that they keep their state.
+struct ConfigReusePlan {
+    // True if every predicate is unchanged, in which case all of [conditionTrackers] are reused.
+    bool reuseConditions = false;
+    std::vector<sp<ConditionTracker>> conditionTrackers;
+
+    // Unchanged metric producers, keyed by metric id.
+    std::unordered_map<int64_t, sp<MetricProducer>> metricProducers;
+};
+
+// Computes the ConfigHashes of [config].
+void computeConfigHashes(const StatsdConfig& config, ConfigHashes& hashes);
+
+// Decides what an update from the previous version of a config to [config] can reuse.
+// Condition trackers are reused all or nothing, since metrics and other conditions refer to them
+// by index. A metric producer is reused only if its definition and everything it depends on is
+// unchanged, the matchers it refers to keep their indices, its condition trackers are reused, and
+// no Alert refers to it in either version.
+ConfigReusePlan planConfigReuse(const StatsdConfig& config, const ConfigHashes& hashes,
+                                const ConfigHashes& previousHashes,
+                                const std::vector<sp<ConditionTracker>>& previousConditionTrackers,
+                                const std::vector<sp<MetricProducer>>& previousMetricProducers);
+
 // Helper functions for MetricsManager to initialize from StatsdConfig.
 // *Note*: only initStatsdConfig() should be called from outside.
 // All other functions are intermediate
@@ -61,13 +103,15 @@ bool initLogTrackers(const StatsdConfig& config,
 // [trackerToConditionMap]: contain the mapping from index of
 //                        log tracker to condition trackers that use the log tracker
 // [initialConditionCache]: stores the initial conditions for each ConditionTracker
+// [reusePlan]: if set and its conditions are reusable, the ConditionTrackers of the previous
+//              config are used instead of new ones
 bool initConditions(const ConfigKey& key, const StatsdConfig& config,
                     const std::unordered_map<int64_t, int>& logTrackerMap,
                     std::unordered_map<int64_t, int>& conditionTrackerMap,
                     std::vector<sp<ConditionTracker>>& allConditionTrackers,
                     std::unordered_map<int, std::vector<int>>& trackerToConditionMap,
-                    std::unordered_map<int, std::vector<MetricConditionLink>>& eventConditionLinks,
-                    std::vector<ConditionState>& initialConditionCache);
+                    std::vector<ConditionState>& initialConditionCache,
+                    const ConfigReusePlan* reusePlan = nullptr);
 
 // Initialize State maps using State protos in the config. These maps will
 // eventually be passed to MetricProducers to initialize their state info.
@@ -90,6 +134,7 @@ bool initStates(const StatsdConfig& config, unordered_map<int64_t, int>& stateAt
 // [stateAtomIdMap]: contains the mapping from state ids to atom ids
 // [allStateGroupMaps]: contains the mapping from atom ids and state values to
 //                      state group ids for all states
+// [reusePlan]: if set, its MetricProducers are used instead of new ones for the same metric ids
 // output:
 // [allMetricProducers]: contains the list of sp to the MetricProducers created.
 // [conditionToMetricMap]: contains the mapping from condition tracker index to
@@ -112,10 +157,11 @@ bool initMetrics(
         std::set<int64_t>& noReportMetricIds,
         std::unordered_map<int, std::vector<int>>& activationAtomTrackerToMetricMap,
         std::unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
-        std::vector<int>& metricsWithActivation);
+        std::vector<int>& metricsWithActivation, const ConfigReusePlan* reusePlan = nullptr);
 
 // Initialize MetricsManager from StatsdConfig.
 // Parameters are the members of MetricsManager. See MetricsManager for declaration.
+// [reusePlan] is set when the config replaces a previous version of itself.
 bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap& uidMap,
                       const sp<StatsPullerManager>& pullerManager,
                       const sp<AlarmMonitor>& anomalyAlarmMonitor,
@@ -133,7 +179,8 @@ bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap&
                       unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
                       std::unordered_map<int64_t, int>& alertTrackerMap,
                       vector<int>& metricsWithActivation,
-                      std::set<int64_t>& noReportMetricIds);
+                      std::set<int64_t>& noReportMetricIds,
+                      const ConfigReusePlan* reusePlan = nullptr);
 
 }  // namespace statsd
 }  // namespace os
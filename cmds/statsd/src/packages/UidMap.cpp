@@ -51,6 +51,7 @@ const int FIELD_ID_SNAPSHOT_PACKAGE_INSTALLER = 8;
 const int FIELD_ID_SNAPSHOT_PACKAGE_INSTALLER_HASH = 9;
 const int FIELD_ID_SNAPSHOT_TIMESTAMP = 1;
 const int FIELD_ID_SNAPSHOT_PACKAGE_INFO = 2;
+const int FIELD_ID_SNAPSHOT_IS_DELTA = 3;
 const int FIELD_ID_SNAPSHOTS = 1;
 const int FIELD_ID_CHANGES = 2;
 const int FIELD_ID_CHANGE_DELETION = 1;
@@ -128,12 +129,28 @@ void UidMap::updateMap(const int64_t& timestamp, const vector<int32_t>& uid,
             }
         }
 
-        mMap.clear();
+        std::unordered_map<std::pair<int, string>, AppData, PairHash> previousMap;
+        previousMap.swap(mMap);
         for (size_t j = 0; j < uid.size(); j++) {
             string package = string(String8(packageName[j]).string());
-            mMap[std::make_pair(uid[j], package)] =
-                    AppData(versionCode[j], string(String8(versionString[j]).string()),
-                            string(String8(installer[j]).string()));
+            const auto key = std::make_pair(uid[j], package);
+            AppData appData(versionCode[j], string(String8(versionString[j]).string()),
+                            string(String8(installer[j]).string()), timestamp);
+            // Keep the update time of unchanged entries so delta snapshots leave them out.
+            auto previousIt = previousMap.find(key);
+            if (previousIt != previousMap.end() && !previousIt->second.deleted &&
+                previousIt->second.versionCode == appData.versionCode &&
+                previousIt->second.versionString == appData.versionString &&
+                previousIt->second.installer == appData.installer) {
+                appData.updateTimestampNs = previousIt->second.updateTimestampNs;
+            }
+            mMap[key] = appData;
+        }
+        for (const auto& kv : previousMap) {
+            if (!kv.second.deleted && mMap.find(kv.first) == mMap.end()) {
+                mLastDroppedPackageNs = timestamp;
+                break;
+            }
         }
 
         for (const auto& kv : deletedApps) {
@@ -178,11 +195,12 @@ void UidMap::updateApp(const int64_t& timestamp, const String16& app_16, const i
             it->second.versionString = newVersionString;
             it->second.installer = string(String8(installer).string());
             it->second.deleted = false;
+            it->second.updateTimestampNs = timestamp;
         }
         if (!found) {
             // Otherwise, we need to add an app at this uid.
-            mMap[std::make_pair(uid, appName)] =
-                    AppData(versionCode, newVersionString, string(String8(installer).string()));
+            mMap[std::make_pair(uid, appName)] = AppData(
+                    versionCode, newVersionString, string(String8(installer).string()), timestamp);
         } else {
             // Only notify the listeners if this is an app upgrade. If this app is being installed
             // for the first time, then we don't notify the listeners.
@@ -235,6 +253,7 @@ void UidMap::removeApp(const int64_t& timestamp, const String16& app_16, const i
             prevVersion = it->second.versionCode;
             prevVersionString = it->second.versionString;
             it->second.deleted = true;
+            it->second.updateTimestampNs = timestamp;
             mDeletedApps.push_back(key);
         }
         if (mDeletedApps.size() > StatsdStats::kMaxDeletedAppsInUidMap) {
@@ -242,6 +261,7 @@ void UidMap::removeApp(const int64_t& timestamp, const String16& app_16, const i
             auto oldest = mDeletedApps.front();
             mDeletedApps.pop_front();
             mMap.erase(oldest);
+            mLastDroppedPackageNs = timestamp;
             StatsdStats::getInstance().noteUidMapAppDeletionDropped();
         }
         mChanges.emplace_back(true, timestamp, app, uid, 0, "", prevVersion, prevVersionString);
@@ -318,19 +338,26 @@ void UidMap::writeUidMapSnapshot(int64_t timestamp, bool includeVersionStrings,
     lock_guard<mutex> lock(mMutex);
 
     writeUidMapSnapshotLocked(timestamp, includeVersionStrings, includeInstaller, interestingUids,
-                              str_set, proto);
+                              -1 /* changedAfterNs */, str_set, proto);
 }
 
 void UidMap::writeUidMapSnapshotLocked(int64_t timestamp, bool includeVersionStrings,
                                        bool includeInstaller,
                                        const std::set<int32_t>& interestingUids,
-                                       std::set<string>* str_set, ProtoOutputStream* proto) {
+                                       int64_t changedAfterNs, std::set<string>* str_set,
+                                       ProtoOutputStream* proto) {
     proto->write(FIELD_TYPE_INT64 | FIELD_ID_SNAPSHOT_TIMESTAMP, (long long)timestamp);
+    if (changedAfterNs >= 0) {
+        proto->write(FIELD_TYPE_BOOL | FIELD_ID_SNAPSHOT_IS_DELTA, true);
+    }
     for (const auto& kv : mMap) {
         if (!interestingUids.empty() &&
             interestingUids.find(kv.first.first) == interestingUids.end()) {
             continue;
         }
+        if (kv.second.updateTimestampNs <= changedAfterNs) {
+            continue;
+        }
         uint64_t token = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
                                       FIELD_ID_SNAPSHOT_PACKAGE_INFO);
         if (str_set != nullptr) {
@@ -368,12 +395,20 @@ void UidMap::writeUidMapSnapshotLocked(int64_t timestamp, bool includeVersionStr
 }
 
 void UidMap::appendUidMap(const int64_t& timestamp, const ConfigKey& key, std::set<string>* str_set,
-                          bool includeVersionStrings, bool includeInstaller,
-                          ProtoOutputStream* proto) {
+                          bool includeVersionStrings, bool includeInstaller, bool deltaSnapshot,
+                          bool eraseData, ProtoOutputStream* proto) {
     lock_guard<mutex> lock(mMutex);  // Lock for updates
 
+    // A delta is relative to the previous output for this key, which must exist and postdate
+    // any package that silently left the map.
+    const int64_t lastUpdateNs = mLastUpdatePerConfigKey[key];
+    const int64_t changedAfterNs =
+            deltaSnapshot && lastUpdateNs >= 0 && lastUpdateNs >= mLastDroppedPackageNs
+                    ? lastUpdateNs
+                    : -1;
+
     for (const ChangeRecord& record : mChanges) {
-        if (record.timestampNs > mLastUpdatePerConfigKey[key]) {
+        if (record.timestampNs > lastUpdateNs) {
             uint64_t changesToken =
                     proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_CHANGES);
             proto->write(FIELD_TYPE_BOOL | FIELD_ID_CHANGE_DELETION, (bool)record.deletion);
@@ -414,9 +449,13 @@ void UidMap::appendUidMap(const int64_t& timestamp, const ConfigKey& key, std::s
             proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SNAPSHOTS);
     writeUidMapSnapshotLocked(timestamp, includeVersionStrings, includeInstaller,
                               std::set<int32_t>() /*empty uid set means including every uid*/,
-                              str_set, proto);
+                              changedAfterNs, str_set, proto);
     proto->end(snapshotsToken);
 
+    if (!eraseData) {
+        return;
+    }
+
     int64_t prevMin = getMinimumTimestampNs();
     mLastUpdatePerConfigKey[key] = timestamp;
     int64_t newMin = getMinimumTimestampNs();
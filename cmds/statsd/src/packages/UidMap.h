@@ -46,13 +46,21 @@ struct AppData {
     string versionString;
     string installer;
     bool deleted;
+    // When this entry last changed. Delta snapshots only include entries changed since the
+    // previous report.
+    int64_t updateTimestampNs;
 
     // Empty constructor needed for unordered map.
     AppData() {
     }
 
-    AppData(const int64_t v, const string& versionString, const string& installer)
-        : versionCode(v), versionString(versionString), installer(installer), deleted(false){};
+    AppData(const int64_t v, const string& versionString, const string& installer,
+            const int64_t updateTimestampNs)
+        : versionCode(v),
+          versionString(versionString),
+          installer(installer),
+          deleted(false),
+          updateTimestampNs(updateTimestampNs){};
 };
 
 // When calling appendUidMap, we retrieve all the ChangeRecords since the last
@@ -137,9 +145,13 @@ public:
     // Gets all snapshots and changes that have occurred since the last output.
     // If every config key has received a change or snapshot record, then this
     // record is deleted.
+    // If deltaSnapshot is true, the snapshot only lists the packages that changed since the
+    // previous output for this config key, unless that output cannot serve as a base.
+    // Only an output with eraseData set counts as the previous output, since the data of a
+    // report that doesn't erase it is reported again.
     void appendUidMap(const int64_t& timestamp, const ConfigKey& key, std::set<string>* str_set,
-                      bool includeVersionStrings, bool includeInstaller,
-                      ProtoOutputStream* proto);
+                      bool includeVersionStrings, bool includeInstaller, bool deltaSnapshot,
+                      bool eraseData, ProtoOutputStream* proto);
 
     // Forces the output to be cleared. We still generate a snapshot based on the current state.
     // This results in extra data uploaded but helps us reconstruct the uid mapping on the server
@@ -164,9 +176,11 @@ private:
     std::set<string> getAppNamesFromUidLocked(const int32_t& uid, bool returnNormalized) const;
     string normalizeAppName(const string& appName) const;
 
+    // changedAfterNs: only write the packages updated after this time. -1 writes every package.
     void writeUidMapSnapshotLocked(int64_t timestamp, bool includeVersionStrings,
                                    bool includeInstaller, const std::set<int32_t>& interestingUids,
-                                   std::set<string>* str_set, ProtoOutputStream* proto);
+                                   int64_t changedAfterNs, std::set<string>* str_set,
+                                   ProtoOutputStream* proto);
 
     mutable mutex mMutex;
     mutable mutex mIsolatedMutex;
@@ -198,6 +212,10 @@ private:
     // Value of -1 denotes this config key has never received an upload.
     std::unordered_map<ConfigKey, int64_t> mLastUpdatePerConfigKey;
 
+    // Last time a package left mMap without first being marked as deleted. A delta snapshot
+    // cannot express that, so outputs older than this need a full snapshot.
+    int64_t mLastDroppedPackageNs = -1;
+
     // Returns the minimum value from mConfigKeys.
     int64_t getMinimumTimestampNs();
 
@@ -218,6 +236,7 @@ private:
     FRIEND_TEST(UidMapTest, TestRemovedAppRetained);
     FRIEND_TEST(UidMapTest, TestRemovedAppOverGuardrail);
     FRIEND_TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot);
+    FRIEND_TEST(UidMapTest, TestDeltaSnapshot);
     FRIEND_TEST(UidMapTest, TestMemoryComputed);
     FRIEND_TEST(UidMapTest, TestMemoryGuardrail);
 };
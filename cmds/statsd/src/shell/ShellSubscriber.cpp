@@ -18,7 +18,10 @@
 
 #include "ShellSubscriber.h"
 
+#include <algorithm>
+
 #include <android-base/file.h>
+#include <zlib.h>
 
 #include "matchers/matcher_util.h"
 #include "stats_log_util.h"
@@ -30,6 +33,7 @@ namespace os {
 namespace statsd {
 
 const static int FIELD_ID_ATOM = 1;
+const static int FIELD_ID_DROPPED_ATOM_COUNT = 2;
 
 void ShellSubscriber::startNewSubscription(int in, int out, int timeoutSec) {
     int myToken = claimToken();
@@ -42,6 +46,12 @@ void ShellSubscriber::startNewSubscription(int in, int out, int timeoutSec) {
     {
         std::unique_lock<std::mutex> lock(mMutex);
         mSubscriptionInfo = mySubscriptionInfo;
+        // Whatever the previous subscription had not sent yet is dropped.
+        mProto.clear();
+        mPendingAtoms = 0;
+        mDroppedAtoms = 0;
+        mFlushPending = false;
+        mBatchReady.notify_all();
         spawnHelperThread(myToken);
         waitForSubscriptionToEndLocked(mySubscriptionInfo, myToken, lock, timeoutSec);
 
@@ -100,8 +110,12 @@ bool ShellSubscriber::readConfig(shared_ptr<SubscriptionInfo> subscriptionInfo)
     }
 
     // Update SubscriptionInfo with state from config
+    subscriptionInfo->mMaxBatchAtoms = std::max(1, config.max_batch_atoms());
+    subscriptionInfo->mMaxBatchDelayMs = std::max(0, config.max_batch_delay_millis());
+    subscriptionInfo->mCompressBatches = config.compress_batches();
+
     for (const auto& pushed : config.pushed()) {
-        subscriptionInfo->mPushedMatchers.push_back(pushed);
+        subscriptionInfo->mPushedMatchers.push_back(compileSimpleMatcher(pushed));
     }
 
     for (const auto& pulled : config.pulled()) {
@@ -126,14 +140,16 @@ bool ShellSubscriber::readConfig(shared_ptr<SubscriptionInfo> subscriptionInfo)
 
 void ShellSubscriber::pullAndSendHeartbeats(int myToken) {
     VLOG("ShellSubscriber: helper thread %d starting", myToken);
+    vector<uint8_t> payload;
     while (true) {
-        int64_t sleepTimeMs = INT_MAX;
+        shared_ptr<SubscriptionInfo> subscriptionInfo;
         {
-            std::lock_guard<std::mutex> lock(mMutex);
+            std::unique_lock<std::mutex> lock(mMutex);
             if (!mSubscriptionInfo || mToken != myToken) {
                 VLOG("ShellSubscriber: helper thread %d done!", myToken);
                 return;
             }
+            subscriptionInfo = mSubscriptionInfo;
 
             int64_t nowMillis = getElapsedRealtimeMillis();
             int64_t nowNanos = getElapsedRealtimeNs();
@@ -153,26 +169,48 @@ void ShellSubscriber::pullAndSendHeartbeats(int myToken) {
                 pullInfo.mPrevPullElapsedRealtimeMs = nowMillis;
             }
 
-            // Send a heartbeat, consisting of a data size of 0, if perfd hasn't recently received
-            // data from statsd. When it receives the data size of 0, perfd will not expect any
-            // atoms and recheck whether the subscription should end.
-            if (nowMillis - mLastWriteMs > kMsBetweenHeartbeats) {
-                attemptWriteToPipeLocked(/*dataSize=*/0);
-            }
+            if (isBatchReadyLocked(nowMillis)) {
+                takeBatchLocked(&payload);
+            } else if (nowMillis - mLastWriteMs > kMsBetweenHeartbeats) {
+                // Send a heartbeat, consisting of a data size of 0, if perfd hasn't recently
+                // received data from statsd. When it receives the data size of 0, perfd will not
+                // expect any atoms and recheck whether the subscription should end.
+                payload.clear();
+            } else {
+                // Determine how long to sleep before doing more work.
+                int64_t sleepTimeMs = INT_MAX;
+                for (PullInfo& pullInfo : mSubscriptionInfo->mPulledInfo) {
+                    int64_t nextPullTime = pullInfo.mPrevPullElapsedRealtimeMs + pullInfo.mInterval;
+                    int64_t timeBeforePull = nextPullTime - nowMillis;  // guaranteed non-negative
+                    if (timeBeforePull < sleepTimeMs) sleepTimeMs = timeBeforePull;
+                }
+                int64_t timeBeforeHeartbeat = (mLastWriteMs + kMsBetweenHeartbeats) - nowMillis;
+                if (timeBeforeHeartbeat < sleepTimeMs) sleepTimeMs = timeBeforeHeartbeat;
+                if (mPendingAtoms > 0) {
+                    int64_t timeBeforeBatch =
+                            (mPendingSinceMs + mSubscriptionInfo->mMaxBatchDelayMs) - nowMillis;
+                    if (timeBeforeBatch < sleepTimeMs) sleepTimeMs = timeBeforeBatch;
+                }
 
-            // Determine how long to sleep before doing more work.
-            for (PullInfo& pullInfo : mSubscriptionInfo->mPulledInfo) {
-                int64_t nextPullTime = pullInfo.mPrevPullElapsedRealtimeMs + pullInfo.mInterval;
-                int64_t timeBeforePull = nextPullTime - nowMillis; // guaranteed to be non-negative
-                if (timeBeforePull < sleepTimeMs) sleepTimeMs = timeBeforePull;
+                VLOG("ShellSubscriber: helper thread %d sleeping for %lld ms", myToken,
+                     (long long)sleepTimeMs);
+                mBatchReady.wait_for(lock, std::chrono::milliseconds(sleepTimeMs));
+                continue;
             }
-            int64_t timeBeforeHeartbeat = (mLastWriteMs + kMsBetweenHeartbeats) - nowMillis;
-            if (timeBeforeHeartbeat < sleepTimeMs) sleepTimeMs = timeBeforeHeartbeat;
         }
 
-        VLOG("ShellSubscriber: helper thread %d sleeping for %lld ms", myToken,
-             (long long)sleepTimeMs);
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleepTimeMs));
+        // The lock is not held while writing, so onLogEvent() keeps adding to, or dropping from,
+        // the next batch while the client catches up.
+        bool success = writeToPipe(subscriptionInfo->mOutputFd, payload);
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!success) {
+            // The read end of the pipe has closed, the subscription should end.
+            subscriptionInfo->mClientAlive = false;
+            mSubscriptionShouldEnd.notify_one();
+            return;
+        }
+        mLastWriteMs = getElapsedRealtimeMillis();
     }
 }
 
@@ -188,56 +226,96 @@ void ShellSubscriber::getUidsForPullAtom(vector<int32_t>* uids, const PullInfo&
 
 void ShellSubscriber::writePulledAtomsLocked(const vector<std::shared_ptr<LogEvent>>& data,
                                              const SimpleAtomMatcher& matcher) {
-    mProto.clear();
-    int count = 0;
     for (const auto& event : data) {
         if (matchesSimple(*mUidMap, matcher, *event)) {
-            count++;
-            uint64_t atomToken = mProto.start(util::FIELD_TYPE_MESSAGE |
-                                              util::FIELD_COUNT_REPEATED | FIELD_ID_ATOM);
-            event->ToProto(mProto);
-            mProto.end(atomToken);
+            appendAtomLocked(*event);
+            mFlushPending = true;
         }
     }
-
-    if (count > 0) attemptWriteToPipeLocked(mProto.size());
 }
 
 void ShellSubscriber::onLogEvent(const LogEvent& event) {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mSubscriptionInfo) return;
 
-    mProto.clear();
+    bool matched = false;
     for (const auto& matcher : mSubscriptionInfo->mPushedMatchers) {
         if (matchesSimple(*mUidMap, matcher, event)) {
-            uint64_t atomToken = mProto.start(util::FIELD_TYPE_MESSAGE |
-                                              util::FIELD_COUNT_REPEATED | FIELD_ID_ATOM);
-            event.ToProto(mProto);
-            mProto.end(atomToken);
-            attemptWriteToPipeLocked(mProto.size());
+            appendAtomLocked(event);
+            matched = true;
         }
     }
+
+    if (matched && mPendingAtoms >= mSubscriptionInfo->mMaxBatchAtoms) {
+        mBatchReady.notify_all();
+    }
 }
 
-// Tries to write the atom encoded in mProto to the pipe. If the write fails
-// because the read end of the pipe has closed, signals to other threads that
-// the subscription should end.
-void ShellSubscriber::attemptWriteToPipeLocked(size_t dataSize) {
-    // First, write the payload size.
-    if (!android::base::WriteFully(mSubscriptionInfo->mOutputFd, &dataSize, sizeof(dataSize))) {
-        mSubscriptionInfo->mClientAlive = false;
-        mSubscriptionShouldEnd.notify_one();
+void ShellSubscriber::appendAtomLocked(const LogEvent& event) {
+    if (mProto.bytesWritten() >= kMaxPendingBytes) {
+        mDroppedAtoms++;
         return;
     }
+    if (mPendingAtoms == 0) {
+        mPendingSinceMs = getElapsedRealtimeMillis();
+    }
+    uint64_t atomToken =
+            mProto.start(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED | FIELD_ID_ATOM);
+    event.ToProto(mProto);
+    mProto.end(atomToken);
+    mPendingAtoms++;
+}
+
+bool ShellSubscriber::isBatchReadyLocked(int64_t nowMillis) const {
+    if (mPendingAtoms == 0) {
+        return false;
+    }
+    return mFlushPending || mPendingAtoms >= mSubscriptionInfo->mMaxBatchAtoms ||
+           nowMillis - mPendingSinceMs >= mSubscriptionInfo->mMaxBatchDelayMs;
+}
 
-    // Then, write the payload if this is not just a heartbeat.
-    if (dataSize > 0 && !mProto.flush(mSubscriptionInfo->mOutputFd)) {
-        mSubscriptionInfo->mClientAlive = false;
-        mSubscriptionShouldEnd.notify_one();
-        return;
+void ShellSubscriber::takeBatchLocked(vector<uint8_t>* payload) {
+    if (mDroppedAtoms > 0) {
+        mProto.write(util::FIELD_TYPE_INT64 | FIELD_ID_DROPPED_ATOM_COUNT,
+                     (long long)mDroppedAtoms);
+    }
+    int64_t droppedAtoms = 0;
+    payload->clear();
+    if (!mSubscriptionInfo->mCompressBatches) {
+        mProto.serializeToVector(payload);
+    } else {
+        vector<uint8_t> data;
+        mProto.serializeToVector(&data);
+        const uint32_t rawSize = data.size();
+        uLongf compressedSize = compressBound(rawSize);
+        payload->resize(sizeof(rawSize) + compressedSize);
+        memcpy(payload->data(), &rawSize, sizeof(rawSize));
+        if (compress(payload->data() + sizeof(rawSize), &compressedSize, data.data(), rawSize) ==
+            Z_OK) {
+            payload->resize(sizeof(rawSize) + compressedSize);
+        } else {
+            // Sent as a heartbeat, the atoms are reported as dropped with the next batch.
+            ALOGE("ShellSubscriber: failed to compress %u bytes", rawSize);
+            payload->clear();
+            droppedAtoms = mPendingAtoms + mDroppedAtoms;
+        }
     }
 
-    mLastWriteMs = getElapsedRealtimeMillis();
+    mProto.clear();
+    mPendingAtoms = 0;
+    mDroppedAtoms = droppedAtoms;
+    mFlushPending = false;
+}
+
+bool ShellSubscriber::writeToPipe(int fd, const vector<uint8_t>& payload) {
+    // First, write the payload size.
+    size_t dataSize = payload.size();
+    if (!android::base::WriteFully(fd, &dataSize, sizeof(dataSize))) {
+        return false;
+    }
+
+    // Then, write the payload if this is not just a heartbeat.
+    return dataSize == 0 || android::base::WriteFully(fd, payload.data(), dataSize);
 }
 
 }  // namespace statsd
@@ -27,6 +27,7 @@
 #include "frameworks/base/cmds/statsd/src/shell/shell_config.pb.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "logd/LogEvent.h"
+#include "matchers/matcher_util.h"
 #include "packages/UidMap.h"
 
 namespace android {
@@ -54,6 +55,15 @@ namespace statsd {
  * The stream would be in the following format:
  * |size_t|shellData proto|size_t|shellData proto|....
  *
+ * If the subscription sets compress_batches, each payload is instead a uint32_t holding the size
+ * of the shellData proto, followed by the zlib compressed proto:
+ * |size_t|uint32_t|compressed shellData proto|....
+ *
+ * Atoms are never written to the fd from the thread that logs them. They are batched (see
+ * max_batch_atoms and max_batch_delay_millis in ShellSubscription) and written by the helper
+ * thread. If the client reads too slowly and kMaxPendingBytes are waiting, new atoms are dropped
+ * and counted in the next shellData's dropped_atom_count, rather than slowing statsd down.
+ *
  * Only one shell subscriber is allowed at a time because each shell subscriber blocks one thread
  * until it exits.
  */
@@ -85,14 +95,22 @@ private:
 
     struct SubscriptionInfo {
         SubscriptionInfo(const int& inputFd, const int& outputFd)
-            : mInputFd(inputFd), mOutputFd(outputFd), mClientAlive(true) {
+            : mInputFd(inputFd),
+              mOutputFd(outputFd),
+              mClientAlive(true),
+              mMaxBatchAtoms(1),
+              mMaxBatchDelayMs(0),
+              mCompressBatches(false) {
         }
 
         int mInputFd;
         int mOutputFd;
-        std::vector<SimpleAtomMatcher> mPushedMatchers;
+        std::vector<CompiledAtomMatcher> mPushedMatchers;
         std::vector<PullInfo> mPulledInfo;
         bool mClientAlive;
+        int32_t mMaxBatchAtoms;
+        int64_t mMaxBatchDelayMs;
+        bool mCompressBatches;
     };
 
     int claimToken();
@@ -117,14 +135,40 @@ private:
 
     void getUidsForPullAtom(vector<int32_t>* uids, const PullInfo& pullInfo);
 
-    void attemptWriteToPipeLocked(size_t dataSize);
+    // Adds the atom to the pending batch, or drops it if too much data is already pending.
+    void appendAtomLocked(const LogEvent& event);
+
+    // Whether the pending batch should be written now.
+    bool isBatchReadyLocked(int64_t nowMillis) const;
+
+    // Moves the pending batch to payload, compressed if the client asked for it.
+    void takeBatchLocked(std::vector<uint8_t>* payload);
+
+    // Writes one payload, or a heartbeat if it is empty. Called without holding mMutex so that
+    // a slow client does not block onLogEvent().
+    static bool writeToPipe(int fd, const std::vector<uint8_t>& payload);
 
     sp<UidMap> mUidMap;
 
     sp<StatsPullerManager> mPullerMgr;
 
+    // The pending batch, a ShellData proto made of the atoms that have not been written yet.
     android::util::ProtoOutputStream mProto;
 
+    int32_t mPendingAtoms = 0;
+
+    // When the oldest pending atom was added.
+    int64_t mPendingSinceMs = 0;
+
+    // Pulled atoms are written as soon as they have been pulled.
+    bool mFlushPending = false;
+
+    // Atoms dropped since the last batch was taken.
+    int64_t mDroppedAtoms = 0;
+
+    // Wakes up the helper thread when a batch is ready.
+    std::condition_variable mBatchReady;
+
     mutable std::mutex mMutex;
 
     std::condition_variable mSubscriptionShouldEnd;
@@ -139,6 +183,9 @@ private:
     // when next to send a heartbeat.
     int64_t mLastWriteMs = 0;
     const int64_t kMsBetweenHeartbeats = 1000;
+
+    // Limit on the size of the pending batch.
+    static const size_t kMaxPendingBytes = 256 * 1024;
 };
 
 }  // namespace statsd
@@ -36,8 +36,50 @@ namespace android {
 namespace os {
 namespace statsd {
 
+// Maximum number of datagrams read from the socket with a single recvmmsg call.
+#define SOCKET_BATCH_SIZE 16
+
+// Buffers for one recvmmsg call. Allocated once, and reused for every batch.
+struct StatsSocketListener::ReceiveBatch {
+    struct Datagram {
+        // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
+        char buffer[sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
+        alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
+        struct iovec iov;
+    };
+
+    Datagram datagrams[SOCKET_BATCH_SIZE];
+    struct mmsghdr headers[SOCKET_BATCH_SIZE];
+    std::vector<std::unique_ptr<LogEvent>> events;
+
+    ReceiveBatch() {
+        events.reserve(SOCKET_BATCH_SIZE);
+    }
+
+    // recvmmsg updates msg_controllen (and msg_flags) of each header, so they must be set again
+    // before each call.
+    void resetHeaders() {
+        for (int i = 0; i < SOCKET_BATCH_SIZE; i++) {
+            Datagram& datagram = datagrams[i];
+            datagram.iov = {datagram.buffer, sizeof(datagram.buffer) - 1};
+            headers[i].msg_hdr = {
+                    NULL, 0, &datagram.iov, 1, datagram.control, sizeof(datagram.control), 0,
+            };
+            headers[i].msg_len = 0;
+        }
+    }
+};
+
 StatsSocketListener::StatsSocketListener(std::shared_ptr<LogEventQueue> queue)
-    : SocketListener(getLogSocket(), false /*start listen*/), mQueue(queue) {
+    : SocketListener(getLogSocket(), false /*start listen*/),
+      mQueue(queue),
+      mBatch(std::make_unique<ReceiveBatch>()) {
+}
+
+StatsSocketListener::StatsSocketListener(std::shared_ptr<LogEventQueue> queue, int socket)
+    : SocketListener(socket, false /*start listen*/),
+      mQueue(queue),
+      mBatch(std::make_unique<ReceiveBatch>()) {
 }
 
 StatsSocketListener::~StatsSocketListener() {
@@ -50,22 +92,38 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
         name_set = true;
     }
 
-    // + 1 to ensure null terminator if MAX_PAYLOAD buffer is received
-    char buffer[sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
-    struct iovec iov = {buffer, sizeof(buffer) - 1};
-
-    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
-    struct msghdr hdr = {
-            NULL, 0, &iov, 1, control, sizeof(control), 0,
-    };
-
     int socket = cli->getSocket();
 
     // To clear the entire buffer is secure/safe, but this contributes to 1.68%
     // overhead under logging load. We are safe because we check counts, but
     // still need to clear null terminator
     // memset(buffer, 0, sizeof(buffer));
-    ssize_t n = recvmsg(socket, &hdr, 0);
+    mBatch->resetHeaders();
+    // The socket is readable, so this returns at least one datagram. MSG_DONTWAIT makes it return
+    // whatever else is already queued instead of waiting for the batch to fill up.
+    int count = recvmmsg(socket, mBatch->headers, SOCKET_BATCH_SIZE, MSG_DONTWAIT, NULL);
+    if (count <= 0) {
+        return false;
+    }
+
+    bool success = false;
+    for (int i = 0; i < count; i++) {
+        struct mmsghdr& header = mBatch->headers[i];
+        success |= handleDatagram(mBatch->datagrams[i].buffer, header.msg_len, &header.msg_hdr);
+    }
+
+    if (!mBatch->events.empty()) {
+        int64_t oldestTimestamp;
+        size_t dropped = mQueue->pushBatch(&mBatch->events, &oldestTimestamp);
+        for (size_t i = 0; i < dropped; i++) {
+            StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp);
+        }
+    }
+
+    return success;
+}
+
+bool StatsSocketListener::handleDatagram(char* buffer, ssize_t n, struct msghdr* hdr) {
     if (n <= (ssize_t)(sizeof(android_log_header_t))) {
         return false;
     }
@@ -74,13 +132,13 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
 
     struct ucred* cred = NULL;
 
-    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr);
     while (cmsg != NULL) {
         if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
             cred = (struct ucred*)CMSG_DATA(cmsg);
             break;
         }
-        cmsg = CMSG_NXTHDR(&hdr, cmsg);
+        cmsg = CMSG_NXTHDR(hdr, cmsg);
     }
 
     struct ucred fake_cred;
@@ -125,13 +183,10 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
     uint32_t uid = cred->uid;
     uint32_t pid = cred->pid;
 
-    int64_t oldestTimestamp;
-    std::unique_ptr<LogEvent> logEvent = std::make_unique<LogEvent>(uid, pid);
-    logEvent->parseBuffer(msg, len);
-
-    if (!mQueue->push(std::move(logEvent), &oldestTimestamp)) {
-        StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp);
-    }
+    std::unique_ptr<LogEvent> logEvent = mQueue->obtain(uid, pid);
+    // The fields are only parsed on the reader thread, and only if some config uses the atom.
+    logEvent->parseBufferDeferred(msg, len);
+    mBatch->events.push_back(std::move(logEvent));
 
     return true;
 }
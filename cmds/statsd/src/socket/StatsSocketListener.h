@@ -15,6 +15,7 @@
  */
 #pragma once
 
+#include <sys/socket.h>
 #include <sysutils/SocketListener.h>
 #include <utils/RefBase.h>
 #include "logd/LogEventQueue.h"
@@ -37,17 +38,38 @@ class StatsSocketListener : public SocketListener, public virtual android::RefBa
 public:
     explicit StatsSocketListener(std::shared_ptr<LogEventQueue> queue);
 
+    /**
+     * Reads from the given datagram socket instead of statsd's own socket. Used to replay atoms
+     * through the normal socket path, e.g. in benchmarks.
+     */
+    StatsSocketListener(std::shared_ptr<LogEventQueue> queue, int socket);
+
     virtual ~StatsSocketListener();
 
 protected:
     virtual bool onDataAvailable(SocketClient* cli);
 
 private:
+    struct ReceiveBatch;
+
     static int getLogSocket();
+
+    /**
+     * Parses one datagram of the current batch. The event, if any, is appended to the batch
+     * rather than pushed to the queue right away.
+     */
+    bool handleDatagram(char* buffer, ssize_t n, struct msghdr* hdr);
+
     /**
      * Who is going to get the events when they're read.
      */
     std::shared_ptr<LogEventQueue> mQueue;
+
+    /**
+     * Datagram buffers and parsed events of the batch being read, only used by the listener
+     * thread.
+     */
+    std::unique_ptr<ReceiveBatch> mBatch;
 };
 }  // namespace statsd
 }  // namespace os
@@ -17,12 +17,21 @@
 
 #include <utils/RefBase.h>
 
+#include <vector>
+
 #include "HashableDimensionKey.h"
 
 namespace android {
 namespace os {
 namespace statsd {
 
+// One primary key's state transition, as delivered by StateTracker.
+struct StateChange {
+    HashableDimensionKey primaryKey;
+    FieldValue oldState;
+    FieldValue newState;
+};
+
 class StateListener : public virtual RefBase {
 public:
     StateListener(){};
@@ -47,6 +56,25 @@ public:
     virtual void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
                                 const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                                 const FieldValue& newState) = 0;
+
+    /**
+     * Interface for handling all state changes caused by one state atom log
+     * event, in the order they occurred. A reset event can change the state of
+     * every primary key at once. Listeners that can process the changes in one
+     * pass should override this; by default each change is forwarded to
+     * onStateChanged.
+     *
+     * [eventTimeNs]: Time of the state change log event.
+     * [atomId]: The id of the state atom
+     * [changes]: The state changes, one per primary key
+     */
+    virtual void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                                const std::vector<StateChange>& changes) {
+        for (const StateChange& change : changes) {
+            onStateChanged(eventTimeNs, atomId, change.primaryKey, change.oldState,
+                           change.newState);
+        }
+    }
 };
 
 }  // namespace statsd
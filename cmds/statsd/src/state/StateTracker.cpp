@@ -38,7 +38,8 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     FieldValue newState;
     if (!getStateFieldValueFromLogEvent(event, &newState)) {
         ALOGE("StateTracker error extracting state from log event. Missing exclusive state field.");
-        clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        clearStateForPrimaryKey(primaryKey);
+        notifyListeners(eventTimeNs);
         return;
     }
 
@@ -47,20 +48,22 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     if (newState.mValue.getType() != INT) {
         ALOGE("StateTracker error extracting state from log event. Type: %d",
               newState.mValue.getType());
-        clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        clearStateForPrimaryKey(primaryKey);
+        notifyListeners(eventTimeNs);
         return;
     }
 
     if (int resetState = event.getResetState(); resetState != -1) {
         VLOG("StateTracker new reset state: %d", resetState);
         const FieldValue resetStateFieldValue(mField, Value(resetState));
-        handleReset(eventTimeNs, resetStateFieldValue);
+        handleReset(resetStateFieldValue);
+        notifyListeners(eventTimeNs);
         return;
     }
 
     const bool nested = newState.mAnnotations.isNested();
-    StateValueInfo* stateValueInfo = &mStateMap[primaryKey];
-    updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested, stateValueInfo);
+    updateStateForSlot(getOrCreateSlot(primaryKey), newState, nested);
+    notifyListeners(eventTimeNs);
 }
 
 void StateTracker::registerListener(wp<StateListener> listener) {
@@ -74,8 +77,8 @@ void StateTracker::unregisterListener(wp<StateListener> listener) {
 bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValue* output) const {
     output->mField = mField;
 
-    if (const auto it = mStateMap.find(queryKey); it != mStateMap.end()) {
-        output->mValue = it->second.state;
+    if (const auto it = mPrimaryKeySlots.find(queryKey); it != mPrimaryKeySlots.end()) {
+        output->mValue = mStates[it->second];
         return true;
     }
 
@@ -84,54 +87,81 @@ bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValu
     return false;
 }
 
-void StateTracker::handleReset(const int64_t eventTimeNs, const FieldValue& newState) {
+size_t StateTracker::getOrCreateSlot(const HashableDimensionKey& primaryKey) {
+    const auto it = mPrimaryKeySlots.find(primaryKey);
+    if (it != mPrimaryKeySlots.end()) {
+        return it->second;
+    }
+
+    size_t slot;
+    if (!mFreeSlots.empty()) {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        mPrimaryKeys[slot] = primaryKey;
+    } else {
+        slot = mStates.size();
+        mPrimaryKeys.push_back(primaryKey);
+        mStates.push_back(kStateUnknown);
+        mCounts.push_back(0);
+    }
+    mPrimaryKeySlots[primaryKey] = slot;
+    return slot;
+}
+
+void StateTracker::releaseSlot(const size_t slot) {
+    mPrimaryKeySlots.erase(mPrimaryKeys[slot]);
+    mPrimaryKeys[slot] = HashableDimensionKey();
+    mStates[slot] = kStateUnknown;
+    mCounts[slot] = 0;
+    mFreeSlots.push_back(slot);
+}
+
+void StateTracker::handleReset(const FieldValue& newState) {
     VLOG("StateTracker handle reset");
-    for (auto& [primaryKey, stateValueInfo] : mStateMap) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, newState,
-                                 false /* nested; treat this state change as not nested */,
-                                 &stateValueInfo);
+    // Free slots hold kStateUnknown and every assigned slot holds a known state, so the
+    // columns can be scanned without going through the primary key map.
+    for (size_t slot = 0; slot < mStates.size(); slot++) {
+        if (mStates[slot] != kStateUnknown) {
+            updateStateForSlot(slot, newState,
+                               false /* nested; treat this state change as not nested */);
+        }
     }
 }
 
-void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
-                                           const HashableDimensionKey& primaryKey) {
+void StateTracker::clearStateForPrimaryKey(const HashableDimensionKey& primaryKey) {
     VLOG("StateTracker clear state for primary key");
-    const std::unordered_map<HashableDimensionKey, StateValueInfo>::iterator it =
-            mStateMap.find(primaryKey);
+    const auto it = mPrimaryKeySlots.find(primaryKey);
 
-    // If there is no entry for the primaryKey in mStateMap, then the state is already
-    // kStateUnknown.
+    // If there is no slot for the primaryKey, then the state is already kStateUnknown.
     const FieldValue state(mField, Value(kStateUnknown));
-    if (it != mStateMap.end()) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
-                                 false /* nested; treat this state change as not nested */,
-                                 &it->second);
+    if (it != mPrimaryKeySlots.end()) {
+        updateStateForSlot(it->second, state,
+                           false /* nested; treat this state change as not nested */);
     }
 }
 
-void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
-                                            const HashableDimensionKey& primaryKey,
-                                            const FieldValue& newState, const bool nested,
-                                            StateValueInfo* stateValueInfo) {
-    FieldValue oldState;
-    oldState.mField = mField;
-    oldState.mValue.setInt(stateValueInfo->state);
-    const int32_t oldStateValue = stateValueInfo->state;
+void StateTracker::updateStateForSlot(const size_t slot, const FieldValue& newState,
+                                      const bool nested) {
+    const int32_t oldStateValue = mStates[slot];
     const int32_t newStateValue = newState.mValue.int_value;
 
     if (kStateUnknown == newStateValue) {
-        mStateMap.erase(primaryKey);
+        if (kStateUnknown != oldStateValue) {
+            addPendingChange(slot, oldStateValue, newState);
+        }
+        releaseSlot(slot);
+        return;
     }
 
     // Update state map for non-nested counting case.
     // Every state event triggers a state overwrite.
     if (!nested) {
-        stateValueInfo->state = newStateValue;
-        stateValueInfo->count = 1;
+        mStates[slot] = newStateValue;
+        mCounts[slot] = 1;
 
         // Notify listeners if state has changed.
         if (oldStateValue != newStateValue) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+            addPendingChange(slot, oldStateValue, newState);
         }
         return;
     }
@@ -146,32 +176,39 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
     // In atoms.proto, a state atom with nested counting enabled
     // must only have 2 states. There is no enforcemnt here of this requirement.
     // The atom must be logged correctly.
-    if (kStateUnknown == newStateValue) {
-        if (kStateUnknown != oldStateValue) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
-        }
-    } else if (oldStateValue == kStateUnknown) {
-        stateValueInfo->state = newStateValue;
-        stateValueInfo->count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+    if (oldStateValue == kStateUnknown) {
+        mStates[slot] = newStateValue;
+        mCounts[slot] = 1;
+        addPendingChange(slot, oldStateValue, newState);
     } else if (oldStateValue == newStateValue) {
-        stateValueInfo->count++;
-    } else if (--stateValueInfo->count == 0) {
-        stateValueInfo->state = newStateValue;
-        stateValueInfo->count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        mCounts[slot]++;
+    } else if (--mCounts[slot] == 0) {
+        mStates[slot] = newStateValue;
+        mCounts[slot] = 1;
+        addPendingChange(slot, oldStateValue, newState);
     }
 }
 
-void StateTracker::notifyListeners(const int64_t eventTimeNs,
-                                   const HashableDimensionKey& primaryKey,
-                                   const FieldValue& oldState, const FieldValue& newState) {
+void StateTracker::addPendingChange(const size_t slot, const int32_t oldStateValue,
+                                    const FieldValue& newState) {
+    StateChange& change = mPendingChanges.emplace_back();
+    change.primaryKey = mPrimaryKeys[slot];
+    change.oldState.mField = mField;
+    change.oldState.mValue.setInt(oldStateValue);
+    change.newState = newState;
+}
+
+void StateTracker::notifyListeners(const int64_t eventTimeNs) {
+    if (mPendingChanges.empty()) {
+        return;
+    }
     for (auto l : mListeners) {
         auto sl = l.promote();
         if (sl != nullptr) {
-            sl->onStateChanged(eventTimeNs, mField.getTag(), primaryKey, oldState, newState);
+            sl->onStateChanges(eventTimeNs, mField.getTag(), mPendingChanges);
         }
     }
+    mPendingChanges.clear();
 }
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output) {
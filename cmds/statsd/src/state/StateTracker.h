@@ -22,6 +22,7 @@
 #include "state/StateListener.h"
 
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -58,33 +59,47 @@ public:
     const static int kStateUnknown = -1;
 
 private:
-    struct StateValueInfo {
-        int32_t state = kStateUnknown;  // state value
-        int count = 0;                  // nested count (only used for binary states)
-    };
-
     Field mField;
 
-    // Maps primary key to state value info
-    std::unordered_map<HashableDimensionKey, StateValueInfo> mStateMap;
+    // Interns primary keys to slots in the state columns below. A slot stays assigned to its
+    // primary key until the key's state returns to kStateUnknown, and is then recycled.
+    std::unordered_map<HashableDimensionKey, size_t> mPrimaryKeySlots;
+
+    // State columns indexed by slot. Free slots hold kStateUnknown.
+    std::vector<HashableDimensionKey> mPrimaryKeys;
+    std::vector<int32_t> mStates;  // state value
+    std::vector<int> mCounts;      // nested count (only used for binary states)
+
+    // Slots released by primary keys whose state became kStateUnknown.
+    std::vector<size_t> mFreeSlots;
+
+    // State changes caused by the log event being processed. They are delivered to each
+    // listener in one batch once the event is fully applied.
+    std::vector<StateChange> mPendingChanges;
 
     // Set of all StateListeners (objects listening for state changes)
     std::set<wp<StateListener>> mListeners;
 
+    // Returns the slot of the given primary key, assigning one if needed.
+    size_t getOrCreateSlot(const HashableDimensionKey& primaryKey);
+
+    void releaseSlot(const size_t slot);
+
     // Reset all state values in map to the given state.
-    void handleReset(const int64_t eventTimeNs, const FieldValue& newState);
+    void handleReset(const FieldValue& newState);
 
     // Clears the state value mapped to the given primary key by setting it to kStateUnknown.
-    void clearStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey);
+    void clearStateForPrimaryKey(const HashableDimensionKey& primaryKey);
+
+    // Update the state in the given slot based on the received state value.
+    void updateStateForSlot(const size_t slot, const FieldValue& newState, const bool nested);
 
-    // Update the StateMap based on the received state value.
-    void updateStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
-                                  const FieldValue& newState, const bool nested,
-                                  StateValueInfo* stateValueInfo);
+    // Queues a state change for the primary key in the given slot.
+    void addPendingChange(const size_t slot, const int32_t oldStateValue,
+                          const FieldValue& newState);
 
-    // Notify registered state listeners of state change.
-    void notifyListeners(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
-                         const FieldValue& oldState, const FieldValue& newState);
+    // Notify registered state listeners of the pending state changes.
+    void notifyListeners(const int64_t eventTimeNs);
 };
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output);
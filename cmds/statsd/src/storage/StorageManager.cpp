@@ -23,7 +23,10 @@
 #include "stats_log_util.h"
 
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
 #include <private/android_filesystem_config.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include <fstream>
 
 namespace android {
@@ -49,6 +52,25 @@ const uint32_t TRAIN_INFO_FILE_MAGIC = 0xfb7447bf;
 // for ConfigMetricsReportList
 const int FIELD_ID_REPORTS = 2;
 
+// Magic word at the start of each report in a segment file, change this if changing the format
+const uint32_t SEGMENT_RECORD_MAGIC = 0x5e6d0001;
+
+// A segment stops taking new reports once it is this large or this old, so that trimToFit can
+// still drop old data a segment at a time.
+const size_t kMaxSegmentSizeBytes = 256 * 1024;
+const long kMaxSegmentAgeSec = 60 * 60 * 24;
+
+// Header of each report appended to a segment. Walking the headers gives the index of the
+// segment without decompressing anything; the compressed report follows each header.
+struct SegmentRecordHeader {
+    uint32_t magic;
+    uint32_t compressedSize;
+    uint32_t rawSize;
+    // crc32 of the compressed report, to detect a record torn by a crash.
+    uint32_t crc;
+    int64_t wallClockSec;
+};
+
 std::mutex StorageManager::sTrainInfoMutex;
 
 using android::base::StringPrintf;
@@ -59,9 +81,11 @@ struct FileName {
     int mUid;
     int64_t mConfigId;
     bool mIsHistory;
+    bool mIsSegment;
     string getFullFileName(const char* path) {
-        return StringPrintf("%s/%lld_%d_%lld%s", path, (long long)mTimestampSec, (int)mUid,
-                            (long long)mConfigId, (mIsHistory ? "_history" : ""));
+        return StringPrintf("%s/%lld_%d_%lld%s%s", path, (long long)mTimestampSec, (int)mUid,
+                            (long long)mConfigId, (mIsSegment ? "_segment" : ""),
+                            (mIsHistory ? "_history" : ""));
     };
 };
 
@@ -75,6 +99,11 @@ string StorageManager::getDataHistoryFileName(long wallClockSec, int uid, int64_
                         (long long)id);
 }
 
+string StorageManager::getDataSegmentFileName(long wallClockSec, int uid, int64_t id) {
+    return StringPrintf("%s/%ld_%d_%lld_segment", STATS_DATA_DIR, wallClockSec, uid,
+                        (long long)id);
+}
+
 static string findTrainInfoFileNameLocked(const string& trainName) {
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(TRAIN_INFO_DIR), closedir);
     if (dir == NULL) {
@@ -99,7 +128,7 @@ static string findTrainInfoFileNameLocked(const string& trainName) {
 }
 
 // Returns array of int64_t which contains timestamp in seconds, uid,
-// configID and whether the file is a local history file.
+// configID and whether the file is a local history file and/or a segment.
 static void parseFileName(char* name, FileName* output) {
     int64_t result[3];
     int index = 0;
@@ -119,11 +148,99 @@ static void parseFileName(char* name, FileName* output) {
     output->mTimestampSec = result[0];
     output->mUid = result[1];
     output->mConfigId = result[2];
-    // check if the file is a local history.
-    output->mIsHistory = (substr != nullptr && strcmp("history", substr) == 0);
+    // check if the file is a local history and/or a segment.
+    output->mIsHistory = false;
+    output->mIsSegment = false;
+    for (; substr != nullptr; substr = strtok(nullptr, "_")) {
+        if (strcmp("history", substr) == 0) {
+            output->mIsHistory = true;
+        } else if (strcmp("segment", substr) == 0) {
+            output->mIsSegment = true;
+        }
+    }
+}
+
+// Reads the record at the current offset of fd into header and compressed. Returns false at the
+// end of the segment, or at a record that is truncated or corrupt, which is what a crash in the
+// middle of an append leaves behind.
+static bool readSegmentRecord(int fd, const string& path, SegmentRecordHeader* header,
+                              string* compressed) {
+    if (!android::base::ReadFully(fd, header, sizeof(*header))) {
+        return false;
+    }
+    // A report is at most kMaxFileSize before compression, whatever the size of the segment.
+    if (header->magic != SEGMENT_RECORD_MAGIC ||
+        header->compressedSize > compressBound(StatsdStats::kMaxFileSize) ||
+        header->rawSize > StatsdStats::kMaxFileSize) {
+        ALOGE("Corrupt record in segment %s", path.c_str());
+        return false;
+    }
+    compressed->resize(header->compressedSize);
+    if (!android::base::ReadFully(fd, compressed->data(), compressed->size())) {
+        ALOGW("Truncated record in segment %s", path.c_str());
+        return false;
+    }
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(compressed->data()), compressed->size());
+    if (crc != header->crc) {
+        ALOGE("Checksum mismatch in segment %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Calls onReport with each report in the segment at path, in the order they were appended.
+// Stops at the first record that is truncated or corrupt.
+static void readSegment(const string& path, const std::function<void(const string&)>& onReport) {
+    android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        ALOGE("file cannot be opened");
+        return;
+    }
+    SegmentRecordHeader header;
+    string compressed;
+    string report;
+    while (readSegmentRecord(fd, path, &header, &compressed)) {
+        report.resize(header.rawSize);
+        uLongf rawSize = header.rawSize;
+        if (uncompress(reinterpret_cast<Bytef*>(report.data()), &rawSize,
+                       reinterpret_cast<const Bytef*>(compressed.data()),
+                       compressed.size()) != Z_OK ||
+            rawSize != header.rawSize) {
+            ALOGE("Failed to decompress record in segment %s", path.c_str());
+            return;
+        }
+        onReport(report);
+    }
+}
+
+// Drops whatever follows the last valid record of the segment open as fd, so that the reports
+// appended after a torn record can still be read. Returns false if the segment can't be repaired.
+static bool truncateSegmentToValidRecords(int fd, const string& path) {
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        return false;
+    }
+    off_t validSize = 0;
+    SegmentRecordHeader header;
+    string compressed;
+    while (validSize < fileStat.st_size && readSegmentRecord(fd, path, &header, &compressed)) {
+        validSize += sizeof(header) + header.compressedSize;
+    }
+    if (validSize == fileStat.st_size) {
+        return true;
+    }
+    ALOGW("Dropping %lld bytes after the last valid record of segment %s",
+          (long long)(fileStat.st_size - validSize), path.c_str());
+    return ftruncate(fd, validSize) == 0;
 }
 
 void StorageManager::writeFile(const char* file, const void* buffer, int numBytes) {
+    writeFile(file, [buffer, numBytes](int fd) {
+        return android::base::WriteFully(fd, buffer, numBytes);
+    });
+}
+
+void StorageManager::writeFile(const char* file, const std::function<bool(int fd)>& writer) {
     int fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
     if (fd == -1) {
         VLOG("Attempt to access %s but failed", file);
@@ -132,7 +249,7 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
     trimToFit(STATS_SERVICE_DIR);
     trimToFit(STATS_DATA_DIR);
 
-    if (android::base::WriteFully(fd, buffer, numBytes)) {
+    if (writer(fd)) {
         VLOG("Successfully wrote %s", file);
     } else {
         ALOGE("Failed to write %s", file);
@@ -146,6 +263,92 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
     close(fd);
 }
 
+int StorageManager::openSpoolFile() {
+    int fd = open(STATS_DATA_DIR, O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        VLOG("Failed to create a spool file in %s", STATS_DATA_DIR);
+    }
+    return fd;
+}
+
+void StorageManager::appendReportToSegment(const ConfigKey& key, long wallClockSec,
+                                           const vector<uint8_t>& report) {
+    // Compress into the buffer right after the header, so that the record is appended with a
+    // single write.
+    uLongf compressedSize = compressBound(report.size());
+    vector<uint8_t> record(sizeof(SegmentRecordHeader) + compressedSize);
+    if (compress(record.data() + sizeof(SegmentRecordHeader), &compressedSize, report.data(),
+                 report.size()) != Z_OK) {
+        ALOGE("Failed to compress the report of config %s", key.ToString().c_str());
+        return;
+    }
+    record.resize(sizeof(SegmentRecordHeader) + compressedSize);
+    SegmentRecordHeader header;
+    header.magic = SEGMENT_RECORD_MAGIC;
+    header.compressedSize = compressedSize;
+    header.rawSize = report.size();
+    header.crc = crc32(0L, record.data() + sizeof(SegmentRecordHeader), compressedSize);
+    header.wallClockSec = wallClockSec;
+    memcpy(record.data(), &header, sizeof(header));
+
+    trimToFit(STATS_SERVICE_DIR);
+    trimToFit(STATS_DATA_DIR);
+
+    // Append to the newest segment of this config, unless it is full or too old.
+    string segmentName;
+    int64_t segmentTimestampSec = -1;
+    unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
+    if (dir != NULL) {
+        dirent* de;
+        while ((de = readdir(dir.get()))) {
+            char* name = de->d_name;
+            if (name[0] == '.') continue;
+            FileName output;
+            parseFileName(name, &output);
+            if (output.mTimestampSec == -1 || !output.mIsSegment || output.mIsHistory ||
+                output.mUid != key.GetUid() || output.mConfigId != key.GetId() ||
+                output.mTimestampSec <= segmentTimestampSec ||
+                wallClockSec - output.mTimestampSec >= kMaxSegmentAgeSec) {
+                continue;
+            }
+            string fullPathName = output.getFullFileName(STATS_DATA_DIR);
+            struct stat fileStat;
+            if (stat(fullPathName.c_str(), &fileStat) == 0 &&
+                (size_t)fileStat.st_size < kMaxSegmentSizeBytes) {
+                segmentName = fullPathName;
+                segmentTimestampSec = output.mTimestampSec;
+            }
+        }
+    }
+    if (segmentName.empty()) {
+        segmentName = getDataSegmentFileName(wallClockSec, key.GetUid(), key.GetId());
+    }
+
+    int fd = open(segmentName.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC,
+                  S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        VLOG("Attempt to access %s but failed", segmentName.c_str());
+        return;
+    }
+    if (!truncateSegmentToValidRecords(fd, segmentName)) {
+        ALOGE("Failed to repair segment %s", segmentName.c_str());
+        close(fd);
+        return;
+    }
+    if (android::base::WriteFully(fd, record.data(), record.size())) {
+        VLOG("Successfully appended %zu bytes to %s", record.size(), segmentName.c_str());
+    } else {
+        ALOGE("Failed to append to %s", segmentName.c_str());
+    }
+
+    int result = fchown(fd, AID_STATSD, AID_STATSD);
+    if (result) {
+        VLOG("Failed to chown %s to statsd", segmentName.c_str());
+    }
+
+    close(fd);
+}
+
 bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     std::lock_guard<std::mutex> lock(sTrainInfoMutex);
 
@@ -484,21 +687,15 @@ bool StorageManager::hasConfigMetricsReport(const ConfigKey& key) {
         return false;
     }
 
-    string suffix = StringPrintf("%d_%lld", key.GetUid(), (long long)key.GetId());
-
     dirent* de;
     while ((de = readdir(dir.get()))) {
         char* name = de->d_name;
         if (name[0] == '.') continue;
 
-        size_t nameLen = strlen(name);
-        size_t suffixLen = suffix.length();
-        if (suffixLen <= nameLen &&
-            strncmp(name + nameLen - suffixLen, suffix.c_str(), suffixLen) == 0) {
-            // Check again that the file name is parseable.
-            FileName output;
-            parseFileName(name, &output);
-            if (output.mTimestampSec == -1 || output.mIsHistory) continue;
+        FileName output;
+        parseFileName(name, &output);
+        if (output.mTimestampSec == -1 || output.mIsHistory) continue;
+        if (output.mUid == key.GetUid() && output.mConfigId == key.GetId()) {
             return true;
         }
     }
@@ -527,16 +724,23 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
         }
 
         auto fullPathName = StringPrintf("%s/%s", STATS_DATA_DIR, fileName.c_str());
-        int fd = open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC);
-        if (fd != -1) {
-            string content;
-            if (android::base::ReadFdToString(fd, &content)) {
+        if (output.mIsSegment) {
+            readSegment(fullPathName, [proto](const string& report) {
                 proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
-                             content.c_str(), content.size());
-            }
-            close(fd);
+                             report.c_str(), report.size());
+            });
         } else {
-            ALOGE("file cannot be opened");
+            int fd = open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd != -1) {
+                string content;
+                if (android::base::ReadFdToString(fd, &content)) {
+                    proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                                 content.c_str(), content.size());
+                }
+                close(fd);
+            } else {
+                ALOGE("file cannot be opened");
+            }
         }
 
         if (erase_data) {
@@ -695,6 +899,7 @@ void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
             file_name = StringPrintf("%s/%s", path, name);
             output.mTimestampSec = StrToInt64(strtok(name, "_"));
             output.mIsHistory = false;
+            output.mIsSegment = false;
         } else {
             parseFileName(name, &output);
             file_name = output.getFullFileName(path);
@@ -757,8 +962,9 @@ void StorageManager::printDirStats(int outFd, const char* path) {
         FileName output;
         parseFileName(name, &output);
         if (output.mTimestampSec == -1) continue;
-        dprintf(outFd, "\t #%d, Last updated: %lld, UID: %d, Config ID: %lld, %s", fileCount + 1,
-                (long long)output.mTimestampSec, output.mUid, (long long)output.mConfigId,
+        dprintf(outFd, "\t #%d, Last updated: %lld, UID: %d, Config ID: %lld, %s%s",
+                fileCount + 1, (long long)output.mTimestampSec, output.mUid,
+                (long long)output.mConfigId, (output.mIsSegment ? "segment " : ""),
                 (output.mIsHistory ? "local history" : ""));
         string file_name = output.getFullFileName(path);
         ifstream file(file_name.c_str(), ifstream::in | ifstream::binary);
@@ -21,6 +21,8 @@
 #include <utils/Log.h>
 #include <utils/RefBase.h>
 
+#include <functional>
+
 #include "packages/UidMap.h"
 
 namespace android {
@@ -49,6 +51,24 @@ public:
      */
     static void writeFile(const char* file, const void* buffer, int numBytes);
 
+    /**
+     * Same as above, but the contents are written by writer, which returns whether it succeeded.
+     */
+    static void writeFile(const char* file, const std::function<bool(int fd)>& writer);
+
+    /**
+     * Opens an unnamed file in the data directory, for data too large to be kept in memory. The
+     * file is gone once the fd is closed. Returns -1 if it cannot be created.
+     */
+    static int openSpoolFile();
+
+    /**
+     * Appends a serialized ConfigMetricsReport to the newest on-disk segment of the config,
+     * compressed. A new segment is started when the newest one is full or too old.
+     */
+    static void appendReportToSegment(const ConfigKey& key, long wallClockSec,
+                                      const vector<uint8_t>& report);
+
     /**
      * Writes train info.
      */
@@ -150,6 +170,8 @@ public:
 
     static string getDataHistoryFileName(long wallClockSec, int uid, int64_t id);
 
+    static string getDataSegmentFileName(long wallClockSec, int uid, int64_t id);
+
     static void sortFiles(vector<FileInfo>* fileNames);
 
 private:
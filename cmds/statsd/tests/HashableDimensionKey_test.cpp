@@ -17,6 +17,8 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "statsd_test_util.h"
 
@@ -129,6 +131,71 @@ TEST(HashableDimensionKeyTest, TestContainsLinkedStateValues_AllConditionsMet) {
     EXPECT_TRUE(containsLinkedStateValues(whatKey, primaryKey, mMetric2StateLinks, stateAtomId));
 }
 
+TEST(HashableDimensionKeyTest, TestInterning) {
+    HashableDimensionKey key1;
+    getUidProcessKey(1000, &key1);
+    HashableDimensionKey key2;
+    getUidProcessKey(1000, &key2);
+    HashableDimensionKey otherKey;
+    getUidProcessKey(1001, &otherKey);
+
+    android::hash_t hash = key1.hash();
+    key1.intern();
+    key2.intern();
+    otherKey.intern();
+
+    // Equal keys share the same storage, and keep their hash.
+    EXPECT_EQ(&key1.getValues(), &key2.getValues());
+    EXPECT_EQ(key1, key2);
+    EXPECT_EQ(hash, key2.hash());
+    EXPECT_NE(key1, otherKey);
+
+    // Changing an interned key leaves the other keys alone.
+    key2.mutableValue(0)->mValue.setInt(1001);
+    EXPECT_NE(&key1.getValues(), &key2.getValues());
+    EXPECT_EQ(1000, key1.getValues()[0].mValue.int_value);
+    EXPECT_EQ(otherKey, key2);
+    EXPECT_EQ(otherKey.hash(), key2.hash());
+}
+
+TEST(HashableDimensionKeyTest, TestMetricDimensionKeyIsInterned) {
+    HashableDimensionKey whatKey;
+    getUidProcessKey(1000, &whatKey);
+    MetricDimensionKey key1(whatKey, DEFAULT_DIMENSION_KEY);
+    MetricDimensionKey key2(whatKey, DEFAULT_DIMENSION_KEY);
+
+    EXPECT_EQ(&key1.getDimensionKeyInWhat().getValues(),
+              &key2.getDimensionKeyInWhat().getValues());
+    EXPECT_EQ(std::hash<MetricDimensionKey>()(key1), std::hash<MetricDimensionKey>()(key2));
+}
+
+TEST(HashableDimensionKeyTest, TestConcurrentInterning) {
+    const int kThreadCount = 8;
+    const int kUidCount = 100;
+    std::vector<std::vector<MetricDimensionKey>> keys(kThreadCount);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadCount; i++) {
+        threads.emplace_back([&keys, i] {
+            for (int uid = 0; uid < kUidCount; uid++) {
+                HashableDimensionKey whatKey;
+                getUidProcessKey(uid, &whatKey);
+                keys[i].emplace_back(whatKey, DEFAULT_DIMENSION_KEY);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every thread ends up with the same storage for the same uid.
+    for (int i = 1; i < kThreadCount; i++) {
+        for (int uid = 0; uid < kUidCount; uid++) {
+            EXPECT_EQ(&keys[0][uid].getDimensionKeyInWhat().getValues(),
+                      &keys[i][uid].getDimensionKeyInWhat().getValues());
+        }
+    }
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -394,6 +394,43 @@ TEST(AtomMatcherTest, TestUidFieldMatcher) {
     EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event2));
 }
 
+TEST(AtomMatcherTest, TestCompiledMatcherReusedAcrossEvents) {
+    UidMap uidMap;
+    uidMap.updateMap(
+            1, {1111, 2222} /* uid list */, {1, 2} /* version list */,
+            {android::String16("v1"), android::String16("v2")},
+            {android::String16("pkg0"), android::String16("pkg1")} /* package name list */,
+            {android::String16(""), android::String16("")});
+
+    // Set up matcher
+    AtomMatcher matcher;
+    auto simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(TAG_ID);
+    auto fieldValueMatcher = simpleMatcher->add_field_value_matcher();
+    fieldValueMatcher->set_field(1);
+    fieldValueMatcher->mutable_eq_any_string()->add_str_value("AID_ROOT");
+    fieldValueMatcher->mutable_eq_any_string()->add_str_value("pkg1");
+    const CompiledAtomMatcher compiledMatcher = compileSimpleMatcher(*simpleMatcher);
+
+    // AID names match their uid, other strings match the packages of the uid.
+    LogEvent rootEvent(/*uid=*/0, /*pid=*/0);
+    makeIntWithBoolAnnotationLogEvent(&rootEvent, TAG_ID, 0, ANNOTATION_ID_IS_UID, true);
+    EXPECT_TRUE(matchesSimple(uidMap, compiledMatcher, rootEvent));
+
+    LogEvent pkg1Event(/*uid=*/0, /*pid=*/0);
+    makeIntWithBoolAnnotationLogEvent(&pkg1Event, TAG_ID, 2222, ANNOTATION_ID_IS_UID, true);
+    EXPECT_TRUE(matchesSimple(uidMap, compiledMatcher, pkg1Event));
+
+    LogEvent pkg0Event(/*uid=*/0, /*pid=*/0);
+    makeIntWithBoolAnnotationLogEvent(&pkg0Event, TAG_ID, 1111, ANNOTATION_ID_IS_UID, true);
+    EXPECT_FALSE(matchesSimple(uidMap, compiledMatcher, pkg0Event));
+
+    // The uid map is consulted per event, so the compiled matcher follows package updates.
+    uidMap.updateApp(2, android::String16("pkg1"), 1111, 1, android::String16("v1"),
+                     android::String16(""));
+    EXPECT_TRUE(matchesSimple(uidMap, compiledMatcher, pkg0Event));
+}
+
 TEST(AtomMatcherTest, TestNeqAnyStringMatcher) {
     UidMap uidMap;
     uidMap.updateMap(
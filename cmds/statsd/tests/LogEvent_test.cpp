@@ -127,6 +127,61 @@ TEST(LogEventTest, TestPrimitiveParsing) {
     AStatsEvent_release(event);
 }
 
+TEST(LogEventTest, TestDeferredParsing) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, 100);
+    AStatsEvent_writeInt32(event, 10);
+    AStatsEvent_writeString(event, "test");
+    AStatsEvent_build(event);
+
+    size_t size;
+    uint8_t* buf = AStatsEvent_getBuffer(event, &size);
+
+    LogEvent logEvent(/*uid=*/1000, /*pid=*/1001);
+    EXPECT_TRUE(logEvent.parseBufferDeferred(buf, size));
+    // The event keeps its own copy of the buffer.
+    AStatsEvent_release(event);
+
+    EXPECT_EQ(100, logEvent.GetTagId());
+    EXPECT_TRUE(logEvent.hasDeferredFields());
+
+    // Fields are parsed on first access.
+    const vector<FieldValue>& values = logEvent.getValues();
+    EXPECT_FALSE(logEvent.hasDeferredFields());
+    EXPECT_TRUE(logEvent.isValid());
+    ASSERT_EQ(2, values.size());
+
+    const FieldValue& int32Item = values[0];
+    Field expectedField = getField(100, {1, 1, 1}, 0, {false, false, false});
+    EXPECT_EQ(expectedField, int32Item.mField);
+    EXPECT_EQ(Type::INT, int32Item.mValue.getType());
+    EXPECT_EQ(10, int32Item.mValue.int_value);
+
+    const FieldValue& stringItem = values[1];
+    expectedField = getField(100, {2, 1, 1}, 0, {true, false, false});
+    EXPECT_EQ(expectedField, stringItem.mField);
+    EXPECT_EQ(Type::STRING, stringItem.mValue.getType());
+    EXPECT_EQ("test", stringItem.mValue.str_value);
+}
+
+TEST(LogEventTest, TestDeferredParsingOfInvalidFields) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, 100);
+    AStatsEvent_writeInt32(event, 10);
+    AStatsEvent_build(event);
+
+    size_t size;
+    uint8_t* buf = AStatsEvent_getBuffer(event, &size);
+
+    LogEvent logEvent(/*uid=*/1000, /*pid=*/1001);
+    // The header is complete, the truncated field is only noticed once the fields are parsed.
+    EXPECT_TRUE(logEvent.parseBufferDeferred(buf, size - 1));
+    EXPECT_EQ(100, logEvent.GetTagId());
+    EXPECT_FALSE(logEvent.isValid());
+
+    AStatsEvent_release(event);
+}
+
 TEST(LogEventTest, TestStringAndByteArrayParsing) {
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_setAtomId(event, 100);
@@ -14,6 +14,7 @@
 
 #include "StatsLogProcessor.h"
 
+#include <android-base/file.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
@@ -300,6 +301,68 @@ TEST(StatsLogProcessorTest, TestOnDumpReportEraseData) {
     EXPECT_TRUE(noData);
 }
 
+TEST(StatsLogProcessorTest, TestStreamDumpReport) {
+    // Setup a config with two metrics, so that the report is written in several chunks.
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+
+    auto countMetric1 = config.add_count_metric();
+    countMetric1->set_id(123456);
+    countMetric1->set_what(wakelockAcquireMatcher.id());
+    countMetric1->set_bucket(FIVE_MINUTES);
+    auto countMetric2 = config.add_count_metric();
+    countMetric2->set_id(654321);
+    countMetric2->set_what(wakelockAcquireMatcher.id());
+    countMetric2->set_bucket(FIVE_MINUTES);
+
+    ConfigKey cfgKey;
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
+
+    std::vector<int> attributionUids = {111};
+    std::vector<string> attributionTags = {"App1"};
+    std::unique_ptr<LogEvent> event =
+            CreateAcquireWakelockEvent(2 /*timestamp*/, attributionUids, attributionTags, "wl1");
+    processor->OnLogEvent(event.get());
+
+    FILE* file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    int fd = fileno(file);
+    ssize_t size = processor->streamDumpReport(cfgKey, 3, true, true /* DO erase data. */,
+                                               ADB_DUMP, FAST, fd);
+    ASSERT_GT(size, 0);
+
+    string bytes;
+    lseek(fd, 0, SEEK_SET);
+    ASSERT_TRUE(android::base::ReadFdToString(fd, &bytes));
+    EXPECT_EQ(size, bytes.size());
+    ConfigMetricsReportList output;
+    ASSERT_TRUE(output.ParseFromString(bytes));
+    EXPECT_EQ(output.config_key().uid(), cfgKey.GetUid());
+    EXPECT_EQ(output.config_key().id(), cfgKey.GetId());
+    ASSERT_EQ(output.reports_size(), 1);
+    ASSERT_EQ(output.reports(0).metrics_size(), 2);
+    EXPECT_EQ(output.reports(0).metrics(0).metric_id(), 123456);
+    ASSERT_EQ(output.reports(0).metrics(0).count_metrics().data_size(), 1);
+    EXPECT_EQ(output.reports(0).metrics(1).metric_id(), 654321);
+    ASSERT_EQ(output.reports(0).metrics(1).count_metrics().data_size(), 1);
+    EXPECT_TRUE(output.reports(0).has_uid_map());
+    EXPECT_EQ(output.reports(0).current_report_elapsed_nanos(), 3);
+    fclose(file);
+
+    // The streamed report erased the data like onDumpReport does.
+    vector<uint8_t> dumpBytes;
+    processor->onDumpReport(cfgKey, 4, true, true /* DO erase data. */, ADB_DUMP, FAST,
+                            &dumpBytes);
+    output.ParseFromArray(dumpBytes.data(), dumpBytes.size());
+    ASSERT_EQ(output.reports_size(), 1);
+    ASSERT_EQ(output.reports(0).metrics_size(), 2);
+    EXPECT_EQ(output.reports(0).metrics(0).count_metrics().data_size(), 0);
+    EXPECT_EQ(output.reports(0).metrics(1).count_metrics().data_size(), 0);
+    EXPECT_EQ(output.reports(0).last_report_elapsed_nanos(), 3);
+}
+
 TEST(StatsLogProcessorTest, TestPullUidProviderSetOnConfigUpdate) {
     // Setup simple config key corresponding to empty config.
     sp<UidMap> m = new UidMap();
@@ -357,6 +420,133 @@ TEST(StatsLogProcessorTest, InvalidConfigRemoved) {
 
 }
 
+TEST(StatsLogProcessorTest, TestConfigUpdateReusesUnchangedMetrics) {
+    sp<UidMap> m = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> subscriberAlarmMonitor;
+    StatsLogProcessor p(
+            m, pullerManager, anomalyAlarmMonitor, subscriberAlarmMonitor, 0,
+            [](const ConfigKey& key) { return true; },
+            [](const int&, const vector<int64_t>&) { return true; });
+    ConfigKey key(3, 4);
+
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    auto screenIsOnPredicate = CreateScreenIsOnPredicate();
+    *config.add_predicate() = screenIsOnPredicate;
+    CountMetric* unchangedMetric = config.add_count_metric();
+    unchangedMetric->set_id(StringToId("Unchanged"));
+    unchangedMetric->set_what(config.atom_matcher(0).id());
+    unchangedMetric->set_condition(screenIsOnPredicate.id());
+    unchangedMetric->set_bucket(FIVE_MINUTES);
+    CountMetric* changedMetric = config.add_count_metric();
+    changedMetric->set_id(StringToId("Changed"));
+    changedMetric->set_what(config.atom_matcher(1).id());
+    changedMetric->set_bucket(FIVE_MINUTES);
+
+    p.OnConfigUpdated(0, key, config);
+    ASSERT_EQ(1, p.mMetricsManagers.size());
+    sp<MetricsManager> previousManager = p.mMetricsManagers[key];
+    ASSERT_EQ(2, previousManager->mAllMetricProducers.size());
+    sp<MetricProducer> unchangedProducer = previousManager->mAllMetricProducers[0];
+    sp<MetricProducer> changedProducer = previousManager->mAllMetricProducers[1];
+    sp<ConditionTracker> conditionTracker = previousManager->mAllConditionTrackers[0];
+    previousManager.clear();
+
+    config.mutable_count_metric(1)->set_bucket(ONE_HOUR);
+    p.OnConfigUpdated(5, key, config);
+    ASSERT_EQ(1, p.mMetricsManagers.size());
+    sp<MetricsManager> metricsManager = p.mMetricsManagers[key];
+    EXPECT_EQ(std::set<int64_t>({StringToId("Unchanged")}),
+              metricsManager->getReusedMetricIds());
+    ASSERT_EQ(2, metricsManager->mAllMetricProducers.size());
+    EXPECT_EQ(unchangedProducer, metricsManager->mAllMetricProducers[0]);
+    EXPECT_NE(changedProducer, metricsManager->mAllMetricProducers[1]);
+    EXPECT_EQ(conditionTracker, metricsManager->mAllConditionTrackers[0]);
+
+    // Moving a matcher changes the index the reused producer relies on.
+    config.mutable_atom_matcher()->SwapElements(0, 1);
+    p.OnConfigUpdated(10, key, config);
+    metricsManager = p.mMetricsManagers[key];
+    EXPECT_TRUE(metricsManager->getReusedMetricIds().empty());
+    EXPECT_NE(unchangedProducer, metricsManager->mAllMetricProducers[0]);
+    EXPECT_NE(conditionTracker, metricsManager->mAllConditionTrackers[0]);
+
+    // A reset, e.g. on TTL expiry, rebuilds even the metrics that did not change.
+    unchangedProducer = metricsManager->mAllMetricProducers[0];
+    p.OnConfigUpdatedLocked(15, key, config, false /* reuseMetrics */);
+    metricsManager = p.mMetricsManagers[key];
+    EXPECT_TRUE(metricsManager->getReusedMetricIds().empty());
+    EXPECT_NE(unchangedProducer, metricsManager->mAllMetricProducers[0]);
+}
+
+TEST(StatsLogProcessorTest, TestConfigUpdateRebuildsGaugeWithChangedTrigger) {
+    sp<UidMap> m = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> subscriberAlarmMonitor;
+    StatsLogProcessor p(
+            m, pullerManager, anomalyAlarmMonitor, subscriberAlarmMonitor, 0,
+            [](const ConfigKey& key) { return true; },
+            [](const int&, const vector<int64_t>&) { return true; });
+    ConfigKey key(3, 4);
+
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");
+    *config.add_atom_matcher() =
+            CreateSimpleAtomMatcher("SubsystemSleep", util::SUBSYSTEM_SLEEP_STATE);
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    GaugeMetric* metric = config.add_gauge_metric();
+    metric->set_id(StringToId("Gauge"));
+    metric->set_what(config.atom_matcher(0).id());
+    metric->set_trigger_event(config.atom_matcher(1).id());
+    metric->set_sampling_type(GaugeMetric::FIRST_N_SAMPLES);
+    metric->mutable_gauge_fields_filter()->set_include_all(true);
+    metric->set_bucket(FIVE_MINUTES);
+
+    p.OnConfigUpdated(0, key, config);
+    ASSERT_EQ(1, p.mMetricsManagers.size());
+    sp<MetricProducer> producer = p.mMetricsManagers[key]->mAllMetricProducers[0];
+
+    p.OnConfigUpdated(5, key, config);
+    EXPECT_EQ(producer, p.mMetricsManagers[key]->mAllMetricProducers[0]);
+
+    // Only the trigger matcher changes, the producer must not keep the old trigger atom.
+    *config.mutable_atom_matcher(1) = CreateAcquireWakelockAtomMatcher();
+    config.mutable_atom_matcher(1)->set_id(metric->trigger_event());
+    p.OnConfigUpdated(10, key, config);
+    EXPECT_TRUE(p.mMetricsManagers[key]->getReusedMetricIds().empty());
+    EXPECT_NE(producer, p.mMetricsManagers[key]->mAllMetricProducers[0]);
+}
+
+TEST(StatsLogProcessorTest, TestAtomDispatch) {
+    sp<UidMap> m = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> subscriberAlarmMonitor;
+    StatsLogProcessor p(m, pullerManager, anomalyAlarmMonitor, subscriberAlarmMonitor, 0,
+                        [](const ConfigKey& key) { return true; },
+                        [](const int&, const vector<int64_t>&) {return true;});
+    ConfigKey key1(3, 4);
+    ConfigKey key2(3, 5);
+    p.OnConfigUpdated(0, key1, MakeConfig(true));
+    p.OnConfigUpdated(0, key2, MakeConfig(false));
+
+    // Only the config with a process crash matcher is dispatched process crash events.
+    ASSERT_EQ(1, p.mMetricsManagersByAtom.size());
+    auto it = p.mMetricsManagersByAtom.find(util::PROCESS_LIFE_CYCLE_STATE_CHANGED);
+    ASSERT_NE(p.mMetricsManagersByAtom.end(), it);
+    ASSERT_EQ(1, it->second.size());
+    EXPECT_EQ(key1, it->second[0].first);
+    EXPECT_EQ(0, p.mMetricsManagersWithActivation.size());
+
+    p.OnConfigRemoved(key1);
+    EXPECT_EQ(0, p.mMetricsManagersByAtom.size());
+}
+
 
 TEST(StatsLogProcessorTest, TestActiveConfigMetricDiskWriteRead) {
     int uid = 1111;
@@ -207,7 +207,7 @@ TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot) {
     m.mLastUpdatePerConfigKey[config1] = 2;
 
     ProtoOutputStream proto;
-    m.appendUidMap(3, config1, nullptr, true, true, &proto);
+    m.appendUidMap(3, config1, nullptr, true, true, false, true, &proto);
 
     // Check there's still a uidmap attached this one.
     UidMapping results;
@@ -216,6 +216,75 @@ TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot) {
     EXPECT_EQ("v1", results.snapshots(0).package_info(0).version_string());
 }
 
+TEST(UidMapTest, TestDeltaSnapshot) {
+    UidMap m;
+    ConfigKey config1(1, StringToId("config1"));
+    m.OnConfigUpdated(config1);
+    vector<int32_t> uids = {1000, 1001};
+    vector<int64_t> versions = {4, 5};
+    vector<String16> apps = {String16(kApp1.c_str()), String16(kApp2.c_str())};
+    vector<String16> versionStrings = {String16("v1"), String16("v1")};
+    vector<String16> installers = {String16(""), String16("")};
+    m.updateMap(1, uids, versions, versionStrings, apps, installers);
+
+    // The first output has no previous snapshot to build on.
+    UidMapping results;
+    ProtoOutputStream proto;
+    m.appendUidMap(2, config1, nullptr, true, true, true, true, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(2, results.snapshots(0).package_info_size());
+
+    m.updateApp(3, String16(kApp1.c_str()), 1000, 40, String16("v40"), String16(""));
+    proto.clear();
+    m.appendUidMap(4, config1, nullptr, true, true, true, true, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    EXPECT_TRUE(results.snapshots(0).is_delta());
+    ASSERT_EQ(1, results.snapshots(0).package_info_size());
+    EXPECT_EQ(40, results.snapshots(0).package_info(0).version());
+    EXPECT_EQ(1, results.changes_size());
+
+    // An output that doesn't erase its data is not the base of the next delta.
+    m.updateApp(5, String16(kApp2.c_str()), 1001, 50, String16("v50"), String16(""));
+    proto.clear();
+    m.appendUidMap(6, config1, nullptr, true, true, true, false, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    EXPECT_EQ(1, results.snapshots(0).package_info_size());
+    proto.clear();
+    m.appendUidMap(7, config1, nullptr, true, true, true, true, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    EXPECT_TRUE(results.snapshots(0).is_delta());
+    ASSERT_EQ(1, results.snapshots(0).package_info_size());
+    EXPECT_EQ(50, results.snapshots(0).package_info(0).version());
+    EXPECT_EQ(1, results.changes_size());
+
+    // Resending the same map changes nothing.
+    versions[0] = 40;
+    versions[1] = 50;
+    versionStrings[0] = String16("v40");
+    versionStrings[1] = String16("v50");
+    m.updateMap(8, uids, versions, versionStrings, apps, installers);
+    proto.clear();
+    m.appendUidMap(9, config1, nullptr, true, true, true, true, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    EXPECT_TRUE(results.snapshots(0).is_delta());
+    EXPECT_EQ(0, results.snapshots(0).package_info_size());
+
+    // A package that disappears without a deletion can't be expressed as a delta.
+    m.updateMap(10, {1000}, {40}, {String16("v40")}, {String16(kApp1.c_str())}, {String16("")});
+    proto.clear();
+    m.appendUidMap(11, config1, nullptr, true, true, true, true, &proto);
+    protoOutputStreamToUidMapping(&proto, &results);
+    ASSERT_EQ(1, results.snapshots_size());
+    EXPECT_FALSE(results.snapshots(0).is_delta());
+    EXPECT_EQ(1, results.snapshots(0).package_info_size());
+}
+
 TEST(UidMapTest, TestRemovedAppRetained) {
     UidMap m;
     // Initialize single config key.
@@ -235,7 +304,7 @@ TEST(UidMapTest, TestRemovedAppRetained) {
     m.removeApp(2, String16(kApp2.c_str()), 1000);
 
     ProtoOutputStream proto;
-    m.appendUidMap(3, config1, nullptr, true, true, &proto);
+    m.appendUidMap(3, config1, nullptr, true, true, false, true, &proto);
 
     // Snapshot should still contain this item as deleted.
     UidMapping results;
@@ -267,7 +336,7 @@ TEST(UidMapTest, TestRemovedAppOverGuardrail) {
     // First, verify that we have the expected number of items.
     UidMapping results;
     ProtoOutputStream proto;
-    m.appendUidMap(3, config1, nullptr, true, true, &proto);
+    m.appendUidMap(3, config1, nullptr, true, true, false, true, &proto);
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(maxDeletedApps + 10, results.snapshots(0).package_info_size());
 
@@ -278,7 +347,7 @@ TEST(UidMapTest, TestRemovedAppOverGuardrail) {
     }
 
     proto.clear();
-    m.appendUidMap(5, config1, nullptr, true, true, &proto);
+    m.appendUidMap(5, config1, nullptr, true, true, false, true, &proto);
     // Snapshot drops the first nine items.
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(maxDeletedApps, results.snapshots(0).package_info_size());
@@ -310,14 +379,14 @@ TEST(UidMapTest, TestClearingOutput) {
     m.updateMap(1, uids, versions, versionStrings, apps, installers);
 
     ProtoOutputStream proto;
-    m.appendUidMap(2, config1, nullptr, true, true, &proto);
+    m.appendUidMap(2, config1, nullptr, true, true, false, true, &proto);
     UidMapping results;
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
 
     // We have to keep at least one snapshot in memory at all times.
     proto.clear();
-    m.appendUidMap(2, config1, nullptr, true, true, &proto);
+    m.appendUidMap(2, config1, nullptr, true, true, false, true, &proto);
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
 
@@ -326,7 +395,7 @@ TEST(UidMapTest, TestClearingOutput) {
     m.updateApp(5, String16(kApp1.c_str()), 1000, 40, String16("v40"), String16(""));
     ASSERT_EQ(1U, m.mChanges.size());
     proto.clear();
-    m.appendUidMap(6, config1, nullptr, true, true, &proto);
+    m.appendUidMap(6, config1, nullptr, true, true, false, true, &proto);
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
     ASSERT_EQ(1, results.changes_size());
@@ -338,14 +407,14 @@ TEST(UidMapTest, TestClearingOutput) {
 
     // We still can't remove anything.
     proto.clear();
-    m.appendUidMap(8, config1, nullptr, true, true, &proto);
+    m.appendUidMap(8, config1, nullptr, true, true, false, true, &proto);
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
     ASSERT_EQ(1, results.changes_size());
     ASSERT_EQ(2U, m.mChanges.size());
 
     proto.clear();
-    m.appendUidMap(9, config2, nullptr, true, true, &proto);
+    m.appendUidMap(9, config2, nullptr, true, true, false, true, &proto);
     protoOutputStreamToUidMapping(&proto, &results);
     ASSERT_EQ(1, results.snapshots_size());
     ASSERT_EQ(2, results.changes_size());
@@ -376,10 +445,10 @@ TEST(UidMapTest, TestMemoryComputed) {
 
     ProtoOutputStream proto;
     vector<uint8_t> bytes;
-    m.appendUidMap(2, config1, nullptr, true, true, &proto);
+    m.appendUidMap(2, config1, nullptr, true, true, false, true, &proto);
     size_t prevBytes = m.mBytesUsed;
 
-    m.appendUidMap(4, config1, nullptr, true, true, &proto);
+    m.appendUidMap(4, config1, nullptr, true, true, false, true, &proto);
     EXPECT_TRUE(m.mBytesUsed < prevBytes);
 }
 
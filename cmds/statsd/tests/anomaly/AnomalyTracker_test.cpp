@@ -400,6 +400,48 @@ TEST(AnomalyTrackerTest, TestSparseBuckets) {
             {{keyA, -1}, {keyB, -1}, {keyC, -1}, {keyD, -1}, {keyE, eventTimestamp6 + 7}});
 }
 
+TEST(AnomalyTrackerTest, TestZeroValuesNotSummed) {
+    Alert alert;
+    alert.set_num_buckets(3);
+    alert.set_trigger_if_sum_gt(2);
+
+    AnomalyTracker anomalyTracker(alert, kConfigKey);
+    MetricDimensionKey keyA = getMockMetricDimensionKey(1, "a");
+    MetricDimensionKey keyB = getMockMetricDimensionKey(1, "b");
+
+    anomalyTracker.addPastBucket(MockBucket({{keyA, 0}, {keyB, 1}}), 0);
+    ASSERT_EQ(anomalyTracker.mSumOverPastBuckets.size(), 1UL);
+    EXPECT_EQ(anomalyTracker.getSumOverPastBuckets(keyA), 0LL);
+    EXPECT_EQ(anomalyTracker.getSumOverPastBuckets(keyB), 1LL);
+
+    anomalyTracker.addPastBucket(keyA, 0, 1);
+    ASSERT_EQ(anomalyTracker.mSumOverPastBuckets.size(), 1UL);
+
+    // With no negative values, a current bucket value above the threshold is an anomaly.
+    EXPECT_TRUE(anomalyTracker.detectAnomaly(2, keyA, 3));
+    EXPECT_FALSE(anomalyTracker.detectAnomaly(2, keyA, 2));
+    EXPECT_TRUE(anomalyTracker.detectAnomaly(2, keyB, 2));
+
+    // Rolling bucket #0 out removes keyB from the sums.
+    EXPECT_FALSE(anomalyTracker.detectAnomaly(3, keyB, 2));
+    ASSERT_EQ(anomalyTracker.mSumOverPastBuckets.size(), 0UL);
+}
+
+TEST(AnomalyTrackerTest, TestNegativePastValuesSummed) {
+    Alert alert;
+    alert.set_num_buckets(3);
+    alert.set_trigger_if_sum_gt(2);
+
+    AnomalyTracker anomalyTracker(alert, kConfigKey);
+    MetricDimensionKey keyA = getMockMetricDimensionKey(1, "a");
+
+    // Value metrics can report negative values, which offset the current bucket.
+    anomalyTracker.addPastBucket(MockBucket({{keyA, -2}}), 0);
+    EXPECT_EQ(anomalyTracker.getSumOverPastBuckets(keyA), -2LL);
+    EXPECT_FALSE(anomalyTracker.detectAnomaly(1, keyA, 3));
+    EXPECT_TRUE(anomalyTracker.detectAnomaly(1, keyA, 5));
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -162,6 +162,57 @@ TEST(ConditionTrackerTest, TestNorCondition) {
     EXPECT_FALSE(evaluateCombinationCondition(children, operation, conditionResults));
 }
 
+TEST(ConditionTrackerTest, TestConditionStateCountsMatchEvaluation) {
+    const vector<LogicalOperation> operations = {LogicalOperation::AND, LogicalOperation::OR,
+                                                 LogicalOperation::NOT, LogicalOperation::NAND,
+                                                 LogicalOperation::NOR};
+    const vector<ConditionState> states = {ConditionState::kUnknown, ConditionState::kFalse,
+                                           ConditionState::kTrue};
+    vector<int> children = {0, 1};
+    for (LogicalOperation operation : operations) {
+        for (ConditionState first : states) {
+            for (ConditionState second : states) {
+                vector<ConditionState> conditionResults = {first, second};
+                vector<int> evaluatedChildren = children;
+                ConditionStateCounts counts;
+                counts.add(first);
+                if (operation == LogicalOperation::NOT) {
+                    evaluatedChildren.pop_back();
+                } else {
+                    counts.add(second);
+                }
+                EXPECT_EQ(evaluateCombinationCondition(evaluatedChildren, operation,
+                                                       conditionResults),
+                          counts.evaluate(operation, first));
+            }
+        }
+    }
+}
+
+TEST(ConditionTrackerTest, TestConditionStateCountsUpdate) {
+    ConditionStateCounts counts;
+    counts.add(ConditionState::kTrue);
+    counts.add(ConditionState::kUnknown);
+    EXPECT_EQ(ConditionState::kUnknown, counts.evaluate(LogicalOperation::AND,
+                                                        ConditionState::kTrue));
+
+    // The unknown child becomes false.
+    counts.remove(ConditionState::kUnknown);
+    counts.add(ConditionState::kFalse);
+    EXPECT_EQ(ConditionState::kFalse, counts.evaluate(LogicalOperation::AND,
+                                                      ConditionState::kTrue));
+    EXPECT_EQ(ConditionState::kTrue, counts.evaluate(LogicalOperation::OR,
+                                                     ConditionState::kTrue));
+
+    // And then true.
+    counts.remove(ConditionState::kFalse);
+    counts.add(ConditionState::kTrue);
+    EXPECT_EQ(ConditionState::kTrue, counts.evaluate(LogicalOperation::AND,
+                                                     ConditionState::kTrue));
+    EXPECT_EQ(ConditionState::kFalse, counts.evaluate(LogicalOperation::NOR,
+                                                      ConditionState::kTrue));
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
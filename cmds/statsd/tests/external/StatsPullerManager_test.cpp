@@ -19,6 +19,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include "stats_event.h"
 #include "tests/statsd_test_util.h"
 
@@ -36,6 +40,8 @@ namespace {
 
 int pullTagId1 = 10101;
 int pullTagId2 = 10102;
+int slowPullTagId1 = 10103;
+int slowPullTagId2 = 10104;
 int uid1 = 9999;
 int uid2 = 8888;
 ConfigKey configKey(50, 12345);
@@ -54,9 +60,14 @@ AStatsEvent* createSimpleEvent(int32_t atomId, int32_t value) {
 
 class FakePullAtomCallback : public BnPullAtomCallback {
 public:
-    FakePullAtomCallback(int32_t uid) : mUid(uid){};
+    FakePullAtomCallback(int32_t uid, int64_t pullDurationNs = 0)
+        : mUid(uid), mPullDurationNs(pullDurationNs){};
     Status onPullAtom(int atomTag,
                       const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        mNumPulls++;
+        if (mPullDurationNs > 0) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(mPullDurationNs));
+        }
         vector<StatsEventParcel> parcels;
         AStatsEvent* event = createSimpleEvent(atomTag, mUid);
         size_t size;
@@ -72,6 +83,21 @@ public:
         return Status::ok();
     }
     int32_t mUid;
+    int64_t mPullDurationNs;
+    std::atomic<int> mNumPulls{0};
+};
+
+class FakePullDataReceiver : public PullDataReceiver {
+public:
+    void onDataPulled(const vector<shared_ptr<LogEvent>>& data, bool pullSuccess,
+                      int64_t originalPullTimeNs) override {
+        mNumPulls++;
+        mPullSuccess = pullSuccess;
+        mNumEvents = data.size();
+    }
+    int mNumPulls = 0;
+    bool mPullSuccess = false;
+    size_t mNumEvents = 0;
 };
 
 class FakePullUidProvider : public PullUidProvider {
@@ -81,6 +107,8 @@ public:
             return {uid2, uid1};
         } else if (atomId == pullTagId2) {
             return {uid2};
+        } else if (atomId == slowPullTagId1 || atomId == slowPullTagId2) {
+            return {uid1};
         }
         return {};
     }
@@ -145,6 +173,97 @@ TEST(StatsPullerManagerTest, TestPullConfigKeyNoPullerWithUid) {
     EXPECT_FALSE(pullerManager->Pull(pullTagId2, configKey, /*timestamp =*/1, &data, true));
 }
 
+TEST(StatsPullerManagerTest, TestAlarmPullsRunConcurrently) {
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    const int64_t pullDurationNs = 300 * NS_PER_SEC / 1000;
+    shared_ptr<FakePullAtomCallback> cb =
+            SharedRefBase::make<FakePullAtomCallback>(uid1, pullDurationNs);
+    pullerManager->RegisterPullAtomCallback(uid1, slowPullTagId1, coolDownNs, NS_PER_SEC, {}, cb,
+                                            true);
+    pullerManager->RegisterPullAtomCallback(uid1, slowPullTagId2, coolDownNs, NS_PER_SEC, {}, cb,
+                                            true);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(slowPullTagId1, configKey, receiver1, /*nextPullTimeNs=*/1,
+                                    /*intervalNs=*/60 * NS_PER_SEC);
+    pullerManager->RegisterReceiver(slowPullTagId2, configKey, receiver2, /*nextPullTimeNs=*/1,
+                                    /*intervalNs=*/60 * NS_PER_SEC);
+
+    const int64_t startNs = getElapsedRealtimeNs();
+    pullerManager->OnAlarmFired(/*elapsedTimeNs=*/1);
+    const int64_t alarmDurationNs = getElapsedRealtimeNs() - startNs;
+
+    // Both pulls are delivered, and they did not run one after the other.
+    EXPECT_LT(alarmDurationNs, 2 * pullDurationNs);
+    EXPECT_EQ(1, receiver1->mNumPulls);
+    EXPECT_TRUE(receiver1->mPullSuccess);
+    EXPECT_EQ(1, receiver1->mNumEvents);
+    EXPECT_EQ(1, receiver2->mNumPulls);
+    EXPECT_TRUE(receiver2->mPullSuccess);
+    EXPECT_EQ(1, receiver2->mNumEvents);
+}
+
+TEST(StatsPullerManagerTest, TestAlarmPullTimeoutDoesNotDelayOtherPulls) {
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    shared_ptr<FakePullAtomCallback> slowCb =
+            SharedRefBase::make<FakePullAtomCallback>(uid1, 2 * NS_PER_SEC);
+    shared_ptr<FakePullAtomCallback> fastCb = SharedRefBase::make<FakePullAtomCallback>(uid1);
+    pullerManager->RegisterPullAtomCallback(uid1, slowPullTagId1, coolDownNs, timeoutNs, {},
+                                            slowCb, true);
+    pullerManager->RegisterPullAtomCallback(uid1, slowPullTagId2, coolDownNs, timeoutNs, {},
+                                            fastCb, true);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    sp<FakePullDataReceiver> slowReceiver = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> fastReceiver = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(slowPullTagId1, configKey, slowReceiver,
+                                    /*nextPullTimeNs=*/1, /*intervalNs=*/60 * NS_PER_SEC);
+    pullerManager->RegisterReceiver(slowPullTagId2, configKey, fastReceiver,
+                                    /*nextPullTimeNs=*/1, /*intervalNs=*/60 * NS_PER_SEC);
+
+    const int64_t startNs = getElapsedRealtimeNs();
+    pullerManager->OnAlarmFired(/*elapsedTimeNs=*/1);
+    const int64_t alarmDurationNs = getElapsedRealtimeNs() - startNs;
+
+    // The slow pull is given up on once its timeout passes.
+    EXPECT_LT(alarmDurationNs, NS_PER_SEC);
+    EXPECT_EQ(1, slowReceiver->mNumPulls);
+    EXPECT_FALSE(slowReceiver->mPullSuccess);
+    EXPECT_EQ(1, fastReceiver->mNumPulls);
+    EXPECT_TRUE(fastReceiver->mPullSuccess);
+    EXPECT_EQ(1, fastReceiver->mNumEvents);
+}
+
+TEST(StatsPullerManagerTest, TestAlarmSkipsPullStillRunning) {
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    shared_ptr<FakePullAtomCallback> slowCb =
+            SharedRefBase::make<FakePullAtomCallback>(uid1, 2 * NS_PER_SEC);
+    pullerManager->RegisterPullAtomCallback(uid1, slowPullTagId1, /*coolDownNs=*/0, timeoutNs, {},
+                                            slowCb, true);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    sp<FakePullDataReceiver> receiver = new FakePullDataReceiver();
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    pullerManager->RegisterReceiver(slowPullTagId1, configKey, receiver, /*nextPullTimeNs=*/1,
+                                    intervalNs);
+
+    pullerManager->OnAlarmFired(/*elapsedTimeNs=*/1);
+    EXPECT_EQ(1, receiver->mNumPulls);
+    EXPECT_FALSE(receiver->mPullSuccess);
+
+    // The first pull is still running, so the next alarm does not start another one.
+    const int64_t startNs = getElapsedRealtimeNs();
+    pullerManager->OnAlarmFired(/*elapsedTimeNs=*/intervalNs + 1);
+    const int64_t alarmDurationNs = getElapsedRealtimeNs() - startNs;
+
+    EXPECT_LT(alarmDurationNs, timeoutNs);
+    EXPECT_EQ(2, receiver->mNumPulls);
+    EXPECT_FALSE(receiver->mPullSuccess);
+    EXPECT_EQ(1, slowCb->mNumPulls);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include "tests/statsd_test_util.h"
 
 #include <gtest/gtest.h>
+#include <thread>
 #include <vector>
 
 #ifdef __ANDROID__
@@ -251,6 +252,50 @@ TEST(StatsdStatsTest, TestAtomLog) {
     EXPECT_TRUE(sensorAtomGood);
 }
 
+TEST(StatsdStatsTest, TestConcurrentHotPathCounters) {
+    StatsdStats stats;
+    ConfigKey key(0, 12345);
+    stats.noteConfigReceived(key, 2, 3, 4, 5, {}, true);
+
+    const int threadCount = 4;
+    const int eventsPerThread = 1000;
+    vector<std::thread> threads;
+    for (int i = 0; i < threadCount; i++) {
+        threads.emplace_back([&stats, &key] {
+            for (int j = 0; j < eventsPerThread; j++) {
+                stats.noteAtomLogged(util::SENSOR_STATE_CHANGED, 0);
+                stats.noteMatcherMatched(key, StringToId("matcher1"));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // The per-thread matcher counts are merged when the stats are dumped.
+    vector<uint8_t> output;
+    stats.dumpStats(&output, false);
+    StatsdStatsReport report;
+    ASSERT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    ASSERT_EQ(1, report.atom_stats_size());
+    EXPECT_EQ(util::SENSOR_STATE_CHANGED, report.atom_stats(0).tag());
+    EXPECT_EQ(threadCount * eventsPerThread, report.atom_stats(0).count());
+    ASSERT_EQ(1, report.config_stats_size());
+    ASSERT_EQ(1, report.config_stats(0).matcher_stats_size());
+    EXPECT_EQ(threadCount * eventsPerThread,
+              report.config_stats(0).matcher_stats(0).matched_times());
+
+    // Counts noted before the config is removed stay with the removed config.
+    stats.noteMatcherMatched(key, StringToId("matcher1"));
+    stats.noteConfigRemoved(key);
+    stats.dumpStats(&output, false);
+    ASSERT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    ASSERT_EQ(1, report.config_stats_size());
+    ASSERT_EQ(1, report.config_stats(0).matcher_stats_size());
+    EXPECT_EQ(threadCount * eventsPerThread + 1,
+              report.config_stats(0).matcher_stats(0).matched_times());
+}
+
 TEST(StatsdStatsTest, TestNonPlatformAtomLog) {
     StatsdStats stats;
     time_t now = time(nullptr);
@@ -106,6 +106,81 @@ TEST(LogEventQueue_test, TestSlowConsumer) {
     writer.join();
 }
 
+TEST(LogEventQueue_test, TestBatchConsumer) {
+    LogEventQueue queue(50);
+    int64_t timeBaseNs = 100;
+    std::thread writer([&queue, timeBaseNs] {
+        for (int i = 0; i < 100; i++) {
+            int64_t oldestEventNs;
+            bool success = queue.push(makeLogEvent(timeBaseNs + i * 1000), &oldestEventNs);
+            EXPECT_TRUE(success);
+            if (i % 10 == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    });
+
+    std::thread reader([&queue, timeBaseNs] {
+        std::vector<std::unique_ptr<LogEvent>> events;
+        int i = 0;
+        while (i < 100) {
+            size_t count = queue.waitPopBatch(&events, 16);
+            EXPECT_GT(count, 0u);
+            EXPECT_LE(count, 16u);
+            EXPECT_EQ(count, events.size());
+            for (auto& event : events) {
+                // All events are in right order.
+                EXPECT_EQ(timeBaseNs + i * 1000, event->GetElapsedTimestampNs());
+                queue.recycle(std::move(event));
+                i++;
+            }
+            events.clear();
+        }
+    });
+
+    reader.join();
+    writer.join();
+}
+
+TEST(LogEventQueue_test, TestObtainRecycledEvent) {
+    LogEventQueue queue(50);
+    int64_t oldestEventNs;
+    EXPECT_TRUE(queue.push(makeLogEvent(100), &oldestEventNs));
+
+    std::unique_ptr<LogEvent> event = queue.waitPop();
+    const LogEvent* consumed = event.get();
+    EXPECT_EQ(10, event->GetTagId());
+    queue.recycle(std::move(event));
+
+    // The recycled event is handed out again, looking like a newly constructed one.
+    std::unique_ptr<LogEvent> reused = queue.obtain(/*uid=*/1000, /*pid=*/1001);
+    EXPECT_EQ(consumed, reused.get());
+    EXPECT_EQ(0, reused->GetTagId());
+    EXPECT_EQ(1000, reused->GetUid());
+    EXPECT_EQ(1001, reused->GetPid());
+    EXPECT_TRUE(reused->isValid());
+    EXPECT_EQ(0u, reused->getValues().size());
+}
+
+TEST(LogEventQueue_test, TestPushBatch) {
+    LogEventQueue queue(5);
+    std::vector<std::unique_ptr<LogEvent>> events;
+    for (int i = 0; i < 8; i++) {
+        events.push_back(makeLogEvent(100 + i * 1000));
+    }
+
+    int64_t oldestEventNs = 0;
+    // Only the first 5 events fit.
+    EXPECT_EQ(3u, queue.pushBatch(&events, &oldestEventNs));
+    EXPECT_TRUE(events.empty());
+    EXPECT_EQ(100, oldestEventNs);
+
+    EXPECT_EQ(5u, queue.waitPopBatch(&events, 16));
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(100 + i * 1000, events[i]->GetElapsedTimestampNs());
+    }
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
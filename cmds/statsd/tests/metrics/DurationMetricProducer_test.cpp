@@ -170,6 +170,55 @@ TEST(DurationMetricTrackerTest, TestNonSlicedCondition) {
     EXPECT_EQ(1LL, buckets2[0].mDuration);
 }
 
+TEST(DurationMetricTrackerTest, TestIdleTrackerSkippedDuringFlush) {
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+
+    DurationMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    metric.set_aggregation_type(DurationMetric_AggregationType_SUM);
+
+    int tagId = 1;
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, bucketStartTimeNs + 1, tagId);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, bucketStartTimeNs + 3 * bucketSizeNs + 5, tagId);
+
+    FieldMatcher dimensions;
+
+    DurationMetricProducer durationProducer(
+            kConfigKey, metric, 0 /* condition index */, {ConditionState::kUnknown},
+            1 /* start index */, 2 /* stop index */, 3 /* stop_all index */, false /*nesting*/,
+            wizard, dimensions, bucketStartTimeNs, bucketStartTimeNs);
+    durationProducer.mCondition = ConditionState::kFalse;
+
+    // The duration starts paused, so the tracker is idle after the first bucket.
+    durationProducer.onMatchedLogEvent(1 /* start index*/, event1);
+    ASSERT_EQ(1UL, durationProducer.mActiveTrackerKeys.size());
+    durationProducer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    ASSERT_EQ(1UL, durationProducer.mCurrentSlicedDurationTrackerMap.size());
+    ASSERT_EQ(0UL, durationProducer.mActiveTrackerKeys.size());
+    durationProducer.flushIfNeededLocked(bucketStartTimeNs + 3 * bucketSizeNs + 1);
+    ASSERT_EQ(0UL, durationProducer.mPastBuckets.size());
+
+    // The idle tracker catches up with the current bucket once it is used again.
+    durationProducer.onConditionChanged(true /* condition */,
+                                        bucketStartTimeNs + 3 * bucketSizeNs + 2);
+    ASSERT_EQ(1UL, durationProducer.mActiveTrackerKeys.size());
+    durationProducer.onMatchedLogEvent(2 /* stop index*/, event2);
+    durationProducer.flushIfNeededLocked(bucketStartTimeNs + 4 * bucketSizeNs + 1);
+    EXPECT_EQ(0UL, durationProducer.mCurrentSlicedDurationTrackerMap.size());
+    EXPECT_EQ(0UL, durationProducer.mActiveTrackerKeys.size());
+    ASSERT_EQ(1UL, durationProducer.mPastBuckets.size());
+    const auto& buckets = durationProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+    ASSERT_EQ(1UL, buckets.size());
+    EXPECT_EQ(bucketStartTimeNs + 3 * bucketSizeNs, buckets[0].mBucketStartNs);
+    EXPECT_EQ(bucketStartTimeNs + 4 * bucketSizeNs, buckets[0].mBucketEndNs);
+    EXPECT_EQ(3LL, buckets[0].mDuration);
+}
+
 TEST(DurationMetricTrackerTest, TestNonSlicedConditionUnknownState) {
     sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
     int64_t bucketStartTimeNs = 10000000000;
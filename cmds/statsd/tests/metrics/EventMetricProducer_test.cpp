@@ -174,6 +174,99 @@ TEST(EventMetricProducerTest, TestEventsWithSlicedCondition) {
     EXPECT_EQ(bucketStartTimeNs + 10, report.event_metrics().data(0).elapsed_timestamp_nanos());
 }
 
+TEST(EventMetricProducerTest, TestSampling) {
+    int64_t bucketStartTimeNs = 10000000000;
+
+    EventMetric metric;
+    metric.set_id(1);
+    metric.set_sampling_percentage(50);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    EventMetricProducer eventProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, bucketStartTimeNs);
+
+    // Log each value twice. Sampling is decided by the values, so both events of a value are
+    // either kept or dropped.
+    int sampledValues = 0;
+    for (int i = 0; i < 20; i++) {
+        for (int j = 0; j < 2; j++) {
+            LogEvent event(/*uid=*/0, /*pid=*/0);
+            makeLogEvent(&event, 1 /*tagId*/, bucketStartTimeNs + 2 * i + j,
+                         "str" + std::to_string(i));
+            if (j == 0 && eventProducer.isSampledLocked(event)) {
+                sampledValues++;
+            }
+            eventProducer.onMatchedLogEvent(1 /*matcher index*/, event);
+        }
+    }
+    EXPECT_GT(sampledValues, 0);
+    EXPECT_LT(sampledValues, 20);
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    eventProducer.onDumpReport(bucketStartTimeNs + 100, true /*include current partial bucket*/,
+                               true /*erase data*/, FAST, &strSet, &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    EXPECT_TRUE(report.has_event_metrics());
+    ASSERT_EQ(2 * sampledValues, report.event_metrics().data_size());
+    for (int i = 0; i < report.event_metrics().data_size(); i += 2) {
+        EXPECT_EQ(report.event_metrics().data(i).elapsed_timestamp_nanos() + 1,
+                  report.event_metrics().data(i + 1).elapsed_timestamp_nanos());
+    }
+}
+
+TEST(EventMetricProducerTest, TestAggregateIdenticalAtoms) {
+    int64_t bucketStartTimeNs = 10000000000;
+
+    EventMetric metric;
+    metric.set_id(1);
+    metric.set_aggregate_identical_atoms(true);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, 1 /*tagId*/, bucketStartTimeNs + 1, "111");
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, 1 /*tagId*/, bucketStartTimeNs + 2, "222");
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event3, 1 /*tagId*/, bucketStartTimeNs + 3, "111");
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    EventMetricProducer eventProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, bucketStartTimeNs);
+
+    eventProducer.onMatchedLogEvent(1 /*matcher index*/, event1);
+    eventProducer.onMatchedLogEvent(1 /*matcher index*/, event2);
+    eventProducer.onMatchedLogEvent(1 /*matcher index*/, event3);
+    EXPECT_EQ(2UL, eventProducer.mAggregatedAtomCount);
+    EXPECT_EQ(0UL, eventProducer.mProto->size());
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    eventProducer.onDumpReport(bucketStartTimeNs + 20, true /*include current partial bucket*/,
+                               true /*erase data*/, FAST, &strSet, &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    EXPECT_TRUE(report.has_event_metrics());
+    ASSERT_EQ(2, report.event_metrics().data_size());
+    for (const EventMetricData& data : report.event_metrics().data()) {
+        ASSERT_TRUE(data.has_aggregated_atom_info());
+        EXPECT_FALSE(data.has_elapsed_timestamp_nanos());
+        const AggregatedAtomInfo& info = data.aggregated_atom_info();
+        if (info.count() == 2) {
+            EXPECT_EQ(bucketStartTimeNs + 1, info.first_elapsed_timestamp_nanos());
+            EXPECT_EQ(bucketStartTimeNs + 3, info.last_elapsed_timestamp_nanos());
+        } else {
+            EXPECT_EQ(1, info.count());
+            EXPECT_EQ(bucketStartTimeNs + 2, info.first_elapsed_timestamp_nanos());
+            EXPECT_EQ(bucketStartTimeNs + 2, info.last_elapsed_timestamp_nanos());
+        }
+    }
+    EXPECT_EQ(0UL, eventProducer.mAggregatedAtomCount);
+    EXPECT_EQ(0UL, eventProducer.byteSizeLocked());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
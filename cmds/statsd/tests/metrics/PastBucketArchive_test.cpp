@@ -0,0 +1,86 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/PastBucketArchive.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "tests/statsd_test_util.h"
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_INT64;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::ProtoOutputStream;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+const int FIELD_ID_BUCKET_INFO = 3;
+const int FIELD_ID_BUCKET_NUM = 4;
+const int FIELD_ID_VALUE = 7;
+
+void writeBucketInfoFields(int64_t bucketNum, int64_t value, ProtoOutputStream* protoOutput) {
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM, (long long)bucketNum);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_VALUE, (long long)value);
+}
+}  // anonymous namespace
+
+TEST(PastBucketArchiveTest, TestWriteToProto) {
+    HashableDimensionKey uidKey;
+    getUidProcessKey(1000, &uidKey);
+    MetricDimensionKey key(uidKey, DEFAULT_DIMENSION_KEY);
+    const uint64_t fieldId = FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO;
+
+    PastBucketArchive archive;
+    ProtoOutputStream expected;
+    for (int i = 0; i < 3; i++) {
+        ProtoOutputStream bucketInfo;
+        writeBucketInfoFields(i, 300 + i, &bucketInfo);
+        archive.append(key, bucketInfo);
+
+        uint64_t token = expected.start(fieldId);
+        writeBucketInfoFields(i, 300 + i, &expected);
+        expected.end(token);
+    }
+    EXPECT_EQ(3UL, archive.bucketCount(key));
+    EXPECT_EQ(0UL, archive.bucketCount(DEFAULT_METRIC_DIMENSION_KEY));
+    EXPECT_GT(archive.byteSize(), 0UL);
+
+    // The archived buckets are written exactly as if they had been written directly.
+    ProtoOutputStream output;
+    archive.writeToProto(key, fieldId, &output);
+    vector<uint8_t> outputBytes;
+    output.serializeToVector(&outputBytes);
+    vector<uint8_t> expectedBytes;
+    expected.serializeToVector(&expectedBytes);
+    EXPECT_EQ(expectedBytes, outputBytes);
+
+    archive.clear();
+    EXPECT_EQ(0UL, archive.bucketCount(key));
+    EXPECT_EQ(0UL, archive.byteSize());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -14,9 +14,11 @@
 
 #include "src/shell/ShellSubscriber.h"
 
+#include <android-base/file.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include <vector>
 
@@ -40,7 +42,7 @@ using testing::StrictMock;
 void runShellTest(ShellSubscription config, sp<MockUidMap> uidMap,
                   sp<MockStatsPullerManager> pullerManager,
                   const vector<std::shared_ptr<LogEvent>>& pushedEvents,
-                  const ShellData& expectedData) {
+                  const ShellData& expectedData, bool compressed = false) {
     // set up 2 pipes for read/write config and data
     int fds_config[2];
     ASSERT_EQ(0, pipe(fds_config));
@@ -94,11 +96,25 @@ void runShellTest(ShellSubscription config, sp<MockUidMap> uidMap,
         size_t dataSize = 0;
         read(fds_data[0], &dataSize, sizeof(dataSize));
         if (dataSize == 0) continue;
-        EXPECT_EQ(expectedData.ByteSize(), int(dataSize));
 
         // Read that much data in proto binary format.
         vector<uint8_t> dataBuffer(dataSize);
-        EXPECT_EQ((int)dataSize, read(fds_data[0], dataBuffer.data(), dataSize));
+        EXPECT_TRUE(android::base::ReadFully(fds_data[0], dataBuffer.data(), dataSize));
+
+        if (compressed) {
+            uint32_t rawSize;
+            ASSERT_GT(dataSize, sizeof(rawSize));
+            memcpy(&rawSize, dataBuffer.data(), sizeof(rawSize));
+            vector<uint8_t> rawBuffer(rawSize);
+            uLongf uncompressedSize = rawSize;
+            ASSERT_EQ(Z_OK, uncompress(rawBuffer.data(), &uncompressedSize,
+                                       dataBuffer.data() + sizeof(rawSize),
+                                       dataSize - sizeof(rawSize)));
+            ASSERT_EQ(rawSize, uncompressedSize);
+            dataBuffer = rawBuffer;
+            dataSize = rawSize;
+        }
+        EXPECT_EQ(expectedData.ByteSize(), int(dataSize));
 
         // Make sure the received bytes can be parsed to an atom.
         ShellData receivedAtom;
@@ -142,6 +158,107 @@ TEST(ShellSubscriberTest, testPushedSubscription) {
     runShellTest(config, uidMap, pullerManager, pushedList, shellData);
 }
 
+TEST(ShellSubscriberTest, testPushedSubscriptionBatched) {
+    sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    vector<std::shared_ptr<LogEvent>> pushedList;
+    pushedList.push_back(CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    pushedList.push_back(CreateScreenStateChangedEvent(
+            2000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF));
+    pushedList.push_back(CreateScreenStateChangedEvent(
+            3000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(29);
+    config.set_max_batch_atoms(3);
+    config.set_max_batch_delay_millis(60 * 1000);
+
+    // All three atoms are sent in one ShellData.
+    ShellData shellData;
+    shellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    shellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
+    shellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+
+    runShellTest(config, uidMap, pullerManager, pushedList, shellData);
+}
+
+TEST(ShellSubscriberTest, testPushedSubscriptionCompressed) {
+    sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    vector<std::shared_ptr<LogEvent>> pushedList;
+    pushedList.push_back(CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(29);
+    config.set_compress_batches(true);
+
+    ShellData shellData;
+    shellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+
+    runShellTest(config, uidMap, pullerManager, pushedList, shellData, /*compressed=*/true);
+}
+
+TEST(ShellSubscriberTest, testDropsWhenClientIsSlow) {
+    sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+
+    int fds_config[2];
+    ASSERT_EQ(0, pipe(fds_config));
+    int fds_data[2];
+    ASSERT_EQ(0, pipe(fds_data));
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(29);
+    size_t bufferSize = config.ByteSize();
+    write(fds_config[1], &bufferSize, sizeof(bufferSize));
+    vector<uint8_t> buffer(bufferSize);
+    config.SerializeToArray(&buffer[0], bufferSize);
+    write(fds_config[1], buffer.data(), bufferSize);
+    close(fds_config[1]);
+
+    sp<ShellSubscriber> shellClient = new ShellSubscriber(uidMap, pullerManager);
+    std::thread reader([&shellClient, &fds_config, &fds_data] {
+        shellClient->startNewSubscription(fds_config[0], fds_data[1], /*timeoutSec=*/-1);
+    });
+    reader.detach();
+    std::this_thread::sleep_for(100ms);
+
+    // Nothing is read from the pipe while logging, which must not block.
+    const int64_t numEvents = 200000;
+    std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    for (int64_t i = 0; i < numEvents; i++) {
+        shellClient->onLogEvent(*event);
+    }
+
+    // Every atom is either received or accounted as dropped.
+    int64_t receivedAtoms = 0;
+    int64_t droppedAtoms = 0;
+    while (receivedAtoms + droppedAtoms < numEvents) {
+        size_t dataSize = 0;
+        ASSERT_TRUE(android::base::ReadFully(fds_data[0], &dataSize, sizeof(dataSize)));
+        if (dataSize == 0) continue;
+        vector<uint8_t> dataBuffer(dataSize);
+        ASSERT_TRUE(android::base::ReadFully(fds_data[0], dataBuffer.data(), dataSize));
+        ShellData shellData;
+        ASSERT_TRUE(shellData.ParseFromArray(dataBuffer.data(), dataSize));
+        receivedAtoms += shellData.atom_size();
+        droppedAtoms += shellData.dropped_atom_count();
+    }
+    EXPECT_EQ(numEvents, receivedAtoms + droppedAtoms);
+    EXPECT_GT(droppedAtoms, 0);
+
+    close(fds_data[0]);
+}
+
 namespace {
 
 int kUid1 = 1000;
@@ -57,6 +57,28 @@ public:
     }
 };
 
+/**
+ * Mock StateListener class that records how state changes are batched.
+ */
+class TestBatchStateListener : public virtual StateListener {
+public:
+    TestBatchStateListener(){};
+
+    virtual ~TestBatchStateListener(){};
+
+    std::vector<size_t> batchSizes;
+
+    void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
+                        const HashableDimensionKey& primaryKey, const FieldValue& oldState,
+                        const FieldValue& newState) {
+    }
+
+    void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                        const std::vector<StateChange>& changes) override {
+        batchSizes.push_back(changes.size());
+    }
+};
+
 int getStateInt(StateManager& mgr, int atomId, const HashableDimensionKey& queryKey) {
     FieldValue output;
     mgr.getStateValue(atomId, queryKey, &output);
@@ -330,6 +352,45 @@ TEST(StateTrackerTest, TestStateChangeReset) {
     }
 }
 
+/**
+ * Test that all state changes caused by a reset event are delivered to each
+ * listener in a single batch.
+ */
+TEST(StateTrackerTest, TestStateChangeResetBatched) {
+    sp<TestStateListener> listener = new TestStateListener();
+    sp<TestBatchStateListener> batchListener = new TestBatchStateListener();
+    StateManager mgr;
+    mgr.registerListener(util::BLE_SCAN_STATE_CHANGED, listener);
+    mgr.registerListener(util::BLE_SCAN_STATE_CHANGED, batchListener);
+
+    std::vector<string> attributionTags = {"tag1"};
+    for (int uid = 1000; uid < 1003; uid++) {
+        std::unique_ptr<LogEvent> event =
+                CreateBleScanStateChangedEvent(timestampNs + uid, {uid}, attributionTags,
+                                               BleScanStateChanged::ON, false, false, false);
+        mgr.onLogEvent(*event);
+    }
+    EXPECT_EQ(std::vector<size_t>({1, 1, 1}), batchListener->batchSizes);
+    ASSERT_EQ(3, listener->updates.size());
+    listener->updates.clear();
+    batchListener->batchSizes.clear();
+
+    std::unique_ptr<LogEvent> resetEvent =
+            CreateBleScanStateChangedEvent(timestampNs + 2000, {1000}, attributionTags,
+                                           BleScanStateChanged::RESET, false, false, false);
+    mgr.onLogEvent(*resetEvent);
+    EXPECT_EQ(std::vector<size_t>({3}), batchListener->batchSizes);
+
+    // Listeners that don't handle batches still get one callback per primary key.
+    ASSERT_EQ(3, listener->updates.size());
+    FieldValue stateFieldValue;
+    for (const TestStateListener::Update& update : listener->updates) {
+        EXPECT_EQ(BleScanStateChanged::OFF, update.mState);
+        mgr.getStateValue(util::BLE_SCAN_STATE_CHANGED, update.mKey, &stateFieldValue);
+        EXPECT_EQ(BleScanStateChanged::OFF, stateFieldValue.mValue.int_value);
+    }
+}
+
 /**
  * Test StateManager's onLogEvent and StateListener's onStateChanged correctly
  * updates listener for states without primary keys.
@@ -16,6 +16,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include "frameworks/base/cmds/statsd/src/stats_log.pb.h"
+#include "src/stats_log_util.h"
 #include "src/storage/StorageManager.h"
 
 #ifdef __ANDROID__
@@ -196,6 +198,126 @@ TEST(StorageManagerTest, AppendConfigReportTest4) {
     clearLocalHistoryTestFiles();
 }
 
+ConfigMetricsReport makeReport(int64_t reportTimeNs) {
+    ConfigMetricsReport report;
+    report.set_current_report_elapsed_nanos(reportTimeNs);
+    report.add_strings("com.app.name");
+    return report;
+}
+
+void appendReportToSegment(const ConfigKey& key, long wallClockSec,
+                           const ConfigMetricsReport& report) {
+    string bytes;
+    report.SerializeToString(&bytes);
+    StorageManager::appendReportToSegment(key, wallClockSec,
+                                          vector<uint8_t>(bytes.begin(), bytes.end()));
+}
+
+TEST(StorageManagerTest, AppendReportToSegmentTest) {
+    ConfigKey key(1067, 1);
+    long nowSec = getWallClockSec();
+    appendReportToSegment(key, nowSec, makeReport(100));
+    appendReportToSegment(key, nowSec + 1, makeReport(200));
+
+    // Both reports went into the same segment.
+    string segment = StorageManager::getDataSegmentFileName(nowSec, key.GetUid(), key.GetId());
+    EXPECT_TRUE(fileExist(segment));
+    EXPECT_FALSE(fileExist(
+            StorageManager::getDataSegmentFileName(nowSec + 1, key.GetUid(), key.GetId())));
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key));
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(key, &out, true /*erase?*/, false /*isAdb?*/);
+    string bytes;
+    ASSERT_TRUE(out.serializeToString(&bytes));
+    ConfigMetricsReportList reports;
+    ASSERT_TRUE(reports.ParseFromString(bytes));
+    ASSERT_EQ(2, reports.reports_size());
+    EXPECT_EQ(100, reports.reports(0).current_report_elapsed_nanos());
+    EXPECT_EQ(200, reports.reports(1).current_report_elapsed_nanos());
+    ASSERT_EQ(1, reports.reports(1).strings_size());
+    EXPECT_EQ("com.app.name", reports.reports(1).strings(0));
+
+    EXPECT_FALSE(fileExist(segment));
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(key));
+}
+
+TEST(StorageManagerTest, SegmentWithTornRecordTest) {
+    ConfigKey key(1067, 2);
+    long nowSec = getWallClockSec();
+    appendReportToSegment(key, nowSec, makeReport(100));
+
+    // Simulate a crash in the middle of appending the next report.
+    string segment = StorageManager::getDataSegmentFileName(nowSec, key.GetUid(), key.GetId());
+    {
+        android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+                open(segment.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)));
+        ASSERT_NE(-1, fd);
+        dprintf(fd, "torn");
+    }
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(key, &out, true /*erase?*/, false /*isAdb?*/);
+    string bytes;
+    ASSERT_TRUE(out.serializeToString(&bytes));
+    ConfigMetricsReportList reports;
+    ASSERT_TRUE(reports.ParseFromString(bytes));
+    ASSERT_EQ(1, reports.reports_size());
+    EXPECT_EQ(100, reports.reports(0).current_report_elapsed_nanos());
+    EXPECT_FALSE(fileExist(segment));
+}
+
+TEST(StorageManagerTest, AppendAfterTornRecordTest) {
+    ConfigKey key(1067, 3);
+    long nowSec = getWallClockSec();
+    appendReportToSegment(key, nowSec, makeReport(100));
+
+    // Simulate a crash in the middle of appending a report, then append another one.
+    string segment = StorageManager::getDataSegmentFileName(nowSec, key.GetUid(), key.GetId());
+    {
+        android::base::unique_fd fd(TEMP_FAILURE_RETRY(
+                open(segment.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC)));
+        ASSERT_NE(-1, fd);
+        dprintf(fd, "torn");
+    }
+    appendReportToSegment(key, nowSec + 1, makeReport(200));
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(key, &out, true /*erase?*/, false /*isAdb?*/);
+    string bytes;
+    ASSERT_TRUE(out.serializeToString(&bytes));
+    ConfigMetricsReportList reports;
+    ASSERT_TRUE(reports.ParseFromString(bytes));
+    ASSERT_EQ(2, reports.reports_size());
+    EXPECT_EQ(100, reports.reports(0).current_report_elapsed_nanos());
+    EXPECT_EQ(200, reports.reports(1).current_report_elapsed_nanos());
+    EXPECT_FALSE(fileExist(segment));
+}
+
+TEST(StorageManagerTest, AppendLargeReportToSegmentTest) {
+    ConfigKey key(1067, 4);
+    long nowSec = getWallClockSec();
+    // Random strings barely compress, so the record is larger than a segment.
+    ConfigMetricsReport report = makeReport(100);
+    std::srand(0);
+    string large(400 * 1024, ' ');
+    for (char& c : large) {
+        c = 'a' + std::rand() % 26;
+    }
+    report.add_strings(large);
+    appendReportToSegment(key, nowSec, report);
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(key, &out, true /*erase?*/, false /*isAdb?*/);
+    string bytes;
+    ASSERT_TRUE(out.serializeToString(&bytes));
+    ConfigMetricsReportList reports;
+    ASSERT_TRUE(reports.ParseFromString(bytes));
+    ASSERT_EQ(1, reports.reports_size());
+    ASSERT_EQ(2, reports.reports(0).strings_size());
+    EXPECT_EQ(large, reports.reports(0).strings(1));
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -16,6 +16,9 @@
 
 #define ATRACE_TAG ATRACE_TAG_RESOURCES
 
+#include <mutex>
+#include <unordered_map>
+
 #include "android-base/logging.h"
 #include "android-base/macros.h"
 #include "android-base/stringprintf.h"
@@ -157,6 +160,38 @@ class LoaderAssetsProvider : public AssetsProvider {
   jobject assets_provider_;
 };
 
+// ApkAssets shared with other Java ApkAssets objects through ApkAssets::LoadShared(), along with
+// the number of Java objects holding them. The ApkAssets are released when the last Java object
+// holding them is destroyed.
+static std::mutex gSharedApkAssetsLock;
+static std::unordered_map<const ApkAssets*,
+                          std::pair<std::shared_ptr<const ApkAssets>, size_t>> gSharedApkAssets;
+
+static jlong AcquireSharedApkAssets(std::shared_ptr<const ApkAssets> apk_assets) {
+  const ApkAssets* ptr = apk_assets.get();
+  std::lock_guard<std::mutex> lock(gSharedApkAssetsLock);
+  auto& entry = gSharedApkAssets[ptr];
+  if (entry.first == nullptr) {
+    entry.first = std::move(apk_assets);
+  }
+  entry.second++;
+  return reinterpret_cast<jlong>(ptr);
+}
+
+// Returns false if `ptr` is not a shared ApkAssets and must be deleted by the caller.
+static bool ReleaseSharedApkAssets(jlong ptr) {
+  std::lock_guard<std::mutex> lock(gSharedApkAssetsLock);
+  auto iter = gSharedApkAssets.find(reinterpret_cast<const ApkAssets*>(ptr));
+  if (iter == gSharedApkAssets.end()) {
+    return false;
+  }
+
+  if (--iter->second.second == 0) {
+    gSharedApkAssets.erase(iter);
+  }
+  return true;
+}
+
 static jlong NativeLoad(JNIEnv* env, jclass /*clazz*/, const format_type_t format,
                         jstring java_path, const jint property_flags, jobject assets_provider) {
   ScopedUtfChars path(env, java_path);
@@ -167,6 +202,20 @@ static jlong NativeLoad(JNIEnv* env, jclass /*clazz*/, const format_type_t forma
   ATRACE_NAME(base::StringPrintf("LoadApkAssets(%s)", path.c_str()).c_str());
 
   auto loader_assets = LoaderAssetsProvider::Create(env, assets_provider);
+  if (format == FORMAT_APK && loader_assets == nullptr) {
+    // APKs without loader provided assets are immutable, so share them with every other Java
+    // ApkAssets loading the same APK.
+    std::shared_ptr<const ApkAssets> shared_apk_assets =
+        ApkAssets::LoadShared(path.c_str(), property_flags);
+    if (shared_apk_assets == nullptr) {
+      const std::string error_msg =
+          base::StringPrintf("Failed to load asset path %s", path.c_str());
+      jniThrowException(env, "java/io/IOException", error_msg.c_str());
+      return 0;
+    }
+    return AcquireSharedApkAssets(std::move(shared_apk_assets));
+  }
+
   std::unique_ptr<const ApkAssets> apk_assets;
   switch (format) {
     case FORMAT_APK:
@@ -315,6 +364,9 @@ static jlong NativeLoadEmpty(JNIEnv* env, jclass /*clazz*/, jint flags, jobject
 }
 
 static void NativeDestroy(JNIEnv* /*env*/, jclass /*clazz*/, jlong ptr) {
+  if (ReleaseSharedApkAssets(ptr)) {
+    return;
+  }
   delete reinterpret_cast<ApkAssets*>(ptr);
 }
 
@@ -24,12 +24,15 @@
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/String16.h>
+#include <utils/Timers.h>
 #include <cutils/ashmem.h>
 #include <sys/mman.h>
 
 #include <string.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include <androidfw/CursorWindow.h>
 
 #include <sqlite3.h>
@@ -650,8 +653,44 @@ enum CopyRowResult {
     CPR_ERROR,
 };
 
+/* Type and size of a column of the current row, read before the row is written. */
+struct ColumnValue {
+    int type;
+    size_t size;
+};
+
+/* Fills that take longer than this are logged along with the statement. */
+static const nsecs_t SLOW_WINDOW_FILL_NS = ms2ns(200);
+
 static CopyRowResult copyRow(JNIEnv* env, CursorWindow* window,
-        sqlite3_stmt* statement, int numColumns, int startPos, int addedRows) {
+        sqlite3_stmt* statement, int numColumns, int startPos, int addedRows,
+        std::vector<ColumnValue>& columns) {
+    // Size the row before touching the window. The window does not reclaim the field data of a
+    // row freed part way through, so a row that cannot fit must be turned away up front rather
+    // than discovered full at its last column.
+    size_t rowSize = numColumns * sizeof(CursorWindow::FieldSlot)
+            + sizeof(uint32_t) /* row slot */ + 3 /* field directory alignment */;
+    for (int i = 0; i < numColumns; i++) {
+        ColumnValue& column = columns[i];
+        column.type = sqlite3_column_type(statement, i);
+        if (column.type == SQLITE_TEXT) {
+            // SQLite does not include the NULL terminator in size, but does
+            // ensure all strings are NULL terminated, so increase size by
+            // one to make sure we store the terminator.
+            column.size = sqlite3_column_bytes(statement, i) + 1;
+        } else if (column.type == SQLITE_BLOB) {
+            column.size = sqlite3_column_bytes(statement, i);
+        } else {
+            column.size = 0;
+        }
+        rowSize += column.size;
+    }
+    if (rowSize > window->freeSpace()) {
+        LOG_WINDOW("Row of %zu bytes does not fit in %zu free bytes at startPos %d row %d",
+                rowSize, window->freeSpace(), startPos, addedRows);
+        return CPR_FULL;
+    }
+
     // Allocate a new field directory for the row.
     status_t status = window->allocRow();
     if (status) {
@@ -663,25 +702,21 @@ static CopyRowResult copyRow(JNIEnv* env, CursorWindow* window,
     // Pack the row into the window.
     CopyRowResult result = CPR_OK;
     for (int i = 0; i < numColumns; i++) {
-        int type = sqlite3_column_type(statement, i);
-        if (type == SQLITE_TEXT) {
+        const ColumnValue& column = columns[i];
+        if (column.type == SQLITE_TEXT) {
             // TEXT data
             const char* text = reinterpret_cast<const char*>(
                     sqlite3_column_text(statement, i));
-            // SQLite does not include the NULL terminator in size, but does
-            // ensure all strings are NULL terminated, so increase size by
-            // one to make sure we store the terminator.
-            size_t sizeIncludingNull = sqlite3_column_bytes(statement, i) + 1;
-            status = window->putString(addedRows, i, text, sizeIncludingNull);
+            status = window->putString(addedRows, i, text, column.size);
             if (status) {
                 LOG_WINDOW("Failed allocating %zu bytes for text at %d,%d, error=%d",
-                        sizeIncludingNull, startPos + addedRows, i, status);
+                        column.size, startPos + addedRows, i, status);
                 result = CPR_FULL;
                 break;
             }
             LOG_WINDOW("%d,%d is TEXT with %zu bytes",
-                    startPos + addedRows, i, sizeIncludingNull);
-        } else if (type == SQLITE_INTEGER) {
+                    startPos + addedRows, i, column.size);
+        } else if (column.type == SQLITE_INTEGER) {
             // INTEGER data
             int64_t value = sqlite3_column_int64(statement, i);
             status = window->putLong(addedRows, i, value);
@@ -692,7 +727,7 @@ static CopyRowResult copyRow(JNIEnv* env, CursorWindow* window,
                 break;
             }
             LOG_WINDOW("%d,%d is INTEGER %" PRId64, startPos + addedRows, i, value);
-        } else if (type == SQLITE_FLOAT) {
+        } else if (column.type == SQLITE_FLOAT) {
             // FLOAT data
             double value = sqlite3_column_double(statement, i);
             status = window->putDouble(addedRows, i, value);
@@ -703,20 +738,19 @@ static CopyRowResult copyRow(JNIEnv* env, CursorWindow* window,
                 break;
             }
             LOG_WINDOW("%d,%d is FLOAT %lf", startPos + addedRows, i, value);
-        } else if (type == SQLITE_BLOB) {
+        } else if (column.type == SQLITE_BLOB) {
             // BLOB data
             const void* blob = sqlite3_column_blob(statement, i);
-            size_t size = sqlite3_column_bytes(statement, i);
-            status = window->putBlob(addedRows, i, blob, size);
+            status = window->putBlob(addedRows, i, blob, column.size);
             if (status) {
                 LOG_WINDOW("Failed allocating %zu bytes for blob at %d,%d, error=%d",
-                        size, startPos + addedRows, i, status);
+                        column.size, startPos + addedRows, i, status);
                 result = CPR_FULL;
                 break;
             }
             LOG_WINDOW("%d,%d is Blob with %zu bytes",
-                    startPos + addedRows, i, size);
-        } else if (type == SQLITE_NULL) {
+                    startPos + addedRows, i, column.size);
+        } else if (column.type == SQLITE_NULL) {
             // NULL field
             status = window->putNull(addedRows, i);
             if (status) {
@@ -768,6 +802,8 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
         return 0;
     }
 
+    std::vector<ColumnValue> columns(numColumns);
+    const nsecs_t fillStart = systemTime(SYSTEM_TIME_MONOTONIC);
     int retryCount = 0;
     int totalRows = 0;
     int addedRows = 0;
@@ -785,7 +821,8 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
                 continue;
             }
 
-            CopyRowResult cpr = copyRow(env, window, statement, numColumns, startPos, addedRows);
+            CopyRowResult cpr = copyRow(env, window, statement, numColumns, startPos, addedRows,
+                    columns);
             if (cpr == CPR_FULL && addedRows && startPos + addedRows <= requiredPos) {
                 // We filled the window before we got to the one row that we really wanted.
                 // Clear the window and start filling it again from here.
@@ -794,7 +831,8 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
                 window->setNumColumns(numColumns);
                 startPos += addedRows;
                 addedRows = 0;
-                cpr = copyRow(env, window, statement, numColumns, startPos, addedRows);
+                cpr = copyRow(env, window, statement, numColumns, startPos, addedRows,
+                        columns);
             }
 
             if (cpr == CPR_OK) {
@@ -831,6 +869,13 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
             statement, totalRows, addedRows, window->size() - window->freeSpace());
     sqlite3_reset(statement);
 
+    const nsecs_t fillTime = systemTime(SYSTEM_TIME_MONOTONIC) - fillStart;
+    if (fillTime > SLOW_WINDOW_FILL_NS) {
+        ALOGW("Filling the cursor window took %" PRId64 "ms: stepped %d rows, added %d rows "
+                "in %zu bytes for \"%s\"", ns2ms(fillTime), totalRows, addedRows,
+                window->size() - window->freeSpace(), sqlite3_sql(statement));
+    }
+
     // Report the total number of rows on request.
     if (startPos > totalRows) {
         ALOGE("startPos %d > actual rows %d", startPos, totalRows);
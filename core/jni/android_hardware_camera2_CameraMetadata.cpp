@@ -25,6 +25,9 @@
 #include <utils/KeyedVector.h>
 #include <stdio.h>
 #include <string.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "jni.h"
@@ -158,6 +161,54 @@ struct Helpers {
 #undef METADATA_UPDATE
     }
 };
+
+// Memoizes CameraMetadata::getTagFromName(), which compares the key against the names of every
+// section and tag. Every metadata key resolves its tag when it is first used, and capture results
+// carry many keys. The names of vendor tags depend on the vendor tag descriptor, so tags are
+// cached per descriptor; the descriptor is held so that its address is not reused.
+class TagFromNameCache {
+public:
+    status_t getTagFromName(const char* key, const sp<VendorTagDescriptor>& vTags,
+            /*out*/uint32_t* tag) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto descIt = mTagsByDescriptor.find(vTags.get());
+        if (descIt != mTagsByDescriptor.end()) {
+            auto tagIt = descIt->second.tags.find(key);
+            if (tagIt != descIt->second.tags.end()) {
+                *tag = tagIt->second;
+                return OK;
+            }
+        }
+
+        status_t res = CameraMetadata::getTagFromName(key, vTags.get(), tag);
+        if (res != OK) {
+            return res;
+        }
+        if (descIt == mTagsByDescriptor.end()) {
+            // Descriptors are only replaced when the camera service restarts, so start over
+            // rather than keep stale ones alive.
+            if (mTagsByDescriptor.size() >= kMaxDescriptors) {
+                mTagsByDescriptor.clear();
+            }
+            descIt = mTagsByDescriptor.emplace(vTags.get(), DescriptorTags{vTags, {}}).first;
+        }
+        descIt->second.tags.emplace(key, *tag);
+        return OK;
+    }
+
+private:
+    static constexpr size_t kMaxDescriptors = 8;
+
+    struct DescriptorTags {
+        sp<VendorTagDescriptor> vTags;
+        std::unordered_map<std::string, uint32_t> tags;
+    };
+
+    std::mutex mLock;
+    std::unordered_map<const VendorTagDescriptor*, DescriptorTags> mTagsByDescriptor;
+};
+
+TagFromNameCache gTagFromNameCache;
 } // namespace {}
 
 extern "C" {
@@ -693,7 +744,7 @@ static jint CameraMetadata_getTagFromKeyLocal(JNIEnv *env, jclass thiz, jlong pt
         }
     }
 
-    status_t res = CameraMetadata::getTagFromName(key, vTags.get(), &tag);
+    status_t res = gTagFromNameCache.getTagFromName(key, vTags, &tag);
     if (res != OK) {
         jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
                              "Could not find tag for key '%s')", key);
@@ -837,7 +888,7 @@ static jint CameraMetadata_getTagFromKey(JNIEnv *env, jclass thiz, jstring keyNa
         }
     }
 
-    status_t res = CameraMetadata::getTagFromName(key, vTags.get(), &tag);
+    status_t res = gTagFromNameCache.getTagFromName(key, vTags, &tag);
     if (res != OK) {
         jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
                              "Could not find tag for key '%s')", key);
@@ -307,6 +307,9 @@ bool NativeContext::hasCaptureTime() const {
 /**
  * Wrapper class for a Java OutputStream.
  *
+ * Writes are gathered in a Java byte array and handed to the OutputStream once it is full, since
+ * TiffWriter emits the IFD entries a few bytes at a time. Call flush() once everything is written.
+ *
  * This class is not intended to be used across JNI calls.
  */
 class JniOutputStream : public Output, public LightRefBase<JniOutputStream> {
@@ -319,18 +322,21 @@ public:
 
     status_t write(const uint8_t* buf, size_t offset, size_t count);
 
+    status_t flush();
+
     status_t close();
 private:
     enum {
-        BYTE_ARRAY_LENGTH = 4096
+        BYTE_ARRAY_LENGTH = 64 * 1024
     };
     jobject mOutputStream;
     JNIEnv* mEnv;
     jbyteArray mByteArray;
+    size_t mBufferedCount;
 };
 
 JniOutputStream::JniOutputStream(JNIEnv* env, jobject outStream) : mOutputStream(outStream),
-        mEnv(env) {
+        mEnv(env), mBufferedCount(0) {
     mByteArray = env->NewByteArray(BYTE_ARRAY_LENGTH);
     if (mByteArray == nullptr) {
         jniThrowException(env, "java/lang/OutOfMemoryError", "Could not allocate byte array.");
@@ -348,30 +354,46 @@ status_t JniOutputStream::open() {
 
 status_t JniOutputStream::write(const uint8_t* buf, size_t offset, size_t count) {
     while(count > 0) {
-        size_t len = BYTE_ARRAY_LENGTH;
+        size_t len = BYTE_ARRAY_LENGTH - mBufferedCount;
         len = (count > len) ? len : count;
-        mEnv->SetByteArrayRegion(mByteArray, 0, len, reinterpret_cast<const jbyte*>(buf + offset));
+        mEnv->SetByteArrayRegion(mByteArray, mBufferedCount, len,
+                reinterpret_cast<const jbyte*>(buf + offset));
 
         if (mEnv->ExceptionCheck()) {
             return BAD_VALUE;
         }
 
-        mEnv->CallVoidMethod(mOutputStream, gOutputStreamClassInfo.mWriteMethod, mByteArray,
-                0, len);
+        mBufferedCount += len;
+        count -= len;
+        offset += len;
 
-        if (mEnv->ExceptionCheck()) {
-            return BAD_VALUE;
+        if (mBufferedCount == BYTE_ARRAY_LENGTH) {
+            status_t res = flush();
+            if (res != OK) {
+                return res;
+            }
         }
+    }
+    return OK;
+}
 
-        count -= len;
-        offset += len;
+status_t JniOutputStream::flush() {
+    if (mBufferedCount == 0) {
+        return OK;
+    }
+
+    mEnv->CallVoidMethod(mOutputStream, gOutputStreamClassInfo.mWriteMethod, mByteArray,
+            0, mBufferedCount);
+    mBufferedCount = 0;
+
+    if (mEnv->ExceptionCheck()) {
+        return BAD_VALUE;
     }
     return OK;
 }
 
 status_t JniOutputStream::close() {
-    // Do nothing
-    return OK;
+    return flush();
 }
 
 // End of JniOutputStream
@@ -2486,7 +2508,8 @@ static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outSt
         sources.add(&stripSource);
 
         status_t ret = OK;
-        if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK) {
+        if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK ||
+                (ret = out->flush()) != OK) {
             ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
             if (!env->ExceptionCheck()) {
                 jniThrowExceptionFmt(env, "java/io/IOException",
@@ -2503,7 +2526,8 @@ static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outSt
         sources.add(&stripSource);
 
         status_t ret = OK;
-        if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK) {
+        if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK ||
+                (ret = out->flush()) != OK) {
             ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
             if (!env->ExceptionCheck()) {
                 jniThrowExceptionFmt(env, "java/io/IOException",
@@ -2577,7 +2601,8 @@ static void DngCreator_nativeWriteInputStream(JNIEnv* env, jobject thiz, jobject
     sources.add(&stripSource);
 
     status_t ret = OK;
-    if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK) {
+    if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK ||
+            (ret = out->flush()) != OK) {
         ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
         if (!env->ExceptionCheck()) {
             jniThrowExceptionFmt(env, "java/io/IOException",
@@ -749,7 +749,8 @@ static jint android_media_AudioTrack_writeArray(JNIEnv *env, jobject thiz,
     jint samplesWritten = writeToTrack(lpTrack, javaAudioFormat, cAudioData,
             offsetInSamples, sizeInSamples, isWriteBlocking == JNI_TRUE /* blocking */);
 
-    envReleaseArrayElements(env, javaAudioData, cAudioData, 0);
+    // The audio data is only read, so don't copy it back into the java array.
+    envReleaseArrayElements(env, javaAudioData, cAudioData, JNI_ABORT);
 
     //ALOGV("write wrote %d (tried %d) samples in the native AudioTrack with offset %d",
     //        (int)samplesWritten, (int)(sizeInSamples), (int)offsetInSamples);
@@ -29,6 +29,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <string>
 #include <vector>
@@ -495,52 +496,35 @@ static void android_os_Debug_getDirtyPages(JNIEnv *env, jobject clazz, jobject o
 static jlong android_os_Debug_getPssPid(JNIEnv *env, jobject clazz, jint pid,
         jlongArray outUssSwapPssRss, jlongArray outMemtrack)
 {
-    jlong pss = 0;
-    jlong rss = 0;
-    jlong swapPss = 0;
-    jlong uss = 0;
-    jlong memtrack = 0;
+    // Read smaps_rollup (or smaps) first: it fails for processes that have exited since they
+    // were picked for sampling, which then don't cost a call into the memtrack HAL.
+    ::android::meminfo::ProcMemInfo proc_mem(pid);
+    ::android::meminfo::MemUsage stats;
+    if (!proc_mem.SmapsOrRollup(&stats)) {
+        return 0;
+    }
 
+    jlong memtrack = 0;
     struct graphics_memory_pss graphics_mem;
     if (read_memtrack_memory(pid, &graphics_mem) == 0) {
-        pss = uss = rss = memtrack = graphics_mem.graphics + graphics_mem.gl + graphics_mem.other;
+        memtrack = graphics_mem.graphics + graphics_mem.gl + graphics_mem.other;
     }
 
-    ::android::meminfo::ProcMemInfo proc_mem(pid);
-    ::android::meminfo::MemUsage stats;
-    if (proc_mem.SmapsOrRollup(&stats)) {
-        pss += stats.pss;
-        uss += stats.uss;
-        rss += stats.rss;
-        swapPss = stats.swap_pss;
-        pss += swapPss; // Also in swap, those pages would be accounted as Pss without SWAP
-    } else {
-        return 0;
-    }
+    jlong swapPss = stats.swap_pss;
+    // Also in swap, those pages would be accounted as Pss without SWAP
+    jlong pss = memtrack + stats.pss + swapPss;
+    jlong uss = memtrack + stats.uss;
+    jlong rss = memtrack + stats.rss;
 
     if (outUssSwapPssRss != NULL) {
-        if (env->GetArrayLength(outUssSwapPssRss) >= 1) {
-            jlong* outUssSwapPssRssArray = env->GetLongArrayElements(outUssSwapPssRss, 0);
-            if (outUssSwapPssRssArray != NULL) {
-                outUssSwapPssRssArray[0] = uss;
-                if (env->GetArrayLength(outUssSwapPssRss) >= 2) {
-                    outUssSwapPssRssArray[1] = swapPss;
-                }
-                if (env->GetArrayLength(outUssSwapPssRss) >= 3) {
-                    outUssSwapPssRssArray[2] = rss;
-                }
-            }
-            env->ReleaseLongArrayElements(outUssSwapPssRss, outUssSwapPssRssArray, 0);
-        }
+        const jlong ussSwapPssRss[] = { uss, swapPss, rss };
+        jsize len = std::min(env->GetArrayLength(outUssSwapPssRss), (jsize) 3);
+        env->SetLongArrayRegion(outUssSwapPssRss, 0, len, ussSwapPssRss);
     }
 
     if (outMemtrack != NULL) {
         if (env->GetArrayLength(outMemtrack) >= 1) {
-            jlong* outMemtrackArray = env->GetLongArrayElements(outMemtrack, 0);
-            if (outMemtrackArray != NULL) {
-                outMemtrackArray[0] = memtrack;
-            }
-            env->ReleaseLongArrayElements(outMemtrack, outMemtrackArray, 0);
+            env->SetLongArrayRegion(outMemtrack, 0, 1, &memtrack);
         }
     }
 
@@ -279,11 +279,18 @@ static void android_os_Parcel_writeString8(JNIEnv* env, jclass clazz, jlong nati
     if (parcel != NULL) {
         status_t err = NO_MEMORY;
         if (val) {
+            // Encode the string straight into the parcel, the way Parcel::writeString8() lays
+            // it out, rather than into a temporary copy that is then copied again.
             const size_t len = env->GetStringUTFLength(val);
-            const char* str = env->GetStringUTFChars(val, 0);
-            if (str) {
-                err = parcel->writeString8(str, len);
-                env->ReleaseStringUTFChars(val, str);
+            err = parcel->writeInt32(len);
+            if (err == NO_ERROR) {
+                char* dest = reinterpret_cast<char*>(parcel->writeInplace(len + 1));
+                if (dest) {
+                    env->GetStringUTFRegion(val, 0, env->GetStringLength(val), dest);
+                    dest[len] = '\0';
+                } else {
+                    err = NO_MEMORY;
+                }
             }
         } else {
             err = parcel->writeString8(NULL, 0);
@@ -300,11 +307,11 @@ static void android_os_Parcel_writeString16(JNIEnv* env, jclass clazz, jlong nat
     if (parcel != NULL) {
         status_t err = NO_MEMORY;
         if (val) {
+            // No JNI calls may be made while the string is held critical.
+            const jsize len = env->GetStringLength(val);
             const jchar* str = env->GetStringCritical(val, 0);
             if (str) {
-                err = parcel->writeString16(
-                    reinterpret_cast<const char16_t*>(str),
-                    env->GetStringLength(val));
+                err = parcel->writeString16(reinterpret_cast<const char16_t*>(str), len);
                 env->ReleaseStringCritical(val, str);
             }
         } else {
@@ -20,32 +20,26 @@
 #include <log/log.h>
 #include <nativehelper/JNIHelp.h>
 
+#include <algorithm>
 #include <array>
 
+#include "android_os_Trace.h"
+
 namespace android {
 
-inline static void sanitizeString(char* str) {
-    while (*str) {
-        char c = *str;
-        if (c == '\n' || c == '|') {
-            *str = ' ';
-        }
-        str++;
-    }
-}
+// Slice and counter names are truncated to this many UTF-16 characters.
+static constexpr jsize kMaxNameLength = 1024;
 
 template<typename F>
 inline static void withString(JNIEnv* env, jstring jstr, F callback) {
-    // We need to handle the worst case of 1 character -> 4 bytes
-    // So make a buffer of size 4097 and let it hold a string with a maximum length
-    // of 1024. The extra last byte for the null terminator.
-    std::array<char, 4097> buffer;
-    // We have no idea of knowing how much data GetStringUTFRegion wrote, so null it out in
-    // advance so we can have a reliable null terminator
-    memset(buffer.data(), 0, buffer.size());
-    jsize size = std::min(env->GetStringLength(jstr), 1024);
-    env->GetStringUTFRegion(jstr, 0, size, buffer.data());
-    sanitizeString(buffer.data());
+    // Read the characters and encode them in a single pass, so that the name is neither
+    // converted by the VM into a zeroed buffer nor scanned a second time. Each character takes at
+    // most 3 bytes, plus the null terminator.
+    std::array<jchar, kMaxNameLength> chars;
+    std::array<char, kMaxNameLength * 3 + 1> buffer;
+    jsize size = std::min(env->GetStringLength(jstr), kMaxNameLength);
+    env->GetStringRegion(jstr, 0, size, chars.data());
+    encodeTraceName(chars.data(), size, buffer.data());
 
     callback(buffer.data());
 }
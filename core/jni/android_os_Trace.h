@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_OS_TRACE_H
+#define ANDROID_OS_TRACE_H
+
+#include <jni.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Encodes UTF-16 characters as UTF-8, replacing the characters that would break the
+// trace_marker format with spaces. A surrogate pair becomes a single 4 byte sequence, while an
+// unpaired surrogate is encoded on its own, so each character takes at most 3 bytes. The output
+// is null terminated and the number of bytes written, excluding the terminator, is returned.
+inline size_t encodeTraceName(const jchar* chars, size_t size, char* out) {
+    char* start = out;
+    for (size_t i = 0; i < size; i++) {
+        uint32_t c = chars[i];
+        if (c >= 0xd800 && c < 0xdc00 && i + 1 < size && chars[i + 1] >= 0xdc00 &&
+            chars[i + 1] < 0xe000) {
+            c = 0x10000 + ((c - 0xd800) << 10) + (chars[++i] - 0xdc00);
+        }
+        if (c == '\n' || c == '|') {
+            *out++ = ' ';
+        } else if (c != 0 && c < 0x80) {
+            *out++ = static_cast<char>(c);
+        } else if (c < 0x800) {
+            *out++ = static_cast<char>(0xc0 | (c >> 6));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            *out++ = static_cast<char>(0xe0 | (c >> 12));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            *out++ = static_cast<char>(0xf0 | (c >> 18));
+            *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            *out++ = static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+    *out = '\0';
+    return out - start;
+}
+
+}  // namespace android
+
+#endif  // ANDROID_OS_TRACE_H
@@ -28,6 +28,7 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "android-base/logging.h"
 #include "android-base/properties.h"
@@ -777,10 +778,12 @@ static jintArray NativeGetStyleAttributes(JNIEnv* env, jclass /*clazz*/, jlong p
     return nullptr;
   }
 
+  // Copy the keys out in a single JNI call rather than one per entry.
+  std::vector<jint> attr_resids(bag->entry_count);
   for (uint32_t i = 0; i < bag->entry_count; i++) {
-    jint attr_resid = bag->entries[i].key;
-    env->SetIntArrayRegion(array, i, 1, &attr_resid);
+    attr_resids[i] = bag->entries[i].key;
   }
+  env->SetIntArrayRegion(array, 0, attr_resids.size(), attr_resids.data());
   return array;
 }
 
@@ -1175,14 +1178,10 @@ static jintArray NativeAttributeResolutionStack(
     return nullptr;
   }
 
-  for (uint32_t i = 0; i < style_stack.size(); i++) {
-    jint attr_resid = style_stack[i];
-    env->SetIntArrayRegion(array, i, 1, &attr_resid);
-  }
-  for (uint32_t i = 0; i < def_style_stack.size(); i++) {
-    jint attr_resid = def_style_stack[i];
-    env->SetIntArrayRegion(array, style_stack.size() + i, 1, &attr_resid);
-  }
+  env->SetIntArrayRegion(array, 0, style_stack.size(),
+                         reinterpret_cast<const jint*>(style_stack.data()));
+  env->SetIntArrayRegion(array, style_stack.size(), def_style_stack.size(),
+                         reinterpret_cast<const jint*>(def_style_stack.data()));
   return array;
 }
 
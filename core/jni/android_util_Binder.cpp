@@ -20,15 +20,21 @@
 #include "android_os_Parcel.h"
 #include "android_util_Binder.h"
 
+#include <algorithm>
 #include <atomic>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
+#include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <binder/BpBinder.h>
 #include <binder/IInterface.h>
@@ -45,6 +51,7 @@
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/SystemClock.h>
+#include <utils/Timers.h>
 #include <utils/threads.h>
 
 #include <nativehelper/JNIHelp.h>
@@ -331,6 +338,127 @@ static void report_exception(JNIEnv* env, jthrowable excep, const char* msg)
     }
 }
 
+// ----------------------------------------------------------------------------
+
+// Latency and request size histograms of the transactions handled by Java binders, kept while
+// the debug.binder.call_stats property is set when the process starts. They are appended to the
+// dumpsys output of the binder they were recorded for. Each thread records into a table of its
+// own, so binder threads never contend with each other; the tables are only merged on dump.
+namespace binder_call_stats {
+
+// Bucket i counts the values in [2^(i-1), 2^i), the last one everything above.
+static constexpr size_t kNumBuckets = 24;
+
+struct Entry {
+    uint64_t count = 0;
+    uint64_t totalUs = 0;
+    uint64_t maxUs = 0;
+    uint64_t latencyUs[kNumBuckets] = {};
+    uint64_t requestBytes[kNumBuckets] = {};
+
+    void merge(const Entry& other) {
+        count += other.count;
+        totalUs += other.totalUs;
+        maxUs = std::max(maxUs, other.maxUs);
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            latencyUs[i] += other.latencyUs[i];
+            requestBytes[i] += other.requestBytes[i];
+        }
+    }
+};
+
+struct ThreadTable {
+    // Only contended by dumps.
+    std::mutex lock;
+    // By interface id in the upper 32 bits and transaction code in the lower ones.
+    std::unordered_map<uint64_t, Entry> entries;
+};
+
+static std::mutex gLock;
+// The interface descriptors seen so far, by id.
+static std::vector<String16> gInterfaces;
+static std::vector<std::shared_ptr<ThreadTable>> gThreadTables;
+
+static bool enabled() {
+    static const bool enabled = base::GetBoolProperty("debug.binder.call_stats", false);
+    return enabled;
+}
+
+static uint32_t interfaceId(const String16& descriptor) {
+    std::lock_guard<std::mutex> lock(gLock);
+    auto it = std::find(gInterfaces.begin(), gInterfaces.end(), descriptor);
+    if (it != gInterfaces.end()) {
+        return it - gInterfaces.begin();
+    }
+    gInterfaces.push_back(descriptor);
+    return gInterfaces.size() - 1;
+}
+
+static size_t bucket(uint64_t value) {
+    const size_t bits = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return std::min(bits, kNumBuckets - 1);
+}
+
+static void record(uint32_t interface, uint32_t code, uint64_t latencyUs, size_t requestBytes) {
+    thread_local std::shared_ptr<ThreadTable> table = [] {
+        auto table = std::make_shared<ThreadTable>();
+        std::lock_guard<std::mutex> lock(gLock);
+        gThreadTables.push_back(table);
+        return table;
+    }();
+
+    std::lock_guard<std::mutex> lock(table->lock);
+    Entry& entry = table->entries[(uint64_t(interface) << 32) | code];
+    entry.count++;
+    entry.totalUs += latencyUs;
+    entry.maxUs = std::max(entry.maxUs, latencyUs);
+    entry.latencyUs[bucket(latencyUs)]++;
+    entry.requestBytes[bucket(requestBytes)]++;
+}
+
+static void dumpBuckets(int fd, const char* name, const uint64_t (&buckets)[kNumBuckets]) {
+    dprintf(fd, "    %s:", name);
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        if (i == kNumBuckets - 1) {
+            dprintf(fd, " >=%" PRIu64 ":%" PRIu64, uint64_t(1) << (i - 1), buckets[i]);
+        } else {
+            dprintf(fd, " <%" PRIu64 ":%" PRIu64, uint64_t(1) << i, buckets[i]);
+        }
+    }
+    dprintf(fd, "\n");
+}
+
+static void dump(int fd, uint32_t interface) {
+    std::vector<std::shared_ptr<ThreadTable>> tables;
+    {
+        std::lock_guard<std::mutex> lock(gLock);
+        tables = gThreadTables;
+    }
+
+    std::map<uint32_t, Entry> entries;
+    for (const auto& table : tables) {
+        std::lock_guard<std::mutex> lock(table->lock);
+        for (const auto& [key, entry] : table->entries) {
+            if ((key >> 32) == interface) {
+                entries[uint32_t(key)].merge(entry);
+            }
+        }
+    }
+
+    dprintf(fd, "\nBinder call stats (debug.binder.call_stats):\n");
+    for (const auto& [code, entry] : entries) {
+        dprintf(fd, "  code %" PRIu32 ": count=%" PRIu64 " avg=%" PRIu64 "us max=%" PRIu64 "us\n",
+                code, entry.count, entry.totalUs / entry.count, entry.maxUs);
+        dumpBuckets(fd, "latency us", entry.latencyUs);
+        dumpBuckets(fd, "request bytes", entry.requestBytes);
+    }
+}
+
+} // namespace binder_call_stats
+
 class JavaBBinderHolder;
 
 class JavaBBinder : public BBinder
@@ -397,6 +525,9 @@ protected:
         IPCThreadState* thread_state = IPCThreadState::self();
         const int32_t strict_policy_before = thread_state->getStrictModePolicy();
 
+        const bool record_stats = binder_call_stats::enabled();
+        const nsecs_t start_time = record_stats ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+
         //printf("Transact from %p to Java code sending: ", this);
         //data.print();
         //printf("\n");
@@ -431,6 +562,20 @@ protected:
             BBinder::onTransact(code, data, reply, flags);
         }
 
+        if (record_stats) {
+            const uint32_t interface = statsInterfaceId();
+            binder_call_stats::record(interface, code,
+                    ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - start_time), data.dataSize());
+            if (code == DUMP_TRANSACTION) {
+                // Append to what the Java binder dumped to the fd that starts the request.
+                data.setDataPosition(0);
+                const int fd = data.readFileDescriptor();
+                if (fd >= 0) {
+                    binder_call_stats::dump(fd, interface);
+                }
+            }
+        }
+
         //aout << "onTransact to Java code; result=" << res << endl
         //    << "Transact from " << this << " to Java code returning "
         //    << reply << ": " << *reply << endl;
@@ -443,11 +588,21 @@ protected:
     }
 
 private:
+    uint32_t statsInterfaceId() {
+        call_once(mPopulateStatsInterfaceId, [this] {
+            mStatsInterfaceId = binder_call_stats::interfaceId(getInterfaceDescriptor());
+        });
+        return mStatsInterfaceId;
+    }
+
     JavaVM* const   mVM;
     jobject const   mObject;  // GlobalRef to Java Binder
 
     mutable std::once_flag mPopulateDescriptor;
     mutable String16 mDescriptor;
+
+    std::once_flag mPopulateStatsInterfaceId;
+    uint32_t mStatsInterfaceId = 0;
 };
 
 // ----------------------------------------------------------------------------
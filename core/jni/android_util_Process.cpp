@@ -34,7 +34,9 @@
 #include <array>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "core_jni_helpers.h"
@@ -79,6 +81,20 @@ static constexpr ssize_t kProcReadStackBufferSize = 1024;
 // this size and retry until the whole file fits.
 static constexpr ssize_t kProcReadMinHeapBufferSize = 4096;
 
+// Number of proc files readProcFile() keeps open between calls.  The
+// same /proc/pid/stat files are polled every few seconds for every
+// process, so this covers the usual process count while staying far
+// from the fd limit; the cache is simply dropped once it fills up.
+static constexpr size_t kMaxCachedProcFiles = 1024;
+
+// Most format arrays passed to parseProcLineArray() describe a single
+// stat line, so they are copied to the stack below this many fields.
+static constexpr jsize kProcFormatStackSize = 64;
+
+// Open fds of the proc files read by readProcFile(), by path.
+static std::mutex gProcFilesLock;
+static std::unordered_map<std::string, std::shared_ptr<::android::base::unique_fd>> gProcFiles;
+
 #if GUARD_THREAD_PRIORITY
 Mutex gKeyCreateMutex;
 static pthread_key_t gBgKey = -1;
@@ -906,16 +922,21 @@ jboolean android_os_Process_parseProcLineArray(JNIEnv* env, jobject clazz,
     const jsize NL = outLongs ? env->GetArrayLength(outLongs) : 0;
     const jsize NR = outFloats ? env->GetArrayLength(outFloats) : 0;
 
-    jint* formatData = env->GetIntArrayElements(format, 0);
+    // The format is only read, so copy it rather than pinning it and
+    // copying it back when done.
+    jint formatStack[kProcFormatStackSize];
+    std::unique_ptr<jint[]> formatHeap;
+    jint* formatData = formatStack;
+    if (NF > kProcFormatStackSize) {
+        formatHeap.reset(new jint[NF]);
+        formatData = formatHeap.get();
+    }
+    env->GetIntArrayRegion(format, 0, NF, formatData);
     jlong* longsData = outLongs ?
         env->GetLongArrayElements(outLongs, 0) : NULL;
     jfloat* floatsData = outFloats ?
         env->GetFloatArrayElements(outFloats, 0) : NULL;
-    if (formatData == NULL || (NL > 0 && longsData == NULL)
-            || (NR > 0 && floatsData == NULL)) {
-        if (formatData != NULL) {
-            env->ReleaseIntArrayElements(format, formatData, 0);
-        }
+    if ((NL > 0 && longsData == NULL) || (NR > 0 && floatsData == NULL)) {
         if (longsData != NULL) {
             env->ReleaseLongArrayElements(outLongs, longsData, 0);
         }
@@ -1009,7 +1030,6 @@ jboolean android_os_Process_parseProcLineArray(JNIEnv* env, jobject clazz,
         }
     }
 
-    env->ReleaseIntArrayElements(format, formatData, 0);
     if (longsData != NULL) {
         env->ReleaseLongArrayElements(outLongs, longsData, 0);
     }
@@ -1035,6 +1055,27 @@ jboolean android_os_Process_parseProcLine(JNIEnv* env, jobject clazz,
         return result;
 }
 
+// Opens a file for readProcFile(), keeping its fd for later reads if
+// it lives in /proc.  Other files may be replaced between reads.
+static std::shared_ptr<::android::base::unique_fd> openProcFile(const std::string& path)
+{
+    auto fd = std::make_shared<::android::base::unique_fd>(
+            open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (path.compare(0, 6, "/proc/") != 0) {
+        return fd->ok() ? fd : nullptr;
+    }
+    std::lock_guard<std::mutex> lock(gProcFilesLock);
+    if (!fd->ok()) {
+        gProcFiles.erase(path);
+        return nullptr;
+    }
+    if (gProcFiles.size() >= kMaxCachedProcFiles) {
+        gProcFiles.clear();
+    }
+    gProcFiles[path] = fd;
+    return fd;
+}
+
 jboolean android_os_Process_readProcFile(JNIEnv* env, jobject clazz,
         jstring file, jintArray format, jobjectArray outStrings,
         jlongArray outLongs, jfloatArray outFloats)
@@ -1049,16 +1090,32 @@ jboolean android_os_Process_readProcFile(JNIEnv* env, jobject clazz,
         jniThrowException(env, "java/lang/OutOfMemoryError", NULL);
         return JNI_FALSE;
     }
+    const std::string path(file8);
+    env->ReleaseStringUTFChars(file, file8);
 
-    ::android::base::unique_fd fd(open(file8, O_RDONLY | O_CLOEXEC));
-    if (!fd.ok()) {
+    // Reuse the fd kept from an earlier read of the file.  An fd of a
+    // /proc/pid file keeps referring to the process it was opened for,
+    // so once the read through it fails, e.g. because that process has
+    // died, the file is opened again in case the pid has been reused.
+    std::shared_ptr<::android::base::unique_fd> fd;
+    {
+        std::lock_guard<std::mutex> lock(gProcFilesLock);
+        auto it = gProcFiles.find(path);
+        if (it != gProcFiles.end()) {
+            fd = it->second;
+        }
+    }
+    bool opened = false;
+    if (fd == nullptr) {
+        fd = openProcFile(path);
+        opened = true;
+    }
+    if (fd == nullptr) {
         if (kDebugProc) {
-            ALOGW("Unable to open process file: %s\n", file8);
+            ALOGW("Unable to open process file: %s\n", path.c_str());
         }
-        env->ReleaseStringUTFChars(file, file8);
         return JNI_FALSE;
     }
-    env->ReleaseStringUTFChars(file, file8);
 
     // Most proc files we read are small, so we only go through the
     // loop once and use the stack buffer.  We allocate a buffer big
@@ -1072,13 +1129,20 @@ jboolean android_os_Process_readProcFile(JNIEnv* env, jobject clazz,
     for (;;) {
         // By using pread, we can avoid an lseek to rewind the FD
         // before retry, saving a system call.
-        numberBytesRead = pread(fd, readBuffer, readBufferSize, 0);
+        numberBytesRead = pread(*fd, readBuffer, readBufferSize, 0);
         if (numberBytesRead < 0 && errno == EINTR) {
             continue;
         }
-        if (numberBytesRead < 0) {
+        if (numberBytesRead < 0 && !opened) {
+            fd = openProcFile(path);
+            opened = true;
+            if (fd != nullptr) {
+                continue;
+            }
+        }
+        if (numberBytesRead < 0 || fd == nullptr) {
             if (kDebugProc) {
-                ALOGW("Unable to open process file: %s fd=%d\n", file8, fd.get());
+                ALOGW("Unable to open process file: %s\n", path.c_str());
             }
             return JNI_FALSE;
         }
@@ -1087,7 +1151,7 @@ jboolean android_os_Process_readProcFile(JNIEnv* env, jobject clazz,
         }
         if (readBufferSize > std::numeric_limits<ssize_t>::max() / 2) {
             if (kDebugProc) {
-                ALOGW("Proc file too big: %s fd=%d\n", file8, fd.get());
+                ALOGW("Proc file too big: %s fd=%d\n", path.c_str(), fd->get());
             }
             return JNI_FALSE;
         }
@@ -27,6 +27,8 @@
 
 #include <stdio.h>
 
+#include <memory>
+
 namespace android {
 
 // ----------------------------------------------------------------------------
@@ -49,9 +51,11 @@ static jlong android_content_XmlBlock_nativeCreate(JNIEnv* env, jobject clazz,
     jbyte* b = env->GetByteArrayElements(bArray, NULL);
     ResXMLTree* osb = new ResXMLTree();
     osb->setTo(b+off, len, true);
-    env->ReleaseByteArrayElements(bArray, b, 0);
+    // The tree keeps a copy of the data, nothing needs to be written back.
+    env->ReleaseByteArrayElements(bArray, b, JNI_ABORT);
 
     if (osb->getError() != NO_ERROR) {
+        delete osb;
         jniThrowException(env, "java/lang/IllegalArgumentException", NULL);
         return 0;
     }
@@ -265,25 +269,36 @@ static jint android_content_XmlBlock_nativeGetAttributeIndex(JNIEnv* env, jobjec
         return 0;
     }
 
+    // Attribute names are short, so they are copied into stack buffers instead of having the
+    // VM hand out a copy of each string.
+    static constexpr jsize kStackNameLength = 64;
+    char16_t nsStack[kStackNameLength];
+    char16_t nameStack[kStackNameLength];
+    std::unique_ptr<char16_t[]> nsHeap;
+    std::unique_ptr<char16_t[]> nameHeap;
+
     const char16_t* ns16 = NULL;
     jsize nsLen = 0;
     if (ns) {
-        ns16 = reinterpret_cast<const char16_t*>(env->GetStringChars(ns, NULL));
         nsLen = env->GetStringLength(ns);
+        char16_t* buf = nsStack;
+        if (nsLen > kStackNameLength) {
+            nsHeap.reset(new char16_t[nsLen]);
+            buf = nsHeap.get();
+        }
+        env->GetStringRegion(ns, 0, nsLen, reinterpret_cast<jchar*>(buf));
+        ns16 = buf;
     }
 
-    const char16_t* name16 = reinterpret_cast<const char16_t*>(
-        env->GetStringChars(name, NULL));
-    jsize nameLen = env->GetStringLength(name);
-
-    jint idx = static_cast<jint>(st->indexOfAttribute(ns16, nsLen, name16, nameLen));
-
-    if (ns) {
-        env->ReleaseStringChars(ns, reinterpret_cast<const jchar*>(ns16));
+    const jsize nameLen = env->GetStringLength(name);
+    char16_t* name16 = nameStack;
+    if (nameLen > kStackNameLength) {
+        nameHeap.reset(new char16_t[nameLen]);
+        name16 = nameHeap.get();
     }
-    env->ReleaseStringChars(name, reinterpret_cast<const jchar*>(name16));
+    env->GetStringRegion(name, 0, nameLen, reinterpret_cast<jchar*>(name16));
 
-    return idx;
+    return static_cast<jint>(st->indexOfAttribute(ns16, nsLen, name16, nameLen));
 }
 
 static jint android_content_XmlBlock_nativeGetIdAttribute(JNIEnv* env, jobject clazz,
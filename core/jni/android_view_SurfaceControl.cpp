@@ -548,10 +548,15 @@ static void nativeSetColor(JNIEnv* env, jclass clazz, jlong transactionObj,
     auto transaction = reinterpret_cast<SurfaceComposerClient::Transaction*>(transactionObj);
     SurfaceControl* const ctrl = reinterpret_cast<SurfaceControl *>(nativeObject);
 
-    float* floatColors = env->GetFloatArrayElements(fColor, 0);
+    // Setters run for every layer of every animation frame, so read the values into the stack
+    // rather than pin or copy the whole array and write it back.
+    float floatColors[3];
+    env->GetFloatArrayRegion(fColor, 0, 3, floatColors);
+    if (env->ExceptionCheck()) {
+        return;
+    }
     half3 color(floatColors[0], floatColors[1], floatColors[2]);
     transaction->setColor(ctrl, color);
-    env->ReleaseFloatArrayElements(fColor, floatColors, 0);
 }
 
 static void nativeSetMatrix(JNIEnv* env, jclass clazz, jlong transactionObj,
@@ -567,13 +572,18 @@ static void nativeSetColorTransform(JNIEnv* env, jclass clazz, jlong transaction
         jlong nativeObject, jfloatArray fMatrix, jfloatArray fTranslation) {
     auto transaction = reinterpret_cast<SurfaceComposerClient::Transaction*>(transactionObj);
     SurfaceControl* const surfaceControl = reinterpret_cast<SurfaceControl*>(nativeObject);
-    float* floatMatrix = env->GetFloatArrayElements(fMatrix, 0);
+    float floatMatrix[9];
+    env->GetFloatArrayRegion(fMatrix, 0, 9, floatMatrix);
+    if (env->ExceptionCheck()) {
+        return;
+    }
+    float floatTranslation[3];
+    env->GetFloatArrayRegion(fTranslation, 0, 3, floatTranslation);
+    if (env->ExceptionCheck()) {
+        return;
+    }
     mat3 matrix(static_cast<float const*>(floatMatrix));
-    env->ReleaseFloatArrayElements(fMatrix, floatMatrix, 0);
-
-    float* floatTranslation = env->GetFloatArrayElements(fTranslation, 0);
     vec3 translation(floatTranslation[0], floatTranslation[1], floatTranslation[2]);
-    env->ReleaseFloatArrayElements(fTranslation, floatTranslation, 0);
 
     transaction->setColorTransform(surfaceControl, matrix, translation);
 }
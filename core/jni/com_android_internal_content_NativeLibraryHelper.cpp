@@ -37,7 +37,12 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 #define APK_LIB "lib/"
 #define APK_LIB_LEN (sizeof(APK_LIB) - 1)
@@ -171,56 +176,33 @@ sumFiles(JNIEnv*, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntry, const char
  * This function assumes the library and path names passed in are considered safe.
  */
 static install_status_t
-copyFileIfChanged(JNIEnv *env, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntry, const char* fileName)
+copyFileIfChanged(const char* nativeLibPath, ZipFileRO* zipFile, ZipEntryRO zipEntry,
+        const char* fileName)
 {
-    void** args = reinterpret_cast<void**>(arg);
-    jstring* javaNativeLibPath = (jstring*) args[0];
-    jboolean extractNativeLibs = *(jboolean*) args[1];
-
-    ScopedUtfChars nativeLibPath(env, *javaNativeLibPath);
+    const size_t nativeLibPathLen = strlen(nativeLibPath);
 
     uint32_t uncompLen;
     uint32_t when;
     uint32_t crc;
 
-    uint16_t method;
-    off64_t offset;
-
-    if (!zipFile->getEntryInfo(zipEntry, &method, &uncompLen, NULL, &offset, &when, &crc)) {
+    if (!zipFile->getEntryInfo(zipEntry, NULL, &uncompLen, NULL, NULL, &when, &crc)) {
         ALOGE("Couldn't read zip entry info\n");
         return INSTALL_FAILED_INVALID_APK;
     }
 
-    if (!extractNativeLibs) {
-        // check if library is uncompressed and page-aligned
-        if (method != ZipFileRO::kCompressStored) {
-            ALOGE("Library '%s' is compressed - will not be able to open it directly from apk.\n",
-                fileName);
-            return INSTALL_FAILED_INVALID_APK;
-        }
-
-        if (offset % PAGE_SIZE != 0) {
-            ALOGE("Library '%s' is not page-aligned - will not be able to open it directly from"
-                " apk.\n", fileName);
-            return INSTALL_FAILED_INVALID_APK;
-        }
-
-        return INSTALL_SUCCEEDED;
-    }
-
     // Build local file path
     const size_t fileNameLen = strlen(fileName);
-    char localFileName[nativeLibPath.size() + fileNameLen + 2];
+    char localFileName[nativeLibPathLen + fileNameLen + 2];
 
-    if (strlcpy(localFileName, nativeLibPath.c_str(), sizeof(localFileName)) != nativeLibPath.size()) {
+    if (strlcpy(localFileName, nativeLibPath, sizeof(localFileName)) != nativeLibPathLen) {
         ALOGE("Couldn't allocate local file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
 
-    *(localFileName + nativeLibPath.size()) = '/';
+    *(localFileName + nativeLibPathLen) = '/';
 
-    if (strlcpy(localFileName + nativeLibPath.size() + 1, fileName, sizeof(localFileName)
-                    - nativeLibPath.size() - 1) != fileNameLen) {
+    if (strlcpy(localFileName + nativeLibPathLen + 1, fileName, sizeof(localFileName)
+                    - nativeLibPathLen - 1) != fileNameLen) {
         ALOGE("Couldn't allocate local file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
@@ -234,14 +216,14 @@ copyFileIfChanged(JNIEnv *env, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntr
         return INSTALL_SUCCEEDED;
     }
 
-    char localTmpFileName[nativeLibPath.size() + TMP_FILE_PATTERN_LEN + 1];
-    if (strlcpy(localTmpFileName, nativeLibPath.c_str(), sizeof(localTmpFileName))
-            != nativeLibPath.size()) {
+    char localTmpFileName[nativeLibPathLen + TMP_FILE_PATTERN_LEN + 1];
+    if (strlcpy(localTmpFileName, nativeLibPath, sizeof(localTmpFileName))
+            != nativeLibPathLen) {
         ALOGE("Couldn't allocate local file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
 
-    if (strlcpy(localTmpFileName + nativeLibPath.size(), TMP_FILE_PATTERN,
+    if (strlcpy(localTmpFileName + nativeLibPathLen, TMP_FILE_PATTERN,
                     TMP_FILE_PATTERN_LEN + 1) != TMP_FILE_PATTERN_LEN) {
         ALOGE("Couldn't allocate temporary file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
@@ -293,6 +275,99 @@ copyFileIfChanged(JNIEnv *env, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntr
     return INSTALL_SUCCEEDED;
 }
 
+/*
+ * The libraries of the ABI to copy, collected while iterating over the APK so they can be
+ * extracted concurrently afterwards.
+ */
+struct NativeLibrariesToCopy {
+    jboolean extractNativeLibs;
+    // Full names of the entries under lib/<abi>/.
+    std::vector<std::string> entryNames;
+};
+
+static install_status_t
+collectFileToCopy(JNIEnv*, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntry,
+        const char* fileName)
+{
+    NativeLibrariesToCopy* libs = reinterpret_cast<NativeLibrariesToCopy*>(arg);
+
+    if (!libs->extractNativeLibs) {
+        uint16_t method;
+        off64_t offset;
+        if (!zipFile->getEntryInfo(zipEntry, &method, NULL, NULL, &offset, NULL, NULL)) {
+            ALOGE("Couldn't read zip entry info\n");
+            return INSTALL_FAILED_INVALID_APK;
+        }
+
+        // check if library is uncompressed and page-aligned
+        if (method != ZipFileRO::kCompressStored) {
+            ALOGE("Library '%s' is compressed - will not be able to open it directly from apk.\n",
+                fileName);
+            return INSTALL_FAILED_INVALID_APK;
+        }
+
+        if (offset % PAGE_SIZE != 0) {
+            ALOGE("Library '%s' is not page-aligned - will not be able to open it directly from"
+                " apk.\n", fileName);
+            return INSTALL_FAILED_INVALID_APK;
+        }
+
+        return INSTALL_SUCCEEDED;
+    }
+
+    char entryName[PATH_MAX];
+    if (zipFile->getEntryFileName(zipEntry, entryName, sizeof(entryName))) {
+        return INSTALL_FAILED_INVALID_APK;
+    }
+    libs->entryNames.emplace_back(entryName);
+    return INSTALL_SUCCEEDED;
+}
+
+/*
+ * Copies the libraries on up to kMaxCopyThreads threads, the calling one included. Libraries are
+ * written to files of their own and the APK is only read with pread, so they are independent.
+ * Returns the first failure seen, after which no more libraries are started.
+ */
+static install_status_t
+copyFilesIfChanged(const char* nativeLibPath, ZipFileRO* zipFile,
+        const std::vector<std::string>& entryNames)
+{
+    static constexpr size_t kMaxCopyThreads = 4;
+
+    std::atomic<size_t> next(0);
+    std::atomic<int> status(INSTALL_SUCCEEDED);
+    auto copyFiles = [&]() {
+        for (size_t i = next++; i < entryNames.size() && status == INSTALL_SUCCEEDED;
+                i = next++) {
+            const std::string& entryName = entryNames[i];
+            install_status_t ret = INSTALL_FAILED_INVALID_APK;
+            ZipEntryRO entry = zipFile->findEntryByName(entryName.c_str());
+            if (entry != NULL) {
+                const char* fileName = entryName.c_str() + entryName.rfind('/') + 1;
+                ret = copyFileIfChanged(nativeLibPath, zipFile, entry, fileName);
+                zipFile->releaseEntry(entry);
+            }
+            if (ret != INSTALL_SUCCEEDED) {
+                ALOGV("Failure for entry %s", entryName.c_str());
+                int expected = INSTALL_SUCCEEDED;
+                status.compare_exchange_strong(expected, ret);
+            }
+        }
+    };
+
+    const size_t numThreads = std::min({entryNames.size(), kMaxCopyThreads,
+            static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++) {
+        threads.emplace_back(copyFiles);
+    }
+    copyFiles();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<install_status_t>(status.load());
+}
+
 /*
  * An iterator over all shared libraries in a zip file. An entry is
  * considered to be a shared library if all of the conditions below are
@@ -488,9 +563,19 @@ com_android_internal_content_NativeLibraryHelper_copyNativeBinaries(JNIEnv *env,
         jlong apkHandle, jstring javaNativeLibPath, jstring javaCpuAbi,
         jboolean extractNativeLibs, jboolean debuggable)
 {
-    void* args[] = { &javaNativeLibPath, &extractNativeLibs };
-    return (jint) iterateOverNativeFiles(env, apkHandle, javaCpuAbi, debuggable,
-            copyFileIfChanged, reinterpret_cast<void*>(args));
+    NativeLibrariesToCopy libs = { extractNativeLibs, {} };
+    install_status_t ret = iterateOverNativeFiles(env, apkHandle, javaCpuAbi, debuggable,
+            collectFileToCopy, &libs);
+    if (ret != INSTALL_SUCCEEDED || libs.entryNames.empty()) {
+        return (jint) ret;
+    }
+
+    ScopedUtfChars nativeLibPath(env, javaNativeLibPath);
+    if (nativeLibPath.c_str() == NULL) {
+        return (jint) INSTALL_FAILED_INTERNAL_ERROR;
+    }
+    return (jint) copyFilesIfChanged(nativeLibPath.c_str(),
+            reinterpret_cast<ZipFileRO*>(apkHandle), libs.entryNames);
 }
 
 static jlong
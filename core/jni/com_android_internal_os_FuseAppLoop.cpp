@@ -29,7 +29,6 @@
 #include <jni.h>
 #include <libappfuse/FuseAppLoop.h>
 #include <nativehelper/ScopedLocalRef.h>
-#include <nativehelper/ScopedPrimitiveArray.h>
 
 #include "core_jni_helpers.h"
 
@@ -165,10 +164,16 @@ void com_android_internal_os_FuseAppLoop_replyWrite(
 
 void com_android_internal_os_FuseAppLoop_replyRead(
         JNIEnv* env, jobject self, jlong ptr, jlong unique, jint size, jbyteArray data) {
-    ScopedByteArrayRO array(env, data);
     CHECK_GE(size, 0);
-    CHECK_LE(static_cast<size_t>(size), array.size());
-    if (!reinterpret_cast<fuse::FuseAppLoop*>(ptr)->ReplyRead(unique, size, array.get())) {
+    CHECK_LE(size, env->GetArrayLength(data));
+    // The buffer is the whole per-file transfer buffer while a read usually fills only part of it,
+    // so write straight from the array instead of copying all of it out first. ReplyRead only
+    // writes the reply to the FUSE device, which does not block or call back into the VM.
+    void* bytes = env->GetPrimitiveArrayCritical(data, nullptr);
+    CHECK(bytes != nullptr);
+    const bool replied = reinterpret_cast<fuse::FuseAppLoop*>(ptr)->ReplyRead(unique, size, bytes);
+    env->ReleasePrimitiveArrayCritical(data, bytes, JNI_ABORT);
+    if (!replied) {
         reinterpret_cast<fuse::FuseAppLoop*>(ptr)->Break();
     }
 }
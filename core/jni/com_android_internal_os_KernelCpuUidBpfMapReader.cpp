@@ -43,14 +43,21 @@ static jlongArray getUidArray(JNIEnv *env, jobject sparseAr, uint32_t uid, jsize
     return ar;
 }
 
-static void copy2DVecToArray(JNIEnv *env, jlongArray ar, std::vector<std::vector<uint64_t>> &vec) {
-    jsize start = 0;
-    for (auto &subVec : vec) {
-        for (uint32_t i = 0; i < subVec.size(); ++i) subVec[i] /= NSEC_PER_MSEC;
-        env->SetLongArrayRegion(ar, start, subVec.size(),
-                                reinterpret_cast<const jlong *>(subVec.data()));
-        start += subVec.size();
+// Copies the times of a uid into its array with a single JNI call, converting them to
+// milliseconds. The times are flattened into flat, which is reused across uids.
+static bool copyTimesToUidArray(JNIEnv *env, jobject sparseAr, uint32_t uid,
+                                const std::vector<std::vector<uint64_t>> &vec,
+                                std::vector<jlong> &flat) {
+    flat.clear();
+    for (const auto &subVec : vec) {
+        for (uint64_t time : subVec) flat.push_back(time / NSEC_PER_MSEC);
     }
+    jlongArray ar = getUidArray(env, sparseAr, uid, flat.size());
+    if (ar == NULL) return false;
+    env->SetLongArrayRegion(ar, 0, flat.size(), flat.data());
+    // Many uids may be updated in one read, don't let their arrays fill the local ref table.
+    env->DeleteLocalRef(ar);
+    return true;
 }
 
 static jboolean KernelCpuUidFreqTimeBpfMapReader_removeUidRange(JNIEnv *env, jclass, jint startUid,
@@ -69,14 +76,9 @@ static jboolean KernelCpuUidFreqTimeBpfMapReader_readBpfData(JNIEnv *env, jobjec
     auto data = android::bpf::getUidsUpdatedCpuFreqTimes(&newLastUpdate);
     if (!data.has_value()) return false;
 
-    jsize s = 0;
-    for (auto &[uid, times] : *data) {
-        if (s == 0) {
-            for (const auto &subVec : times) s += subVec.size();
-        }
-        jlongArray ar = getUidArray(env, sparseAr, uid, s);
-        if (ar == NULL) return false;
-        copy2DVecToArray(env, ar, times);
+    std::vector<jlong> flat;
+    for (const auto &[uid, times] : *data) {
+        if (!copyTimesToUidArray(env, sparseAr, uid, times, flat)) return false;
     }
     lastUpdate = newLastUpdate;
     return true;
@@ -118,6 +120,7 @@ static jboolean KernelCpuUidActiveTimeBpfMapReader_readBpfData(JNIEnv *env, jobj
         if (ar == NULL) return false;
         env->SetLongArrayRegion(ar, 0, times.active.size(),
                                 reinterpret_cast<const jlong *>(times.active.data()));
+        env->DeleteLocalRef(ar);
     }
     lastUpdate = newLastUpdate;
     return true;
@@ -144,14 +147,9 @@ static jboolean KernelCpuUidClusterTimeBpfMapReader_readBpfData(JNIEnv *env, job
     auto data = android::bpf::getUidsUpdatedConcurrentTimes(&newLastUpdate);
     if (!data.has_value()) return false;
 
-    jsize s = 0;
-    for (auto &[uid, times] : *data) {
-        if (s == 0) {
-            for (const auto &subVec : times.policy) s += subVec.size();
-        }
-        jlongArray ar = getUidArray(env, sparseAr, uid, s);
-        if (ar == NULL) return false;
-        copy2DVecToArray(env, ar, times.policy);
+    std::vector<jlong> flat;
+    for (const auto &[uid, times] : *data) {
+        if (!copyTimesToUidArray(env, sparseAr, uid, times.policy, flat)) return false;
     }
     lastUpdate = newLastUpdate;
     return true;
@@ -17,6 +17,8 @@
 #include "fd_utils.h"
 
 #include <algorithm>
+#include <string_view>
+#include <unordered_set>
 
 #include <fcntl.h>
 #include <grp.h>
@@ -72,10 +74,11 @@ static bool IsArtMemfd(const std::string& path) {
 }
 
 bool FileDescriptorWhitelist::IsAllowed(const std::string& path) const {
-  // Check the static whitelist path.
-  for (const auto& whitelist_path : kPathWhitelist) {
-    if (path == whitelist_path)
-      return true;
+  // Check the static whitelist path, hashed once so that each check is a single lookup.
+  static const std::unordered_set<std::string_view> kPathWhitelistSet(
+      std::begin(kPathWhitelist), std::end(kPathWhitelist));
+  if (kPathWhitelistSet.count(path) != 0) {
+    return true;
   }
 
   // Check any paths added to the dynamic whitelist.
@@ -337,7 +340,14 @@ void FileDescriptorInfo::ReopenOrDetach(fail_fn_t fail_fn) const {
   // NOTE: This might happen if the file was unlinked after being opened.
   // It's a common pattern in the case of temporary files and the like but
   // we should not allow such usage from the zygote.
-  const int new_fd = TEMP_FAILURE_RETRY(open(file_path.c_str(), open_flags));
+  //
+  // This runs for every whitelisted fd on each fork, so syscalls that would not change anything
+  // are skipped: the descriptor flags of new_fd don't matter as it is only used as the source of
+  // dup3 below, which sets FD_CLOEXEC on fd itself, the usual status flags are passed to open(),
+  // and a file is only seeked when it was not at its start.
+  static const int kOpenStatusFlags = O_APPEND | O_NONBLOCK;
+  const int new_fd = TEMP_FAILURE_RETRY(
+      open(file_path.c_str(), open_flags | (fs_flags & kOpenStatusFlags) | O_CLOEXEC));
 
   if (new_fd == -1) {
     fail_fn(android::base::StringPrintf("Failed open(%s, %i): %s",
@@ -346,16 +356,10 @@ void FileDescriptorInfo::ReopenOrDetach(fail_fn_t fail_fn) const {
                                         strerror(errno)));
   }
 
-  if (TEMP_FAILURE_RETRY(fcntl(new_fd, F_SETFD, fd_flags)) == -1) {
-    close(new_fd);
-    fail_fn(android::base::StringPrintf("Failed fcntl(%d, F_SETFD, %d) (%s): %s",
-                                        new_fd,
-                                        fd_flags,
-                                        file_path.c_str(),
-                                        strerror(errno)));
-  }
-
-  if (TEMP_FAILURE_RETRY(fcntl(new_fd, F_SETFL, fs_flags)) == -1) {
+  // The status flags F_SETFL can set and open() was not given.
+  static const int kSetStatusFlags = O_ASYNC | O_DIRECT | O_NOATIME;
+  if ((fs_flags & kSetStatusFlags) != 0
+      && TEMP_FAILURE_RETRY(fcntl(new_fd, F_SETFL, fs_flags)) == -1) {
     close(new_fd);
     fail_fn(android::base::StringPrintf("Failed fcntl(%d, F_SETFL, %d) (%s): %s",
                                         new_fd,
@@ -364,7 +368,7 @@ void FileDescriptorInfo::ReopenOrDetach(fail_fn_t fail_fn) const {
                                         strerror(errno)));
   }
 
-  if (offset != -1 && TEMP_FAILURE_RETRY(lseek64(new_fd, offset, SEEK_SET)) == -1) {
+  if (offset > 0 && TEMP_FAILURE_RETRY(lseek64(new_fd, offset, SEEK_SET)) == -1) {
     close(new_fd);
     fail_fn(android::base::StringPrintf("Failed lseek64(%d, SEEK_SET) (%s): %s",
                                         new_fd,
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android_os_Trace.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+
+static std::string encode(const std::vector<jchar>& chars) {
+    std::vector<char> buffer(chars.size() * 3 + 1);
+    size_t length = encodeTraceName(chars.data(), chars.size(), buffer.data());
+    EXPECT_EQ(buffer[length], '\0');
+    return std::string(buffer.data(), length);
+}
+
+TEST(TraceNameTest, EncodesAscii) {
+    EXPECT_EQ(encode({'v', 'i', 'e', 'w'}), "view");
+}
+
+TEST(TraceNameTest, ReplacesMarkerSeparators) {
+    EXPECT_EQ(encode({'a', '|', 'b', '\n', 'c'}), "a b c");
+}
+
+TEST(TraceNameTest, EncodesBasicMultilingualPlane) {
+    // U+00E9 LATIN SMALL LETTER E WITH ACUTE, U+4E2D CJK UNIFIED IDEOGRAPH-4E2D
+    EXPECT_EQ(encode({0x00e9, 0x4e2d}), "\xc3\xa9\xe4\xb8\xad");
+}
+
+TEST(TraceNameTest, EncodesSurrogatePairAsOneSequence) {
+    // U+1F600 GRINNING FACE
+    EXPECT_EQ(encode({'a', 0xd83d, 0xde00, 'b'}), "a\xf0\x9f\x98\x80" "b");
+}
+
+TEST(TraceNameTest, EncodesUnpairedSurrogatesAlone) {
+    EXPECT_EQ(encode({0xd83d, 'a'}), "\xed\xa0\xbd" "a");
+    EXPECT_EQ(encode({0xde00}), "\xed\xb8\x80");
+    EXPECT_EQ(encode({0xd83d}), "\xed\xa0\xbd");
+}
+
+} // namespace android
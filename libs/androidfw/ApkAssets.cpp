@@ -16,7 +16,13 @@
 
 #include "androidfw/ApkAssets.h"
 
+#include <sys/stat.h>
+
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "android-base/errors.h"
 #include "android-base/file.h"
@@ -41,6 +47,48 @@ using base::unique_fd;
 
 static const std::string kResourcesArsc("resources.arsc");
 
+namespace {
+
+// Identifies an APK loaded through ApkAssets::LoadShared().
+struct SharedApkAssetsKey {
+  std::string path;
+  dev_t device;
+  ino_t inode;
+  time_t last_mod_time;
+  package_property_t flags;
+
+  bool operator==(const SharedApkAssetsKey& o) const {
+    return inode == o.inode && device == o.device && last_mod_time == o.last_mod_time &&
+           flags == o.flags && path == o.path;
+  }
+};
+
+struct SharedApkAssetsKeyHash {
+  size_t operator()(const SharedApkAssetsKey& key) const {
+    size_t hash = std::hash<std::string>()(key.path);
+    hash = hash * 31 + std::hash<uint64_t>()(static_cast<uint64_t>(key.inode));
+    hash = hash * 31 + std::hash<uint64_t>()(static_cast<uint64_t>(key.last_mod_time));
+    return hash * 31 + key.flags;
+  }
+};
+
+using SharedApkAssetsMap =
+    std::unordered_map<SharedApkAssetsKey, std::weak_ptr<const ApkAssets>, SharedApkAssetsKeyHash>;
+
+std::mutex& SharedApkAssetsLock() {
+  static std::mutex* lock = new std::mutex();
+  return *lock;
+}
+
+// Guarded by SharedApkAssetsLock(). Entries expire when the last reference to their ApkAssets is
+// released and are purged on the next insertion.
+SharedApkAssetsMap& SharedApkAssets() {
+  static SharedApkAssetsMap* shared_apk_assets = new SharedApkAssetsMap();
+  return *shared_apk_assets;
+}
+
+}  // namespace
+
 ApkAssets::ApkAssets(std::unique_ptr<const AssetsProvider> assets_provider,
                      std::string path,
                      time_t last_mod_time,
@@ -89,9 +137,8 @@ class ZipAssetsProvider : public AssetsProvider {
                                                                  unmanaged_handle));
   }
 
-  // Iterate over all files and directories within the zip. The order of iteration is not
-  // guaranteed to be the same as the order of elements in the central directory but is stable for a
-  // given zip file.
+  // Iterate over all files and directories within the zip. Files are visited in name order, which
+  // is not necessarily the order of elements in the central directory.
   bool ForEachFile(const std::string& root_path,
                    const std::function<void(const StringPiece&, FileType)>& f) const override {
     // If this is a resource loader from an .arsc, there will be no zip handle
@@ -104,21 +151,22 @@ class ZipAssetsProvider : public AssetsProvider {
       root_path_full += '/';
     }
 
-    void* cookie;
-    if (::StartIteration(zip_handle_.get(), &cookie, root_path_full, "") != 0) {
+    const std::vector<std::string>* entry_names = GetSortedEntryNames();
+    if (entry_names == nullptr) {
       return false;
     }
 
-    std::string name;
-    ::ZipEntry entry{};
-
     // We need to hold back directories because many paths will contain them and we want to only
     // surface one.
     std::set<std::string> dirs{};
 
-    int32_t result;
-    while ((result = ::Next(cookie, &entry, &name)) == 0) {
-      StringPiece full_file_path(name);
+    // The entries within `root_path_full` are contiguous in the sorted list of entry names.
+    for (auto name_iter =
+             std::lower_bound(entry_names->begin(), entry_names->end(), root_path_full);
+         name_iter != entry_names->end() &&
+         name_iter->compare(0, root_path_full.size(), root_path_full) == 0;
+         ++name_iter) {
+      StringPiece full_file_path(*name_iter);
       StringPiece leaf_file_path = full_file_path.substr(root_path_full.size());
 
       if (!leaf_file_path.empty()) {
@@ -132,15 +180,12 @@ class ZipAssetsProvider : public AssetsProvider {
         }
       }
     }
-    ::EndIteration(cookie);
 
     // Now present the unique directories.
     for (const std::string& dir : dirs) {
       f(dir, kFileTypeDirectory);
     }
-
-    // -1 is end of iteration, anything else is an error.
-    return result == -1;
+    return true;
   }
 
  protected:
@@ -221,10 +266,43 @@ class ZipAssetsProvider : public AssetsProvider {
     return path_.empty() ? nullptr : path_.c_str();
   }
 
+  // Returns the sorted names of all the entries of the zip, or nullptr if the central directory
+  // could not be read. The names are only read from the central directory once, so that listing
+  // the files of a directory does not scan the whole central directory every time.
+  const std::vector<std::string>* GetSortedEntryNames() const {
+    std::call_once(entry_names_read_, [&]() {
+      void* cookie;
+      if (::StartIteration(zip_handle_.get(), &cookie, "", "") != 0) {
+        return;
+      }
+
+      std::vector<std::string> entry_names;
+      std::string name;
+      ::ZipEntry entry{};
+      int32_t result;
+      while ((result = ::Next(cookie, &entry, &name)) == 0) {
+        entry_names.push_back(name);
+      }
+      ::EndIteration(cookie);
+
+      // -1 is end of iteration, anything else is an error.
+      if (result == -1) {
+        std::sort(entry_names.begin(), entry_names.end());
+        entry_names_ = std::move(entry_names);
+        entry_names_valid_ = true;
+      }
+    });
+    return entry_names_valid_ ? &entry_names_ : nullptr;
+  }
+
   using ZipArchivePtr = std::unique_ptr<ZipArchive, void (*)(ZipArchiveHandle)>;
   ZipArchivePtr zip_handle_;
   std::string path_;
   std::string friendly_name_;
+
+  mutable std::once_flag entry_names_read_;
+  mutable std::vector<std::string> entry_names_;
+  mutable bool entry_names_valid_ = false;
 };
 
 class DirectoryAssetsProvider : AssetsProvider {
@@ -339,6 +417,80 @@ std::unique_ptr<const ApkAssets> ApkAssets::Load(
                   : nullptr;
 }
 
+std::shared_ptr<const ApkAssets> ApkAssets::LoadShared(const std::string& path,
+                                                       const package_property_t flags) {
+  if ((flags & PROPERTY_LOADER) != 0U) {
+    return Load(path, flags);
+  }
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    LOG(ERROR) << "Failed to stat file '" << path << "': " << SystemErrorCodeToString(errno);
+    return {};
+  }
+
+  SharedApkAssetsKey key{path, st.st_dev, st.st_ino, st.st_mtime, flags};
+  {
+    std::lock_guard<std::mutex> lock(SharedApkAssetsLock());
+    auto iter = SharedApkAssets().find(key);
+    if (iter != SharedApkAssets().end()) {
+      if (std::shared_ptr<const ApkAssets> apk_assets = iter->second.lock()) {
+        return apk_assets;
+      }
+    }
+  }
+
+  // Load without holding the lock so that different APKs can be loaded concurrently.
+  std::shared_ptr<const ApkAssets> apk_assets = Load(path, flags);
+  if (apk_assets == nullptr) {
+    return {};
+  }
+
+  std::lock_guard<std::mutex> lock(SharedApkAssetsLock());
+  SharedApkAssetsMap& shared_apk_assets = SharedApkAssets();
+  for (auto iter = shared_apk_assets.begin(); iter != shared_apk_assets.end();) {
+    if (iter->second.expired()) {
+      iter = shared_apk_assets.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  // Another thread may have loaded the same APK in the meantime. Prefer its instance so that
+  // every caller shares a single ApkAssets.
+  std::weak_ptr<const ApkAssets>& entry = shared_apk_assets[std::move(key)];
+  if (std::shared_ptr<const ApkAssets> existing = entry.lock()) {
+    return existing;
+  }
+  entry = apk_assets;
+  return apk_assets;
+}
+
+std::vector<std::shared_ptr<const ApkAssets>> ApkAssets::LoadAllShared(
+    const std::vector<std::string>& paths, const package_property_t flags) {
+  std::vector<std::shared_ptr<const ApkAssets>> apk_assets(paths.size());
+  std::atomic<size_t> next_path(0);
+  auto worker = [&]() {
+    for (size_t i = next_path++; i < paths.size(); i = next_path++) {
+      apk_assets[i] = LoadShared(paths[i], flags);
+    }
+  };
+
+  // Loading is mostly spent reading and parsing the zip central directory and resources.arsc of
+  // each APK, which do not depend on each other. The calling thread loads APKs as well.
+  const size_t thread_count =
+      std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), paths.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return apk_assets;
+}
+
 // Opens the archive using the file file descriptor with the specified file offset and read length.
 // If the `assume_ownership` parameter is 'true' calling CloseArchive will close the file.
 std::unique_ptr<const ApkAssets> ApkAssets::LoadFromFd(
@@ -501,8 +653,14 @@ std::unique_ptr<const ApkAssets> ApkAssets::LoadImpl(
     return {};
   }
 
-  loaded_apk->loaded_arsc_ = LoadedArsc::Load(data, loaded_apk->loaded_idmap_.get(),
-                                              property_flags);
+  // Most processes only look up a small part of large tables such as the framework's, so the
+  // type chunks of system APKs are only indexed when the type is first used. Lazily loaded types
+  // skip malformed chunks instead of failing the load, so every other APK is still fully
+  // validated up front.
+  const package_property_t arsc_flags = (property_flags & PROPERTY_SYSTEM) != 0U
+                                            ? property_flags | PROPERTY_LAZY_TYPES
+                                            : property_flags;
+  loaded_apk->loaded_arsc_ = LoadedArsc::Load(data, loaded_apk->loaded_idmap_.get(), arsc_flags);
   if (!loaded_apk->loaded_arsc_) {
     LOG(ERROR) << "Failed to load '" << kResourcesArsc << "' in APK '" << path << "'.";
     return {};
@@ -833,6 +833,32 @@ status_t _CompressedAsset::openChunk(FileMap* dataMap, size_t uncompressedLen)
     return NO_ERROR;
 }
 
+/*
+ * Expand all of the compressed data into "buf", which must hold
+ * mUncompressedLen bytes.
+ */
+bool _CompressedAsset::inflateTo(unsigned char* buf)
+{
+    if (mMap != NULL) {
+        return ZipUtils::inflateToBuffer(mMap->getDataPtr(), buf,
+                mUncompressedLen, mCompressedLen);
+    }
+
+    assert(mFd >= 0);
+
+    /*
+     * Seek to the start of the compressed data.
+     */
+    if (lseek(mFd, mStart, SEEK_SET) != mStart)
+        return false;
+
+    /*
+     * Expand the data into it.
+     */
+    return ZipUtils::inflateToBuffer(mFd, buf, mUncompressedLen,
+            mCompressedLen);
+}
+
 /*
  * Read data from a chunk of compressed data.
  *
@@ -850,6 +876,16 @@ ssize_t _CompressedAsset::read(void* buf, size_t count)
         actual = mZipInflater->read(buf, count);
     } else {
         if (mBuf == NULL) {
+            /*
+             * Reading the whole asset from the start is the common case; expand it
+             * straight into the caller's buffer rather than into one of our own.
+             */
+            if (mOffset == 0 && count >= (size_t) mUncompressedLen) {
+                if (!inflateTo((unsigned char*) buf))
+                    return -1;
+                mOffset = mUncompressedLen;
+                return mUncompressedLen;
+            }
             if (getBuffer(false) == NULL)
                 return -1;
         }
@@ -940,26 +976,8 @@ const void* _CompressedAsset::getBuffer(bool)
         goto bail;
     }
 
-    if (mMap != NULL) {
-        if (!ZipUtils::inflateToBuffer(mMap->getDataPtr(), buf,
-                mUncompressedLen, mCompressedLen))
-            goto bail;
-    } else {
-        assert(mFd >= 0);
-
-        /*
-         * Seek to the start of the compressed data.
-         */
-        if (lseek(mFd, mStart, SEEK_SET) != mStart)
-            goto bail;
-
-        /*
-         * Expand the data into it.
-         */
-        if (!ZipUtils::inflateToBuffer(mFd, buf, mUncompressedLen,
-                mCompressedLen))
-            goto bail;
-    }
+    if (!inflateTo(buf))
+        goto bail;
 
     /*
      * Success - now that we have the full asset in RAM we
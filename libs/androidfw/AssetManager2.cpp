@@ -38,33 +38,14 @@
 
 namespace android {
 
-struct FindEntryResult {
-  // A pointer to the resource table entry for this resource.
-  // If the size of the entry is > sizeof(ResTable_entry), it can be cast to
-  // a ResTable_map_entry and processed as a bag/map.
-  ResTable_entry_handle entry;
-
-  // The configuration for which the resulting entry was defined. This is already swapped to host
-  // endianness.
-  ResTable_config config;
-
-  // The bitmask of configuration axis with which the resource value varies.
-  uint32_t type_flags;
-
-  // The dynamic package ID map for the package from which this resource came from.
-  const DynamicRefTable* dynamic_ref_table;
-
-  // The package name of the resource.
-  const std::string* package_name;
+namespace {
 
-  // The string pool reference to the type's name. This uses a different string pool than
-  // the global string pool, but this is hidden from the caller.
-  StringPoolRef type_string_ref;
+// Builds the key of a resolved entry in AssetManager2::cached_entries_.
+inline uint64_t MakeEntryCacheKey(uint32_t resid, uint16_t density_override) {
+  return (static_cast<uint64_t>(density_override) << 32) | resid;
+}
 
-  // The string pool reference to the entry's name. This uses a different string pool than
-  // the global string pool, but this is hidden from the caller.
-  StringPoolRef entry_string_ref;
-};
+}  // namespace
 
 AssetManager2::AssetManager2() {
   memset(&configuration_, 0, sizeof(configuration_));
@@ -73,6 +54,11 @@ AssetManager2::AssetManager2() {
 bool AssetManager2::SetApkAssets(const std::vector<const ApkAssets*>& apk_assets,
                                  bool invalidate_caches, bool filter_incompatible_configs) {
   apk_assets_ = apk_assets;
+
+  // Resolved entries point into the package groups and cookies rebuilt below, so they can never
+  // outlive a change of the ApkAssets set.
+  cached_entries_.clear();
+  cached_themes_.clear();
   BuildDynamicRefTable();
   RebuildFilterList(filter_incompatible_configs);
   if (invalidate_caches) {
@@ -341,7 +327,11 @@ void AssetManager2::SetConfiguration(const ResTable_config& configuration) {
   configuration_ = configuration;
 
   if (diff) {
-    RebuildFilterList();
+    if (filtered_incompatible_configs_) {
+      RebuildFilterList(static_cast<uint32_t>(diff));
+    } else {
+      RebuildFilterList();
+    }
     InvalidateCaches(static_cast<uint32_t>(diff));
   }
 }
@@ -513,12 +503,29 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
     last_resolution_.resid = resid;
   }
 
+  // An override equal to the configured density selects the same entry as no override at all.
+  if (density_override == configuration_.density) {
+    density_override = 0u;
+  }
+
+  // Resolved entries are only valid for the current configuration. Bypass the cache when the
+  // steps taken to resolve the resource must be recorded.
+  const bool use_cache = !ignore_configuration && !resource_resolution_logging_enabled_;
+  const uint64_t cache_key = MakeEntryCacheKey(resid, density_override);
+  if (use_cache) {
+    auto cached_iter = cached_entries_.find(cache_key);
+    if (cached_iter != cached_entries_.end()) {
+      *out_entry = cached_iter->second.result;
+      return cached_iter->second.cookie;
+    }
+  }
+
   // Might use this if density_override != 0.
   ResTable_config density_override_config;
 
   // Select our configuration or generate a density override configuration.
   const ResTable_config* desired_config = &configuration_;
-  if (density_override != 0 && density_override != configuration_.density) {
+  if (density_override != 0) {
     density_override_config = configuration_;
     density_override_config.density = density_override;
     desired_config = &density_override_config;
@@ -548,6 +555,7 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
     return kInvalidCookie;
   }
 
+  uint32_t cache_type_flags = out_entry->type_flags;
   if (!apk_assets_[cookie]->IsLoader()) {
     for (const auto& id_map : package_group.overlays_) {
       auto overlay_entry = id_map.overlay_res_maps_.Lookup(resid);
@@ -572,6 +580,9 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
         continue;
       }
 
+      // The overlay may vary with configuration axis that the target does not.
+      cache_type_flags |= overlay_result.type_flags;
+
       if (!overlay_result.config.isBetterThan(out_entry->config, desired_config)
           && overlay_result.config.compare(out_entry->config) != 0) {
         // The configuration of the entry for the overlay must be equal to or better than the target
@@ -597,6 +608,9 @@ ApkAssetsCookie AssetManager2::FindEntry(uint32_t resid, uint16_t density_overri
     last_resolution_.entry_string_ref = out_entry->entry_string_ref;
   }
 
+  if (use_cache) {
+    cached_entries_[cache_key] = CachedEntry{cookie, *out_entry, cache_type_flags};
+  }
   return cookie;
 }
 
@@ -640,7 +654,8 @@ ApkAssetsCookie AssetManager2::FindEntryInternal(const PackageGroup& package_gro
     type_flags |= type_spec->GetFlagsForEntryIndex(entry_idx);
 
     if (use_fast_path) {
-      const FilteredConfigGroup& filtered_group = loaded_package_impl.filtered_configs_[type_idx];
+      const FilteredConfigGroup& filtered_group =
+          GetFilteredConfigGroup(loaded_package_impl, type_spec, type_idx);
       const std::vector<ResTable_config>& candidate_configs = filtered_group.configurations;
       const size_t type_count = candidate_configs.size();
       for (uint32_t i = 0; i < type_count; i++) {
@@ -1264,28 +1279,60 @@ uint32_t AssetManager2::GetResourceId(const std::string& resource_name,
   return 0u;
 }
 
+const AssetManager2::FilteredConfigGroup& AssetManager2::GetFilteredConfigGroup(
+    const ConfiguredPackage& package, const TypeSpec* type_spec, uint8_t type_idx) const {
+  FilteredConfigGroup& group = package.filtered_configs_.editItemAt(type_idx);
+  if (group.filtered) {
+    return group;
+  }
+
+  ResTable_config default_config;
+  memset(&default_config, 0, sizeof(default_config));
+
+  group.configurations.clear();
+  group.types.clear();
+  group.config_axes = 0u;
+  const auto iter_end = type_spec->types + type_spec->type_count;
+  for (auto iter = type_spec->types; iter != iter_end; ++iter) {
+    ResTable_config this_config;
+    this_config.copyFromDtoH((*iter)->config);
+    group.config_axes |= static_cast<uint32_t>(this_config.diff(default_config));
+    if (!filtered_incompatible_configs_ || this_config.match(configuration_)) {
+      group.configurations.push_back(this_config);
+      group.types.push_back(*iter);
+    }
+  }
+  group.filtered = true;
+  return group;
+}
+
 void AssetManager2::RebuildFilterList(bool filter_incompatible_configs) {
+  filtered_incompatible_configs_ = filter_incompatible_configs;
+
   for (PackageGroup& group : package_groups_) {
     for (ConfiguredPackage& impl : group.packages_) {
       // Destroy it.
       impl.filtered_configs_.~ByteBucketArray();
 
-      // Re-create it.
+      // Re-create it. The filters are created when each type is first looked up.
       new (&impl.filtered_configs_) ByteBucketArray<FilteredConfigGroup>();
+    }
+  }
+}
 
-      // Create the filters here.
-      impl.loaded_package_->ForEachTypeSpec([&](const TypeSpec* spec, uint8_t type_index) {
-        FilteredConfigGroup& group = impl.filtered_configs_.editItemAt(type_index);
-        const auto iter_end = spec->types + spec->type_count;
-        for (auto iter = spec->types; iter != iter_end; ++iter) {
-          ResTable_config this_config;
-          this_config.copyFromDtoH((*iter)->config);
-          if (!filter_incompatible_configs || this_config.match(configuration_)) {
-            group.configurations.push_back(this_config);
-            group.types.push_back(*iter);
-          }
+void AssetManager2::RebuildFilterList(uint32_t diff) {
+  for (PackageGroup& group : package_groups_) {
+    for (ConfiguredPackage& impl : group.packages_) {
+      const size_t type_count = impl.filtered_configs_.size();
+      for (size_t i = 0; i < type_count; i++) {
+        const FilteredConfigGroup& filtered_group = impl.filtered_configs_[i];
+        // Whether a configuration matches only depends on the axis it specifies, so if none of
+        // them changed, none of the configurations of this type can have started or stopped
+        // matching.
+        if (filtered_group.filtered && (filtered_group.config_axes & diff) != 0u) {
+          impl.filtered_configs_.editItemAt(i).filtered = false;
         }
-      });
+      }
     }
   }
 }
@@ -1296,9 +1343,27 @@ void AssetManager2::InvalidateCaches(uint32_t diff) {
   if (diff == 0xffffffffu) {
     // Everything must go.
     cached_bags_.clear();
+    cached_entries_.clear();
+    cached_themes_.clear();
     return;
   }
 
+  for (auto iter = cached_themes_.begin(); iter != cached_themes_.end();) {
+    if (diff & iter->second->GetChangingConfigurations()) {
+      iter = cached_themes_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
+  for (auto iter = cached_entries_.cbegin(); iter != cached_entries_.cend();) {
+    if (diff & iter->second.type_flags) {
+      iter = cached_entries_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+
   // Be more conservative with what gets purged. Only if the bag has other possible
   // variations with respect to what changed (diff) should we remove it.
   for (auto iter = cached_bags_.cbegin(); iter != cached_bags_.cend();) {
@@ -1345,19 +1410,50 @@ struct ThemeType {
 
 constexpr size_t kTypeCount = std::numeric_limits<uint8_t>::max() + 1;
 
+// The maximum number of themes cached in AssetManager2::cached_themes_.
+constexpr size_t kMaxCachedThemes = 32u;
+
+// Allocates a ThemeType with room for `entry_count` entries. The entries of `src`, if any, are
+// copied and the remaining entries are zeroed.
+std::shared_ptr<ThemeType> NewThemeType(int entry_count, const ThemeType* src) {
+  std::shared_ptr<ThemeType> type(reinterpret_cast<ThemeType*>(
+      calloc(sizeof(ThemeType) + (entry_count * sizeof(ThemeEntry)), 1)), free);
+  type->entry_count = entry_count;
+  if (src != nullptr) {
+    memcpy(type->entries, src->entries,
+           std::min(src->entry_count, entry_count) * sizeof(ThemeEntry));
+  }
+  return type;
+}
+
 }  // namespace
 
 struct Theme::Package {
   // Each element of Type will be a dynamically sized object
   // allocated to have the entries stored contiguously with the Type.
-  std::array<util::unique_cptr<ThemeType>, kTypeCount> types;
+  // Types may be shared with other themes and must be copied before being modified.
+  std::array<std::shared_ptr<ThemeType>, kTypeCount> types;
 };
 
 bool Theme::ApplyStyle(uint32_t resid, bool force) {
   ATRACE_NAME("Theme::ApplyStyle");
 
+  if (style_stack_valid_) {
+    style_stack_.emplace_back(resid, force);
+    auto cached_iter = asset_manager_->cached_themes_.find(style_stack_);
+    if (cached_iter != asset_manager_->cached_themes_.end()) {
+      // Another theme was built from the same styles, so share its packages.
+      type_spec_flags_ = cached_iter->second->type_spec_flags_;
+      packages_ = cached_iter->second->packages_;
+      return true;
+    }
+  }
+
   const ResolvedBag* bag = asset_manager_->GetBag(resid);
   if (bag == nullptr) {
+    if (style_stack_valid_) {
+      style_stack_.pop_back();
+    }
     return false;
   }
 
@@ -1379,6 +1475,9 @@ bool Theme::ApplyStyle(uint32_t resid, bool force) {
     // If the resource ID passed in is not a style, the key can be some other identifier that is not
     // a resource ID. We should fail fast instead of operating with strange resource IDs.
     if (!is_valid_resid(attr_resid)) {
+      // The style may have been partially applied, so this theme can no longer be shared.
+      style_stack_valid_ = false;
+      style_stack_.clear();
       return false;
     }
 
@@ -1391,9 +1490,13 @@ bool Theme::ApplyStyle(uint32_t resid, bool force) {
     const int entry_idx = get_entry_id(attr_resid);
 
     if (last_package_idx != package_idx) {
-      std::unique_ptr<Package>& package = packages_[package_idx];
+      std::shared_ptr<Package>& package = packages_[package_idx];
       if (package == nullptr) {
-        package.reset(new Package());
+        package = std::make_shared<Package>();
+      } else if (package.use_count() > 1) {
+        // The package is shared with another theme, so copy it before modifying it. The copy
+        // still shares the types of the original.
+        package = std::make_shared<Package>(*package);
       }
       last_package_idx = package_idx;
       last_package = package.get();
@@ -1401,24 +1504,13 @@ bool Theme::ApplyStyle(uint32_t resid, bool force) {
     }
 
     if (last_type_idx != type_idx) {
-      util::unique_cptr<ThemeType>& type = last_package->types[type_idx];
-      if (type == nullptr) {
-        // Allocate enough memory to contain this entry_idx. Since we're iterating in reverse over
-        // a sorted list of attributes, this shouldn't be resized again during this method call.
-        type.reset(reinterpret_cast<ThemeType*>(
-            calloc(sizeof(ThemeType) + (entry_idx + 1) * sizeof(ThemeEntry), 1)));
-        type->entry_count = entry_idx + 1;
-      } else if (entry_idx >= type->entry_count) {
-        // Reallocate the memory to contain this entry_idx. Since we're iterating in reverse over
-        // a sorted list of attributes, this shouldn't be resized again during this method call.
-        const int new_count = entry_idx + 1;
-        type.reset(reinterpret_cast<ThemeType*>(
-            realloc(type.release(), sizeof(ThemeType) + (new_count * sizeof(ThemeEntry)))));
-
-        // Clear out the newly allocated space (which isn't zeroed).
-        memset(type->entries + type->entry_count, 0,
-               (new_count - type->entry_count) * sizeof(ThemeEntry));
-        type->entry_count = new_count;
+      std::shared_ptr<ThemeType>& type = last_package->types[type_idx];
+      if (type == nullptr || entry_idx >= type->entry_count || type.use_count() > 1) {
+        // Copy the type if it is shared with another theme, and grow it to contain this
+        // entry_idx. Since we're iterating in reverse over a sorted list of attributes, this
+        // happens at most once per type during this method call.
+        const int entry_count = std::max(entry_idx + 1, type != nullptr ? type->entry_count : 0);
+        type = NewThemeType(entry_count, type.get());
       }
       last_type_idx = type_idx;
       last_type = type.get();
@@ -1432,6 +1524,17 @@ bool Theme::ApplyStyle(uint32_t resid, bool force) {
       entry.value = bag_iter->value;
     }
   }
+
+  if (style_stack_valid_) {
+    // Cache the new theme so that themes applying the same styles can share its packages.
+    auto& cached_themes = asset_manager_->cached_themes_;
+    if (cached_themes.size() >= kMaxCachedThemes) {
+      cached_themes.clear();
+    }
+    std::unique_ptr<Theme> cached_theme(new Theme(asset_manager_));
+    cached_theme->SetTo(*this);
+    cached_themes.emplace(style_stack_, std::move(cached_theme));
+  }
   return true;
 }
 
@@ -1501,9 +1604,11 @@ ApkAssetsCookie Theme::ResolveAttributeReference(ApkAssetsCookie cookie, Res_val
 
 void Theme::Clear() {
   type_spec_flags_ = 0u;
-  for (std::unique_ptr<Package>& package : packages_) {
+  for (std::shared_ptr<Package>& package : packages_) {
     package.reset();
   }
+  style_stack_.clear();
+  style_stack_valid_ = true;
 }
 
 void Theme::SetTo(const Theme& o) {
@@ -1514,35 +1619,11 @@ void Theme::SetTo(const Theme& o) {
   type_spec_flags_ = o.type_spec_flags_;
 
   if (asset_manager_ == o.asset_manager_) {
-    // The theme comes from the same asset manager so all theme data can be copied exactly
-    for (size_t p = 0; p < packages_.size(); p++) {
-      const Package *package = o.packages_[p].get();
-      if (package == nullptr) {
-        // The other theme doesn't have this package, clear ours.
-        packages_[p].reset();
-        continue;
-      }
-
-      if (packages_[p] == nullptr) {
-        // The other theme has this package, but we don't. Make one.
-        packages_[p].reset(new Package());
-      }
-
-      for (size_t t = 0; t < package->types.size(); t++) {
-        const ThemeType *type = package->types[t].get();
-        if (type == nullptr) {
-          // The other theme doesn't have this type, clear ours.
-          packages_[p]->types[t].reset();
-          continue;
-        }
-
-        // Create a new type and update it to theirs.
-        const size_t type_alloc_size = sizeof(ThemeType) + (type->entry_count * sizeof(ThemeEntry));
-        void *copied_data = malloc(type_alloc_size);
-        memcpy(copied_data, type, type_alloc_size);
-        packages_[p]->types[t].reset(reinterpret_cast<ThemeType *>(copied_data));
-      }
-    }
+    // The theme comes from the same asset manager so all theme data can be shared exactly. The
+    // packages are copied when either theme modifies them.
+    packages_ = o.packages_;
+    style_stack_ = o.style_stack_;
+    style_stack_valid_ = o.style_stack_valid_;
   } else {
     std::map<ApkAssetsCookie, ApkAssetsCookie> src_to_dest_asset_cookies;
     typedef std::map<int, int> SourceToDestinationRuntimePackageMap;
@@ -1596,6 +1677,11 @@ void Theme::SetTo(const Theme& o) {
       }
     }
 
+    // The copied attributes are rewritten for this AssetManager, so this theme can no longer be
+    // shared.
+    style_stack_.clear();
+    style_stack_valid_ = false;
+
     for (size_t p = 0; p < packages_.size(); p++) {
       const Package *package = o.packages_[p].get();
       if (package == nullptr) {
@@ -1680,27 +1766,16 @@ void Theme::SetTo(const Theme& o) {
           }
 
           // Lazily instantiate the destination package.
-          std::unique_ptr<Package>& dest_package = packages_[attribute_dest_package_id];
+          std::shared_ptr<Package>& dest_package = packages_[attribute_dest_package_id];
           if (dest_package == nullptr) {
-            dest_package.reset(new Package());
+            dest_package = std::make_shared<Package>();
           }
 
           // Lazily instantiate and resize the destination type.
-          util::unique_cptr<ThemeType>& dest_type = dest_package->types[t];
+          std::shared_ptr<ThemeType>& dest_type = dest_package->types[t];
           if (dest_type == nullptr || dest_type->entry_count < type->entry_count) {
-            const size_t type_alloc_size = sizeof(ThemeType)
-                + (type->entry_count * sizeof(ThemeEntry));
-            void* dest_data = malloc(type_alloc_size);
-            memset(dest_data, 0, type->entry_count * sizeof(ThemeEntry));
-
             // Copy the existing destination type values if the type is resized.
-            if (dest_type != nullptr) {
-              memcpy(dest_data, type, sizeof(ThemeType)
-                                      + (dest_type->entry_count * sizeof(ThemeEntry)));
-            }
-
-            dest_type.reset(reinterpret_cast<ThemeType *>(dest_data));
-            dest_type->entry_count = type->entry_count;
+            dest_type = NewThemeType(type->entry_count, dest_type.get());
           }
 
           dest_type->entries[e].cookie = data_dest_cookie;
@@ -16,6 +16,7 @@
 
 #include "androidfw/AttributeResolution.h"
 
+#include <algorithm>
 #include <cstdint>
 
 #include <log/log.h>
@@ -202,9 +203,12 @@ bool ResolveAttrs(Theme* theme, uint32_t def_style_attr, uint32_t def_style_res,
   return true;
 }
 
-void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
-                uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
-                uint32_t* out_values, uint32_t* out_indices) {
+// If `default_values` is not nullptr, it holds the values of `attrs` resolved from the default
+// style and the theme (see ApplyStyleCache), and the default style is not resolved again.
+static void ApplyStyleImpl(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
+                           uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
+                           const uint32_t* default_values, uint32_t* out_values,
+                           uint32_t* out_indices) {
   if (kDebugStyles) {
     ALOGI("APPLY STYLE: theme=0x%p defStyleAttr=0x%x defStyleRes=0x%x xml=0x%p", theme,
           def_style_attr, def_style_resid, xml_parser);
@@ -218,7 +222,7 @@ void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
 
   // Load default style from attribute, if specified...
   uint32_t def_style_flags = 0u;
-  if (def_style_attr != 0) {
+  if (def_style_attr != 0 && default_values == nullptr) {
     Res_value value;
     if (theme->GetAttribute(def_style_attr, &value, &def_style_flags) != kInvalidCookie) {
       if (value.dataType == Res_value::TYPE_REFERENCE) {
@@ -248,7 +252,7 @@ void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
 
   // Retrieve the default style bag, if requested.
   const ResolvedBag* default_style_bag = nullptr;
-  if (def_style_resid != 0) {
+  if (def_style_resid != 0 && default_values == nullptr) {
     default_style_bag = assetmanager->GetBag(def_style_resid);
     if (default_style_bag != nullptr) {
       def_style_flags |= default_style_bag->type_spec_flags;
@@ -319,6 +323,20 @@ void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
       }
     }
 
+    if (default_values != nullptr && value.dataType == Res_value::TYPE_NULL &&
+        value.data != Res_value::DATA_NULL_EMPTY) {
+      // The value comes from the default style or the theme, which have been resolved already.
+      const uint32_t* default_value = default_values + (ii * STYLE_NUM_ENTRIES);
+      std::copy(default_value, default_value + STYLE_NUM_ENTRIES, out_values);
+      if (default_value[STYLE_TYPE] != Res_value::TYPE_NULL ||
+          default_value[STYLE_DATA] == Res_value::DATA_NULL_EMPTY) {
+        indices_idx++;
+        out_indices[indices_idx] = ii;
+      }
+      out_values += STYLE_NUM_ENTRIES;
+      continue;
+    }
+
     if (value.dataType == Res_value::TYPE_NULL && value.data != Res_value::DATA_NULL_EMPTY) {
       // Walk through the default style values looking for the requested attribute.
       const ResolvedBag::Entry* entry = def_style_attr_finder.Find(cur_ident);
@@ -403,6 +421,46 @@ void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
   out_indices[0] = indices_idx;
 }
 
+void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
+                uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
+                uint32_t* out_values, uint32_t* out_indices) {
+  ApplyStyleImpl(theme, xml_parser, def_style_attr, def_style_resid, attrs, attrs_length,
+                 nullptr /*default_values*/, out_values, out_indices);
+}
+
+const uint32_t* ApplyStyleCache::GetDefaultValues(uint32_t def_style_attr,
+                                                  uint32_t def_style_resid,
+                                                  const uint32_t* attrs, size_t attrs_length) {
+  for (const Entry& entry : entries_) {
+    if (entry.def_style_attr == def_style_attr && entry.def_style_resid == def_style_resid &&
+        entry.attrs.size() == attrs_length &&
+        std::equal(entry.attrs.begin(), entry.attrs.end(), attrs)) {
+      return entry.values.data();
+    }
+  }
+
+  // Resolve every attribute as if no XML attributes or XML style were present.
+  Entry entry;
+  entry.def_style_attr = def_style_attr;
+  entry.def_style_resid = def_style_resid;
+  entry.attrs.assign(attrs, attrs + attrs_length);
+  entry.values.resize(attrs_length * STYLE_NUM_ENTRIES);
+  std::vector<uint32_t> indices(attrs_length + 1);
+  ApplyStyleImpl(theme_, nullptr /*xml_parser*/, def_style_attr, def_style_resid, attrs,
+                 attrs_length, nullptr /*default_values*/, entry.values.data(), indices.data());
+  entries_.push_back(std::move(entry));
+  return entries_.back().values.data();
+}
+
+void ApplyStyle(ApplyStyleCache* cache, ResXMLParser* xml_parser, uint32_t def_style_attr,
+                uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
+                uint32_t* out_values, uint32_t* out_indices) {
+  const uint32_t* default_values =
+      cache->GetDefaultValues(def_style_attr, def_style_resid, attrs, attrs_length);
+  ApplyStyleImpl(cache->GetTheme(), xml_parser, def_style_attr, def_style_resid, attrs,
+                 attrs_length, default_values, out_values, out_indices);
+}
+
 bool RetrieveAttributes(AssetManager2* assetmanager, ResXMLParser* xml_parser, uint32_t* attrs,
                         size_t attrs_length, uint32_t* out_values, uint32_t* out_indices) {
   ResTable_config config;
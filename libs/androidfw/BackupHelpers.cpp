@@ -30,6 +30,12 @@
 #include <utime.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include <log/log.h>
 #include <utils/ByteOrder.h>
 #include <utils/KeyedVector.h>
@@ -310,7 +316,7 @@ compute_crc32(const char* file, FileRec* out) {
         return -1;
     }
 
-    const int bufsize = 4*1024;
+    const int bufsize = 64*1024;
     int amt;
 
     char* buf = (char*)malloc(bufsize);
@@ -318,17 +324,48 @@ compute_crc32(const char* file, FileRec* out) {
 
     lseek(fd, 0, SEEK_SET);
 
-    while ((amt = read(fd, buf, bufsize)) != 0) {
+    while ((amt = read(fd, buf, bufsize)) > 0) {
         crc = crc32(crc, (Bytef*)buf, amt);
     }
 
     close(fd);
     free(buf);
 
+    if (amt < 0) {
+        return -1;
+    }
+
     out->s.crc32 = crc;
     return NO_ERROR;
 }
 
+// Computes the CRCs of the files concurrently. The files are independent, and reading them and
+// computing their CRCs is most of the work of a backup pass. Returns whether each CRC was computed.
+static std::unique_ptr<bool[]>
+compute_crc32s(std::vector<FileRec>* records)
+{
+    // Written concurrently, so not a std::vector<bool>.
+    std::unique_ptr<bool[]> computed(new bool[records->size()]());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < records->size(); i = next++) {
+            computed[i] = compute_crc32((*records)[i].file.string(), &(*records)[i]) == NO_ERROR;
+        }
+    };
+
+    const size_t threadCount = std::min<size_t>(
+            std::max(std::thread::hardware_concurrency(), 1u), records->size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return computed;
+}
+
 int
 back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD,
         char const* const* files, char const* const* keys, int fileCount)
@@ -345,6 +382,9 @@ back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD
         }
     }
 
+    std::vector<String8> foundKeys;
+    std::vector<FileRec> found;
+    KeyedVector<String8,bool> foundKeySet;
     for (int i=0; i<fileCount; i++) {
         String8 key(keys[i]);
         FileRec r;
@@ -364,18 +404,24 @@ back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD
             r.s.mode = st.st_mode;
             r.s.size = st.st_size;
 
-            if (newSnapshot.indexOfKey(key) >= 0) {
+            if (foundKeySet.indexOfKey(key) >= 0) {
                 LOGP("back_up_files key already in use '%s'", key.string());
                 return -1;
             }
+            foundKeySet.add(key, true);
+        }
+        foundKeys.push_back(key);
+        found.push_back(r);
+    }
 
-            // compute the CRC
-            if (compute_crc32(file, &r) != NO_ERROR) {
-                ALOGW("Unable to open file %s", file);
-                continue;
-            }
+    // compute the CRCs
+    std::unique_ptr<bool[]> computed = compute_crc32s(&found);
+    for (size_t i = 0; i < found.size(); i++) {
+        if (!computed[i]) {
+            ALOGW("Unable to open file %s", found[i].file.string());
+            continue;
         }
-        newSnapshot.add(key, r);
+        newSnapshot.add(foundKeys[i], found[i]);
     }
 
     int n = 0;
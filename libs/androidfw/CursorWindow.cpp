@@ -153,13 +153,11 @@ status_t CursorWindow::clear() {
         return INVALID_OPERATION;
     }
 
-    mHeader->freeOffset = sizeof(Header) + sizeof(RowSlotChunk);
-    mHeader->firstChunkOffset = sizeof(Header);
+    mHeader->freeOffset = sizeof(Header);
+    // Keep the row slots 4 byte aligned.
+    mHeader->slotsOffset = mSize & ~static_cast<size_t>(3);
     mHeader->numRows = 0;
     mHeader->numColumns = 0;
-
-    RowSlotChunk* firstChunk = static_cast<RowSlotChunk*>(offsetToPtr(mHeader->firstChunkOffset));
-    firstChunk->nextChunkOffset = 0;
     return OK;
 }
 
@@ -193,6 +191,7 @@ status_t CursorWindow::allocRow() {
     uint32_t fieldDirOffset = alloc(fieldDirSize, true /*aligned*/);
     if (!fieldDirOffset) {
         mHeader->numRows--;
+        mHeader->slotsOffset += sizeof(RowSlot);
         LOG_WINDOW("The row failed, so back out the new row accounting "
                 "from allocRowSlot %d", mHeader->numRows);
         return NO_MEMORY;
@@ -213,6 +212,7 @@ status_t CursorWindow::freeLastRow() {
 
     if (mHeader->numRows > 0) {
         mHeader->numRows--;
+        mHeader->slotsOffset += sizeof(RowSlot);
     }
     return OK;
 }
@@ -228,7 +228,7 @@ uint32_t CursorWindow::alloc(size_t size, bool aligned) {
 
     uint32_t offset = mHeader->freeOffset + padding;
     uint32_t nextFreeOffset = offset + size;
-    if (nextFreeOffset > mSize) {
+    if (nextFreeOffset > mHeader->slotsOffset) {
         ALOGW("Window is full: requested allocation %zu bytes, "
                 "free space %zu bytes, window size %zu bytes",
                 size, freeSpace(), mSize);
@@ -240,37 +240,26 @@ uint32_t CursorWindow::alloc(size_t size, bool aligned) {
 }
 
 CursorWindow::RowSlot* CursorWindow::getRowSlot(uint32_t row) {
-    uint32_t chunkPos = row;
-    RowSlotChunk* chunk = static_cast<RowSlotChunk*>(
-            offsetToPtr(mHeader->firstChunkOffset));
-    while (chunkPos >= ROW_SLOT_CHUNK_NUM_ROWS) {
-        chunk = static_cast<RowSlotChunk*>(offsetToPtr(chunk->nextChunkOffset));
-        chunkPos -= ROW_SLOT_CHUNK_NUM_ROWS;
+    // The row slots are stored in reverse order, the slot of the last row comes first.
+    size_t offset = mHeader->slotsOffset +
+            static_cast<size_t>(mHeader->numRows - 1 - row) * sizeof(RowSlot);
+    if (offset > mSize) {
+        ALOGE("Row slot offset %zu out of bounds, max value %zu", offset, mSize);
+        return NULL;
     }
-    return &chunk->slots[chunkPos];
+    return static_cast<RowSlot*>(offsetToPtr(offset, sizeof(RowSlot)));
 }
 
 CursorWindow::RowSlot* CursorWindow::allocRowSlot() {
-    uint32_t chunkPos = mHeader->numRows;
-    RowSlotChunk* chunk = static_cast<RowSlotChunk*>(
-            offsetToPtr(mHeader->firstChunkOffset));
-    while (chunkPos > ROW_SLOT_CHUNK_NUM_ROWS) {
-        chunk = static_cast<RowSlotChunk*>(offsetToPtr(chunk->nextChunkOffset));
-        chunkPos -= ROW_SLOT_CHUNK_NUM_ROWS;
-    }
-    if (chunkPos == ROW_SLOT_CHUNK_NUM_ROWS) {
-        if (!chunk->nextChunkOffset) {
-            chunk->nextChunkOffset = alloc(sizeof(RowSlotChunk), true /*aligned*/);
-            if (!chunk->nextChunkOffset) {
-                return NULL;
-            }
-        }
-        chunk = static_cast<RowSlotChunk*>(offsetToPtr(chunk->nextChunkOffset));
-        chunk->nextChunkOffset = 0;
-        chunkPos = 0;
+    if (mHeader->slotsOffset < mHeader->freeOffset + sizeof(RowSlot)) {
+        ALOGW("Window is full: requested allocation %zu bytes, "
+                "free space %zu bytes, window size %zu bytes",
+                sizeof(RowSlot), freeSpace(), mSize);
+        return NULL;
     }
+    mHeader->slotsOffset -= sizeof(RowSlot);
     mHeader->numRows += 1;
-    return &chunk->slots[chunkPos];
+    return static_cast<RowSlot*>(offsetToPtr(mHeader->slotsOffset, sizeof(RowSlot)));
 }
 
 CursorWindow::FieldSlot* CursorWindow::getFieldSlot(uint32_t row, uint32_t column) {
@@ -106,10 +106,12 @@ status_t OverlayDynamicRefTable::lookupResourceIdNoRewrite(uint32_t* resId) cons
 
 IdmapResMap::IdmapResMap(const Idmap_data_header* data_header,
                          const Idmap_target_entry* entries,
+                         const IdmapTargetIndex* target_index,
                          uint8_t target_assigned_package_id,
                          const OverlayDynamicRefTable* overlay_ref_table)
     : data_header_(data_header),
       entries_(entries),
+      target_index_(target_index),
       target_assigned_package_id_(target_assigned_package_id),
       overlay_ref_table_(overlay_ref_table) { };
 
@@ -123,11 +125,8 @@ IdmapResMap::Result IdmapResMap::Lookup(uint32_t target_res_id) const {
   target_res_id = (0x00FFFFFFU & target_res_id)
       | (((uint32_t) data_header_->target_package_id) << 24);
 
-  const Idmap_target_entry* first_entry = entries_;
-  const Idmap_target_entry* end_entry = entries_ + dtohl(data_header_->target_entry_count);
-  auto entry = std::lower_bound(first_entry, end_entry, target_res_id, compare_target_entries);
-
-  if (entry == end_entry || dtohl(entry->target_id) != target_res_id) {
+  const Idmap_target_entry* entry = FindTargetEntry(target_res_id);
+  if (entry == nullptr) {
     // A mapping for the target resource id could not be found.
     return {};
   }
@@ -160,6 +159,38 @@ IdmapResMap::Result IdmapResMap::Lookup(uint32_t target_res_id) const {
   return Result(ResTable_entry_handle::managed(table_entry, [](auto p) { free(p); }));
 }
 
+const Idmap_target_entry* IdmapResMap::FindTargetEntry(uint32_t target_res_id) const {
+  const Idmap_target_entry* first_entry = entries_;
+  const Idmap_target_entry* end_entry = entries_ + dtohl(data_header_->target_entry_count);
+
+  if (target_index_ != nullptr && !target_index_->types.empty()) {
+    const size_t type_id = (target_res_id >> 16) & 0xffU;
+    if (type_id >= target_index_->types.size()) {
+      return nullptr;
+    }
+
+    const IdmapTargetIndex::Type& type = target_index_->types[type_id];
+    if (type.span != 0U) {
+      const uint32_t entry_offset = (target_res_id & 0xffffU) - type.min_entry_id;
+      if (entry_offset >= type.span) {
+        return nullptr;
+      }
+
+      const uint32_t idx = target_index_->lookup[type.lookup_offset + entry_offset];
+      return idx != IdmapTargetIndex::kNoEntry ? entries_ + idx : nullptr;
+    }
+
+    first_entry = entries_ + type.first_entry;
+    end_entry = first_entry + type.entry_count;
+  }
+
+  auto entry = std::lower_bound(first_entry, end_entry, target_res_id, compare_target_entries);
+  if (entry == end_entry || dtohl(entry->target_id) != target_res_id) {
+    return nullptr;
+  }
+  return entry;
+}
+
 static bool is_word_aligned(const void* data) {
   return (reinterpret_cast<uintptr_t>(data) & 0x03) == 0;
 }
@@ -193,18 +224,69 @@ static bool IsValidIdmapHeader(const StringPiece& data) {
   return true;
 }
 
+// Builds the per-type index over the target entries. Returns an empty index if the entries are not
+// sorted or do not all belong to the target package, in which case lookups fall back to a binary
+// search over all target entries.
+static IdmapTargetIndex BuildTargetIndex(const Idmap_data_header* data_header,
+                                         const Idmap_target_entry* target_entries) {
+  const uint32_t entry_count = dtohl(data_header->target_entry_count);
+  IdmapTargetIndex index;
+  uint32_t last_target_id = 0U;
+  for (uint32_t i = 0U; i < entry_count; i++) {
+    const uint32_t target_id = dtohl(target_entries[i].target_id);
+    if ((target_id >> 24) != data_header->target_package_id
+        || (i > 0U && target_id <= last_target_id)) {
+      return {};
+    }
+    last_target_id = target_id;
+
+    const size_t type_id = (target_id >> 16) & 0xffU;
+    if (type_id >= index.types.size()) {
+      index.types.resize(type_id + 1U);
+      index.types[type_id].first_entry = i;
+      index.types[type_id].min_entry_id = target_id & 0xffffU;
+    }
+    index.types[type_id].entry_count++;
+  }
+
+  for (IdmapTargetIndex::Type& type : index.types) {
+    if (type.entry_count == 0U) {
+      continue;
+    }
+
+    // Only use a direct lookup table when it is not much larger than the entries it indexes.
+    const uint32_t max_entry_id =
+        dtohl(target_entries[type.first_entry + type.entry_count - 1U].target_id) & 0xffffU;
+    const uint32_t span = max_entry_id - type.min_entry_id + 1U;
+    if (span > type.entry_count * 2U + 16U) {
+      continue;
+    }
+
+    type.span = span;
+    type.lookup_offset = static_cast<uint32_t>(index.lookup.size());
+    index.lookup.resize(index.lookup.size() + span, IdmapTargetIndex::kNoEntry);
+    for (uint32_t i = type.first_entry; i < type.first_entry + type.entry_count; i++) {
+      const uint32_t entry_id = dtohl(target_entries[i].target_id) & 0xffffU;
+      index.lookup[type.lookup_offset + entry_id - type.min_entry_id] = i;
+    }
+  }
+  return index;
+}
+
 LoadedIdmap::LoadedIdmap(std::string&& idmap_path,
                          const time_t last_mod_time,
                          const Idmap_header* header,
                          const Idmap_data_header* data_header,
                          const Idmap_target_entry* target_entries,
                          const Idmap_overlay_entry* overlay_entries,
-                         ResStringPool* string_pool)
+                         ResStringPool* string_pool,
+                         IdmapTargetIndex&& target_index)
      : header_(header),
        data_header_(data_header),
        target_entries_(target_entries),
        overlay_entries_(overlay_entries),
        string_pool_(string_pool),
+       target_index_(std::move(target_index)),
        idmap_path_(std::move(idmap_path)),
        idmap_last_mod_time_(last_mod_time) {
 
@@ -282,7 +364,8 @@ std::unique_ptr<const LoadedIdmap> LoadedIdmap::Load(const StringPiece& idmap_pa
   // Can't use make_unique because LoadedIdmap constructor is private.
   std::unique_ptr<LoadedIdmap> loaded_idmap = std::unique_ptr<LoadedIdmap>(
       new LoadedIdmap(idmap_path.to_string(), getFileModDate(idmap_path.data()), header,
-                      data_header, target_entries, overlay_entries, idmap_string_pool.release()));
+                      data_header, target_entries, overlay_entries, idmap_string_pool.release(),
+                      BuildTargetIndex(data_header, target_entries)));
 
   return std::move(loaded_idmap);
 }
@@ -81,6 +81,15 @@ class TypeSpecPtrBuilder {
   std::vector<const ResTable_type*> types_;
 };
 
+// FNV-1a hash of a resource name, used to index the names of a LoadedPackage.
+inline uint32_t HashName(const char* name, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+  }
+  return hash;
+}
+
 }  // namespace
 
 LoadedPackage::LoadedPackage() = default;
@@ -297,7 +306,7 @@ void LoadedPackage::CollectConfigurations(bool exclude_mipmap,
   const static std::u16string kMipMap = u"mipmap";
   const size_t type_count = type_specs_.size();
   for (size_t i = 0; i < type_count; i++) {
-    const TypeSpecPtr& type_spec = type_specs_[i];
+    const TypeSpec* type_spec = GetTypeSpec(i);
     if (type_spec != nullptr) {
       if (exclude_mipmap) {
         const int type_idx = type_spec->type_spec->id - 1;
@@ -332,7 +341,7 @@ void LoadedPackage::CollectLocales(bool canonicalize, std::set<std::string>* out
   char temp_locale[RESTABLE_MAX_LOCALE_LEN];
   const size_t type_count = type_specs_.size();
   for (size_t i = 0; i < type_count; i++) {
-    const TypeSpecPtr& type_spec = type_specs_[i];
+    const TypeSpec* type_spec = GetTypeSpec(i);
     if (type_spec != nullptr) {
       const auto iter_end = type_spec->types + type_spec->type_count;
       for (auto iter = type_spec->types; iter != iter_end; ++iter) {
@@ -348,6 +357,101 @@ void LoadedPackage::CollectLocales(bool canonicalize, std::set<std::string>* out
   }
 }
 
+const LoadedPackage::NameIndex& LoadedPackage::GetNameIndex() const {
+  std::call_once(name_index_built_, [&]() {
+    ATRACE_NAME("LoadedPackage::GetNameIndex");
+    auto index = util::make_unique<NameIndex>();
+
+    const size_t key_count = key_string_pool_.size();
+    index->key_hashes.reserve(key_count);
+    for (size_t key_idx = 0; key_idx < key_count; key_idx++) {
+      size_t len;
+      if (const char* key = key_string_pool_.string8At(key_idx, &len)) {
+        index->key_hashes.emplace_back(HashName(key, len), key_idx);
+      } else if (const char16_t* key16 = key_string_pool_.stringAt(key_idx, &len)) {
+        const std::string key8 = util::Utf16ToUtf8(StringPiece16(key16, len));
+        index->key_hashes.emplace_back(HashName(key8.data(), key8.size()), key_idx);
+      }
+    }
+    std::sort(index->key_hashes.begin(), index->key_hashes.end());
+
+    index->type_count = type_specs_.size();
+    index->types.reset(new NameIndex::TypeEntries[index->type_count]);
+    name_index_ = std::move(index);
+  });
+  return *name_index_;
+}
+
+const std::vector<LoadedPackage::NameIndex::Entry>& LoadedPackage::GetNameIndexEntries(
+    const TypeSpec* type_spec, size_t type_idx) const {
+  NameIndex::TypeEntries& type_entries = GetNameIndex().types[type_idx];
+  std::call_once(type_entries.built, [&]() {
+    ATRACE_NAME("LoadedPackage::GetNameIndexEntries");
+    std::vector<NameIndex::Entry>& entries = type_entries.entries;
+    const auto iter_end = type_spec->types + type_spec->type_count;
+    for (auto iter = type_spec->types; iter != iter_end; ++iter) {
+      const ResTable_type* type = *iter;
+      const size_t entry_count = dtohl(type->entryCount);
+      const uint8_t* offsets =
+          reinterpret_cast<const uint8_t*>(type) + dtohs(type->header.headerSize);
+      for (size_t i = 0; i < entry_count; i++) {
+        uint32_t entry_idx;
+        uint32_t offset;
+        if (type->flags & ResTable_type::FLAG_SPARSE) {
+          const ResTable_sparseTypeEntry& sparse_entry =
+              reinterpret_cast<const ResTable_sparseTypeEntry*>(offsets)[i];
+          entry_idx = dtohs(sparse_entry.idx);
+          offset = uint32_t{dtohs(sparse_entry.offset)} * 4u;
+        } else {
+          entry_idx = i;
+          offset = dtohl(reinterpret_cast<const uint32_t*>(offsets)[i]);
+        }
+
+        if (offset != ResTable_type::NO_ENTRY) {
+          const ResTable_entry* entry = reinterpret_cast<const ResTable_entry*>(
+              reinterpret_cast<const uint8_t*>(type) + dtohl(type->entriesStart) + offset);
+          entries.push_back(NameIndex::Entry{entry_idx, dtohl(entry->key.index)});
+        }
+      }
+    }
+
+    // Keep the first entry of every name, which is the one the types are searched for first.
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const NameIndex::Entry& a, const NameIndex::Entry& b) {
+                       return a.key_idx < b.key_idx;
+                     });
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const NameIndex::Entry& a, const NameIndex::Entry& b) {
+                                return a.key_idx == b.key_idx;
+                              }),
+                  entries.end());
+    entries.shrink_to_fit();
+  });
+  return type_entries.entries;
+}
+
+ssize_t LoadedPackage::FindKeyIndex(const std::u16string& entry_name) const {
+  const std::string name = util::Utf16ToUtf8(entry_name);
+  const uint32_t hash = HashName(name.data(), name.size());
+  const NameIndex& index = GetNameIndex();
+  auto iter = std::lower_bound(index.key_hashes.begin(), index.key_hashes.end(),
+                               std::make_pair(hash, 0u));
+  for (; iter != index.key_hashes.end() && iter->first == hash; ++iter) {
+    // Resolve hash collisions by comparing the actual strings.
+    size_t len;
+    if (const char* key = key_string_pool_.string8At(iter->second, &len)) {
+      if (StringPiece(key, len) == name) {
+        return iter->second;
+      }
+    } else if (const char16_t* key16 = key_string_pool_.stringAt(iter->second, &len)) {
+      if (entry_name.compare(0, std::u16string::npos, key16, len) == 0) {
+        return iter->second;
+      }
+    }
+  }
+  return -1;
+}
+
 uint32_t LoadedPackage::FindEntryByName(const std::u16string& type_name,
                                         const std::u16string& entry_name) const {
   ssize_t type_idx = type_string_pool_.indexOfString(type_name.data(), type_name.size());
@@ -355,36 +459,70 @@ uint32_t LoadedPackage::FindEntryByName(const std::u16string& type_name,
     return 0u;
   }
 
-  ssize_t key_idx = key_string_pool_.indexOfString(entry_name.data(), entry_name.size());
+  ssize_t key_idx = FindKeyIndex(entry_name);
   if (key_idx < 0) {
     return 0u;
   }
 
-  const TypeSpec* type_spec = type_specs_[type_idx].get();
+  const TypeSpec* type_spec = GetTypeSpec(type_idx);
   if (type_spec == nullptr) {
     return 0u;
   }
 
-  const auto iter_end = type_spec->types + type_spec->type_count;
-  for (auto iter = type_spec->types; iter != iter_end; ++iter) {
-    const ResTable_type* type = *iter;
-    size_t entry_count = dtohl(type->entryCount);
-    for (size_t entry_idx = 0; entry_idx < entry_count; entry_idx++) {
-      const uint32_t* entry_offsets = reinterpret_cast<const uint32_t*>(
-          reinterpret_cast<const uint8_t*>(type) + dtohs(type->header.headerSize));
-      const uint32_t offset = dtohl(entry_offsets[entry_idx]);
-      if (offset != ResTable_type::NO_ENTRY) {
-        const ResTable_entry* entry = reinterpret_cast<const ResTable_entry*>(
-            reinterpret_cast<const uint8_t*>(type) + dtohl(type->entriesStart) + offset);
-        if (dtohl(entry->key.index) == static_cast<uint32_t>(key_idx)) {
-          // The package ID will be overridden by the caller (due to runtime assignment of package
-          // IDs for shared libraries).
-          return make_resid(0x00, type_idx + type_id_offset_ + 1, entry_idx);
+  const std::vector<NameIndex::Entry>& entries = GetNameIndexEntries(type_spec, type_idx);
+  auto iter = std::lower_bound(entries.begin(), entries.end(), static_cast<uint32_t>(key_idx),
+                               [](const NameIndex::Entry& a, uint32_t key) {
+                                 return a.key_idx < key;
+                               });
+  if (iter == entries.end() || iter->key_idx != static_cast<uint32_t>(key_idx)) {
+    return 0u;
+  }
+
+  // The package ID will be overridden by the caller (due to runtime assignment of package
+  // IDs for shared libraries).
+  return make_resid(0x00, type_idx + type_id_offset_ + 1, iter->entry_idx);
+}
+
+const TypeSpec* LoadedPackage::GetLazyTypeSpec(size_t type_idx) const {
+  const std::unique_ptr<LazyTypeSpec>& lazy_type_spec = lazy_type_specs_[type_idx];
+  if (lazy_type_spec == nullptr) {
+    return nullptr;
+  }
+
+  std::call_once(lazy_type_spec->built, [&]() {
+    ATRACE_NAME("LoadedPackage::GetLazyTypeSpec");
+    TypeSpecPtrBuilder builder(lazy_type_spec->type_spec);
+    if (lazy_type_spec->types_begin != nullptr) {
+      ChunkIterator iter(lazy_type_spec->types_begin,
+                         lazy_type_spec->types_end - lazy_type_spec->types_begin);
+      while (iter.HasNext()) {
+        const Chunk child_chunk = iter.Next();
+        if (child_chunk.type() != RES_TABLE_TYPE_TYPE) {
+          continue;
+        }
+
+        // The size of the header was already checked when the package was loaded.
+        const ResTable_type* type = child_chunk.header<ResTable_type, kResTableTypeMinSize>();
+        if (type->id != lazy_type_spec->type_spec->id) {
+          continue;
+        }
+
+        if (!VerifyResTableType(type)) {
+          LOG(ERROR) << StringPrintf("Skipping corrupt RES_TABLE_TYPE_TYPE with ID %02x.",
+                                     type->id);
+          continue;
         }
+        builder.AddType(type);
       }
     }
-  }
-  return 0u;
+
+    TypeSpecPtr type_spec_ptr = builder.Build();
+    if (type_spec_ptr == nullptr) {
+      LOG(ERROR) << "Too many type configurations, overflow detected.";
+    }
+    type_specs_.editItemAt(type_idx) = std::move(type_spec_ptr);
+  });
+  return type_specs_[type_idx].get();
 }
 
 const LoadedPackage* LoadedArsc::GetPackageById(uint8_t package_id) const {
@@ -425,6 +563,11 @@ std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
     loaded_package->property_flags_ |= PROPERTY_OVERLAY | PROPERTY_DYNAMIC;
   }
 
+  const bool lazy_types = (property_flags & PROPERTY_LAZY_TYPES) != 0;
+  if (lazy_types) {
+    loaded_package->property_flags_ |= PROPERTY_LAZY_TYPES;
+  }
+
   loaded_package->package_id_ = dtohl(header->id);
   if (loaded_package->package_id_ == 0 ||
       (loaded_package->package_id_ == kAppPackageId && (property_flags & PROPERTY_DYNAMIC) != 0)) {
@@ -512,6 +655,23 @@ std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
           return {};
         }
 
+        if (lazy_types) {
+          std::unique_ptr<LazyTypeSpec>& lazy_ptr =
+              loaded_package->lazy_type_specs_.editItemAt(type_spec->id - 1);
+          if (lazy_ptr == nullptr) {
+            lazy_ptr = util::make_unique<LazyTypeSpec>();
+            lazy_ptr->type_spec = type_spec;
+            loaded_package->resource_ids_.set(type_spec->id, entry_count);
+
+            // Allocate the slot of the type now so that building it later only writes to it.
+            loaded_package->type_specs_.editItemAt(type_spec->id - 1);
+          } else {
+            LOG(WARNING) << StringPrintf("RES_TABLE_TYPE_SPEC_TYPE already defined for ID %02x",
+                                         type_spec->id);
+          }
+          break;
+        }
+
         std::unique_ptr<TypeSpecPtrBuilder>& builder_ptr = type_builder_map[type_spec->id - 1];
         if (builder_ptr == nullptr) {
           builder_ptr = util::make_unique<TypeSpecPtrBuilder>(type_spec);
@@ -529,6 +689,31 @@ std::unique_ptr<const LoadedPackage> LoadedPackage::Load(const Chunk& chunk,
           return {};
         }
 
+        if (lazy_types) {
+          if (type->id == 0) {
+            LOG(ERROR) << "RES_TABLE_TYPE_TYPE has invalid ID 0.";
+            return {};
+          }
+
+          // Type chunks must be preceded by their TypeSpec chunks.
+          const std::unique_ptr<LazyTypeSpec>& lazy_ptr =
+              loaded_package->lazy_type_specs_[type->id - 1];
+          if (lazy_ptr == nullptr) {
+            LOG(ERROR) << StringPrintf(
+                "RES_TABLE_TYPE_TYPE with ID %02x found without preceding RES_TABLE_TYPE_SPEC_TYPE.",
+                type->id);
+            return {};
+          }
+
+          // Only remember where the chunks of this type are. They are validated on first access.
+          const uint8_t* type_begin = reinterpret_cast<const uint8_t*>(type);
+          if (lazy_ptr->types_begin == nullptr) {
+            lazy_ptr->types_begin = type_begin;
+          }
+          lazy_ptr->types_end = type_begin + child_chunk.size();
+          break;
+        }
+
         if (!VerifyResTableType(type)) {
           return {};
         }
@@ -132,14 +132,10 @@ inline bool isSpecialSpanish(uint32_t language_and_region) {
     return (language_and_region == US_SPANISH || language_and_region == MEXICAN_SPANISH);
 }
 
-int localeDataCompareRegions(
+static int compareRegions(
         const char* left_region, const char* right_region,
         const char* requested_language, const char* requested_script,
         const char* requested_region) {
-
-    if (left_region[0] == right_region[0] && left_region[1] == right_region[1]) {
-        return 0;
-    }
     uint32_t left = packLocale(requested_language, left_region);
     uint32_t right = packLocale(requested_language, right_region);
     const uint32_t request = packLocale(requested_language, requested_region);
@@ -239,4 +235,49 @@ bool localeDataIsCloseToUsEnglish(const char* region) {
     return stop_list_index == 0; // 'en' is first in ENGLISH_STOP_LIST
 }
 
+// Results of compareRegions() are memoized, since the same few pairs of
+// regions get compared against the same requested locale for every resource
+// that varies by locale whenever resources are resolved or configurations are
+// filtered.
+struct RegionComparison {
+    uint64_t request;   // requested language, region and script
+    uint32_t regions;   // left and right regions
+    int result;
+    bool valid;
+};
+
+const size_t REGION_COMPARISON_CACHE_SIZE = 64;
+
+int localeDataCompareRegions(
+        const char* left_region, const char* right_region,
+        const char* requested_language, const char* requested_script,
+        const char* requested_region) {
+
+    if (left_region[0] == right_region[0] && left_region[1] == right_region[1]) {
+        return 0;
+    }
+
+    static thread_local std::array<RegionComparison, REGION_COMPARISON_CACHE_SIZE> cache{};
+
+    const uint64_t request = (
+            (((uint64_t) packLocale(requested_language, requested_region)) << 32u) |
+            (((uint64_t) (uint8_t) requested_script[0]) << 24u) |
+            (((uint64_t) (uint8_t) requested_script[1]) << 16u) |
+            (((uint64_t) (uint8_t) requested_script[2]) <<  8u) |
+            ((uint64_t) (uint8_t) requested_script[3]));
+    const uint32_t regions = packLocale(left_region, right_region);
+
+    const uint64_t hash = (request ^ (((uint64_t) regions) * 0x9E3779B97F4A7C15LLU)) *
+            0xFF51AFD7ED558CCDLLU;
+    RegionComparison& entry = cache[(hash >> 32u) % REGION_COMPARISON_CACHE_SIZE];
+    if (!entry.valid || entry.request != request || entry.regions != regions) {
+        entry.request = request;
+        entry.regions = regions;
+        entry.result = compareRegions(left_region, right_region,
+                requested_language, requested_script, requested_region);
+        entry.valid = true;
+    }
+    return entry.result;
+}
+
 } // namespace android
@@ -654,15 +654,19 @@ status_t ResStringPool::getError() const
 void ResStringPool::uninit()
 {
     mError = NO_INIT;
-    if (mHeader != NULL && mCache != NULL) {
-        for (size_t x = 0; x < mHeader->stringCount; x++) {
-            if (mCache[x] != NULL) {
-                free(mCache[x]);
-                mCache[x] = NULL;
+    std::atomic<CachePage*>* pages = mCache.exchange(NULL);
+    if (mHeader != NULL && pages != NULL) {
+        const size_t pageCount = (mHeader->stringCount + kCachePageSize - 1) / kCachePageSize;
+        for (size_t x = 0; x < pageCount; x++) {
+            CachePage* page = pages[x].load();
+            if (page != NULL) {
+                for (size_t y = 0; y < kCachePageSize; y++) {
+                    free(page->strings[y].load());
+                }
+                delete page;
             }
         }
-        free(mCache);
-        mCache = NULL;
+        delete[] pages;
     }
     if (mOwnedData) {
         free(mOwnedData);
@@ -714,6 +718,52 @@ decodeLength(const uint8_t** str)
     return len;
 }
 
+std::atomic<char16_t*>* ResStringPool::cacheEntryAt(size_t idx) const
+{
+    const size_t pageCount = (mHeader->stringCount + kCachePageSize - 1) / kCachePageSize;
+    std::atomic<CachePage*>* pages = mCache.load(std::memory_order_acquire);
+    if (pages == NULL) {
+#ifndef __ANDROID__
+        if (kDebugStringPoolNoisy) {
+            ALOGI("CREATING STRING CACHE OF %zu bytes", pageCount*sizeof(CachePage*));
+        }
+#else
+        // We do not want to be in this case when actually running Android.
+        ALOGW("CREATING STRING CACHE OF %zu bytes", pageCount*sizeof(CachePage*));
+#endif
+        std::atomic<CachePage*>* newPages = new (std::nothrow) std::atomic<CachePage*>[pageCount]();
+        if (newPages == NULL) {
+            ALOGW("No memory trying to allocate decode cache table of %zu bytes\n",
+                  pageCount*sizeof(CachePage*));
+            return NULL;
+        }
+
+        // Another thread may have published its table first, in which case it is used instead.
+        if (mCache.compare_exchange_strong(pages, newPages, std::memory_order_acq_rel)) {
+            pages = newPages;
+        } else {
+            delete[] newPages;
+        }
+    }
+
+    std::atomic<CachePage*>& pageEntry = pages[idx / kCachePageSize];
+    CachePage* page = pageEntry.load(std::memory_order_acquire);
+    if (page == NULL) {
+        CachePage* newPage = new (std::nothrow) CachePage();
+        if (newPage == NULL) {
+            ALOGW("No memory trying to allocate decode cache page of %zu bytes\n",
+                  sizeof(CachePage));
+            return NULL;
+        }
+        if (pageEntry.compare_exchange_strong(page, newPage, std::memory_order_acq_rel)) {
+            page = newPage;
+        } else {
+            delete newPage;
+        }
+    }
+    return &page->strings[idx % kCachePageSize];
+}
+
 const char16_t* ResStringPool::stringAt(size_t idx, size_t* u16len) const
 {
     if (mError == NO_ERROR && idx < mHeader->stringCount) {
@@ -746,10 +796,17 @@ const char16_t* ResStringPool::stringAt(size_t idx, size_t* u16len) const
 
                 // encLen must be less than 0x7FFF due to encoding.
                 if ((uint32_t)(u8str+u8len-strings) < mStringPoolSize) {
-                    AutoMutex lock(mDecodeLock);
-
-                    if (mCache != NULL && mCache[idx] != NULL) {
-                        return mCache[idx];
+                    std::atomic<CachePage*>* pages = mCache.load(std::memory_order_acquire);
+                    if (pages != NULL) {
+                        CachePage* page =
+                                pages[idx / kCachePageSize].load(std::memory_order_acquire);
+                        if (page != NULL) {
+                            char16_t* cached = page->strings[idx % kCachePageSize].load(
+                                    std::memory_order_acquire);
+                            if (cached != NULL) {
+                                return cached;
+                            }
+                        }
                     }
 
                     // Retrieve the actual length of the utf8 string if the
@@ -779,30 +836,24 @@ const char16_t* ResStringPool::stringAt(size_t idx, size_t* u16len) const
 
                     utf8_to_utf16(u8str, u8len, u16str, *u16len + 1);
 
-                    if (mCache == NULL) {
-#ifndef __ANDROID__
-                        if (kDebugStringPoolNoisy) {
-                            ALOGI("CREATING STRING CACHE OF %zu bytes",
-                                  mHeader->stringCount*sizeof(char16_t**));
-                        }
-#else
-                        // We do not want to be in this case when actually running Android.
-                        ALOGW("CREATING STRING CACHE OF %zu bytes",
-                                static_cast<size_t>(mHeader->stringCount*sizeof(char16_t**)));
-#endif
-                        mCache = (char16_t**)calloc(mHeader->stringCount, sizeof(char16_t*));
-                        if (mCache == NULL) {
-                            ALOGW("No memory trying to allocate decode cache table of %d bytes\n",
-                                  (int)(mHeader->stringCount*sizeof(char16_t**)));
-                            return NULL;
-                        }
+                    std::atomic<char16_t*>* entry = cacheEntryAt(idx);
+                    if (entry == NULL) {
+                        free(u16str);
+                        return NULL;
                     }
 
                     if (kDebugStringPoolNoisy) {
                       ALOGI("Caching UTF8 string: %s", u8str);
                     }
 
-                    mCache[idx] = u16str;
+                    // Another thread may have decoded the same string in the meantime. Keep a
+                    // single copy so that returned pointers stay valid for the pool's lifetime.
+                    char16_t* expected = NULL;
+                    if (!entry->compare_exchange_strong(expected, u16str,
+                                                        std::memory_order_acq_rel)) {
+                        free(u16str);
+                        return expected;
+                    }
                     return u16str;
                 } else {
                     ALOGW("Bad string block: string #%lld extends to %lld, past end at %lld\n",
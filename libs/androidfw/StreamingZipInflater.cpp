@@ -51,14 +51,15 @@ using namespace android;
  * Streaming access to compressed asset data in an open fd
  */
 StreamingZipInflater::StreamingZipInflater(int fd, off64_t compDataStart,
-        size_t uncompSize, size_t compSize) {
+        size_t uncompSize, size_t compSize, size_t readAheadSize) {
     mFd = fd;
     mDataMap = NULL;
     mInFileStart = compDataStart;
     mOutTotalSize = uncompSize;
     mInTotalSize = compSize;
 
-    mInBufSize = StreamingZipInflater::INPUT_CHUNK_SIZE;
+    // No need for a read buffer larger than the whole compressed data
+    mInBufSize = min_of(readAheadSize, compSize);
     mInBuf = new uint8_t[mInBufSize];
 
     mOutBufSize = StreamingZipInflater::OUTPUT_CHUNK_SIZE;
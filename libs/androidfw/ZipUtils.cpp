@@ -79,27 +79,6 @@ class FdReader : public zip_archive::Reader {
     const int mFd;
 };
 
-class BufferReader : public zip_archive::Reader {
-  public:
-    BufferReader(const void* input, size_t inputSize) : Reader(),
-        mInput(reinterpret_cast<const uint8_t*>(input)),
-        mInputSize(inputSize) {
-    }
-
-    bool ReadAtOffset(uint8_t* buf, size_t len, uint32_t offset) const {
-        if (offset + len > mInputSize) {
-            return false;
-        }
-
-        memcpy(buf, mInput + offset, len);
-        return true;
-    }
-
-  private:
-    const uint8_t* mInput;
-    const size_t mInputSize;
-};
-
 class BufferWriter : public zip_archive::Writer {
   public:
     BufferWriter(void* output, size_t outputSize) : Writer(),
@@ -141,9 +120,53 @@ class BufferWriter : public zip_archive::Writer {
 /*static*/ bool ZipUtils::inflateToBuffer(const void* in, void* buf,
     long uncompressedLen, long compressedLen)
 {
-    BufferReader reader(in, compressedLen);
-    BufferWriter writer(buf, uncompressedLen);
-    return (zip_archive::Inflate(reader, compressedLen, uncompressedLen, &writer, nullptr) == 0);
+    /*
+     * Both the compressed and the uncompressed data are entirely in memory,
+     * so inflate them in a single pass rather than staging them through
+     * intermediate chunk buffers.
+     */
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+    zstream.next_in = (Bytef*) in;
+    zstream.avail_in = compressedLen;
+    zstream.next_out = (Bytef*) buf;
+    zstream.avail_out = uncompressedLen;
+    zstream.data_type = Z_UNKNOWN;
+
+    /*
+     * Use the undocumented "negative window bits" feature to tell zlib
+     * that there's no zlib header waiting for it.
+     */
+    int zerr = inflateInit2(&zstream, -MAX_WBITS);
+    if (zerr != Z_OK) {
+        if (zerr == Z_VERSION_ERROR) {
+            ALOGE("Installed zlib is not compatible with linked version (%s)\n",
+                ZLIB_VERSION);
+        } else {
+            ALOGE("Call to inflateInit2 failed (zerr=%d)\n", zerr);
+        }
+        return false;
+    }
+
+    zerr = inflate(&zstream, Z_FINISH);
+    inflateEnd(&zstream);
+
+    if (zerr != Z_STREAM_END) {
+        ALOGW("Zip inflate failed, zerr=%d (nIn=%p aIn=%u nOut=%p aOut=%u)\n",
+            zerr, zstream.next_in, zstream.avail_in,
+            zstream.next_out, zstream.avail_out);
+        return false;
+    }
+
+    if ((long) zstream.total_out != uncompressedLen) {
+        ALOGW("Size mismatch on inflated file (%lu vs %ld)\n",
+            zstream.total_out, uncompressedLen);
+        return false;
+    }
+    return true;
 }
 
 static inline unsigned long get4LE(const unsigned char* buf) {
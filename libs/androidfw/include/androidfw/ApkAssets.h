@@ -19,6 +19,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "android-base/macros.h"
 #include "android-base/unique_fd.h"
@@ -79,6 +80,20 @@ class ApkAssets {
       const std::string& path, package_property_t flags = 0U,
       std::unique_ptr<const AssetsProvider> override_asset = nullptr);
 
+  // Returns an ApkAssets for the APK at `path` that is shared by every caller in this process that
+  // loads the same, unmodified APK with the same `flags`. An APK is identified by its path, device,
+  // inode and modification time, so a replaced APK is loaded again. The ApkAssets is destroyed
+  // when the last reference to it is released.
+  // APKs loaded with PROPERTY_LOADER are never shared.
+  static std::shared_ptr<const ApkAssets> LoadShared(const std::string& path,
+                                                     package_property_t flags = 0U);
+
+  // Loads the APKs at `paths` like LoadShared(), opening and parsing them concurrently, and returns
+  // once all of them are loaded. The result holds the ApkAssets of each path at the same index,
+  // or nullptr if that APK failed to load.
+  static std::vector<std::shared_ptr<const ApkAssets>> LoadAllShared(
+      const std::vector<std::string>& paths, package_property_t flags = 0U);
+
   // Creates an ApkAssets from the given file descriptor, and takes ownership of the file
   // descriptor. The `friendly_name` is some name that will be used to identify the source of
   // this ApkAssets in log messages and other debug scenarios.
@@ -338,6 +338,8 @@ public:
     virtual bool isAllocated(void) const { return mBuf != NULL; }
 
 private:
+    bool inflateTo(unsigned char* buf);
+
     off64_t     mStart;         // offset to start of compressed data
     off64_t     mCompressedLen; // length of the compressed data
     off64_t     mUncompressedLen; // length of the uncompressed data
@@ -21,8 +21,10 @@
 
 #include <array>
 #include <limits>
+#include <map>
 #include <set>
 #include <unordered_map>
+#include <utility>
 
 #include "androidfw/ApkAssets.h"
 #include "androidfw/Asset.h"
@@ -72,7 +74,34 @@ struct ResolvedBag {
   Entry entries[0];
 };
 
-struct FindEntryResult;
+// The result of a successful AssetManager2::FindEntry() lookup.
+struct FindEntryResult {
+  // A pointer to the resource table entry for this resource.
+  // If the size of the entry is > sizeof(ResTable_entry), it can be cast to
+  // a ResTable_map_entry and processed as a bag/map.
+  ResTable_entry_handle entry;
+
+  // The configuration for which the resulting entry was defined. This is already swapped to host
+  // endianness.
+  ResTable_config config;
+
+  // The bitmask of configuration axis with which the resource value varies.
+  uint32_t type_flags;
+
+  // The dynamic package ID map for the package from which this resource came from.
+  const DynamicRefTable* dynamic_ref_table;
+
+  // The package name of the resource.
+  const std::string* package_name;
+
+  // The string pool reference to the type's name. This uses a different string pool than
+  // the global string pool, but this is hidden from the caller.
+  StringPoolRef type_string_ref;
+
+  // The string pool reference to the entry's name. This uses a different string pool than
+  // the global string pool, but this is hidden from the caller.
+  StringPoolRef entry_string_ref;
+};
 
 // AssetManager2 is the main entry point for accessing assets and resources.
 // AssetManager2 provides caching of resources retrieved via the underlying ApkAssets.
@@ -291,6 +320,15 @@ class AssetManager2 {
   struct FilteredConfigGroup {
       std::vector<ResTable_config> configurations;
       std::vector<const ResTable_type*> types;
+
+      // A bitmask of the configuration axis specified by any configuration of the type, matched
+      // or not. Only a change along one of these axis can change which configurations match.
+      uint32_t config_axes = 0u;
+
+      // Whether the group has been filtered against the current configuration. Groups are only
+      // filtered the first time their type is looked up, so that the types of lazily loaded
+      // packages are not all built up front.
+      bool filtered = false;
   };
 
   // Represents an single package.
@@ -301,7 +339,7 @@ class AssetManager2 {
       // A mutable AssetManager-specific list of configurations that match the AssetManager's
       // current configuration. This is used as an optimization to avoid checking every single
       // candidate configuration when looking up resources.
-      ByteBucketArray<FilteredConfigGroup> filtered_configs_;
+      mutable ByteBucketArray<FilteredConfigGroup> filtered_configs_;
   };
 
   // Represents a Runtime Resource Overlay that overlays resources in the logical package.
@@ -355,6 +393,12 @@ class AssetManager2 {
                                     bool /*stop_at_first_match*/,
                                     bool ignore_configuration, FindEntryResult* out_entry) const;
 
+  // Returns the configurations of the type at `type_idx` that match the set configuration,
+  // filtering them first if the type has not been looked up since the filters were invalidated.
+  const FilteredConfigGroup& GetFilteredConfigGroup(const ConfiguredPackage& package,
+                                                    const TypeSpec* type_spec,
+                                                    uint8_t type_idx) const;
+
   // Assigns package IDs to all shared library ApkAssets.
   // Should be called whenever the ApkAssets are changed.
   void BuildDynamicRefTable();
@@ -363,10 +407,16 @@ class AssetManager2 {
   // bitmask `diff`.
   void InvalidateCaches(uint32_t diff);
 
-  // Triggers the re-construction of lists of types that match the set configuration.
+  // Invalidates the lists of types that match the set configuration. They are rebuilt for each
+  // type the next time it is looked up.
   // This should always be called when mutating the AssetManager's configuration or ApkAssets set.
   void RebuildFilterList(bool filter_incompatible_configs = true);
 
+  // Invalidates only the filtered types that have configurations varying along the configuration
+  // axis denoted by the bitmask `diff`.
+  // This should be called when mutating the AssetManager's configuration.
+  void RebuildFilterList(uint32_t diff);
+
   // Retrieves the APK paths of overlays that overlay non-system packages.
   std::set<std::string> GetNonSystemOverlayPaths() const;
 
@@ -392,6 +442,10 @@ class AssetManager2 {
   // may need to be purged.
   ResTable_config configuration_;
 
+  // Whether the filtered configurations of the ConfiguredPackages only contain the configurations
+  // that match configuration_.
+  bool filtered_incompatible_configs_ = true;
+
   // Cached set of bags. These are cached because they can inherit keys from parent bags,
   // which involves some calculation.
   std::unordered_map<uint32_t, util::unique_cptr<ResolvedBag>> cached_bags_;
@@ -400,6 +454,26 @@ class AssetManager2 {
   // a number of times for each view during View inspection.
   std::unordered_map<uint32_t, std::vector<uint32_t>> cached_bag_resid_stacks_;
 
+  // A resolved entry for the current configuration, as returned by FindEntry().
+  struct CachedEntry {
+    ApkAssetsCookie cookie;
+    FindEntryResult result;
+
+    // The configuration axis with which the target resource or any of its overlays vary.
+    // A configuration change along one of these axis purges this entry.
+    uint32_t type_flags;
+  };
+
+  // Cached set of resolved entries, keyed by resource ID and density override. These are cached
+  // because resolving an entry walks every package, overlay and candidate configuration, and the
+  // same resources are looked up repeatedly (e.g. during layout inflation).
+  mutable std::unordered_map<uint64_t, CachedEntry> cached_entries_;
+
+  // Cached themes, keyed by the stack of styles (and their `force` flag) applied to an empty theme
+  // to build them. Themes that apply the same stack of styles share the packages of these themes
+  // copy-on-write instead of building their own (see Theme::ApplyStyle()).
+  std::map<std::vector<std::pair<uint32_t, bool>>, std::unique_ptr<Theme>> cached_themes_;
+
   // Whether or not to save resource resolution steps
   bool resource_resolution_logging_enabled_ = false;
 
@@ -517,8 +591,16 @@ class Theme {
   // Defined in the cpp.
   struct Package;
 
+  // Packages, and the types within them, are shared between themes and copied only when a theme
+  // modifies them.
   constexpr static size_t kPackageCount = std::numeric_limits<uint8_t>::max() + 1;
-  std::array<std::unique_ptr<Package>, kPackageCount> packages_;
+  std::array<std::shared_ptr<Package>, kPackageCount> packages_;
+
+  // The styles applied to this theme since it was last cleared. This is only valid if this theme
+  // was built solely by applying these styles, and is used to share the packages of themes
+  // cached in AssetManager2::cached_themes_.
+  std::vector<std::pair<uint32_t, bool>> style_stack_;
+  bool style_stack_valid_ = true;
 };
 
 inline const ResolvedBag::Entry* begin(const ResolvedBag* bag) {
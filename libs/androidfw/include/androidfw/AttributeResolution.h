@@ -17,6 +17,10 @@
 #ifndef ANDROIDFW_ATTRIBUTERESOLUTION_H
 #define ANDROIDFW_ATTRIBUTERESOLUTION_H
 
+#include <vector>
+
+#include "android-base/macros.h"
+
 #include "androidfw/AssetManager2.h"
 #include "androidfw/ResourceTypes.h"
 
@@ -55,6 +59,53 @@ void ApplyStyle(Theme* theme, ResXMLParser* xml_parser, uint32_t def_style_attr,
                 uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
                 uint32_t* out_values, uint32_t* out_indices);
 
+// Memoizes the values that ApplyStyle() resolves from the default style and the theme. These only
+// depend on the requested attributes, the default style attribute and the default style resource,
+// so they are resolved once for all the views of the same tag within one layout inflation.
+// An ApplyStyleCache may only be used while its theme and the theme's AssetManager are unchanged.
+class ApplyStyleCache {
+ public:
+  explicit ApplyStyleCache(Theme* theme) : theme_(theme) {
+  }
+
+  inline Theme* GetTheme() const {
+    return theme_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ApplyStyleCache);
+
+  friend void ApplyStyle(ApplyStyleCache* cache, ResXMLParser* xml_parser, uint32_t def_style_attr,
+                         uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
+                         uint32_t* out_values, uint32_t* out_indices);
+
+  struct Entry {
+    uint32_t def_style_attr;
+    uint32_t def_style_resid;
+    std::vector<uint32_t> attrs;
+
+    // The values of `attrs` resolved without any XML attributes or XML style, laid out like the
+    // `out_values` of ApplyStyle().
+    std::vector<uint32_t> values;
+  };
+
+  // Returns the resolved values for the given default style and attributes, resolving them on
+  // first use.
+  const uint32_t* GetDefaultValues(uint32_t def_style_attr, uint32_t def_style_resid,
+                                   const uint32_t* attrs, size_t attrs_length);
+
+  Theme* theme_;
+  std::vector<Entry> entries_;
+};
+
+// Like ApplyStyle() above, but reuses the values resolved from the default style and the theme of
+// previous calls with the same `cache`, default style and attributes.
+// `out_values` must NOT be nullptr.
+// `out_indices` is NOT optional and must NOT be nullptr.
+void ApplyStyle(ApplyStyleCache* cache, ResXMLParser* xml_parser, uint32_t def_style_attr,
+                uint32_t def_style_resid, const uint32_t* attrs, size_t attrs_length,
+                uint32_t* out_values, uint32_t* out_indices);
+
 // `out_values` must NOT be nullptr.
 // `out_indices` may be nullptr.
 bool RetrieveAttributes(AssetManager2* assetmanager, ResXMLParser* xml_parser, uint32_t* attrs,
@@ -40,11 +40,12 @@
 namespace android {
 
 /**
- * This class stores a set of rows from a database in a buffer. The begining of the
- * window has first chunk of RowSlots, which are offsets to the row directory, followed by
- * an offset to the next chunk in a linked-list of additional chunk of RowSlots in case
- * the pre-allocated chunk isn't big enough to refer to all rows. Each row directory has a
- * FieldSlot per column, which has the size, offset, and type of the data for that field.
+ * This class stores a set of rows from a database in a buffer. The beginning of the
+ * window has a header, followed by the row data that grows towards the end of the window.
+ * The end of the window holds a contiguous directory of RowSlots, which are offsets to the
+ * row directories, that grows towards the beginning of the window so that any row can be
+ * found with a single indexed load. Each row directory has a FieldSlot per column, which has
+ * the size, offset, and type of the data for that field.
  * Note that the data types come from sqlite3.h.
  *
  * Strings are stored in UTF-8.
@@ -88,7 +89,7 @@ public:
 
     inline String8 name() { return mName; }
     inline size_t size() { return mSize; }
-    inline size_t freeSpace() { return mSize - mHeader->freeOffset; }
+    inline size_t freeSpace() { return mHeader->slotsOffset - mHeader->freeOffset; }
     inline uint32_t getNumRows() { return mHeader->numRows; }
     inline uint32_t getNumColumns() { return mHeader->numColumns; }
 
@@ -139,14 +140,14 @@ public:
     }
 
 private:
-    static const size_t ROW_SLOT_CHUNK_NUM_ROWS = 100;
-
     struct Header {
         // Offset of the lowest unused byte in the window.
         uint32_t freeOffset;
 
-        // Offset of the first row slot chunk.
-        uint32_t firstChunkOffset;
+        // Offset of the row slot of the last row. The row slots of the previous rows follow
+        // it contiguously up to the end of the window, so that the slot of the first row
+        // is the last one in the window.
+        uint32_t slotsOffset;
 
         uint32_t numRows;
         uint32_t numColumns;
@@ -156,11 +157,6 @@ private:
         uint32_t offset;
     };
 
-    struct RowSlotChunk {
-        RowSlot slots[ROW_SLOT_CHUNK_NUM_ROWS];
-        uint32_t nextChunkOffset;
-    };
-
     String8 mName;
     int mAshmemFd;
     void* mData;
@@ -21,6 +21,7 @@
 #include <string>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include "android-base/macros.h"
 #include "androidfw/StringPiece.h"
@@ -74,6 +75,32 @@ class OverlayDynamicRefTable : public DynamicRefTable {
   friend IdmapResMap;
 };
 
+// An index over the target entries of an idmap. Target entries are sorted by resource id, so the
+// entries of each target type form a contiguous range. Types whose entry ids are densely populated
+// additionally get a direct lookup table from entry id to target entry.
+struct IdmapTargetIndex {
+  static constexpr uint32_t kNoEntry = 0xffffffffU;
+
+  struct Type {
+    // The range of target entries that belong to this type.
+    uint32_t first_entry = 0U;
+    uint32_t entry_count = 0U;
+
+    // The direct lookup table of the type covers entry ids [min_entry_id, min_entry_id + span).
+    // A span of 0 means the type is too sparse and its range is binary searched instead.
+    uint32_t min_entry_id = 0U;
+    uint32_t span = 0U;
+    uint32_t lookup_offset = 0U;
+  };
+
+  // Indexed by the type id (not the type index) of the target resource.
+  std::vector<Type> types;
+
+  // Concatenated lookup tables of the dense types, holding indices into the target entries or
+  // kNoEntry.
+  std::vector<uint32_t> lookup;
+};
+
 // A mapping of target resource ids to a values or resource ids that should overlay the target.
 class IdmapResMap {
  public:
@@ -123,11 +150,17 @@ class IdmapResMap {
  private:
   explicit IdmapResMap(const Idmap_data_header* data_header,
                        const Idmap_target_entry* entries,
+                       const IdmapTargetIndex* target_index,
                        uint8_t target_assigned_package_id,
                        const OverlayDynamicRefTable* overlay_ref_table);
 
+  // Returns the target entry for the build-time target resource id, or nullptr if the resource is
+  // not overlaid.
+  const Idmap_target_entry* FindTargetEntry(uint32_t target_res_id) const;
+
   const Idmap_data_header* data_header_;
   const Idmap_target_entry* entries_;
+  const IdmapTargetIndex* target_index_;
   const uint8_t target_assigned_package_id_;
   const OverlayDynamicRefTable* overlay_ref_table_;
 
@@ -163,7 +196,7 @@ class LoadedIdmap {
   // Returns a mapping from target resource ids to overlay values.
   inline const IdmapResMap GetTargetResourcesMap(
       uint8_t target_assigned_package_id, const OverlayDynamicRefTable* overlay_ref_table) const {
-    return IdmapResMap(data_header_, target_entries_, target_assigned_package_id,
+    return IdmapResMap(data_header_, target_entries_, &target_index_, target_assigned_package_id,
                        overlay_ref_table);
   }
 
@@ -186,6 +219,7 @@ class LoadedIdmap {
   const Idmap_target_entry* target_entries_;
   const Idmap_overlay_entry* overlay_entries_;
   const std::unique_ptr<ResStringPool> string_pool_;
+  const IdmapTargetIndex target_index_;
 
   const std::string idmap_path_;
   std::string overlay_apk_path_;
@@ -201,7 +235,8 @@ class LoadedIdmap {
                        const Idmap_data_header* data_header,
                        const Idmap_target_entry* target_entries,
                        const Idmap_overlay_entry* overlay_entries,
-                       ResStringPool* string_pool);
+                       ResStringPool* string_pool,
+                       IdmapTargetIndex&& target_index);
 
   friend OverlayStringPool;
 };
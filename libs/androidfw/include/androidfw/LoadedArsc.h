@@ -18,6 +18,7 @@
 #define LOADEDARSC_H_
 
 #include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 #include <unordered_map>
@@ -87,6 +88,11 @@ enum : package_property_t {
 
   // The package is a RRO.
   PROPERTY_OVERLAY = 1U << 3U,
+
+  // Only the RES_TABLE_TYPE_SPEC_TYPE chunks of the package are indexed when it is loaded. The
+  // RES_TABLE_TYPE_TYPE chunks of a type are validated and indexed the first time the type is
+  // accessed. Malformed type chunks are then skipped instead of failing the load.
+  PROPERTY_LAZY_TYPES = 1U << 4U,
 };
 
 // TypeSpecPtr points to a block of memory that holds a TypeSpec struct, followed by an array of
@@ -231,16 +237,16 @@ class LoadedPackage {
   inline const TypeSpec* GetTypeSpecByTypeIndex(uint8_t type_index) const {
     // If the type IDs are offset in this package, we need to take that into account when searching
     // for a type.
-    return type_specs_[type_index - type_id_offset_].get();
+    return GetTypeSpec(type_index - type_id_offset_);
   }
 
   template <typename Func>
   void ForEachTypeSpec(Func f) const {
     for (size_t i = 0; i < type_specs_.size(); i++) {
-      const TypeSpecPtr& ptr = type_specs_[i];
+      const TypeSpec* ptr = GetTypeSpec(i);
       if (ptr != nullptr) {
         uint8_t type_id = ptr->type_spec->id;
-        f(ptr.get(), type_id - 1);
+        f(ptr, type_id - 1);
       }
     }
   }
@@ -273,6 +279,65 @@ class LoadedPackage {
 
   LoadedPackage();
 
+  // The location of the type chunks of a type that has not been accessed yet.
+  // Only used when the package was loaded with PROPERTY_LAZY_TYPES.
+  struct LazyTypeSpec {
+    const ResTable_typeSpec* type_spec = nullptr;
+
+    // The range of the package chunk that holds every RES_TABLE_TYPE_TYPE chunk of the type.
+    // Chunks of other types may be interleaved and are skipped when the type is built.
+    const uint8_t* types_begin = nullptr;
+    const uint8_t* types_end = nullptr;
+
+    std::once_flag built;
+  };
+
+  // type_idx is the index into type_specs_, with the type ID offset already applied.
+  inline const TypeSpec* GetTypeSpec(size_t type_idx) const {
+    if ((property_flags_ & PROPERTY_LAZY_TYPES) != 0U) {
+      return GetLazyTypeSpec(type_idx);
+    }
+    return type_specs_[type_idx].get();
+  }
+
+  // Validates and indexes the type chunks of the type at `type_idx` on first access.
+  // Thread-safe.
+  const TypeSpec* GetLazyTypeSpec(size_t type_idx) const;
+
+  // Hashed index of the resource names of this package, used by FindEntryByName().
+  struct NameIndex {
+    // Hashes of the UTF-8 key strings and their indices in the key string pool,
+    // sorted by hash.
+    std::vector<std::pair<uint32_t, uint32_t>> key_hashes;
+
+    struct Entry {
+      uint32_t entry_idx;
+      uint32_t key_idx;
+    };
+
+    // The entries of one type, built when the type is first searched, so that looking up a name
+    // doesn't build every lazily loaded type of the package.
+    struct TypeEntries {
+      std::once_flag built;
+      // The first entry of every key in the type, sorted by key.
+      std::vector<Entry> entries;
+    };
+
+    // Indexed by type_idx; type_count slots.
+    std::unique_ptr<TypeEntries[]> types;
+    size_t type_count = 0;
+  };
+
+  // Builds the key part of the name index on first access. Thread-safe.
+  const NameIndex& GetNameIndex() const;
+
+  // Returns the entries of the type at `type_idx`, building them on first access. Thread-safe.
+  const std::vector<NameIndex::Entry>& GetNameIndexEntries(const TypeSpec* type_spec,
+                                                          size_t type_idx) const;
+
+  // Returns the index of `entry_name` in the key string pool, or -1 if it is not there.
+  ssize_t FindKeyIndex(const std::u16string& entry_name) const;
+
   ResStringPool type_string_pool_;
   ResStringPool key_string_pool_;
   std::string package_name_;
@@ -281,13 +346,19 @@ class LoadedPackage {
   int type_id_offset_ = 0;
   package_property_t property_flags_ = 0U;
 
-  ByteBucketArray<TypeSpecPtr> type_specs_;
+  // Mutable so that lazily loaded types can be built on first access. The slot of every type is
+  // allocated at load time, so building a type never reallocates a bucket read by another thread.
+  mutable ByteBucketArray<TypeSpecPtr> type_specs_;
+  ByteBucketArray<std::unique_ptr<LazyTypeSpec>> lazy_type_specs_;
   ByteBucketArray<uint32_t> resource_ids_;
   std::vector<DynamicPackageEntry> dynamic_package_map_;
   std::vector<const std::pair<OverlayableInfo, std::unordered_set<uint32_t>>> overlayable_infos_;
 
   // A map of overlayable name to actor
   std::unordered_map<std::string, std::string> overlayable_map_;
+
+  mutable std::once_flag name_index_built_;
+  mutable std::unique_ptr<NameIndex> name_index_;
 };
 
 // Read-only view into a resource table. This class validates all data
@@ -36,6 +36,7 @@
 #include <android/configuration.h>
 
 #include <array>
+#include <atomic>
 #include <memory>
 
 namespace android {
@@ -536,17 +537,31 @@ private:
     void*                       mOwnedData;
     const ResStringPool_header* mHeader;
     size_t                      mSize;
-    mutable Mutex               mDecodeLock;
     const uint32_t*             mEntries;
     const uint32_t*             mEntryStyles;
     const void*                 mStrings;
-    char16_t mutable**          mCache;
+    // Number of strings whose UTF-16 decodings share one page of mCache.
+    static constexpr size_t kCachePageSize = 256;
+    struct CachePage {
+        std::atomic<char16_t*> strings[kCachePageSize];
+    };
+    // Lazily allocated UTF-16 decodings of the strings of a UTF-8 pool. The page table, its
+    // pages and their entries are published with compare-and-swap so that readers never take a
+    // lock. A page is only allocated once one of its strings is decoded, so large pools that
+    // are mostly unused do not pay for a slot per string. Entries are never evicted, because
+    // stringAt() hands out pointers that stay valid for the lifetime of the pool, which rules
+    // out a bounded or LRU cache.
+    mutable std::atomic<std::atomic<CachePage*>*> mCache;
     uint32_t                    mStringPoolSize;    // number of uint16_t
     const uint32_t*             mStyles;
     uint32_t                    mStylePoolSize;    // number of uint32_t
 
     const char* stringDecodeAt(size_t idx, const uint8_t* str, const size_t encLen,
                                size_t* outLen) const;
+
+    // Returns the cache entry of the string at |idx|, allocating its page if needed.
+    // Returns NULL if out of memory.
+    std::atomic<char16_t*>* cacheEntryAt(size_t idx) const;
 };
 
 /**
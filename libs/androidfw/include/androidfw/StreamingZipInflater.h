@@ -30,8 +30,10 @@ public:
     static const size_t INPUT_CHUNK_SIZE = 64 * 1024;
     static const size_t OUTPUT_CHUNK_SIZE = 64 * 1024;
 
-    // Flavor that pages in the compressed data from a fd
-    StreamingZipInflater(int fd, off64_t compDataStart, size_t uncompSize, size_t compSize);
+    // Flavor that pages in the compressed data from a fd, reading up to 'readAheadSize'
+    // bytes of it at a time
+    StreamingZipInflater(int fd, off64_t compDataStart, size_t uncompSize, size_t compSize,
+            size_t readAheadSize = INPUT_CHUNK_SIZE);
 
     // Flavor that gets the compressed data from an in-memory buffer
     StreamingZipInflater(class FileMap* dataMap, size_t uncompSize);
@@ -28,6 +28,7 @@ using ::android::base::unique_fd;
 using ::com::android::basic::R;
 using ::testing::Eq;
 using ::testing::Ge;
+using ::testing::IsNull;
 using ::testing::NotNull;
 using ::testing::SizeIs;
 using ::testing::StrEq;
@@ -59,6 +60,40 @@ TEST(ApkAssetsTest, LoadApkFromFd) {
   ASSERT_THAT(loaded_apk->GetAssetsProvider()->Open("res/layout/main.xml"), NotNull());
 }
 
+TEST(ApkAssetsTest, LoadSharedApk) {
+  const std::string path = GetTestDataPath() + "/basic/basic.apk";
+  std::shared_ptr<const ApkAssets> loaded_apk = ApkAssets::LoadShared(path);
+  ASSERT_THAT(loaded_apk, NotNull());
+  ASSERT_THAT(loaded_apk->GetLoadedArsc()->GetPackageById(0x7fu), NotNull());
+
+  // Loading the same APK again returns the same instance.
+  std::shared_ptr<const ApkAssets> other_loaded_apk = ApkAssets::LoadShared(path);
+  EXPECT_THAT(other_loaded_apk.get(), Eq(loaded_apk.get()));
+
+  // Loading the APK with different flags returns a different instance.
+  std::shared_ptr<const ApkAssets> system_loaded_apk = ApkAssets::LoadShared(path, PROPERTY_SYSTEM);
+  ASSERT_THAT(system_loaded_apk, NotNull());
+  EXPECT_NE(system_loaded_apk.get(), loaded_apk.get());
+}
+
+TEST(ApkAssetsTest, LoadAllSharedApks) {
+  const std::string basic_path = GetTestDataPath() + "/basic/basic.apk";
+  const std::string lib_path = GetTestDataPath() + "/appaslib/appaslib.apk";
+  std::shared_ptr<const ApkAssets> loaded_basic_apk = ApkAssets::LoadShared(basic_path);
+  ASSERT_THAT(loaded_basic_apk, NotNull());
+
+  std::vector<std::shared_ptr<const ApkAssets>> loaded_apks = ApkAssets::LoadAllShared(
+      {basic_path, GetTestDataPath() + "/does_not_exist.apk", lib_path, basic_path});
+  ASSERT_THAT(loaded_apks, SizeIs(4u));
+
+  // APKs are returned in the order of their paths, and are shared like with LoadShared().
+  EXPECT_THAT(loaded_apks[0].get(), Eq(loaded_basic_apk.get()));
+  EXPECT_THAT(loaded_apks[1], IsNull());
+  ASSERT_THAT(loaded_apks[2], NotNull());
+  EXPECT_THAT(loaded_apks[2]->GetPath(), Eq(lib_path));
+  EXPECT_THAT(loaded_apks[3].get(), Eq(loaded_basic_apk.get()));
+}
+
 TEST(ApkAssetsTest, LoadApkAsSharedLibrary) {
   std::unique_ptr<const ApkAssets> loaded_apk =
       ApkAssets::Load(GetTestDataPath() + "/appaslib/appaslib.apk");
@@ -60,11 +60,13 @@ BENCHMARK(BM_AssetManagerLoadAssetsOld);
 
 static void BM_AssetManagerLoadFrameworkAssets(benchmark::State& state) {
   std::string path = kFrameworkPath;
+  const size_t start_allocs = GetAllocationCount();
   while (state.KeepRunning()) {
     std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(path);
     AssetManager2 assets;
     assets.SetApkAssets({apk.get()});
   }
+  ReportAllocationsPerOp(start_allocs, state);
 }
 BENCHMARK(BM_AssetManagerLoadFrameworkAssets);
 
@@ -252,4 +254,73 @@ static void BM_AssetManagerSetConfigurationFrameworkOld(benchmark::State& state)
 }
 BENCHMARK(BM_AssetManagerSetConfigurationFrameworkOld);
 
+static void BM_AssetManagerSetConfigurationOrientationFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  assets.SetApkAssets({apk.get()});
+
+  ResTable_config config;
+  memset(&config, 0, sizeof(config));
+  config.orientation = ResTable_config::ORIENTATION_PORT;
+
+  // Rotation only changes the orientation, which few types vary by.
+  const size_t start_allocs = GetAllocationCount();
+  while (state.KeepRunning()) {
+    config.orientation = config.orientation == ResTable_config::ORIENTATION_PORT
+                             ? ResTable_config::ORIENTATION_LAND
+                             : ResTable_config::ORIENTATION_PORT;
+    assets.SetConfiguration(config);
+  }
+  ReportAllocationsPerOp(start_allocs, state);
+}
+BENCHMARK(BM_AssetManagerSetConfigurationOrientationFramework);
+
+static void BM_AssetManagerGetResourceIdFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  assets.SetApkAssets({apk.get()});
+
+  const size_t start_allocs = GetAllocationCount();
+  while (state.KeepRunning()) {
+    uint32_t resid = assets.GetResourceId("ok", "string", "android");
+    benchmark::DoNotOptimize(resid);
+  }
+  ReportAllocationsPerOp(start_allocs, state);
+}
+BENCHMARK(BM_AssetManagerGetResourceIdFramework);
+
+constexpr static const uint32_t kDeepStyleId = 0x01030237u;  // android:style/Theme.Material.Light
+
+static void BM_AssetManagerGetBagDeepUncachedFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  const size_t start_allocs = GetAllocationCount();
+  while (state.KeepRunning()) {
+    // Resetting the ApkAssets purges the bag cache, so every parent of the style is merged again.
+    PauseTiming(state);
+    assets.SetApkAssets({apk.get()});
+    ResumeTiming(state);
+
+    const ResolvedBag* bag = assets.GetBag(kDeepStyleId);
+    benchmark::DoNotOptimize(bag);
+  }
+  ReportAllocationsPerOp(start_allocs, state);
+}
+BENCHMARK(BM_AssetManagerGetBagDeepUncachedFramework);
+
 }  // namespace android
@@ -79,7 +79,7 @@ static void BM_ApplyStyle(benchmark::State& state) {
 }
 BENCHMARK(BM_ApplyStyle);
 
-static void BM_ApplyStyleFramework(benchmark::State& state) {
+static void ApplyStyleFrameworkBenchmark(bool use_cache, benchmark::State& state) {
   std::unique_ptr<const ApkAssets> framework_apk = ApkAssets::Load(kFrameworkPath);
   if (framework_apk == nullptr) {
     state.SkipWithError("failed to load framework assets");
@@ -165,11 +165,29 @@ static void BM_ApplyStyleFramework(benchmark::State& state) {
 
   std::array<uint32_t, attrs.size() * STYLE_NUM_ENTRIES> values;
   std::array<uint32_t, attrs.size() + 1> indices;
+  ApplyStyleCache cache(theme.get());
+  const size_t start_allocs = GetAllocationCount();
   while (state.KeepRunning()) {
-    ApplyStyle(theme.get(), &xml_tree, 0x01010084u /*def_style_attr*/, 0u /*def_style_res*/,
-               attrs.data(), attrs.size(), values.data(), indices.data());
+    if (use_cache) {
+      // Every view of the same tag in one inflation shares the cache.
+      ApplyStyle(&cache, &xml_tree, 0x01010084u /*def_style_attr*/, 0u /*def_style_res*/,
+                 attrs.data(), attrs.size(), values.data(), indices.data());
+    } else {
+      ApplyStyle(theme.get(), &xml_tree, 0x01010084u /*def_style_attr*/, 0u /*def_style_res*/,
+                 attrs.data(), attrs.size(), values.data(), indices.data());
+    }
   }
+  ReportAllocationsPerOp(start_allocs, state);
+}
+
+static void BM_ApplyStyleFramework(benchmark::State& state) {
+  ApplyStyleFrameworkBenchmark(false /*use_cache*/, state);
 }
 BENCHMARK(BM_ApplyStyleFramework);
 
+static void BM_ApplyStyleFrameworkWithCache(benchmark::State& state) {
+  ApplyStyleFrameworkBenchmark(true /*use_cache*/, state);
+}
+BENCHMARK(BM_ApplyStyleFrameworkWithCache);
+
 }  // namespace android
@@ -272,5 +272,29 @@ TEST_F(AttributeResolutionXmlTest, ThemeAndXmlParser) {
   EXPECT_EQ(expected_indices, indices);
 }
 
+TEST_F(AttributeResolutionXmlTest, ApplyStyleWithCache) {
+  std::unique_ptr<Theme> theme = assetmanager_.NewTheme();
+  ASSERT_TRUE(theme->ApplyStyle(R::style::StyleTwo));
+
+  std::array<uint32_t, 6> attrs{{R::attr::attr_one, R::attr::attr_two, R::attr::attr_three,
+                                 R::attr::attr_four, R::attr::attr_five, R::attr::attr_empty}};
+  std::array<uint32_t, attrs.size() * STYLE_NUM_ENTRIES> expected_values;
+  std::array<uint32_t, attrs.size() + 1> expected_indices;
+
+  ApplyStyle(theme.get(), &xml_parser_, 0u /*def_style_attr*/, R::style::StyleOne, attrs.data(),
+             attrs.size(), expected_values.data(), expected_indices.data());
+
+  // The values resolved from the default style and the theme are reused by subsequent calls.
+  ApplyStyleCache cache(theme.get());
+  for (int i = 0; i < 2; i++) {
+    std::array<uint32_t, attrs.size() * STYLE_NUM_ENTRIES> values;
+    std::array<uint32_t, attrs.size() + 1> indices;
+    ApplyStyle(&cache, &xml_parser_, 0u /*def_style_attr*/, R::style::StyleOne, attrs.data(),
+               attrs.size(), values.data(), indices.data());
+    EXPECT_EQ(expected_values, values);
+    EXPECT_EQ(expected_indices, indices);
+  }
+}
+
 } // namespace android
 
@@ -16,10 +16,41 @@
 
 #include "BenchmarkHelpers.h"
 
+#include <atomic>
+#include <cstdlib>
+
 #include "android-base/stringprintf.h"
 #include "androidfw/AssetManager.h"
 #include "androidfw/AssetManager2.h"
 
+static std::atomic<size_t> gAllocationCount{0u};
+static std::atomic<bool> gCountingAllocations{true};
+
+// Count every allocation made by the benchmarks while they are timed, so that allocations per
+// operation can be reported alongside timings.
+void* operator new(size_t size) {
+  if (gCountingAllocations.load(std::memory_order_relaxed)) {
+    gAllocationCount.fetch_add(1u, std::memory_order_relaxed);
+  }
+  void* ptr = malloc(size == 0u ? 1u : size);
+  if (ptr == nullptr) {
+    abort();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
 namespace android {
 
 void GetResourceBenchmarkOld(const std::vector<std::string>& paths, const ResTable_config* config,
@@ -83,4 +114,23 @@ void GetResourceBenchmark(const std::vector<std::string>& paths, const ResTable_
   }
 }
 
+size_t GetAllocationCount() {
+  return gAllocationCount.load(std::memory_order_relaxed);
+}
+
+void PauseTiming(benchmark::State& state) {
+  state.PauseTiming();
+  gCountingAllocations.store(false, std::memory_order_relaxed);
+}
+
+void ResumeTiming(benchmark::State& state) {
+  gCountingAllocations.store(true, std::memory_order_relaxed);
+  state.ResumeTiming();
+}
+
+void ReportAllocationsPerOp(size_t start_count, benchmark::State& state) {
+  state.counters["allocs/op"] = benchmark::Counter(
+      static_cast<double>(GetAllocationCount() - start_count), benchmark::Counter::kAvgIterations);
+}
+
 }  // namespace android
@@ -33,6 +33,20 @@ void GetResourceBenchmarkOld(const std::vector<std::string>& paths, const ResTab
 void GetResourceBenchmark(const std::vector<std::string>& paths, const ResTable_config* config,
                           uint32_t resid, benchmark::State& state);
 
+// Returns the number of heap allocations made through operator new so far by this process, leaving
+// out the ones made between PauseTiming() and ResumeTiming().
+size_t GetAllocationCount();
+
+// Pause and resume the timer of `state` along with the allocation count. Benchmarks that report
+// allocations per operation must use these instead of State::PauseTiming()/ResumeTiming(), so that
+// setup work outside the timed region isn't counted.
+void PauseTiming(benchmark::State& state);
+void ResumeTiming(benchmark::State& state);
+
+// Reports the average number of heap allocations per iteration made since `start_count` (as
+// returned by GetAllocationCount()) as the "allocs/op" counter of `state`.
+void ReportAllocationsPerOp(size_t start_count, benchmark::State& state);
+
 }  // namespace android
 
 #endif  // ANDROIDFW_TESTS_BENCHMARKHELPERS_H
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include "androidfw/CursorWindow.h"
+
+#include "TestHelpers.h"
+
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+namespace android {
+
+static constexpr size_t kWindowSize = 64 * 1024;
+
+static std::unique_ptr<CursorWindow> CreateWindow(size_t size = kWindowSize) {
+  CursorWindow* window = nullptr;
+  if (CursorWindow::create(String8("CursorWindowTest"), size, &window) != OK) {
+    return {};
+  }
+  return std::unique_ptr<CursorWindow>(window);
+}
+
+TEST(CursorWindowTest, RandomRowAccess) {
+  std::unique_ptr<CursorWindow> window = CreateWindow();
+  ASSERT_THAT(window, NotNull());
+  ASSERT_EQ(OK, window->setNumColumns(2));
+
+  // Use more rows than the old row slot chunks held to exercise the whole row slot directory.
+  constexpr uint32_t kNumRows = 1000;
+  for (uint32_t row = 0; row < kNumRows; row++) {
+    ASSERT_EQ(OK, window->allocRow());
+    ASSERT_EQ(OK, window->putLong(row, 0, row));
+    ASSERT_EQ(OK, window->putDouble(row, 1, row * 0.5));
+  }
+  ASSERT_EQ(kNumRows, window->getNumRows());
+
+  for (uint32_t row = kNumRows; row-- > 0;) {
+    CursorWindow::FieldSlot* field_slot = window->getFieldSlot(row, 0);
+    ASSERT_THAT(field_slot, NotNull());
+    ASSERT_EQ(CursorWindow::FIELD_TYPE_INTEGER, window->getFieldSlotType(field_slot));
+    EXPECT_EQ(row, window->getFieldSlotValueLong(field_slot));
+
+    field_slot = window->getFieldSlot(row, 1);
+    ASSERT_THAT(field_slot, NotNull());
+    ASSERT_EQ(CursorWindow::FIELD_TYPE_FLOAT, window->getFieldSlotType(field_slot));
+    EXPECT_EQ(row * 0.5, window->getFieldSlotValueDouble(field_slot));
+  }
+
+  EXPECT_THAT(window->getFieldSlot(kNumRows, 0), IsNull());
+}
+
+TEST(CursorWindowTest, FreeLastRowReleasesRowSlot) {
+  std::unique_ptr<CursorWindow> window = CreateWindow();
+  ASSERT_THAT(window, NotNull());
+  ASSERT_EQ(OK, window->setNumColumns(1));
+
+  ASSERT_EQ(OK, window->allocRow());
+  ASSERT_EQ(OK, window->putLong(0, 0, 42));
+  const size_t free_space = window->freeSpace();
+
+  ASSERT_EQ(OK, window->allocRow());
+  ASSERT_EQ(OK, window->freeLastRow());
+  ASSERT_EQ(1u, window->getNumRows());
+
+  ASSERT_EQ(OK, window->allocRow());
+  ASSERT_EQ(OK, window->putLong(1, 0, 43));
+  EXPECT_LT(window->freeSpace(), free_space);
+
+  CursorWindow::FieldSlot* field_slot = window->getFieldSlot(0, 0);
+  ASSERT_THAT(field_slot, NotNull());
+  EXPECT_EQ(42, window->getFieldSlotValueLong(field_slot));
+
+  field_slot = window->getFieldSlot(1, 0);
+  ASSERT_THAT(field_slot, NotNull());
+  EXPECT_EQ(43, window->getFieldSlotValueLong(field_slot));
+}
+
+TEST(CursorWindowTest, FullWindow) {
+  std::unique_ptr<CursorWindow> window = CreateWindow(4096);
+  ASSERT_THAT(window, NotNull());
+  ASSERT_EQ(OK, window->setNumColumns(1));
+
+  status_t status;
+  uint32_t num_rows = 0;
+  while ((status = window->allocRow()) == OK) {
+    ASSERT_EQ(OK, window->putLong(num_rows, 0, num_rows));
+    num_rows++;
+  }
+  EXPECT_EQ(NO_MEMORY, status);
+  ASSERT_EQ(num_rows, window->getNumRows());
+
+  // The rows that fit are still intact.
+  for (uint32_t row = 0; row < num_rows; row++) {
+    CursorWindow::FieldSlot* field_slot = window->getFieldSlot(row, 0);
+    ASSERT_THAT(field_slot, NotNull());
+    EXPECT_EQ(row, window->getFieldSlotValueLong(field_slot));
+  }
+}
+
+}  // namespace android
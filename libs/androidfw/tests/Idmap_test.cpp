@@ -244,6 +244,45 @@ TEST_F(IdmapTest, OverlayLoaderInterop) {
   ASSERT_EQ(GetStringFromApkAssets(asset_manager, val, cookie), "loader");
 }
 
+TEST_F(IdmapTest, TargetResourcesMapLookup) {
+  std::string idmap_contents;
+  ASSERT_TRUE(base::ReadFileToString("overlay/overlay.idmap", &idmap_contents));
+
+  auto loaded_idmap = LoadedIdmap::Load("overlay/overlay.idmap", idmap_contents);
+  ASSERT_NE(nullptr, loaded_idmap);
+
+  const OverlayDynamicRefTable ref_table = loaded_idmap->GetOverlayDynamicRefTable(0x7f);
+  const IdmapResMap res_map = loaded_idmap->GetTargetResourcesMap(0x7f, &ref_table);
+
+  // Resources that are mapped to overlay resources.
+  auto result = res_map.Lookup(overlayable::R::string::overlayable5);
+  ASSERT_TRUE(result);
+  ASSERT_TRUE(result.IsResourceId());
+
+  result = res_map.Lookup(overlayable::R::layout::hello_view);
+  ASSERT_TRUE(result);
+  ASSERT_TRUE(result.IsResourceId());
+
+  // Resources that are mapped to inline values.
+  result = res_map.Lookup(overlayable::R::integer::config_integer);
+  ASSERT_TRUE(result);
+  ASSERT_TRUE(result.IsTableEntry());
+  ResTable_entry_handle table_entry = result.GetTableEntry();
+  const Res_value* value = reinterpret_cast<const Res_value*>(
+      reinterpret_cast<const uint8_t*>(*table_entry) + sizeof(ResTable_entry));
+  EXPECT_EQ(Res_value::TYPE_INT_DEC, value->dataType);
+  EXPECT_EQ(42U, value->data);
+
+  // Resources that are not overlaid, including ones of types that have no overlaid entries and
+  // ones of types past the last overlaid type.
+  EXPECT_FALSE(res_map.Lookup(overlayable::R::string::not_overlayable));
+  EXPECT_FALSE(res_map.Lookup(overlayable::R::string::overlayable4));
+  EXPECT_FALSE(res_map.Lookup(overlayable::R::string::overlayable11 + 1U));
+  EXPECT_FALSE(res_map.Lookup(overlayable::R::boolean::config_bool));
+  EXPECT_FALSE(res_map.Lookup(0x7f070000));
+  EXPECT_FALSE(res_map.Lookup(0x7e010005));
+}
+
 TEST_F(IdmapTest, OverlayAssetsIsUpToDate) {
   std::string idmap_contents;
   ASSERT_TRUE(base::ReadFileToString("overlay/overlay.idmap", &idmap_contents));
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark/benchmark.h"
+
+#include "androidfw/ApkAssets.h"
+#include "androidfw/AssetManager2.h"
+#include "androidfw/ResourceTypes.h"
+
+#include "BenchmarkHelpers.h"
+
+namespace android {
+
+constexpr const static char* kFrameworkPath = "/system/framework/framework-res.apk";
+
+// Returns the global string pool of the framework, shared by all benchmark threads.
+static const ResStringPool* GetFrameworkStringPool() {
+  static const ApkAssets* apk = ApkAssets::Load(kFrameworkPath).release();
+  if (apk == nullptr) {
+    return nullptr;
+  }
+  return apk->GetLoadedArsc()->GetStringPool();
+}
+
+static void BM_ResStringPoolStringAtFramework(benchmark::State& state) {
+  const ResStringPool* pool = GetFrameworkStringPool();
+  if (pool == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  // Every thread decodes the same strings, so the UTF-16 decode cache is contended.
+  const size_t count = pool->size();
+  size_t idx = 0u;
+  const size_t start_allocs = GetAllocationCount();
+  while (state.KeepRunning()) {
+    size_t len;
+    const char16_t* str = pool->stringAt(idx, &len);
+    benchmark::DoNotOptimize(str);
+    idx = (idx + 1u) % count;
+  }
+  if (state.thread_index == 0) {
+    ReportAllocationsPerOp(start_allocs, state);
+  }
+}
+BENCHMARK(BM_ResStringPoolStringAtFramework)->Threads(1)->Threads(4);
+
+static void BM_ResStringPoolString8AtFramework(benchmark::State& state) {
+  const ResStringPool* pool = GetFrameworkStringPool();
+  if (pool == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  const size_t count = pool->size();
+  size_t idx = 0u;
+  while (state.KeepRunning()) {
+    size_t len;
+    const char* str = pool->string8At(idx, &len);
+    benchmark::DoNotOptimize(str);
+    idx = (idx + 1u) % count;
+  }
+}
+BENCHMARK(BM_ResStringPoolString8AtFramework)->Threads(1)->Threads(4);
+
+}  // namespace android
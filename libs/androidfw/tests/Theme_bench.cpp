@@ -21,11 +21,14 @@
 #include "androidfw/AssetManager2.h"
 #include "androidfw/ResourceTypes.h"
 
+#include "BenchmarkHelpers.h"
+
 namespace android {
 
 constexpr const static char* kFrameworkPath = "/system/framework/framework-res.apk";
 constexpr const static uint32_t kStyleId = 0x01030237u;  // android:style/Theme.Material.Light
 constexpr const static uint32_t kAttrId = 0x01010030u;   // android:attr/colorForeground
+constexpr const static uint32_t kOverlayStyleId = 0x01030224u;  // android:style/Theme.Material
 
 static void BM_ThemeApplyStyleFramework(benchmark::State& state) {
   std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
@@ -96,4 +99,49 @@ static void BM_ThemeGetAttributeOld(benchmark::State& state) {
 }
 BENCHMARK(BM_ThemeGetAttributeOld);
 
+static void BM_ThemeRebaseFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  assets.SetApkAssets({apk.get()});
+
+  // Theme.rebase() clears the theme and re-applies the same styles.
+  auto theme = assets.NewTheme();
+  const size_t start_allocs = GetAllocationCount();
+  while (state.KeepRunning()) {
+    theme->Clear();
+    theme->ApplyStyle(kStyleId, false /* force */);
+    theme->ApplyStyle(kOverlayStyleId, true /* force */);
+  }
+  ReportAllocationsPerOp(start_allocs, state);
+}
+BENCHMARK(BM_ThemeRebaseFramework);
+
+static void BM_ThemeSetToFramework(benchmark::State& state) {
+  std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(kFrameworkPath);
+  if (apk == nullptr) {
+    state.SkipWithError("Failed to load assets");
+    return;
+  }
+
+  AssetManager2 assets;
+  assets.SetApkAssets({apk.get()});
+
+  auto base_theme = assets.NewTheme();
+  base_theme->ApplyStyle(kStyleId, false /* force */);
+
+  const size_t start_allocs = GetAllocationCount();
+  while (state.KeepRunning()) {
+    auto theme = assets.NewTheme();
+    theme->SetTo(*base_theme);
+    theme->ApplyStyle(kOverlayStyleId, true /* force */);
+  }
+  ReportAllocationsPerOp(start_allocs, state);
+}
+BENCHMARK(BM_ThemeSetToFramework);
+
 }  // namespace android
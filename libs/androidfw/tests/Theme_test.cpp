@@ -210,6 +210,39 @@ TEST_F(ThemeTest, MultipleThemesOverlaidForced) {
   EXPECT_EQ(static_cast<uint32_t>(ResTable_typeSpec::SPEC_PUBLIC), flags);
 }
 
+TEST_F(ThemeTest, ThemesWithSameStylesDoNotAffectEachOther) {
+  AssetManager2 assetmanager;
+  assetmanager.SetApkAssets({style_assets_.get()});
+
+  std::unique_ptr<Theme> theme_one = assetmanager.NewTheme();
+  ASSERT_TRUE(theme_one->ApplyStyle(app::R::style::StyleTwo));
+
+  // The second theme shares the attributes of the first until it is modified.
+  std::unique_ptr<Theme> theme_two = assetmanager.NewTheme();
+  ASSERT_TRUE(theme_two->ApplyStyle(app::R::style::StyleTwo));
+  ASSERT_TRUE(theme_two->ApplyStyle(app::R::style::StyleThree, true /* force */));
+
+  Res_value value;
+  uint32_t flags;
+
+  ASSERT_NE(kInvalidCookie, theme_one->GetAttribute(app::R::attr::attr_five, &value, &flags));
+  EXPECT_EQ(Res_value::TYPE_REFERENCE, value.dataType);
+  EXPECT_EQ(app::R::string::string_one, value.data);
+  EXPECT_EQ(kInvalidCookie, theme_one->GetAttribute(app::R::attr::attr_six, &value, &flags));
+
+  ASSERT_NE(kInvalidCookie, theme_two->GetAttribute(app::R::attr::attr_five, &value, &flags));
+  EXPECT_EQ(Res_value::TYPE_INT_DEC, value.dataType);
+  EXPECT_EQ(5u, value.data);
+
+  // Rebasing the second theme onto the styles of the first makes them equal again.
+  theme_two->Clear();
+  ASSERT_TRUE(theme_two->ApplyStyle(app::R::style::StyleTwo));
+  ASSERT_NE(kInvalidCookie, theme_two->GetAttribute(app::R::attr::attr_five, &value, &flags));
+  EXPECT_EQ(Res_value::TYPE_REFERENCE, value.dataType);
+  EXPECT_EQ(app::R::string::string_one, value.data);
+  EXPECT_EQ(kInvalidCookie, theme_two->GetAttribute(app::R::attr::attr_six, &value, &flags));
+}
+
 TEST_F(ThemeTest, ResolveDynamicAttributesAndReferencesToSharedLibrary) {
   AssetManager2 assetmanager;
   assetmanager.SetApkAssets(
@@ -22,6 +22,9 @@
 
 #include <fcntl.h>
 #include <string.h>
+#include <zlib.h>
+
+#include <vector>
 
 namespace android {
 
@@ -66,4 +69,35 @@ TEST_F(ZipUtilsTest, ZipTimeConvertSuccess) {
     EXPECT_EQ(nullptr, t.tm_zone);
 }
 
+TEST_F(ZipUtilsTest, InflateToBufferFromMemory) {
+    std::vector<uint8_t> data(200 * 1024);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>((i * 7) ^ (i >> 9));
+    }
+
+    // Raw deflate, as stored in zip entries.
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+    ASSERT_EQ(Z_OK, deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+            Z_DEFAULT_STRATEGY));
+    std::vector<uint8_t> compressed(deflateBound(&zstream, data.size()));
+    zstream.next_in = data.data();
+    zstream.avail_in = data.size();
+    zstream.next_out = compressed.data();
+    zstream.avail_out = compressed.size();
+    ASSERT_EQ(Z_STREAM_END, deflate(&zstream, Z_FINISH));
+    compressed.resize(zstream.total_out);
+    deflateEnd(&zstream);
+
+    std::vector<uint8_t> inflated(data.size());
+    ASSERT_TRUE(ZipUtils::inflateToBuffer(compressed.data(), inflated.data(), inflated.size(),
+            compressed.size()));
+    EXPECT_EQ(data, inflated);
+
+    // The uncompressed size must match exactly.
+    std::vector<uint8_t> too_small(data.size() - 1);
+    EXPECT_FALSE(ZipUtils::inflateToBuffer(compressed.data(), too_small.data(),
+            too_small.size(), compressed.size()));
+}
+
 }
@@ -61,6 +61,7 @@ public:
     void endAllActiveAnimators();
 
     bool hasAnimators() { return mAnimators.size(); }
+    bool hasNewAnimators() { return mNewAnimators.size(); }
 
 private:
     uint32_t animateCommon(TreeInfo& info);
@@ -25,6 +25,7 @@
 #include <ui/ColorSpace.h>
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 
 #include <log/log.h>
@@ -54,7 +55,7 @@ static SkColor makeDark(SkColor color) {
     }
 }
 
-static SkColor transformColor(ColorTransform transform, SkColor color) {
+static SkColor computeTransformedColor(ColorTransform transform, SkColor color) {
     switch (transform) {
         case ColorTransform::Light:
             return makeLight(color);
@@ -65,6 +66,106 @@ static SkColor transformColor(ColorTransform transform, SkColor color) {
     }
 }
 
+// Force dark runs on the RenderThread, and the paints of a display list mostly share a handful
+// of colors, so the results of the Lab round trips and the objects built from them are kept in
+// small direct-mapped caches of the thread.
+static constexpr size_t kTransformCacheSize = 64;
+
+static size_t transformCacheSlot(ColorTransform transform, uint32_t key) {
+    key ^= static_cast<uint32_t>(transform) * 0x9E3779B9u;
+    key ^= key >> 16;
+    key *= 0x85EBCA6Bu;
+    key ^= key >> 13;
+    return key % kTransformCacheSize;
+}
+
+struct TransformedColor {
+    ColorTransform transform = ColorTransform::None;
+    SkColor source;
+    SkColor transformed;
+};
+
+struct TransformedColorFilter {
+    SkColor color;
+    SkBlendMode mode;
+    sk_sp<SkColorFilter> filter;
+};
+
+struct TransformedShader {
+    ColorTransform transform = ColorTransform::None;
+    // Holds a reference so that the address cannot be reused by another shader.
+    sk_sp<SkShader> source;
+    sk_sp<SkShader> transformed;
+};
+
+static thread_local std::array<TransformedColor, kTransformCacheSize> sTransformedColors;
+static thread_local std::array<TransformedColorFilter, kTransformCacheSize> sColorFilters;
+static thread_local std::array<TransformedShader, kTransformCacheSize> sShaders;
+
+static SkColor transformColor(ColorTransform transform, SkColor color) {
+    if (transform == ColorTransform::None) return color;
+
+    TransformedColor& entry = sTransformedColors[transformCacheSlot(transform, color)];
+    if (entry.transform != transform || entry.source != color) {
+        entry.transform = transform;
+        entry.source = color;
+        entry.transformed = computeTransformedColor(transform, color);
+    }
+    return entry.transformed;
+}
+
+// Blend filters are keyed on their already transformed color and mode, whatever the transform.
+static sk_sp<SkColorFilter> makeBlendColorFilter(SkColor color, SkBlendMode mode) {
+    TransformedColorFilter& entry = sColorFilters[transformCacheSlot(
+            ColorTransform::None, color ^ (static_cast<uint32_t>(mode) << 24))];
+    if (!entry.filter || entry.color != color || entry.mode != mode) {
+        entry.color = color;
+        entry.mode = mode;
+        entry.filter = SkColorFilters::Blend(color, mode);
+    }
+    return entry.filter;
+}
+
+static sk_sp<SkShader> transformShader(ColorTransform transform, SkShader* shader) {
+    TransformedShader& entry = sShaders[transformCacheSlot(
+            transform, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(shader) >> 4))];
+    if (entry.transform == transform && entry.source.get() == shader) {
+        return entry.transformed;
+    }
+
+    sk_sp<SkShader> transformed;
+    SkShader::GradientInfo info;
+    std::array<SkColor, 10> _colorStorage;
+    std::array<SkScalar, _colorStorage.size()> _offsetStorage;
+    info.fColorCount = _colorStorage.size();
+    info.fColors = _colorStorage.data();
+    info.fColorOffsets = _offsetStorage.data();
+    SkShader::GradientType type = shader->asAGradient(&info);
+
+    if (info.fColorCount <= 10) {
+        switch (type) {
+            case SkShader::kLinear_GradientType:
+                for (int i = 0; i < info.fColorCount; i++) {
+                    info.fColors[i] = transformColor(transform, info.fColors[i]);
+                }
+                transformed = SkGradientShader::MakeLinear(info.fPoint, info.fColors,
+                                                           info.fColorOffsets, info.fColorCount,
+                                                           info.fTileMode, info.fGradientFlags, nullptr);
+                break;
+            default:break;
+        }
+    }
+
+    // Only gradients are cached. Holding other shaders would keep them, and the bitmaps they
+    // sample, alive for as long as the slot is not reused.
+    if (transformed) {
+        entry.transform = transform;
+        entry.source = sk_ref_sp(shader);
+        entry.transformed = transformed;
+    }
+    return transformed;
+}
+
 static void applyColorTransform(ColorTransform transform, SkPaint& paint) {
     if (transform == ColorTransform::None) return;
 
@@ -72,37 +173,18 @@ static void applyColorTransform(ColorTransform transform, SkPaint& paint) {
     paint.setColor(newColor);
 
     if (paint.getShader()) {
-        SkShader::GradientInfo info;
-        std::array<SkColor, 10> _colorStorage;
-        std::array<SkScalar, _colorStorage.size()> _offsetStorage;
-        info.fColorCount = _colorStorage.size();
-        info.fColors = _colorStorage.data();
-        info.fColorOffsets = _offsetStorage.data();
-        SkShader::GradientType type = paint.getShader()->asAGradient(&info);
-
-        if (info.fColorCount <= 10) {
-            switch (type) {
-                case SkShader::kLinear_GradientType:
-                    for (int i = 0; i < info.fColorCount; i++) {
-                        info.fColors[i] = transformColor(transform, info.fColors[i]);
-                    }
-                    paint.setShader(SkGradientShader::MakeLinear(info.fPoint, info.fColors,
-                                                                 info.fColorOffsets, info.fColorCount,
-                                                                 info.fTileMode, info.fGradientFlags, nullptr));
-                    break;
-                default:break;
-            }
-
+        sk_sp<SkShader> shader = transformShader(transform, paint.getShader());
+        if (shader) {
+            paint.setShader(std::move(shader));
         }
     }
 
     if (paint.getColorFilter()) {
         SkBlendMode mode;
         SkColor color;
-        // TODO: LRU this or something to avoid spamming new color mode filters
         if (paint.getColorFilter()->asAColorMode(&color, &mode)) {
             color = transformColor(transform, color);
-            paint.setColorFilter(SkColorFilters::Blend(color, mode));
+            paint.setColorFilter(makeBlendColorFilter(color, mode));
         }
     }
 }
@@ -146,6 +146,9 @@ void DeferredLayerUpdater::apply() {
                     createReleaseFence, fenceWait, &mRenderState);
 
             if (hardwareBuffer) {
+                if (mImageSlots[slot].buffer() != hardwareBuffer) {
+                    releaseIncompatibleSlots(slot, hardwareBuffer);
+                }
                 sk_sp<SkImage> layerImage = mImageSlots[slot].createIfNeeded(
                         hardwareBuffer, dataspace, newContent,
                         mRenderState.getRenderThread().getGrContext());
@@ -170,6 +173,22 @@ void DeferredLayerUpdater::apply() {
     }
 }
 
+void DeferredLayerUpdater::releaseIncompatibleSlots(int slot, AHardwareBuffer* buffer) {
+    // A new buffer in a slot usually means the producer reallocated its buffers, e.g. when a
+    // video changes resolution. The images of the old buffers would otherwise keep them alive
+    // until their slots are reused, which may never happen, so they are released now. Images
+    // still used by the layer or by a frame in flight are kept alive by their own references.
+    AHardwareBuffer_Desc desc;
+    AHardwareBuffer_describe(buffer, &desc);
+    for (auto it = mImageSlots.begin(); it != mImageSlots.end();) {
+        if (it->first != slot && it->second.buffer() && !it->second.isCompatible(desc)) {
+            it = mImageSlots.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void DeferredLayerUpdater::updateLayer(bool forceFilter, const SkMatrix& textureTransform,
                                        const sk_sp<SkImage>& layerImage) {
     mLayer->setBlend(mBlend);
@@ -207,6 +226,9 @@ sk_sp<SkImage> DeferredLayerUpdater::ImageSlot::createIfNeeded(AHardwareBuffer*
         }
 
         mDataspace = dataspace;
+        if (mBuffer != buffer) {
+            AHardwareBuffer_describe(buffer, &mDesc);
+        }
         mBuffer = buffer;
         mTextureRelease->makeImage(buffer, dataspace, context);
     }
@@ -108,6 +108,15 @@ private:
         sk_sp<SkImage> createIfNeeded(AHardwareBuffer* buffer, android_dataspace dataspace,
                                       bool forceCreate, GrContext* context);
 
+        AHardwareBuffer* buffer() const { return mBuffer; }
+
+        // Whether the buffer of the slot has the same size and format as a buffer described
+        // by desc.
+        bool isCompatible(const AHardwareBuffer_Desc& desc) const {
+            return mBuffer && mDesc.width == desc.width && mDesc.height == desc.height &&
+                   mDesc.format == desc.format;
+        }
+
     private:
         void clear();
 
@@ -115,6 +124,7 @@ private:
         android_dataspace mDataspace = HAL_DATASPACE_UNKNOWN;
 
         AHardwareBuffer* mBuffer = nullptr;
+        AHardwareBuffer_Desc mDesc = {};
 
         /**
          * mTextureRelease may outlive DeferredLayerUpdater, if the last ref is held by an SkImage.
@@ -129,6 +139,8 @@ private:
      */
     std::map<int, ImageSlot> mImageSlots;
 
+    void releaseIncompatibleSlots(int slot, AHardwareBuffer* buffer);
+
     RenderState& mRenderState;
 
     // Generic properties
@@ -19,6 +19,7 @@
 #include "hwui/Bitmap.h"
 #include "renderthread/EglManager.h"
 #include "renderthread/VulkanManager.h"
+#include "thread/CommonPool.h"
 #include "thread/ThreadBase.h"
 #include "utils/TimeUtils.h"
 
@@ -32,7 +33,9 @@
 #include <utils/GLUtils.h>
 #include <utils/Trace.h>
 #include <utils/TraceUtils.h>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace android::uirenderer {
 
@@ -49,6 +52,14 @@ struct FormatInfo {
     bool valid = true;
 };
 
+// A single bitmap upload within a batch.
+struct PendingUpload {
+    SkBitmap bitmap;
+    FormatInfo format;
+    sp<GraphicBuffer> graphicBuffer;
+    bool uploaded = false;
+};
+
 class AHBUploader : public RefBase {
 public:
     virtual ~AHBUploader() {}
@@ -79,6 +90,14 @@ public:
         return result;
     }
 
+    // Uploads a batch of bitmaps under a single begin/end so that the uploader can pipeline them.
+    void uploadHardwareBitmaps(std::vector<PendingUpload>& uploads) {
+        ATRACE_CALL();
+        beginUpload();
+        onUploadHardwareBitmaps(uploads);
+        endUpload();
+    }
+
     void postIdleTimeoutCheck() {
         mUploadThread->queue().postDelayed(5000_ms, [this](){ this->idleTimeoutCheck(); });
     }
@@ -96,6 +115,14 @@ private:
                                         sp<GraphicBuffer> graphicBuffer) = 0;
     virtual void onBeginUpload() = 0;
 
+    // Uploads the bitmaps one at a time. Uploaders that can overlap transfers override this.
+    virtual void onUploadHardwareBitmaps(std::vector<PendingUpload>& uploads) {
+        for (auto& upload : uploads) {
+            upload.uploaded =
+                    onUploadHardwareBitmap(upload.bitmap, upload.format, upload.graphicBuffer);
+        }
+    }
+
     bool shouldTimeOutLocked() {
         nsecs_t durationSince = systemTime() - mLastUpload;
         return durationSince > 2000_ms;
@@ -223,6 +250,67 @@ private:
         return true;
     }
 
+    void onUploadHardwareBitmaps(std::vector<PendingUpload>& uploads) override {
+        ATRACE_CALL();
+
+        EGLDisplay display = getUploadEglDisplay();
+
+        LOG_ALWAYS_FATAL_IF(display == EGL_NO_DISPLAY, "Failed to get EGL_DEFAULT_DISPLAY! err=%s",
+                            uirenderer::renderthread::EglManager::eglErrorString());
+        std::vector<std::unique_ptr<AutoEglImage>> images;
+        images.reserve(uploads.size());
+        for (auto& upload : uploads) {
+            EGLClientBuffer clientBuffer = (EGLClientBuffer)upload.graphicBuffer->getNativeBuffer();
+            images.push_back(std::make_unique<AutoEglImage>(display, clientBuffer));
+            if (images.back()->image == EGL_NO_IMAGE_KHR) {
+                ALOGW("Could not create EGL image, err =%s",
+                      uirenderer::renderthread::EglManager::eglErrorString());
+            }
+        }
+
+        ATRACE_FORMAT("CPU -> gralloc batch transfer (%zu bitmaps)", uploads.size());
+        // Issue every transfer before creating the fence so that the batch is waited on once
+        // rather than once per bitmap.
+        EGLSyncKHR fence = mUploadThread->queue().runSync([&]() -> EGLSyncKHR {
+            for (size_t i = 0; i < uploads.size(); i++) {
+                if (images[i]->image == EGL_NO_IMAGE_KHR) {
+                    continue;
+                }
+                const SkBitmap& bitmap = uploads[i].bitmap;
+                const FormatInfo& format = uploads[i].format;
+                AutoSkiaGlTexture glTexture;
+                glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, images[i]->image);
+                if (GLUtils::dumpGLErrors()) {
+                    continue;
+                }
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, bitmap.width(), bitmap.height(),
+                                format.format, format.type, bitmap.getPixels());
+                uploads[i].uploaded = !GLUtils::dumpGLErrors();
+            }
+
+            EGLSyncKHR uploadFence =
+                    eglCreateSyncKHR(eglGetCurrentDisplay(), EGL_SYNC_FENCE_KHR, NULL);
+            if (uploadFence == EGL_NO_SYNC_KHR) {
+                ALOGW("Could not create sync fence %#x", eglGetError());
+            };
+            glFlush();
+            GLUtils::dumpGLErrors();
+            return uploadFence;
+        });
+
+        if (fence == EGL_NO_SYNC_KHR) {
+            for (auto& upload : uploads) {
+                upload.uploaded = false;
+            }
+            return;
+        }
+        EGLint waitStatus = eglClientWaitSyncKHR(display, fence, 0, FENCE_TIMEOUT);
+        ALOGE_IF(waitStatus != EGL_CONDITION_SATISFIED_KHR,
+                "Failed to wait for the fence %#x", eglGetError());
+
+        eglDestroySyncKHR(display, fence);
+    }
+
     renderthread::EglManager mEglManager;
 };
 
@@ -382,15 +470,12 @@ static void createUploader(bool usingGL) {
     }
 }
 
-sk_sp<Bitmap> HardwareBitmapUploader::allocateHardwareBitmap(const SkBitmap& sourceBitmap) {
-    ATRACE_CALL();
-
-    bool usingGL = uirenderer::Properties::getRenderPipelineType() ==
-            uirenderer::RenderPipelineType::SkiaGL;
-
+// Converts the source bitmap to an uploadable format and allocates its graphic buffer. Returns false
+// if the bitmap cannot be made into a hardware bitmap.
+static bool prepareUpload(const SkBitmap& sourceBitmap, bool usingGL, PendingUpload* outUpload) {
     FormatInfo format = determineFormat(sourceBitmap, usingGL);
     if (!format.valid) {
-        return nullptr;
+        return false;
     }
 
     SkBitmap bitmap = makeHwCompatible(format, sourceBitmap);
@@ -405,17 +490,86 @@ sk_sp<Bitmap> HardwareBitmapUploader::allocateHardwareBitmap(const SkBitmap& sou
     status_t error = buffer->initCheck();
     if (error < 0) {
         ALOGW("createGraphicBuffer() failed in GraphicBuffer.create()");
+        return false;
+    }
+
+    outUpload->bitmap = std::move(bitmap);
+    outUpload->format = format;
+    outUpload->graphicBuffer = std::move(buffer);
+    return true;
+}
+
+static sk_sp<Bitmap> createFromUpload(const PendingUpload& upload) {
+    const SkBitmap& bitmap = upload.bitmap;
+    return Bitmap::createFrom(upload.graphicBuffer->toAHardwareBuffer(), bitmap.colorType(),
+                              bitmap.refColorSpace(), bitmap.alphaType(),
+                              Bitmap::computePalette(bitmap));
+}
+
+sk_sp<Bitmap> HardwareBitmapUploader::allocateHardwareBitmap(const SkBitmap& sourceBitmap) {
+    ATRACE_CALL();
+
+    bool usingGL = uirenderer::Properties::getRenderPipelineType() ==
+            uirenderer::RenderPipelineType::SkiaGL;
+
+    PendingUpload upload;
+    if (!prepareUpload(sourceBitmap, usingGL, &upload)) {
         return nullptr;
     }
 
     createUploader(usingGL);
 
-    if (!sUploader->uploadHardwareBitmap(bitmap, format, buffer)) {
+    if (!sUploader->uploadHardwareBitmap(upload.bitmap, upload.format, upload.graphicBuffer)) {
         return nullptr;
     }
-    return Bitmap::createFrom(buffer->toAHardwareBuffer(), bitmap.colorType(),
-                              bitmap.refColorSpace(), bitmap.alphaType(),
-			      Bitmap::computePalette(bitmap));
+    return createFromUpload(upload);
+}
+
+std::vector<std::future<sk_sp<Bitmap>>> HardwareBitmapUploader::allocateHardwareBitmaps(
+        std::vector<SkBitmap> sourceBitmaps) {
+    ATRACE_CALL();
+
+    auto promises = std::make_shared<std::vector<std::promise<sk_sp<Bitmap>>>>(
+            sourceBitmaps.size());
+    std::vector<std::future<sk_sp<Bitmap>>> futures;
+    futures.reserve(promises->size());
+    for (auto& promise : *promises) {
+        futures.push_back(promise.get_future());
+    }
+
+    CommonPool::post([promises, sourceBitmaps = std::move(sourceBitmaps)] {
+        ATRACE_NAME("allocateHardwareBitmaps");
+        bool usingGL = uirenderer::Properties::getRenderPipelineType() ==
+                uirenderer::RenderPipelineType::SkiaGL;
+
+        // Bitmaps that cannot be uploaded resolve immediately; the rest are uploaded together.
+        std::vector<PendingUpload> uploads;
+        std::vector<size_t> uploadIndices;
+        uploads.reserve(sourceBitmaps.size());
+        uploadIndices.reserve(sourceBitmaps.size());
+        for (size_t i = 0; i < sourceBitmaps.size(); i++) {
+            PendingUpload upload;
+            if (prepareUpload(sourceBitmaps[i], usingGL, &upload)) {
+                uploads.push_back(std::move(upload));
+                uploadIndices.push_back(i);
+            } else {
+                (*promises)[i].set_value(nullptr);
+            }
+        }
+        if (uploads.empty()) {
+            return;
+        }
+
+        createUploader(usingGL);
+        sUploader->uploadHardwareBitmaps(uploads);
+
+        for (size_t i = 0; i < uploads.size(); i++) {
+            (*promises)[uploadIndices[i]].set_value(
+                    uploads[i].uploaded ? createFromUpload(uploads[i]) : nullptr);
+        }
+    }, CommonPool::Priority::High);
+
+    return futures;
 }
 
 void HardwareBitmapUploader::initialize() {
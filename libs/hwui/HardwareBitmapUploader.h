@@ -18,6 +18,9 @@
 
 #include <hwui/Bitmap.h>
 
+#include <future>
+#include <vector>
+
 namespace android::uirenderer {
 
 class ANDROID_API HardwareBitmapUploader {
@@ -27,6 +30,13 @@ public:
 
     static sk_sp<Bitmap> allocateHardwareBitmap(const SkBitmap& sourceBitmap);
 
+    // Uploads a batch of bitmaps without blocking the caller. The uploads are issued back to back
+    // on the upload thread and share a single fence. Each future yields the hardware bitmap, or
+    // nullptr if that bitmap could not be uploaded. The pixels of the source bitmaps must not be
+    // modified until their futures are ready.
+    static std::vector<std::future<sk_sp<Bitmap>>> allocateHardwareBitmaps(
+            std::vector<SkBitmap> sourceBitmaps);
+
 #ifdef __ANDROID__
     static bool hasFP16Support();
 #else
@@ -101,18 +101,28 @@ float PathInterpolator::interpolate(float t) {
     } else if (t >= 1) {
         return 1;
     }
-    // Do a binary search for the correct x to interpolate between.
-    size_t startIndex = 0;
-    size_t endIndex = mX.size() - 1;
-
-    while (endIndex > startIndex + 1) {
-        int midIndex = (startIndex + endIndex) / 2;
-        if (t < mX[midIndex]) {
-            endIndex = midIndex;
-        } else {
-            startIndex = midIndex;
+    // Find the segment such that mX[startIndex] <= t < mX[endIndex], trying the segment of
+    // the previous input and the one after it before a binary search.
+    size_t startIndex = mLastStartIndex;
+    size_t endIndex = startIndex + 1;
+    if (endIndex + 1 < mX.size() && mX[endIndex] <= t) {
+        startIndex++;
+        endIndex++;
+    }
+    if (endIndex >= mX.size() || t < mX[startIndex] || t >= mX[endIndex]) {
+        startIndex = 0;
+        endIndex = mX.size() - 1;
+
+        while (endIndex > startIndex + 1) {
+            int midIndex = (startIndex + endIndex) / 2;
+            if (t < mX[midIndex]) {
+                endIndex = midIndex;
+            } else {
+                startIndex = midIndex;
+            }
         }
     }
+    mLastStartIndex = startIndex;
 
     float xRange = mX[endIndex] - mX[startIndex];
     if (xRange == 0) {
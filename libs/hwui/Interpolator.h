@@ -115,6 +115,9 @@ public:
 private:
     std::vector<float> mX;
     std::vector<float> mY;
+    // The segment of the previous input. Animations mostly move forward by small steps, so the
+    // next input usually falls in the same segment or the one after it.
+    size_t mLastStartIndex = 0;
 };
 
 class ANDROID_API LUTInterpolator : public Interpolator {
@@ -61,6 +61,28 @@ static const std::array<Comparison, 4> COMPARISONS{
                    FrameInfoIndex::IssueDrawCommandsStart, FrameInfoIndex::FrameCompleted},
 };
 
+struct StageSpan {
+    FrameStage stage;
+    FrameInfoIndex start;
+    FrameInfoIndex end;
+};
+
+// GPU completion is reported separately from finishGpuDraw() as it arrives later
+static const std::array<StageSpan, 7> STAGE_SPANS{
+        StageSpan{kStageInput, FrameInfoIndex::HandleInputStart, FrameInfoIndex::AnimationStart},
+        StageSpan{kStageAnimation, FrameInfoIndex::AnimationStart,
+                  FrameInfoIndex::PerformTraversalsStart},
+        StageSpan{kStageMeasureLayout, FrameInfoIndex::PerformTraversalsStart,
+                  FrameInfoIndex::DrawStart},
+        StageSpan{kStageSync, FrameInfoIndex::SyncStart, FrameInfoIndex::IssueDrawCommandsStart},
+        StageSpan{kStageIssueDraw, FrameInfoIndex::IssueDrawCommandsStart,
+                  FrameInfoIndex::SwapBuffers},
+        StageSpan{kStageSwap, FrameInfoIndex::SwapBuffers, FrameInfoIndex::FrameCompleted},
+        // Frames that handled no input have no OldestInputEvent, or one past FrameCompleted
+        StageSpan{kStageInputLatency, FrameInfoIndex::OldestInputEvent,
+                  FrameInfoIndex::FrameCompleted},
+};
+
 // If the event exceeds 10 seconds throw it away, this isn't a jank event
 // it's an ANR and will be handled as such
 static const int64_t IGNORE_EXCEEDING = seconds_to_nanoseconds(10);
@@ -134,6 +156,17 @@ void JankTracker::finishFrame(const FrameInfo& frame) {
         return;
     }
 
+    for (auto& span : STAGE_SPANS) {
+        // Stages the frame skipped, e.g. the UI thread stages of a RenderThread-only
+        // animation frame, have no start timestamp and are left out of the histograms
+        if (frame[span.start] <= 0 || frame[span.end] < frame[span.start]) continue;
+        int64_t delta = frame.duration(span.start, span.end);
+        if (delta < IGNORE_EXCEEDING) {
+            mData->reportStage(span.stage, delta);
+            (*mGlobalData)->reportStage(span.stage, delta);
+        }
+    }
+
     if (totalDuration > mFrameInterval) {
         mData->reportJank();
         (*mGlobalData)->reportJank();
@@ -240,6 +273,8 @@ void JankTracker::finishGpuDraw(const FrameInfo& frame) {
     if (totalGPUDrawTime >= 0) {
         mData->reportGPUFrame(totalGPUDrawTime);
         (*mGlobalData)->reportGPUFrame(totalGPUDrawTime);
+        mData->reportStage(kStageGpuCompletion, totalGPUDrawTime);
+        (*mGlobalData)->reportStage(kStageGpuCompletion, totalGPUDrawTime);
     }
 }
 
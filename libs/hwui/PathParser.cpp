@@ -99,10 +99,98 @@ static void extract(int* outEndPosition, bool* outEndWithNegOrDot, const char* s
     *outEndPosition = currentIndex;
 }
 
+static const float kPowersOfTen[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                     1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Parses a decimal number without going through strtof. With at most 7 significant digits the
+ * mantissa is exact in a float, and so is any power of ten up to 1e10, so a single correctly
+ * rounded multiply or divide produces exactly what strtof would (Clinger's fast path). Path data
+ * from resources virtually always fits; anything else returns false so the caller can fall back.
+ */
+static bool parseFloatFast(const char* s, size_t length, float* outValue) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < length && (s[i] == '-' || s[i] == '+')) {
+        negative = s[i] == '-';
+        i++;
+    }
+    uint32_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool sawDigit = false;
+    for (; i < length && isDigit(s[i]); i++) {
+        sawDigit = true;
+        if (mantissa == 0 && s[i] == '0') {
+            continue;
+        }
+        if (++significantDigits > 7) {
+            return false;
+        }
+        mantissa = mantissa * 10 + (s[i] - '0');
+    }
+    if (i < length && s[i] == '.') {
+        for (i++; i < length && isDigit(s[i]); i++) {
+            sawDigit = true;
+            exponent--;
+            if (mantissa == 0 && s[i] == '0') {
+                continue;
+            }
+            if (++significantDigits > 7) {
+                return false;
+            }
+            mantissa = mantissa * 10 + (s[i] - '0');
+        }
+    }
+    if (!sawDigit) {
+        return false;
+    }
+    if (i < length && (s[i] == 'e' || s[i] == 'E')) {
+        size_t j = i + 1;
+        bool negativeExponent = false;
+        if (j < length && (s[j] == '-' || s[j] == '+')) {
+            negativeExponent = s[j] == '-';
+            j++;
+        }
+        // Like strtof, an 'e' that isn't followed by digits is not part of the number.
+        if (j < length && isDigit(s[j])) {
+            int value = 0;
+            for (; j < length && isDigit(s[j]); j++) {
+                if (value > 100) {
+                    return false;
+                }
+                value = value * 10 + (s[j] - '0');
+            }
+            exponent += negativeExponent ? -value : value;
+        }
+    } else if (i < length && (s[i] == 'x' || s[i] == 'X')) {
+        // Hexadecimal floats are left to strtof.
+        return false;
+    }
+
+    float value = mantissa;
+    if (mantissa != 0) {
+        if (exponent < -10 || exponent > 10) {
+            return false;
+        }
+        value = exponent < 0 ? value / kPowersOfTen[-exponent] : value * kPowersOfTen[exponent];
+    }
+    *outValue = negative ? -value : value;
+    return true;
+}
+
 static float parseFloat(PathParser::ParseResult* result, const char* startPtr,
                         size_t expectedLength) {
+    float currentValue;
+    if (parseFloatFast(startPtr, expectedLength, &currentValue)) {
+        return currentValue;
+    }
     char* endPtr = NULL;
-    float currentValue = strtof(startPtr, &endPtr);
+    currentValue = strtof(startPtr, &endPtr);
     if ((currentValue == HUGE_VALF || currentValue == -HUGE_VALF) && errno == ERANGE) {
         result->failureOccurred = true;
         result->failureMessage = "Float out of range:  ";
@@ -214,8 +302,14 @@ void PathParser::validateVerbAndPoints(char verb, size_t points, PathParser::Par
                               std::to_string(points) + " float(s) are found. ";
 }
 
-void PathParser::getPathDataFromAsciiString(PathData* data, ParseResult* result,
-                                            const char* pathStr, size_t strLen) {
+/**
+ * Parses the path string and calls onCommand(verb, pointStart, pointCount) for every valid
+ * command, after its floats have been appended to points. Stops at the first invalid command,
+ * whose floats are dropped again.
+ */
+template <typename Callback>
+static void parsePath(PathParser::ParseResult* result, std::vector<float>* points,
+                      const char* pathStr, size_t strLen, Callback onCommand) {
     if (pathStr == NULL) {
         result->failureOccurred = true;
         result->failureMessage = "Path string cannot be NULL.";
@@ -236,35 +330,43 @@ void PathParser::getPathDataFromAsciiString(PathData* data, ParseResult* result,
 
     while (end < strLen) {
         end = nextStart(pathStr, strLen, end);
-        std::vector<float> points;
-        getFloats(&points, result, pathStr, start, end);
-        validateVerbAndPoints(pathStr[start], points.size(), result);
+        size_t pointStart = points->size();
+        getFloats(points, result, pathStr, start, end);
+        size_t pointCount = points->size() - pointStart;
+        PathParser::validateVerbAndPoints(pathStr[start], pointCount, result);
         if (result->failureOccurred) {
             // If either verb or points is not valid, return immediately.
+            points->resize(pointStart);
             result->failureMessage += "Failure occurred at position " + std::to_string(start) +
                                       " of path: " + pathStr;
             return;
         }
-        data->verbs.push_back(pathStr[start]);
-        data->verbSizes.push_back(points.size());
-        data->points.insert(data->points.end(), points.begin(), points.end());
+        onCommand(pathStr[start], pointStart, pointCount);
         start = end;
         end++;
     }
 
     if ((end - start) == 1 && start < strLen) {
-        validateVerbAndPoints(pathStr[start], 0, result);
+        PathParser::validateVerbAndPoints(pathStr[start], 0, result);
         if (result->failureOccurred) {
             // If either verb or points is not valid, return immediately.
             result->failureMessage += "Failure occurred at position " + std::to_string(start) +
                                       " of path: " + pathStr;
             return;
         }
-        data->verbs.push_back(pathStr[start]);
-        data->verbSizes.push_back(0);
+        onCommand(pathStr[start], points->size(), 0);
     }
 }
 
+void PathParser::getPathDataFromAsciiString(PathData* data, ParseResult* result,
+                                            const char* pathStr, size_t strLen) {
+    parsePath(result, &data->points, pathStr, strLen,
+              [data](char verb, size_t pointStart, size_t pointCount) {
+                  data->verbs.push_back(verb);
+                  data->verbSizes.push_back(pointCount);
+              });
+}
+
 void PathParser::dump(const PathData& data) {
     // Print out the path data.
     size_t start = 0;
@@ -288,19 +390,35 @@ void PathParser::dump(const PathData& data) {
 
 void PathParser::parseAsciiStringForSkPath(SkPath* skPath, ParseResult* result, const char* pathStr,
                                            size_t strLen) {
-    PathData pathData;
-    getPathDataFromAsciiString(&pathData, result, pathStr, strLen);
+    // Commands are resolved into the SkPath as soon as they're parsed, so only the floats of a
+    // single command are ever held. The buffer is kept per thread so that inflating many paths
+    // doesn't allocate for each one.
+    static thread_local std::vector<float> sPoints;
+    sPoints.clear();
+
+    SkPath path;
+    PathResolver resolver;
+    char previousCommand = 'm';
+    size_t verbCount = 0;
+    parsePath(result, &sPoints, pathStr, strLen,
+              [&](char verb, size_t pointStart, size_t pointCount) {
+                  resolver.addCommand(&path, previousCommand, verb, sPoints.data(), pointStart,
+                                      pointStart + pointCount);
+                  previousCommand = verb;
+                  verbCount++;
+                  sPoints.clear();
+              });
     if (result->failureOccurred) {
         return;
     }
     // Check if there is valid data coming out of parsing the string.
-    if (pathData.verbs.size() == 0) {
+    if (verbCount == 0) {
         result->failureOccurred = true;
         result->failureMessage = "No verbs found in the string for pathData: ";
         result->failureMessage += pathStr;
         return;
     }
-    VectorDrawableUtils::verbsToPath(skPath, pathData);
+    skPath->swap(path);
     return;
 }
 
@@ -26,6 +26,12 @@ static const char* JANK_TYPE_NAMES[] = {
         "Missed Vsync",        "High input latency",       "Slow UI thread",
         "Slow bitmap uploads", "Slow issue draw commands", "Frame deadline missed"};
 
+static const char* FRAME_STAGE_NAMES[] = {"input",      "animation", "measure/layout",
+                                          "sync",       "issue draw", "swap",
+                                          "gpu completion", "input latency"};
+static_assert(sizeof(FRAME_STAGE_NAMES) / sizeof(FRAME_STAGE_NAMES[0]) == NUM_FRAME_STAGES,
+              "Missing a FrameStage name");
+
 // The bucketing algorithm controls so to speak
 // If a frame is <= to this it goes in bucket 0
 static const uint32_t kBucketMinThreshold = 5;
@@ -39,6 +45,9 @@ static const uint32_t kSlowFrameBucketIntervalMs = 50;
 // The start point of the slow frame bucket in ms
 static const uint32_t kSlowFrameBucketStartMs = 150;
 
+// The stage histogram counts in increments of 1ms below this and 4ms above it
+static const uint32_t kStageBucket4msIntervals = 16;
+
 // This will be called every frame, performance sensitive
 // Uses bit twiddling to avoid branching while achieving the packing desired
 static uint32_t frameCountIndexForFrameTime(nsecs_t frameTime) {
@@ -103,6 +112,12 @@ void ProfileData::mergeWith(const ProfileData& other) {
         mGPUFrameCounts[i] >>= divider;
         mGPUFrameCounts[i] += other.mGPUFrameCounts[i];
     }
+    for (size_t stage = 0; stage < other.mStageFrameCounts.size(); stage++) {
+        for (size_t i = 0; i < other.mStageFrameCounts[stage].size(); i++) {
+            mStageFrameCounts[stage][i] >>= divider;
+            mStageFrameCounts[stage][i] += other.mStageFrameCounts[stage][i];
+        }
+    }
     mPipelineType = other.mPipelineType;
 }
 
@@ -131,6 +146,12 @@ void ProfileData::dump(int fd) const {
     histogramGPUForEach([fd](HistogramEntry entry) {
         dprintf(fd, " %ums=%u", entry.renderTimeMs, entry.frameCount);
     });
+    for (int i = 0; i < NUM_FRAME_STAGES; i++) {
+        FrameStage stage = static_cast<FrameStage>(i);
+        dprintf(fd, "\n%s stage percentiles: 50th=%ums 90th=%ums 95th=%ums 99th=%ums",
+                stageName(stage), findStagePercentile(stage, 50), findStagePercentile(stage, 90),
+                findStagePercentile(stage, 95), findStagePercentile(stage, 99));
+    }
 }
 
 uint32_t ProfileData::findPercentile(int percentile) const {
@@ -156,6 +177,9 @@ void ProfileData::reset() {
     mFrameCounts.fill(0);
     mGPUFrameCounts.fill(0);
     mSlowFrameCounts.fill(0);
+    for (auto& counts : mStageFrameCounts) {
+        counts.fill(0);
+    }
     mTotalFrameCount = 0;
     mJankFrameCount = 0;
     mStatStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
@@ -218,5 +242,53 @@ void ProfileData::histogramGPUForEach(const std::function<void(HistogramEntry)>&
     }
 }
 
+const char* ProfileData::stageName(FrameStage stage) {
+    return FRAME_STAGE_NAMES[stage];
+}
+
+uint32_t ProfileData::findStagePercentile(FrameStage stage, int percentile) const {
+    const auto& counts = mStageFrameCounts[stage];
+    uint32_t totalStageCount = 0;
+    for (uint32_t count : counts) {
+        totalStageCount += count;
+    }
+    int pos = percentile * totalStageCount / 100;
+    int remaining = totalStageCount - pos;
+    for (int i = counts.size() - 1; i >= 0; i--) {
+        remaining -= counts[i];
+        if (remaining <= 0) {
+            return stageTimeForStageCountIndex(i);
+        }
+    }
+    return 0;
+}
+
+uint32_t ProfileData::stageTimeForStageCountIndex(uint32_t index) {
+    if (index == static_cast<uint32_t>(StageHistogramSize() - 1)) {
+        return 4950;
+    }
+    if (index < kStageBucket4msIntervals) {
+        return index + 1;
+    }
+    return kStageBucket4msIntervals + (index - kStageBucket4msIntervals + 1) * 4;
+}
+
+void ProfileData::reportStage(FrameStage stage, int64_t duration) {
+    uint32_t index = static_cast<uint32_t>(ns2ms(duration));
+    if (index >= kStageBucket4msIntervals) {
+        index = kStageBucket4msIntervals + (index - kStageBucket4msIntervals) / 4;
+    }
+    index = std::min(index, static_cast<uint32_t>(StageHistogramSize() - 1));
+    mStageFrameCounts[stage][index]++;
+}
+
+void ProfileData::histogramStageForEach(
+        FrameStage stage, const std::function<void(HistogramEntry)>& callback) const {
+    const auto& counts = mStageFrameCounts[stage];
+    for (size_t i = 0; i < counts.size(); i++) {
+        callback(HistogramEntry{stageTimeForStageCountIndex(i), counts[i]});
+    }
+}
+
 } /* namespace uirenderer */
 } /* namespace android */
\ No newline at end of file
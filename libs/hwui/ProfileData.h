@@ -40,6 +40,23 @@ enum JankType {
     NUM_BUCKETS,
 };
 
+// Pipeline stages which get their own duration histogram, see JankTracker for
+// the FrameInfo timestamps each stage spans
+enum FrameStage {
+    kStageInput = 0,
+    kStageAnimation,
+    kStageMeasureLayout,
+    kStageSync,
+    kStageIssueDraw,
+    kStageSwap,
+    kStageGpuCompletion,
+    // From the oldest input event handled by the frame to the frame being queued
+    kStageInputLatency,
+
+    // must be last
+    NUM_FRAME_STAGES,
+};
+
 // For testing
 class MockProfileData;
 
@@ -56,9 +73,11 @@ public:
     void dump(int fd) const;
     uint32_t findPercentile(int percentile) const;
     uint32_t findGPUPercentile(int percentile) const;
+    uint32_t findStagePercentile(FrameStage stage, int percentile) const;
 
     void reportFrame(int64_t duration);
     void reportGPUFrame(int64_t duration);
+    void reportStage(FrameStage stage, int64_t duration);
     void reportJank() { mJankFrameCount++; }
     void reportJankType(JankType type) { mJankTypeCounts[static_cast<int>(type)]++; }
 
@@ -74,6 +93,8 @@ public:
     };
     void histogramForEach(const std::function<void(HistogramEntry)>& callback) const;
     void histogramGPUForEach(const std::function<void(HistogramEntry)>& callback) const;
+    void histogramStageForEach(FrameStage stage,
+                               const std::function<void(HistogramEntry)>& callback) const;
 
     constexpr static int HistogramSize() {
         return std::tuple_size<decltype(ProfileData::mFrameCounts)>::value +
@@ -84,10 +105,17 @@ public:
         return std::tuple_size<decltype(ProfileData::mGPUFrameCounts)>::value;
     }
 
+    constexpr static int StageHistogramSize() {
+        return std::tuple_size<decltype(ProfileData::mStageFrameCounts)::value_type>::value;
+    }
+
+    static const char* stageName(FrameStage stage);
+
     // Visible for testing
     static uint32_t frameTimeForFrameCountIndex(uint32_t index);
     static uint32_t frameTimeForSlowFrameCountIndex(uint32_t index);
     static uint32_t GPUFrameTimeForFrameCountIndex(uint32_t index);
+    static uint32_t stageTimeForStageCountIndex(uint32_t index);
 
 private:
     // Open our guts up to unit tests
@@ -101,6 +129,9 @@ private:
     // Holds a histogram of GPU draw times in 1ms increments. Frames longer than 25ms are placed in
     // last bucket.
     std::array<uint32_t, 26> mGPUFrameCounts;
+    // Holds a histogram of durations for each FrameStage, in 1ms increments up to 16ms and 4ms
+    // increments from there on. Stages longer than 76ms are placed in the last bucket.
+    std::array<std::array<uint32_t, 32>, NUM_FRAME_STAGES> mStageFrameCounts;
 
     uint32_t mTotalFrameCount;
     uint32_t mJankFrameCount;
@@ -116,6 +147,9 @@ public:
     std::array<uint32_t, NUM_BUCKETS>& editJankTypeCounts() { return mJankTypeCounts; }
     std::array<uint32_t, 57>& editFrameCounts() { return mFrameCounts; }
     std::array<uint16_t, 97>& editSlowFrameCounts() { return mSlowFrameCounts; }
+    std::array<uint32_t, 32>& editStageFrameCounts(FrameStage stage) {
+        return mStageFrameCounts[stage];
+    }
     uint32_t& editTotalFrameCount() { return mTotalFrameCount; }
     uint32_t& editJankFrameCount() { return mJankFrameCount; }
     nsecs_t& editStatStartTime() { return mStatStartTime; }
@@ -71,6 +71,11 @@ bool Properties::filterOutTestOverhead = false;
 bool Properties::disableVsync = false;
 bool Properties::skpCaptureEnabled = false;
 bool Properties::enableRTAnimations = true;
+bool Properties::parallelPrepareTree = false;
+bool Properties::pipelinedDraw = false;
+bool Properties::reorderDisplayList = false;
+bool Properties::enableImageAtlas = false;
+bool Properties::prefetchText = false;
 
 bool Properties::runningInEmulator = false;
 bool Properties::debuggingEnabled = false;
@@ -126,6 +131,12 @@ bool Properties::load() {
 
     runningInEmulator = base::GetBoolProperty(PROPERTY_QEMU_KERNEL, false);
 
+    parallelPrepareTree = base::GetBoolProperty(PROPERTY_PARALLEL_PREPARE_TREE, false);
+    pipelinedDraw = base::GetBoolProperty(PROPERTY_PIPELINED_DRAW, false);
+    reorderDisplayList = base::GetBoolProperty(PROPERTY_REORDER_DISPLAY_LIST, false);
+    enableImageAtlas = base::GetBoolProperty(PROPERTY_IMAGE_ATLAS, false);
+    prefetchText = base::GetBoolProperty(PROPERTY_PREFETCH_TEXT, false);
+
     defaultRenderAhead = std::max(-1, std::min(2, base::GetIntProperty(PROPERTY_RENDERAHEAD,
             render_ahead().value_or(0))));
 
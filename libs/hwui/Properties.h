@@ -164,6 +164,43 @@ enum DebugLevel {
 
 #define PROPERTY_RENDERAHEAD "debug.hwui.render_ahead"
 
+/**
+ * Allows RenderNode::prepareTree to prepare independent child subtrees of wide nodes on the
+ * CommonPool. Defaults to false.
+ */
+#define PROPERTY_PARALLEL_PREPARE_TREE "debug.hwui.parallel_prepare_tree"
+
+/**
+ * Allows DrawFrameTask to leave the swap of a frame pending until the sync of the next frame,
+ * if it is already queued, has run. Defaults to false.
+ */
+#define PROPERTY_PIPELINED_DRAW "debug.hwui.pipelined_draw"
+
+/**
+ * Allows finished display lists to group non-overlapping draws that share paint state, so that
+ * they can be batched. Defaults to false.
+ */
+#define PROPERTY_REORDER_DISPLAY_LIST "debug.hwui.reorder_display_list"
+
+/**
+ * Allows small raster images that are drawn on consecutive frames to be drawn from shared GPU
+ * textures, so that their draws can be batched. Defaults to false.
+ */
+#define PROPERTY_IMAGE_ATLAS "debug.hwui.image_atlas"
+
+/**
+ * Allows the glyphs of newly recorded text to be rasterized into the glyph cache on a worker
+ * thread, ahead of the RenderThread drawing them. Defaults to false.
+ */
+#define PROPERTY_PREFETCH_TEXT "debug.hwui.prefetch_text"
+
+/**
+ * Path to a read-only, system provided shader cache that is consulted when the per-app cache
+ * misses. It uses the per-app cache file format, and is only used when its identity hash
+ * matches the current GPU driver. Disabled when empty, the default.
+ */
+#define PROPERTY_SYSTEM_SHADER_CACHE "ro.hwui.system_shader_cache"
+
 ///////////////////////////////////////////////////////////////////////////////
 // Misc
 ///////////////////////////////////////////////////////////////////////////////
@@ -237,6 +274,12 @@ public:
     // For experimentation b/68769804
     ANDROID_API static bool enableRTAnimations;
 
+    static bool parallelPrepareTree;
+    static bool pipelinedDraw;
+    static bool reorderDisplayList;
+    static bool enableImageAtlas;
+    static bool prefetchText;
+
     // Used for testing only to change the render pipeline.
     static void overrideRenderPipelineType(RenderPipelineType);
 
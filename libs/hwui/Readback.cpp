@@ -35,16 +35,15 @@ using namespace android::uirenderer::renderthread;
 namespace android {
 namespace uirenderer {
 
-CopyResult Readback::copySurfaceInto(ANativeWindow* window, const Rect& srcRect, SkBitmap* bitmap) {
-    ATRACE_CALL();
+CopyResult Readback::acquireLastQueuedImage(ANativeWindow* window, Matrix4* texTransform,
+                                            base::unique_fd* outFence, sk_sp<SkImage>* outImage) {
     // Setup the source
     AHardwareBuffer* rawSourceBuffer;
     int rawSourceFence;
-    Matrix4 texTransform;
     status_t err = ANativeWindow_getLastQueuedBuffer(window, &rawSourceBuffer, &rawSourceFence,
-                                                     texTransform.data);
-    base::unique_fd sourceFence(rawSourceFence);
-    texTransform.invalidateType();
+                                                     texTransform->data);
+    outFence->reset(rawSourceFence);
+    texTransform->invalidateType();
     if (err != NO_ERROR) {
         ALOGW("Failed to get last queued buffer, error = %d", err);
         return CopyResult::UnknownError;
@@ -63,15 +62,27 @@ CopyResult Readback::copySurfaceInto(ANativeWindow* window, const Rect& srcRect,
         return CopyResult::SourceInvalid;
     }
 
+    sk_sp<SkColorSpace> colorSpace = DataSpaceToColorSpace(
+            static_cast<android_dataspace>(ANativeWindow_getBuffersDataSpace(window)));
+    *outImage =
+            SkImage::MakeFromAHardwareBuffer(sourceBuffer.get(), kPremul_SkAlphaType, colorSpace);
+    return CopyResult::Success;
+}
+
+CopyResult Readback::copySurfaceInto(ANativeWindow* window, const Rect& srcRect, SkBitmap* bitmap) {
+    ATRACE_CALL();
+    Matrix4 texTransform;
+    base::unique_fd sourceFence;
+    sk_sp<SkImage> image;
+    CopyResult result = acquireLastQueuedImage(window, &texTransform, &sourceFence, &image);
+    if (result != CopyResult::Success) {
+        return result;
+    }
+
     if (sourceFence != -1 && sync_wait(sourceFence.get(), 500 /* ms */) != NO_ERROR) {
         ALOGE("Timeout (500ms) exceeded waiting for buffer fence, abandoning readback attempt");
         return CopyResult::Timeout;
     }
-
-    sk_sp<SkColorSpace> colorSpace = DataSpaceToColorSpace(
-            static_cast<android_dataspace>(ANativeWindow_getBuffersDataSpace(window)));
-    sk_sp<SkImage> image =
-            SkImage::MakeFromAHardwareBuffer(sourceBuffer.get(), kPremul_SkAlphaType, colorSpace);
     return copyImageInto(image, texTransform, srcRect, bitmap);
 }
 
@@ -106,6 +117,31 @@ CopyResult Readback::copyLayerInto(DeferredLayerUpdater* deferredLayer, SkBitmap
     return copyResult;
 }
 
+bool Readback::setupLayer(Layer* layer, const sk_sp<SkImage>& image, Matrix4& texTransform,
+                          const Rect& srcRect, SkRect* outSrcRect) {
+    int imgWidth = image->width();
+    int imgHeight = image->height();
+    int displayedWidth = imgWidth, displayedHeight = imgHeight;
+    // If this is a 90 or 270 degree rotation we need to swap width/height to get the device
+    // size.
+    if (texTransform[Matrix4::kSkewX] >= 0.5f || texTransform[Matrix4::kSkewX] <= -0.5f) {
+        std::swap(displayedWidth, displayedHeight);
+    }
+    *outSrcRect = srcRect.toSkRect();
+    if (outSrcRect->isEmpty()) {
+        *outSrcRect = SkRect::MakeIWH(displayedWidth, displayedHeight);
+    }
+    bool srcNotEmpty = outSrcRect->intersect(SkRect::MakeIWH(displayedWidth, displayedHeight));
+    if (!srcNotEmpty) {
+        return false;
+    }
+
+    layer->setSize(displayedWidth, displayedHeight);
+    texTransform.copyTo(layer->getTexTransform());
+    layer->setImage(image);
+    return true;
+}
+
 CopyResult Readback::copyImageInto(const sk_sp<SkImage>& image, Matrix4& texTransform,
                                    const Rect& srcRect, SkBitmap* bitmap) {
     ATRACE_CALL();
@@ -117,8 +153,6 @@ CopyResult Readback::copyImageInto(const sk_sp<SkImage>& image, Matrix4& texTran
     if (!image.get()) {
         return CopyResult::UnknownError;
     }
-    int imgWidth = image->width();
-    int imgHeight = image->height();
     sk_sp<GrContext> grContext = sk_ref_sp(mRenderThread.getGrContext());
 
     if (bitmap->colorType() == kRGBA_F16_SkColorType &&
@@ -129,26 +163,12 @@ CopyResult Readback::copyImageInto(const sk_sp<SkImage>& image, Matrix4& texTran
 
     CopyResult copyResult = CopyResult::UnknownError;
 
-    int displayedWidth = imgWidth, displayedHeight = imgHeight;
-    // If this is a 90 or 270 degree rotation we need to swap width/height to get the device
-    // size.
-    if (texTransform[Matrix4::kSkewX] >= 0.5f || texTransform[Matrix4::kSkewX] <= -0.5f) {
-        std::swap(displayedWidth, displayedHeight);
-    }
     SkRect skiaDestRect = SkRect::MakeWH(bitmap->width(), bitmap->height());
-    SkRect skiaSrcRect = srcRect.toSkRect();
-    if (skiaSrcRect.isEmpty()) {
-        skiaSrcRect = SkRect::MakeIWH(displayedWidth, displayedHeight);
-    }
-    bool srcNotEmpty = skiaSrcRect.intersect(SkRect::MakeIWH(displayedWidth, displayedHeight));
-    if (!srcNotEmpty) {
+    SkRect skiaSrcRect;
+    Layer layer(mRenderThread.renderState(), nullptr, 255, SkBlendMode::kSrc);
+    if (!setupLayer(&layer, image, texTransform, srcRect, &skiaSrcRect)) {
         return copyResult;
     }
-
-    Layer layer(mRenderThread.renderState(), nullptr, 255, SkBlendMode::kSrc);
-    layer.setSize(displayedWidth, displayedHeight);
-    texTransform.copyTo(layer.getTexTransform());
-    layer.setImage(image);
     // Scaling filter is not explicitly set here, because it is done inside copyLayerInfo
     // after checking the necessity based on the src/dest rect size and the transformation.
     if (copyLayerInto(&layer, &skiaSrcRect, &skiaDestRect, bitmap)) {
@@ -158,6 +178,115 @@ CopyResult Readback::copyImageInto(const sk_sp<SkImage>& image, Matrix4& texTran
     return copyResult;
 }
 
+CopyResult Readback::copySurfaceIntoBuffer(ANativeWindow* window, const Rect& srcRect,
+                                           AHardwareBuffer* dstBuffer,
+                                           sk_sp<SkColorSpace> dstColorSpace,
+                                           base::unique_fd* outFence) {
+    ATRACE_CALL();
+    Matrix4 texTransform;
+    base::unique_fd sourceFence;
+    sk_sp<SkImage> image;
+    CopyResult result = acquireLastQueuedImage(window, &texTransform, &sourceFence, &image);
+    if (result != CopyResult::Success) {
+        return result;
+    }
+
+    if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
+        mRenderThread.requireGlContext();
+    } else {
+        mRenderThread.requireVkContext();
+    }
+    // Make the GPU wait for the producer instead of blocking the RenderThread on it.
+    if (sourceFence != -1) {
+        status_t err = Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL
+                               ? mRenderThread.eglManager().fenceWait(sourceFence.get())
+                               : mRenderThread.vulkanManager().fenceWait(
+                                         sourceFence.get(), mRenderThread.getGrContext());
+        if (err != NO_ERROR) {
+            ALOGW("Failed to wait on the source buffer fence, error = %d", err);
+            return CopyResult::UnknownError;
+        }
+    }
+    return copyImageIntoBuffer(image, texTransform, srcRect, dstBuffer, std::move(dstColorSpace),
+                               outFence);
+}
+
+CopyResult Readback::copyHWBitmapIntoBuffer(Bitmap* hwBitmap, AHardwareBuffer* dstBuffer,
+                                            sk_sp<SkColorSpace> dstColorSpace,
+                                            base::unique_fd* outFence) {
+    LOG_ALWAYS_FATAL_IF(!hwBitmap->isHardware());
+
+    Rect srcRect;
+    Matrix4 transform;
+    transform.loadScale(1, -1, 1);
+    transform.translate(0, -1);
+
+    if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
+        mRenderThread.requireGlContext();
+    } else {
+        mRenderThread.requireVkContext();
+    }
+    return copyImageIntoBuffer(hwBitmap->makeImage(), transform, srcRect, dstBuffer,
+                               std::move(dstColorSpace), outFence);
+}
+
+CopyResult Readback::copyImageIntoBuffer(const sk_sp<SkImage>& image, Matrix4& texTransform,
+                                         const Rect& srcRect, AHardwareBuffer* dstBuffer,
+                                         sk_sp<SkColorSpace> dstColorSpace,
+                                         base::unique_fd* outFence) {
+    ATRACE_CALL();
+    outFence->reset();
+    if (!image.get()) {
+        return CopyResult::UnknownError;
+    }
+    AHardwareBuffer_Desc description;
+    AHardwareBuffer_describe(dstBuffer, &description);
+    if (!(description.usage & AHARDWAREBUFFER_USAGE_GPU_COLOR_OUTPUT)) {
+        ALOGW("Can't copy into a buffer that isn't usable as a GPU color output");
+        return CopyResult::DestinationInvalid;
+    }
+
+    // Rendering straight into the destination does the scaling and the conversion to its format
+    // and color space in a single pass.
+    GrContext* grContext = mRenderThread.getGrContext();
+    sk_sp<SkSurface> dstSurface = SkSurface::MakeFromAHardwareBuffer(
+            grContext, dstBuffer, kTopLeft_GrSurfaceOrigin,
+            dstColorSpace ? std::move(dstColorSpace) : SkColorSpace::MakeSRGB(), nullptr);
+    if (!dstSurface.get()) {
+        ALOGW("Unable to render into a buffer of format %u", description.format);
+        return CopyResult::DestinationInvalid;
+    }
+
+    SkRect skiaDestRect = SkRect::MakeIWH(description.width, description.height);
+    SkRect skiaSrcRect;
+    Layer layer(mRenderThread.renderState(), nullptr, 255, SkBlendMode::kSrc);
+    if (!setupLayer(&layer, image, texTransform, srcRect, &skiaSrcRect)) {
+        return CopyResult::UnknownError;
+    }
+    if (!skiapipeline::LayerDrawable::DrawLayer(grContext, dstSurface->getCanvas(), &layer,
+                                                &skiaSrcRect, &skiaDestRect, false)) {
+        ALOGW("Unable to draw content from GPU into the provided buffer");
+        return CopyResult::UnknownError;
+    }
+    dstSurface->flush();
+
+    int rawFence = -1;
+    status_t err;
+    if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
+        EGLSyncKHR eglFence = EGL_NO_SYNC_KHR;
+        err = mRenderThread.eglManager().createReleaseFence(false, &eglFence, &rawFence);
+    } else {
+        err = mRenderThread.vulkanManager().createReleaseFence(&rawFence, grContext);
+    }
+    if (err != NO_ERROR || rawFence == -1) {
+        // Without a fence to hand to the consumer we have to wait for the copy ourselves.
+        grContext->flush(kSyncCpu_GrFlushFlag, 0, nullptr);
+        rawFence = -1;
+    }
+    outFence->reset(rawFence);
+    return CopyResult::Success;
+}
+
 bool Readback::copyLayerInto(Layer* layer, const SkRect* srcRect, const SkRect* dstRect,
                              SkBitmap* bitmap) {
     /* This intermediate surface is present to work around a bug in SwiftShader that
@@ -21,6 +21,8 @@
 #include "renderthread/RenderThread.h"
 
 #include <SkBitmap.h>
+#include <SkColorSpace.h>
+#include <android-base/unique_fd.h>
 
 namespace android {
 class Bitmap;
@@ -53,10 +55,34 @@ public:
 
     CopyResult copyLayerInto(DeferredLayerUpdater* layer, SkBitmap* bitmap);
 
+    /**
+     * Scales and converts the surface's most recently queued buffer into dstBuffer on the GPU,
+     * without waiting for the copy or downloading it. dstBuffer must be usable as a GPU color
+     * output. On success, outFence is set to a fence that signals once dstBuffer has been
+     * written, or to -1 if the write has already completed.
+     */
+    CopyResult copySurfaceIntoBuffer(ANativeWindow* window, const Rect& srcRect,
+                                     AHardwareBuffer* dstBuffer, sk_sp<SkColorSpace> dstColorSpace,
+                                     base::unique_fd* outFence);
+
+    CopyResult copyHWBitmapIntoBuffer(Bitmap* hwBitmap, AHardwareBuffer* dstBuffer,
+                                      sk_sp<SkColorSpace> dstColorSpace,
+                                      base::unique_fd* outFence);
+
 private:
+    CopyResult acquireLastQueuedImage(ANativeWindow* window, Matrix4* texTransform,
+                                      base::unique_fd* outFence, sk_sp<SkImage>* outImage);
+
     CopyResult copyImageInto(const sk_sp<SkImage>& image, Matrix4& texTransform,
                              const Rect& srcRect, SkBitmap* bitmap);
 
+    CopyResult copyImageIntoBuffer(const sk_sp<SkImage>& image, Matrix4& texTransform,
+                                   const Rect& srcRect, AHardwareBuffer* dstBuffer,
+                                   sk_sp<SkColorSpace> dstColorSpace, base::unique_fd* outFence);
+
+    bool setupLayer(Layer* layer, const sk_sp<SkImage>& image, Matrix4& texTransform,
+                    const Rect& srcRect, SkRect* outSrcRect);
+
     bool copyLayerInto(Layer* layer, const SkRect* srcRect, const SkRect* dstRect,
                        SkBitmap* bitmap);
 
@@ -66,6 +66,28 @@ static const D* pod(const T* op, size_t offset = 0) {
     return SkTAddOffset<const D>(op + 1, offset);
 }
 
+// Conservative local bounds of what the paint touches when drawing rawBounds, not counting
+// antialiasing. Returns false if they can't be computed cheaply.
+static bool paintBounds(const SkPaint& paint, const SkRect& rawBounds, SkRect* outBounds) {
+    if (!paint.canComputeFastBounds()) {
+        return false;
+    }
+    SkRect storage;
+    *outBounds = paint.computeFastBounds(rawBounds, &storage);
+    return true;
+}
+
+// Ops with equal keys are likely to need the same GPU state. Collisions only cost batching
+// opportunities, never correctness.
+static uint32_t paintBatchKey(const SkPaint& paint) {
+    uint32_t key = static_cast<uint32_t>(paint.getBlendMode());
+    key = key * 31 + paint.getStyle();
+    key = key * 31 + paint.isAntiAlias();
+    key = key * 31 + static_cast<uint32_t>(reinterpret_cast<uintptr_t>(paint.getShader()));
+    key = key * 31 + static_cast<uint32_t>(reinterpret_cast<uintptr_t>(paint.getColorFilter()));
+    return key;
+}
+
 namespace {
 
 #define X(T) T,
@@ -213,6 +235,10 @@ struct DrawPath final : Op {
     SkPath path;
     SkPaint paint;
     void draw(SkCanvas* c, const SkMatrix&) const { c->drawPath(path, paint); }
+    bool bounds(SkRect* out) const {
+        return !path.isInverseFillType() && paintBounds(paint, path.getBounds(), out);
+    }
+    uint32_t batchKey() const { return paintBatchKey(paint); }
 };
 struct DrawRect final : Op {
     static const auto kType = Type::DrawRect;
@@ -220,6 +246,8 @@ struct DrawRect final : Op {
     SkRect rect;
     SkPaint paint;
     void draw(SkCanvas* c, const SkMatrix&) const { c->drawRect(rect, paint); }
+    bool bounds(SkRect* out) const { return paintBounds(paint, rect.makeSorted(), out); }
+    uint32_t batchKey() const { return paintBatchKey(paint); }
 };
 struct DrawRegion final : Op {
     static const auto kType = Type::DrawRegion;
@@ -234,6 +262,8 @@ struct DrawOval final : Op {
     SkRect oval;
     SkPaint paint;
     void draw(SkCanvas* c, const SkMatrix&) const { c->drawOval(oval, paint); }
+    bool bounds(SkRect* out) const { return paintBounds(paint, oval.makeSorted(), out); }
+    uint32_t batchKey() const { return paintBatchKey(paint); }
 };
 struct DrawArc final : Op {
     static const auto kType = Type::DrawArc;
@@ -329,6 +359,20 @@ struct DrawImage final : Op {
     SkPaint paint;
     BitmapPalette palette;
     void draw(SkCanvas* c, const SkMatrix&) const { c->drawImage(image.get(), x, y, &paint); }
+    bool drawFromAtlas(SkCanvas* c, ImageAtlas* atlas) const {
+        SkRect src;
+        const SkImage* texture = atlas->find(c, image.get(), paint, &src);
+        if (!texture) {
+            return false;
+        }
+        c->drawImageRect(texture, src, SkRect::MakeXYWH(x, y, image->width(), image->height()),
+                         &paint, SkCanvas::kStrict_SrcRectConstraint);
+        return true;
+    }
+    bool bounds(SkRect* out) const {
+        return paintBounds(paint, SkRect::MakeXYWH(x, y, image->width(), image->height()), out);
+    }
+    uint32_t batchKey() const { return paintBatchKey(paint) * 31 + image->uniqueID(); }
 };
 struct DrawImageNine final : Op {
     static const auto kType = Type::DrawImageNine;
@@ -366,6 +410,24 @@ struct DrawImageRect final : Op {
     void draw(SkCanvas* c, const SkMatrix&) const {
         c->drawImageRect(image.get(), src, dst, &paint, constraint);
     }
+    bool drawFromAtlas(SkCanvas* c, ImageAtlas* atlas) const {
+        // Neighbouring images in the atlas must never be sampled, so a fast constraint can only
+        // be replaced by a strict one when it wasn't allowed to sample outside of src anyway.
+        if (constraint != SkCanvas::kStrict_SrcRectConstraint &&
+            src != SkRect::MakeIWH(image->width(), image->height())) {
+            return false;
+        }
+        SkRect bounds;
+        const SkImage* texture = atlas->find(c, image.get(), paint, &bounds);
+        if (!texture) {
+            return false;
+        }
+        c->drawImageRect(texture, src.makeOffset(bounds.x(), bounds.y()), dst, &paint,
+                         SkCanvas::kStrict_SrcRectConstraint);
+        return true;
+    }
+    bool bounds(SkRect* out) const { return paintBounds(paint, dst.makeSorted(), out); }
+    uint32_t batchKey() const { return paintBatchKey(paint) * 31 + image->uniqueID(); }
 };
 struct DrawImageLattice final : Op {
     static const auto kType = Type::DrawImageLattice;
@@ -406,6 +468,10 @@ struct DrawTextBlob final : Op {
     SkScalar x, y;
     SkPaint paint;
     void draw(SkCanvas* c, const SkMatrix&) const { c->drawTextBlob(blob.get(), x, y, paint); }
+    bool bounds(SkRect* out) const {
+        return paintBounds(paint, blob->bounds().makeOffset(x, y), out);
+    }
+    uint32_t batchKey() const { return paintBatchKey(paint); }
 };
 
 struct DrawPatch final : Op {
@@ -727,6 +793,49 @@ static const draw_fn draw_fns[] = {
 };
 #undef X
 
+typedef bool (*atlas_draw_fn)(const void*, SkCanvas*, ImageAtlas*);
+
+template <class T>
+using has_atlas_draw_helper = decltype(std::declval<T>().drawFromAtlas(
+        std::declval<SkCanvas*>(), std::declval<ImageAtlas*>()));
+
+template <class T>
+constexpr bool has_atlas_draw = std::experimental::is_detected_v<has_atlas_draw_helper, T>;
+
+template <class T>
+constexpr atlas_draw_fn atlasDrawForOp() {
+    if
+        constexpr(has_atlas_draw<T>) {
+            return [](const void* op, SkCanvas* c, ImageAtlas* atlas) {
+                return reinterpret_cast<const T*>(op)->drawFromAtlas(c, atlas);
+            };
+        }
+    else {
+        return nullptr;
+    }
+}
+
+// Only image draws can come from an atlas, every other op is drawn as recorded.
+#define X(T) atlasDrawForOp<T>(),
+static const atlas_draw_fn atlas_draw_fns[] = {
+#include "DisplayListOps.in"
+};
+#undef X
+
+static thread_local ImageAtlas* sCurrentImageAtlas = nullptr;
+
+ImageAtlas* ImageAtlas::current() {
+    return sCurrentImageAtlas;
+}
+
+ImageAtlas::AutoCurrent::AutoCurrent(ImageAtlas* atlas) : mPrevious(sCurrentImageAtlas) {
+    sCurrentImageAtlas = atlas;
+}
+
+ImageAtlas::AutoCurrent::~AutoCurrent() {
+    sCurrentImageAtlas = mPrevious;
+}
+
 // Most state ops (matrix, clip, save, restore) have a trivial destructor.
 #define X(T)                                                                                 \
     !std::is_trivially_destructible<T>::value ? [](const void* op) { ((const T*)op)->~T(); } \
@@ -739,7 +848,48 @@ static const void_fn dtor_fns[] = {
 
 void DisplayListData::draw(SkCanvas* canvas) const {
     SkAutoCanvasRestore acr(canvas, false);
-    this->map(draw_fns, canvas, canvas->getTotalMatrix());
+    ImageAtlas* atlas = ImageAtlas::current();
+    if (mDrawOrder.empty() && !atlas) {
+        this->map(draw_fns, canvas, canvas->getTotalMatrix());
+        return;
+    }
+    SkMatrix original = canvas->getTotalMatrix();
+    auto drawOp = [&](const Op* op) {
+        auto atlasFn = atlas_draw_fns[op->type];
+        if (!atlas || !atlasFn || !atlasFn(op, canvas, atlas)) {
+            draw_fns[op->type](op, canvas, original);
+        }
+    };
+    // The draw order allows for antialiasing one unit around each op in the display list's own
+    // space, which only covers a device pixel if the canvas doesn't scale the display list down.
+    if (mDrawOrder.empty() || !(original.getMinScale() >= 1)) {
+        auto end = fBytes.get() + fUsed;
+        for (const uint8_t* ptr = fBytes.get(); ptr < end;) {
+            auto op = (const Op*)ptr;
+            ptr += op->skip;
+            drawOp(op);
+        }
+        return;
+    }
+    for (uint32_t offset : mDrawOrder) {
+        drawOp((const Op*)(fBytes.get() + offset));
+    }
+}
+
+void DisplayListData::forEachTextBlob(
+        const std::function<void(const SkTextBlob* blob, const SkPaint& paint)>& fn) const {
+    if (!mHasText) {
+        return;
+    }
+    auto end = fBytes.get() + fUsed;
+    for (const uint8_t* ptr = fBytes.get(); ptr < end;) {
+        auto op = (const Op*)ptr;
+        ptr += op->skip;
+        if (op->type == (uint32_t)Type::DrawTextBlob) {
+            auto textOp = (const DrawTextBlob*)op;
+            fn(textOp->blob.get(), textOp->paint);
+        }
+    }
 }
 
 DisplayListData::~DisplayListData() {
@@ -748,6 +898,7 @@ DisplayListData::~DisplayListData() {
 
 void DisplayListData::reset() {
     this->map(dtor_fns);
+    mDrawOrder.clear();
 
     // Leave fBytes and fReserved alone.
     fUsed = 0;
@@ -801,6 +952,164 @@ void DisplayListData::applyColorTransform(ColorTransform transform) {
     this->map(color_transform_fns, transform);
 }
 
+typedef bool (*bounds_fn)(const void*, SkRect*);
+typedef uint32_t (*batch_key_fn)(const void*);
+
+template <class T>
+using has_bounds_helper = decltype(std::declval<T>().bounds(std::declval<SkRect*>()));
+
+template <class T>
+constexpr bool has_bounds = std::experimental::is_detected_v<has_bounds_helper, T>;
+
+template <class T>
+constexpr bounds_fn boundsForOp() {
+    if
+        constexpr(has_bounds<T>) {
+            return [](const void* op, SkRect* outBounds) {
+                return reinterpret_cast<const T*>(op)->bounds(outBounds);
+            };
+        }
+    else {
+        return nullptr;
+    }
+}
+
+template <class T>
+constexpr batch_key_fn batchKeyForOp() {
+    if
+        constexpr(has_bounds<T>) {
+            return [](const void* op) { return reinterpret_cast<const T*>(op)->batchKey(); };
+        }
+    else {
+        return nullptr;
+    }
+}
+
+// Only ops that can report their bounds may be reordered; all others, including every matrix,
+// clip and save op, keep their place and are never moved across.
+#define X(T) boundsForOp<T>(),
+static const bounds_fn bounds_fns[] = {
+#include "DisplayListOps.in"
+};
+#undef X
+
+#define X(T) batchKeyForOp<T>(),
+static const batch_key_fn batch_key_fns[] = {
+#include "DisplayListOps.in"
+};
+#undef X
+
+// How many batches an op may be moved back across to join one with the same key.
+#define MAX_BATCH_LOOKBACK 8
+
+void DisplayListData::reorderForBatching() {
+    struct Batch {
+        uint32_t key;
+        SkRect bounds;
+        std::vector<uint32_t> ops;
+    };
+    // The matrix from each op's local space to the display list's space, for every save level.
+    // Unknown after a 4x4 concat, which makes every op under it a barrier.
+    struct MatrixState {
+        SkMatrix matrix;
+        bool known;
+    };
+    std::vector<MatrixState> matrices = {{SkMatrix::I(), true}};
+    std::vector<uint32_t> order;
+    std::vector<Batch> batches;
+    bool reordered = false;
+    auto flushBatches = [&]() {
+        for (const Batch& batch : batches) {
+            order.insert(order.end(), batch.ops.begin(), batch.ops.end());
+        }
+        batches.clear();
+    };
+
+    auto end = fBytes.get() + fUsed;
+    for (const uint8_t* ptr = fBytes.get(); ptr < end;) {
+        auto op = (const Op*)ptr;
+        uint32_t offset = ptr - fBytes.get();
+        ptr += op->skip;
+
+        MatrixState& state = matrices.back();
+        switch ((Type)op->type) {
+            case Type::Save:
+            case Type::SaveLayer:
+            case Type::SaveBehind: {
+                MatrixState saved = state;
+                matrices.push_back(saved);
+                break;
+            }
+            case Type::Restore:
+                if (matrices.size() > 1) {
+                    matrices.pop_back();
+                }
+                break;
+            case Type::Concat44:
+                state.known = false;
+                break;
+            case Type::Concat:
+                state.matrix.preConcat(((const Concat*)op)->matrix);
+                break;
+            case Type::SetMatrix:
+                state = {((const SetMatrix*)op)->matrix, true};
+                break;
+            case Type::Scale:
+                state.matrix.preScale(((const Scale*)op)->sx, ((const Scale*)op)->sy);
+                break;
+            case Type::Translate:
+                state.matrix.preTranslate(((const Translate*)op)->dx, ((const Translate*)op)->dy);
+                break;
+            default:
+                break;
+        }
+        if (matrices.back().matrix.hasPerspective()) {
+            matrices.back().known = false;
+        }
+
+        SkRect bounds;
+        auto boundsFn = bounds_fns[op->type];
+        if (!boundsFn || !matrices.back().known || !boundsFn(op, &bounds)) {
+            flushBatches();
+            order.push_back(offset);
+            continue;
+        }
+        // Antialiasing reaches a unit of the display list's space around the op, however its
+        // local space is scaled.
+        matrices.back().matrix.mapRect(&bounds);
+        bounds.outset(1, 1);
+        // All ops between two barriers share a matrix and clip, so their bounds are comparable.
+        // An op may join an earlier batch only if nothing drawn after that batch overlaps it.
+        uint32_t key = (op->type << 24) ^ batch_key_fns[op->type](op);
+        Batch* target = nullptr;
+        int lookback = 0;
+        for (auto it = batches.rbegin(); it != batches.rend() && lookback < MAX_BATCH_LOOKBACK;
+             it++, lookback++) {
+            if (it->key == key) {
+                target = &*it;
+                break;
+            }
+            if (SkRect::Intersects(it->bounds, bounds)) {
+                break;
+            }
+        }
+        if (target) {
+            reordered |= target != &batches.back();
+            target->bounds.join(bounds);
+            target->ops.push_back(offset);
+        } else {
+            batches.push_back({key, bounds, {offset}});
+        }
+    }
+    flushBatches();
+
+    if (reordered) {
+        mDrawOrder = std::move(order);
+    } else {
+        mDrawOrder.clear();
+    }
+}
+
 RecordingCanvas::RecordingCanvas() : INHERITED(1, 1), fDL(nullptr) {}
 
 void RecordingCanvas::reset(DisplayListData* dl, const SkIRect& bounds) {
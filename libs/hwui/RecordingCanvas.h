@@ -31,6 +31,7 @@
 #include "SkRect.h"
 #include "SkTemplates.h"
 
+#include <functional>
 #include <vector>
 
 namespace android {
@@ -55,6 +56,30 @@ static_assert(sizeof(DisplayListOp) == 4);
 
 class RecordingCanvas;
 
+// Lets playback draw small images out of shared textures, so that draws of different images can
+// be batched together. Only used while it is the current atlas of the drawing thread.
+class ImageAtlas {
+public:
+    virtual ~ImageAtlas() {}
+
+    // Returns the texture holding image and sets outBounds to the image's bounds within it, or
+    // returns nullptr when image has to be drawn on its own to canvas with paint.
+    virtual const SkImage* find(SkCanvas* canvas, const SkImage* image, const SkPaint& paint,
+                                SkRect* outBounds) = 0;
+
+    static ImageAtlas* current();
+
+    // Makes an atlas current on this thread for as long as the AutoCurrent is alive.
+    class AutoCurrent {
+    public:
+        explicit AutoCurrent(ImageAtlas* atlas);
+        ~AutoCurrent();
+
+    private:
+        ImageAtlas* mPrevious;
+    };
+};
+
 class DisplayListData final {
 public:
     DisplayListData() : mHasText(false) {}
@@ -67,7 +92,14 @@ public:
 
     void applyColorTransform(ColorTransform transform);
 
+    // Computes a draw order that groups ops sharing paint state, as long as that doesn't change
+    // what's drawn. Should be called once recording has finished.
+    void reorderForBatching();
+
     bool hasText() const { return mHasText; }
+    // Calls fn with the blob and paint of every text draw, in recording order.
+    void forEachTextBlob(
+            const std::function<void(const SkTextBlob* blob, const SkPaint& paint)>& fn) const;
     size_t usedSize() const { return fUsed; }
     size_t allocatedSize() const { return fReserved; }
 
@@ -138,6 +170,9 @@ private:
     size_t fUsed = 0;
     size_t fReserved = 0;
 
+    // Offsets of ops into fBytes in the order they are drawn; empty when that is record order.
+    std::vector<uint32_t> mDrawOrder;
+
     bool mHasText : 1;
 };
 
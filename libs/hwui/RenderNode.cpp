@@ -22,7 +22,9 @@
 #include "VectorDrawable.h"
 #include "private/hwui/WebViewFunctor.h"
 #ifdef __ANDROID__
+#include "Properties.h"
 #include "renderthread/CanvasContext.h"
+#include "thread/CommonPool.h"
 #else
 #include "DamageAccumulator.h"
 #include "pipeline/skia/SkiaDisplayList.h"
@@ -34,6 +36,7 @@
 #include <SkPathOps.h>
 #include <algorithm>
 #include <atomic>
+#include <set>
 #include <sstream>
 #include <string>
 #include <ui/FatVector.h>
@@ -67,6 +70,32 @@ RenderNode::RenderNode()
         , mAnimatorManager(*this)
         , mParentCount(0) {}
 
+// Every RenderNode that has an offscreen layer attached. Layers are detached before a node is
+// destroyed, see the destructor below, so this never holds dangling nodes.
+static std::set<const RenderNode*> sLayerNodes;
+
+void RenderNode::setLayerSurface(sk_sp<SkSurface> layer) {
+    if (layer.get()) {
+        if (!mSkiaLayer.get()) {
+            mSkiaLayer = std::make_unique<skiapipeline::SkiaLayer>();
+            sLayerNodes.insert(this);
+        }
+        mSkiaLayer->layerSurface = std::move(layer);
+        mSkiaLayer->inverseTransformInWindow.loadIdentity();
+    } else {
+        if (mSkiaLayer.get()) {
+            sLayerNodes.erase(this);
+        }
+        mSkiaLayer.reset();
+    }
+}
+
+void RenderNode::forEachLayer(const std::function<void(const RenderNode&)>& fn) {
+    for (const RenderNode* node : sLayerNodes) {
+        fn(*node);
+    }
+}
+
 RenderNode::~RenderNode() {
     ImmediateRemoved observer(nullptr);
     deleteDisplayList(observer);
@@ -260,11 +289,15 @@ void RenderNode::prepareTreeImpl(TreeObserver& observer, TreeInfo& info, bool fu
 
     if (mDisplayList) {
         info.out.hasFunctors |= mDisplayList->hasFunctor();
+        const bool childrenPrepared =
+                prepareChildrenInParallel(observer, info, childFunctorsNeedLayer);
         bool isDirty = mDisplayList->prepareListAndChildren(
                 observer, info, childFunctorsNeedLayer,
-                [](RenderNode* child, TreeObserver& observer, TreeInfo& info,
-                   bool functorsNeedLayer) {
-                    child->prepareTreeImpl(observer, info, functorsNeedLayer);
+                [childrenPrepared](RenderNode* child, TreeObserver& observer, TreeInfo& info,
+                                   bool functorsNeedLayer) {
+                    if (!childrenPrepared) {
+                        child->prepareTreeImpl(observer, info, functorsNeedLayer);
+                    }
                 });
         if (isDirty) {
             damageSelf(info);
@@ -278,6 +311,169 @@ void RenderNode::prepareTreeImpl(TreeObserver& observer, TreeInfo& info, bool fu
     info.damageAccumulator->popTransform();
 }
 
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+// Below these sizes fanning the children out costs more than preparing them serially.
+static constexpr size_t kMinParallelChildren = 4;
+static constexpr size_t kMinParallelNodes = 64;
+
+static std::atomic<int64_t> sParallelWalkId{0};
+
+// Collects the nodes that may have been removed while preparing a subtree on the CommonPool, so
+// that they can be handed to the real observer on the RenderThread.
+class DeferredRemoved : public TreeObserver {
+public:
+    void onMaybeRemovedFromTree(RenderNode* node) override { mMarked.emplace_back(node); }
+
+    void forwardTo(TreeObserver& observer) {
+        for (auto& node : mMarked) {
+            observer.onMaybeRemovedFromTree(node.get());
+        }
+    }
+
+private:
+    std::vector<sp<RenderNode>> mMarked;
+};
+
+// The preparation of one child subtree. Damage is accumulated in the parent's coordinate space
+// and merged into the parent's DamageAccumulator once all of the children are done.
+struct RenderNode::ParallelPrepareTask {
+    ParallelPrepareTask(const TreeInfo& parentInfo, RenderNode* node, const SkMatrix& matrix)
+            : node(node), matrix(matrix), info(parentInfo.mode, parentInfo.canvasContext) {
+        info.prepareTextures = false;
+        info.runAnimations = parentInfo.runAnimations;
+        info.damageAccumulator = &damageAccumulator;
+        info.damageGenerationId = parentInfo.damageGenerationId;
+        info.layerUpdateQueue = parentInfo.layerUpdateQueue;
+        info.errorHandler = parentInfo.errorHandler;
+        info.updateWindowPositions = parentInfo.updateWindowPositions;
+        info.disableForceDark = parentInfo.disableForceDark;
+        info.allowParallelPrepare = false;
+    }
+
+    void prepare(bool functorsNeedLayer) {
+        damageAccumulator.pushTransform(&matrix);
+        node->prepareTreeImpl(observer, info, functorsNeedLayer);
+        damageAccumulator.popTransform();
+        damageAccumulator.finish(&dirty);
+    }
+
+    RenderNode* node;
+    Matrix4 matrix;
+    DamageAccumulator damageAccumulator;
+    DeferredRemoved observer;
+    TreeInfo info;
+    SkRect dirty = SkRect::MakeEmpty();
+};
+
+/**
+ * Returns whether this node and everything below it can be prepared off the RenderThread. Layers,
+ * functors, animators, position listeners and images that must be pinned all need the
+ * RenderThread or the UI thread, and projection depends on the order of traversal. A node that
+ * is reachable from two of the subtrees being fanned out would be prepared concurrently, so that
+ * also prevents preparing the children in parallel.
+ */
+bool RenderNode::canPrepareInParallel(int64_t walkId, int taskIndex, size_t* nodeCount) {
+    if (mParallelWalkId == walkId) {
+        return mParallelTaskIndex == taskIndex;
+    }
+    mParallelWalkId = walkId;
+    mParallelTaskIndex = taskIndex;
+    (*nodeCount)++;
+
+    if (hasLayer() || mProperties.effectiveLayerType() == LayerType::RenderLayer ||
+        mStagingProperties.effectiveLayerType() == LayerType::RenderLayer ||
+        mProperties.getProjectBackwards() || mStagingProperties.getProjectBackwards() ||
+        mAnimatorManager.hasAnimators() || mAnimatorManager.hasNewAnimators() ||
+        mPositionListener.get() || mStagingPositionListener.get()) {
+        return false;
+    }
+
+    // Both lists are visited, as syncing adds the children of the staging list and removes
+    // the children of the current one.
+    for (DisplayList* displayList : {mDisplayList, mStagingDisplayList}) {
+        if (!displayList) {
+            continue;
+        }
+        if (displayList->hasFunctor() || displayList->hasVectorDrawables() ||
+            !displayList->mMutableImages.empty() || !displayList->mAnimatedImages.empty() ||
+            displayList->containsProjectionReceiver()) {
+            return false;
+        }
+        for (auto& child : displayList->mChildNodes) {
+            if (!child.getRenderNode()->canPrepareInParallel(walkId, taskIndex, nodeCount)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Prepares each child subtree of a wide node as its own task on the CommonPool. The results are
+ * merged back in child order, so damage and removed nodes are reported deterministically.
+ * Returns false, having done nothing, if the children must be prepared serially.
+ */
+bool RenderNode::prepareChildrenInParallel(TreeObserver& observer, TreeInfo& info,
+                                           bool functorsNeedLayer) {
+    if (!Properties::parallelPrepareTree || info.mode != TreeInfo::MODE_FULL ||
+        !info.allowParallelPrepare || mDisplayList->mChildNodes.size() < kMinParallelChildren) {
+        return false;
+    }
+
+    const int64_t walkId = ++sParallelWalkId;
+    size_t nodeCount = 0;
+    int taskIndex = 0;
+    for (auto& child : mDisplayList->mChildNodes) {
+        if (!child.getRenderNode()->canPrepareInParallel(walkId, taskIndex++, &nodeCount)) {
+            return false;
+        }
+    }
+    if (nodeCount < kMinParallelNodes) {
+        return false;
+    }
+
+    ATRACE_NAME("prepareChildrenInParallel");
+    std::vector<std::unique_ptr<ParallelPrepareTask>> tasks;
+    tasks.reserve(mDisplayList->mChildNodes.size());
+    for (auto& child : mDisplayList->mChildNodes) {
+        tasks.push_back(std::make_unique<ParallelPrepareTask>(info, child.getRenderNode(),
+                                                              child.getRecordedMatrix()));
+    }
+
+    // Run the first subtree here rather than idling while the pool works through the rest.
+    std::vector<std::future<void>> futures;
+    futures.reserve(tasks.size() - 1);
+    for (size_t i = 1; i < tasks.size(); i++) {
+        ParallelPrepareTask* task = tasks[i].get();
+        futures.push_back(CommonPool::async(
+                [task, functorsNeedLayer] { task->prepare(functorsNeedLayer); },
+                CommonPool::Priority::High));
+    }
+    tasks[0]->prepare(functorsNeedLayer);
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    for (auto& task : tasks) {
+        const SkRect& dirty = task->dirty;
+        if (!dirty.isEmpty()) {
+            info.damageAccumulator->dirty(dirty.fLeft, dirty.fTop, dirty.fRight, dirty.fBottom);
+        }
+        task->observer.forwardTo(observer);
+        const TreeInfo::Out& out = task->info.out;
+        info.out.hasFunctors |= out.hasFunctors;
+        info.out.hasAnimations |= out.hasAnimations;
+        info.out.requiresUiRedraw |= out.requiresUiRedraw;
+        info.out.canDrawThisFrame &= out.canDrawThisFrame;
+    }
+    return true;
+}
+#else
+bool RenderNode::prepareChildrenInParallel(TreeObserver&, TreeInfo&, bool) {
+    return false;
+}
+#endif
+
 void RenderNode::syncProperties() {
     mProperties = mStagingProperties;
 }
@@ -391,6 +587,12 @@ void RenderNode::destroyHardwareResources(TreeInfo* info) {
     if (hasLayer()) {
         this->setLayerSurface(nullptr);
     }
+    if (mDisplayList) {
+        // Stop decoding frames ahead for animated images that are no longer drawn.
+        for (auto& animatedImage : mDisplayList->mAnimatedImages) {
+            animatedImage->cancelPendingDecodes();
+        }
+    }
     setStagingDisplayList(nullptr);
 
     ImmediateRemoved observer(info);
@@ -486,6 +688,24 @@ const SkPath* RenderNode::getClippedOutline(const SkRect& clipRect) const {
     return &mClippedOutlineCache.clippedOutline;
 }
 
+const SkPath* RenderNode::getRevealClippedOutline(const SkPath& casterPath,
+                                                  const SkPath& revealClipPath) const {
+    const uint32_t casterID = casterPath.getGenerationID();
+    const uint32_t revealClipID = revealClipPath.getGenerationID();
+
+    if (casterID != mRevealClippedOutlineCache.casterID ||
+        revealClipID != mRevealClippedOutlineCache.revealClipID) {
+        // update the cache keys
+        mRevealClippedOutlineCache.casterID = casterID;
+        mRevealClippedOutlineCache.revealClipID = revealClipID;
+
+        // update the cache value by recomputing a new path
+        Op(casterPath, revealClipPath, kIntersect_SkPathOp,
+           &mRevealClippedOutlineCache.revealClippedOutline);
+    }
+    return &mRevealClippedOutlineCache.revealClippedOutline;
+}
+
 using StringBuffer = FatVector<char, 128>;
 
 template <typename... T>
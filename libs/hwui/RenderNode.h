@@ -38,6 +38,7 @@
 #include "pipeline/skia/SkiaDisplayList.h"
 #include "pipeline/skia/SkiaLayer.h"
 
+#include <functional>
 #include <vector>
 
 class SkBitmap;
@@ -228,6 +229,9 @@ private:
     void handleForceDark(TreeInfo* info);
 
     void prepareTreeImpl(TreeObserver& observer, TreeInfo& info, bool functorsNeedLayer);
+    bool prepareChildrenInParallel(TreeObserver& observer, TreeInfo& info,
+                                   bool functorsNeedLayer);
+    bool canPrepareInParallel(int64_t walkId, int taskIndex, size_t* nodeCount);
     void pushStagingPropertiesChanges(TreeInfo& info);
     void pushStagingDisplayListChanges(TreeObserver& observer, TreeInfo& info);
     void prepareLayer(TreeInfo& info, uint32_t dirtyMask);
@@ -257,6 +261,12 @@ private:
 
     int64_t mDamageGenerationId;
 
+    // The parallel prepare eligibility walk, and the subtree within it, that last visited this
+    // node. Only used on the RenderThread.
+    struct ParallelPrepareTask;
+    int64_t mParallelWalkId = 0;
+    int mParallelTaskIndex = -1;
+
     friend class AnimatorManager;
     AnimatorManager mAnimatorManager;
 
@@ -308,17 +318,13 @@ public:
      * Used by the RenderPipeline to attach an offscreen surface to the RenderNode.
      * The surface is then will be used to store the contents of a layer.
      */
-    void setLayerSurface(sk_sp<SkSurface> layer) {
-        if (layer.get()) {
-            if (!mSkiaLayer.get()) {
-                mSkiaLayer = std::make_unique<skiapipeline::SkiaLayer>();
-            }
-            mSkiaLayer->layerSurface = std::move(layer);
-            mSkiaLayer->inverseTransformInWindow.loadIdentity();
-        } else {
-            mSkiaLayer.reset();
-        }
-    }
+    void setLayerSurface(sk_sp<SkSurface> layer);
+
+    /**
+     * Calls fn for every RenderNode with an offscreen layer attached. Must be called on the
+     * thread that attaches layers, that is the RenderThread.
+     */
+    static void forEachLayer(const std::function<void(const RenderNode&)>& fn);
 
     /**
      * If the RenderNode is of type LayerType::RenderLayer then this method will
@@ -347,6 +353,17 @@ public:
      */
     const SkPath* getClippedOutline(const SkRect& clipRect) const;
 
+    /**
+     * Returns the shadow casting path of the RenderNode intersected with its reveal clip,
+     * caching the result like getClippedOutline. Keeping the same path while neither input
+     * changes lets the tessellation of its shadow be reused across frames.
+     *
+     * The returned path is only guaranteed to be valid until this function is called
+     * again or either of the input paths is mutated.
+     */
+    const SkPath* getRevealClippedOutline(const SkPath& casterPath,
+                                          const SkPath& revealClipPath) const;
+
 private:
     /**
      * If this RenderNode has been used in a previous frame then the SkiaDisplayList
@@ -372,6 +389,16 @@ private:
         SkPath clippedOutline;
     };
     mutable ClippedOutlineCache mClippedOutlineCache;
+
+    struct RevealClippedOutlineCache {
+        // keys
+        uint32_t casterID = 0;
+        uint32_t revealClipID = 0;
+
+        // value
+        SkPath revealClippedOutline;
+    };
+    mutable RevealClippedOutlineCache mRevealClippedOutlineCache;
 };  // class RenderNode
 
 class MarkAndSweepRemoved : public TreeObserver {
@@ -94,6 +94,10 @@ public:
 
     bool updateWindowPositions = false;
 
+    // Whether children may be prepared on the CommonPool, see
+    // Properties::parallelPrepareTree. Cleared for the traversals that run on the pool.
+    bool allowParallelPrepare = true;
+
     int disableForceDark;
 
     const SkISize screenSize;
@@ -40,6 +40,13 @@ namespace VectorDrawable {
 
 const int Tree::MAX_CACHED_BITMAP_SIZE = 2048;
 
+// Byte budget of the process-wide RasterCache; room for roughly 64 icons at 64x64.
+#define RASTER_CACHE_MAX_BYTES (1024 * 1024)
+
+// Rasters larger than this fraction of the budget are shared but not retained, so that a
+// single large drawable can't flush every icon from the cache.
+#define RASTER_CACHE_MAX_ENTRY_FRACTION 4
+
 void Path::dump() {
     ALOGD("Path: %s has %zu points", mName.c_str(), mProperties.getData().points.size());
 }
@@ -71,6 +78,13 @@ const SkPath& Path::getUpdatedPath(bool useStagingData, SkPath* tempStagingPath)
     }
 }
 
+void Path::hashContent(ContentHash* hash) const {
+    const Data& data = mProperties.getData();
+    hash->mix(data.verbs);
+    hash->mix(data.verbSizes);
+    hash->mix(data.points);
+}
+
 void Path::syncProperties() {
     if (mStagingPropertiesDirty) {
         mProperties.syncProperties(mStagingProperties);
@@ -147,6 +161,17 @@ void FullPath::dump() {
           mProperties.getFillColor(), mProperties.getFillAlpha());
 }
 
+void FullPath::hashContent(ContentHash* hash) const {
+    static const uint8_t kFullPathTag = 'F';
+    hash->mix(kFullPathTag);
+    Path::hashContent(hash);
+    hash->mix(mProperties.getPrimitiveFields());
+    hash->mix(mAntiAlias);
+    if (mProperties.getFillGradient() || mProperties.getStrokeGradient()) {
+        hash->setUnshareable();
+    }
+}
+
 inline SkColor applyAlpha(SkColor color, float alpha) {
     int alphaBytes = SkColorGetA(color);
     return SkColorSetA(color, alphaBytes * alpha);
@@ -272,6 +297,12 @@ void ClipPath::draw(SkCanvas* outCanvas, bool useStagingData) {
     outCanvas->clipPath(getUpdatedPath(useStagingData, &tempStagingPath));
 }
 
+void ClipPath::hashContent(ContentHash* hash) const {
+    static const uint8_t kClipPathTag = 'C';
+    hash->mix(kClipPathTag);
+    Path::hashContent(hash);
+}
+
 Group::Group(const Group& group) : Node(group) {
     mStagingProperties.syncProperties(group.mStagingProperties);
 }
@@ -291,6 +322,16 @@ void Group::draw(SkCanvas* outCanvas, bool useStagingData) {
     // Restore the previous clip and matrix information.
 }
 
+void Group::hashContent(ContentHash* hash) const {
+    static const uint8_t kGroupTag = 'G';
+    hash->mix(kGroupTag);
+    hash->mix(mProperties.mPrimitiveFields);
+    hash->mix(mChildren.size());
+    for (auto& child : mChildren) {
+        child->hashContent(hash);
+    }
+}
+
 void Group::dump() {
     ALOGD("Group %s has %zu children: ", mName.c_str(), mChildren.size());
     ALOGD("Group translateX, Y : %f, %f, scaleX, Y: %f, %f", mProperties.getTranslateX(),
@@ -486,6 +527,20 @@ void Tree::getPaintFor(SkPaint* outPaint, const TreeProperties& prop) const {
 }
 
 Bitmap& Tree::getBitmapUpdateIfDirty() {
+    int width = mProperties.getScaledWidth();
+    int height = mProperties.getScaledHeight();
+    if (mUseRasterCache && mAllowCaching) {
+        bool upToDate = mCache.bitmap && !mCache.dirty && mCache.bitmap->width() == width &&
+                        mCache.bitmap->height() == height;
+        if (upToDate || updateFromRasterCache(width, height)) {
+            return *mCache.bitmap;
+        }
+    }
+    if (mCache.shared) {
+        // Never draw into a raster other trees may be using.
+        mCache.bitmap.reset();
+        mCache.shared = false;
+    }
     bool redrawNeeded = allocateBitmapIfNeeded(mCache, mProperties.getScaledWidth(),
                                                mProperties.getScaledHeight());
     if (redrawNeeded || mCache.dirty) {
@@ -533,6 +588,42 @@ void Tree::updateBitmapCache(Bitmap& bitmap, bool useStagingData) {
     mRootNode->draw(&outCanvas, useStagingData);
 }
 
+bool Tree::updateFromRasterCache(int width, int height) {
+    ContentHash hash;
+    hash.mix(mProperties.getViewportWidth());
+    hash.mix(mProperties.getViewportHeight());
+    mRootNode->hashContent(&hash);
+    if (!hash.isShareable()) {
+        mUseRasterCache = false;
+        return false;
+    }
+    if (mCache.shared && mCache.contentHash != hash.value() && mCache.bitmap->width() == width &&
+        mCache.bitmap->height() == height) {
+        // The content changed without a size change, so this tree is being animated. Caching
+        // every intermediate frame would only evict the static icons the cache is meant for.
+        mUseRasterCache = false;
+        return false;
+    }
+
+    RasterCache& rasterCache = RasterCache::get();
+    sk_sp<Bitmap> bitmap = rasterCache.find(hash.value(), width, height);
+    if (!bitmap) {
+        SkImageInfo info = SkImageInfo::MakeN32(width, height, kPremul_SkAlphaType);
+        bitmap = Bitmap::allocateHeapBitmap(info);
+        if (!bitmap) {
+            return false;
+        }
+        updateBitmapCache(*bitmap, false);
+        bitmap->setImmutable();
+        rasterCache.put(hash.value(), width, height, bitmap);
+    }
+    mCache.bitmap = std::move(bitmap);
+    mCache.shared = true;
+    mCache.contentHash = hash.value();
+    mCache.dirty = false;
+    return true;
+}
+
 bool Tree::allocateBitmapIfNeeded(Cache& cache, int width, int height) {
     if (!canReuseBitmap(cache.bitmap.get(), width, height)) {
         SkImageInfo info = SkImageInfo::MakeN32(width, height, kPremul_SkAlphaType);
@@ -628,6 +719,74 @@ BitmapPalette Tree::computePalette() {
     return BitmapPalette::Unknown;
 }
 
+RasterCache& RasterCache::get() {
+    static RasterCache sInstance;
+    return sInstance;
+}
+
+RasterCache::RasterCache() : mMaxBytes(RASTER_CACHE_MAX_BYTES) {}
+
+sk_sp<Bitmap> RasterCache::find(uint64_t contentHash, int width, int height) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find({contentHash, width, height});
+    if (it == mEntries.end()) {
+        return nullptr;
+    }
+    mLru.splice(mLru.begin(), mLru, it->second);
+    return it->second->second;
+}
+
+void RasterCache::put(uint64_t contentHash, int width, int height, const sk_sp<Bitmap>& bitmap) {
+    std::lock_guard<std::mutex> lock(mLock);
+    size_t size = bitmap->getAllocationByteCount();
+    if (size > mMaxBytes / RASTER_CACHE_MAX_ENTRY_FRACTION) {
+        return;
+    }
+    Key key = {contentHash, width, height};
+    if (mEntries.find(key) != mEntries.end()) {
+        return;
+    }
+    trimLocked(mMaxBytes - size);
+    mLru.emplace_front(key, bitmap);
+    mEntries[key] = mLru.begin();
+    mUsedBytes += size;
+}
+
+void RasterCache::clear() {
+    std::lock_guard<std::mutex> lock(mLock);
+    trimLocked(0);
+}
+
+void RasterCache::setMaxBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mMaxBytes = maxBytes;
+    trimLocked(maxBytes);
+}
+
+size_t RasterCache::getMaxBytes() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mMaxBytes;
+}
+
+size_t RasterCache::getUsedBytes() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mUsedBytes;
+}
+
+size_t RasterCache::getEntryCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mEntries.size();
+}
+
+void RasterCache::trimLocked(size_t maxBytes) {
+    while (mUsedBytes > maxBytes && !mLru.empty()) {
+        auto& entry = mLru.back();
+        mUsedBytes -= entry.second->getAllocationByteCount();
+        mEntries.erase(entry.first);
+        mLru.pop_back();
+    }
+}
+
 }  // namespace VectorDrawable
 
 }  // namespace uirenderer
@@ -36,7 +36,10 @@
 
 #include <cutils/compiler.h>
 #include <stddef.h>
+#include <list>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
@@ -97,6 +100,40 @@ private:
     bool* mStagingDirty;
 };
 
+/*
+ * 64-bit FNV-1a hash over the render thread properties of a tree. Used as the content half of the
+ * RasterCache key, so every property that affects the rasterized result must be mixed in. Trees
+ * whose content can't be identified by value (e.g. gradients, which are only known by pointer)
+ * mark the hash unshareable.
+ */
+class ContentHash {
+public:
+    void mix(const void* data, size_t size) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            mHash = (mHash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    template <typename T>
+    void mix(const std::vector<T>& values) {
+        size_t count = values.size();
+        mix(&count, sizeof(count));
+        mix(values.data(), count * sizeof(T));
+    }
+    template <typename T>
+    void mix(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "ContentHash needs plain data");
+        mix(&value, sizeof(T));
+    }
+    void setUnshareable() { mShareable = false; }
+    bool isShareable() const { return mShareable; }
+    uint64_t value() const { return mHash; }
+
+private:
+    uint64_t mHash = 14695981039346656037ull;
+    bool mShareable = true;
+};
+
 class ANDROID_API Node {
 public:
     class Properties {
@@ -122,6 +159,9 @@ public:
 
     virtual void forEachFillColor(const std::function<void(SkColor)>& func) const { }
 
+    // Mixes the render thread properties of this node (and its children) into the hash.
+    virtual void hashContent(ContentHash* hash) const = 0;
+
 protected:
     std::string mName;
     PropertyChangedListener* mPropertyChangedListener = nullptr;
@@ -167,6 +207,7 @@ public:
     Path() {}
 
     void dump() override;
+    void hashContent(ContentHash* hash) const override;
     virtual void syncProperties() override;
     virtual void onPropertyChanged(Properties* prop) override {
         if (prop == &mStagingProperties) {
@@ -301,6 +342,7 @@ public:
         // Set property values during animation
         void setColorPropertyValue(int propertyId, int32_t value);
         void setPropertyValue(int propertyId, float value);
+        const PrimitiveFields& getPrimitiveFields() const { return mPrimitiveFields; }
         bool mTrimDirty;
 
     private:
@@ -330,6 +372,7 @@ public:
     FullPath() : Path() {}
     void draw(SkCanvas* outCanvas, bool useStagingData) override;
     void dump() override;
+    void hashContent(ContentHash* hash) const override;
     FullPathProperties* mutateStagingProperties() { return &mStagingProperties; }
     const FullPathProperties* stagingProperties() { return &mStagingProperties; }
 
@@ -375,6 +418,7 @@ public:
     ClipPath(const char* path, size_t strLength) : Path(path, strLength) {}
     ClipPath() : Path() {}
     void draw(SkCanvas* outCanvas, bool useStagingData) override;
+    void hashContent(ContentHash* hash) const override;
     virtual void setAntiAlias(bool aa) {}
 };
 
@@ -464,6 +508,7 @@ public:
     virtual void draw(SkCanvas* outCanvas, bool useStagingData) override;
     void getLocalMatrix(SkMatrix* outMatrix, const GroupProperties& properties);
     void dump() override;
+    void hashContent(ContentHash* hash) const override;
     static bool isValidProperty(int propertyId);
 
     virtual void onPropertyChanged(Properties* properties) override {
@@ -658,8 +703,12 @@ private:
     public:
         sk_sp<Bitmap> bitmap;  // used by HWUI pipeline and software
         bool dirty = true;
+        // Set when bitmap is owned by the RasterCache and must not be drawn into.
+        bool shared = false;
+        uint64_t contentHash = 0;
     };
 
+    bool updateFromRasterCache(int width, int height);
     bool allocateBitmapIfNeeded(Cache& cache, int width, int height);
     bool canReuseBitmap(Bitmap*, int width, int height);
     void updateBitmapCache(Bitmap& outCache, bool useStagingData);
@@ -670,6 +719,8 @@ private:
     const static int MAX_CACHED_BITMAP_SIZE;
 
     bool mAllowCaching = true;
+    // Cleared once the tree is seen animating, after which it rasterizes into a private bitmap.
+    bool mUseRasterCache = true;
     std::unique_ptr<Group> mRootNode;
 
     TreeProperties mProperties = TreeProperties(this);
@@ -684,6 +735,54 @@ private:
     mutable bool mWillBeConsumed = false;
 };
 
+/*
+ * Process-wide cache of VectorDrawable rasters, keyed by tree content and raster size, so that
+ * trees inflated from the same resource share one bitmap (and therefore one GPU texture) instead
+ * of each rasterizing their own. Tint and root alpha are applied when the raster is drawn and are
+ * not part of the key. Entries are evicted in LRU order once the byte budget is exceeded; bitmaps
+ * still referenced by a tree stay alive until that tree re-rasterizes.
+ */
+class ANDROID_API RasterCache {
+public:
+    static RasterCache& get();
+
+    sk_sp<Bitmap> find(uint64_t contentHash, int width, int height);
+    void put(uint64_t contentHash, int width, int height, const sk_sp<Bitmap>& bitmap);
+    void clear();
+
+    void setMaxBytes(size_t maxBytes);
+    size_t getMaxBytes();
+    size_t getUsedBytes();
+    size_t getEntryCount();
+
+private:
+    struct Key {
+        uint64_t contentHash;
+        int width;
+        int height;
+        bool operator==(const Key& other) const {
+            return contentHash == other.contentHash && width == other.width &&
+                   height == other.height;
+        }
+    };
+    struct KeyHasher {
+        size_t operator()(const Key& key) const {
+            return key.contentHash ^ (static_cast<uint64_t>(key.width) << 32) ^ key.height;
+        }
+    };
+    typedef std::list<std::pair<Key, sk_sp<Bitmap>>> LruList;
+
+    void trimLocked(size_t maxBytes);
+
+    std::mutex mLock;
+    LruList mLru;
+    std::unordered_map<Key, LruList::iterator, KeyHasher> mEntries;
+    size_t mUsedBytes = 0;
+    size_t mMaxBytes;
+
+    RasterCache();
+};
+
 }  // namespace VectorDrawable
 
 typedef VectorDrawable::Path::Data PathData;
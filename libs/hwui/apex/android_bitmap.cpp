@@ -138,6 +138,10 @@ ADataSpace ABitmap_getDataSpace(ABitmap* bitmapHandle) {
     return (ADataSpace)uirenderer::ColorSpaceToADataSpace(info.colorSpace(), info.colorType());
 }
 
+uint32_t ABitmap_getGenerationId(ABitmap* bitmapHandle) {
+    return TypeCast::toBitmap(bitmapHandle)->getGenerationID();
+}
+
 AndroidBitmapInfo ABitmap_getInfoFromJava(JNIEnv* env, jobject bitmapObj) {
     uint32_t rowBytes = 0;
     bool isHardware = false;
@@ -55,6 +55,12 @@ ANDROID_API void ABitmap_releaseRef(ABitmap* bitmap);
 ANDROID_API AndroidBitmapInfo ABitmap_getInfo(ABitmap* bitmap);
 ANDROID_API ADataSpace ABitmap_getDataSpace(ABitmap* bitmap);
 
+/**
+ * @return an id that is unique to the current pixels of the bitmap. It changes whenever the
+ *         pixels are changed, and is never shared with another bitmap.
+ */
+ANDROID_API uint32_t ABitmap_getGenerationId(ABitmap* bitmap);
+
 ANDROID_API void* ABitmap_getPixels(ABitmap* bitmap);
 ANDROID_API void ABitmap_notifyPixelsChanged(ABitmap* bitmap);
 
@@ -129,6 +135,7 @@ namespace graphics {
 
         AndroidBitmapInfo getInfo() const { return ABitmap_getInfo(mBitmap); }
         ADataSpace getDataSpace() const { return ABitmap_getDataSpace(mBitmap); }
+        uint32_t getGenerationId() const { return ABitmap_getGenerationId(mBitmap); }
         void* getPixels() const { return ABitmap_getPixels(mBitmap); }
         void notifyPixelsChanged() const { ABitmap_notifyPixelsChanged(mBitmap); }
         AHardwareBuffer* getHardwareBuffer() const { return ABitmap_getHardwareBuffer(mBitmap); }
@@ -26,6 +26,10 @@
 
 #include <optional>
 
+// Number of frames decoded ahead of the one being shown, so that a busy
+// AnimatedImageThread does not immediately cause a dropped frame.
+#define ANIMATED_IMAGE_LOOKAHEAD_FRAMES 2
+
 namespace android {
 
 AnimatedImageDrawable::AnimatedImageDrawable(sk_sp<SkAnimatedImage> animatedImage, size_t bytesUsed)
@@ -51,6 +55,8 @@ bool AnimatedImageDrawable::start() {
 bool AnimatedImageDrawable::stop() {
     bool wasRunning = mRunning;
     mRunning = false;
+    // The frames decoded ahead are kept. If the animation is started again
+    // while it still shows its first frame, they are the frames it shows next.
     return wasRunning;
 }
 
@@ -58,9 +64,48 @@ bool AnimatedImageDrawable::isRunning() {
     return mRunning;
 }
 
-bool AnimatedImageDrawable::nextSnapshotReady() const {
-    return mNextSnapshot.valid() &&
-           mNextSnapshot.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+// Only called on the RenderThread.
+void AnimatedImageDrawable::collectDecodedSnapshots() {
+    const uint32_t generation = mDecodeGeneration.load();
+    if (generation != mPendingGeneration) {
+        // Anything queued before the cancellation is stale. The decodes that
+        // have not run yet are skipped by the AnimatedImageThread.
+        mPendingSnapshots.clear();
+        mDecodedSnapshots.clear();
+        mPendingGeneration = generation;
+        return;
+    }
+
+    // Frames for one drawable are decoded in order, so stop at the first one
+    // that is not ready yet.
+    while (!mPendingSnapshots.empty() &&
+           mPendingSnapshots.front().wait_for(std::chrono::seconds(0)) ==
+                   std::future_status::ready) {
+        Snapshot snap = mPendingSnapshots.front().get();
+        mPendingSnapshots.pop_front();
+        if (!snap.mPic) {
+            // The decode was skipped because it raced with a cancellation.
+            mPendingSnapshots.clear();
+            return;
+        }
+        mDecodedSnapshots.push_back(std::move(snap));
+    }
+}
+
+// Only called on the RenderThread.
+void AnimatedImageDrawable::queueDecodes() {
+#ifdef __ANDROID__ // Layoutlib does not support AnimatedImageThread
+    auto& thread = uirenderer::AnimatedImageThread::getInstance();
+    while (mPendingSnapshots.size() + mDecodedSnapshots.size() < ANIMATED_IMAGE_LOOKAHEAD_FRAMES) {
+        mPendingSnapshots.push_back(thread.decodeNextFrame(sk_ref_sp(this)));
+    }
+#endif
+}
+
+// Only called on the RenderThread.
+bool AnimatedImageDrawable::nextSnapshotReady() {
+    collectDecodedSnapshots();
+    return !mDecodedSnapshots.empty();
 }
 
 // Only called on the RenderThread while UI thread is locked.
@@ -74,10 +119,11 @@ bool AnimatedImageDrawable::isDirty(nsecs_t* outDelay) {
         return false;
     }
 
+    const bool ready = nextSnapshotReady();
     std::unique_lock lock{mSwapLock};
     mCurrentTime += currentTime - lastWallTime;
 
-    if (!mNextSnapshot.valid()) {
+    if (mPendingSnapshots.empty() && mDecodedSnapshots.empty()) {
         // Need to trigger onDraw in order to start decoding the next frame.
         *outDelay = mTimeToShowNextSnapshot - mCurrentTime;
         return true;
@@ -85,12 +131,11 @@ bool AnimatedImageDrawable::isDirty(nsecs_t* outDelay) {
 
     if (mTimeToShowNextSnapshot > mCurrentTime) {
         *outDelay = mTimeToShowNextSnapshot - mCurrentTime;
-    } else if (nextSnapshotReady()) {
+    } else if (ready) {
         // We have not yet updated mTimeToShowNextSnapshot. Read frame duration
-        // directly from mSkAnimatedImage.
-        lock.unlock();
-        std::unique_lock imageLock{mImageLock};
-        *outDelay = ms2ns(mSkAnimatedImage->currentFrameDuration());
+        // from the snapshot that will be shown next.
+        const int durationMS = mDecodedSnapshots.front().mDurationMS;
+        *outDelay = durationMS == SkAnimatedImage::kFinished ? 0 : ms2ns(durationMS);
         return true;
     } else {
         // The next snapshot has not yet been decoded, but we've already passed
@@ -109,6 +154,7 @@ AnimatedImageDrawable::Snapshot AnimatedImageDrawable::decodeNextFrame() {
         std::unique_lock lock{mImageLock};
         snap.mDurationMS = mSkAnimatedImage->decodeNextFrame();
         snap.mPic.reset(mSkAnimatedImage->newPictureSnapshot());
+        snap.mFrameIndex = ++mImageFrameIndex;
     }
 
     return snap;
@@ -120,8 +166,10 @@ AnimatedImageDrawable::Snapshot AnimatedImageDrawable::reset() {
     {
         std::unique_lock lock{mImageLock};
         mSkAnimatedImage->reset();
+        mImageFrameIndex = 0;
         snap.mPic.reset(mSkAnimatedImage->newPictureSnapshot());
         snap.mDurationMS = mSkAnimatedImage->currentFrameDuration();
+        snap.mFrameIndex = 0;
     }
 
     return snap;
@@ -159,12 +207,21 @@ void AnimatedImageDrawable::onDraw(SkCanvas* canvas) {
         if (!mRunning) {
             return;
         }
+    } else if (starting && mSnapshot.mFrameIndex == 0) {
+        // The animation is restarted while it still shows its first frame, so
+        // the frames decoded ahead are still the ones to show next. Show the
+        // first frame for its full duration again.
+        std::unique_lock lock{mSwapLock};
+        mTimeToShowNextSnapshot = mCurrentTime + ms2ns(mSnapshot.mDurationMS);
     } else if (starting) {
         // The image has animated, and now is being reset. Queue up the first
         // frame, but keep showing the current frame until the first is ready.
 #ifdef __ANDROID__ // Layoutlib does not support AnimatedImageThread
+        // Frames decoded ahead belong to the previous run of the animation.
+        cancelPendingDecodes();
+        collectDecodedSnapshots();
         auto& thread = uirenderer::AnimatedImageThread::getInstance();
-        mNextSnapshot = thread.reset(sk_ref_sp(this));
+        mPendingSnapshots.push_back(thread.reset(sk_ref_sp(this)));
 #endif
     }
 
@@ -172,11 +229,15 @@ void AnimatedImageDrawable::onDraw(SkCanvas* canvas) {
     if (mRunning && nextSnapshotReady()) {
         std::unique_lock lock{mSwapLock};
         if (mCurrentTime >= mTimeToShowNextSnapshot) {
-            mSnapshot = mNextSnapshot.get();
+            mSnapshot = std::move(mDecodedSnapshots.front());
+            mDecodedSnapshots.pop_front();
             const nsecs_t timeToShowCurrentSnap = mTimeToShowNextSnapshot;
             if (mSnapshot.mDurationMS == SkAnimatedImage::kFinished) {
                 finalFrame = true;
                 mRunning = false;
+                // Anything decoded past the end is just another final frame.
+                mPendingSnapshots.clear();
+                mDecodedSnapshots.clear();
             } else {
                 mTimeToShowNextSnapshot += ms2ns(mSnapshot.mDurationMS);
                 if (mCurrentTime >= mTimeToShowNextSnapshot) {
@@ -190,11 +251,8 @@ void AnimatedImageDrawable::onDraw(SkCanvas* canvas) {
         }
     }
 
-    if (mRunning && !mNextSnapshot.valid()) {
-#ifdef __ANDROID__ // Layoutlib does not support AnimatedImageThread
-        auto& thread = uirenderer::AnimatedImageThread::getInstance();
-        mNextSnapshot = thread.decodeNextFrame(sk_ref_sp(this));
-#endif
+    if (mRunning) {
+        queueDecodes();
     }
 
     if (!drawDirectly) {
@@ -238,6 +296,7 @@ int AnimatedImageDrawable::drawStaging(SkCanvas* canvas) {
         {
             std::unique_lock lock{mImageLock};
             mSkAnimatedImage->reset();
+            mImageFrameIndex = 0;
             durationMS = mSkAnimatedImage->currentFrameDuration();
         }
         {
@@ -271,6 +330,7 @@ int AnimatedImageDrawable::drawStaging(SkCanvas* canvas) {
         std::unique_lock lock{mImageLock};
         if (update) {
             durationMS = mSkAnimatedImage->decodeNextFrame();
+            mImageFrameIndex++;
         }
 
         canvas->drawDrawable(mSkAnimatedImage.get());
@@ -27,6 +27,8 @@
 #include <SkDrawable.h>
 #include <SkPicture.h>
 
+#include <atomic>
+#include <deque>
 #include <future>
 #include <mutex>
 
@@ -93,6 +95,8 @@ public:
     struct Snapshot {
         sk_sp<SkPicture> mPic;
         int mDurationMS;
+        // Frames decoded since the last reset of mSkAnimatedImage. 0 is the first frame.
+        int mFrameIndex = 0;
 
         Snapshot() = default;
 
@@ -102,6 +106,13 @@ public:
         PREVENT_COPY_AND_ASSIGN(Snapshot);
     };
 
+    // Drops the frames that have been queued or decoded ahead of time, e.g.
+    // because the drawable was removed from the tree. Frames still waiting on
+    // the AnimatedImageThread are skipped rather than decoded. May be called
+    // from any thread.
+    void cancelPendingDecodes() { mDecodeGeneration++; }
+    uint32_t decodeGeneration() const { return mDecodeGeneration.load(); }
+
     // These are only called on AnimatedImageThread.
     Snapshot decodeNextFrame();
     Snapshot reset();
@@ -115,17 +126,32 @@ private:
     sk_sp<SkAnimatedImage> mSkAnimatedImage;
     const size_t mBytesUsed;
 
+    // The index of the frame mSkAnimatedImage is on, counted from its last reset.
+    // Guarded by mImageLock.
+    int mImageFrameIndex = 0;
+
     bool mRunning = false;
     bool mStarting = false;
 
     // A snapshot of the current frame to draw.
     Snapshot mSnapshot;
 
-    std::future<Snapshot> mNextSnapshot;
+    // Frames queued on the AnimatedImageThread, in the order they will be shown.
+    std::deque<std::future<Snapshot>> mPendingSnapshots;
+
+    // Frames that have finished decoding but are not yet due to be shown.
+    std::deque<Snapshot> mDecodedSnapshots;
+
+    // Bumped by cancelPendingDecodes(). mPendingGeneration is the value the
+    // queues above were filled under; a mismatch means they must be dropped.
+    std::atomic<uint32_t> mDecodeGeneration{0};
+    uint32_t mPendingGeneration = 0;
 
-    bool nextSnapshotReady() const;
+    void collectDecodedSnapshots();
+    void queueDecodes();
+    bool nextSnapshotReady();
 
-    // When to switch from mSnapshot to mNextSnapshot.
+    // When to switch from mSnapshot to the next decoded snapshot.
     nsecs_t mTimeToShowNextSnapshot = 0;
 
     // The current time for the drawable itself.
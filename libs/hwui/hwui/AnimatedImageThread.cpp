@@ -18,6 +18,13 @@
 
 #include <sys/resource.h>
 
+#include <algorithm>
+#include <string>
+#include <thread>
+
+// Upper bound on the number of decoding threads, whatever the core count.
+#define ANIMATED_IMAGE_MAX_THREADS 4
+
 namespace android {
 namespace uirenderer {
 
@@ -27,18 +34,40 @@ AnimatedImageThread& AnimatedImageThread::getInstance() {
 }
 
 AnimatedImageThread::AnimatedImageThread() {
-    setpriority(PRIO_PROCESS, 0, PRIORITY_NORMAL + PRIORITY_MORE_FAVORABLE);
-    start("AnimatedImageThread");
+    const int cpuCount = std::thread::hardware_concurrency();
+    const int threadCount = std::clamp(cpuCount / 2, 1, ANIMATED_IMAGE_MAX_THREADS);
+    for (int i = 0; i < threadCount; i++) {
+        sp<ThreadBase> worker = new ThreadBase();
+        worker->queue().post(
+                []() { setpriority(PRIO_PROCESS, 0, PRIORITY_NORMAL + PRIORITY_MORE_FAVORABLE); });
+        worker->start(("AnimatedImage" + std::to_string(i)).c_str());
+        mWorkers.push_back(std::move(worker));
+    }
+}
+
+WorkQueue& AnimatedImageThread::queueFor(const AnimatedImageDrawable* drawable) {
+    // Allocations are aligned, so mix the pointer before picking a worker.
+    uint64_t hash = reinterpret_cast<uintptr_t>(drawable);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return mWorkers[hash % mWorkers.size()]->queue();
 }
 
 std::future<AnimatedImageDrawable::Snapshot> AnimatedImageThread::decodeNextFrame(
         const sk_sp<AnimatedImageDrawable>& drawable) {
-    return queue().async([drawable]() { return drawable->decodeNextFrame(); });
+    const uint32_t generation = drawable->decodeGeneration();
+    return queueFor(drawable.get()).async([drawable, generation]() {
+        if (drawable->decodeGeneration() != generation) {
+            return AnimatedImageDrawable::Snapshot();
+        }
+        return drawable->decodeNextFrame();
+    });
 }
 
 std::future<AnimatedImageDrawable::Snapshot> AnimatedImageThread::reset(
         const sk_sp<AnimatedImageDrawable>& drawable) {
-    return queue().async([drawable]() { return drawable->reset(); });
+    return queueFor(drawable.get()).async([drawable]() { return drawable->reset(); });
 }
 
 }  // namespace uirenderer
@@ -22,22 +22,35 @@
 
 #include <SkRefCnt.h>
 
+#include <vector>
+
 namespace android {
 
 namespace uirenderer {
 
-class AnimatedImageThread : private ThreadBase {
+/**
+ * A small pool of threads decoding frames for AnimatedImageDrawables. Each
+ * drawable is always served by the same thread, so that its decodes run in
+ * the order they were queued, while different drawables decode in parallel.
+ */
+class AnimatedImageThread {
     PREVENT_COPY_AND_ASSIGN(AnimatedImageThread);
 
 public:
     static AnimatedImageThread& getInstance();
 
+    // Decodes are skipped, returning an empty Snapshot, if the drawable's
+    // pending decodes are cancelled before they run.
     std::future<AnimatedImageDrawable::Snapshot> decodeNextFrame(
             const sk_sp<AnimatedImageDrawable>&);
     std::future<AnimatedImageDrawable::Snapshot> reset(const sk_sp<AnimatedImageDrawable>&);
 
 private:
     AnimatedImageThread();
+
+    WorkQueue& queueFor(const AnimatedImageDrawable* drawable);
+
+    std::vector<sp<ThreadBase>> mWorkers;
 };
 
 }  // namespace uirenderer
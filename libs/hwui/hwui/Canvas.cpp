@@ -151,21 +151,31 @@ void Canvas::drawText(const uint16_t* text, int textSize, int start, int count,
         paint.getSkFont().setHinting(SkFontHinting::kNone);
     }
 
-    minikin::Layout layout = MinikinUtils::doLayout(&paint, bidiFlags, typeface, text, textSize,
-                                                    start, count, contextStart, contextCount, mt);
-
-    x += MinikinUtils::xOffsetForTextAlign(&paint, layout);
-
-    minikin::MinikinRect bounds;
-    layout.getBounds(&bounds);
-
-    // Set align to left for drawing, as we don't want individual
-    // glyphs centered or right-aligned; the offset above takes
-    // care of all alignment.
-    paint.setTextAlign(Paint::kLeft_Align);
-
-    DrawTextFunctor f(layout, this, paint, x, y, bounds, layout.getAdvance());
-    MinikinUtils::forFontRun(layout, &paint, f);
+    auto drawLayout = [&](const minikin::Layout& layout) {
+        x += MinikinUtils::xOffsetForTextAlign(&paint, layout);
+
+        minikin::MinikinRect bounds;
+        layout.getBounds(&bounds);
+
+        // Set align to left for drawing, as we don't want individual
+        // glyphs centered or right-aligned; the offset above takes
+        // care of all alignment.
+        paint.setTextAlign(Paint::kLeft_Align);
+
+        DrawTextFunctor f(layout, this, paint, x, y, bounds, layout.getAdvance());
+        MinikinUtils::forFontRun(layout, &paint, f);
+    };
+
+    if (mt == nullptr) {
+        // Usually shaped already, when the text was measured.
+        std::shared_ptr<const minikin::Layout> layout = MinikinUtils::doLayoutCached(
+                &paint, bidiFlags, typeface, text, textSize, start, count, contextStart,
+                contextCount);
+        drawLayout(*layout);
+    } else {
+        drawLayout(MinikinUtils::doLayout(&paint, bidiFlags, typeface, text, textSize, start,
+                                          count, contextStart, contextCount, mt));
+    }
 }
 
 void Canvas::drawDoubleRoundRectXY(float outerLeft, float outerTop, float outerRight,
@@ -16,17 +16,157 @@
 
 #include "MinikinUtils.h"
 
+#include <cstring>
+#include <list>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <log/log.h>
+#include <utils/JenkinsHash.h>
 
 #include <minikin/MeasuredText.h>
 #include "Paint.h"
 #include "SkPathMeasure.h"
 #include "Typeface.h"
 
+// Longer runs are shaped without the layout cache. They are rarely measured and drawn
+// unchanged, and would make each entry expensive to compare.
+#define LAYOUT_CACHE_MAX_LENGTH 256
+#define LAYOUT_CACHE_MAX_ENTRIES 256
+
 namespace android {
 
+namespace {
+
+struct LayoutKey {
+    // The context range of the text; start and count are relative to it.
+    std::vector<uint16_t> text;
+    uint32_t start;
+    uint32_t count;
+    minikin::Bidi bidiFlags;
+    minikin::MinikinPaint paint;
+    minikin::StartHyphenEdit startHyphen;
+    minikin::EndHyphenEdit endHyphen;
+    hash_t hash;
+
+    LayoutKey(const uint16_t* context, size_t contextCount, size_t start, size_t count,
+              minikin::Bidi bidiFlags, const minikin::MinikinPaint& paint,
+              minikin::StartHyphenEdit startHyphen, minikin::EndHyphenEdit endHyphen)
+            : text(context, context + contextCount)
+            , start(start)
+            , count(count)
+            , bidiFlags(bidiFlags)
+            , paint(paint)
+            , startHyphen(startHyphen)
+            , endHyphen(endHyphen) {
+        hash = JenkinsHashMixShorts(0, text.data(), text.size());
+        hash = JenkinsHashMix(hash, this->start);
+        hash = JenkinsHashMix(hash, this->count);
+        hash = JenkinsHashMix(hash, static_cast<uint32_t>(bidiFlags));
+        hash = JenkinsHashMix(hash, floatBits(paint.size));
+        hash = JenkinsHashMix(hash, floatBits(paint.scaleX));
+        hash = JenkinsHashMix(hash, floatBits(paint.skewX));
+        hash = JenkinsHashMix(hash, floatBits(paint.letterSpacing));
+        hash = JenkinsHashMix(hash, floatBits(paint.wordSpacing));
+        hash = JenkinsHashMix(hash, paint.fontFlags);
+        hash = JenkinsHashMix(hash, paint.localeListId);
+        hash = JenkinsHashMix(hash, static_cast<uint32_t>(paint.familyVariant));
+        hash = JenkinsHashMix(hash, static_cast<uint32_t>(
+                                            reinterpret_cast<uintptr_t>(paint.font.get())));
+        hash = JenkinsHashMix(hash, static_cast<uint32_t>(startHyphen));
+        hash = JenkinsHashMix(hash, static_cast<uint32_t>(endHyphen));
+        hash = JenkinsHashWhiten(hash);
+    }
+
+    static uint32_t floatBits(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    bool operator==(const LayoutKey& other) const {
+        return hash == other.hash && start == other.start && count == other.count &&
+               bidiFlags == other.bidiFlags && startHyphen == other.startHyphen &&
+               endHyphen == other.endHyphen && paint.size == other.paint.size &&
+               paint.scaleX == other.paint.scaleX && paint.skewX == other.paint.skewX &&
+               paint.letterSpacing == other.paint.letterSpacing &&
+               paint.wordSpacing == other.paint.wordSpacing &&
+               paint.fontFlags == other.paint.fontFlags &&
+               paint.localeListId == other.paint.localeListId &&
+               paint.familyVariant == other.paint.familyVariant &&
+               paint.fontStyle == other.paint.fontStyle && paint.font == other.paint.font &&
+               paint.fontFeatureSettings == other.paint.fontFeatureSettings && text == other.text;
+    }
+};
+
+struct LayoutKeyHash {
+    size_t operator()(const LayoutKey& key) const { return key.hash; }
+};
+
+/**
+ * A bounded LRU cache of whole-run layouts. minikin caches the shaping of each word, but
+ * assembling a Layout for a run still costs a pass over all of its pieces, and every
+ * measure followed by a draw of the same text paid it twice.
+ */
+class LayoutCache {
+public:
+    static LayoutCache& get() {
+        static LayoutCache* sInstance = new LayoutCache();
+        return *sInstance;
+    }
+
+    std::shared_ptr<const minikin::Layout> getOrCreate(const LayoutKey& key) {
+        {
+            std::lock_guard lock(mLock);
+            auto it = mEntries.find(key);
+            if (it != mEntries.end()) {
+                mLru.splice(mLru.begin(), mLru, it->second);
+                return it->second->second;
+            }
+        }
+
+        // Shape outside of the lock; another thread may race us to insert the same key, in
+        // which case the first insertion is kept.
+        const minikin::U16StringPiece textBuf(key.text.data(), key.text.size());
+        const minikin::Range range(key.start, key.start + key.count);
+        auto layout = std::make_shared<const minikin::Layout>(
+                textBuf, range, key.bidiFlags, key.paint, key.startHyphen, key.endHyphen);
+
+        std::lock_guard lock(mLock);
+        auto [it, inserted] = mEntries.emplace(key, mLru.end());
+        if (!inserted) {
+            return it->second->second;
+        }
+        mLru.emplace_front(&it->first, layout);
+        it->second = mLru.begin();
+        while (mLru.size() > LAYOUT_CACHE_MAX_ENTRIES) {
+            mEntries.erase(*mLru.back().first);
+            mLru.pop_back();
+        }
+        return layout;
+    }
+
+    void clear() {
+        std::lock_guard lock(mLock);
+        mEntries.clear();
+        mLru.clear();
+    }
+
+private:
+    LayoutCache() = default;
+
+    using LruList = std::list<std::pair<const LayoutKey*, std::shared_ptr<const minikin::Layout>>>;
+
+    std::mutex mLock;
+    // Most recently used first. Keys point into mEntries, whose nodes never move.
+    LruList mLru;
+    std::unordered_map<LayoutKey, LruList::iterator, LayoutKeyHash> mEntries;
+};
+
+}  // namespace
+
 minikin::MinikinPaint MinikinUtils::prepareMinikinPaint(const Paint* paint,
                                                         const Typeface* typeface) {
     const Typeface* resolvedFace = Typeface::resolveDefault(typeface);
@@ -69,9 +209,47 @@ minikin::Layout MinikinUtils::doLayout(const Paint* paint, minikin::Bidi bidiFla
     }
 }
 
+std::shared_ptr<const minikin::Layout> MinikinUtils::doLayoutCached(
+        const Paint* paint, minikin::Bidi bidiFlags, const Typeface* typeface,
+        const uint16_t* buf, size_t bufSize, size_t start, size_t count, size_t contextStart,
+        size_t contextCount) {
+    minikin::MinikinPaint minikinPaint = prepareMinikinPaint(paint, typeface);
+    const minikin::StartHyphenEdit startHyphen = paint->getStartHyphenEdit();
+    const minikin::EndHyphenEdit endHyphen = paint->getEndHyphenEdit();
+
+    if (contextCount > LAYOUT_CACHE_MAX_LENGTH) {
+        const minikin::U16StringPiece textBuf(buf, bufSize);
+        const minikin::Range range(start, start + count);
+        const minikin::Range contextRange(contextStart, contextStart + contextCount);
+        return std::make_shared<const minikin::Layout>(textBuf.substr(contextRange),
+                                                       range - contextStart, bidiFlags,
+                                                       minikinPaint, startHyphen, endHyphen);
+    }
+
+    const LayoutKey key(buf + contextStart, contextCount, start - contextStart, count, bidiFlags,
+                        minikinPaint, startHyphen, endHyphen);
+    return LayoutCache::get().getOrCreate(key);
+}
+
+void MinikinUtils::purgeLayoutCache() {
+    LayoutCache::get().clear();
+}
+
 float MinikinUtils::measureText(const Paint* paint, minikin::Bidi bidiFlags,
                                 const Typeface* typeface, const uint16_t* buf, size_t start,
                                 size_t count, size_t bufSize, float* advances) {
+    if (bufSize <= LAYOUT_CACHE_MAX_LENGTH) {
+        // The whole buffer is the context, as it is for Layout::measureText().
+        std::shared_ptr<const minikin::Layout> layout = doLayoutCached(
+                paint, bidiFlags, typeface, buf, bufSize, start, count, 0, bufSize);
+        if (advances) {
+            for (size_t i = 0; i < count; i++) {
+                advances[i] = layout->getCharAdvance(i);
+            }
+        }
+        return layout->getAdvance();
+    }
+
     minikin::MinikinPaint minikinPaint = prepareMinikinPaint(paint, typeface);
     const minikin::U16StringPiece textBuf(buf, bufSize);
     const minikin::Range range(start, start + count);
@@ -31,6 +31,8 @@
 #include "Paint.h"
 #include "Typeface.h"
 
+#include <memory>
+
 namespace minikin {
 class MeasuredText;
 }  // namespace minikin
@@ -48,6 +50,16 @@ public:
                                                 size_t contextStart, size_t contextCount,
                                                 minikin::MeasuredText* mt);
 
+    // Same as doLayout() without a MeasuredText, except that the result is kept in a small
+    // process-wide cache. measureText() shapes through the same cache, so a string measured
+    // and then drawn with the same paint is only shaped once.
+    ANDROID_API static std::shared_ptr<const minikin::Layout> doLayoutCached(
+            const Paint* paint, minikin::Bidi bidiFlags, const Typeface* typeface,
+            const uint16_t* buf, size_t bufSize, size_t start, size_t count, size_t contextStart,
+            size_t contextCount);
+
+    ANDROID_API static void purgeLayoutCache();
+
     ANDROID_API static float measureText(const Paint* paint, minikin::Bidi bidiFlags,
                                          const Typeface* typeface, const uint16_t* buf,
                                          size_t start, size_t count, size_t bufSize,
@@ -8,6 +8,7 @@
 #include "NinePatchPeeker.h"
 #include "SkAndroidCodec.h"
 #include "SkBRDAllocator.h"
+#include "SkData.h"
 #include "SkFrontBufferedStream.h"
 #include "SkMath.h"
 #include "SkPixelRef.h"
@@ -24,6 +25,10 @@
 #include <memory>
 #include <stdio.h>
 #include <sys/stat.h>
+#ifdef __ANDROID__ // Layoutlib for Windows does not support mmap
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 jfieldID gOptions_justBoundsFieldID;
 jfieldID gOptions_sampleSizeFieldID;
@@ -519,6 +524,36 @@ static jobject nativeDecodeStream(JNIEnv* env, jobject clazz, jobject is, jbyteA
     return bitmap;
 }
 
+#ifdef __ANDROID__ // Layoutlib for Windows does not support mmap
+static void unmapFile(const void* addr, void* context) {
+    munmap(const_cast<void*>(addr), reinterpret_cast<size_t>(context));
+}
+
+// Maps a regular file from the descriptor's current offset to its end, so that the codec reads the
+// encoded data straight from the page cache instead of copying it through a FILE buffer. As with
+// the buffered stream below, the stream cannot rewind past that offset.
+static std::unique_ptr<SkStreamRewindable> mapFileDescriptor(int descriptor,
+                                                              const struct stat& fdStat) {
+    const off64_t offset = ::lseek64(descriptor, 0, SEEK_CUR);
+    if (!S_ISREG(fdStat.st_mode) || offset < 0 || offset >= fdStat.st_size) {
+        return nullptr;
+    }
+
+    const off64_t mapOffset = offset & ~static_cast<off64_t>(getpagesize() - 1);
+    const size_t mapLength = fdStat.st_size - mapOffset;
+    void* addr = mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, descriptor, mapOffset);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    madvise(addr, mapLength, MADV_SEQUENTIAL);
+
+    sk_sp<SkData> mapping = SkData::MakeWithProc(addr, mapLength, unmapFile,
+                                                 reinterpret_cast<void*>(mapLength));
+    return std::make_unique<SkMemoryStream>(
+            SkData::MakeSubset(mapping.get(), offset - mapOffset, fdStat.st_size - offset));
+}
+#endif
+
 static jobject nativeDecodeFileDescriptor(JNIEnv* env, jobject clazz, jobject fileDescriptor,
         jobject padding, jobject bitmapFactoryOptions, jlong inBitmapHandle, jlong colorSpaceHandle) {
 #ifndef __ANDROID__ // LayoutLib for Windows does not support F_DUPFD_CLOEXEC
@@ -539,6 +574,11 @@ static jobject nativeDecodeFileDescriptor(JNIEnv* env, jobject clazz, jobject fi
     // file description and changes to the file offset in one impact the other.
     AutoFDSeek autoRestore(descriptor);
 
+    if (std::unique_ptr<SkStreamRewindable> mappedStream = mapFileDescriptor(descriptor, fdStat)) {
+        return doDecode(env, std::move(mappedStream), padding, bitmapFactoryOptions,
+                        inBitmapHandle, colorSpaceHandle);
+    }
+
     // Duplicate the descriptor here to prevent leaking memory. A leak occurs
     // if we only close the file descriptor and not the file object it is used to
     // create.  If we don't explicitly clean up the file (which in turn closes the
@@ -578,7 +618,12 @@ static jobject nativeDecodeAsset(JNIEnv* env, jobject clazz, jlong native_asset,
 
     Asset* asset = reinterpret_cast<Asset*>(native_asset);
     // since we know we'll be done with the asset when we return, we can
-    // just use a simple wrapper
+    // just use a simple wrapper. Prefer reading the asset's buffer in place, which
+    // for uncompressed assets is the mapped APK.
+    if (std::unique_ptr<SkMemoryStream> mappedStream = MapAssetToStream(asset)) {
+        return doDecode(env, std::move(mappedStream), padding, options, inBitmapHandle,
+                        colorSpaceHandle);
+    }
     return doDecode(env, std::make_unique<AssetStreamAdaptor>(asset), padding, options,
                     inBitmapHandle, colorSpaceHandle);
 }
@@ -33,13 +33,102 @@
 #include <sys/stat.h>
 
 #include <memory>
+#include <mutex>
+#include <vector>
+
+// Idle decoders kept per BitmapRegionDecoder. More may exist while that many
+// regions are being decoded at once, but are deleted when they finish.
+#define MAX_IDLE_REGION_DECODERS 4
 
 using namespace android;
 
+/**
+ * Native peer of android.graphics.BitmapRegionDecoder. Each decodeRegion call
+ * checks out its own SkBitmapRegionDecoder, so concurrent calls decode on
+ * independent codecs instead of contending for one. Every codec reads from a
+ * duplicate of the same memory stream, which shares the encoded data rather
+ * than copying it.
+ */
+class BitmapRegionDecoderWrapper {
+public:
+    static BitmapRegionDecoderWrapper* Make(std::unique_ptr<SkStreamRewindable> stream) {
+        std::unique_ptr<SkStreamRewindable> source = stream->duplicate();
+        if (!source) {
+            return nullptr;
+        }
+        std::unique_ptr<SkBitmapRegionDecoder> brd(SkBitmapRegionDecoder::Create(
+                stream.release(), SkBitmapRegionDecoder::kAndroidCodec_Strategy));
+        if (!brd) {
+            return nullptr;
+        }
+        return new BitmapRegionDecoderWrapper(std::move(source), std::move(brd));
+    }
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+
+    // Returns an idle decoder, or creates a new one if all are in use.
+    std::unique_ptr<SkBitmapRegionDecoder> acquire() {
+        std::unique_ptr<SkStreamRewindable> stream;
+        {
+            std::lock_guard lock(mLock);
+            if (!mIdleDecoders.empty()) {
+                std::unique_ptr<SkBitmapRegionDecoder> brd = std::move(mIdleDecoders.back());
+                mIdleDecoders.pop_back();
+                return brd;
+            }
+            stream = mSource->duplicate();
+        }
+        if (!stream) {
+            return nullptr;
+        }
+        return std::unique_ptr<SkBitmapRegionDecoder>(SkBitmapRegionDecoder::Create(
+                stream.release(), SkBitmapRegionDecoder::kAndroidCodec_Strategy));
+    }
+
+    void release(std::unique_ptr<SkBitmapRegionDecoder> brd) {
+        std::lock_guard lock(mLock);
+        if (mIdleDecoders.size() < MAX_IDLE_REGION_DECODERS) {
+            mIdleDecoders.push_back(std::move(brd));
+        }
+    }
+
+private:
+    BitmapRegionDecoderWrapper(std::unique_ptr<SkStreamRewindable> source,
+                               std::unique_ptr<SkBitmapRegionDecoder> brd)
+            : mSource(std::move(source)), mWidth(brd->width()), mHeight(brd->height()) {
+        mIdleDecoders.push_back(std::move(brd));
+    }
+
+    std::mutex mLock;
+    // Never read from; only duplicated to create more decoders.
+    std::unique_ptr<SkStreamRewindable> mSource;
+    std::vector<std::unique_ptr<SkBitmapRegionDecoder>> mIdleDecoders;
+    const int mWidth;
+    const int mHeight;
+};
+
+// Checks a decoder out of a BitmapRegionDecoderWrapper for the current scope.
+class AutoRegionDecoder {
+public:
+    explicit AutoRegionDecoder(BitmapRegionDecoderWrapper* wrapper)
+            : mWrapper(wrapper), mDecoder(wrapper->acquire()) {}
+    ~AutoRegionDecoder() {
+        if (mDecoder) {
+            mWrapper->release(std::move(mDecoder));
+        }
+    }
+
+    SkBitmapRegionDecoder* get() const { return mDecoder.get(); }
+
+private:
+    BitmapRegionDecoderWrapper* mWrapper;
+    std::unique_ptr<SkBitmapRegionDecoder> mDecoder;
+};
+
 static jobject createBitmapRegionDecoder(JNIEnv* env, std::unique_ptr<SkStreamRewindable> stream) {
-  std::unique_ptr<SkBitmapRegionDecoder> brd(
-            SkBitmapRegionDecoder::Create(stream.release(),
-                                          SkBitmapRegionDecoder::kAndroidCodec_Strategy));
+    std::unique_ptr<BitmapRegionDecoderWrapper> brd(
+            BitmapRegionDecoderWrapper::Make(std::move(stream)));
     if (!brd) {
         doThrowIOE(env, "Image format not supported");
         return nullObjectReturn("CreateBitmapRegionDecoder returned null");
@@ -158,7 +247,11 @@ static jobject nativeDecodeRegion(JNIEnv* env, jobject, jlong brdHandle, jint in
         recycledBytes = recycledBitmap->getAllocationByteCount();
     }
 
-    SkBitmapRegionDecoder* brd = reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
+    AutoRegionDecoder autoDecoder(reinterpret_cast<BitmapRegionDecoderWrapper*>(brdHandle));
+    SkBitmapRegionDecoder* brd = autoDecoder.get();
+    if (!brd) {
+        return nullObjectReturn("Failed to create a region decoder.");
+    }
     SkColorType decodeColorType = brd->computeOutputColorType(colorType);
     if (decodeColorType == kRGBA_F16_SkColorType && isHardware &&
             !uirenderer::HardwareBitmapUploader::hasFP16Support()) {
@@ -230,20 +323,20 @@ static jobject nativeDecodeRegion(JNIEnv* env, jobject, jlong brdHandle, jint in
 }
 
 static jint nativeGetHeight(JNIEnv* env, jobject, jlong brdHandle) {
-    SkBitmapRegionDecoder* brd =
-            reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
+    BitmapRegionDecoderWrapper* brd =
+            reinterpret_cast<BitmapRegionDecoderWrapper*>(brdHandle);
     return static_cast<jint>(brd->height());
 }
 
 static jint nativeGetWidth(JNIEnv* env, jobject, jlong brdHandle) {
-    SkBitmapRegionDecoder* brd =
-            reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
+    BitmapRegionDecoderWrapper* brd =
+            reinterpret_cast<BitmapRegionDecoderWrapper*>(brdHandle);
     return static_cast<jint>(brd->width());
 }
 
 static void nativeClean(JNIEnv* env, jobject, jlong brdHandle) {
-    SkBitmapRegionDecoder* brd =
-            reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
+    BitmapRegionDecoderWrapper* brd =
+            reinterpret_cast<BitmapRegionDecoderWrapper*>(brdHandle);
     delete brd;
 }
 
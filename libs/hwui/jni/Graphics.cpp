@@ -167,6 +167,55 @@ AutoJavaByteArray::~AutoJavaByteArray() {
     }
 }
 
+AutoJavaTextRange::AutoJavaTextRange(JNIEnv* env, jstring text, int start, int count)
+: fPtr(NULL), fLen(0) {
+    ALOG_ASSERT(env);
+    if (!text) {
+        doThrowNPE(env);
+        return;
+    }
+    jchar* ptr = allocate(count);
+    if (!ptr) {
+        doThrowAIOOBE(env);
+        return;
+    }
+    env->GetStringRegion(text, start, count, ptr);
+    if (!env->ExceptionCheck()) {
+        fPtr = ptr;
+        fLen = count;
+    }
+}
+
+AutoJavaTextRange::AutoJavaTextRange(JNIEnv* env, jcharArray text, int start, int count)
+: fPtr(NULL), fLen(0) {
+    ALOG_ASSERT(env);
+    if (!text) {
+        doThrowNPE(env);
+        return;
+    }
+    jchar* ptr = allocate(count);
+    if (!ptr) {
+        doThrowAIOOBE(env);
+        return;
+    }
+    env->GetCharArrayRegion(text, start, count, ptr);
+    if (!env->ExceptionCheck()) {
+        fPtr = ptr;
+        fLen = count;
+    }
+}
+
+jchar* AutoJavaTextRange::allocate(int count) {
+    if (count < 0) {
+        return NULL;
+    }
+    if (count <= kStackCount) {
+        return fStorage;
+    }
+    fHeapStorage.reset(new jchar[count]);
+    return fHeapStorage.get();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 static jclass   gRect_class;
@@ -470,7 +519,7 @@ SkRegion* GraphicsJNI::getNativeRegion(JNIEnv* env, jobject region)
 
 ///////////////////////////////////////////////////////////////////////////////////////////
 
-jobject GraphicsJNI::createBitmapRegionDecoder(JNIEnv* env, SkBitmapRegionDecoder* bitmap)
+jobject GraphicsJNI::createBitmapRegionDecoder(JNIEnv* env, BitmapRegionDecoderWrapper* bitmap)
 {
     ALOG_ASSERT(bitmap != NULL);
 
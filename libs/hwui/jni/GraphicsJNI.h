@@ -17,7 +17,9 @@
 
 #include "graphics_jni_helpers.h"
 
-class SkBitmapRegionDecoder;
+#include <memory>
+
+class BitmapRegionDecoderWrapper;
 class SkCanvas;
 
 namespace android {
@@ -103,7 +105,7 @@ public:
 
     static jobject createRegion(JNIEnv* env, SkRegion* region);
 
-    static jobject createBitmapRegionDecoder(JNIEnv* env, SkBitmapRegionDecoder* bitmap);
+    static jobject createBitmapRegionDecoder(JNIEnv* env, BitmapRegionDecoderWrapper* bitmap);
 
     /**
      * Given a bitmap we natively allocate a memory block to store the contents
@@ -318,6 +320,29 @@ private:
     int         fLen;
 };
 
+/**
+ * Copies the count characters at start in a Java string or char array, and none of the rest of
+ * the text, which GetStringChars or GetCharArrayElements may have to copy whole. Short ranges
+ * are copied to the stack. ptr() is NULL, with an exception pending, if the range is invalid.
+ */
+class AutoJavaTextRange {
+public:
+    AutoJavaTextRange(JNIEnv* env, jstring text, int start, int count);
+    AutoJavaTextRange(JNIEnv* env, jcharArray text, int start, int count);
+
+    const jchar* ptr() const { return fPtr; }
+    int    length() const { return fLen; }
+
+private:
+    jchar* allocate(int count);
+
+    static constexpr int kStackCount = 256;
+    jchar   fStorage[kStackCount];
+    std::unique_ptr<jchar[]> fHeapStorage;
+    jchar*  fPtr;
+    int     fLen;
+};
+
 void doThrowNPE(JNIEnv* env);
 void doThrowAIOOBE(JNIEnv* env); // Array Index Out Of Bounds Exception
 void doThrowIAE(JNIEnv* env, const char* msg = NULL);   // Illegal Argument
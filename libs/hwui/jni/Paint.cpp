@@ -223,11 +223,13 @@ namespace PaintGlue {
             jint bidiFlags, jfloatArray advances, jint advancesIndex) {
         Paint* paint = reinterpret_cast<Paint*>(paintHandle);
         const Typeface* typeface = paint->getAndroidTypeface();
-        jchar* textArray = env->GetCharArrayElements(text, nullptr);
-        jfloat result = doTextAdvances(env, paint, typeface, textArray + contextIndex,
-                index - contextIndex, count, contextCount, bidiFlags, advances, advancesIndex);
-        env->ReleaseCharArrayElements(text, textArray, JNI_ABORT);
-        return result;
+        // Only the context is measured, so the rest of the text is not read
+        AutoJavaTextRange textArray(env, text, contextIndex, contextCount);
+        if (!textArray.ptr()) {
+            return 0;
+        }
+        return doTextAdvances(env, paint, typeface, textArray.ptr(), index - contextIndex, count,
+                contextCount, bidiFlags, advances, advancesIndex);
     }
 
     static jfloat getTextAdvances__StringIIIII_FI(JNIEnv* env, jobject clazz, jlong paintHandle,
@@ -235,12 +237,12 @@ namespace PaintGlue {
             jfloatArray advances, jint advancesIndex) {
         Paint* paint = reinterpret_cast<Paint*>(paintHandle);
         const Typeface* typeface = paint->getAndroidTypeface();
-        const jchar* textArray = env->GetStringChars(text, nullptr);
-        jfloat result = doTextAdvances(env, paint, typeface, textArray + contextStart,
-                start - contextStart, end - start, contextEnd - contextStart, bidiFlags,
-                advances, advancesIndex);
-        env->ReleaseStringChars(text, textArray);
-        return result;
+        AutoJavaTextRange textArray(env, text, contextStart, contextEnd - contextStart);
+        if (!textArray.ptr()) {
+            return 0;
+        }
+        return doTextAdvances(env, paint, typeface, textArray.ptr(), start - contextStart,
+                end - start, contextEnd - contextStart, bidiFlags, advances, advancesIndex);
     }
 
     static jint doTextRunCursor(JNIEnv *env, Paint* paint, const Typeface* typeface,
@@ -337,9 +339,11 @@ namespace PaintGlue {
         Paint* paint = reinterpret_cast<Paint*>(paintHandle);
         const Typeface* typeface = paint->getAndroidTypeface();
         SkPath* path = reinterpret_cast<SkPath*>(pathHandle);
-        const jchar* textArray = env->GetCharArrayElements(text, nullptr);
-        getTextPath(env, paint, typeface, textArray + index, count, bidiFlags, x, y, path);
-        env->ReleaseCharArrayElements(text, const_cast<jchar*>(textArray), JNI_ABORT);
+        AutoJavaTextRange textArray(env, text, index, count);
+        if (!textArray.ptr()) {
+            return;
+        }
+        getTextPath(env, paint, typeface, textArray.ptr(), count, bidiFlags, x, y, path);
     }
 
     static void getTextPath__String(JNIEnv* env, jobject clazz, jlong paintHandle, jint bidiFlags,
@@ -347,9 +351,11 @@ namespace PaintGlue {
         Paint* paint = reinterpret_cast<Paint*>(paintHandle);
         const Typeface* typeface = paint->getAndroidTypeface();
         SkPath* path = reinterpret_cast<SkPath*>(pathHandle);
-        const jchar* textArray = env->GetStringChars(text, nullptr);
-        getTextPath(env, paint, typeface, textArray + start, end - start, bidiFlags, x, y, path);
-        env->ReleaseStringChars(text, textArray);
+        AutoJavaTextRange textArray(env, text, start, end - start);
+        if (!textArray.ptr()) {
+            return;
+        }
+        getTextPath(env, paint, typeface, textArray.ptr(), end - start, bidiFlags, x, y, path);
     }
 
     static void doTextBounds(JNIEnv* env, const jchar* text, int count, jobject bounds,
@@ -377,19 +383,22 @@ namespace PaintGlue {
             jint end, jint bidiFlags, jobject bounds) {
         const Paint* paint = reinterpret_cast<Paint*>(paintHandle);
         const Typeface* typeface = paint->getAndroidTypeface();
-        const jchar* textArray = env->GetStringChars(text, nullptr);
-        doTextBounds(env, textArray + start, end - start, bounds, *paint, typeface, bidiFlags);
-        env->ReleaseStringChars(text, textArray);
+        AutoJavaTextRange textArray(env, text, start, end - start);
+        if (!textArray.ptr()) {
+            return;
+        }
+        doTextBounds(env, textArray.ptr(), end - start, bounds, *paint, typeface, bidiFlags);
     }
 
     static void getCharArrayBounds(JNIEnv* env, jobject, jlong paintHandle, jcharArray text,
             jint index, jint count, jint bidiFlags, jobject bounds) {
         const Paint* paint = reinterpret_cast<Paint*>(paintHandle);
         const Typeface* typeface = paint->getAndroidTypeface();
-        const jchar* textArray = env->GetCharArrayElements(text, nullptr);
-        doTextBounds(env, textArray + index, count, bounds, *paint, typeface, bidiFlags);
-        env->ReleaseCharArrayElements(text, const_cast<jchar*>(textArray),
-                                      JNI_ABORT);
+        AutoJavaTextRange textArray(env, text, index, count);
+        if (!textArray.ptr()) {
+            return;
+        }
+        doTextBounds(env, textArray.ptr(), count, bounds, *paint, typeface, bidiFlags);
     }
 
     // Returns true if the given string is exact one pair of regional indicators.
@@ -114,6 +114,21 @@ size_t AssetStreamAdaptor::read(void* buffer, size_t size) {
     return amount;
 }
 
+std::unique_ptr<SkMemoryStream> android::MapAssetToStream(Asset* asset) {
+    const off64_t offset = asset->seek(0, SEEK_CUR);
+    const off64_t length = asset->getLength();
+    if (offset < 0 || offset >= length) {
+        return nullptr;
+    }
+
+    const void* buffer = asset->getBuffer(false);
+    if (buffer == NULL) {
+        return nullptr;
+    }
+    return std::make_unique<SkMemoryStream>(static_cast<const uint8_t*>(buffer) + offset,
+                                            length - offset, false);
+}
+
 SkMemoryStream* android::CopyAssetToStream(Asset* asset) {
     if (NULL == asset) {
         return NULL;
@@ -22,6 +22,8 @@
 #include <jni.h>
 #include <androidfw/Asset.h>
 
+#include <memory>
+
 namespace android {
 
 class AssetStreamAdaptor : public SkStreamRewindable {
@@ -53,6 +55,14 @@ private:
 
 SkMemoryStream* CopyAssetToStream(Asset*);
 
+/**
+ *  Return a stream over the asset's remaining bytes that reads from the asset's
+ *  own buffer, or NULL if the asset cannot provide one. For assets stored
+ *  uncompressed this is the mapped APK and nothing is copied. The asset must
+ *  outlive the stream.
+ */
+std::unique_ptr<SkMemoryStream> MapAssetToStream(Asset*);
+
 /** Restore the file descriptor's offset in our destructor
  */
 class AutoFDSeek {
@@ -6,6 +6,50 @@
 
 #include "graphics_jni_helpers.h"
 
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// Splits count interleaved VU pairs into a row of U and a row of V samples.
+static void deinterleaveVU(const uint8_t* vu, uint8_t* uRow, uint8_t* vRow, int count) {
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t pairs = vld2q_u8(vu + 2 * i);
+        vst1q_u8(uRow + i, pairs.val[1]);
+        vst1q_u8(vRow + i, pairs.val[0]);
+    }
+#endif
+    for (; i < count; ++i) {
+        uRow[i] = vu[2 * i + 1];
+        vRow[i] = vu[2 * i];
+    }
+}
+
+// Splits count YUYV groups into a row of 2 * count Y samples and rows of count U
+// and V samples.
+static void deinterleaveYUYV(const uint8_t* yuyv, uint8_t* yRow, uint8_t* uRow, uint8_t* vRow,
+        int count) {
+    int i = 0;
+#ifdef __ARM_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t groups = vld4q_u8(yuyv + 4 * i);
+        uint8x16x2_t luma;
+        luma.val[0] = groups.val[0];
+        luma.val[1] = groups.val[2];
+        vst2q_u8(yRow + 2 * i, luma);
+        vst1q_u8(uRow + i, groups.val[1]);
+        vst1q_u8(vRow + i, groups.val[3]);
+    }
+#endif
+    for (; i < count; ++i) {
+        yRow[2 * i] = yuyv[4 * i];
+        yRow[2 * i + 1] = yuyv[4 * i + 2];
+        uRow[i] = yuyv[4 * i + 1];
+        vRow[i] = yuyv[4 * i + 3];
+    }
+}
+
 YuvToJpegEncoder* YuvToJpegEncoder::create(int format, int* strides) {
     // Only ImageFormat.NV21 and ImageFormat.YUY2 are supported
     // for now.
@@ -133,13 +177,8 @@ void Yuv420SpToJpegEncoder::deinterleave(uint8_t* vuPlanar, uint8_t* uRows,
     if (numRows > 8) numRows = 8;
     for (int row = 0; row < numRows; ++row) {
         int offset = ((rowIndex >> 1) + row) * fStrides[1];
-        uint8_t* vu = vuPlanar + offset;
-        for (int i = 0; i < (width >> 1); ++i) {
-            int index = row * (width >> 1) + i;
-            uRows[index] = vu[1];
-            vRows[index] = vu[0];
-            vu += 2;
-        }
+        int index = row * (width >> 1);
+        deinterleaveVU(vuPlanar + offset, uRows + index, vRows + index, width >> 1);
     }
 }
 
@@ -208,15 +247,9 @@ void Yuv422IToJpegEncoder::deinterleave(uint8_t* yuv, uint8_t* yRows, uint8_t* u
     if (numRows > 16) numRows = 16;
     for (int row = 0; row < numRows; ++row) {
         uint8_t* yuvSeg = yuv + (rowIndex + row) * fStrides[0];
-        for (int i = 0; i < (width >> 1); ++i) {
-            int indexY = row * width + (i << 1);
-            int indexU = row * (width >> 1) + i;
-            yRows[indexY] = yuvSeg[0];
-            yRows[indexY + 1] = yuvSeg[2];
-            uRows[indexU] = yuvSeg[1];
-            vRows[indexU] = yuvSeg[3];
-            yuvSeg += 4;
-        }
+        int indexU = row * (width >> 1);
+        deinterleaveYUYV(yuvSeg, yRows + row * width, uRows + indexU, vRows + indexU,
+                width >> 1);
     }
 }
 
@@ -545,10 +545,13 @@ static void drawTextChars(JNIEnv* env, jobject, jlong canvasHandle, jcharArray c
                           jlong paintHandle) {
     Paint* paint = reinterpret_cast<Paint*>(paintHandle);
     const Typeface* typeface = paint->getAndroidTypeface();
-    ScopedCharArrayRO text(env, charArray);
-    // drawTextString and drawTextChars doesn't use context info
+    // drawTextString and drawTextChars doesn't use context info, so only the drawn range is read
+    AutoJavaTextRange text(env, charArray, index, count);
+    if (!text.ptr()) {
+        return;
+    }
     get_canvas(canvasHandle)->drawText(
-            text.get() + index, count,  // text buffer
+            text.ptr(), count,  // text buffer
             0, count,  // draw range
             0, count,  // context range
             x, y,  // draw position
@@ -558,13 +561,16 @@ static void drawTextChars(JNIEnv* env, jobject, jlong canvasHandle, jcharArray c
 static void drawTextString(JNIEnv* env, jobject, jlong canvasHandle, jstring strObj,
                            jint start, jint end, jfloat x, jfloat y, jint bidiFlags,
                            jlong paintHandle) {
-    ScopedStringChars text(env, strObj);
     Paint* paint = reinterpret_cast<Paint*>(paintHandle);
     const Typeface* typeface = paint->getAndroidTypeface();
     const int count = end - start;
-    // drawTextString and drawTextChars doesn't use context info
+    // drawTextString and drawTextChars doesn't use context info, so only the drawn range is read
+    AutoJavaTextRange text(env, strObj, start, count);
+    if (!text.ptr()) {
+        return;
+    }
     get_canvas(canvasHandle)->drawText(
-            text.get() + start, count,  // text buffer
+            text.ptr(), count,  // text buffer
             0, count,  // draw range
             0, count,  // context range
             x, y,  // draw position
@@ -612,12 +618,13 @@ static void drawTextOnPathChars(JNIEnv* env, jobject, jlong canvasHandle, jcharA
     Paint* paint = reinterpret_cast<Paint*>(paintHandle);
     const Typeface* typeface = paint->getAndroidTypeface();
 
-    jchar* jchars = env->GetCharArrayElements(text, NULL);
+    AutoJavaTextRange jchars(env, text, index, count);
+    if (!jchars.ptr()) {
+        return;
+    }
 
-    get_canvas(canvasHandle)->drawTextOnPath(jchars + index, count,
+    get_canvas(canvasHandle)->drawTextOnPath(jchars.ptr(), count,
             static_cast<minikin::Bidi>(bidiFlags), *path, hOffset, vOffset, *paint, typeface);
-
-    env->ReleaseCharArrayElements(text, jchars, 0);
 }
 
 static void drawTextOnPathString(JNIEnv* env, jobject, jlong canvasHandle, jstring text,
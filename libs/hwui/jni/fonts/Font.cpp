@@ -31,7 +31,12 @@
 #include <minikin/FontFamily.h>
 #include <ui/FatVector.h>
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+
+#include <sys/stat.h>
 
 namespace android {
 
@@ -62,6 +67,92 @@ static void release_global_ref(const void* /*data*/, void* context) {
     env->DeleteGlobalRef(obj);
 }
 
+// Apps often build the same font file into several families, and each build would otherwise
+// parse the font again and keep its own typeface. Typefaces of font files are shared while any
+// of them is alive, keyed by the identity of the file and the arguments of the typeface.
+struct SharedTypeface {
+    SkTypeface* typeface;  // weak reference
+    const void* fontPtr;
+};
+
+static std::mutex gSharedTypefacesLock;
+static std::map<std::string, SharedTypeface> gSharedTypefaces;
+
+// Returns the key of the typeface of a font file, or an empty string if the font doesn't come
+// from a file that can be identified.
+static std::string sharedTypefaceKey(const char* fontPath, jlong fontSize, jint ttcIndex,
+                                     const std::vector<minikin::FontVariation>& axes) {
+    struct stat st;
+    if (fontPath[0] == '\0' || stat(fontPath, &st) != 0 || st.st_size != fontSize) {
+        return std::string();
+    }
+    std::string key = fontPath;
+    key += '\0';
+    key += std::to_string(st.st_dev) + ':' + std::to_string(st.st_ino) + ':' +
+            std::to_string(st.st_mtime) + ':' + std::to_string(fontSize) + ':' +
+            std::to_string(ttcIndex);
+    for (const auto& axis : axes) {
+        key += ':' + std::to_string(axis.axisTag) + '=' + std::to_string(axis.value);
+    }
+    return key;
+}
+
+static sk_sp<SkTypeface> findSharedTypeface(const std::string& key, const void** outFontPtr) {
+    std::lock_guard<std::mutex> lock(gSharedTypefacesLock);
+    auto it = gSharedTypefaces.find(key);
+    if (it == gSharedTypefaces.end()) {
+        return nullptr;
+    }
+    if (!it->second.typeface->try_ref()) {
+        it->second.typeface->weak_unref();
+        gSharedTypefaces.erase(it);
+        return nullptr;
+    }
+    *outFontPtr = it->second.fontPtr;
+    return sk_sp<SkTypeface>(it->second.typeface);
+}
+
+static void addSharedTypeface(const std::string& key, const sk_sp<SkTypeface>& typeface,
+                              const void* fontPtr) {
+    std::lock_guard<std::mutex> lock(gSharedTypefacesLock);
+    // Drop the typefaces that are gone, so the cache doesn't grow with every font ever built.
+    for (auto it = gSharedTypefaces.begin(); it != gSharedTypefaces.end();) {
+        if (it->second.typeface->weak_expired()) {
+            it->second.typeface->weak_unref();
+            it = gSharedTypefaces.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (gSharedTypefaces.count(key) != 0) {
+        return;  // Built by another thread in the meantime.
+    }
+    typeface->weak_ref();
+    gSharedTypefaces[key] = { typeface.get(), fontPtr };
+}
+
+static sk_sp<SkTypeface> makeTypeface(JNIEnv* env, jobject buffer, const void* fontPtr,
+                                      jlong fontSize, jint ttcIndex,
+                                      const std::vector<minikin::FontVariation>& axes) {
+    jobject fontRef = MakeGlobalRefOrDie(env, buffer);
+    sk_sp<SkData> data(SkData::MakeWithProc(fontPtr, fontSize,
+            release_global_ref, reinterpret_cast<void*>(fontRef)));
+
+    FatVector<SkFontArguments::Axis, 2> skiaAxes;
+    for (const auto& axis : axes) {
+        skiaAxes.emplace_back(SkFontArguments::Axis{axis.axisTag, axis.value});
+    }
+
+    std::unique_ptr<SkStreamAsset> fontData(new SkMemoryStream(std::move(data)));
+
+    SkFontArguments params;
+    params.setCollectionIndex(ttcIndex);
+    params.setAxes(skiaAxes.data(), skiaAxes.size());
+
+    sk_sp<SkFontMgr> fm(SkFontMgr::RefDefault());
+    return fm->makeFromStream(std::move(fontData), params);
+}
+
 // Regular JNI
 static jlong Font_Builder_initBuilder(JNIEnv*, jobject) {
     return reinterpret_cast<jlong>(new NativeFontBuilder());
@@ -89,27 +180,22 @@ static jlong Font_Builder_build(JNIEnv* env, jobject clazz, jlong builderPtr, jo
         return 0;
     }
     ScopedUtfChars fontPath(env, filePath);
-    jobject fontRef = MakeGlobalRefOrDie(env, buffer);
-    sk_sp<SkData> data(SkData::MakeWithProc(fontPtr, fontSize,
-            release_global_ref, reinterpret_cast<void*>(fontRef)));
-
-    FatVector<SkFontArguments::Axis, 2> skiaAxes;
-    for (const auto& axis : builder->axes) {
-        skiaAxes.emplace_back(SkFontArguments::Axis{axis.axisTag, axis.value});
+    const std::string key = sharedTypefaceKey(fontPath.c_str(), fontSize, ttcIndex, builder->axes);
+    sk_sp<SkTypeface> face;
+    if (!key.empty()) {
+        // The shared typeface reads its own buffer of the file, which it keeps alive.
+        face = findSharedTypeface(key, &fontPtr);
     }
-
-    std::unique_ptr<SkStreamAsset> fontData(new SkMemoryStream(std::move(data)));
-
-    SkFontArguments params;
-    params.setCollectionIndex(ttcIndex);
-    params.setAxes(skiaAxes.data(), skiaAxes.size());
-
-    sk_sp<SkFontMgr> fm(SkFontMgr::RefDefault());
-    sk_sp<SkTypeface> face(fm->makeFromStream(std::move(fontData), params));
     if (face == nullptr) {
-        jniThrowException(env, "java/lang/IllegalArgumentException",
-                          "Failed to create internal object. maybe invalid font data.");
-        return 0;
+        face = makeTypeface(env, buffer, fontPtr, fontSize, ttcIndex, builder->axes);
+        if (face == nullptr) {
+            jniThrowException(env, "java/lang/IllegalArgumentException",
+                              "Failed to create internal object. maybe invalid font data.");
+            return 0;
+        }
+        if (!key.empty()) {
+            addSharedTypeface(key, face, fontPtr);
+        }
     }
     std::shared_ptr<minikin::MinikinFont> minikinFont =
             std::make_shared<MinikinFontSkia>(std::move(face), fontPtr, fontSize,
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MappedBlobCache.h"
+
+#include <android-base/properties.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <log/log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+
+#include "utils/TraceUtils.h"
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+// The layout written by FileBlobCache: the magic, a CRC32C of the rest of the file, and the
+// flattened BlobCache.
+static const char fileMagic[] = {'E', 'G', 'L', '$'};
+static const size_t fileHeaderSize = 8;
+
+// The layout written by BlobCache::flatten, every part aligned to 4 bytes.
+static const uint32_t blobCacheMagic = ('_' << 24) + ('B' << 16) + ('b' << 8) + '$';
+static const uint32_t blobCacheVersion = 3;
+static const uint32_t blobCacheDeviceVersion = 1;
+
+struct BlobCacheHeader {
+    uint32_t magicNumber;
+    uint32_t blobCacheVersion;
+    uint32_t deviceVersion;
+    uint32_t numEntries;
+    uint32_t buildIdLength;
+};
+
+struct BlobCacheEntryHeader {
+    uint32_t keySize;
+    uint32_t valueSize;
+};
+
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
+static uint32_t crc32c(const uint8_t* buf, size_t len) {
+    const uint32_t polyBits = 0x82F63B78;
+    uint32_t r = 0;
+    for (size_t i = 0; i < len; i++) {
+        r ^= buf[i];
+        for (int j = 0; j < 8; j++) {
+            r = (r & 1) ? (r >> 1) ^ polyBits : r >> 1;
+        }
+    }
+    return r;
+}
+
+std::unique_ptr<MappedBlobCache> MappedBlobCache::open(const std::string& filename,
+                                                       size_t maxKeySize, size_t maxValueSize) {
+    ATRACE_NAME("MappedBlobCache::open");
+    base::unique_fd fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            ALOGE("MappedBlobCache: unable to open %s: %s (%d)", filename.c_str(), strerror(errno),
+                  errno);
+        }
+        return nullptr;
+    }
+    struct stat statBuf;
+    if (fstat(fd, &statBuf) == -1 || statBuf.st_size <= 0) {
+        return nullptr;
+    }
+    const size_t size = statBuf.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("MappedBlobCache: unable to map %s: %s (%d)", filename.c_str(), strerror(errno),
+              errno);
+        return nullptr;
+    }
+    std::unique_ptr<MappedBlobCache> cache(
+            new MappedBlobCache(static_cast<const uint8_t*>(data), size));
+    if (!cache->index(maxKeySize, maxValueSize)) {
+        ALOGE("MappedBlobCache: %s is not a valid cache file", filename.c_str());
+        return nullptr;
+    }
+    return cache;
+}
+
+MappedBlobCache::~MappedBlobCache() {
+    munmap(const_cast<uint8_t*>(mData), mSize);
+}
+
+bool MappedBlobCache::index(size_t maxKeySize, size_t maxValueSize) {
+    if (mSize < fileHeaderSize || memcmp(mData, fileMagic, sizeof(fileMagic)) != 0) {
+        return false;
+    }
+    uint32_t crc;
+    memcpy(&crc, mData + sizeof(fileMagic), sizeof(crc));
+    if (crc32c(mData + fileHeaderSize, mSize - fileHeaderSize) != crc) {
+        return false;
+    }
+
+    const uint8_t* cache = mData + fileHeaderSize;
+    const size_t cacheSize = mSize - fileHeaderSize;
+    BlobCacheHeader header;
+    if (cacheSize < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, cache, sizeof(header));
+    if (header.magicNumber != blobCacheMagic) {
+        return false;
+    }
+    const std::string buildId = base::GetProperty("ro.build.id", "");
+    if (header.blobCacheVersion != blobCacheVersion ||
+        header.deviceVersion != blobCacheDeviceVersion ||
+        header.buildIdLength != buildId.size() || header.buildIdLength > cacheSize ||
+        memcmp(cache + sizeof(header), buildId.data(), buildId.size()) != 0) {
+        // A cache written by another build is treated as empty, as BlobCache does.
+        return false;
+    }
+
+    size_t offset = align4(sizeof(header) + header.buildIdLength);
+    for (uint32_t i = 0; i < header.numEntries; i++) {
+        BlobCacheEntryHeader entryHeader;
+        if (offset > cacheSize || cacheSize - offset < sizeof(entryHeader)) {
+            return false;
+        }
+        memcpy(&entryHeader, cache + offset, sizeof(entryHeader));
+        const size_t dataOffset = offset + sizeof(entryHeader);
+        const size_t entrySize = align4(sizeof(entryHeader) + size_t(entryHeader.keySize) +
+                                        size_t(entryHeader.valueSize));
+        if (cacheSize - offset < entrySize) {
+            return false;
+        }
+        if (entryHeader.keySize <= maxKeySize && entryHeader.valueSize <= maxValueSize) {
+            const uint32_t keyOffset = fileHeaderSize + dataOffset;
+            mEntries.push_back({keyOffset, entryHeader.keySize, keyOffset + entryHeader.keySize,
+                                entryHeader.valueSize});
+        }
+        offset += entrySize;
+    }
+
+    auto keyLess = [this](const Entry& a, const Entry& b) {
+        int cmp = memcmp(mData + a.keyOffset, mData + b.keyOffset,
+                         std::min(a.keySize, b.keySize));
+        return cmp != 0 ? cmp < 0 : a.keySize < b.keySize;
+    };
+    std::stable_sort(mEntries.begin(), mEntries.end(), keyLess);
+    mEntries.shrink_to_fit();
+    return true;
+}
+
+const MappedBlobCache::Entry* MappedBlobCache::find(const void* key, size_t keySize) const {
+    auto keyLess = [this](const Entry& entry, std::pair<const void*, size_t> key) {
+        int cmp = memcmp(mData + entry.keyOffset, key.first, std::min<size_t>(entry.keySize,
+                                                                            key.second));
+        return cmp != 0 ? cmp < 0 : entry.keySize < key.second;
+    };
+    auto iter = std::lower_bound(mEntries.begin(), mEntries.end(), std::make_pair(key, keySize),
+                                 keyLess);
+    if (iter == mEntries.end() || iter->keySize != keySize ||
+        memcmp(mData + iter->keyOffset, key, keySize) != 0) {
+        return nullptr;
+    }
+    return &*iter;
+}
+
+size_t MappedBlobCache::getValueSize(const void* key, size_t keySize) const {
+    const Entry* entry = find(key, keySize);
+    return entry != nullptr ? entry->valueSize : 0;
+}
+
+sk_sp<SkData> MappedBlobCache::get(const void* key, size_t keySize) const {
+    const Entry* entry = find(key, keySize);
+    if (entry == nullptr || entry->valueSize == 0) {
+        return nullptr;
+    }
+    return SkData::MakeWithCopy(mData + entry->valueOffset, entry->valueSize);
+}
+
+size_t MappedBlobCache::getMemoryUsage() const {
+    return mEntries.capacity() * sizeof(Entry);
+}
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <SkData.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+/**
+ * Read-only view of a cache file written by FileBlobCache, mapped rather than read into the
+ * heap. The pages of the file are shared with every other process that maps it, and only an
+ * index of the entries is allocated.
+ *
+ * The file is validated the same way FileBlobCache validates it when loading: the file magic
+ * and checksum, and the BlobCache header, versions and build id. A file that fails validation
+ * yields no cache at all.
+ */
+class MappedBlobCache {
+public:
+    /**
+     * Maps and indexes "filename". Entries with keys or values larger than the given limits are
+     * left out, as BlobCache leaves them out. Returns null if the file can't be used.
+     */
+    static std::unique_ptr<MappedBlobCache> open(const std::string& filename, size_t maxKeySize,
+                                                 size_t maxValueSize);
+
+    ~MappedBlobCache();
+
+    /**
+     * Returns the size of the value of "key", or 0 if it is not in the cache.
+     */
+    size_t getValueSize(const void* key, size_t keySize) const;
+
+    /**
+     * Returns a copy of the value of "key", or null if it is not in the cache.
+     */
+    sk_sp<SkData> get(const void* key, size_t keySize) const;
+
+    /**
+     * Returns the number of bytes allocated for the index. The mapping is not counted.
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    struct Entry {
+        uint32_t keyOffset;
+        uint32_t keySize;
+        uint32_t valueOffset;
+        uint32_t valueSize;
+    };
+
+    MappedBlobCache(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    bool index(size_t maxKeySize, size_t maxValueSize);
+    const Entry* find(const void* key, size_t keySize) const;
+
+    const uint8_t* mData;
+    size_t mSize;
+    // Sorted by key.
+    std::vector<Entry> mEntries;
+};
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
@@ -16,12 +16,20 @@
 
 #include "ShaderCache.h"
 #include <GrContext.h>
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
 #include <log/log.h>
 #include <openssl/sha.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <thread>
 #include "FileBlobCache.h"
+#include "MappedBlobCache.h"
 #include "Properties.h"
 #include "utils/TraceUtils.h"
 
@@ -33,6 +41,23 @@ namespace skiapipeline {
 static const size_t maxKeySize = 1024;
 static const size_t maxValueSize = 512 * 1024;
 static const size_t maxTotalSize = 1024 * 1024;
+// The system cache is shared by all apps, so it is allowed to hold more.
+
+// The journal is compacted into the cache file once it grows past this size.
+static const size_t maxJournalSize = maxTotalSize;
+
+// Journal layout: the magic, followed by records of
+// {uint32_t keySize, uint32_t valueSize, key bytes, value bytes}.
+static const uint32_t journalMagic = 0x4a434853;  // 'SHCJ'
+static const size_t journalRecordHeaderSize = 2 * sizeof(uint32_t);
+
+static void appendJournalRecord(std::string* journal, const void* key, uint32_t keySize,
+                                const void* value, uint32_t valueSize) {
+    journal->append(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+    journal->append(reinterpret_cast<const char*>(&valueSize), sizeof(valueSize));
+    journal->append(reinterpret_cast<const char*>(key), keySize);
+    journal->append(reinterpret_cast<const char*>(value), valueSize);
+}
 
 ShaderCache::ShaderCache() {
     // There is an "incomplete FileBlobCache type" compilation error, if ctor is moved to header.
@@ -83,17 +108,83 @@ void ShaderCache::initShaderDiskCache(const void* identity, ssize_t size) {
     // or snapshot migration. Also, program binaries may not work well on some
     // desktop / laptop GPUs. Thus, disable the shader disk cache for emulator builds.
     if (!Properties::runningInEmulator && mFilename.length() > 0) {
-        mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
-        validateCache(identity, size);
+        if (mPreloadedBlobCache && mPreloadedFilename == mFilename) {
+            mBlobCache = std::move(mPreloadedBlobCache);
+        } else {
+            mBlobCache.reset(
+                    new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
+        }
+        mPreloadedBlobCache.reset();
+        replayJournalLocked();
+        if (!validateCache(identity, size)) {
+            // The journal entries have been dropped along with the rest of the cache. A cache
+            // built for another driver is also removed from disk, so that it is neither read nor
+            // validated again on the next start.
+            std::lock_guard<std::mutex> ioLock(mIOMutex);
+            if (identity != nullptr && size > 0) {
+                unlink(mFilename.c_str());
+            }
+            unlink(journalFilename(mFilename).c_str());
+            mJournalSize = 0;
+        }
+        mSystemBlobCache.reset();
+        // The system cache can only be trusted if it was built for this identity.
+        if (identity != nullptr && size > 0) {
+            initSystemCacheLocked();
+        }
         mInitialized = true;
     }
 }
 
+void ShaderCache::preloadDiskCache() {
+    ATRACE_NAME("ShaderCache::preloadDiskCache");
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mInitialized || Properties::runningInEmulator || mFilename.empty()) {
+        return;
+    }
+    // Nothing is written to the file before the cache is initialized, so the contents are still
+    // current when "initShaderDiskCache" adopts them.
+    mPreloadedBlobCache.reset(
+            new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
+    mPreloadedFilename = mFilename;
+}
+
+void ShaderCache::initSystemCacheLocked() {
+    if (!mSystemFilenameSet) {
+        mSystemFilename = base::GetProperty(PROPERTY_SYSTEM_SHADER_CACHE, "");
+        mSystemFilenameSet = true;
+    }
+    if (mSystemFilename.empty() || mIDHash.empty()) {
+        return;
+    }
+    ATRACE_NAME("ShaderCache::initSystemCacheLocked");
+    mSystemBlobCache = MappedBlobCache::open(mSystemFilename, maxKeySize, maxValueSize);
+    if (!mSystemBlobCache) {
+        return;
+    }
+
+    auto key = sIDKey;
+    sk_sp<SkData> hash = mSystemBlobCache->get(&key, sizeof(key));
+    if (!hash || hash->size() != mIDHash.size() ||
+        memcmp(hash->data(), mIDHash.data(), hash->size()) != 0) {
+        if (CC_UNLIKELY(Properties::debugLevel & kDebugCaches)) {
+            ALOGW("ShaderCache::initSystemCacheLocked system cache validation fails");
+        }
+        mSystemBlobCache.reset();
+    }
+}
+
 void ShaderCache::setFilename(const char* filename) {
     std::lock_guard<std::mutex> lock(mMutex);
     mFilename = filename;
 }
 
+void ShaderCache::setSystemFilename(const char* filename) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSystemFilename = filename;
+    mSystemFilenameSet = true;
+}
+
 BlobCache* ShaderCache::getBlobCacheLocked() {
     LOG_ALWAYS_FATAL_IF(!mInitialized, "ShaderCache has not been initialized");
     return mBlobCache.get();
@@ -101,19 +192,28 @@ BlobCache* ShaderCache::getBlobCacheLocked() {
 
 sk_sp<SkData> ShaderCache::load(const SkData& key) {
     ATRACE_NAME("ShaderCache::load");
-    size_t keySize = key.size();
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mInitialized) {
         return nullptr;
     }
 
+    // The per-app cache goes first, it may hold a newer value for entries that
+    // are rewritten over time, like the Vulkan pipeline cache.
+    sk_sp<SkData> data = loadFromBlobCacheLocked(getBlobCacheLocked(), key);
+    if (!data && mSystemBlobCache) {
+        data = mSystemBlobCache->get(key.data(), key.size());
+    }
+    return data;
+}
+
+sk_sp<SkData> ShaderCache::loadFromBlobCacheLocked(BlobCache* bc, const SkData& key) {
+    size_t keySize = key.size();
     // mObservedBlobValueSize is reasonably big to avoid memory reallocation
     // Allocate a buffer with malloc. SkData takes ownership of that allocation and will call free.
     void* valueBuffer = malloc(mObservedBlobValueSize);
     if (!valueBuffer) {
         return nullptr;
     }
-    BlobCache* bc = getBlobCacheLocked();
     size_t valueSize = bc->get(key.data(), keySize, valueBuffer, mObservedBlobValueSize);
     int maxTries = 3;
     while (valueSize > mObservedBlobValueSize && maxTries > 0) {
@@ -146,11 +246,183 @@ void ShaderCache::saveToDiskLocked() {
             auto key = sIDKey;
             mBlobCache->set(&key, sizeof(key), mIDHash.data(), mIDHash.size());
         }
+        std::lock_guard<std::mutex> ioLock(mIOMutex);
         mBlobCache->writeToFile();
+        unlink(journalFilename(mFilename).c_str());
+        mJournalSize = 0;
     }
+    mPendingEntries.clear();
     mSavePending = false;
 }
 
+std::string ShaderCache::journalFilename(const std::string& filename) {
+    return filename + ".journal";
+}
+
+void ShaderCache::replayJournalLocked() {
+    ATRACE_NAME("ShaderCache::replayJournalLocked");
+    std::lock_guard<std::mutex> ioLock(mIOMutex);
+    mJournalSize = 0;
+    const std::string journalName = journalFilename(mFilename);
+    std::string journal;
+    if (!base::ReadFileToString(journalName, &journal)) {
+        return;
+    }
+    uint32_t magic = 0;
+    if (journal.size() >= sizeof(magic)) {
+        memcpy(&magic, journal.data(), sizeof(magic));
+    }
+    if (magic != journalMagic) {
+        ALOGW("ShaderCache: discarding invalid journal %s", journalName.c_str());
+        unlink(journalName.c_str());
+        return;
+    }
+    size_t offset = sizeof(magic);
+    while (journal.size() - offset >= journalRecordHeaderSize) {
+        uint32_t keySize, valueSize;
+        memcpy(&keySize, journal.data() + offset, sizeof(keySize));
+        memcpy(&valueSize, journal.data() + offset + sizeof(keySize), sizeof(valueSize));
+        const size_t recordSize = journalRecordHeaderSize + keySize + valueSize;
+        if (keySize == 0 || keySize > maxKeySize || valueSize == 0 || valueSize > maxValueSize ||
+            journal.size() - offset < recordSize) {
+            break;
+        }
+        const char* key = journal.data() + offset + journalRecordHeaderSize;
+        mBlobCache->set(key, keySize, key + keySize, valueSize);
+        offset += recordSize;
+    }
+    if (offset != journal.size()) {
+        // A save was interrupted mid-record. Drop the torn tail so that later
+        // appends start on a record boundary.
+        ALOGW("ShaderCache: truncating journal %s from %zu to %zu bytes", journalName.c_str(),
+              journal.size(), offset);
+        if (truncate(journalName.c_str(), offset) != 0) {
+            unlink(journalName.c_str());
+            return;
+        }
+    }
+    mJournalSize = offset;
+}
+
+void ShaderCache::scheduleSaveLocked() {
+    mSavePending = true;
+    if (!mSaveThreadStarted) {
+        mSaveThreadStarted = true;
+        std::thread saveThread([this]() { saveThreadLoop(); });
+        saveThread.detach();
+    }
+    mSaveCondition.notify_one();
+}
+
+void ShaderCache::saveThreadLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mSaveCondition.wait(lock, [this]() { return mSavePending; });
+        }
+        // Batch up everything compiled during the delay into a single write.
+        sleep(mDeferredSaveDelay);
+
+        std::vector<std::pair<sk_sp<SkData>, sk_sp<SkData>>> entries;
+        std::vector<uint8_t> snapshot;
+        std::vector<uint8_t> idHash;
+        std::string filename;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mSavePending) {
+                // Saved synchronously in the meantime.
+                continue;
+            }
+            mSavePending = false;
+            // Store file on disk if there a new shader or Vulkan pipeline cache size changed.
+            if (!mInitialized || !mBlobCache ||
+                (!mCacheDirty && mNewPipelineCacheSize == mOldPipelineCacheSize)) {
+                mPendingEntries.clear();
+                continue;
+            }
+            mOldPipelineCacheSize = mNewPipelineCacheSize;
+            mTryToStorePipelineCache = false;
+            mCacheDirty = false;
+            filename = mFilename;
+            idHash = mIDHash;
+
+            size_t pendingSize = 0;
+            for (const auto& entry : mPendingEntries) {
+                pendingSize += journalRecordHeaderSize + entry.first->size() + entry.second->size();
+            }
+            bool compact;
+            {
+                std::lock_guard<std::mutex> ioLock(mIOMutex);
+                compact = mJournalSize + pendingSize > maxJournalSize;
+            }
+            if (compact) {
+                // Copy the cache out, the pending entries are part of it.
+                if (idHash.size()) {
+                    auto key = sIDKey;
+                    mBlobCache->set(&key, sizeof(key), idHash.data(), idHash.size());
+                }
+                snapshot.resize(mBlobCache->getFlattenedSize());
+                if (mBlobCache->flatten(snapshot.data(), snapshot.size()) != 0) {
+                    ALOGE("ShaderCache: failed to flatten the cache for compaction");
+                    snapshot.clear();
+                }
+                mPendingEntries.clear();
+            } else {
+                entries.swap(mPendingEntries);
+            }
+        }
+
+        std::lock_guard<std::mutex> ioLock(mIOMutex);
+        if (!snapshot.empty()) {
+            ATRACE_NAME("ShaderCache::compactJournal");
+            // Write the compacted cache next to the old one and swap it in, so
+            // that the cache file on disk is always complete.
+            const std::string tempFilename = filename + ".tmp";
+            unlink(tempFilename.c_str());
+            {
+                FileBlobCache compacted(maxKeySize, maxValueSize, maxTotalSize, tempFilename);
+                compacted.unflatten(snapshot.data(), snapshot.size());
+                compacted.writeToFile();
+            }
+            if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
+                ALOGE("ShaderCache: failed to rename %s: %s", tempFilename.c_str(),
+                      strerror(errno));
+                unlink(tempFilename.c_str());
+                continue;
+            }
+            unlink(journalFilename(filename).c_str());
+            mJournalSize = 0;
+        } else if (!entries.empty()) {
+            ATRACE_NAME("ShaderCache::appendJournal");
+            std::string journal;
+            if (mJournalSize == 0) {
+                journal.append(reinterpret_cast<const char*>(&journalMagic), sizeof(journalMagic));
+                if (idHash.size()) {
+                    auto key = sIDKey;
+                    appendJournalRecord(&journal, &key, sizeof(key), idHash.data(),
+                                        idHash.size());
+                }
+            }
+            for (const auto& entry : entries) {
+                appendJournalRecord(&journal, entry.first->data(), entry.first->size(),
+                                    entry.second->data(), entry.second->size());
+            }
+            const std::string journalName = journalFilename(filename);
+            base::unique_fd fd(open(journalName.c_str(),
+                                    O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR));
+            if (fd == -1 || !base::WriteFully(fd, journal.data(), journal.size())) {
+                ALOGE("ShaderCache: failed to append to %s: %s", journalName.c_str(),
+                      strerror(errno));
+                // Start over with a fresh journal next time rather than leaving a torn one.
+                unlink(journalName.c_str());
+                mJournalSize = 0;
+                continue;
+            }
+            mJournalSize += journal.size();
+        }
+    }
+}
+
 void ShaderCache::store(const SkData& key, const SkData& data) {
     ATRACE_NAME("ShaderCache::store");
     std::lock_guard<std::mutex> lock(mMutex);
@@ -189,21 +461,35 @@ void ShaderCache::store(const SkData& key, const SkData& data) {
     }
     bc->set(key.data(), keySize, value, valueSize);
 
-    if (!mSavePending && mDeferredSaveDelay > 0) {
-        mSavePending = true;
-        std::thread deferredSaveThread([this]() {
-            sleep(mDeferredSaveDelay);
-            std::lock_guard<std::mutex> lock(mMutex);
-            // Store file on disk if there a new shader or Vulkan pipeline cache size changed.
-            if (mCacheDirty || mNewPipelineCacheSize != mOldPipelineCacheSize) {
-                saveToDiskLocked();
-                mOldPipelineCacheSize = mNewPipelineCacheSize;
-                mTryToStorePipelineCache = false;
-                mCacheDirty = false;
-            }
-        });
-        deferredSaveThread.detach();
+    if (mDeferredSaveDelay > 0) {
+        // Skia owns the passed in data, so the save thread gets its own copy.
+        // Only the latest value of a key needs to reach the journal, which
+        // matters for the Vulkan pipeline cache that is stored repeatedly.
+        auto pending =
+                std::find_if(mPendingEntries.begin(), mPendingEntries.end(),
+                             [&key](const auto& entry) { return entry.first->equals(&key); });
+        if (pending != mPendingEntries.end()) {
+            pending->second = SkData::MakeWithCopy(value, valueSize);
+        } else {
+            mPendingEntries.emplace_back(SkData::MakeWithCopy(key.data(), keySize),
+                                         SkData::MakeWithCopy(value, valueSize));
+        }
+        if (!mSavePending) {
+            scheduleSaveLocked();
+        }
+    }
+}
+
+size_t ShaderCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    size_t size = 0;
+    if (mBlobCache) {
+        size += mBlobCache->getFlattenedSize();
+    }
+    if (mSystemBlobCache) {
+        size += mSystemBlobCache->getMemoryUsage();
     }
+    return size;
 }
 
 void ShaderCache::onVkFrameFlushed(GrContext* context) {
@@ -17,10 +17,13 @@
 #pragma once
 
 #include <GrContextOptions.h>
+#include <SkData.h>
 #include <cutils/compiler.h>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -31,6 +34,8 @@ class FileBlobCache;
 namespace uirenderer {
 namespace skiapipeline {
 
+class MappedBlobCache;
+
 class ShaderCache : public GrContextOptions::PersistentCache {
 public:
     /**
@@ -56,6 +61,14 @@ public:
 
     virtual void initShaderDiskCache() { initShaderDiskCache(nullptr, 0); }
 
+    /**
+     * "preloadDiskCache" reads the serialized cache contents from disk ahead of
+     * "initShaderDiskCache", so that the disk I/O can overlap with the GPU driver
+     * initialization. The next call to "initShaderDiskCache" adopts the contents
+     * instead of reading them again. It does nothing once the cache is initialized.
+     */
+    void preloadDiskCache();
+
     /**
      * "setFilename" sets the name of the file that should be used to store
      * cache contents from one program invocation to another. This function does not perform any
@@ -63,6 +76,15 @@ public:
      */
     virtual void setFilename(const char* filename);
 
+    /**
+     * "setSystemFilename" sets the name of the read-only, system provided cache file that is
+     * consulted on per-app cache misses. It defaults to the value of
+     * PROPERTY_SYSTEM_SHADER_CACHE. The system cache is only used if its identity hash matches
+     * the identity passed to "initShaderDiskCache". This function does not perform any disk
+     * operation and it should be invoked before "initShaderCache".
+     */
+    virtual void setSystemFilename(const char* filename);
+
     /**
      * "load" attempts to retrieve the value blob associated with a given key
      * blob from cache.  This will be called by Skia, when it needs to compile a new SKSL shader.
@@ -82,6 +104,12 @@ public:
      */
     void onVkFrameFlushed(GrContext* context);
 
+    /**
+     * "getMemoryUsage" returns the number of bytes held in memory by the per-app and the system
+     * caches.
+     */
+    size_t getMemoryUsage() const;
+
 private:
     // Creation and (the lack of) destruction is handled internally.
     ShaderCache();
@@ -104,13 +132,52 @@ private:
      */
     bool validateCache(const void* identity, ssize_t size);
 
+    /**
+     * "initSystemCacheLocked" loads the system cache file, if any, and drops it
+     * unless it was built for the current identity hash.
+     */
+    void initSystemCacheLocked();
+
+    /**
+     * "loadFromBlobCacheLocked" attempts to retrieve the value blob associated with a
+     * given key blob from the given BlobCache.
+     */
+    sk_sp<SkData> loadFromBlobCacheLocked(BlobCache* bc, const SkData& key);
+
     /**
      * "saveToDiskLocked" attemps to save the current contents of the cache to
      * disk. If the identity hash exists, we will insert the identity hash into
-     * the cache for next validation.
+     * the cache for next validation. The journal is folded into the saved file
+     * and removed.
      */
     void saveToDiskLocked();
 
+    /**
+     * "scheduleSaveLocked" starts the background save thread if needed and
+     * wakes it up to persist the pending journal entries after the deferred
+     * save delay.
+     */
+    void scheduleSaveLocked();
+
+    /**
+     * "saveThreadLoop" is the body of the background save thread. It appends
+     * the pending entries to the journal and periodically compacts the journal
+     * into the cache file. No disk I/O is done while holding mMutex.
+     */
+    void saveThreadLoop();
+
+    /**
+     * "replayJournalLocked" applies the entries of the journal file, written
+     * since the cache file was last compacted, to the in-memory cache.
+     */
+    void replayJournalLocked();
+
+    /**
+     * "journalFilename" returns the name of the journal file that goes with
+     * the given cache file.
+     */
+    static std::string journalFilename(const std::string& filename);
+
     /**
      * "mInitialized" indicates whether the ShaderCache is in the initialized
      * state.  It is initialized to false at construction time, and gets set to
@@ -130,6 +197,32 @@ private:
      */
     std::unique_ptr<FileBlobCache> mBlobCache;
 
+    /**
+     * "mPreloadedBlobCache" holds the contents read by "preloadDiskCache" from the
+     * file named "mPreloadedFilename", until "initShaderDiskCache" adopts them.
+     */
+    std::unique_ptr<FileBlobCache> mPreloadedBlobCache;
+    std::string mPreloadedFilename;
+
+    /**
+     * "mSystemBlobCache" is the read-only, system provided cache. It is null
+     * when there is no system cache or when it failed validation. The file is
+     * mapped rather than read, so its pages are shared between processes.
+     */
+    std::unique_ptr<MappedBlobCache> mSystemBlobCache;
+
+    /**
+     * "mSystemFilename" is the name of the file holding the system cache. An
+     * empty string disables the system cache.
+     */
+    std::string mSystemFilename;
+
+    /**
+     * "mSystemFilenameSet" indicates whether mSystemFilename has been set,
+     * otherwise it is read from PROPERTY_SYSTEM_SHADER_CACHE on initialization.
+     */
+    bool mSystemFilenameSet = false;
+
     /**
      * "mFilename" is the name of the file for storing cache contents in between
      * program invocations.  It is initialized to an empty string at
@@ -157,6 +250,36 @@ private:
      */
     bool mSavePending = false;
 
+    /**
+     * "mPendingEntries" holds the key/value pairs inserted since the last time
+     * the save thread ran, in insertion order. They are appended to the
+     * journal by the save thread.
+     */
+    std::vector<std::pair<sk_sp<SkData>, sk_sp<SkData>>> mPendingEntries;
+
+    /**
+     * "mSaveThreadStarted" is true once the background save thread is running.
+     */
+    bool mSaveThreadStarted = false;
+
+    /**
+     * "mSaveCondition" is signalled, with mMutex held, when a deferred save is
+     * scheduled.
+     */
+    std::condition_variable mSaveCondition;
+
+    /**
+     * "mIOMutex" serializes writes to the cache and journal files. It may be
+     * acquired while holding mMutex, never the other way around.
+     */
+    std::mutex mIOMutex;
+
+    /**
+     * "mJournalSize" is the size in bytes of the journal file. It is guarded
+     * by mIOMutex.
+     */
+    size_t mJournalSize = 0;
+
     /**
      *  "mObservedBlobValueSize" is the maximum value size observed by the cache reading function.
      */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SkiaImageAtlas.h"
+
+#include "utils/TraceUtils.h"
+
+#include <SkColorSpace.h>
+#include <SkPixmap.h>
+#include <log/log.h>
+
+#include <algorithm>
+
+// Width and height of every atlas texture
+#define ATLAS_PAGE_SIZE 1024
+
+// Images that fit the smallest cell size go into that page, larger ones aren't atlased
+static const int kCellSizes[] = {32, 64, 128};
+
+// Bounds how much uploading a single prepareFrame() may do
+#define ATLAS_MAX_UPLOADS_PER_FRAME 32
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+SkiaImageAtlas::SkiaImageAtlas(GrContext* context) : mContext(context) {
+    for (int cellSize : kCellSizes) {
+        Page page;
+        page.cellSize = cellSize;
+        mPages.push_back(std::move(page));
+    }
+}
+
+bool SkiaImageAtlas::canDraw(const SkImage* image, const SkPaint& paint) {
+    // The atlas textures have no mipmaps and are in sRGB N32, so only images that would be drawn
+    // identically from them can be atlased. Alpha only images take their color from the paint.
+    return paint.getFilterQuality() <= kLow_SkFilterQuality && !image->isTextureBacked() &&
+           !image->isLazyGenerated() && !image->isAlphaOnly() &&
+           image->colorType() == kN32_SkColorType &&
+           (!image->colorSpace() || image->colorSpace()->isSRGB());
+}
+
+int SkiaImageAtlas::pageIndexFor(const SkImage* image) const {
+    int size = std::max(image->width(), image->height());
+    for (size_t i = 0; i < mPages.size(); i++) {
+        if (size <= mPages[i].cellSize) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+SkIPoint SkiaImageAtlas::cellOrigin(const Page& page, uint32_t cell) const {
+    const uint32_t cellsPerRow = ATLAS_PAGE_SIZE / page.cellSize;
+    return SkIPoint::Make((cell % cellsPerRow) * page.cellSize,
+                          (cell / cellsPerRow) * page.cellSize);
+}
+
+bool SkiaImageAtlas::allocateCell(Page& page, uint32_t* outCell) {
+    if (!page.surface) {
+        SkImageInfo info = SkImageInfo::MakeN32Premul(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE,
+                                                      SkColorSpace::MakeSRGB());
+        page.surface = SkSurface::MakeRenderTarget(mContext, SkBudgeted::kYes, info);
+        if (!page.surface) {
+            ALOGW("Failed to allocate a %dx%d image atlas", ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+            return false;
+        }
+        const uint32_t cellsPerRow = ATLAS_PAGE_SIZE / page.cellSize;
+        page.cells.resize(cellsPerRow * cellsPerRow);
+        page.freeCells.reserve(page.cells.size());
+        for (uint32_t i = page.cells.size(); i > 0; i--) {
+            page.freeCells.push_back(i - 1);
+        }
+    }
+
+    if (!page.freeCells.empty()) {
+        *outCell = page.freeCells.back();
+        page.freeCells.pop_back();
+        return true;
+    }
+
+    // Reuse the least recently drawn cell, unless every cell was drawn by the last frame, in
+    // which case the page is too small for the current content and evicting would only thrash.
+    auto lru = std::min_element(page.cells.begin(), page.cells.end(),
+                                [](const Cell& a, const Cell& b) {
+                                    return a.lastUsedFrame < b.lastUsedFrame;
+                                });
+    if (lru->lastUsedFrame + 1 >= mFrame) {
+        return false;
+    }
+    mSlots.erase(lru->imageId);
+    *outCell = lru - page.cells.begin();
+    return true;
+}
+
+void SkiaImageAtlas::prepareFrame() {
+    mFrame++;
+    if (mPendingImages.empty()) {
+        return;
+    }
+
+    ATRACE_FORMAT("Upload %zu images to atlas", mPendingImages.size());
+    for (const sk_sp<const SkImage>& image : mPendingImages) {
+        SkPixmap pixmap;
+        if (mSlots.count(image->uniqueID()) || !image->peekPixels(&pixmap)) {
+            continue;
+        }
+        uint32_t pageIndex = pageIndexFor(image.get());
+        Page& page = mPages[pageIndex];
+        uint32_t cell;
+        if (!allocateCell(page, &cell)) {
+            continue;
+        }
+        if (!page.dirty) {
+            // Drop the snapshot before writing, otherwise the surface has to copy itself to
+            // preserve the snapshot's contents.
+            page.snapshot.reset();
+            page.dirty = true;
+        }
+        SkIPoint origin = cellOrigin(page, cell);
+        page.surface->writePixels(pixmap, origin.x(), origin.y());
+        page.cells[cell].imageId = image->uniqueID();
+        page.cells[cell].lastUsedFrame = mFrame;
+        mSlots[image->uniqueID()] = {pageIndex, cell};
+    }
+    mPendingImages.clear();
+
+    for (Page& page : mPages) {
+        if (page.dirty) {
+            page.snapshot = page.surface->makeImageSnapshot();
+            page.dirty = false;
+        }
+    }
+}
+
+const SkImage* SkiaImageAtlas::find(SkCanvas* canvas, const SkImage* image, const SkPaint& paint,
+                                    SkRect* outBounds) {
+    if (canvas->getGrContext() != mContext || !canDraw(image, paint)) {
+        return nullptr;
+    }
+
+    auto slot = mSlots.find(image->uniqueID());
+    if (slot == mSlots.end()) {
+        if (mPendingImages.size() < ATLAS_MAX_UPLOADS_PER_FRAME && pageIndexFor(image) >= 0 &&
+            std::none_of(mPendingImages.begin(), mPendingImages.end(),
+                         [image](const sk_sp<const SkImage>& pending) {
+                             return pending->uniqueID() == image->uniqueID();
+                         })) {
+            mPendingImages.push_back(sk_ref_sp(image));
+        }
+        return nullptr;
+    }
+
+    Page& page = mPages[slot->second.page];
+    if (!page.snapshot) {
+        return nullptr;
+    }
+    page.cells[slot->second.cell].lastUsedFrame = mFrame;
+    SkIPoint origin = cellOrigin(page, slot->second.cell);
+    *outBounds = SkRect::MakeXYWH(origin.x(), origin.y(), image->width(), image->height());
+    return page.snapshot.get();
+}
+
+size_t SkiaImageAtlas::cellCount() const {
+    size_t count = 0;
+    for (const Page& page : mPages) {
+        count += page.cells.size();
+    }
+    return count;
+}
+
+size_t SkiaImageAtlas::allocatedBytes() const {
+    size_t bytes = 0;
+    for (const Page& page : mPages) {
+        if (page.surface) {
+            bytes += ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4;
+        }
+    }
+    return bytes;
+}
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "RecordingCanvas.h"
+
+#include <GrContext.h>
+#include <SkImage.h>
+#include <SkSurface.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+/**
+ * Packs small raster images into a few shared GPU textures. Each texture holds cells of a single
+ * size, and cells are reused in least recently drawn order once a texture is full.
+ *
+ * Images are never uploaded while a frame is being drawn. An image that misses is drawn on its
+ * own and queued, and is copied into its cell by the next prepareFrame(). This way only images
+ * that are drawn on more than one frame end up in the atlas.
+ */
+class SkiaImageAtlas : public ImageAtlas {
+public:
+    explicit SkiaImageAtlas(GrContext* context);
+
+    // Uploads the images queued by the previous frame, must be called before drawing a frame.
+    void prepareFrame();
+
+    const SkImage* find(SkCanvas* canvas, const SkImage* image, const SkPaint& paint,
+                        SkRect* outBounds) override;
+
+    size_t imageCount() const { return mSlots.size(); }
+    size_t cellCount() const;
+    size_t allocatedBytes() const;
+
+private:
+    struct Cell {
+        uint32_t imageId = 0;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    struct Page {
+        int cellSize;
+        sk_sp<SkSurface> surface;
+        sk_sp<SkImage> snapshot;
+        std::vector<Cell> cells;
+        std::vector<uint32_t> freeCells;
+        bool dirty = false;
+    };
+
+    struct Slot {
+        uint32_t page;
+        uint32_t cell;
+    };
+
+    static bool canDraw(const SkImage* image, const SkPaint& paint);
+
+    int pageIndexFor(const SkImage* image) const;
+    SkIPoint cellOrigin(const Page& page, uint32_t cell) const;
+    bool allocateCell(Page& page, uint32_t* outCell);
+
+    GrContext* mContext;
+    uint64_t mFrame = 0;
+    std::vector<Page> mPages;
+    std::unordered_map<uint32_t, Slot> mSlots;
+    std::vector<sk_sp<const SkImage>> mPendingImages;
+};
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
@@ -158,6 +158,29 @@ void SkiaMemoryTracer::logTotals(String8& log) {
                      total.value, total.units, purgeable.value, purgeable.units);
 }
 
+uint64_t SkiaMemoryTracer::getTotalBytes() {
+    processElement();
+    return mTotalSize.value;
+}
+
+uint64_t SkiaMemoryTracer::getPurgeableBytes() {
+    processElement();
+    return mPurgeableSize.value;
+}
+
+uint64_t SkiaMemoryTracer::getBytes(const char* resourceName) {
+    processElement();
+    auto result = mResults.find(resourceName);
+    if (result == mResults.end()) {
+        return 0;
+    }
+    uint64_t bytes = 0;
+    for (const auto& typedValue : result->second) {
+        bytes += typedValue.second.value;
+    }
+    return bytes;
+}
+
 SkiaMemoryTracer::TraceValue SkiaMemoryTracer::convertUnits(const TraceValue& value) {
     TraceValue output(value);
     if (SkString("bytes") == SkString(output.units) && output.value >= 1024) {
@@ -37,6 +37,11 @@ public:
     void logOutput(String8& log);
     void logTotals(String8& log);
 
+    // Sizes in bytes of everything that was dumped, and of the elements labeled resourceName
+    uint64_t getTotalBytes();
+    uint64_t getPurgeableBytes();
+    uint64_t getBytes(const char* resourceName);
+
     void dumpNumericValue(const char* dumpName, const char* valueName, const char* units,
                           uint64_t value) override;
 
@@ -32,6 +32,7 @@
 #include <sstream>
 
 #include "LightingInfo.h"
+#include "SkiaImageAtlas.h"
 #include "VectorDrawable.h"
 #include "thread/CommonPool.h"
 #include "tools/SkSharingProc.h"
@@ -224,7 +225,7 @@ static void savePictureAsync(const sk_sp<SkData>& data, const std::string& filen
             ALOGD("SKP Captured Drawing Output (%zu bytes) for frame. %s", stream.bytesWritten(),
                      filename.c_str());
         }
-    });
+    }, CommonPool::Priority::Low);
 }
 
 // Note multiple SkiaPipeline instances may be loaded if more than one app is visible.
@@ -402,7 +403,7 @@ void SkiaPipeline::endCapture(SkSurface* surface) {
                 doc->close();
                 delete stream;
                 ALOGD("Multi frame SKP complete.");
-            });
+            }, CommonPool::Priority::Low);
         }
     } else {
         sk_sp<SkPicture> picture = mRecorder->finishRecordingAsPicture();
@@ -438,6 +439,12 @@ void SkiaPipeline::renderFrame(const LayerUpdateQueue& layers, const SkRect& cli
     // capture is enabled.
     SkCanvas* canvas = tryCapture(surface.get(), nodes[0].get(), layers);
 
+    SkiaImageAtlas* atlas = mRenderThread.cacheManager().imageAtlas();
+    if (atlas) {
+        atlas->prepareFrame();
+    }
+    ImageAtlas::AutoCurrent autoAtlas(atlas);
+
     // draw all layers up front
     renderLayersImpl(layers, opaque);
 
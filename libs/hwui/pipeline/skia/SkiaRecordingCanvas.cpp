@@ -25,8 +25,10 @@
 #include "NinePatchUtils.h"
 #include "RenderNode.h"
 #include "pipeline/skia/AnimatedDrawables.h"
+#include "utils/TraceUtils.h"
 #ifdef __ANDROID__ // Layoutlib does not support GL, Vulcan etc.
 #include "pipeline/skia/GLFunctorDrawable.h"
+#include "pipeline/skia/TextPrefetcher.h"
 #include "pipeline/skia/VkFunctorDrawable.h"
 #include "pipeline/skia/VkInteropFunctorDrawable.h"
 #endif
@@ -59,6 +61,14 @@ uirenderer::DisplayList* SkiaRecordingCanvas::finishRecording() {
     // close any existing chunks if necessary
     insertReorderBarrier(false);
     mRecorder.restoreToCount(1);
+    if (Properties::reorderDisplayList) {
+        mDisplayList->mDisplayList.reorderForBatching();
+    }
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+    if (Properties::prefetchText) {
+        TextPrefetcher::get().enqueue(mDisplayList->mDisplayList);
+    }
+#endif
     return mDisplayList.release();
 }
 
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextPrefetcher.h"
+
+#include "thread/CommonPool.h"
+#include "utils/TraceUtils.h"
+
+#include <SkCanvas.h>
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+// Text is prefetched into a scratch mask of at most this size, glyphs outside of it are left to
+// be rasterized when the text is drawn
+#define PREFETCH_TEXT_MAX_WIDTH 2048
+#define PREFETCH_TEXT_MAX_HEIGHT 256
+
+// Text blobs waiting to be prefetched beyond this are dropped
+#define PREFETCH_TEXT_MAX_PENDING 1024
+
+TextPrefetcher& TextPrefetcher::get() {
+    static TextPrefetcher* sInstance = new TextPrefetcher();
+    return *sInstance;
+}
+
+void TextPrefetcher::enqueue(const DisplayListData& displayList) {
+    if (!displayList.hasText()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    displayList.forEachTextBlob([this](const SkTextBlob* blob, const SkPaint& paint) {
+        if (mPending.size() >= PREFETCH_TEXT_MAX_PENDING) {
+            return;
+        }
+        // Only the state that ends up in the glyph cache key matters, drop everything else
+        SkPaint glyphPaint(paint);
+        glyphPaint.setShader(nullptr);
+        glyphPaint.setColorFilter(nullptr);
+        glyphPaint.setImageFilter(nullptr);
+        glyphPaint.setColor(SK_ColorBLACK);
+        glyphPaint.setBlendMode(SkBlendMode::kSrcOver);
+        mPending.emplace_back(sk_ref_sp(blob), glyphPaint);
+    });
+    if (!mTaskPosted && !mPending.empty()) {
+        mTaskPosted = true;
+        CommonPool::post([this] { drainQueue(); }, CommonPool::Priority::Low);
+    }
+}
+
+size_t TextPrefetcher::prefetchedCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mPrefetchedCount;
+}
+
+void TextPrefetcher::drainQueue() {
+    std::vector<TextRun> runs;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mPrefetchedCount += runs.size();
+            runs.clear();
+            if (mPending.empty()) {
+                mTaskPosted = false;
+                return;
+            }
+            runs.swap(mPending);
+        }
+
+        ATRACE_FORMAT("Prefetch %zu text blobs", runs.size());
+        // Glyphs are cached by the device matrix and the font, not the destination, so the
+        // cheapest surface that still rasterizes the masks will do
+        if (mScratch.isNull()) {
+            mScratch.allocPixels(
+                    SkImageInfo::MakeA8(PREFETCH_TEXT_MAX_WIDTH, PREFETCH_TEXT_MAX_HEIGHT));
+        }
+        SkCanvas canvas(mScratch);
+        for (const auto& [blob, paint] : runs) {
+            const SkRect& bounds = blob->bounds();
+            canvas.resetMatrix();
+            canvas.translate(-SkScalarFloorToScalar(bounds.fLeft),
+                             -SkScalarFloorToScalar(bounds.fTop));
+            canvas.drawTextBlob(blob.get(), 0, 0, paint);
+        }
+    }
+}
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "RecordingCanvas.h"
+
+#include <SkBitmap.h>
+#include <SkPaint.h>
+#include <SkTextBlob.h>
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+namespace skiapipeline {
+
+/**
+ * Rasterizes the glyphs of recorded text on a low priority CommonPool worker, so that the process
+ * wide glyph cache is already warm when the RenderThread draws the text.
+ *
+ * Text from every recorded display list is queued. A single worker task drains the queue, so
+ * display lists recorded while a prefetch is running are picked up by that same task instead of
+ * being dropped. The queue is bounded; text beyond it is rasterized lazily, as before.
+ */
+class TextPrefetcher {
+public:
+    static TextPrefetcher& get();
+
+    void enqueue(const DisplayListData& displayList);
+
+    // The number of text blobs rasterized so far, for tests
+    size_t prefetchedCount();
+
+private:
+    using TextRun = std::pair<sk_sp<const SkTextBlob>, SkPaint>;
+
+    void drainQueue();
+
+    std::mutex mLock;
+    std::vector<TextRun> mPending;
+    bool mTaskPosted = false;
+    size_t mPrefetchedCount = 0;
+    // Only touched by the single worker task, reused across prefetches
+    SkBitmap mScratch;
+};
+
+} /* namespace skiapipeline */
+} /* namespace uirenderer */
+} /* namespace android */
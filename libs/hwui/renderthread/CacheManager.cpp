@@ -19,12 +19,18 @@
 #include "DeviceInfo.h"
 #include "Layer.h"
 #include "Properties.h"
+#include "RenderNode.h"
 #include "RenderThread.h"
+#include "VectorDrawable.h"
+#include "hwui/MinikinUtils.h"
 #include "pipeline/skia/ATraceMemoryDump.h"
 #include "pipeline/skia/ShaderCache.h"
+#include "pipeline/skia/SkiaImageAtlas.h"
 #include "pipeline/skia/SkiaMemoryTracer.h"
 #include "renderstate/RenderState.h"
 #include "thread/CommonPool.h"
+#include "utils/TimeUtils.h"
+#include "utils/TraceUtils.h"
 #include <utils/Trace.h>
 
 #include <GrContextOptions.h>
@@ -32,6 +38,9 @@
 #include <SkGraphics.h>
 #include <SkMathPriv.h>
 #include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
 #include <set>
 
 namespace android {
@@ -45,8 +54,45 @@ namespace renderthread {
 #define SURFACE_SIZE_MULTIPLIER (12.0f * 4.0f)
 #define BACKGROUND_RETENTION_PERCENTAGE (0.5f)
 
-CacheManager::CacheManager()
+// Memory pressure runs from 0 (none) to 1 (critical). Crossing these tiers purges
+// unlocked scratch resources and then the CPU glyph and resource caches.
+#define SCRATCH_PURGE_PRESSURE (0.5f)
+#define CPU_CACHE_PURGE_PRESSURE (0.75f)
+// Budget changes smaller than this fraction of the maximum are not worth a purge.
+#define BUDGET_HYSTERESIS (0.05f)
+
+// The "some avg10" memory PSI value, in percent of time stalled, treated as critical.
+#define PSI_CRITICAL_STALL_PERCENTAGE (20.0f)
+#define PSI_POLL_INTERVAL 1_s
+// RUNNING_* trim levels are not revoked with a callback, so they expire instead.
+#define TRIM_PRESSURE_TIMEOUT 30_s
+
+// Once no frame has completed for this long, resources that have not been used
+// recently are purged. The age scales from the max down to the min with pressure.
+#define IDLE_PURGE_DELAY 1_s
+#define IDLE_PURGE_MAX_AGE std::chrono::seconds(30)
+#define IDLE_PURGE_MIN_AGE std::chrono::seconds(5)
+
+static float readPsiPressure() {
+    static bool sPsiUnavailable = false;
+    if (sPsiUnavailable) return 0;
+
+    FILE* file = fopen("/proc/pressure/memory", "re");
+    if (!file) {
+        sPsiUnavailable = true;
+        return 0;
+    }
+    float avg10 = 0;
+    if (fscanf(file, "some avg10=%f", &avg10) != 1) {
+        avg10 = 0;
+    }
+    fclose(file);
+    return std::min(avg10 / PSI_CRITICAL_STALL_PERCENTAGE, 1.0f);
+}
+
+CacheManager::CacheManager(RenderThread& thread)
         : mMaxSurfaceArea(DeviceInfo::getWidth() * DeviceInfo::getHeight())
+        , mRenderThread(thread)
         , mMaxResourceBytes(mMaxSurfaceArea * SURFACE_SIZE_MULTIPLIER)
         , mBackgroundResourceBytes(mMaxResourceBytes * BACKGROUND_RETENTION_PERCENTAGE)
         // This sets the maximum size for a single texture atlas in the GPU font cache. If
@@ -57,7 +103,9 @@ CacheManager::CacheManager()
         // total number of GPU font caches (i.e. 4 separate GPU atlases).
         , mMaxCpuFontCacheBytes(
                   std::max(mMaxGpuFontAtlasBytes * 4, SkGraphics::GetFontCacheLimit()))
-        , mBackgroundCpuFontCacheBytes(mMaxCpuFontCacheBytes * BACKGROUND_RETENTION_PERCENTAGE) {
+        , mBackgroundCpuFontCacheBytes(mMaxCpuFontCacheBytes * BACKGROUND_RETENTION_PERCENTAGE)
+        , mResourceBudget(mMaxResourceBytes)
+        , mCpuFontCacheBudget(mMaxCpuFontCacheBytes) {
     SkGraphics::SetFontCacheLimit(mMaxCpuFontCacheBytes);
 }
 
@@ -68,12 +116,13 @@ void CacheManager::reset(sk_sp<GrContext> context) {
 
     if (context) {
         mGrContext = std::move(context);
-        mGrContext->setResourceCacheLimit(mMaxResourceBytes);
+        mGrContext->setResourceCacheLimit(mResourceBudget);
     }
 }
 
 void CacheManager::destroy() {
     // cleanup any caches here as the GrContext is about to go away...
+    mImageAtlas.reset();
     mGrContext.reset(nullptr);
 }
 
@@ -101,12 +150,39 @@ void CacheManager::trimMemory(TrimMemoryMode mode) {
         return;
     }
 
+    float trimPressure = 0;
+    switch (mode) {
+        case TrimMemoryMode::RunningModerate:
+            trimPressure = SCRATCH_PURGE_PRESSURE / 2;
+            break;
+        case TrimMemoryMode::RunningLow:
+            trimPressure = SCRATCH_PURGE_PRESSURE;
+            break;
+        case TrimMemoryMode::RunningCritical:
+            trimPressure = 1.0f;
+            break;
+        default:
+            break;
+    }
+    if (trimPressure > 0) {
+        mTrimPressure = trimPressure;
+        mTrimPressureTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        updateMemoryPressure(mTrimPressureTime);
+        return;
+    }
+
     mGrContext->flush();
 
+    // The atlas textures are always in use, so they have to be released before the GrContext
+    // can free them. The atlas is repopulated from scratch once it is needed again.
+    mImageAtlas.reset();
+
     switch (mode) {
         case TrimMemoryMode::Complete:
             mGrContext->freeGpuResources();
             SkGraphics::PurgeAllCaches();
+            VectorDrawable::RasterCache::get().clear();
+            MinikinUtils::purgeLayoutCache();
             break;
         case TrimMemoryMode::UiHidden:
             // Here we purge all the unlocked scratch resources and then toggle the resources cache
@@ -114,9 +190,12 @@ void CacheManager::trimMemory(TrimMemoryMode mode) {
             // that have persistent data to be purged in LRU order.
             mGrContext->purgeUnlockedResources(true);
             mGrContext->setResourceCacheLimit(mBackgroundResourceBytes);
-            mGrContext->setResourceCacheLimit(mMaxResourceBytes);
+            mGrContext->setResourceCacheLimit(mResourceBudget);
             SkGraphics::SetFontCacheLimit(mBackgroundCpuFontCacheBytes);
-            SkGraphics::SetFontCacheLimit(mMaxCpuFontCacheBytes);
+            SkGraphics::SetFontCacheLimit(mCpuFontCacheBudget);
+            VectorDrawable::RasterCache::get().clear();
+            break;
+        default:
             break;
     }
 
@@ -125,6 +204,16 @@ void CacheManager::trimMemory(TrimMemoryMode mode) {
     mGrContext->flush(kSyncCpu_GrFlushFlag, 0, nullptr);
 }
 
+skiapipeline::SkiaImageAtlas* CacheManager::imageAtlas() {
+    if (!Properties::enableImageAtlas || !mGrContext) {
+        return nullptr;
+    }
+    if (!mImageAtlas) {
+        mImageAtlas = std::make_unique<skiapipeline::SkiaImageAtlas>(mGrContext.get());
+    }
+    return mImageAtlas.get();
+}
+
 void CacheManager::trimStaleResources() {
     if (!mGrContext) {
         return;
@@ -139,6 +228,12 @@ void CacheManager::dumpMemoryUsage(String8& log, const RenderState* renderState)
         return;
     }
 
+    log.appendFormat("Memory pressure: %.2f\n", mMemoryPressure);
+    log.appendFormat("  Resource budget: %.2f kB of %.2f kB\n", mResourceBudget / 1024.0f,
+                     mMaxResourceBytes / 1024.0f);
+    log.appendFormat("  Font cache budget: %.2f kB of %.2f kB\n", mCpuFontCacheBudget / 1024.0f,
+                     mMaxCpuFontCacheBytes / 1024.0f);
+
     log.appendFormat("Font Cache (CPU):\n");
     log.appendFormat("  Size: %.2f kB \n", SkGraphics::GetFontCacheUsed() / 1024.0f);
     log.appendFormat("  Glyph Count: %d \n", SkGraphics::GetFontCacheCountUsed());
@@ -154,6 +249,13 @@ void CacheManager::dumpMemoryUsage(String8& log, const RenderState* renderState)
     SkGraphics::DumpMemoryStatistics(&cpuTracer);
     cpuTracer.logOutput(log);
 
+    if (mImageAtlas) {
+        log.appendFormat("Image atlas:\n");
+        log.appendFormat("  Images: %zu of %zu cells\n", mImageAtlas->imageCount(),
+                         mImageAtlas->cellCount());
+        log.appendFormat("  Size: %.2f kB\n", mImageAtlas->allocatedBytes() / 1024.0f);
+    }
+
     log.appendFormat("GPU Caches:\n");
     skiapipeline::SkiaMemoryTracer gpuTracer("category", true);
     mGrContext->dumpMemoryStatistics(&gpuTracer);
@@ -161,6 +263,10 @@ void CacheManager::dumpMemoryUsage(String8& log, const RenderState* renderState)
 
     log.appendFormat("Other Caches:\n");
     log.appendFormat("                         Current / Maximum\n");
+    VectorDrawable::RasterCache& rasterCache = VectorDrawable::RasterCache::get();
+    log.appendFormat("  VectorDrawable rasters %6.2f KB / %6.2f KB (numRasters = %zu)\n",
+                     rasterCache.getUsedBytes() / 1024.0f, rasterCache.getMaxBytes() / 1024.0f,
+                     rasterCache.getEntryCount());
 
     if (renderState) {
         if (renderState->mActiveLayers.size() > 0) {
@@ -186,6 +292,42 @@ void CacheManager::dumpMemoryUsage(String8& log, const RenderState* renderState)
     gpuTracer.logTotals(log);
 }
 
+void CacheManager::getMemoryStats(GpuMemoryStats* outStats, const RenderState* renderState) {
+    *outStats = GpuMemoryStats();
+    outStats->glyphCacheBytes = SkGraphics::GetFontCacheUsed();
+    outStats->shaderCacheBytes = skiapipeline::ShaderCache::get().getMemoryUsage();
+    if (!mGrContext) {
+        return;
+    }
+
+    skiapipeline::SkiaMemoryTracer gpuTracer("type", false);
+    mGrContext->dumpMemoryStatistics(&gpuTracer);
+    outStats->totalBytes = gpuTracer.getTotalBytes();
+    outStats->purgeableBytes = gpuTracer.getPurgeableBytes();
+    outStats->textureBytes = gpuTracer.getBytes("Texture");
+    outStats->renderTargetBytes = gpuTracer.getBytes("RenderTarget");
+    outStats->otherBytes =
+            outStats->totalBytes - std::min(outStats->totalBytes,
+                                            outStats->textureBytes + outStats->renderTargetBytes);
+
+    RenderNode::forEachLayer([outStats](const RenderNode& node) {
+        SkSurface* surface = node.getLayerSurface();
+        size_t bytes = surface->width() * surface->height() * surface->imageInfo().bytesPerPixel();
+        outStats->layerBytes += bytes;
+        outStats->layers.push_back({node.uniqueId(), node.getName(), bytes});
+    });
+
+    if (renderState) {
+        for (const Layer* layer : renderState->mActiveLayers) {
+            outStats->textureLayerBytes += layer->getWidth() * layer->getHeight() * 4;
+        }
+    }
+
+    if (mImageAtlas) {
+        outStats->imageAtlasBytes = mImageAtlas->allocatedBytes();
+    }
+}
+
 void CacheManager::onFrameCompleted() {
     if (ATRACE_ENABLED()) {
         static skiapipeline::ATraceMemoryDump tracer;
@@ -196,6 +338,83 @@ void CacheManager::onFrameCompleted() {
         }
         tracer.logTraces();
     }
+
+    mLastFrameCompletedTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    updateMemoryPressure(mLastFrameCompletedTime);
+    scheduleIdlePurge();
+}
+
+void CacheManager::updateMemoryPressure(nsecs_t now) {
+    if (now - mLastPsiReadTime >= PSI_POLL_INTERVAL) {
+        mPsiPressure = readPsiPressure();
+        mLastPsiReadTime = now;
+    }
+    float trimPressure = now - mTrimPressureTime < TRIM_PRESSURE_TIMEOUT ? mTrimPressure : 0;
+    setMemoryPressure(std::max(mPsiPressure, trimPressure));
+}
+
+void CacheManager::setMemoryPressure(float pressure) {
+    pressure = std::max(0.0f, std::min(pressure, 1.0f));
+    if (!mGrContext) {
+        mMemoryPressure = pressure;
+        return;
+    }
+
+    size_t resourceBudget =
+            mMaxResourceBytes - pressure * (mMaxResourceBytes - mBackgroundResourceBytes);
+    size_t fontCacheBudget = mMaxCpuFontCacheBytes -
+                             pressure * (mMaxCpuFontCacheBytes - mBackgroundCpuFontCacheBytes);
+    size_t budgetDelta = resourceBudget > mResourceBudget ? resourceBudget - mResourceBudget
+                                                          : mResourceBudget - resourceBudget;
+    // Always go back to the full budgets once the pressure is gone.
+    if (budgetDelta >= mMaxResourceBytes * BUDGET_HYSTERESIS ||
+        (pressure == 0 && budgetDelta > 0)) {
+        ATRACE_FORMAT("CacheManager budget %zu kB, pressure %.2f", resourceBudget / 1024,
+                      pressure);
+        mResourceBudget = resourceBudget;
+        mCpuFontCacheBudget = fontCacheBudget;
+        mGrContext->setResourceCacheLimit(mResourceBudget);
+        SkGraphics::SetFontCacheLimit(mCpuFontCacheBudget);
+    }
+
+    if (pressure >= SCRATCH_PURGE_PRESSURE && mMemoryPressure < SCRATCH_PURGE_PRESSURE) {
+        ATRACE_NAME("CacheManager purge scratch resources");
+        mGrContext->purgeUnlockedResources(true);
+    }
+    if (pressure >= CPU_CACHE_PURGE_PRESSURE && mMemoryPressure < CPU_CACHE_PURGE_PRESSURE) {
+        ATRACE_NAME("CacheManager purge CPU caches");
+        SkGraphics::PurgeFontCache();
+        SkGraphics::PurgeResourceCache();
+    }
+    mMemoryPressure = pressure;
+}
+
+void CacheManager::scheduleIdlePurge() {
+    if (mIdlePurgeScheduled) return;
+    mIdlePurgeScheduled = true;
+    mRenderThread.queue().postAt(mLastFrameCompletedTime + IDLE_PURGE_DELAY,
+                                 [this]() { onIdle(); });
+}
+
+void CacheManager::onIdle() {
+    mIdlePurgeScheduled = false;
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (now - mLastFrameCompletedTime < IDLE_PURGE_DELAY) {
+        // Still drawing, check again once the latest frame has been idle for long enough.
+        scheduleIdlePurge();
+        return;
+    }
+    if (!mGrContext) {
+        return;
+    }
+
+    ATRACE_NAME("CacheManager::onIdle");
+    updateMemoryPressure(now);
+    auto maxAge = IDLE_PURGE_MAX_AGE;
+    auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+            maxAge - (maxAge - IDLE_PURGE_MIN_AGE) * mMemoryPressure);
+    mGrContext->flush();
+    mGrContext->purgeResourcesNotUsedInMs(age);
 }
 
 } /* namespace renderthread */
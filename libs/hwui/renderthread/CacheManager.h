@@ -21,7 +21,10 @@
 #include <GrContext.h>
 #endif
 #include <SkSurface.h>
+#include <memory>
+#include <string>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 #include <vector>
 
 namespace android {
@@ -32,14 +35,54 @@ namespace uirenderer {
 
 class RenderState;
 
+namespace skiapipeline {
+class SkiaImageAtlas;
+}
+
 namespace renderthread {
 
 class IRenderPipeline;
 class RenderThread;
 
+/**
+ * A breakdown of the memory the RenderThread holds for rendering, in bytes. The GPU totals come
+ * from the GrContext's resource cache, which also holds the layers and the image atlas, so those
+ * are a subset of totalBytes rather than in addition to it.
+ */
+struct GpuMemoryStats {
+    struct LayerUsage {
+        int64_t renderNodeId;
+        std::string renderNodeName;
+        size_t bytes;
+    };
+
+    size_t totalBytes = 0;
+    size_t purgeableBytes = 0;
+    size_t textureBytes = 0;
+    size_t renderTargetBytes = 0;
+    size_t otherBytes = 0;
+
+    size_t layerBytes = 0;
+    std::vector<LayerUsage> layers;
+    // TextureView and other Layer objects registered with the RenderState
+    size_t textureLayerBytes = 0;
+
+    size_t imageAtlasBytes = 0;
+    size_t glyphCacheBytes = 0;
+    size_t shaderCacheBytes = 0;
+};
+
 class CacheManager {
 public:
-    enum class TrimMemoryMode { Complete, UiHidden };
+    enum class TrimMemoryMode {
+        Complete,
+        UiHidden,
+        // The app is still visible but the device is running low on memory, these only shrink
+        // the cache budgets, see setMemoryPressure().
+        RunningModerate,
+        RunningLow,
+        RunningCritical,
+    };
 
 #ifdef __ANDROID__ // Layoutlib does not support hardware acceleration
     void configureContext(GrContextOptions* context, const void* identity, ssize_t size);
@@ -47,15 +90,36 @@ public:
     void trimMemory(TrimMemoryMode mode);
     void trimStaleResources();
     void dumpMemoryUsage(String8& log, const RenderState* renderState = nullptr);
+    void getMemoryStats(GpuMemoryStats* outStats, const RenderState* renderState = nullptr);
 
     size_t getCacheSize() const { return mMaxResourceBytes; }
     size_t getBackgroundCacheSize() const { return mBackgroundResourceBytes; }
+    size_t getResourceBudget() const { return mResourceBudget; }
     void onFrameCompleted();
 
+#ifdef __ANDROID__ // Layoutlib does not support hardware acceleration
+    // Returns the shared image atlas, or nullptr if it is disabled or there is no GrContext.
+    skiapipeline::SkiaImageAtlas* imageAtlas();
+#endif
+
+    /**
+     * Scales the GPU resource and CPU font cache budgets between their maximum (pressure 0)
+     * and background (pressure 1) sizes. Crossing into a higher pressure tier additionally
+     * purges unlocked scratch resources, then the CPU glyph and resource caches.
+     *
+     * The pressure is normally derived from PSI and recent RUNNING_* trim levels every time a
+     * frame completes, this is only public for testing.
+     */
+    void setMemoryPressure(float pressure);
+
 private:
     friend class RenderThread;
 
-    explicit CacheManager();
+    explicit CacheManager(RenderThread& thread);
+
+    void updateMemoryPressure(nsecs_t now);
+    void scheduleIdlePurge();
+    void onIdle();
 
 #ifdef __ANDROID__ // Layoutlib does not support hardware acceleration
     void reset(sk_sp<GrContext> grContext);
@@ -65,14 +129,30 @@ private:
     const size_t mMaxSurfaceArea;
 #ifdef __ANDROID__ // Layoutlib does not support hardware acceleration
     sk_sp<GrContext> mGrContext;
+    std::unique_ptr<skiapipeline::SkiaImageAtlas> mImageAtlas;
 #endif
 
+    RenderThread& mRenderThread;
+
     const size_t mMaxResourceBytes;
     const size_t mBackgroundResourceBytes;
 
     const size_t mMaxGpuFontAtlasBytes;
     const size_t mMaxCpuFontCacheBytes;
     const size_t mBackgroundCpuFontCacheBytes;
+
+    // The budgets currently applied for the memory pressure
+    float mMemoryPressure = 0;
+    size_t mResourceBudget;
+    size_t mCpuFontCacheBudget;
+
+    float mPsiPressure = 0;
+    nsecs_t mLastPsiReadTime = 0;
+    float mTrimPressure = 0;
+    nsecs_t mTrimPressureTime = 0;
+
+    nsecs_t mLastFrameCompletedTime = 0;
+    bool mIdlePurgeScheduled = false;
 };
 
 } /* namespace renderthread */
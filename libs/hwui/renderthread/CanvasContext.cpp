@@ -43,9 +43,16 @@
 
 #define TRIM_MEMORY_COMPLETE 80
 #define TRIM_MEMORY_UI_HIDDEN 20
+#define TRIM_MEMORY_RUNNING_CRITICAL 15
+#define TRIM_MEMORY_RUNNING_LOW 10
+#define TRIM_MEMORY_RUNNING_MODERATE 5
 
 #define LOG_FRAMETIME_MMA 0
 
+// Number of consecutive frames that must finish well inside the latch deadline before dynamic
+// render ahead is dropped, trading a frame of latency back for the safety margin
+#define RENDER_AHEAD_RECOVERY_FRAMES 120
+
 #if LOG_FRAMETIME_MMA
 static float sBenchMma = 0;
 static int sFrameCount = 0;
@@ -156,10 +163,13 @@ static void setBufferCount(ANativeWindow* window) {
 
 void CanvasContext::setSurface(ANativeWindow* window, bool enableTimeout) {
     ATRACE_CALL();
+    finishPendingSwap();
 
     if (mRenderAheadDepth == 0 && DeviceInfo::get()->getMaxRefreshRate() > 66.6f) {
         mFixedRenderAhead = false;
         mRenderAheadCapacity = 1;
+        mDynamicRenderAhead = 1;
+        mFramesWithinDeadline = 0;
     } else {
         mFixedRenderAhead = true;
         mRenderAheadCapacity = mRenderAheadDepth;
@@ -210,6 +220,7 @@ bool CanvasContext::pauseSurface() {
 }
 
 void CanvasContext::setStopped(bool stopped) {
+    finishPendingSwap();
     if (mStopped != stopped) {
         mStopped = stopped;
         if (mStopped) {
@@ -355,10 +366,11 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
         return;
     }
 
-    if (CC_LIKELY(mSwapHistory.size() && !Properties::forceDrawFrame)) {
+    if (CC_LIKELY((mSwapHistory.size() || mPendingSwap) && !Properties::forceDrawFrame)) {
         nsecs_t latestVsync = mRenderThread.timeLord().latestVsync();
-        SwapHistory& lastSwap = mSwapHistory.back();
-        nsecs_t vsyncDelta = std::abs(lastSwap.vsyncTime - latestVsync);
+        nsecs_t lastSwapVsync =
+                mPendingSwap ? mPendingSwap->vsyncTime : mSwapHistory.back().vsyncTime;
+        nsecs_t vsyncDelta = std::abs(lastSwapVsync - latestVsync);
         // The slight fudge-factor is to deal with cases where
         // the vsync was estimated due to being slow handling the signal.
         // See the logic in TimeLord#computeFrameTimeNanos or in
@@ -379,7 +391,9 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
     }
 
     if (info.out.canDrawThisFrame) {
-        int err = mNativeSurface->reserveNext();
+        // While the previous frame still holds its buffer, reserving the next one could block
+        // on buffer availability, so leave the dequeue to draw(), after that frame's swap.
+        int err = mPendingSwap ? OK : mNativeSurface->reserveNext();
         if (err != OK) {
             mCurrentFrameInfo->addFlag(FrameInfoFlags::SkippedFrame);
             info.out.canDrawThisFrame = false;
@@ -426,6 +440,7 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
 }
 
 void CanvasContext::stopDrawing() {
+    finishPendingSwap();
     mRenderThread.removeFrameCallback(this);
     mAnimationContext->pauseAnimators();
     mGenerationID++;
@@ -443,7 +458,7 @@ void CanvasContext::setPresentTime() {
     if (mFixedRenderAhead) {
         renderAhead = std::min(mRenderAheadDepth, mRenderAheadCapacity);
     } else if (frameIntervalNanos < 15_ms) {
-        renderAhead = std::min(1, static_cast<int>(mRenderAheadCapacity));
+        renderAhead = std::min(mDynamicRenderAhead, mRenderAheadCapacity);
     }
 
     if (renderAhead) {
@@ -454,7 +469,31 @@ void CanvasContext::setPresentTime() {
     native_window_set_buffers_timestamp(mNativeSurface->getNativeWindow(), presentTime);
 }
 
-void CanvasContext::draw() {
+void CanvasContext::updateDynamicRenderAhead(const FrameInfo& frameInfo) {
+    if (mFixedRenderAhead || (frameInfo[FrameInfoIndex::Flags] & FrameInfoFlags::SkippedFrame)) {
+        return;
+    }
+    nsecs_t gpuCompleted = frameInfo[FrameInfoIndex::GpuCompleted];
+    if (gpuCompleted <= 0) {
+        return;
+    }
+    // Render ahead only buys anything when frames can't reliably make the very next refresh.
+    // Keep a quarter of a frame as headroom so a small regression doesn't immediately jank.
+    const TimeLord& timeLord = mRenderThread.timeLord();
+    nsecs_t deadline = timeLord.computeLatchDeadline(frameInfo[FrameInfoIndex::Vsync], 0) -
+                       (timeLord.frameIntervalNanos() / 4);
+    if (gpuCompleted > deadline) {
+        mFramesWithinDeadline = 0;
+        mDynamicRenderAhead = 1;
+    } else if (mDynamicRenderAhead && ++mFramesWithinDeadline >= RENDER_AHEAD_RECOVERY_FRAMES) {
+        mDynamicRenderAhead = 0;
+    }
+}
+
+void CanvasContext::draw(bool allowDeferredSwap) {
+    // Only a single frame may be in flight between draw and swap.
+    finishPendingSwap();
+
     SkRect dirty;
     mDamageAccumulator.finish(&dirty);
 
@@ -480,16 +519,57 @@ void CanvasContext::draw() {
                                       mContentDrawBounds, mOpaque, mLightInfo, mRenderNodes,
                                       &(profiler()));
 
-    int64_t frameCompleteNr = getFrameNumber();
+    mIsDirty = false;
+
+    std::unique_ptr<PendingSwap> swap(new PendingSwap{
+            frame, windowDirty, drew, getFrameNumber(), mRenderThread.timeLord().latestVsync(),
+            mCurrentFrameInfo, &mLast4FrameInfos[-1], std::move(mFrameCompleteCallbacks)});
+    mFrameCompleteCallbacks.clear();
+    if (mLast4FrameInfos.size() == mLast4FrameInfos.capacity()) {
+        swap->fourthBehind = mLast4FrameInfos.front();
+    }
+
+    if (allowDeferredSwap) {
+        // The swap runs as the next RenderThread task, unless the UI thread has already
+        // queued the sync of the next frame, which then goes first. Tasks run in order,
+        // so this is always ahead of the task that destroys the context.
+        mPendingSwap = std::move(swap);
+        mRenderThread.queue().post([this]() { finishPendingSwap(); });
+        return;
+    }
+    swapAndFinishFrame(*swap);
+}
+
+void CanvasContext::finishPendingSwap() {
+    if (mPendingSwap) {
+        ATRACE_NAME("finishPendingSwap");
+        // Clear it first, swapAndFinishFrame may end up in setSurface(nullptr)
+        std::unique_ptr<PendingSwap> swap = std::move(mPendingSwap);
+        if (!mRenderPipeline->isContextReady()) {
+            // The rendering context was torn down since the draw, e.g. by trimMemory, so
+            // there is nothing to swap. Hand the callbacks on to the next frame.
+            mFrameCompleteCallbacks.insert(
+                    mFrameCompleteCallbacks.begin(),
+                    std::make_move_iterator(swap->frameCompleteCallbacks.begin()),
+                    std::make_move_iterator(swap->frameCompleteCallbacks.end()));
+            return;
+        }
+        swapAndFinishFrame(*swap);
+    }
+}
+
+void CanvasContext::swapAndFinishFrame(PendingSwap& pendingSwap) {
+    const Frame& frame = pendingSwap.frame;
+    const SkRect& windowDirty = pendingSwap.windowDirty;
+    FrameInfo* frameInfo = pendingSwap.frameInfo;
+    int64_t frameCompleteNr = pendingSwap.frameCompleteNr;
 
     waitOnFences();
 
     bool requireSwap = false;
     int error = OK;
-    bool didSwap =
-            mRenderPipeline->swapBuffers(frame, drew, windowDirty, mCurrentFrameInfo, &requireSwap);
-
-    mIsDirty = false;
+    bool didSwap = mRenderPipeline->swapBuffers(frame, pendingSwap.drew, windowDirty, frameInfo,
+                                                &requireSwap);
 
     if (requireSwap) {
         bool didDraw = true;
@@ -516,11 +596,11 @@ void CanvasContext::draw() {
             swap.damage = SkRect::MakeWH(max, max);
         }
         swap.swapCompletedTime = systemTime(SYSTEM_TIME_MONOTONIC);
-        swap.vsyncTime = mRenderThread.timeLord().latestVsync();
+        swap.vsyncTime = pendingSwap.vsyncTime;
         if (didDraw) {
             nsecs_t dequeueStart =
                     ANativeWindow_getLastDequeueStartTime(mNativeSurface->getNativeWindow());
-            if (dequeueStart < mCurrentFrameInfo->get(FrameInfoIndex::SyncStart)) {
+            if (dequeueStart < frameInfo->get(FrameInfoIndex::SyncStart)) {
                 // Ignoring dequeue duration as it happened prior to frame render start
                 // and thus is not part of the frame.
                 swap.dequeueDuration = 0;
@@ -534,23 +614,23 @@ void CanvasContext::draw() {
             swap.dequeueDuration = 0;
             swap.queueDuration = 0;
         }
-        mCurrentFrameInfo->set(FrameInfoIndex::DequeueBufferDuration) = swap.dequeueDuration;
-        mCurrentFrameInfo->set(FrameInfoIndex::QueueBufferDuration) = swap.queueDuration;
-        mLast4FrameInfos[-1].second = frameCompleteNr;
+        frameInfo->set(FrameInfoIndex::DequeueBufferDuration) = swap.dequeueDuration;
+        frameInfo->set(FrameInfoIndex::QueueBufferDuration) = swap.queueDuration;
+        pendingSwap.frameInfoEntry->second = frameCompleteNr;
         mHaveNewSurface = false;
         mFrameNumber = -1;
     } else {
-        mCurrentFrameInfo->set(FrameInfoIndex::DequeueBufferDuration) = 0;
-        mCurrentFrameInfo->set(FrameInfoIndex::QueueBufferDuration) = 0;
-        mLast4FrameInfos[-1].second = -1;
+        frameInfo->set(FrameInfoIndex::DequeueBufferDuration) = 0;
+        frameInfo->set(FrameInfoIndex::QueueBufferDuration) = 0;
+        pendingSwap.frameInfoEntry->second = -1;
     }
 
     // TODO: Use a fence for real completion?
-    mCurrentFrameInfo->markFrameCompleted();
+    frameInfo->markFrameCompleted();
 
 #if LOG_FRAMETIME_MMA
-    float thisFrame = mCurrentFrameInfo->duration(FrameInfoIndex::IssueDrawCommandsStart,
-                                                  FrameInfoIndex::FrameCompleted) /
+    float thisFrame = frameInfo->duration(FrameInfoIndex::IssueDrawCommandsStart,
+                                          FrameInfoIndex::FrameCompleted) /
                       NANOS_PER_MILLIS_F;
     if (sFrameCount) {
         sBenchMma = ((9 * sBenchMma) + thisFrame) / 10;
@@ -563,23 +643,28 @@ void CanvasContext::draw() {
     }
 #endif
 
+    auto& frameCompleteCallbacks = pendingSwap.frameCompleteCallbacks;
     if (didSwap) {
-        for (auto& func : mFrameCompleteCallbacks) {
+        for (auto& func : frameCompleteCallbacks) {
             std::invoke(func, frameCompleteNr);
         }
-        mFrameCompleteCallbacks.clear();
+    } else {
+        // Keep waiting for the next frame that makes it to the screen
+        mFrameCompleteCallbacks.insert(mFrameCompleteCallbacks.begin(),
+                                       std::make_move_iterator(frameCompleteCallbacks.begin()),
+                                       std::make_move_iterator(frameCompleteCallbacks.end()));
     }
 
-    mJankTracker.finishFrame(*mCurrentFrameInfo);
+    mJankTracker.finishFrame(*frameInfo);
     if (CC_UNLIKELY(mFrameMetricsReporter.get() != nullptr)) {
-        mFrameMetricsReporter->reportFrameMetrics(mCurrentFrameInfo->data());
+        mFrameMetricsReporter->reportFrameMetrics(frameInfo->data());
     }
 
-    if (mLast4FrameInfos.size() == mLast4FrameInfos.capacity()) {
+    if (pendingSwap.fourthBehind.first) {
         // By looking 4 frames back, we guarantee all SF stats are available. There are at
         // most 3 buffers in BufferQueue. Surface object keeps stats for the last 8 frames.
-        FrameInfo* forthBehind = mLast4FrameInfos.front().first;
-        int64_t composedFrameId = mLast4FrameInfos.front().second;
+        FrameInfo* forthBehind = pendingSwap.fourthBehind.first;
+        int64_t composedFrameId = pendingSwap.fourthBehind.second;
         nsecs_t acquireTime = -1;
         if (mNativeSurface) {
             native_window_get_frame_timestamps(mNativeSurface->getNativeWindow(), composedFrameId,
@@ -589,6 +674,7 @@ void CanvasContext::draw() {
         // Ignore default -1, NATIVE_WINDOW_TIMESTAMP_INVALID and NATIVE_WINDOW_TIMESTAMP_PENDING
         forthBehind->set(FrameInfoIndex::GpuCompleted) = acquireTime > 0 ? acquireTime : -1;
         mJankTracker.finishGpuDraw(*forthBehind);
+        updateDynamicRenderAhead(*forthBehind);
     }
 
     mRenderThread.cacheManager().onFrameCompleted();
@@ -692,6 +778,12 @@ void CanvasContext::trimMemory(RenderThread& thread, int level) {
         thread.destroyRenderingContext();
     } else if (level >= TRIM_MEMORY_UI_HIDDEN) {
         thread.cacheManager().trimMemory(CacheManager::TrimMemoryMode::UiHidden);
+    } else if (level >= TRIM_MEMORY_RUNNING_CRITICAL) {
+        thread.cacheManager().trimMemory(CacheManager::TrimMemoryMode::RunningCritical);
+    } else if (level >= TRIM_MEMORY_RUNNING_LOW) {
+        thread.cacheManager().trimMemory(CacheManager::TrimMemoryMode::RunningLow);
+    } else if (level >= TRIM_MEMORY_RUNNING_MODERATE) {
+        thread.cacheManager().trimMemory(CacheManager::TrimMemoryMode::RunningModerate);
     }
 }
 
@@ -723,10 +815,14 @@ void CanvasContext::waitOnFences() {
 }
 
 void CanvasContext::enqueueFrameWork(std::function<void()>&& func) {
-    mFrameFences.push_back(CommonPool::async(std::move(func)));
+    mFrameFences.push_back(CommonPool::async(std::move(func), CommonPool::Priority::High));
 }
 
 int64_t CanvasContext::getFrameNumber() {
+    // The pending swap still owns the current frame number
+    if (mPendingSwap) {
+        return mPendingSwap->frameCompleteNr + 1;
+    }
     // mFrameNumber is reset to -1 when the surface changes or we swap buffers
     if (mFrameNumber == -1 && mNativeSurface.get()) {
         mFrameNumber = ANativeWindow_getNextFrameId(mNativeSurface->getNativeWindow());
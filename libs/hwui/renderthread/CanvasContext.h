@@ -122,7 +122,10 @@ public:
     void setWideGamut(bool wideGamut);
     bool makeCurrent();
     void prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t syncQueued, RenderNode* target);
-    void draw();
+    // With allowDeferredSwap the swap is left pending behind a RenderThread task, so that the
+    // sync of the next frame, if it is already queued, can run while this frame is in flight.
+    void draw(bool allowDeferredSwap = false);
+    void finishPendingSwap();
     void destroy();
 
     // IFrameCallback, Choreographer-driven frame callback entry point
@@ -211,6 +214,7 @@ private:
     bool isSwapChainStuffed();
     bool surfaceRequiresRedraw();
     void setPresentTime();
+    void updateDynamicRenderAhead(const FrameInfo& frameInfo);
 
     SkRect computeDirtyRect(const Frame& frame, SkRect* dirty);
 
@@ -233,6 +237,9 @@ private:
     bool mFixedRenderAhead = false;
     uint32_t mRenderAheadDepth = 0;
     uint32_t mRenderAheadCapacity = 0;
+    // Render ahead used when it isn't fixed, driven by how early recent frames have finished
+    uint32_t mDynamicRenderAhead = 1;
+    uint32_t mFramesWithinDeadline = 0;
     struct SwapHistory {
         SkRect damage;
         nsecs_t vsyncTime;
@@ -243,6 +250,23 @@ private:
 
     // Need at least 4 because we do quad buffer. Add a 5th for good measure.
     RingBuffer<SwapHistory, 5> mSwapHistory;
+
+    // A frame that has been drawn but not swapped yet, along with everything the
+    // swap needs that the sync of the next frame may replace
+    struct PendingSwap {
+        Frame frame;
+        SkRect windowDirty;
+        bool drew;
+        int64_t frameCompleteNr;
+        nsecs_t vsyncTime;
+        FrameInfo* frameInfo;
+        std::pair<FrameInfo*, int64_t>* frameInfoEntry;
+        std::vector<std::function<void(int64_t)>> frameCompleteCallbacks;
+        std::pair<FrameInfo*, int64_t> fourthBehind = {nullptr, -1};
+    };
+    void swapAndFinishFrame(PendingSwap& pendingSwap);
+    std::unique_ptr<PendingSwap> mPendingSwap;
+
     int64_t mFrameNumber = -1;
     int64_t mDamageId = 0;
 
@@ -21,6 +21,7 @@
 
 #include "../DeferredLayerUpdater.h"
 #include "../DisplayList.h"
+#include "../Properties.h"
 #include "../RenderNode.h"
 #include "CanvasContext.h"
 #include "RenderThread.h"
@@ -114,7 +115,9 @@ void DrawFrameTask::run() {
     }
 
     if (CC_LIKELY(canDrawThisFrame)) {
-        context->draw();
+        // In pipelined mode the UI thread can be unblocked as soon as the draw commands have
+        // been issued, and the next sync may run before this frame is swapped.
+        context->draw(Properties::pipelinedDraw);
     } else {
         // wait on fences so tasks don't overlap next frame
         context->waitOnFences();
@@ -25,6 +25,7 @@
 #include "renderthread/CanvasContext.h"
 #include "renderthread/RenderTask.h"
 #include "renderthread/RenderThread.h"
+#include "utils/Color.h"
 #include "utils/Macros.h"
 #include "utils/TimeUtils.h"
 #include "utils/TraceUtils.h"
@@ -246,6 +247,15 @@ void RenderProxy::dumpGraphicsMemory(int fd) {
     }
 }
 
+void RenderProxy::getGpuMemoryStats(GpuMemoryStats* outStats) {
+    if (RenderThread::hasInstance()) {
+        auto& thread = RenderThread::getInstance();
+        thread.queue().runSync([&]() {
+            thread.cacheManager().getMemoryStats(outStats, &thread.renderState());
+        });
+    }
+}
+
 void RenderProxy::setProcessStatsBuffer(int fd) {
     auto& rt = RenderThread::getInstance();
     rt.queue().post([&rt, fd = dup(fd)]() {
@@ -361,6 +371,39 @@ int RenderProxy::copyHWBitmapInto(Bitmap* hwBitmap, SkBitmap* bitmap) {
     }
 }
 
+void RenderProxy::copySurfaceIntoBuffer(ANativeWindow* window, int left, int top, int right,
+                                        int bottom, AHardwareBuffer* buffer,
+                                        android_dataspace dataSpace,
+                                        BufferCopyCallback callback) {
+    auto& thread = RenderThread::getInstance();
+    ANativeWindow_acquire(window);
+    AHardwareBuffer_acquire(buffer);
+    thread.queue().post([&thread, window, buffer, dataSpace, callback = std::move(callback),
+                         srcRect = Rect(left, top, right, bottom)]() {
+        base::unique_fd fence;
+        CopyResult result = thread.readback().copySurfaceIntoBuffer(
+                window, srcRect, buffer, DataSpaceToColorSpace(dataSpace), &fence);
+        AHardwareBuffer_release(buffer);
+        ANativeWindow_release(window);
+        callback(static_cast<int>(result), std::move(fence));
+    });
+}
+
+void RenderProxy::copyHWBitmapIntoBuffer(Bitmap* hwBitmap, AHardwareBuffer* buffer,
+                                         android_dataspace dataSpace,
+                                         BufferCopyCallback callback) {
+    auto& thread = RenderThread::getInstance();
+    AHardwareBuffer_acquire(buffer);
+    thread.queue().post([&thread, bitmap = sk_ref_sp(hwBitmap), buffer, dataSpace,
+                         callback = std::move(callback)]() {
+        base::unique_fd fence;
+        CopyResult result = thread.readback().copyHWBitmapIntoBuffer(
+                bitmap.get(), buffer, DataSpaceToColorSpace(dataSpace), &fence);
+        AHardwareBuffer_release(buffer);
+        callback(static_cast<int>(result), std::move(fence));
+    });
+}
+
 void RenderProxy::disableVsync() {
     Properties::disableVsync = true;
 }
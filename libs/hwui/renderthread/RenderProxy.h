@@ -18,10 +18,15 @@
 #define RENDERPROXY_H_
 
 #include <SkBitmap.h>
+#include <android-base/unique_fd.h>
+#include <android/hardware_buffer.h>
 #include <android/native_window.h>
 #include <cutils/compiler.h>
+#include <system/graphics.h>
 #include <utils/Functor.h>
 
+#include <functional>
+
 #include "../FrameMetricsObserver.h"
 #include "../IContextFactory.h"
 #include "DrawFrameTask.h"
@@ -43,6 +48,7 @@ namespace renderthread {
 class CanvasContext;
 class RenderThread;
 class RenderProxyBridge;
+struct GpuMemoryStats;
 
 namespace DumpFlags {
 enum {
@@ -106,6 +112,9 @@ public:
     void resetProfileInfo();
     uint32_t frameTimePercentile(int p);
     ANDROID_API static void dumpGraphicsMemory(int fd);
+    // Fills outStats with the memory currently used by the RenderThread, see GpuMemoryStats.
+    // Does nothing if the RenderThread hasn't been started.
+    ANDROID_API static void getGpuMemoryStats(GpuMemoryStats* outStats);
 
     ANDROID_API static void rotateProcessStatsBuffer();
     ANDROID_API static void setProcessStatsBuffer(int fd);
@@ -147,6 +156,24 @@ public:
 
     static int copyHWBitmapInto(Bitmap* hwBitmap, SkBitmap* bitmap);
 
+    // Invoked on the RenderThread with a CopyResult and, on success, a fence that signals once
+    // the destination buffer has been written (or -1 if it already has).
+    typedef std::function<void(int result, base::unique_fd fence)> BufferCopyCallback;
+
+    /**
+     * Queues a GPU copy of the surface's most recently queued buffer into buffer, scaled from
+     * the given source rect to the size of buffer and converted to its format and dataSpace.
+     * Returns immediately, without waiting for the RenderThread or the GPU.
+     */
+    ANDROID_API static void copySurfaceIntoBuffer(ANativeWindow* window, int left, int top,
+                                                  int right, int bottom, AHardwareBuffer* buffer,
+                                                  android_dataspace dataSpace,
+                                                  BufferCopyCallback callback);
+
+    ANDROID_API static void copyHWBitmapIntoBuffer(Bitmap* hwBitmap, AHardwareBuffer* buffer,
+                                                   android_dataspace dataSpace,
+                                                   BufferCopyCallback callback);
+
     ANDROID_API static void disableVsync();
 
     ANDROID_API static void preload();
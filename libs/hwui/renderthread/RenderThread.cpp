@@ -24,6 +24,7 @@
 #include "RenderProxy.h"
 #include "VulkanManager.h"
 #include "hwui/Bitmap.h"
+#include "pipeline/skia/ShaderCache.h"
 #include "pipeline/skia/SkiaOpenGLPipeline.h"
 #include "pipeline/skia/SkiaVulkanPipeline.h"
 #include "renderstate/RenderState.h"
@@ -167,7 +168,7 @@ void RenderThread::initThreadLocals() {
     mEglManager = new EglManager();
     mRenderState = new RenderState(*this);
     mVkManager = new VulkanManager();
-    mCacheManager = new CacheManager();
+    mCacheManager = new CacheManager(*this);
 }
 
 void RenderThread::setupFrameInterval() {
@@ -386,6 +387,10 @@ bool RenderThread::isCurrent() {
 }
 
 void RenderThread::preload() {
+    // The shader cache is read from disk while the driver initializes, instead of after it
+    // when the first context is created.
+    std::thread shaderCacheThread([]() { skiapipeline::ShaderCache::get().preloadDiskCache(); });
+    shaderCacheThread.detach();
     // EGL driver is always preloaded only if HWUI renders with GL.
     if (Properties::getRenderPipelineType() == RenderPipelineType::SkiaGL) {
         std::thread eglInitThread([]() { eglGetDisplay(EGL_DEFAULT_DISPLAY); });
@@ -15,6 +15,8 @@
  */
 #include "TimeLord.h"
 
+#include "DeviceInfo.h"
+
 namespace android {
 namespace uirenderer {
 namespace renderthread {
@@ -40,6 +42,13 @@ nsecs_t TimeLord::computeFrameTimeNanos() {
     return mFrameTimeNanos;
 }
 
+nsecs_t TimeLord::computeLatchDeadline(nsecs_t vsync, int framesAhead) const {
+    // vsync is the app-phase vsync, so remove the app offset to get back to the hardware vsync
+    // and then move to the compositor phase of the refresh the frame is aimed at
+    return vsync - DeviceInfo::getAppOffset() + (mFrameIntervalNanos * (framesAhead + 1)) +
+           DeviceInfo::getCompositorOffset();
+}
+
 } /* namespace renderthread */
 } /* namespace uirenderer */
 } /* namespace android */
@@ -36,6 +36,10 @@ public:
     nsecs_t latestVsync() { return mFrameTimeNanos; }
     nsecs_t computeFrameTimeNanos();
 
+    // Returns the time by which a frame started at the given vsync must have finished rendering
+    // for the compositor to latch it framesAhead frames after the earliest possible refresh.
+    nsecs_t computeLatchDeadline(nsecs_t vsync, int framesAhead) const;
+
 private:
     friend class RenderThread;
 
@@ -349,6 +349,13 @@ void VulkanSurface::releaseBuffers() {
     }
 }
 
+void VulkanSurface::invalidateBufferContents() {
+    for (uint32_t i = 0; i < mWindowInfo.bufferCount; i++) {
+        mNativeBuffers[i].hasValidContents = false;
+        mNativeBuffers[i].lastPresentedCount = 0;
+    }
+}
+
 VulkanSurface::NativeBufferInfo* VulkanSurface::dequeueNativeBuffer() {
     // Set the mCurrentBufferInfo to invalid in case of error and only reset it to the correct
     // value at the end of the function if everything dequeued correctly.
@@ -389,6 +396,10 @@ VulkanSurface::NativeBufferInfo* VulkanSurface::dequeueNativeBuffer() {
                 return nullptr;
             }
             mWindowInfo.transform = transformHint;
+
+            // The retained buffers were rendered with the previous pre-rotation, so their
+            // contents can't be used for a partial update. Force a full redraw of each of them.
+            invalidateBufferContents();
         }
 
         mWindowInfo.size = actualSize;
@@ -439,18 +450,22 @@ VulkanSurface::NativeBufferInfo* VulkanSurface::dequeueNativeBuffer() {
 bool VulkanSurface::presentCurrentBuffer(const SkRect& dirtyRect, int semaphoreFd) {
     if (!dirtyRect.isEmpty()) {
 
-        // native_window_set_surface_damage takes a rectangle in prerotated space
-        // with a bottom-left origin. That is, top > bottom.
-        // The dirtyRect is also in prerotated space, so we just need to switch it to
-        // a bottom-left origin space.
-
+        // native_window_set_surface_damage takes a rectangle in buffer space with a bottom-left
+        // origin. That is, top > bottom. The dirtyRect is in logical (unrotated) space, so map it
+        // through the current pre-rotation before flipping it to a bottom-left origin. Otherwise
+        // the compositor would be told about the wrong region whenever the buffers are rotated.
+        SkRect bufferDirty = mWindowInfo.preTransform.mapRect(dirtyRect);
         SkIRect irect;
-        dirtyRect.roundOut(&irect);
+        bufferDirty.roundOut(&irect);
+        if (!irect.intersect(SkIRect::MakeSize(mWindowInfo.actualSize))) {
+            irect.setEmpty();
+        }
+        const int bufferHeight = mWindowInfo.actualSize.height();
         android_native_rect_t aRect;
         aRect.left = irect.left();
-        aRect.top = logicalHeight() - irect.top();
+        aRect.top = bufferHeight - irect.top();
         aRect.right = irect.right();
-        aRect.bottom = logicalHeight() - irect.bottom();
+        aRect.bottom = bufferHeight - irect.bottom();
 
         int err = native_window_set_surface_damage(mNativeWindow.get(), &aRect, 1);
         ALOGE_IF(err != 0, "native_window_set_surface_damage failed: %s (%d)", strerror(-err), err);
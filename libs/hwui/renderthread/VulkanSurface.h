@@ -110,6 +110,8 @@ private:
                                            WindowInfo* outWindowInfo);
     static bool UpdateWindow(ANativeWindow* window, const WindowInfo& windowInfo);
     void releaseBuffers();
+    // Marks every retained buffer as having undefined contents so its age is reported as 0.
+    void invalidateBufferContents();
 
     // TODO: Just use a vector?
     NativeBufferInfo mNativeBuffers[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
@@ -18,14 +18,20 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <inttypes.h>
 #include <log/log.h>
+#include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <memory>
+#include <utility>
+
 #include <android/util/ProtoOutputStream.h>
 #include <stats_event.h>
 #include <statslog.h>
@@ -341,32 +347,40 @@ void GraphicsStatsService::saveBuffer(const std::string& path, const std::string
               statsProto.has_summary());
         return;
     }
-    int outFd = open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0660);
-    if (outFd <= 0) {
-        int err = errno;
-        ALOGW("Failed to open '%s', error=%d (%s)", path.c_str(), err, strerror(err));
+    size_t protoSize = statsProto.ByteSizeLong();
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[sHeaderSize + protoSize]);
+    memcpy(buffer.get(), &sCurrentFileVersion, sHeaderSize);
+    if (!statsProto.SerializeToArray(buffer.get() + sHeaderSize, protoSize)) {
+        ALOGW("Serialize failed on '%s' unknown error", path.c_str());
         return;
     }
-    int wrote = write(outFd, &sCurrentFileVersion, sHeaderSize);
-    if (wrote != sHeaderSize) {
+    // The merged stats go to a new file that replaces the old one in a single rename, so a
+    // reader or a crash never sees a partly written file.
+    std::string tmpPath = path + ".tmp";
+    FileDescriptor fd{open(tmpPath.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0660)};
+    if (!fd.valid()) {
         int err = errno;
-        ALOGW("Failed to write header to '%s', returned=%d errno=%d (%s)", path.c_str(), wrote, err,
-              strerror(err));
-        close(outFd);
+        ALOGW("Failed to open '%s', error=%d (%s)", tmpPath.c_str(), err, strerror(err));
         return;
     }
-    {
-        FileOutputStreamLite output(outFd);
-        bool success = statsProto.SerializeToZeroCopyStream(&output) && output.Flush();
-        if (output.GetErrno() != 0) {
-            ALOGW("Error writing to fd=%d, path='%s' err=%d (%s)", outFd, path.c_str(),
-                  output.GetErrno(), strerror(output.GetErrno()));
-            success = false;
-        } else if (!success) {
-            ALOGW("Serialize failed on '%s' unknown error", path.c_str());
+    size_t fileSize = sHeaderSize + protoSize;
+    for (size_t written = 0; written < fileSize;) {
+        ssize_t ret = TEMP_FAILURE_RETRY(write(fd, buffer.get() + written, fileSize - written));
+        if (ret <= 0) {
+            int err = errno;
+            ALOGW("Error writing to fd=%d, path='%s' err=%d (%s)", static_cast<int>(fd),
+                  tmpPath.c_str(), err, strerror(err));
+            unlink(tmpPath.c_str());
+            return;
         }
+        written += ret;
+    }
+    if (rename(tmpPath.c_str(), path.c_str())) {
+        int err = errno;
+        ALOGW("Failed to rename '%s' to '%s', errno=%d (%s)", tmpPath.c_str(), path.c_str(), err,
+              strerror(err));
+        unlink(tmpPath.c_str());
     }
-    close(outFd);
 }
 
 class GraphicsStatsService::Dump {
@@ -379,24 +393,32 @@ public:
     int fd() { return mFd; }
     DumpType type() { return mType; }
     protos::GraphicsStatsServiceDumpProto& proto() { return mProto; }
-    void mergeStat(const protos::GraphicsStatsProto& stat);
+    void mergeStat(protos::GraphicsStatsProto&& stat);
+    void mergeStageData(const std::string& package, int64_t versionCode, const ProfileData& data);
+    const ProfileData* stageData(const protos::GraphicsStatsProto& stat) const;
     void updateProto();
+    void writeStat(const protos::GraphicsStatsProto& stat);
+    void flush();
 
 private:
     // use package name and app version for a key
     typedef std::pair<std::string, int64_t> DumpKey;
 
     std::map<DumpKey, protos::GraphicsStatsProto> mStats;
+    // The stage histograms are not part of GraphicsStatsProto, so they are only known for the
+    // packages whose live ProfileData was added to the dump.
+    std::map<DumpKey, ProfileData> mStageData;
     int mFd;
     DumpType mType;
     protos::GraphicsStatsServiceDumpProto mProto;
+    std::unique_ptr<FileOutputStreamLite> mStream;
 };
 
-void GraphicsStatsService::Dump::mergeStat(const protos::GraphicsStatsProto& stat) {
+void GraphicsStatsService::Dump::mergeStat(protos::GraphicsStatsProto&& stat) {
     auto dumpKey = std::make_pair(stat.package_name(), stat.version_code());
     auto findIt = mStats.find(dumpKey);
     if (findIt == mStats.end()) {
-        mStats[dumpKey] = stat;
+        mStats.emplace(std::move(dumpKey), std::move(stat));
     } else {
         auto summary = findIt->second.mutable_summary();
         summary->set_total_frames(summary->total_frames() + stat.summary().total_frames());
@@ -428,9 +450,42 @@ void GraphicsStatsService::Dump::mergeStat(const protos::GraphicsStatsProto& sta
     }
 }
 
+void GraphicsStatsService::Dump::mergeStageData(const std::string& package, int64_t versionCode,
+                                                const ProfileData& data) {
+    mStageData[std::make_pair(package, versionCode)].mergeWith(data);
+}
+
+const ProfileData* GraphicsStatsService::Dump::stageData(
+        const protos::GraphicsStatsProto& stat) const {
+    auto findIt = mStageData.find(std::make_pair(stat.package_name(), stat.version_code()));
+    return findIt != mStageData.end() ? &findIt->second : nullptr;
+}
+
 void GraphicsStatsService::Dump::updateProto() {
     for (auto& stat : mStats) {
-        mProto.add_stats()->CopyFrom(stat.second);
+        *mProto.add_stats() = std::move(stat.second);
+    }
+    mStats.clear();
+}
+
+// Writes |stat| out as one more entry of the GraphicsStatsServiceDumpProto.stats field, so that
+// the dump does not have to hold every package in memory until finishDump().
+void GraphicsStatsService::Dump::writeStat(const protos::GraphicsStatsProto& stat) {
+    if (!mStream) {
+        mStream = std::make_unique<FileOutputStreamLite>(mFd);
+    }
+    io::CodedOutputStream output(mStream.get());
+    internal::WireFormatLite::WriteTag(GraphicsStatsServiceDumpProto::kStatsFieldNumber,
+                                       internal::WireFormatLite::WIRETYPE_LENGTH_DELIMITED,
+                                       &output);
+    output.WriteVarint32(static_cast<uint32_t>(stat.ByteSizeLong()));
+    stat.SerializeWithCachedSizes(&output);
+}
+
+void GraphicsStatsService::Dump::flush() {
+    if (mStream && (!mStream->Flush() || mStream->GetErrno() != 0)) {
+        ALOGW("Error writing dump to fd=%d err=%d (%s)", mFd, mStream->GetErrno(),
+              strerror(mStream->GetErrno()));
     }
 }
 
@@ -455,9 +510,12 @@ void GraphicsStatsService::addToDump(Dump* dump, const std::string& path,
         return;
     }
     if (dump->type() == DumpType::ProtobufStatsd) {
-        dump->mergeStat(statsProto);
+        if (data) {
+            dump->mergeStageData(package, versionCode, *data);
+        }
+        dump->mergeStat(std::move(statsProto));
     } else if (dump->type() == DumpType::Protobuf) {
-        dump->proto().add_stats()->CopyFrom(statsProto);
+        dump->writeStat(statsProto);
     } else {
         dumpAsTextToFd(&statsProto, dump->fd());
     }
@@ -469,9 +527,9 @@ void GraphicsStatsService::addToDump(Dump* dump, const std::string& path) {
         return;
     }
     if (dump->type() == DumpType::ProtobufStatsd) {
-        dump->mergeStat(statsProto);
+        dump->mergeStat(std::move(statsProto));
     } else if (dump->type() == DumpType::Protobuf) {
-        dump->proto().add_stats()->CopyFrom(statsProto);
+        dump->writeStat(statsProto);
     } else {
         dumpAsTextToFd(&statsProto, dump->fd());
     }
@@ -479,8 +537,7 @@ void GraphicsStatsService::addToDump(Dump* dump, const std::string& path) {
 
 void GraphicsStatsService::finishDump(Dump* dump) {
     if (dump->type() == DumpType::Protobuf) {
-        FileOutputStreamLite stream(dump->fd());
-        dump->proto().SerializeToZeroCopyStream(&stream);
+        dump->flush();
     }
     delete dump;
 }
@@ -531,6 +588,72 @@ static void writeGpuHistogram(AStatsEvent* event,
     AStatsEvent_writeByteArray(event, outVector.data(), outVector.size());
 }
 
+// Field ids taken from FrameStageHistograms and FrameStageHistogram in atoms.proto
+#define STAGES_FIELD_NUMBER 1
+#define STAGE_FIELD_NUMBER 1
+#define STAGE_TIME_MILLIS_BUCKETS_FIELD_NUMBER 2
+#define STAGE_FRAME_COUNTS_FIELD_NUMBER 3
+
+void GraphicsStatsService::writeStageHistograms(const ProfileData* data,
+                                                std::vector<uint8_t>* output) {
+    util::ProtoOutputStream proto;
+    for (int i = 0; i < NUM_FRAME_STAGES; i++) {
+        FrameStage stage = static_cast<FrameStage>(i);
+        std::vector<ProfileData::HistogramEntry> buckets;
+        data->histogramStageForEach(stage, [&](ProfileData::HistogramEntry entry) {
+            if (entry.frameCount) buckets.push_back(entry);
+        });
+        if (buckets.empty()) continue;
+        uint64_t token = proto.start(android::util::FIELD_TYPE_MESSAGE |
+                                     android::util::FIELD_COUNT_REPEATED |
+                                     STAGES_FIELD_NUMBER /* field id */);
+        proto.write(android::util::FIELD_TYPE_ENUM | android::util::FIELD_COUNT_SINGLE |
+                            STAGE_FIELD_NUMBER /* field id */,
+                    i + 1 /* FrameStage enum values start after UNKNOWN */);
+        for (const auto& bucket : buckets) {
+            proto.write(android::util::FIELD_TYPE_INT32 | android::util::FIELD_COUNT_REPEATED |
+                                STAGE_TIME_MILLIS_BUCKETS_FIELD_NUMBER /* field id */,
+                        (int)bucket.renderTimeMs);
+        }
+        for (const auto& bucket : buckets) {
+            proto.write(android::util::FIELD_TYPE_INT64 | android::util::FIELD_COUNT_REPEATED |
+                                STAGE_FRAME_COUNTS_FIELD_NUMBER /* field id */,
+                        (long long)bucket.frameCount);
+        }
+        proto.end(token);
+    }
+    output->clear();
+    proto.serializeToVector(output);
+}
+
+void GraphicsStatsService::writeGraphicsStats(AStatsEvent* event,
+                                              const protos::GraphicsStatsProto& stat,
+                                              const ProfileData* stageData, bool lastFullDay) {
+    AStatsEvent_setAtomId(event, android::util::GRAPHICS_STATS);
+    AStatsEvent_writeString(event, stat.package_name().c_str());
+    AStatsEvent_writeInt64(event, (int64_t)stat.version_code());
+    AStatsEvent_writeInt64(event, (int64_t)stat.stats_start());
+    AStatsEvent_writeInt64(event, (int64_t)stat.stats_end());
+    AStatsEvent_writeInt32(event, (int32_t)stat.pipeline());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().total_frames());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().missed_vsync_count());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().high_input_latency_count());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().slow_ui_thread_count());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().slow_bitmap_upload_count());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().slow_draw_count());
+    AStatsEvent_writeInt32(event, (int32_t)stat.summary().missed_deadline_count());
+    writeCpuHistogram(event, stat);
+    writeGpuHistogram(event, stat);
+    // TODO: fill in UI mainline module version, when the feature is available.
+    AStatsEvent_writeInt64(event, (int64_t)0);
+    AStatsEvent_writeBool(event, !lastFullDay);
+    std::vector<uint8_t> stageHistograms;
+    if (stageData) {
+        writeStageHistograms(stageData, &stageHistograms);
+    }
+    AStatsEvent_writeByteArray(event, stageHistograms.data(), stageHistograms.size());
+    AStatsEvent_build(event);
+}
 
 void GraphicsStatsService::finishDumpInMemory(Dump* dump, AStatsEventList* data,
                                               bool lastFullDay) {
@@ -538,26 +661,8 @@ void GraphicsStatsService::finishDumpInMemory(Dump* dump, AStatsEventList* data,
     auto& serviceDump = dump->proto();
     for (int stat_index = 0; stat_index < serviceDump.stats_size(); stat_index++) {
         auto& stat = serviceDump.stats(stat_index);
-        AStatsEvent* event = AStatsEventList_addStatsEvent(data);
-        AStatsEvent_setAtomId(event, android::util::GRAPHICS_STATS);
-        AStatsEvent_writeString(event, stat.package_name().c_str());
-        AStatsEvent_writeInt64(event, (int64_t)stat.version_code());
-        AStatsEvent_writeInt64(event, (int64_t)stat.stats_start());
-        AStatsEvent_writeInt64(event, (int64_t)stat.stats_end());
-        AStatsEvent_writeInt32(event, (int32_t)stat.pipeline());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().total_frames());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().missed_vsync_count());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().high_input_latency_count());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().slow_ui_thread_count());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().slow_bitmap_upload_count());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().slow_draw_count());
-        AStatsEvent_writeInt32(event, (int32_t)stat.summary().missed_deadline_count());
-        writeCpuHistogram(event, stat);
-        writeGpuHistogram(event, stat);
-        // TODO: fill in UI mainline module version, when the feature is available.
-        AStatsEvent_writeInt64(event, (int64_t)0);
-        AStatsEvent_writeBool(event, !lastFullDay);
-        AStatsEvent_build(event);
+        writeGraphicsStats(AStatsEventList_addStatsEvent(data), stat, dump->stageData(stat),
+                           lastFullDay);
     }
     delete dump;
 }
@@ -17,9 +17,11 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "JankTracker.h"
 #include "utils/Macros.h"
+#include <stats_event.h>
 #include <stats_pull_atom_callback.h>
 
 namespace android {
@@ -57,8 +59,17 @@ public:
     ANDROID_API static void finishDumpInMemory(Dump* dump, AStatsEventList* data,
                                                bool lastFullDay);
 
+    // Serializes the per-stage duration histograms of |data| into |output| as a
+    // FrameStageHistograms message (see atoms.proto). Empty buckets are left out.
+    ANDROID_API static void writeStageHistograms(const ProfileData* data,
+                                                 std::vector<uint8_t>* output);
+
     // Visible for testing
     static bool parseFromFile(const std::string& path, protos::GraphicsStatsProto* output);
+    // Visible for testing. Fills in and builds the GRAPHICS_STATS atom of |stat|. The stage
+    // histograms of |stageData| are written when it is known, and left empty otherwise.
+    static void writeGraphicsStats(AStatsEvent* event, const protos::GraphicsStatsProto& stat,
+                                   const ProfileData* stageData, bool lastFullDay);
 };
 
 } /* namespace uirenderer */
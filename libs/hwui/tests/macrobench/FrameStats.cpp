@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tests/macrobench/FrameStats.h"
+
+#include "FrameInfo.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <utility>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+static double stageMs(const int64_t* buffer, FrameInfoIndex start, FrameInfoIndex end) {
+    return (buffer[static_cast<int>(end)] - buffer[static_cast<int>(start)]) / 1000000.0;
+}
+
+void FrameStatsCollector::notify(const int64_t* buffer) {
+    if (buffer[static_cast<int>(FrameInfoIndex::Flags)] & FrameInfoFlags::SkippedFrame) {
+        return;
+    }
+    FrameStageTimes frame;
+    frame.total = stageMs(buffer, FrameInfoIndex::IntendedVsync, FrameInfoIndex::FrameCompleted);
+    frame.sync = stageMs(buffer, FrameInfoIndex::SyncStart, FrameInfoIndex::IssueDrawCommandsStart);
+    frame.draw =
+            stageMs(buffer, FrameInfoIndex::IssueDrawCommandsStart, FrameInfoIndex::SwapBuffers);
+    frame.swap = stageMs(buffer, FrameInfoIndex::SwapBuffers, FrameInfoIndex::FrameCompleted);
+    frame.dequeueBuffer =
+            buffer[static_cast<int>(FrameInfoIndex::DequeueBufferDuration)] / 1000000.0;
+    frame.queueBuffer = buffer[static_cast<int>(FrameInfoIndex::QueueBufferDuration)] / 1000000.0;
+
+    std::lock_guard lock(mLock);
+    mFrames.push_back(frame);
+}
+
+std::vector<FrameStageTimes> FrameStatsCollector::takeFrames() {
+    std::lock_guard lock(mLock);
+    return std::move(mFrames);
+}
+
+struct SceneSummary {
+    int count = 0;
+    double mean = 0;
+    double stddev = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p95 = 0;
+    double p99 = 0;
+};
+
+static SceneSummary summarize(const std::vector<FrameStageTimes>& frames) {
+    SceneSummary summary;
+    summary.count = frames.size();
+    if (frames.empty()) {
+        return summary;
+    }
+
+    std::vector<double> totals;
+    for (const FrameStageTimes& frame : frames) {
+        totals.push_back(frame.total);
+        summary.mean += frame.total;
+    }
+    summary.mean /= totals.size();
+    for (double total : totals) {
+        summary.stddev += (total - summary.mean) * (total - summary.mean);
+    }
+    summary.stddev = totals.size() > 1 ? sqrt(summary.stddev / (totals.size() - 1)) : 0;
+
+    std::sort(totals.begin(), totals.end());
+    auto percentile = [&totals](int p) { return totals[(totals.size() - 1) * p / 100]; };
+    summary.p50 = percentile(50);
+    summary.p90 = percentile(90);
+    summary.p95 = percentile(95);
+    summary.p99 = percentile(99);
+    return summary;
+}
+
+bool appendFrameStats(const char* path, const std::string& scene, const std::string& pipeline,
+                      const std::vector<FrameStageTimes>& frames, size_t nativeHeapBytes) {
+    FILE* file = fopen(path, "ae");
+    if (!file) {
+        fprintf(stderr, "Failed to open '%s' for frame stats: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    const SceneSummary summary = summarize(frames);
+    fprintf(file,
+            "{\"scene\": \"%s\", \"pipeline\": \"%s\", \"frames\": %d, \"mean_ms\": %.4f, "
+            "\"stddev_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p95_ms\": %.4f, "
+            "\"p99_ms\": %.4f, \"native_heap_bytes\": %zu, \"frame_stages\": [",
+            scene.c_str(), pipeline.c_str(), summary.count, summary.mean, summary.stddev,
+            summary.p50, summary.p90, summary.p95, summary.p99, nativeHeapBytes);
+    for (size_t i = 0; i < frames.size(); i++) {
+        const FrameStageTimes& frame = frames[i];
+        fprintf(file,
+                "%s{\"total\": %.4f, \"sync\": %.4f, \"draw\": %.4f, \"swap\": %.4f, "
+                "\"dequeue_buffer\": %.4f, \"queue_buffer\": %.4f}",
+                i ? ", " : "", frame.total, frame.sync, frame.draw, frame.swap,
+                frame.dequeueBuffer, frame.queueBuffer);
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+    return true;
+}
+
+// Finds "key": <value> in a line written by appendFrameStats(). The summary keys precede the
+// per-frame stages and do not collide with their names.
+static const char* findValue(const std::string& line, const char* key) {
+    const std::string quoted = std::string("\"") + key + "\": ";
+    size_t pos = line.find(quoted);
+    return pos == std::string::npos ? nullptr : line.c_str() + pos + quoted.size();
+}
+
+static bool readFrameStats(const char* path,
+                           std::map<std::pair<std::string, std::string>, SceneSummary>* out) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Failed to open frame stats '%s'\n", path);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        const char* scene = findValue(line, "scene");
+        const char* pipeline = findValue(line, "pipeline");
+        const char* keys[] = {"frames", "mean_ms", "stddev_ms", "p90_ms"};
+        double values[4];
+        const char* sceneEnd = scene && *scene == '"' ? strchr(scene + 1, '"') : nullptr;
+        const char* pipelineEnd =
+                pipeline && *pipeline == '"' ? strchr(pipeline + 1, '"') : nullptr;
+        bool valid = sceneEnd && pipelineEnd;
+        for (int i = 0; valid && i < 4; i++) {
+            const char* value = findValue(line, keys[i]);
+            valid = value != nullptr;
+            if (valid) {
+                values[i] = strtod(value, nullptr);
+            }
+        }
+        if (!valid) {
+            fprintf(stderr, "Skipping malformed frame stats line in '%s'\n", path);
+            continue;
+        }
+
+        SceneSummary& summary = (*out)[{std::string(scene + 1, sceneEnd),
+                                        std::string(pipeline + 1, pipelineEnd)}];
+        summary.count = values[0];
+        summary.mean = values[1];
+        summary.stddev = values[2];
+        summary.p90 = values[3];
+    }
+    return true;
+}
+
+int compareFrameStats(const char* baselinePath, const char* currentPath, double thresholdPercent) {
+    std::map<std::pair<std::string, std::string>, SceneSummary> baseline;
+    std::map<std::pair<std::string, std::string>, SceneSummary> current;
+    if (!readFrameStats(baselinePath, &baseline) || !readFrameStats(currentPath, &current)) {
+        return -1;
+    }
+
+    int regressions = 0;
+    for (const auto& [key, now] : current) {
+        auto it = baseline.find(key);
+        if (it == baseline.end()) {
+            printf("%s [%s]: no baseline\n", key.first.c_str(), key.second.c_str());
+            continue;
+        }
+        const SceneSummary& before = it->second;
+        if (now.count == 0 || before.count == 0) {
+            continue;
+        }
+
+        const double p90Change = before.p90 > 0 ? (now.p90 - before.p90) * 100 / before.p90 : 0;
+        const double standardError = sqrt(now.stddev * now.stddev / now.count +
+                                          before.stddev * before.stddev / before.count);
+        const bool significant = now.mean - before.mean > 2 * standardError;
+        const bool regressed = p90Change > thresholdPercent && significant;
+        printf("%s [%s]: p90 %.3fms -> %.3fms (%+.1f%%), mean %.3fms -> %.3fms%s\n",
+               key.first.c_str(), key.second.c_str(), before.p90, now.p90, p90Change,
+               before.mean, now.mean, regressed ? "  REGRESSION" : "");
+        if (regressed) {
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+}  // namespace test
+}  // namespace uirenderer
+}  // namespace android
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FrameMetricsObserver.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+// Stage timings of a single frame, in milliseconds.
+struct FrameStageTimes {
+    double total;
+    double sync;
+    double draw;
+    double swap;
+    double dequeueBuffer;
+    double queueBuffer;
+};
+
+// Collects the stage timings of every drawn frame. notify() is called on the RenderThread.
+class FrameStatsCollector : public FrameMetricsObserver {
+public:
+    void notify(const int64_t* buffer) override;
+
+    std::vector<FrameStageTimes> takeFrames();
+
+private:
+    std::mutex mLock;
+    std::vector<FrameStageTimes> mFrames;
+};
+
+// Appends one JSON object for the run of a scene as a single line of path, so that runs from
+// several processes (one per pipeline) can share one file.
+bool appendFrameStats(const char* path, const std::string& scene, const std::string& pipeline,
+                      const std::vector<FrameStageTimes>& frames, size_t nativeHeapBytes);
+
+// Compares every scene in currentPath against the same scene and pipeline in baselinePath, both
+// written by appendFrameStats(). A scene regresses if its 90th percentile frame time grew by more
+// than thresholdPercent and its mean frame time grew by more than twice the standard error of
+// the difference. Prints a line per scene and returns the number of regressions, or -1 if either
+// file could not be read.
+int compareFrameStats(const char* baselinePath, const char* currentPath, double thresholdPercent);
+
+}  // namespace test
+}  // namespace uirenderer
+}  // namespace android
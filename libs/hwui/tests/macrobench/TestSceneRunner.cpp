@@ -21,11 +21,13 @@
 #include "tests/common/TestContext.h"
 #include "tests/common/TestScene.h"
 #include "tests/common/scenes/TestSceneBase.h"
+#include "tests/macrobench/FrameStats.h"
 #include "utils/TraceUtils.h"
 
 #include <benchmark/benchmark.h>
 #include <gui/Surface.h>
 #include <log/log.h>
+#include <malloc.h>
 #include <ui/PixelFormat.h>
 
 using namespace android;
@@ -107,8 +109,19 @@ void outputBenchmarkReport(const TestScene::Info& info, const TestScene::Options
     }
 }
 
+static const char* pipelineName() {
+    switch (Properties::getRenderPipelineType()) {
+        case RenderPipelineType::SkiaGL:
+            return "skiagl";
+        case RenderPipelineType::SkiaVulkan:
+            return "skiavk";
+        default:
+            return "unknown";
+    }
+}
+
 void run(const TestScene::Info& info, const TestScene::Options& opts,
-         benchmark::BenchmarkReporter* reporter) {
+         benchmark::BenchmarkReporter* reporter, const char* frameStatsPath) {
     Properties::forceDrawFrame = true;
     TestContext testContext;
     testContext.setRenderOffscreen(opts.renderOffscreen);
@@ -157,6 +170,12 @@ void run(const TestScene::Info& info, const TestScene::Options& opts,
     }
     proxy->setRenderAheadDepth(opts.renderAhead);
 
+    sp<FrameStatsCollector> frameStats;
+    if (frameStatsPath) {
+        frameStats = new FrameStatsCollector();
+        proxy->addFrameMetricsObserver(frameStats.get());
+    }
+
     ModifiedMovingAverage<double> avgMs(opts.reportFrametimeWeight);
 
     nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
@@ -181,6 +200,12 @@ void run(const TestScene::Info& info, const TestScene::Options& opts,
     proxy->fence();
     nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC);
 
+    if (frameStats) {
+        proxy->removeFrameMetricsObserver(frameStats.get());
+        appendFrameStats(frameStatsPath, info.name, pipelineName(), frameStats->takeFrames(),
+                         mallinfo().uordblks);
+    }
+
     if (reporter) {
         outputBenchmarkReport(info, opts, reporter, proxy.get(), (end - start) / (double)s2ns(1));
     } else {
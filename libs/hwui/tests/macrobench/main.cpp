@@ -16,6 +16,7 @@
 
 #include "tests/common/LeakChecker.h"
 #include "tests/common/TestScene.h"
+#include "tests/macrobench/FrameStats.h"
 
 #include "Properties.h"
 #include "hwui/Typeface.h"
@@ -26,6 +27,7 @@
 #include <getopt.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <string>
 #include <unordered_map>
@@ -35,6 +37,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 using namespace android;
 using namespace android::uirenderer;
@@ -43,10 +46,14 @@ using namespace android::uirenderer::test;
 static int gRepeatCount = 1;
 static std::vector<TestScene::Info> gRunTests;
 static TestScene::Options gOpts;
+static bool gRunAllRenderers = false;
+static const char* gFrameStatsPath = nullptr;
+static const char* gBaselinePath = nullptr;
+static double gRegressionThreshold = 5;
 std::unique_ptr<benchmark::BenchmarkReporter> gBenchmarkReporter;
 
 void run(const TestScene::Info& info, const TestScene::Options& opts,
-         benchmark::BenchmarkReporter* reporter);
+         benchmark::BenchmarkReporter* reporter, const char* frameStatsPath);
 
 static void printHelp() {
     printf(R"(
@@ -68,8 +75,16 @@ OPTIONS:
   --onscreen           Render tests on device screen. By default tests
                        are offscreen rendered
   --benchmark_format   Set output format. Possible values are tabular, json, csv
-  --renderer=TYPE      Sets the render pipeline to use. May be skiagl or skiavk
+  --renderer=TYPE      Sets the render pipeline to use. May be skiagl, skiavk, or all
+                       to run every test once per pipeline, each in its own process
   --render-ahead=NUM   Sets how far to render-ahead. Must be 0 (default), 1, or 2.
+  --frame-stats=FILE   Write per-frame stage timings and a summary of each test run
+                       to FILE, one JSON object per line
+  --baseline=FILE      Compare the --frame-stats results against a FILE written by an
+                       earlier run, and exit with an error if any test regressed
+  --regression-threshold=PERCENT  How much the 90th percentile frame time may grow
+                       before a statistically significant change is a regression.
+                       Default is 5
 )");
 }
 
@@ -147,7 +162,10 @@ static bool setBenchmarkFormat(const char* format) {
 }
 
 static bool setRenderer(const char* renderer) {
-    if (!strcmp(renderer, "skiagl")) {
+    if (!strcmp(renderer, "all")) {
+        // The pipeline is fixed once chosen, so each one is run in a child process.
+        gRunAllRenderers = true;
+    } else if (!strcmp(renderer, "skiagl")) {
         Properties::overrideRenderPipelineType(RenderPipelineType::SkiaGL);
     } else if (!strcmp(renderer, "skiavk")) {
         Properties::overrideRenderPipelineType(RenderPipelineType::SkiaVulkan);
@@ -172,6 +190,9 @@ enum {
     Offscreen,
     Renderer,
     RenderAhead,
+    FrameStats,
+    Baseline,
+    RegressionThreshold,
 };
 }
 
@@ -188,6 +209,9 @@ static const struct option LONG_OPTIONS[] = {
         {"offscreen", no_argument, nullptr, LongOpts::Offscreen},
         {"renderer", required_argument, nullptr, LongOpts::Renderer},
         {"render-ahead", required_argument, nullptr, LongOpts::RenderAhead},
+        {"frame-stats", required_argument, nullptr, LongOpts::FrameStats},
+        {"baseline", required_argument, nullptr, LongOpts::Baseline},
+        {"regression-threshold", required_argument, nullptr, LongOpts::RegressionThreshold},
         {0, 0, 0, 0}};
 
 static const char* SHORT_OPTIONS = "c:r:h";
@@ -296,6 +320,22 @@ void parseOptions(int argc, char* argv[]) {
                 }
                 break;
 
+            case LongOpts::FrameStats:
+                gFrameStatsPath = optarg;
+                break;
+
+            case LongOpts::Baseline:
+                gBaselinePath = optarg;
+                break;
+
+            case LongOpts::RegressionThreshold:
+                gRegressionThreshold = atof(optarg);
+                if (gRegressionThreshold < 0) {
+                    fprintf(stderr, "Invalid regression threshold '%s'\n", optarg);
+                    error = true;
+                }
+                break;
+
             case 'h':
                 printHelp();
                 exit(EXIT_SUCCESS);
@@ -310,6 +350,11 @@ void parseOptions(int argc, char* argv[]) {
         }
     }
 
+    if (gBaselinePath && !gFrameStatsPath) {
+        fprintf(stderr, "--baseline requires --frame-stats\n");
+        error = true;
+    }
+
     if (error) {
         fprintf(stderr, "Try 'hwuitest --help' for more information.\n");
         exit(EXIT_FAILURE);
@@ -334,17 +379,7 @@ void parseOptions(int argc, char* argv[]) {
     }
 }
 
-int main(int argc, char* argv[]) {
-    // set defaults
-    gOpts.count = 150;
-
-    Typeface::setRobotoTypefaceForTest();
-
-    parseOptions(argc, argv);
-    if (!gBenchmarkReporter && gOpts.renderOffscreen) {
-        gBenchmarkReporter.reset(new benchmark::ConsoleReporter());
-    }
-
+static void runTests() {
     if (gBenchmarkReporter) {
         size_t name_field_width = 10;
         for (auto&& test : gRunTests) {
@@ -360,7 +395,7 @@ int main(int argc, char* argv[]) {
 
     for (int i = 0; i < gRepeatCount; i++) {
         for (auto&& test : gRunTests) {
-            run(test, gOpts, gBenchmarkReporter.get());
+            run(test, gOpts, gBenchmarkReporter.get(), gFrameStatsPath);
         }
     }
 
@@ -372,5 +407,71 @@ int main(int argc, char* argv[]) {
     HardwareBitmapUploader::terminate();
 
     LeakChecker::checkForLeaks();
+}
+
+// Runs the tests in a child process using the given pipeline. Returns false if it failed.
+static bool runTestsInChild(const char* renderer) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        fprintf(stderr, "Failed to fork for renderer %s: %s\n", renderer, strerror(errno));
+        return false;
+    }
+    if (pid == 0) {
+        setRenderer(renderer);
+        runTests();
+        _exit(EXIT_SUCCESS);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        fprintf(stderr, "Tests with renderer %s failed\n", renderer);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // set defaults
+    gOpts.count = 150;
+
+    Typeface::setRobotoTypefaceForTest();
+
+    parseOptions(argc, argv);
+    if (gFrameStatsPath) {
+        // Runs append to the file, so that each pipeline's process can add its own.
+        FILE* file = fopen(gFrameStatsPath, "we");
+        if (!file) {
+            fprintf(stderr, "Failed to create '%s': %s\n", gFrameStatsPath, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        fclose(file);
+    }
+    if (!gBenchmarkReporter && gOpts.renderOffscreen) {
+        gBenchmarkReporter.reset(new benchmark::ConsoleReporter());
+    }
+
+    if (gRunAllRenderers) {
+        bool success = true;
+        for (const char* renderer : {"skiagl", "skiavk"}) {
+            success &= runTestsInChild(renderer);
+        }
+        if (!success) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        runTests();
+    }
+
+    if (gBaselinePath) {
+        int regressions = compareFrameStats(gBaselinePath, gFrameStatsPath, gRegressionThreshold);
+        if (regressions < 0) {
+            fprintf(stderr, "Could not compare against the baseline\n");
+            return EXIT_FAILURE;
+        } else if (regressions > 0) {
+            fprintf(stderr, "%d test(s) regressed\n", regressions);
+            return EXIT_FAILURE;
+        }
+    }
     return 0;
 }
@@ -46,3 +46,27 @@ static void BM_LinearStdAllocator_vector(benchmark::State& state) {
     }
 }
 BENCHMARK(BM_LinearStdAllocator_vector);
+
+// Simulates re-recording a large display list every frame: many small allocations spread over
+// several pages, with the allocator destroyed at the end of each iteration.
+static void recordDisplayListSized(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        LinearAllocator la;
+        for (int j = 0; j < 4000; j++) {
+            benchmark::DoNotOptimize(la.alloc<char>(48));
+        }
+    }
+}
+
+static void BM_LinearAllocator_rerecord(benchmark::State& state) {
+    recordDisplayListSized(state);
+}
+BENCHMARK(BM_LinearAllocator_rerecord);
+
+static void BM_LinearAllocator_rerecordNoPagePool(benchmark::State& state) {
+    LinearAllocator::setPagePoolHighWatermark(0);
+    LinearAllocator::trimPagePool();
+    recordDisplayListSized(state);
+    LinearAllocator::setPagePoolHighWatermark(LinearAllocator::DEFAULT_PAGE_POOL_HIGH_WATERMARK);
+}
+BENCHMARK(BM_LinearAllocator_rerecordNoPagePool);
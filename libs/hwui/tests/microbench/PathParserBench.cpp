@@ -51,3 +51,66 @@ void BM_PathParser_parseStringPathForPathData(benchmark::State& state) {
     }
 }
 BENCHMARK(BM_PathParser_parseStringPathForPathData);
+
+// Path data of commonly used system icons, covering the number formats found in real
+// resources: implicit separators, leading dots, negative signs and repeated commands.
+static const char* sIconCorpus[] = {
+        // ic_menu
+        "M3,18h18v-2H3v2zm0,-5h18v-2H3v2zm0,-7v2h18V6H3z",
+        // ic_search
+        "M15.5,14h-0.79l-0.28,-0.27C15.41,12.59 16,11.11 16,9.5 16,5.91 13.09,3 9.5,3S3,5.91 3,"
+        "9.5 5.91,16 9.5,16c1.61,0 3.09,-0.59 4.23,-1.57l0.27,0.28v0.79l5,4.99L20.49,19l-4.99,"
+        "-5zM9.5,14C7.01,14 5,11.99 5,9.5S7.01,5 9.5,5 14,7.01 14,9.5 11.99,14 9.5,14z",
+        // ic_arrow_back
+        "M20,11H7.83l5.59,-5.59L12,4l-8,8 8,8 1.41,-1.41L7.83,13H20v-2z",
+        // ic_close
+        "M19,6.41L17.59,5 12,10.59 6.41,5 5,6.41 10.59,12 5,17.59 6.41,19 12,13.41 17.59,19 19,"
+        "17.59 13.41,12z",
+        // ic_settings
+        "M19.43,12.98c.04-.32.07-.64.07-.98s-.03-.66-.07-.98l2.11-1.65c.19-.15.24-.42.12-.64l-2-"
+        "3.46c-.12-.22-.39-.3-.61-.22l-2.49,1c-.52-.4-1.08-.73-1.69-.98l-.38-2.65C14.46,2.18 "
+        "14.25,2 14,2h-4c-.25,0-.46.18-.49.42l-.38,2.65c-.61.25-1.17.59-1.69.98l-2.49-1c-.23-"
+        ".09-.49,0-.61.22l-2,3.46c-.13.22-.07.49.12.64l2.11,1.65c-.04.32-.07.65-.07.98s.03.66.07."
+        "98l-2.11,1.65c-.19.15-.24.42-.12.64l2,3.46c.12.22.39.3.61.22l2.49-1c.52.4,1.08.73,1.69."
+        "98l.38,2.65c.03.24.24.42.49.42h4c.25,0,.46-.18.49-.42l.38-2.65c.61-.25,1.17-.59,1.69-.98"
+        "l2.49,1c.23.09.49,0,.61-.22l2-3.46c.12-.22.07-.49-.12-.64l-2.11-1.65zM12,15.5c-1.93,0-"
+        "3.5-1.57-3.5-3.5s1.57-3.5,3.5-3.5 3.5,1.57 3.5,3.5-1.57,3.5-3.5,3.5z",
+        // ic_wifi
+        "M1,9l2,2c4.97,-4.97 13.03,-4.97 18,0l2,-2C16.93,2.93 7.08,2.93 1,9zM9,17l3,3 3,-3c-1."
+        "65,-1.66 -4.34,-1.66 -6,0zM5,13l2,2c2.76,-2.76 7.24,-2.76 10,0l2,-2C15.14,9.14 8.87,9."
+        "14 5,13z",
+        // ic_battery
+        "M15.67,4H14V2h-4v2H8.33C7.6,4 7,4.6 7,5.33v15.33C7,21.4 7.6,22 8.33,22h7.33c0.74,0 1.34,"
+        "-0.6 1.34,-1.33V5.33C17,4.6 16.4,4 15.67,4z",
+        // ic_check_circle
+        "M12,2C6.48,2 2,6.48 2,12s4.48,10 10,10 10,-4.48 10,-10S17.52,2 12,2zM10,17l-5,-5 1.41,"
+        "-1.41L10,14.17l7.59,-7.59L19,8l-9,9z",
+};
+
+void BM_PathParser_parseIconCorpusForSkPath(benchmark::State& state) {
+    SkPath skPath;
+    while (state.KeepRunning()) {
+        for (const char* pathString : sIconCorpus) {
+            PathParser::ParseResult result;
+            PathParser::parseAsciiStringForSkPath(&skPath, &result, pathString,
+                                                  strlen(pathString));
+            benchmark::DoNotOptimize(&result);
+            benchmark::DoNotOptimize(&skPath);
+        }
+    }
+}
+BENCHMARK(BM_PathParser_parseIconCorpusForSkPath);
+
+void BM_PathParser_parseIconCorpusForPathData(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        for (const char* pathString : sIconCorpus) {
+            PathData outData;
+            PathParser::ParseResult result;
+            PathParser::getPathDataFromAsciiString(&outData, &result, pathString,
+                                                   strlen(pathString));
+            benchmark::DoNotOptimize(&result);
+            benchmark::DoNotOptimize(&outData);
+        }
+    }
+}
+BENCHMARK(BM_PathParser_parseIconCorpusForPathData);
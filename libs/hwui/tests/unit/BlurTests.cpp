@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "utils/Blur.h"
+
+#include <vector>
+
+using namespace android::uirenderer;
+
+static std::vector<uint8_t> transpose(const std::vector<uint8_t>& image, int32_t width,
+                                      int32_t height) {
+    std::vector<uint8_t> result(image.size());
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            result[x * height + y] = image[y * width + x];
+        }
+    }
+    return result;
+}
+
+TEST(Blur, verticalMatchesTransposedHorizontal) {
+    // Large enough to be split into tiles, and not square so rows and columns differ.
+    const int32_t width = 320;
+    const int32_t height = 410;
+    const int32_t radius = 12;
+    std::vector<uint8_t> source(width * height);
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = (i * 37 + (i / width) * 11) & 0xFF;
+    }
+    std::vector<float> weights(2 * radius + 1);
+    Blur::generateGaussianWeights(weights.data(), radius);
+
+    std::vector<uint8_t> vertical(source.size());
+    Blur::vertical(weights.data(), radius, source.data(), vertical.data(), width, height);
+
+    std::vector<uint8_t> transposed = transpose(source, width, height);
+    std::vector<uint8_t> horizontal(source.size());
+    Blur::horizontal(weights.data(), radius, transposed.data(), horizontal.data(), height, width);
+
+    EXPECT_EQ(transpose(horizontal, height, width), vertical);
+}
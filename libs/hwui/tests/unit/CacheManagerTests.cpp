@@ -83,3 +83,59 @@ RENDERTHREAD_SKIA_PIPELINE_TEST(CacheManager, trimMemory) {
     renderThread.cacheManager().trimMemory(CacheManager::TrimMemoryMode::Complete);
     ASSERT_TRUE(0 == grContext->getResourceCachePurgeableBytes());
 }
+
+RENDERTHREAD_SKIA_PIPELINE_TEST(CacheManager, memoryPressureBudget) {
+    GrContext* grContext = renderThread.getGrContext();
+    ASSERT_TRUE(grContext != nullptr);
+    CacheManager& cacheManager = renderThread.cacheManager();
+
+    cacheManager.setMemoryPressure(0);
+    ASSERT_EQ(cacheManager.getCacheSize(), cacheManager.getResourceBudget());
+    ASSERT_EQ(cacheManager.getCacheSize(), grContext->getResourceCacheLimit());
+
+    // the budget shrinks continuously down to the background size
+    cacheManager.setMemoryPressure(0.5f);
+    ASSERT_GT(cacheManager.getCacheSize(), cacheManager.getResourceBudget());
+    ASSERT_LT(cacheManager.getBackgroundCacheSize(), cacheManager.getResourceBudget());
+    ASSERT_EQ(cacheManager.getResourceBudget(), grContext->getResourceCacheLimit());
+
+    cacheManager.setMemoryPressure(1.0f);
+    ASSERT_EQ(cacheManager.getBackgroundCacheSize(), cacheManager.getResourceBudget());
+
+    // UI hidden keeps the reduced budget in place
+    cacheManager.trimMemory(CacheManager::TrimMemoryMode::UiHidden);
+    ASSERT_EQ(cacheManager.getResourceBudget(), grContext->getResourceCacheLimit());
+
+    // and the full budget comes back once the pressure is gone
+    cacheManager.setMemoryPressure(0);
+    ASSERT_EQ(cacheManager.getCacheSize(), cacheManager.getResourceBudget());
+    ASSERT_EQ(cacheManager.getCacheSize(), grContext->getResourceCacheLimit());
+}
+
+RENDERTHREAD_SKIA_PIPELINE_TEST(CacheManager, getMemoryStats) {
+    GrContext* grContext = renderThread.getGrContext();
+    ASSERT_TRUE(grContext != nullptr);
+    CacheManager& cacheManager = renderThread.cacheManager();
+
+    auto node = TestUtils::createNode(0, 0, 64, 32, nullptr);
+    node->setName("layerNode");
+    SkImageInfo info = SkImageInfo::MakeN32Premul(64, 32);
+    node->setLayerSurface(SkSurface::MakeRenderTarget(grContext, SkBudgeted::kYes, info));
+    ASSERT_TRUE(node->hasLayer());
+
+    GpuMemoryStats stats;
+    cacheManager.getMemoryStats(&stats);
+    ASSERT_EQ(1u, stats.layers.size());
+    EXPECT_EQ(node->uniqueId(), stats.layers[0].renderNodeId);
+    EXPECT_EQ("layerNode", stats.layers[0].renderNodeName);
+    EXPECT_EQ(64u * 32u * 4u, stats.layers[0].bytes);
+    EXPECT_EQ(stats.layers[0].bytes, stats.layerBytes);
+    EXPECT_LE(stats.layerBytes, stats.totalBytes);
+    EXPECT_LE(stats.purgeableBytes, stats.totalBytes);
+
+    // detaching the layer drops it from the attribution
+    node->setLayerSurface(nullptr);
+    cacheManager.getMemoryStats(&stats);
+    EXPECT_TRUE(stats.layers.empty());
+    EXPECT_EQ(0u, stats.layerBytes);
+}
@@ -50,7 +50,7 @@ TEST(DISABLED_CommonPool, threadCount) {
     for (auto& f : futures) {
         threads.insert(f.get());
     }
-    EXPECT_EQ(threads.size(), CommonPool::THREAD_COUNT);
+    EXPECT_EQ(threads.size(), CommonPool::threadCount());
     EXPECT_EQ(0, threads.count(gettid()));
 }
 
@@ -101,7 +101,8 @@ TEST(DISABLED_CommonPool, fullQueue) {
     std::mutex lock;
     std::condition_variable fence;
     bool signaled = false;
-    static constexpr auto QUEUE_COUNT = CommonPool::THREAD_COUNT + CommonPool::QUEUE_SIZE + 10;
+    static constexpr auto QUEUE_COUNT =
+            CommonPool::MAX_THREAD_COUNT * (CommonPool::QUEUE_SIZE + 1) + 10;
     std::atomic_int queuedCount{0};
     std::array<std::future<void>, QUEUE_COUNT> futures;
 
@@ -123,7 +124,7 @@ TEST(DISABLED_CommonPool, fullQueue) {
         usleep(10000);
     } while (previous != queuedCount.load());
 
-    EXPECT_GT(queuedCount.load(), CommonPool::QUEUE_SIZE);
+    EXPECT_GT(queuedCount.load(), CommonPool::threadCount() * (CommonPool::QUEUE_SIZE - 1));
     EXPECT_LT(queuedCount.load(), QUEUE_COUNT);
 
     {
@@ -141,6 +142,37 @@ TEST(DISABLED_CommonPool, fullQueue) {
     }
 }
 
+TEST(CommonPool, threadCountInRange) {
+    EXPECT_LE(CommonPool::MIN_THREAD_COUNT, CommonPool::threadCount());
+    EXPECT_GE(CommonPool::MAX_THREAD_COUNT, CommonPool::threadCount());
+    EXPECT_FALSE(CommonPool::isWorkerThread());
+    EXPECT_TRUE(CommonPool::runSync([] { return CommonPool::isWorkerThread(); }));
+}
+
+TEST(CommonPool, postFromWorkerWhenFull) {
+    // Posting more tasks than fit in the queues from a worker must neither block nor abort.
+    static constexpr auto TASK_COUNT =
+            CommonPool::MAX_THREAD_COUNT * CommonPool::QUEUE_SIZE * 2;
+    std::atomic_int ranCount{0};
+    CommonPool::async([&ranCount] {
+        for (int i = 0; i < TASK_COUNT; i++) {
+            CommonPool::post([&ranCount] { ranCount++; }, CommonPool::Priority::Low);
+        }
+    }).get();
+    for (int i = 0; ranCount < TASK_COUNT && i < 1000; i++) {
+        usleep(1000);
+    }
+    EXPECT_EQ(TASK_COUNT, ranCount.load());
+    CommonPool::waitForIdle();
+}
+
+TEST(CommonPool, asyncWithPriority) {
+    auto high = CommonPool::async([] { return 1; }, CommonPool::Priority::High);
+    auto low = CommonPool::async([] { return 2; }, CommonPool::Priority::Low);
+    EXPECT_EQ(1, high.get());
+    EXPECT_EQ(2, low.get());
+}
+
 class ObjectTracker {
     static std::atomic_int sGlobalCount;
 
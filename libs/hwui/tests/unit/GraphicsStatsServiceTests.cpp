@@ -18,13 +18,17 @@
 
 #include "protos/graphicsstats.pb.h"
 #include "service/GraphicsStatsService.h"
+#include "utils/TimeUtils.h"
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 using namespace android;
 using namespace android::uirenderer;
 
@@ -160,3 +164,112 @@ TEST(GraphicsStats, merge) {
         EXPECT_EQ(expectedBucket, loadedProto.histogram().Get(i).render_millis());
     }
 }
+
+TEST(GraphicsStats, protobufDump) {
+    std::string path = findRootPath() + "/test_protobufDump";
+    std::string dumpPath = findRootPath() + "/test_protobufDump.out";
+    MockProfileData mockData;
+    mockData.editJankFrameCount() = 20;
+    mockData.editTotalFrameCount() = 100;
+    GraphicsStatsService::saveBuffer(path, "com.test.dump", 5, 3000, 7000, &mockData);
+
+    int outFd = open(dumpPath.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0660);
+    ASSERT_NE(-1, outFd);
+    auto dump = GraphicsStatsService::createDump(outFd, GraphicsStatsService::DumpType::Protobuf);
+    GraphicsStatsService::addToDump(dump, path);
+    GraphicsStatsService::addToDump(dump, "", "com.test.dump.live", 6, 8000, 9000, &mockData);
+    GraphicsStatsService::finishDump(dump);
+
+    std::string serialized;
+    char buffer[4096];
+    ssize_t r;
+    lseek(outFd, 0, SEEK_SET);
+    while ((r = read(outFd, buffer, sizeof(buffer))) > 0) {
+        serialized.append(buffer, r);
+    }
+    close(outFd);
+    protos::GraphicsStatsServiceDumpProto dumpProto;
+    EXPECT_TRUE(dumpProto.ParseFromString(serialized));
+    // Clean up the files
+    unlink(path.c_str());
+    unlink(dumpPath.c_str());
+
+    ASSERT_EQ(2, dumpProto.stats_size());
+    EXPECT_EQ("com.test.dump", dumpProto.stats(0).package_name());
+    EXPECT_EQ(3000, dumpProto.stats(0).stats_start());
+    EXPECT_EQ(100, dumpProto.stats(0).summary().total_frames());
+    EXPECT_EQ("com.test.dump.live", dumpProto.stats(1).package_name());
+    EXPECT_EQ(6, dumpProto.stats(1).version_code());
+    EXPECT_EQ(20, dumpProto.stats(1).summary().janky_frames());
+}
+
+TEST(GraphicsStats, stageHistograms) {
+    MockProfileData mockData;
+    std::vector<uint8_t> output;
+    GraphicsStatsService::writeStageHistograms(&mockData, &output);
+    EXPECT_TRUE(output.empty());
+
+    for (int i = 0; i < 90; i++) {
+        mockData.reportStage(kStageSync, 3_ms);
+    }
+    for (int i = 0; i < 10; i++) {
+        mockData.reportStage(kStageSync, 40_ms);
+    }
+    EXPECT_EQ(4u, mockData.findStagePercentile(kStageSync, 50));
+    EXPECT_EQ(44u, mockData.findStagePercentile(kStageSync, 95));
+    EXPECT_EQ(0u, mockData.findStagePercentile(kStageInput, 50));
+    EXPECT_EQ(90u, mockData.editStageFrameCounts(kStageSync)[3]);
+
+    mockData.reportStage(kStageSwap, 10_s);
+    EXPECT_EQ(1u, mockData.editStageFrameCounts(kStageSwap).back());
+
+    mockData.reportStage(kStageInputLatency, 30_ms);
+    EXPECT_EQ(32u, mockData.findStagePercentile(kStageInputLatency, 50));
+
+    MockProfileData mergedData;
+    mergedData.mergeWith(mockData);
+    mergedData.mergeWith(mockData);
+    EXPECT_EQ(180u, mergedData.editStageFrameCounts(kStageSync)[3]);
+    EXPECT_EQ(44u, mergedData.findStagePercentile(kStageSync, 95));
+
+    GraphicsStatsService::writeStageHistograms(&mockData, &output);
+    EXPECT_FALSE(output.empty());
+    mockData.reset();
+    GraphicsStatsService::writeStageHistograms(&mockData, &output);
+    EXPECT_TRUE(output.empty());
+}
+
+TEST(GraphicsStats, pulledStageHistograms) {
+    protos::GraphicsStatsProto stat;
+    stat.set_package_name("com.test.pull");
+    stat.set_version_code(5);
+    MockProfileData mockData;
+    for (int i = 0; i < 10; i++) {
+        mockData.reportStage(kStageSync, 3_ms);
+    }
+    std::vector<uint8_t> expected;
+    GraphicsStatsService::writeStageHistograms(&mockData, &expected);
+    ASSERT_FALSE(expected.empty());
+
+    // The stage histograms are the last field of the atom, written as a length-prefixed byte
+    // array.
+    AStatsEvent* event = AStatsEvent_obtain();
+    GraphicsStatsService::writeGraphicsStats(event, stat, &mockData, false);
+    size_t size = 0;
+    const uint8_t* buffer = AStatsEvent_getBuffer(event, &size);
+    int32_t length = 0;
+    ASSERT_GE(size, expected.size() + sizeof(length));
+    memcpy(&length, buffer + size - expected.size() - sizeof(length), sizeof(length));
+    EXPECT_EQ(static_cast<int32_t>(expected.size()), length);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), buffer + size - expected.size()));
+    AStatsEvent_release(event);
+
+    // Packages that were not running have no stage data to report.
+    event = AStatsEvent_obtain();
+    GraphicsStatsService::writeGraphicsStats(event, stat, nullptr, false);
+    buffer = AStatsEvent_getBuffer(event, &size);
+    ASSERT_GE(size, sizeof(length));
+    memcpy(&length, buffer + size - sizeof(length), sizeof(length));
+    EXPECT_EQ(0, length);
+    AStatsEvent_release(event);
+}
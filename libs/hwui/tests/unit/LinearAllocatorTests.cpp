@@ -86,6 +86,32 @@ TEST(LinearAllocator, rewind) {
     EXPECT_EQ(1, destroyed);
 }
 
+TEST(LinearAllocator, pagePool) {
+    LinearAllocator::trimPagePool();
+    EXPECT_EQ(0u, LinearAllocator::pagePoolSize());
+    void* firstAlloc;
+    {
+        LinearAllocator la;
+        firstAlloc = la.alloc<char>(64);
+    }
+    EXPECT_LT(0u, LinearAllocator::pagePoolSize());
+    {
+        // The next allocator reuses the released page
+        LinearAllocator la;
+        EXPECT_EQ(firstAlloc, la.alloc<char>(64));
+        EXPECT_EQ(0u, LinearAllocator::pagePoolSize());
+    }
+
+    LinearAllocator::setPagePoolHighWatermark(0);
+    LinearAllocator::trimPagePool();
+    {
+        LinearAllocator la;
+        la.alloc<char>(64);
+    }
+    EXPECT_EQ(0u, LinearAllocator::pagePoolSize());
+    LinearAllocator::setPagePoolHighWatermark(LinearAllocator::DEFAULT_PAGE_POOL_HIGH_WATERMARK);
+}
+
 TEST(LinearStdAllocator, simpleAllocate) {
     LinearAllocator la;
     LinearStdAllocator<void*> stdAllocator(la);
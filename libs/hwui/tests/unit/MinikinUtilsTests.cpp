@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "hwui/MinikinUtils.h"
+#include "hwui/Paint.h"
+
+#include <string>
+#include <vector>
+
+using namespace android;
+
+TEST(MinikinUtils, layoutCacheSharedBetweenMeasureAndDraw) {
+    MinikinUtils::purgeLayoutCache();
+    const std::u16string text = u"Hello world";
+    const uint16_t* buf = reinterpret_cast<const uint16_t*>(text.data());
+    const size_t size = text.size();
+    Paint paint;
+    paint.getSkFont().setSize(20);
+
+    std::vector<float> advances(size);
+    const float width = MinikinUtils::measureText(&paint, minikin::Bidi::LTR, nullptr, buf, 0,
+                                                  size, size, advances.data());
+
+    auto layout = MinikinUtils::doLayoutCached(&paint, minikin::Bidi::LTR, nullptr, buf, size, 0,
+                                               size, 0, size);
+    EXPECT_EQ(width, layout->getAdvance());
+    for (size_t i = 0; i < size; i++) {
+        EXPECT_EQ(advances[i], layout->getCharAdvance(i));
+    }
+    EXPECT_EQ(layout.get(), MinikinUtils::doLayoutCached(&paint, minikin::Bidi::LTR, nullptr, buf,
+                                                         size, 0, size, 0, size)
+                                    .get());
+
+    // A different paint must not hit the same entry.
+    paint.getSkFont().setSize(30);
+    auto largerLayout = MinikinUtils::doLayoutCached(&paint, minikin::Bidi::LTR, nullptr, buf,
+                                                     size, 0, size, 0, size);
+    EXPECT_NE(layout.get(), largerLayout.get());
+    EXPECT_GT(largerLayout->getAdvance(), layout->getAdvance());
+
+    MinikinUtils::purgeLayoutCache();
+    EXPECT_NE(layout.get(), MinikinUtils::doLayoutCached(&paint, minikin::Bidi::LTR, nullptr, buf,
+                                                         size, 0, size, 0, size)
+                                    .get());
+}
@@ -86,5 +86,18 @@ TEST(Interpolator, pathInterpolation) {
         }
     }
 }
+
+TEST(Interpolator, pathInterpolationOutOfOrder) {
+    for (const TestData& data : sTestDataSet) {
+        PathInterpolator interpolator(getX(data), getY(data));
+        for (size_t i = data.inFraction.size(); i > 0; i--) {
+            EXPECT_FLOAT_EQ(data.outFraction[i - 1],
+                            interpolator.interpolate(data.inFraction[i - 1]));
+        }
+        for (size_t i = 0; i < data.inFraction.size(); i += 2) {
+            EXPECT_FLOAT_EQ(data.outFraction[i], interpolator.interpolate(data.inFraction[i]));
+        }
+    }
+}
 }
 }
@@ -20,6 +20,7 @@
 #include "AnimationContext.h"
 #include "DamageAccumulator.h"
 #include "IContextFactory.h"
+#include "Properties.h"
 #include "RenderNode.h"
 #include "TreeInfo.h"
 #include "renderthread/CanvasContext.h"
@@ -266,6 +267,31 @@ TEST(RenderNode, releasedCallback) {
     EXPECT_EQ(0, refcnt);
 }
 
+TEST(RenderNode, revealClippedOutlineCache) {
+    auto node = TestUtils::createNode(0, 0, 200, 400, [](RenderProperties& props, Canvas& canvas) {
+        canvas.drawColor(Color::Red_500, SkBlendMode::kSrcOver);
+    });
+
+    SkPath casterPath;
+    casterPath.addRect(SkRect::MakeWH(200, 400));
+    SkPath revealPath;
+    revealPath.addRect(SkRect::MakeLTRB(50, 50, 150, 150));
+
+    const SkPath* clipped = node->getRevealClippedOutline(casterPath, revealPath);
+    const uint32_t clippedID = clipped->getGenerationID();
+    EXPECT_EQ(SkRect::MakeLTRB(50, 50, 150, 150), clipped->getBounds());
+
+    // Unchanged inputs return the same path, so its shadow can be cached by its generation ID.
+    clipped = node->getRevealClippedOutline(casterPath, revealPath);
+    EXPECT_EQ(clippedID, clipped->getGenerationID());
+
+    revealPath.reset();
+    revealPath.addRect(SkRect::MakeLTRB(75, 75, 125, 125));
+    clipped = node->getRevealClippedOutline(casterPath, revealPath);
+    EXPECT_NE(clippedID, clipped->getGenerationID());
+    EXPECT_EQ(SkRect::MakeLTRB(75, 75, 125, 125), clipped->getBounds());
+}
+
 RENDERTHREAD_TEST(RenderNode, prepareTree_nullableDisplayList) {
     auto rootNode = TestUtils::createNode(0, 0, 200, 400, nullptr);
     ContextFactory contextFactory;
@@ -295,6 +321,60 @@ RENDERTHREAD_TEST(RenderNode, prepareTree_nullableDisplayList) {
     canvasContext->destroy();
 }
 
+// Prepares a root with 8 columns of 10 rows twice, moving one cell between the two frames, and
+// returns the damage of the second frame.
+static SkRect prepareWideTreeWithMovedCell(RenderThread& renderThread, bool parallel) {
+    std::vector<sp<RenderNode>> cells;
+    auto rootNode = TestUtils::createNode(0, 0, 800, 800, [&](RenderProperties& props,
+                                                              Canvas& canvas) {
+        for (int i = 0; i < 8; i++) {
+            auto column = TestUtils::createNode(i * 100, 0, (i + 1) * 100, 800,
+                                                [&](RenderProperties& props, Canvas& canvas) {
+                for (int j = 0; j < 10; j++) {
+                    auto cell = TestUtils::createNode(0, j * 80, 100, (j + 1) * 80,
+                                                      [](RenderProperties& props, Canvas& canvas) {
+                        canvas.drawColor(Color::Red_500, SkBlendMode::kSrcOver);
+                    });
+                    canvas.drawRenderNode(cell.get());
+                    cells.push_back(cell);
+                }
+            });
+            canvas.drawRenderNode(column.get());
+        }
+    });
+    ContextFactory contextFactory;
+    std::unique_ptr<CanvasContext> canvasContext(
+            CanvasContext::create(renderThread, false, rootNode.get(), &contextFactory));
+    Properties::parallelPrepareTree = parallel;
+
+    SkRect dirty;
+    for (int frame = 1; frame <= 2; frame++) {
+        if (frame == 2) {
+            // Move the third cell of the fourth column down
+            RenderNode* cell = cells[3 * 10 + 2].get();
+            cell->mutateStagingProperties().setTranslationY(10);
+            cell->setPropertyFieldsDirty(RenderNode::TRANSLATION_Y);
+        }
+        TreeInfo info(TreeInfo::MODE_FULL, *canvasContext.get());
+        DamageAccumulator damageAccumulator;
+        info.damageAccumulator = &damageAccumulator;
+        info.damageGenerationId = frame;
+        rootNode->prepareTree(info);
+        damageAccumulator.finish(&dirty);
+    }
+
+    Properties::parallelPrepareTree = false;
+    canvasContext->destroy();
+    return dirty;
+}
+
+RENDERTHREAD_TEST(RenderNode, prepareTree_parallelMatchesSerial) {
+    SkRect serialDirty = prepareWideTreeWithMovedCell(renderThread, false);
+    EXPECT_EQ(SkRect::MakeLTRB(300, 160, 400, 250), serialDirty);
+    SkRect parallelDirty = prepareWideTreeWithMovedCell(renderThread, true);
+    EXPECT_EQ(serialDirty, parallelDirty);
+}
+
 // TODO: Is this supposed to work in SkiaGL/SkiaVK?
 RENDERTHREAD_TEST(DISABLED_RenderNode, prepareTree_HwLayer_AVD_enqueueDamage) {
     VectorDrawable::Group* group = new VectorDrawable::Group();
@@ -20,7 +20,9 @@
 #include <gtest/gtest.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <utils/Log.h>
 #include <cstdint>
 #include "FileBlobCache.h"
@@ -53,6 +55,15 @@ public:
         cache.mBlobCache = NULL;
     }
 
+    /**
+     * "uninitialize" puts the cache back in the state it has before the first call to
+     * "initShaderDiskCache", such that "preloadDiskCache" reads from disk again.
+     */
+    static void uninitialize(ShaderCache& cache) {
+        std::lock_guard<std::mutex> lock(cache.mMutex);
+        cache.mInitialized = false;
+    }
+
     /**
      *
      */
@@ -274,9 +285,163 @@ TEST(ShaderCacheTest, testCacheValidation) {
     for (const auto& blob : blobVec) {
         ASSERT_EQ(ShaderCache::get().load(*blob.first.get()), sk_sp<SkData>());
     }
+    // The stale cache file is removed, so that it is not validated again on the next start.
+    struct stat st;
+    ASSERT_NE(0, stat(cacheFile1.c_str(), &st));
+
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+    remove(cacheFile1.c_str());
+}
+
+TEST(ShaderCacheTest, testJournalReplay) {
+    if (!folderExist(getExternalStorageFolder())) {
+        // don't run the test if external storage folder is not available
+        return;
+    }
+    std::string cacheFile1 = getExternalStorageFolder() + "/shaderCacheTest1";
+    std::string journalFile1 = cacheFile1 + ".journal";
+
+    // remove any test files from previous test run
+    remove(cacheFile1.c_str());
+    remove(journalFile1.c_str());
+
+    ShaderCache::get().setFilename(cacheFile1.c_str());
+    ShaderCacheTestUtils::setSaveDelay(ShaderCache::get(), 1);
+    ShaderCache::get().initShaderDiskCache();
+
+    sk_sp<SkData> inVS;
+    setShader(inVS, "sassas");
+    ShaderCache::get().store(GrProgramDescTest(100), *inVS.get());
+    setShader(inVS, "someVS");
+    ShaderCache::get().store(GrProgramDescTest(432), *inVS.get());
+
+    // wait for the save thread to append the entries to the journal
+    for (int i = 0; i < 50 && access(journalFile1.c_str(), F_OK) != 0; i++) {
+        usleep(100 * 1000);
+    }
+    ASSERT_EQ(0, access(journalFile1.c_str(), F_OK));
+    ASSERT_NE(0, access(cacheFile1.c_str(), F_OK));
+
+    // drop the in-memory cache without saving and verify the entries come back from the journal
+    ShaderCacheTestUtils::setSaveDelay(ShaderCache::get(), 0);
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+    ShaderCache::get().initShaderDiskCache();
+    sk_sp<SkData> outVS;
+    ASSERT_NE((outVS = ShaderCache::get().load(GrProgramDescTest(100))), sk_sp<SkData>());
+    ASSERT_TRUE(checkShader(outVS, "sassas"));
+    ASSERT_NE((outVS = ShaderCache::get().load(GrProgramDescTest(432))), sk_sp<SkData>());
+    ASSERT_TRUE(checkShader(outVS, "someVS"));
+
+    // a full save folds the journal into the cache file
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), true);
+    ASSERT_NE(0, access(journalFile1.c_str(), F_OK));
+    ShaderCache::get().initShaderDiskCache();
+    ASSERT_NE((outVS = ShaderCache::get().load(GrProgramDescTest(432))), sk_sp<SkData>());
+    ASSERT_TRUE(checkShader(outVS, "someVS"));
+
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+    remove(cacheFile1.c_str());
+}
+
+TEST(ShaderCacheTest, testSystemCache) {
+    if (!folderExist(getExternalStorageFolder())) {
+        // don't run the test if external storage folder is not available
+        return;
+    }
+    std::string systemFile = getExternalStorageFolder() + "/shaderCacheTestSystem";
+    std::string cacheFile1 = getExternalStorageFolder() + "/shaderCacheTest1";
+
+    // remove any test files from previous test run
+    remove(systemFile.c_str());
+    remove(cacheFile1.c_str());
+    std::srand(0);
+
+    // build a system cache file for an identity
+    ShaderCacheTestUtils::setSaveDelay(ShaderCache::get(), 0);  // disable deferred save
+    std::vector<uint8_t> identity(1024);
+    genRandomData(identity);
+    ShaderCache::get().setFilename(systemFile.c_str());
+    ShaderCache::get().initShaderDiskCache(
+            identity.data(), identity.size() * sizeof(decltype(identity)::value_type));
+    sk_sp<SkData> inVS;
+    setShader(inVS, "systemVS");
+    ShaderCache::get().store(GrProgramDescTest(100), *inVS.get());
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), true);
+
+    // an empty per-app cache falls back to the system cache for the same identity
+    ShaderCache::get().setSystemFilename(systemFile.c_str());
+    ShaderCache::get().setFilename(cacheFile1.c_str());
+    ShaderCache::get().initShaderDiskCache(
+            identity.data(), identity.size() * sizeof(decltype(identity)::value_type));
+    sk_sp<SkData> outVS;
+    ASSERT_NE((outVS = ShaderCache::get().load(GrProgramDescTest(100))), sk_sp<SkData>());
+    ASSERT_TRUE(checkShader(outVS, "systemVS"));
+
+    // the per-app cache takes precedence over the system cache
+    setShader(inVS, "appVS");
+    ShaderCache::get().store(GrProgramDescTest(100), *inVS.get());
+    ASSERT_NE((outVS = ShaderCache::get().load(GrProgramDescTest(100))), sk_sp<SkData>());
+    ASSERT_TRUE(checkShader(outVS, "appVS"));
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+
+    // the system cache is not used without an identity
+    ShaderCache::get().initShaderDiskCache();
+    ASSERT_EQ(ShaderCache::get().load(GrProgramDescTest(100)), sk_sp<SkData>());
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+
+    // or for another identity
+    for (auto& data : identity) {
+        data += std::rand();
+    }
+    ShaderCache::get().initShaderDiskCache(
+            identity.data(), identity.size() * sizeof(decltype(identity)::value_type));
+    ASSERT_EQ(ShaderCache::get().load(GrProgramDescTest(100)), sk_sp<SkData>());
+
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+    ShaderCache::get().setSystemFilename("");
+    remove(systemFile.c_str());
+    remove(cacheFile1.c_str());
+}
+
+TEST(ShaderCacheTest, testPreloadDiskCache) {
+    if (!folderExist(getExternalStorageFolder())) {
+        // don't run the test if external storage folder is not available
+        return;
+    }
+    std::string cacheFile1 = getExternalStorageFolder() + "/shaderCacheTest1";
+    std::string cacheFile2 = getExternalStorageFolder() + "/shaderCacheTest2";
+
+    // remove any test files from previous test run
+    remove(cacheFile1.c_str());
+    remove(cacheFile2.c_str());
+
+    ShaderCache::get().setFilename(cacheFile1.c_str());
+    ShaderCacheTestUtils::setSaveDelay(ShaderCache::get(), 0);  // disable deferred save
+    ShaderCache::get().initShaderDiskCache();
+    sk_sp<SkData> inVS;
+    setShader(inVS, "someVS");
+    ShaderCache::get().store(GrProgramDescTest(432), *inVS.get());
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), true);
+
+    // the preloaded contents are adopted by the next initialization
+    ShaderCacheTestUtils::uninitialize(ShaderCache::get());
+    ShaderCache::get().preloadDiskCache();
+    ShaderCache::get().initShaderDiskCache();
+    sk_sp<SkData> outVS;
+    ASSERT_NE((outVS = ShaderCache::get().load(GrProgramDescTest(432))), sk_sp<SkData>());
+    ASSERT_TRUE(checkShader(outVS, "someVS"));
+    ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
+
+    // contents preloaded from another file than the one initialized are not used
+    ShaderCacheTestUtils::uninitialize(ShaderCache::get());
+    ShaderCache::get().preloadDiskCache();
+    ShaderCache::get().setFilename(cacheFile2.c_str());
+    ShaderCache::get().initShaderDiskCache();
+    ASSERT_EQ(ShaderCache::get().load(GrProgramDescTest(432)), sk_sp<SkData>());
 
     ShaderCacheTestUtils::terminate(ShaderCache::get(), false);
     remove(cacheFile1.c_str());
+    remove(cacheFile2.c_str());
 }
 
 }  // namespace
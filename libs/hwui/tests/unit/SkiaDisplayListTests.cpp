@@ -20,6 +20,7 @@
 #include "AnimationContext.h"
 #include "DamageAccumulator.h"
 #include "IContextFactory.h"
+#include "RecordingCanvas.h"
 #include "pipeline/skia/GLFunctorDrawable.h"
 #include "pipeline/skia/SkiaDisplayList.h"
 #include "renderthread/CanvasContext.h"
@@ -368,3 +369,64 @@ TEST(SkiaDisplayList, updateChildren) {
     skiaDL.mChildNodes.emplace_back(renderNode.get(), &dummyCanvas);
     skiaDL.updateChildren([renderNode](RenderNode* n) { ASSERT_EQ(renderNode.get(), n); });
 }
+
+namespace {
+class DrawOrderCanvas : public SkNoDrawCanvas {
+public:
+    DrawOrderCanvas() : SkNoDrawCanvas(100, 100) {}
+    void onDrawRect(const SkRect& rect, const SkPaint&) override { mOrder.push_back(rect.fLeft); }
+    void onDrawOval(const SkRect& oval, const SkPaint&) override { mOrder.push_back(oval.fLeft); }
+    std::vector<float> mOrder;
+};
+
+static std::vector<float> recordAndReorder(const std::vector<SkRect>& rects,
+                                           float recordScale = 1, float drawScale = 1) {
+    DisplayListData displayList;
+    RecordingCanvas recorder;
+    recorder.reset(&displayList, SkIRect::MakeWH(100, 100));
+    recorder.scale(recordScale, recordScale);
+    SkPaint paint;
+    for (size_t i = 0; i < rects.size(); i++) {
+        // Alternate between ops that can't share a batch.
+        if (i % 2) {
+            recorder.drawOval(rects[i], paint);
+        } else {
+            recorder.drawRect(rects[i], paint);
+        }
+    }
+    displayList.reorderForBatching();
+    DrawOrderCanvas canvas;
+    canvas.scale(drawScale, drawScale);
+    displayList.draw(&canvas);
+    return canvas.mOrder;
+}
+}  // namespace
+
+TEST(SkiaDisplayList, reorderForBatching) {
+    // Disjoint draws are grouped by op type.
+    std::vector<float> expected = {0, 40, 20};
+    EXPECT_EQ(expected, recordAndReorder({SkRect::MakeLTRB(0, 0, 10, 10),
+                                          SkRect::MakeLTRB(20, 0, 30, 10),
+                                          SkRect::MakeLTRB(40, 0, 50, 10)}));
+
+    // A draw is never moved across one it overlaps.
+    expected = {0, 5, 12};
+    EXPECT_EQ(expected, recordAndReorder({SkRect::MakeLTRB(0, 0, 10, 10),
+                                          SkRect::MakeLTRB(5, 0, 15, 10),
+                                          SkRect::MakeLTRB(12, 0, 20, 10)}));
+
+    // The antialiasing margin doesn't shrink with the recorded matrix. The rects are 4 units
+    // apart from the oval, which is only one unit once scaled.
+    expected = {0, 12, 24};
+    EXPECT_EQ(expected, recordAndReorder({SkRect::MakeLTRB(0, 0, 8, 10),
+                                          SkRect::MakeLTRB(12, 0, 20, 10),
+                                          SkRect::MakeLTRB(24, 0, 32, 10)},
+                                         0.25f));
+
+    // Drawing scaled down falls back to recording order.
+    expected = {0, 20, 40};
+    EXPECT_EQ(expected, recordAndReorder({SkRect::MakeLTRB(0, 0, 10, 10),
+                                          SkRect::MakeLTRB(20, 0, 30, 10),
+                                          SkRect::MakeLTRB(40, 0, 50, 10)},
+                                         1, 0.5f));
+}
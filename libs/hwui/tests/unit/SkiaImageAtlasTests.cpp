@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "pipeline/skia/SkiaImageAtlas.h"
+#include "tests/common/TestUtils.h"
+
+#include <SkBitmap.h>
+#include <SkSurface.h>
+
+using namespace android;
+using namespace android::uirenderer;
+using namespace android::uirenderer::skiapipeline;
+
+static sk_sp<SkImage> makeImage(const SkImageInfo& info, SkColor color) {
+    SkBitmap bitmap;
+    bitmap.allocPixels(info);
+    bitmap.eraseColor(color);
+    bitmap.setImmutable();
+    return SkImage::MakeFromBitmap(bitmap);
+}
+
+RENDERTHREAD_SKIA_PIPELINE_TEST(SkiaImageAtlas, findAfterPrepareFrame) {
+    GrContext* grContext = renderThread.getGrContext();
+    sk_sp<SkSurface> surface = SkSurface::MakeRenderTarget(grContext, SkBudgeted::kNo,
+                                                           SkImageInfo::MakeN32Premul(100, 100));
+    SkiaImageAtlas atlas(grContext);
+    sk_sp<SkImage> image = makeImage(SkImageInfo::MakeN32Premul(20, 10), SK_ColorRED);
+    SkPaint paint;
+    SkRect bounds;
+
+    atlas.prepareFrame();
+    // The first draw only queues the image
+    EXPECT_EQ(nullptr, atlas.find(surface->getCanvas(), image.get(), paint, &bounds));
+    EXPECT_EQ(0u, atlas.imageCount());
+
+    atlas.prepareFrame();
+    const SkImage* texture = atlas.find(surface->getCanvas(), image.get(), paint, &bounds);
+    ASSERT_NE(nullptr, texture);
+    EXPECT_TRUE(texture->isTextureBacked());
+    EXPECT_EQ(1u, atlas.imageCount());
+    EXPECT_EQ(20, bounds.width());
+    EXPECT_EQ(10, bounds.height());
+    EXPECT_TRUE(SkRect::MakeIWH(texture->width(), texture->height()).contains(bounds));
+
+    // Draws to a canvas of another context must keep using the image itself
+    sk_sp<SkSurface> rasterSurface = SkSurface::MakeRasterN32Premul(100, 100);
+    EXPECT_EQ(nullptr, atlas.find(rasterSurface->getCanvas(), image.get(), paint, &bounds));
+}
+
+RENDERTHREAD_SKIA_PIPELINE_TEST(SkiaImageAtlas, rejectsUnsupportedDraws) {
+    GrContext* grContext = renderThread.getGrContext();
+    sk_sp<SkSurface> surface = SkSurface::MakeRenderTarget(grContext, SkBudgeted::kNo,
+                                                           SkImageInfo::MakeN32Premul(100, 100));
+    SkCanvas* canvas = surface->getCanvas();
+    SkiaImageAtlas atlas(grContext);
+    SkRect bounds;
+
+    sk_sp<SkImage> large = makeImage(SkImageInfo::MakeN32Premul(200, 10), SK_ColorRED);
+    sk_sp<SkImage> alpha = makeImage(SkImageInfo::MakeA8(10, 10), SK_ColorBLACK);
+    sk_sp<SkImage> small = makeImage(SkImageInfo::MakeN32Premul(10, 10), SK_ColorBLUE);
+    SkPaint mipmapPaint;
+    mipmapPaint.setFilterQuality(kMedium_SkFilterQuality);
+    SkPaint paint;
+
+    for (int frame = 0; frame < 3; frame++) {
+        atlas.prepareFrame();
+        EXPECT_EQ(nullptr, atlas.find(canvas, large.get(), paint, &bounds));
+        EXPECT_EQ(nullptr, atlas.find(canvas, alpha.get(), paint, &bounds));
+        EXPECT_EQ(nullptr, atlas.find(canvas, small.get(), mipmapPaint, &bounds));
+    }
+    EXPECT_EQ(0u, atlas.imageCount());
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "hwui/Paint.h"
+#include "pipeline/skia/SkiaDisplayList.h"
+#include "pipeline/skia/SkiaRecordingCanvas.h"
+#include "pipeline/skia/TextPrefetcher.h"
+#include "tests/common/TestUtils.h"
+#include "thread/CommonPool.h"
+
+using namespace android;
+using namespace android::uirenderer;
+using namespace android::uirenderer::skiapipeline;
+
+static std::unique_ptr<SkiaDisplayList> recordText(const char* text) {
+    SkiaRecordingCanvas canvas{nullptr, 200, 200};
+    Paint paint;
+    paint.setAntiAlias(true);
+    TestUtils::drawUtf8ToCanvas(&canvas, text, paint, 0, 50);
+    return std::unique_ptr<SkiaDisplayList>(canvas.finishRecording());
+}
+
+TEST(TextPrefetcher, backToBackSubmissions) {
+    ScopedProperty<bool> prop(Properties::prefetchText, true);
+    CommonPool::waitForIdle();
+    size_t before = TextPrefetcher::get().prefetchedCount();
+
+    // The second display list is recorded while the first one may still be prefetching, both
+    // must be prefetched
+    auto first = recordText("first");
+    auto second = recordText("second");
+    CommonPool::waitForIdle();
+
+    EXPECT_EQ(before + 2, TextPrefetcher::get().prefetchedCount());
+}
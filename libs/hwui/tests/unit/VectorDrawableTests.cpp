@@ -409,5 +409,50 @@ TEST(VectorDrawable, drawPathWithoutIncrementingShaderRefCount) {
     EXPECT_TRUE(shader->unique());
 }
 
+static VectorDrawable::Tree* createTriangleTree(SkColor fillColor) {
+    VectorDrawable::Group* group = new VectorDrawable::Group();
+    VectorDrawable::FullPath* path = new VectorDrawable::FullPath("M0,0 L10,0 L10,10z", 18);
+    path->mutateStagingProperties()->setFillColor(fillColor);
+    group->addChild(path);
+    VectorDrawable::Tree* tree = new VectorDrawable::Tree(group);
+    tree->mutateStagingProperties()->setViewportSize(10, 10);
+    tree->mutateStagingProperties()->setScaledSize(20, 20);
+    tree->syncProperties();
+    return tree;
+}
+
+TEST(VectorDrawable, rasterCacheSharedAcrossTrees) {
+    VectorDrawable::RasterCache& rasterCache = VectorDrawable::RasterCache::get();
+    rasterCache.clear();
+
+    sp<VectorDrawable::Tree> first(createTriangleTree(SK_ColorRED));
+    sp<VectorDrawable::Tree> second(createTriangleTree(SK_ColorRED));
+    sp<VectorDrawable::Tree> other(createTriangleTree(SK_ColorBLUE));
+
+    Bitmap* firstBitmap = &first->getBitmapUpdateIfDirty();
+    EXPECT_EQ(1u, rasterCache.getEntryCount());
+    EXPECT_EQ(firstBitmap, &second->getBitmapUpdateIfDirty());
+    EXPECT_EQ(1u, rasterCache.getEntryCount());
+    EXPECT_NE(firstBitmap, &other->getBitmapUpdateIfDirty());
+    EXPECT_EQ(2u, rasterCache.getEntryCount());
+
+    // Root alpha is applied at draw time and keeps the shared raster.
+    first->mutateStagingProperties()->setRootAlpha(0.5f);
+    first->syncProperties();
+    EXPECT_EQ(firstBitmap, &first->getBitmapUpdateIfDirty());
+
+    // Content changes at the same size opt the tree out, leaving the shared raster untouched.
+    first->mutateStagingProperties()->setViewportSize(20, 20);
+    first->syncProperties();
+    EXPECT_NE(firstBitmap, &first->getBitmapUpdateIfDirty());
+    EXPECT_EQ(firstBitmap, &second->getBitmapUpdateIfDirty());
+    EXPECT_EQ(2u, rasterCache.getEntryCount());
+
+    rasterCache.setMaxBytes(0);
+    EXPECT_EQ(0u, rasterCache.getEntryCount());
+    EXPECT_EQ(0u, rasterCache.getUsedBytes());
+    rasterCache.setMaxBytes(1024 * 1024);
+}
+
 }  // namespace uirenderer
 }  // namespace android
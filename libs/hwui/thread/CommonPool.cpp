@@ -20,17 +20,51 @@
 #include <utils/Trace.h>
 #include "renderthread/RenderThread.h"
 
+#include <algorithm>
 #include <array>
+#include <cstdio>
+#include <thread>
+#include <vector>
 
 namespace android {
 namespace uirenderer {
 
-CommonPool::CommonPool() {
+static thread_local int sWorkerIndex = -1;
+
+// Returns the number of CPUs that are faster than the slowest cluster, or all of them on devices
+// without heterogeneous cores. Workers beyond that would only contend for the little cores.
+static int countPerformanceCores() {
+    const int cpuCount = static_cast<int>(std::thread::hardware_concurrency());
+    std::vector<long> maxFreqs;
+    for (int cpu = 0; cpu < cpuCount; cpu++) {
+        std::array<char, 80> path;
+        snprintf(path.data(), path.size(), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq",
+                 cpu);
+        FILE* file = fopen(path.data(), "re");
+        if (!file) {
+            continue;
+        }
+        long freq = 0;
+        if (fscanf(file, "%ld", &freq) == 1) {
+            maxFreqs.push_back(freq);
+        }
+        fclose(file);
+    }
+    if (maxFreqs.empty()) {
+        return cpuCount;
+    }
+    const long slowest = *std::min_element(maxFreqs.begin(), maxFreqs.end());
+    const int fastCount = std::count_if(maxFreqs.begin(), maxFreqs.end(),
+                                        [slowest](long freq) { return freq > slowest; });
+    return fastCount > 0 ? fastCount : static_cast<int>(maxFreqs.size());
+}
+
+CommonPool::CommonPool()
+        : mThreadCount(std::clamp(countPerformanceCores(), MIN_THREAD_COUNT, MAX_THREAD_COUNT)) {
     ATRACE_CALL();
 
     CommonPool* pool = this;
-    // Create 2 workers
-    for (int i = 0; i < THREAD_COUNT; i++) {
+    for (int i = 0; i < mThreadCount; i++) {
         std::thread worker([pool, i] {
             {
                 std::array<char, 20> name{"hwuiTask"};
@@ -43,7 +77,8 @@ CommonPool::CommonPool() {
                     startHook(name.data());
                 }
             }
-            pool->workerLoop();
+            sWorkerIndex = i;
+            pool->workerLoop(i);
         });
         worker.detach();
     }
@@ -54,39 +89,108 @@ CommonPool& CommonPool::instance() {
     return pool;
 }
 
-void CommonPool::post(Task&& task) {
-    instance().enqueue(std::move(task));
+void CommonPool::post(Task&& task, Priority priority) {
+    instance().enqueue(std::move(task), priority);
 }
 
-void CommonPool::enqueue(Task&& task) {
-    std::unique_lock lock(mLock);
-    while (!mWorkQueue.hasSpace()) {
-        lock.unlock();
-        usleep(100);
-        lock.lock();
+int CommonPool::threadCount() {
+    return instance().mThreadCount;
+}
+
+bool CommonPool::isWorkerThread() {
+    return sWorkerIndex >= 0;
+}
+
+bool CommonPool::tryPush(int workerIndex, Task& task, Priority priority) {
+    Worker& worker = mWorkers[workerIndex];
+    std::lock_guard lock(worker.lock);
+    auto& queue = worker.queues[static_cast<int>(priority)];
+    if (!queue.hasSpace()) {
+        return false;
     }
-    mWorkQueue.push(std::move(task));
-    if (mWaitingThreads == THREAD_COUNT || (mWaitingThreads > 0 && mWorkQueue.size() > 1)) {
-        mCondition.notify_one();
+    queue.push(std::move(task));
+    mQueuedTasks++;
+    return true;
+}
+
+bool CommonPool::tryTake(int workerIndex, Task* outTask) {
+    // Take the highest priority task available, preferring our own queues over stealing
+    // from the other workers.
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        for (int i = 0; i < mThreadCount; i++) {
+            Worker& worker = mWorkers[(workerIndex + i) % mThreadCount];
+            std::lock_guard lock(worker.lock);
+            auto& queue = worker.queues[priority];
+            if (queue.hasWork()) {
+                *outTask = queue.pop();
+                mQueuedTasks--;
+                mTakenTasks++;
+                return true;
+            }
+        }
     }
+    return false;
 }
 
-void CommonPool::workerLoop() {
+void CommonPool::enqueue(Task&& task, Priority priority) {
+    const int self = sWorkerIndex;
+    if (self >= 0) {
+        // Workers queue onto their own queues first so related work stays local. Blocking a
+        // worker on a full pool could deadlock it, so run the task inline instead.
+        bool pushed = false;
+        for (int i = 0; i < mThreadCount && !pushed; i++) {
+            pushed = tryPush((self + i) % mThreadCount, task, priority);
+        }
+        if (!pushed) {
+            task();
+            return;
+        }
+    } else {
+        while (true) {
+            const unsigned int taken = mTakenTasks.load();
+            const int start = mNextWorker++ % mThreadCount;
+            bool pushed = false;
+            for (int i = 0; i < mThreadCount && !pushed; i++) {
+                pushed = tryPush((start + i) % mThreadCount, task, priority);
+            }
+            if (pushed) {
+                break;
+            }
+            std::unique_lock lock(mLock);
+            mBlockedPosters++;
+            mSpaceCondition.wait(lock, [&] { return mTakenTasks.load() != taken; });
+            mBlockedPosters--;
+        }
+    }
+
     std::unique_lock lock(mLock);
+    if (mWaitingThreads == mThreadCount || (mWaitingThreads > 0 && mQueuedTasks.load() > 1)) {
+        mCondition.notify_one();
+    }
+}
+
+void CommonPool::workerLoop(int workerIndex) {
+    Task work;
     while (true) {
-        if (!mWorkQueue.hasWork()) {
-            mWaitingThreads++;
-            mCondition.wait(lock);
-            mWaitingThreads--;
-        }
-        // Need to double-check that work is still available now that we have the lock
-        // It may have already been grabbed by a different thread
-        while (mWorkQueue.hasWork()) {
-            auto work = mWorkQueue.pop();
-            lock.unlock();
+        if (tryTake(workerIndex, &work)) {
+            if (mBlockedPosters.load() > 0) {
+                std::unique_lock lock(mLock);
+                mSpaceCondition.notify_all();
+            }
             work();
-            lock.lock();
+            work = nullptr;
+            continue;
+        }
+
+        std::unique_lock lock(mLock);
+        // Need to double-check that no work was posted since we last looked now that we have
+        // the lock, as posters only signal while holding it.
+        if (mQueuedTasks.load() > 0) {
+            continue;
         }
+        mWaitingThreads++;
+        mCondition.wait(lock);
+        mWaitingThreads--;
     }
 }
 
@@ -96,7 +200,7 @@ void CommonPool::waitForIdle() {
 
 void CommonPool::doWaitForIdle() {
     std::unique_lock lock(mLock);
-    while (mWaitingThreads != THREAD_COUNT) {
+    while (mWaitingThreads != mThreadCount) {
         lock.unlock();
         usleep(100);
         lock.lock();
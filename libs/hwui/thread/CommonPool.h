@@ -21,6 +21,8 @@
 
 #include <log/log.h>
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <future>
@@ -72,49 +74,91 @@ private:
     int mTail = 0;
 };
 
+// A pool of worker threads for short-lived background work. Each worker owns a queue per task
+// priority; posted tasks are spread across the workers and idle workers steal queued tasks from
+// busy ones, highest priority first. The number of workers is derived from the CPU topology.
 class CommonPool {
     PREVENT_COPY_AND_ASSIGN(CommonPool);
 
 public:
     using Task = std::function<void()>;
-    static constexpr auto THREAD_COUNT = 2;
-    static constexpr auto QUEUE_SIZE = 128;
+    static constexpr auto MIN_THREAD_COUNT = 2;
+    static constexpr auto MAX_THREAD_COUNT = 4;
+    // Capacity of each per-worker, per-priority queue.
+    static constexpr auto QUEUE_SIZE = 64;
+
+    enum class Priority {
+        // Work that a frame is waiting on, such as texture uploads and image decoding.
+        High,
+        // Work that should complete soon but does not block a frame, such as shader compilation.
+        Normal,
+        // Background work, such as persisting caches or captures to disk.
+        Low,
+    };
+    static constexpr auto PRIORITY_COUNT = 3;
 
-    static void post(Task&& func);
+    // Posts a task to the pool. If every queue is full the call blocks until there is space,
+    // unless it is made from a worker thread, in which case the task is run immediately.
+    static void post(Task&& func, Priority priority = Priority::Normal);
 
     template <class F>
-    static auto async(F&& func) -> std::future<decltype(func())> {
+    static auto async(F&& func, Priority priority = Priority::Normal)
+            -> std::future<decltype(func())> {
         typedef std::packaged_task<decltype(func())()> task_t;
         auto task = std::make_shared<task_t>(std::forward<F>(func));
-        post([task]() { std::invoke(*task); });
+        post([task]() { std::invoke(*task); }, priority);
         return task->get_future();
     }
 
     template <class F>
-    static auto runSync(F&& func) -> decltype(func()) {
+    static auto runSync(F&& func, Priority priority = Priority::Normal) -> decltype(func()) {
+        if (isWorkerThread()) {
+            // Queuing behind ourselves could deadlock, so run the task inline.
+            return std::invoke(std::forward<F>(func));
+        }
         std::packaged_task<decltype(func())()> task{std::forward<F>(func)};
-        post([&task]() { std::invoke(task); });
+        post([&task]() { std::invoke(task); }, priority);
         return task.get_future().get();
     };
 
+    // Returns the number of worker threads in the pool.
+    static int threadCount();
+
+    // Returns true if the calling thread is one of the pool's worker threads.
+    static bool isWorkerThread();
+
     // For testing purposes only, blocks until all worker threads are parked.
     static void waitForIdle();
 
 private:
+    struct Worker {
+        std::mutex lock;
+        std::array<ArrayQueue<Task, QUEUE_SIZE>, PRIORITY_COUNT> queues;
+    };
+
     static CommonPool& instance();
 
     CommonPool();
     ~CommonPool() {}
 
-    void enqueue(Task&&);
+    void enqueue(Task&&, Priority priority);
+    bool tryPush(int workerIndex, Task& task, Priority priority);
+    bool tryTake(int workerIndex, Task* outTask);
     void doWaitForIdle();
 
-    void workerLoop();
+    void workerLoop(int workerIndex);
+
+    const int mThreadCount;
+    std::array<Worker, MAX_THREAD_COUNT> mWorkers;
+    std::atomic_int mQueuedTasks{0};
+    std::atomic_uint mNextWorker{0};
+    std::atomic_uint mTakenTasks{0};
 
     std::mutex mLock;
     std::condition_variable mCondition;
+    std::condition_variable mSpaceCondition;
     int mWaitingThreads = 0;
-    ArrayQueue<Task, QUEUE_SIZE> mWorkQueue;
+    std::atomic_int mBlockedPosters{0};
 };
 
 }  // namespace uirenderer
@@ -18,6 +18,18 @@
 
 #include "Blur.h"
 #include "MathUtils.h"
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+#include "thread/CommonPool.h"
+#endif
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+// Images smaller than this are blurred on the calling thread.
+#define BLUR_PARALLEL_MIN_PIXELS (256 * 256)
+// Fewest rows handed to a CommonPool worker at once.
+#define BLUR_MIN_TILE_ROWS 32
 
 namespace android {
 namespace uirenderer {
@@ -91,12 +103,47 @@ void Blur::generateGaussianWeights(float* weights, float radius) {
     }
 }
 
+// Splits the rows [0, height) into tiles and runs func(rowStart, rowEnd) on each. Large images
+// are spread over the CommonPool, with the first tile run on the calling thread.
+template <typename F>
+static void forEachRowTile(int32_t width, int32_t height, F&& func) {
+#ifdef __ANDROID__ // Layoutlib does not support CommonPool
+    if (width * height < BLUR_PARALLEL_MIN_PIXELS || CommonPool::isWorkerThread()) {
+        func(0, height);
+        return;
+    }
+
+    const int32_t tileCount = std::min(CommonPool::threadCount() + 1,
+                                       (height + BLUR_MIN_TILE_ROWS - 1) / BLUR_MIN_TILE_ROWS);
+    const int32_t tileRows = (height + tileCount - 1) / tileCount;
+    std::vector<std::future<void>> tiles;
+    for (int32_t rowStart = tileRows; rowStart < height; rowStart += tileRows) {
+        const int32_t rowEnd = std::min(rowStart + tileRows, height);
+        tiles.push_back(CommonPool::async([&func, rowStart, rowEnd]() { func(rowStart, rowEnd); },
+                                          CommonPool::Priority::High));
+    }
+    func(0, std::min(tileRows, height));
+    for (auto& tile : tiles) {
+        tile.get();
+    }
+#else
+    func(0, height);
+#endif
+}
+
 void Blur::horizontal(float* weights, int32_t radius, const uint8_t* source, uint8_t* dest,
                       int32_t width, int32_t height) {
+    forEachRowTile(width, height, [=](int32_t rowStart, int32_t rowEnd) {
+        horizontalRows(weights, radius, source, dest, width, rowStart, rowEnd);
+    });
+}
+
+void Blur::horizontalRows(const float* weights, int32_t radius, const uint8_t* source,
+                          uint8_t* dest, int32_t width, int32_t rowStart, int32_t rowEnd) {
     float blurredPixel = 0.0f;
     float currentPixel = 0.0f;
 
-    for (int32_t y = 0; y < height; y++) {
+    for (int32_t y = rowStart; y < rowEnd; y++) {
         const uint8_t* input = source + y * width;
         uint8_t* output = dest + y * width;
 
@@ -136,44 +183,35 @@ void Blur::horizontal(float* weights, int32_t radius, const uint8_t* source, uin
 
 void Blur::vertical(float* weights, int32_t radius, const uint8_t* source, uint8_t* dest,
                     int32_t width, int32_t height) {
-    float blurredPixel = 0.0f;
-    float currentPixel = 0.0f;
+    forEachRowTile(width, height, [=](int32_t rowStart, int32_t rowEnd) {
+        verticalRows(weights, radius, source, dest, width, height, rowStart, rowEnd);
+    });
+}
 
-    for (int32_t y = 0; y < height; y++) {
-        uint8_t* output = dest + y * width;
+void Blur::verticalRows(const float* weights, int32_t radius, const uint8_t* source,
+                        uint8_t* dest, int32_t width, int32_t height, int32_t rowStart,
+                        int32_t rowEnd) {
+    // Walking down a column for every pixel misses the cache on each tap. Instead accumulate
+    // whole source rows into one output row; every pixel still sums its taps in the same
+    // order, so the result is unchanged, and the inner loop is contiguous and vectorizes.
+    std::vector<float> blurredRow(width);
+
+    for (int32_t y = rowStart; y < rowEnd; y++) {
+        std::fill(blurredRow.begin(), blurredRow.end(), 0.0f);
+
+        for (int32_t r = -radius; r <= radius; r++) {
+            // Clamp to zero and height
+            const int32_t validH = std::max(0, std::min(y + r, height - 1));
+            const uint8_t* input = source + validH * width;
+            const float weight = weights[r + radius];
+            for (int32_t x = 0; x < width; x++) {
+                blurredRow[x] += (float)input[x] * weight;
+            }
+        }
 
+        uint8_t* output = dest + y * width;
         for (int32_t x = 0; x < width; x++) {
-            blurredPixel = 0.0f;
-            const float* gPtr = weights;
-            const uint8_t* input = source + x;
-            // Optimization for non-border pixels
-            if (y > radius && y < (height - radius)) {
-                const uint8_t* i = input + ((y - radius) * width);
-                for (int32_t r = -radius; r <= radius; r++) {
-                    currentPixel = (float)(*i);
-                    blurredPixel += currentPixel * gPtr[0];
-                    gPtr++;
-                    i += width;
-                }
-            } else {
-                for (int32_t r = -radius; r <= radius; r++) {
-                    int validH = y + r;
-                    // Clamp to zero and width
-                    if (validH < 0) {
-                        validH = 0;
-                    }
-                    if (validH > height - 1) {
-                        validH = height - 1;
-                    }
-
-                    const uint8_t* i = input + validH * width;
-                    currentPixel = (float)(*i);
-                    blurredPixel += currentPixel * gPtr[0];
-                    gPtr++;
-                }
-            }
-            *output = (uint8_t)blurredPixel;
-            output++;
+            output[x] = (uint8_t)blurredRow[x];
         }
     }
 }
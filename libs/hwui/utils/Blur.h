@@ -35,10 +35,18 @@ public:
     static uint32_t convertRadiusToInt(float radius);
 
     static void generateGaussianWeights(float* weights, float radius);
+    // Large images are split into row tiles blurred in parallel on the CommonPool.
     static void horizontal(float* weights, int32_t radius, const uint8_t* source, uint8_t* dest,
                            int32_t width, int32_t height);
     static void vertical(float* weights, int32_t radius, const uint8_t* source, uint8_t* dest,
                          int32_t width, int32_t height);
+
+private:
+    static void horizontalRows(const float* weights, int32_t radius, const uint8_t* source,
+                               uint8_t* dest, int32_t width, int32_t rowStart, int32_t rowEnd);
+    static void verticalRows(const float* weights, int32_t radius, const uint8_t* source,
+                             uint8_t* dest, int32_t width, int32_t height, int32_t rowStart,
+                             int32_t rowEnd);
 };
 
 }  // namespace uirenderer
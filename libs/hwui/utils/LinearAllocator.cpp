@@ -31,6 +31,10 @@
 #include <utils/Log.h>
 #include <utils/Macros.h>
 
+#include <array>
+#include <atomic>
+#include <mutex>
+
 // The ideal size of a page allocation (these need to be multiples of 8)
 #define INITIAL_PAGE_SIZE ((size_t)512)  // 512b
 #define MAX_PAGE_SIZE ((size_t)131072)   // 128kb
@@ -79,8 +83,9 @@ class LinearAllocator::Page {
 public:
     Page* next() { return mNextPage; }
     void setNext(Page* next) { mNextPage = next; }
+    size_t allocSize() { return mAllocSize; }
 
-    Page() : mNextPage(0) {}
+    explicit Page(size_t allocSize) : mNextPage(0), mAllocSize(allocSize) {}
 
     void* operator new(size_t /*size*/, void* buf) { return buf; }
 
@@ -91,8 +96,108 @@ public:
 private:
     Page(const Page& /*other*/) {}
     Page* mNextPage;
+    size_t mAllocSize;
+};
+
+static std::atomic<size_t> sPagePoolHighWatermark{
+        LinearAllocator::DEFAULT_PAGE_POOL_HIGH_WATERMARK};
+
+/**
+ * Free pages released by destroyed LinearAllocators, shared by every thread of the process. Only
+ * pages of the sizes LinearAllocator grows through are kept, one free list per size, so that a
+ * pooled page is always an exact fit for a new page request.
+ */
+class PagePool {
+public:
+    void* take(size_t allocSize) {
+        int sizeClass = sizeClassFor(allocSize);
+        if (sizeClass < 0) return nullptr;
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mFreeLists[sizeClass]) return nullptr;
+        FreePage* page = mFreeLists[sizeClass];
+        mFreeLists[sizeClass] = page->next;
+        mSize -= allocSize;
+        return page;
+    }
+
+    bool give(void* buf, size_t allocSize) {
+        int sizeClass = sizeClassFor(allocSize);
+        if (sizeClass < 0) return false;
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mSize + allocSize > sPagePoolHighWatermark.load()) return false;
+        FreePage* page = new (buf) FreePage();
+        page->next = mFreeLists[sizeClass];
+        mFreeLists[sizeClass] = page;
+        mSize += allocSize;
+        return true;
+    }
+
+    void trim() {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (auto& list : mFreeLists) {
+            while (list) {
+                FreePage* next = list->next;
+                free(list);
+                list = next;
+            }
+        }
+        mSize = 0;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mSize;
+    }
+
+    // Returns the malloc size of a page of the given usable size
+    static size_t allocSizeFor(size_t pageSize);
+
+private:
+    struct FreePage {
+        FreePage* next = nullptr;
+    };
+
+    // INITIAL_PAGE_SIZE doubled until MAX_PAGE_SIZE
+    static constexpr int SIZE_CLASS_COUNT = 9;
+
+    static int sizeClassFor(size_t allocSize) {
+        size_t pageSize = INITIAL_PAGE_SIZE;
+        for (int i = 0; i < SIZE_CLASS_COUNT; i++, pageSize *= 2) {
+            if (allocSize == allocSizeFor(pageSize)) return i;
+        }
+        return -1;
+    }
+
+    std::mutex mLock;
+    std::array<FreePage*, SIZE_CLASS_COUNT> mFreeLists{};
+    size_t mSize = 0;
 };
 
+static_assert((INITIAL_PAGE_SIZE << 8) == MAX_PAGE_SIZE, "PagePool size classes are out of date");
+
+size_t PagePool::allocSizeFor(size_t pageSize) {
+    return ALIGN(pageSize + sizeof(LinearAllocator::Page));
+}
+
+// Intentionally never destroyed so that LinearAllocators outliving static destruction can still
+// release their pages
+static PagePool& pagePool() {
+    static PagePool* sPagePool = new PagePool();
+    return *sPagePool;
+}
+
+void LinearAllocator::setPagePoolHighWatermark(size_t bytes) {
+    sPagePoolHighWatermark = bytes;
+}
+
+size_t LinearAllocator::pagePoolSize() {
+    return pagePool().size();
+}
+
+void LinearAllocator::trimPagePool() {
+    pagePool().trim();
+}
+
 LinearAllocator::LinearAllocator()
         : mPageSize(INITIAL_PAGE_SIZE)
         , mMaxAllocSize(INITIAL_PAGE_SIZE * MAX_WASTE_RATIO)
@@ -113,8 +218,11 @@ LinearAllocator::~LinearAllocator(void) {
     Page* p = mPages;
     while (p) {
         Page* next = p->next();
+        size_t allocSize = p->allocSize();
         p->~Page();
-        free(p);
+        if (!pagePool().give(p, allocSize)) {
+            free(p);
+        }
         RM_ALLOCATION();
         p = next;
     }
@@ -217,12 +325,15 @@ void LinearAllocator::rewindIfLastAlloc(void* ptr, size_t allocSize) {
 }
 
 LinearAllocator::Page* LinearAllocator::newPage(size_t pageSize) {
-    pageSize = ALIGN(pageSize + sizeof(LinearAllocator::Page));
+    pageSize = PagePool::allocSizeFor(pageSize);
     ADD_ALLOCATION();
     mTotalAllocated += pageSize;
     mPageCount++;
-    void* buf = malloc(pageSize);
-    return new (buf) Page();
+    void* buf = pagePool().take(pageSize);
+    if (!buf) {
+        buf = malloc(pageSize);
+    }
+    return new (buf) Page(pageSize);
 }
 
 static const char* toSize(size_t value, float& result) {
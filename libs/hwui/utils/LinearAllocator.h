@@ -34,6 +34,8 @@
 namespace android {
 namespace uirenderer {
 
+class PagePool;
+
 /**
  * A memory manager that internally allocates multi-kbyte buffers for placing objects in. It avoids
  * the overhead of malloc when many objects are allocated. It is most useful when creating many
@@ -117,9 +119,30 @@ public:
     size_t usedSize() const { return mTotalAllocated - mWastedSpace; }
     size_t allocatedSize() const { return mTotalAllocated; }
 
+    static constexpr size_t DEFAULT_PAGE_POOL_HIGH_WATERMARK = 1024 * 1024;
+
+    /**
+     * Pages of destroyed LinearAllocators are kept in a process-wide pool and reused by the next
+     * LinearAllocators created on any thread. This sets the maximum number of bytes the pool may
+     * hold; pages beyond it are freed. A watermark of 0 disables pooling.
+     */
+    static void setPagePoolHighWatermark(size_t bytes);
+
+    /**
+     * The number of bytes of free pages in the pool
+     */
+    static size_t pagePoolSize();
+
+    /**
+     * Frees all of the pages in the pool
+     */
+    static void trimPagePool();
+
 private:
     LinearAllocator(const LinearAllocator& other);
 
+    friend class PagePool;
+
     class Page;
     typedef void (*Destructor)(void* addr);
     struct DestructorNode {
@@ -24,18 +24,6 @@
 namespace android {
 namespace uirenderer {
 
-class PathResolver {
-public:
-    float currentX = 0;
-    float currentY = 0;
-    float ctrlPointX = 0;
-    float ctrlPointY = 0;
-    float currentSegmentStartX = 0;
-    float currentSegmentStartY = 0;
-    void addCommand(SkPath* outPath, char previousCmd, char cmd, const std::vector<float>* points,
-                    size_t start, size_t end);
-};
-
 bool VectorDrawableUtils::canMorph(const PathData& morphFrom, const PathData& morphTo) {
     if (morphFrom.verbs.size() != morphTo.verbs.size()) {
         return false;
@@ -69,7 +57,7 @@ void VectorDrawableUtils::verbsToPath(SkPath* outPath, const PathData& data) {
     outPath->reset();
     for (unsigned int i = 0; i < data.verbs.size(); i++) {
         size_t verbSize = data.verbSizes[i];
-        resolver.addCommand(outPath, previousCommand, data.verbs[i], &data.points, start,
+        resolver.addCommand(outPath, previousCommand, data.verbs[i], data.points.data(), start,
                             start + verbSize);
         previousCommand = data.verbs[i];
         start += verbSize;
@@ -97,8 +85,8 @@ void VectorDrawableUtils::interpolatePaths(PathData* outData, const PathData& fr
 }
 
 // Use the given verb, and points in the range [start, end) to insert a command into the SkPath.
-void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd,
-                              const std::vector<float>* points, size_t start, size_t end) {
+void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd, const float* points,
+                              size_t start, size_t end) {
     int incr = 2;
     float reflectiveCtrlPointX;
     float reflectiveCtrlPointY;
@@ -149,76 +137,76 @@ void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd,
     for (unsigned int k = start; k < end; k += incr) {
         switch (cmd) {
             case 'm':  // moveto - Start a new sub-path (relative)
-                currentX += points->at(k + 0);
-                currentY += points->at(k + 1);
+                currentX += points[k + 0];
+                currentY += points[k + 1];
                 if (k > start) {
                     // According to the spec, if a moveto is followed by multiple
                     // pairs of coordinates, the subsequent pairs are treated as
                     // implicit lineto commands.
-                    outPath->rLineTo(points->at(k + 0), points->at(k + 1));
+                    outPath->rLineTo(points[k + 0], points[k + 1]);
                 } else {
-                    outPath->rMoveTo(points->at(k + 0), points->at(k + 1));
+                    outPath->rMoveTo(points[k + 0], points[k + 1]);
                     currentSegmentStartX = currentX;
                     currentSegmentStartY = currentY;
                 }
                 break;
             case 'M':  // moveto - Start a new sub-path
-                currentX = points->at(k + 0);
-                currentY = points->at(k + 1);
+                currentX = points[k + 0];
+                currentY = points[k + 1];
                 if (k > start) {
                     // According to the spec, if a moveto is followed by multiple
                     // pairs of coordinates, the subsequent pairs are treated as
                     // implicit lineto commands.
-                    outPath->lineTo(points->at(k + 0), points->at(k + 1));
+                    outPath->lineTo(points[k + 0], points[k + 1]);
                 } else {
-                    outPath->moveTo(points->at(k + 0), points->at(k + 1));
+                    outPath->moveTo(points[k + 0], points[k + 1]);
                     currentSegmentStartX = currentX;
                     currentSegmentStartY = currentY;
                 }
                 break;
             case 'l':  // lineto - Draw a line from the current point (relative)
-                outPath->rLineTo(points->at(k + 0), points->at(k + 1));
-                currentX += points->at(k + 0);
-                currentY += points->at(k + 1);
+                outPath->rLineTo(points[k + 0], points[k + 1]);
+                currentX += points[k + 0];
+                currentY += points[k + 1];
                 break;
             case 'L':  // lineto - Draw a line from the current point
-                outPath->lineTo(points->at(k + 0), points->at(k + 1));
-                currentX = points->at(k + 0);
-                currentY = points->at(k + 1);
+                outPath->lineTo(points[k + 0], points[k + 1]);
+                currentX = points[k + 0];
+                currentY = points[k + 1];
                 break;
             case 'h':  // horizontal lineto - Draws a horizontal line (relative)
-                outPath->rLineTo(points->at(k + 0), 0);
-                currentX += points->at(k + 0);
+                outPath->rLineTo(points[k + 0], 0);
+                currentX += points[k + 0];
                 break;
             case 'H':  // horizontal lineto - Draws a horizontal line
-                outPath->lineTo(points->at(k + 0), currentY);
-                currentX = points->at(k + 0);
+                outPath->lineTo(points[k + 0], currentY);
+                currentX = points[k + 0];
                 break;
             case 'v':  // vertical lineto - Draws a vertical line from the current point (r)
-                outPath->rLineTo(0, points->at(k + 0));
-                currentY += points->at(k + 0);
+                outPath->rLineTo(0, points[k + 0]);
+                currentY += points[k + 0];
                 break;
             case 'V':  // vertical lineto - Draws a vertical line from the current point
-                outPath->lineTo(currentX, points->at(k + 0));
-                currentY = points->at(k + 0);
+                outPath->lineTo(currentX, points[k + 0]);
+                currentY = points[k + 0];
                 break;
             case 'c':  // curveto - Draws a cubic Bézier curve (relative)
-                outPath->rCubicTo(points->at(k + 0), points->at(k + 1), points->at(k + 2),
-                                  points->at(k + 3), points->at(k + 4), points->at(k + 5));
+                outPath->rCubicTo(points[k + 0], points[k + 1], points[k + 2], points[k + 3],
+                                  points[k + 4], points[k + 5]);
 
-                ctrlPointX = currentX + points->at(k + 2);
-                ctrlPointY = currentY + points->at(k + 3);
-                currentX += points->at(k + 4);
-                currentY += points->at(k + 5);
+                ctrlPointX = currentX + points[k + 2];
+                ctrlPointY = currentY + points[k + 3];
+                currentX += points[k + 4];
+                currentY += points[k + 5];
 
                 break;
             case 'C':  // curveto - Draws a cubic Bézier curve
-                outPath->cubicTo(points->at(k + 0), points->at(k + 1), points->at(k + 2),
-                                 points->at(k + 3), points->at(k + 4), points->at(k + 5));
-                currentX = points->at(k + 4);
-                currentY = points->at(k + 5);
-                ctrlPointX = points->at(k + 2);
-                ctrlPointY = points->at(k + 3);
+                outPath->cubicTo(points[k + 0], points[k + 1], points[k + 2], points[k + 3],
+                                 points[k + 4], points[k + 5]);
+                currentX = points[k + 4];
+                currentY = points[k + 5];
+                ctrlPointX = points[k + 2];
+                ctrlPointY = points[k + 3];
                 break;
             case 's':  // smooth curveto - Draws a cubic Bézier curve (reflective cp)
                 reflectiveCtrlPointX = 0;
@@ -228,12 +216,12 @@ void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd,
                     reflectiveCtrlPointX = currentX - ctrlPointX;
                     reflectiveCtrlPointY = currentY - ctrlPointY;
                 }
-                outPath->rCubicTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points->at(k + 0),
-                                  points->at(k + 1), points->at(k + 2), points->at(k + 3));
-                ctrlPointX = currentX + points->at(k + 0);
-                ctrlPointY = currentY + points->at(k + 1);
-                currentX += points->at(k + 2);
-                currentY += points->at(k + 3);
+                outPath->rCubicTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points[k + 0],
+                                  points[k + 1], points[k + 2], points[k + 3]);
+                ctrlPointX = currentX + points[k + 0];
+                ctrlPointY = currentY + points[k + 1];
+                currentX += points[k + 2];
+                currentY += points[k + 3];
                 break;
             case 'S':  // shorthand/smooth curveto Draws a cubic Bézier curve(reflective cp)
                 reflectiveCtrlPointX = currentX;
@@ -243,28 +231,26 @@ void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd,
                     reflectiveCtrlPointX = 2 * currentX - ctrlPointX;
                     reflectiveCtrlPointY = 2 * currentY - ctrlPointY;
                 }
-                outPath->cubicTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points->at(k + 0),
-                                 points->at(k + 1), points->at(k + 2), points->at(k + 3));
-                ctrlPointX = points->at(k + 0);
-                ctrlPointY = points->at(k + 1);
-                currentX = points->at(k + 2);
-                currentY = points->at(k + 3);
+                outPath->cubicTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points[k + 0],
+                                 points[k + 1], points[k + 2], points[k + 3]);
+                ctrlPointX = points[k + 0];
+                ctrlPointY = points[k + 1];
+                currentX = points[k + 2];
+                currentY = points[k + 3];
                 break;
             case 'q':  // Draws a quadratic Bézier (relative)
-                outPath->rQuadTo(points->at(k + 0), points->at(k + 1), points->at(k + 2),
-                                 points->at(k + 3));
-                ctrlPointX = currentX + points->at(k + 0);
-                ctrlPointY = currentY + points->at(k + 1);
-                currentX += points->at(k + 2);
-                currentY += points->at(k + 3);
+                outPath->rQuadTo(points[k + 0], points[k + 1], points[k + 2], points[k + 3]);
+                ctrlPointX = currentX + points[k + 0];
+                ctrlPointY = currentY + points[k + 1];
+                currentX += points[k + 2];
+                currentY += points[k + 3];
                 break;
             case 'Q':  // Draws a quadratic Bézier
-                outPath->quadTo(points->at(k + 0), points->at(k + 1), points->at(k + 2),
-                                points->at(k + 3));
-                ctrlPointX = points->at(k + 0);
-                ctrlPointY = points->at(k + 1);
-                currentX = points->at(k + 2);
-                currentY = points->at(k + 3);
+                outPath->quadTo(points[k + 0], points[k + 1], points[k + 2], points[k + 3]);
+                ctrlPointX = points[k + 0];
+                ctrlPointY = points[k + 1];
+                currentX = points[k + 2];
+                currentY = points[k + 3];
                 break;
             case 't':  // Draws a quadratic Bézier curve(reflective control point)(relative)
                 reflectiveCtrlPointX = 0;
@@ -274,12 +260,12 @@ void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd,
                     reflectiveCtrlPointX = currentX - ctrlPointX;
                     reflectiveCtrlPointY = currentY - ctrlPointY;
                 }
-                outPath->rQuadTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points->at(k + 0),
-                                 points->at(k + 1));
+                outPath->rQuadTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points[k + 0],
+                                 points[k + 1]);
                 ctrlPointX = currentX + reflectiveCtrlPointX;
                 ctrlPointY = currentY + reflectiveCtrlPointY;
-                currentX += points->at(k + 0);
-                currentY += points->at(k + 1);
+                currentX += points[k + 0];
+                currentY += points[k + 1];
                 break;
             case 'T':  // Draws a quadratic Bézier curve (reflective control point)
                 reflectiveCtrlPointX = currentX;
@@ -289,31 +275,31 @@ void PathResolver::addCommand(SkPath* outPath, char previousCmd, char cmd,
                     reflectiveCtrlPointX = 2 * currentX - ctrlPointX;
                     reflectiveCtrlPointY = 2 * currentY - ctrlPointY;
                 }
-                outPath->quadTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points->at(k + 0),
-                                points->at(k + 1));
+                outPath->quadTo(reflectiveCtrlPointX, reflectiveCtrlPointY, points[k + 0],
+                                points[k + 1]);
                 ctrlPointX = reflectiveCtrlPointX;
                 ctrlPointY = reflectiveCtrlPointY;
-                currentX = points->at(k + 0);
-                currentY = points->at(k + 1);
+                currentX = points[k + 0];
+                currentY = points[k + 1];
                 break;
             case 'a':  // Draws an elliptical arc
                 // (rx ry x-axis-rotation large-arc-flag sweep-flag x y)
-                outPath->arcTo(points->at(k + 0), points->at(k + 1), points->at(k + 2),
-                               (SkPath::ArcSize) (points->at(k + 3) != 0),
-                               (SkPathDirection) (points->at(k + 4) == 0),
-                               points->at(k + 5) + currentX, points->at(k + 6) + currentY);
-                currentX += points->at(k + 5);
-                currentY += points->at(k + 6);
+                outPath->arcTo(points[k + 0], points[k + 1], points[k + 2],
+                               (SkPath::ArcSize) (points[k + 3] != 0),
+                               (SkPathDirection) (points[k + 4] == 0),
+                               points[k + 5] + currentX, points[k + 6] + currentY);
+                currentX += points[k + 5];
+                currentY += points[k + 6];
                 ctrlPointX = currentX;
                 ctrlPointY = currentY;
                 break;
             case 'A':  // Draws an elliptical arc
-                outPath->arcTo(points->at(k + 0), points->at(k + 1), points->at(k + 2),
-                               (SkPath::ArcSize) (points->at(k + 3) != 0),
-                               (SkPathDirection) (points->at(k + 4) == 0),
-                               points->at(k + 5), points->at(k + 6));
-                currentX = points->at(k + 5);
-                currentY = points->at(k + 6);
+                outPath->arcTo(points[k + 0], points[k + 1], points[k + 2],
+                               (SkPath::ArcSize) (points[k + 3] != 0),
+                               (SkPathDirection) (points[k + 4] == 0),
+                               points[k + 5], points[k + 6]);
+                currentX = points[k + 5];
+                currentY = points[k + 6];
                 ctrlPointX = currentX;
                 ctrlPointY = currentY;
                 break;
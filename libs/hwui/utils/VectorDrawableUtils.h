@@ -26,6 +26,22 @@
 namespace android {
 namespace uirenderer {
 
+/**
+ * Turns path commands into SkPath operations, tracking the pen and control point state that
+ * relative and smooth commands depend on between calls.
+ */
+class PathResolver {
+public:
+    float currentX = 0;
+    float currentY = 0;
+    float ctrlPointX = 0;
+    float ctrlPointY = 0;
+    float currentSegmentStartX = 0;
+    float currentSegmentStartY = 0;
+    void addCommand(SkPath* outPath, char previousCmd, char cmd, const float* points,
+                    size_t start, size_t end);
+};
+
 class VectorDrawableUtils {
 public:
     ANDROID_API static bool canMorph(const PathData& morphFrom, const PathData& morphTo);
@@ -91,6 +91,8 @@ PointerController::PointerController(const sp<PointerControllerPolicyInterface>&
     mLocked.pointerFadeDirection = 0;
     mLocked.pointerX = 0;
     mLocked.pointerY = 0;
+    mLocked.pointerPositionPending = false;
+    mLocked.displayEventsLost = false;
     mLocked.pointerAlpha = 0.0f; // pointer is initially faded
     mLocked.pointerSprite = mSpriteController->createSprite();
     mLocked.pointerIconChanged = false;
@@ -197,7 +199,18 @@ void PointerController::setPositionLocked(float x, float y) {
         } else {
             mLocked.pointerY = y;
         }
-        updatePointerLocked();
+
+        // A new position only needs to be shown on the next frame, so the sprite is moved on
+        // vsync to the latest position rather than on every event of a high polling rate mouse.
+        if (!mLocked.pointerPositionPending) {
+            if (!mLocked.displayEventsLost
+                    && mDisplayEventReceiver.initCheck() == NO_ERROR
+                    && mDisplayEventReceiver.requestNextVsync() == NO_ERROR) {
+                mLocked.pointerPositionPending = true;
+            } else {
+                updatePointerLocked();
+            }
+        }
     }
 }
 
@@ -492,6 +505,14 @@ int PointerController::handleEvent(int /* fd */, int events, void* /* data */) {
     if (events & (Looper::EVENT_ERROR | Looper::EVENT_HANGUP)) {
         ALOGE("Display event receiver pipe was closed or an error occurred.  "
               "events=0x%x", events);
+        // No vsync will come to move the pointer, so show any pending position now and
+        // move the sprite immediately from here on.
+        AutoMutex _l(mLock);
+        mLocked.displayEventsLost = true;
+        if (mLocked.pointerPositionPending) {
+            mLocked.pointerPositionPending = false;
+            updatePointerLocked();
+        }
         return 0; // remove the callback
     }
 
@@ -522,6 +543,15 @@ int PointerController::handleEvent(int /* fd */, int events, void* /* data */) {
 void PointerController::doAnimate(nsecs_t timestamp) {
     AutoMutex _l(mLock);
 
+    if (mLocked.pointerPositionPending) {
+        mLocked.pointerPositionPending = false;
+        updatePointerLocked();
+    }
+
+    // The vsync may have been requested only to move the pointer.
+    if (!mLocked.animationPending) {
+        return;
+    }
     mLocked.animationPending = false;
 
     bool keepFading = doFadingAnimationLocked(timestamp);
@@ -168,6 +168,9 @@ private:
         int32_t pointerFadeDirection;
         float pointerX;
         float pointerY;
+        bool pointerPositionPending;
+        // Set once the display event callback is removed, after which no vsync will arrive.
+        bool displayEventsLost;
         float pointerAlpha;
         sp<Sprite> pointerSprite;
         SpriteIcon pointerIcon;
@@ -30,6 +30,9 @@
 
 namespace android {
 
+// The maximum number of icon bitmap copies kept for reuse.
+static constexpr size_t MAX_ICON_BITMAP_COPIES = 32;
+
 // --- SpriteController ---
 
 SpriteController::SpriteController(const sp<Looper>& looper, int32_t overlayLayer) :
@@ -92,6 +95,21 @@ void SpriteController::disposeSurfaceLocked(const sp<SurfaceControl>& surfaceCon
     }
 }
 
+graphics::Bitmap SpriteController::copyIconBitmapLocked(const graphics::Bitmap& bitmap) {
+    const uint32_t generationId = bitmap.getGenerationId();
+    auto it = mLocked.iconBitmapCopies.find(generationId);
+    if (it != mLocked.iconBitmapCopies.end()) {
+        return it->second;
+    }
+
+    if (mLocked.iconBitmapCopies.size() >= MAX_ICON_BITMAP_COPIES) {
+        mLocked.iconBitmapCopies.clear();
+    }
+    graphics::Bitmap& copy = mLocked.iconBitmapCopies[generationId];
+    copy = bitmap.copy(ANDROID_BITMAP_FORMAT_RGBA_8888);
+    return copy;
+}
+
 void SpriteController::handleMessage(const Message& message) {
     switch (message.what) {
     case MSG_UPDATE_SPRITES:
@@ -143,8 +161,11 @@ void SpriteController::doUpdateSprites() {
     }
 
     // Resize and/or reparent sprites if needed.
+    // Only resizes have to be applied before the sprites are redrawn, other changes are applied
+    // along with the rest of the sprite updates in a single transaction.
     SurfaceComposerClient::Transaction t;
     bool needApplyTransaction = false;
+    bool needResize = false;
     for (size_t i = 0; i < numSprites; i++) {
         SpriteUpdate& update = updates.editItemAt(i);
         if (update.state.surfaceControl == nullptr) {
@@ -156,7 +177,7 @@ void SpriteController::doUpdateSprites() {
             int32_t desiredHeight = update.state.icon.bitmap.getInfo().height;
             if (update.state.surfaceWidth < desiredWidth
                     || update.state.surfaceHeight < desiredHeight) {
-                needApplyTransaction = true;
+                needResize = true;
 
                 t.setSize(update.state.surfaceControl,
                         desiredWidth, desiredHeight);
@@ -178,8 +199,9 @@ void SpriteController::doUpdateSprites() {
             needApplyTransaction = true;
         }
     }
-    if (needApplyTransaction) {
+    if (needResize) {
         t.apply();
+        needApplyTransaction = false;
     }
 
     // Redraw sprites if needed.
@@ -228,7 +250,6 @@ void SpriteController::doUpdateSprites() {
         }
     }
 
-    needApplyTransaction = false;
     for (size_t i = 0; i < numSprites; i++) {
         SpriteUpdate& update = updates.editItemAt(i);
 
@@ -392,15 +413,15 @@ void SpriteController::SpriteImpl::setIcon(const SpriteIcon& icon) {
 
     uint32_t dirty;
     if (icon.isValid()) {
-        mLocked.state.icon.bitmap = icon.bitmap.copy(ANDROID_BITMAP_FORMAT_RGBA_8888);
-        if (!mLocked.state.icon.isValid()
-                || mLocked.state.icon.hotSpotX != icon.hotSpotX
+        graphics::Bitmap bitmap = mController->copyIconBitmapLocked(icon.bitmap);
+        // Setting the icon the sprite already shows doesn't need it to be redrawn.
+        dirty = bitmap.get() != mLocked.state.icon.bitmap.get() ? DIRTY_BITMAP : 0;
+        mLocked.state.icon.bitmap = bitmap;
+        if (mLocked.state.icon.hotSpotX != icon.hotSpotX
                 || mLocked.state.icon.hotSpotY != icon.hotSpotY) {
             mLocked.state.icon.hotSpotX = icon.hotSpotX;
             mLocked.state.icon.hotSpotY = icon.hotSpotY;
-            dirty = DIRTY_BITMAP | DIRTY_HOTSPOT;
-        } else {
-            dirty = DIRTY_BITMAP;
+            dirty |= DIRTY_BITMAP | DIRTY_HOTSPOT;
         }
 
         if (mLocked.state.icon.style != icon.style) {
@@ -414,6 +435,10 @@ void SpriteController::SpriteImpl::setIcon(const SpriteIcon& icon) {
         return; // setting to invalid icon and already invalid so nothing to do
     }
 
+    if (!dirty) {
+        return; // same icon as before so nothing to do
+    }
+
     invalidateLocked(dirty);
 }
 
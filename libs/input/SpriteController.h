@@ -23,6 +23,8 @@
 #include <android/graphics/bitmap.h>
 #include <gui/SurfaceComposerClient.h>
 
+#include <map>
+
 namespace android {
 
 /*
@@ -281,10 +283,16 @@ private:
         Vector<sp<SurfaceControl> > disposedSurfaces;
         uint32_t transactionNestingCount;
         bool deferredSpriteUpdate;
+        // Icons are set repeatedly as pointer animations cycle through their frames and as
+        // spots come and go, so their copies are shared rather than made on every change.
+        // Keyed by the generation id of the source, which is unique to its current pixels,
+        // so the sources themselves don't need to be kept alive.
+        std::map<uint32_t, graphics::Bitmap> iconBitmapCopies;
     } mLocked; // guarded by mLock
 
     void invalidateSpriteLocked(const sp<SpriteImpl>& sprite);
     void disposeSurfaceLocked(const sp<SurfaceControl>& surfaceControl);
+    graphics::Bitmap copyIconBitmapLocked(const graphics::Bitmap& bitmap);
 
     void handleMessage(const Message& message);
     void doUpdateSprites();
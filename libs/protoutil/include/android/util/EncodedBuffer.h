@@ -72,6 +72,14 @@ public:
      */
     void clear();
 
+    /**
+     * Releases the memory of chunks cached for reuse by the calling thread and the process-wide
+     * cache. Chunks of freed EncodedBuffers are kept to back new ones, so call this after a burst
+     * of work, e.g. taking an incident report, to give the memory back.
+     * Thread safe.
+     */
+    static void trimChunkCache();
+
     /******************************** Write APIs ************************************************/
 
     /**
@@ -177,6 +185,17 @@ public:
      */
     void copy(size_t srcPos, size_t size);
 
+    /**
+     * Overwrite _size_ bytes starting at __pos__ with buf. The bytes must already be written.
+     */
+    void editRaw(size_t pos, uint8_t const* buf, size_t size);
+
+    /**
+     * Move _size_ bytes of data starting at __srcPos__ to __dstPos__, which must be larger than
+     * srcPos. The ranges may overlap. The destination must already be written.
+     */
+    void moveForward(size_t srcPos, size_t dstPos, size_t size);
+
     /********************************* Read APIs ************************************************/
     /**
      * Returns the Reader of EncodedBuffer so it guarantees consumers won't be able to
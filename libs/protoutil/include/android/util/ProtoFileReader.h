@@ -20,6 +20,7 @@
 #include <string>
 
 #include <android/util/EncodedBuffer.h>
+#include <android/util/ProtoSpanReader.h>
 
 namespace android {
 namespace util {
@@ -55,7 +56,7 @@ private:
     int mFd;                // File descriptor for input.
     status_t mStatus;       // Any errors encountered during read.
     ssize_t mSize;          // How much total data there is, or -1 if we can't tell.
-    size_t mPos;            // How much data has been read so far.
+    size_t mPos;            // How much data has been read so far, in and past mBuffer.
     size_t mOffset;         // Offset in current buffer.
     size_t mMaxOffset;      // How much data is left to read in mBuffer.
     const int mChunkSize;   // Size of mBuffer.
@@ -70,6 +71,33 @@ private:
     bool ensure_data();
 };
 
+/**
+ * A ProtoReader on top of a file descriptor that maps the file instead of reading it, so
+ * the whole file is one span for ProtoSpanReader. Reads from the current offset of the
+ * file descriptor to the end of the file, without moving the offset.
+ *
+ * Only works for regular files; if the file can't be mapped, getError() says so right
+ * after construction, and the caller should fall back to a ProtoFileReader. The file
+ * must not be truncated while the reader is alive.
+ */
+class ProtoMappedFileReader : public ProtoSpanReader
+{
+public:
+    /**
+     * Map this file descriptor.
+     */
+    ProtoMappedFileReader(int fd);
+
+    /**
+     * Unmaps the file. Does NOT close the file.
+     */
+    virtual ~ProtoMappedFileReader();
+
+private:
+    void* mMap;             // Start of the mapping, or NULL if nothing is mapped.
+    size_t mMapSize;        // Size of the mapping.
+};
+
 }
 }
 
@@ -18,10 +18,13 @@
 #define ANDROID_UTIL_PROTOOUTPUT_STREAM_H
 
 #include <cstdint>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include <android/util/EncodedBuffer.h>
+#include <android/util/protobuf.h>
 
 namespace android {
 namespace util {
@@ -68,7 +71,7 @@ const uint64_t FIELD_TYPE_SINT64   = 18ULL << FIELD_TYPE_SHIFT;  // int64, ZigZa
 
 //
 // FieldId flags for whether the field is single, repeated or packed.
-// TODO: packed is not supported yet.
+// Packed fields can only be written in bulk, with writePacked.
 //
 const uint64_t FIELD_COUNT_SHIFT = 40;
 const uint64_t FIELD_COUNT_MASK = 0x0fULL << FIELD_COUNT_SHIFT;
@@ -85,12 +88,20 @@ const uint64_t FIELD_COUNT_PACKED = 5ULL << FIELD_COUNT_SHIFT;
  * and then end when you are done.
  *
  * See the java version implementation (ProtoOutputStream.java) for more infos.
+ *
+ * By default the size of each sub-message is filled in by a compaction pass over the whole
+ * buffer once writing is done. With inPlaceSizes, sizes are instead written at end() into a
+ * two byte varint reserved at start(), padded if the size is smaller, so there is no
+ * compaction pass or copy. Sub-messages that outgrow the reserved varint are widened when
+ * the data is first read, which moves only the data after them. The output is valid protobuf
+ * but may be a few bytes larger.
  */
 class ProtoOutputStream
 {
 public:
     ProtoOutputStream();
     ProtoOutputStream(sp<EncodedBuffer> buffer);
+    ProtoOutputStream(sp<EncodedBuffer> buffer, bool inPlaceSizes);
     ~ProtoOutputStream();
 
     /**
@@ -105,6 +116,27 @@ public:
     bool write(uint64_t fieldId, std::string val);
     bool write(uint64_t fieldId, const char* val, size_t size);
 
+    /**
+     * Writes a field whose id and type are compile-time constants, e.g.
+     *     proto.write<FIELD_TYPE_INT64 | FIELD_COUNT_SINGLE | FIELD_ID_FOO>(val);
+     * The wire type and tag are resolved by the compiler, so this skips the type dispatch of
+     * write(fieldId, val). Only scalar types are supported. Returns true if the write succeeds.
+     */
+    template<uint64_t fieldId, typename T>
+    bool write(T val);
+
+    /**
+     * Writes n values of a packed repeated field in a single length-delimited record. The
+     * fieldId must have FIELD_COUNT_PACKED and a scalar type. Nothing is written when n is 0.
+     * Returns true if the write succeeds.
+     */
+    bool writePacked(uint64_t fieldId, const double* vals, size_t n);
+    bool writePacked(uint64_t fieldId, const float* vals, size_t n);
+    bool writePacked(uint64_t fieldId, const int32_t* vals, size_t n);
+    bool writePacked(uint64_t fieldId, const int64_t* vals, size_t n);
+    bool writePacked(uint64_t fieldId, const uint32_t* vals, size_t n);
+    bool writePacked(uint64_t fieldId, const uint64_t* vals, size_t n);
+
     /**
      * Starts a sub-message write session.
      * Returns a token of this write session.
@@ -147,6 +179,21 @@ private:
     uint32_t mObjectId;
     uint64_t mExpectedObjectToken;
 
+    // With inPlaceSizes, the state of the sub-messages being written, which would otherwise
+    // be kept in the buffer, and the sub-messages whose sizes didn't fit.
+    struct OpenObject {
+        uint64_t prevToken;
+        size_t growthAtStart;
+    };
+    struct OversizedObject {
+        size_t sizePos;
+        size_t encodedSize;
+    };
+    const bool mInPlaceSizes;
+    std::vector<OpenObject> mOpenObjects;
+    std::vector<OversizedObject> mOversizedObjects;
+    size_t mGrowth; // Bytes needed to widen the sizes of mOversizedObjects.
+
     inline void writeDoubleImpl(uint32_t id, double val);
     inline void writeFloatImpl(uint32_t id, float val);
     inline void writeInt64Impl(uint32_t id, int64_t val);
@@ -167,11 +214,74 @@ private:
     bool compact();
     size_t editEncodedSize(size_t rawSize);
     bool compactSize(size_t rawSize);
+    void endInPlace(uint64_t token, uint32_t sizePos);
+    void widenOversizedObjects();
 
     template<typename T>
     bool internalWrite(uint64_t fieldId, T val, const char* typeName);
+
+    template<typename T>
+    bool internalWritePacked(uint64_t fieldId, const T* vals, size_t n, const char* typeName);
+    template<typename T, typename Encode>
+    void writePackedVarintImpl(uint32_t id, const T* vals, size_t n, Encode encode);
+    template<typename T, typename Encode>
+    void writePackedFixed32Impl(uint32_t id, const T* vals, size_t n, Encode encode);
+    template<typename T, typename Encode>
+    void writePackedFixed64Impl(uint32_t id, const T* vals, size_t n, Encode encode);
 };
 
+template<uint64_t fieldId, typename T>
+inline bool
+ProtoOutputStream::write(T val)
+{
+    constexpr uint64_t type = fieldId & FIELD_TYPE_MASK;
+    constexpr uint32_t id = (uint32_t)fieldId;
+    static_assert(std::is_arithmetic<T>::value, "write<fieldId> only takes scalar values");
+    static_assert(type != FIELD_TYPE_UNKNOWN && type != FIELD_TYPE_STRING
+            && type != FIELD_TYPE_MESSAGE && type != FIELD_TYPE_BYTES,
+            "write<fieldId> only supports scalar field types");
+
+    if (mCompact) return false;
+    if constexpr (type == FIELD_TYPE_DOUBLE) {
+        double d = (double)val;
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_FIXED64);
+        mBuffer->writeRawFixed64(bits);
+    } else if constexpr (type == FIELD_TYPE_FLOAT) {
+        float f = (float)val;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_FIXED32);
+        mBuffer->writeRawFixed32(bits);
+    } else if constexpr (type == FIELD_TYPE_FIXED64 || type == FIELD_TYPE_SFIXED64) {
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_FIXED64);
+        mBuffer->writeRawFixed64((uint64_t)(int64_t)val);
+    } else if constexpr (type == FIELD_TYPE_FIXED32 || type == FIELD_TYPE_SFIXED32) {
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_FIXED32);
+        mBuffer->writeRawFixed32((uint32_t)(int32_t)val);
+    } else if constexpr (type == FIELD_TYPE_SINT64) {
+        int64_t v = (int64_t)val;
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+        mBuffer->writeRawVarint64(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+    } else if constexpr (type == FIELD_TYPE_SINT32) {
+        int32_t v = (int32_t)val;
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+        mBuffer->writeRawVarint32(((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+    } else if constexpr (type == FIELD_TYPE_BOOL) {
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+        mBuffer->writeRawVarint32(val != 0 ? 1 : 0);
+    } else if constexpr (type == FIELD_TYPE_INT64 || type == FIELD_TYPE_UINT64) {
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+        mBuffer->writeRawVarint64((uint64_t)(int64_t)val);
+    } else {
+        // INT32, UINT32 and ENUM, encoded the same way as write(fieldId, val) does.
+        mBuffer->writeRawVarint32((id << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+        mBuffer->writeRawVarint32((uint32_t)(int32_t)val);
+    }
+    return true;
+}
+
 }
 }
 
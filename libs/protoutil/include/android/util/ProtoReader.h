@@ -70,6 +70,13 @@ public:
      * Advance the read pointer.
      */
     virtual void move(size_t amt) = 0;
+
+    /**
+     * Skip the value of a field whose tag has just been read. Length-delimited fields are
+     * skipped with a single move(), without reading through their contents. Returns false
+     * if the wire type is not known.
+     */
+    bool skipField(uint32_t fieldTag);
 };
 
 } // util
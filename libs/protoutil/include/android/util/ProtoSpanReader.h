@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <android/util/ProtoReader.h>
+
+namespace android {
+namespace util {
+
+/**
+ * A ProtoReader over a single contiguous buffer, such as a serialized proto in memory.
+ *
+ * Unlike the chunked readers, the whole input is one span, so varints are decoded without
+ * boundary checks per byte, and move() (and so skipping a length-delimited field) is O(1).
+ * Does NOT copy or own the data, which must outlive the reader.
+ */
+class ProtoSpanReader : public ProtoReader
+{
+public:
+    ProtoSpanReader(const uint8_t* data, size_t size);
+    virtual ~ProtoSpanReader();
+
+    // From ProtoReader.
+    virtual ssize_t size() const;
+    virtual size_t bytesRead() const;
+    virtual uint8_t const* readBuffer();
+    virtual size_t currentToRead();
+    virtual bool hasNext();
+    virtual uint8_t next();
+    virtual uint64_t readRawVarint();
+    virtual void move(size_t amt);
+
+    /**
+     * Returns the next size bytes and moves past them, or NULL if fewer than size bytes
+     * are left. Lets callers take a length-delimited field without copying it.
+     */
+    const uint8_t* readSpan(size_t size);
+
+    status_t getError() const;
+
+protected:
+    ProtoSpanReader();
+
+    /**
+     * For subclasses that only get their data after construction.
+     */
+    void setSpan(const uint8_t* data, size_t size);
+
+    status_t mStatus;       // Any errors encountered during read.
+
+private:
+    const uint8_t* mData;   // Start of the span.
+    size_t mSize;           // Size of the span.
+    size_t mPos;            // How much data has been read so far.
+};
+
+}
+}
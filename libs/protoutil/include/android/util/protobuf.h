@@ -45,12 +45,28 @@ uint32_t read_field_id(uint32_t varint);
  */
 size_t get_varint_size(uint64_t varint);
 
+/**
+ * The largest number of bytes a varint can take, for a 64-bit value.
+ */
+const size_t MAX_VARINT_SIZE = 10;
+
 /**
  * Write a varint into the buffer. Return the next position to write at.
  * There must be 10 bytes in the buffer.
  */
 uint8_t* write_raw_varint(uint8_t* buf, uint64_t val);
 
+/**
+ * Write a little-endian 32-bit value into the buffer. There must be 4 bytes in the buffer.
+ */
+inline void write_raw_fixed32(uint8_t* buf, uint32_t val)
+{
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
 /**
  * Write a protobuf WIRE_TYPE_LENGTH_DELIMITED header. Return the next position
  * to write at. There must be 20 bytes in the buffer.
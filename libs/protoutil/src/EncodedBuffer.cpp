@@ -15,7 +15,12 @@
  */
 #define LOG_TAG "libprotoutil"
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 
 #include <android/util/EncodedBuffer.h>
@@ -27,6 +32,103 @@ namespace util {
 
 const size_t BUFFER_SIZE = 8 * 1024; // 8 KB
 
+// ===========================================================
+// Chunks are mmapped, so every EncodedBuffer used to cost a pair of syscalls per chunk. Freed
+// chunks are instead cached by size class, first in a small per-thread cache that needs no
+// locking, then in a process-wide pool bounded by total size. Chunks larger than
+// MAX_CACHED_CHUNK_PAGES are uncommon and always unmapped.
+const size_t MAX_CACHED_CHUNK_PAGES = 16;
+const size_t MAX_THREAD_CACHED_CHUNKS = 8; // per size class
+const size_t MAX_SHARED_CACHED_BYTES = 1024 * 1024; // 1 MB across size classes
+
+// The size class of a chunk is its size in pages, rounded up so that a chunk taken from a class
+// is never smaller than the chunk it is used for.
+static size_t chunk_pages(size_t chunkSize) {
+    return (chunkSize + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+struct SharedChunkPool {
+    std::mutex lock;
+    std::vector<uint8_t*> chunks[MAX_CACHED_CHUNK_PAGES + 1];
+    size_t bytes = 0;
+};
+
+static SharedChunkPool* shared_chunk_pool() {
+    // Never destroyed, so threads exiting during static destruction can still return chunks.
+    static SharedChunkPool* pool = new SharedChunkPool();
+    return pool;
+}
+
+static void release_to_shared_pool(uint8_t* chunk, size_t chunkSize) {
+    SharedChunkPool* pool = shared_chunk_pool();
+    const size_t pages = chunk_pages(chunkSize);
+    {
+        std::lock_guard<std::mutex> lock(pool->lock);
+        // Accounted by size class, the same way allocate_chunk() takes chunks back out.
+        if (pool->bytes + pages * PAGE_SIZE <= MAX_SHARED_CACHED_BYTES) {
+            pool->chunks[pages].push_back(chunk);
+            pool->bytes += pages * PAGE_SIZE;
+            return;
+        }
+    }
+    munmap(chunk, chunkSize);
+}
+
+struct ThreadChunkCache {
+    std::vector<uint8_t*> chunks[MAX_CACHED_CHUNK_PAGES + 1];
+
+    void trim() {
+        for (size_t pages = 0; pages <= MAX_CACHED_CHUNK_PAGES; pages++) {
+            for (uint8_t* chunk : chunks[pages]) {
+                release_to_shared_pool(chunk, pages * PAGE_SIZE);
+            }
+            chunks[pages].clear();
+        }
+    }
+
+    ~ThreadChunkCache() { trim(); }
+};
+
+static thread_local ThreadChunkCache gThreadChunkCache;
+
+static uint8_t* allocate_chunk(size_t chunkSize) {
+    const size_t pages = chunk_pages(chunkSize);
+    if (pages <= MAX_CACHED_CHUNK_PAGES) {
+        std::vector<uint8_t*>& local = gThreadChunkCache.chunks[pages];
+        if (!local.empty()) {
+            uint8_t* chunk = local.back();
+            local.pop_back();
+            return chunk;
+        }
+        SharedChunkPool* pool = shared_chunk_pool();
+        std::lock_guard<std::mutex> lock(pool->lock);
+        if (!pool->chunks[pages].empty()) {
+            uint8_t* chunk = pool->chunks[pages].back();
+            pool->chunks[pages].pop_back();
+            pool->bytes -= pages * PAGE_SIZE;
+            return chunk;
+        }
+    }
+    // Use mmap instead of malloc to ensure memory alignment i.e. no fragmentation so that
+    // the mem region can be immediately reused by the allocator after calling munmap()
+    void* chunk = mmap(NULL, chunkSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    return chunk == MAP_FAILED ? NULL : (uint8_t*)chunk;
+}
+
+static void free_chunk(uint8_t* chunk, size_t chunkSize) {
+    const size_t pages = chunk_pages(chunkSize);
+    if (pages > MAX_CACHED_CHUNK_PAGES) {
+        munmap(chunk, chunkSize);
+        return;
+    }
+    std::vector<uint8_t*>& local = gThreadChunkCache.chunks[pages];
+    if (local.size() < MAX_THREAD_CACHED_CHUNKS) {
+        local.push_back(chunk);
+        return;
+    }
+    release_to_shared_pool(chunk, chunkSize);
+}
+
 EncodedBuffer::Pointer::Pointer() : Pointer(BUFFER_SIZE)
 {
 }
@@ -100,11 +202,25 @@ EncodedBuffer::EncodedBuffer(size_t chunkSize)
 EncodedBuffer::~EncodedBuffer()
 {
     for (size_t i=0; i<mBuffers.size(); i++) {
-        uint8_t* buf = mBuffers[i];
-        munmap(buf, mChunkSize);
+        free_chunk(mBuffers[i], mChunkSize);
     }
 }
 
+void
+EncodedBuffer::trimChunkCache()
+{
+    gThreadChunkCache.trim();
+    SharedChunkPool* pool = shared_chunk_pool();
+    std::lock_guard<std::mutex> lock(pool->lock);
+    for (size_t pages = 0; pages <= MAX_CACHED_CHUNK_PAGES; pages++) {
+        for (uint8_t* chunk : pool->chunks[pages]) {
+            munmap(chunk, pages * PAGE_SIZE);
+        }
+        pool->chunks[pages].clear();
+    }
+    pool->bytes = 0;
+}
+
 inline uint8_t*
 EncodedBuffer::at(const Pointer& p) const
 {
@@ -138,10 +254,7 @@ EncodedBuffer::writeBuffer()
     if (mWp.index() > mBuffers.size()) return NULL;
     uint8_t* buf = NULL;
     if (mWp.index() == mBuffers.size()) {
-        // Use mmap instead of malloc to ensure memory alignment i.e. no fragmentation so that
-        // the mem region can be immediately reused by the allocator after calling munmap()
-        buf = (uint8_t*)mmap(NULL, mChunkSize, PROT_READ | PROT_WRITE,
-                MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+        buf = allocate_chunk(mChunkSize);
 
         if (buf == NULL) return NULL; // This indicates NO_MEMORY
 
@@ -166,6 +279,15 @@ EncodedBuffer::writeRawByte(uint8_t val)
 size_t
 EncodedBuffer::writeRawVarint64(uint64_t val)
 {
+    // Most of the time the whole varint fits in the current chunk, so encode it in place and
+    // move the write pointer once instead of checking the chunk for every byte.
+    uint8_t* buf = writeBuffer();
+    if (buf != NULL && currentToWrite() >= MAX_VARINT_SIZE) {
+        size_t size = write_raw_varint(buf, val) - buf;
+        mWp.move(size);
+        return size;
+    }
+
     size_t size = 0;
     while (true) {
         size++;
@@ -189,6 +311,12 @@ EncodedBuffer::writeRawVarint32(uint32_t val)
 void
 EncodedBuffer::writeRawFixed32(uint32_t val)
 {
+    uint8_t* buf = writeBuffer();
+    if (buf != NULL && currentToWrite() >= sizeof(val)) {
+        write_raw_fixed32(buf, val);
+        mWp.move(sizeof(val));
+        return;
+    }
     writeRawByte((uint8_t) val);
     writeRawByte((uint8_t) (val>>8));
     writeRawByte((uint8_t) (val>>16));
@@ -198,6 +326,13 @@ EncodedBuffer::writeRawFixed32(uint32_t val)
 void
 EncodedBuffer::writeRawFixed64(uint64_t val)
 {
+    uint8_t* buf = writeBuffer();
+    if (buf != NULL && currentToWrite() >= sizeof(val)) {
+        write_raw_fixed32(buf, (uint32_t)val);
+        write_raw_fixed32(buf + 4, (uint32_t)(val >> 32));
+        mWp.move(sizeof(val));
+        return;
+    }
     writeRawByte((uint8_t) val);
     writeRawByte((uint8_t) (val>>8));
     writeRawByte((uint8_t) (val>>16));
@@ -345,6 +480,39 @@ EncodedBuffer::copy(size_t srcPos, size_t size)
     }
 }
 
+void
+EncodedBuffer::editRaw(size_t pos, uint8_t const* buf, size_t size)
+{
+    while (size > 0) {
+        size_t index = pos / mChunkSize;
+        size_t offset = pos % mChunkSize;
+        size_t chunk = std::min(size, mChunkSize - offset);
+        memcpy(mBuffers[index] + offset, buf, chunk);
+        pos += chunk;
+        buf += chunk;
+        size -= chunk;
+    }
+}
+
+void
+EncodedBuffer::moveForward(size_t srcPos, size_t dstPos, size_t size)
+{
+    // Go from the end backwards, so overlapping data isn't overwritten before it is moved.
+    size_t srcEnd = srcPos + size;
+    size_t dstEnd = dstPos + size;
+    while (size > 0) {
+        // How much data there is before the ends in their current chunks.
+        size_t srcAvail = (srcEnd - 1) % mChunkSize + 1;
+        size_t dstAvail = (dstEnd - 1) % mChunkSize + 1;
+        size_t chunk = std::min(size, std::min(srcAvail, dstAvail));
+        memmove(mBuffers[(dstEnd - 1) / mChunkSize] + dstAvail - chunk,
+                mBuffers[(srcEnd - 1) / mChunkSize] + srcAvail - chunk, chunk);
+        srcEnd -= chunk;
+        dstEnd -= chunk;
+        size -= chunk;
+    }
+}
+
 /********************************* Read APIs ************************************************/
 sp<ProtoReader>
 EncodedBuffer::read()
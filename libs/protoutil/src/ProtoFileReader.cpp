@@ -21,6 +21,8 @@
 #include <cinttypes>
 #include <type_traits>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 namespace android {
@@ -99,6 +101,7 @@ ProtoFileReader::next()
         // Shouldn't get to here.  Always call hasNext() before calling next().
         return 0;
     }
+    mPos++;
     return mBuffer[mOffset++];
 }
 
@@ -124,12 +127,27 @@ void
 ProtoFileReader::move(size_t amt)
 {
     while (mStatus == NO_ERROR && amt > 0) {
+        // Once the buffer is used up, seek over large skips instead of reading through them.
+        // Only the data that was there when we started is known to be seekable.
+        if (mOffset == mMaxOffset && amt >= (size_t)mChunkSize
+                && mSize >= 0 && (size_t)mSize > mPos) {
+            const size_t left = mSize - mPos;
+            const size_t skip = left > amt ? amt : left;
+            if (lseek(mFd, skip, SEEK_CUR) < 0) {
+                mStatus = -errno;
+                return;
+            }
+            mPos += skip;
+            amt -= skip;
+            continue;
+        }
         if (!ensure_data()) {
             return;
         }
         const size_t chunk =
                 mMaxOffset - mOffset > amt ? amt : mMaxOffset - mOffset;
         mOffset += chunk;
+        mPos += chunk;
         amt -= chunk;
     }
 }
@@ -160,6 +178,43 @@ ProtoFileReader::ensure_data() {
     }
 }
 
+// =========================================================================
+ProtoMappedFileReader::ProtoMappedFileReader(int fd)
+        :ProtoSpanReader(),
+         mMap(NULL),
+         mMapSize(0) {
+    struct stat st;
+    off_t current = lseek(fd, 0, SEEK_CUR);
+    if (current < 0 || fstat(fd, &st) != 0) {
+        mStatus = -errno;
+        return;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        mStatus = INVALID_OPERATION;
+        return;
+    }
+    if (st.st_size <= current) {
+        // Nothing left to read, and mmap doesn't take empty mappings.
+        return;
+    }
+    // Map from the start of the file, since the mapping has to start on a page boundary.
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        mStatus = -errno;
+        return;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    mMap = map;
+    mMapSize = st.st_size;
+    setSpan(static_cast<const uint8_t*>(map) + current, st.st_size - current);
+}
+
+ProtoMappedFileReader::~ProtoMappedFileReader() {
+    if (mMap != NULL) {
+        munmap(mMap, mMapSize);
+    }
+}
+
 
 } // util
 } // android
@@ -15,6 +15,7 @@
  */
 #define LOG_TAG "libprotoutil"
 
+#include <algorithm>
 #include <cinttypes>
 #include <type_traits>
 
@@ -26,17 +27,33 @@
 namespace android {
 namespace util {
 
+/**
+ * With inPlaceSizes, the size of a sub-message is a varint of this many bytes, so it holds
+ * sizes up to MAX_IN_PLACE_SIZE.
+ */
+const size_t IN_PLACE_SIZE_BYTES = 2;
+const size_t MAX_IN_PLACE_SIZE = (1 << (7 * IN_PLACE_SIZE_BYTES)) - 1;
+
 ProtoOutputStream::ProtoOutputStream(): ProtoOutputStream(new EncodedBuffer())
 {
 }
 
 ProtoOutputStream::ProtoOutputStream(sp<EncodedBuffer> buffer)
+        :ProtoOutputStream(buffer, false)
+{
+}
+
+ProtoOutputStream::ProtoOutputStream(sp<EncodedBuffer> buffer, bool inPlaceSizes)
         :mBuffer(buffer),
          mCopyBegin(0),
          mCompact(false),
          mDepth(0),
          mObjectId(0),
-         mExpectedObjectToken(UINT64_C(-1))
+         mExpectedObjectToken(UINT64_C(-1)),
+         mInPlaceSizes(inPlaceSizes),
+         mOpenObjects(),
+         mOversizedObjects(),
+         mGrowth(0)
 {
 }
 
@@ -54,6 +71,9 @@ ProtoOutputStream::clear()
     mDepth = 0;
     mObjectId = 0;
     mExpectedObjectToken = UINT64_C(-1);
+    mOpenObjects.clear();
+    mOversizedObjects.clear();
+    mGrowth = 0;
 }
 
 template<typename T>
@@ -206,6 +226,42 @@ ProtoOutputStream::write(uint64_t fieldId, const char* val, size_t size)
     }
 }
 
+bool
+ProtoOutputStream::writePacked(uint64_t fieldId, const double* vals, size_t n)
+{
+    return internalWritePacked(fieldId, vals, n, "double");
+}
+
+bool
+ProtoOutputStream::writePacked(uint64_t fieldId, const float* vals, size_t n)
+{
+    return internalWritePacked(fieldId, vals, n, "float");
+}
+
+bool
+ProtoOutputStream::writePacked(uint64_t fieldId, const int32_t* vals, size_t n)
+{
+    return internalWritePacked(fieldId, vals, n, "int32_t");
+}
+
+bool
+ProtoOutputStream::writePacked(uint64_t fieldId, const int64_t* vals, size_t n)
+{
+    return internalWritePacked(fieldId, vals, n, "int64_t");
+}
+
+bool
+ProtoOutputStream::writePacked(uint64_t fieldId, const uint32_t* vals, size_t n)
+{
+    return internalWritePacked(fieldId, vals, n, "uint32_t");
+}
+
+bool
+ProtoOutputStream::writePacked(uint64_t fieldId, const uint64_t* vals, size_t n)
+{
+    return internalWritePacked(fieldId, vals, n, "uint64_t");
+}
+
 /**
  * Make a token.
  *  Bits 61-63 - tag size (So we can go backwards later if the object had not data)
@@ -264,7 +320,15 @@ ProtoOutputStream::start(uint64_t fieldId)
 
     mDepth++;
     mObjectId++;
-    mBuffer->writeRawFixed64(mExpectedObjectToken); // push previous token into stack.
+    if (mInPlaceSizes) {
+        mOpenObjects.push_back({ mExpectedObjectToken, mGrowth });
+        // reserves the size, end fills it in.
+        for (size_t i = 0; i < IN_PLACE_SIZE_BYTES; i++) {
+            mBuffer->writeRawByte(0);
+        }
+    } else {
+        mBuffer->writeRawFixed64(mExpectedObjectToken); // push previous token into stack.
+    }
 
     mExpectedObjectToken = makeToken(sizePos - prevPos,
         (bool)(fieldId & FIELD_COUNT_REPEATED), mDepth, mObjectId, sizePos);
@@ -289,6 +353,10 @@ ProtoOutputStream::end(uint64_t token)
     mDepth--;
 
     uint32_t sizePos = getSizePosFromToken(token);
+    if (mInPlaceSizes) {
+        endInPlace(token, sizePos);
+        return;
+    }
     // number of bytes written in this start-end session.
     int childRawSize = mBuffer->wp()->pos() - sizePos - 8;
 
@@ -306,6 +374,36 @@ ProtoOutputStream::end(uint64_t token)
     }
 }
 
+void
+ProtoOutputStream::endInPlace(uint64_t token, uint32_t sizePos)
+{
+    // retrieve the old token from stack.
+    OpenObject object = mOpenObjects.back();
+    mOpenObjects.pop_back();
+    mExpectedObjectToken = object.prevToken;
+
+    size_t rawSize = mBuffer->wp()->pos() - sizePos - IN_PLACE_SIZE_BYTES;
+    if (rawSize == 0) {
+        // reset wp which erase the header tag of the message when its size is 0.
+        mBuffer->wp()->rewind()->move(sizePos - getTagSizeFromToken(token));
+        return;
+    }
+
+    // Only sub-messages of messages that are themselves too big can have been widened.
+    size_t encodedSize = rawSize + (mGrowth - object.growthAtStart);
+    if (encodedSize <= MAX_IN_PLACE_SIZE) {
+        // A varint padded to the reserved size, with a continuation bit on all but the last byte.
+        uint8_t size[IN_PLACE_SIZE_BYTES] = {
+            (uint8_t)(0x80 | (encodedSize & 0x7F)),
+            (uint8_t)(encodedSize >> 7),
+        };
+        mBuffer->editRaw(sizePos, size, sizeof(size));
+    } else {
+        mOversizedObjects.push_back({ sizePos, encodedSize });
+        mGrowth += get_varint_size(encodedSize) - IN_PLACE_SIZE_BYTES;
+    }
+}
+
 size_t
 ProtoOutputStream::bytesWritten()
 {
@@ -319,6 +417,12 @@ ProtoOutputStream::compact() {
         ALOGE("Can't compact when depth(%" PRIu32 ") is not zero. Missing or extra calls to end.", mDepth);
         return false;
     }
+    if (mInPlaceSizes) {
+        widenOversizedObjects();
+        // mark true means it is not legal to write to this ProtoOutputStream anymore
+        mCompact = true;
+        return true;
+    }
     // record the size of the original buffer.
     size_t rawBufferSize = mBuffer->size();
     if (rawBufferSize == 0) return true; // nothing to do if the buffer is empty;
@@ -347,6 +451,40 @@ ProtoOutputStream::compact() {
     return true;
 }
 
+/**
+ * Makes room for the sizes that didn't fit in place, and writes them. Working from the end of
+ * the buffer, the data after each of them only has to move once.
+ */
+void
+ProtoOutputStream::widenOversizedObjects()
+{
+    if (mOversizedObjects.empty()) return;
+
+    // end is called on children before their parents, so sort back into buffer order.
+    std::sort(mOversizedObjects.begin(), mOversizedObjects.end(),
+            [](const OversizedObject& a, const OversizedObject& b) {
+                return a.sizePos < b.sizePos;
+            });
+
+    size_t end = mBuffer->size();
+    for (size_t i = 0; i < mGrowth; i++) {
+        mBuffer->writeRawByte(0);
+    }
+    size_t shift = mGrowth;
+    for (auto it = mOversizedObjects.rbegin(); it != mOversizedObjects.rend(); it++) {
+        size_t dataPos = it->sizePos + IN_PLACE_SIZE_BYTES;
+        mBuffer->moveForward(dataPos, dataPos + shift, end - dataPos);
+
+        uint8_t size[MAX_VARINT_SIZE];
+        size_t width = write_raw_varint(size, it->encodedSize) - size;
+        shift -= width - IN_PLACE_SIZE_BYTES;
+        mBuffer->editRaw(it->sizePos + shift, size, width);
+        end = it->sizePos;
+    }
+    mOversizedObjects.clear();
+    mGrowth = 0;
+}
+
 /**
  * First compaction pass.  Iterate through the data, and fill in the
  * nested object sizes so the next pass can compact them.
@@ -533,6 +671,11 @@ void
 ProtoOutputStream::writeLengthDelimitedHeader(uint32_t id, size_t size)
 {
     mBuffer->writeHeader(id, WIRE_TYPE_LENGTH_DELIMITED);
+    if (mInPlaceSizes) {
+        // The size is known, so there's nothing to fill in later.
+        mBuffer->writeRawVarint64(size);
+        return;
+    }
     // reserves 64 bits for length delimited fields, if first field is negative, compact it.
     mBuffer->writeRawFixed32(size);
     mBuffer->writeRawFixed32(size);
@@ -661,9 +804,7 @@ ProtoOutputStream::writeUtf8StringImpl(uint32_t id, const char* val, size_t size
 {
     if (val == NULL) return;
     writeLengthDelimitedHeader(id, size);
-    for (size_t i=0; i<size; i++) {
-        mBuffer->writeRawByte((uint8_t)val[i]);
-    }
+    mBuffer->writeRaw(reinterpret_cast<const uint8_t*>(val), size);
 }
 
 inline void
@@ -671,11 +812,112 @@ ProtoOutputStream::writeMessageBytesImpl(uint32_t id, const char* val, size_t si
 {
     if (val == NULL) return;
     writeLengthDelimitedHeader(id, size);
-    for (size_t i=0; i<size; i++) {
-        mBuffer->writeRawByte(val[i]);
+    mBuffer->writeRaw(reinterpret_cast<const uint8_t*>(val), size);
+}
+
+/**
+ * Packed fields are written with their exact size up front, the same as strings, so that
+ * compaction copies them through without having to look inside.
+ */
+template<typename T, typename Encode>
+void
+ProtoOutputStream::writePackedVarintImpl(uint32_t id, const T* vals, size_t n, Encode encode)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < n; i++) {
+        size += get_varint_size(encode(vals[i]));
+    }
+    writeLengthDelimitedHeader(id, size);
+    for (size_t i = 0; i < n; i++) {
+        mBuffer->writeRawVarint64(encode(vals[i]));
+    }
+}
+
+template<typename T, typename Encode>
+void
+ProtoOutputStream::writePackedFixed32Impl(uint32_t id, const T* vals, size_t n, Encode encode)
+{
+    writeLengthDelimitedHeader(id, n * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++) {
+        mBuffer->writeRawFixed32(encode(vals[i]));
+    }
+}
+
+template<typename T, typename Encode>
+void
+ProtoOutputStream::writePackedFixed64Impl(uint32_t id, const T* vals, size_t n, Encode encode)
+{
+    writeLengthDelimitedHeader(id, n * sizeof(uint64_t));
+    for (size_t i = 0; i < n; i++) {
+        mBuffer->writeRawFixed64(encode(vals[i]));
     }
 }
 
+template<typename T>
+bool
+ProtoOutputStream::internalWritePacked(uint64_t fieldId, const T* vals, size_t n,
+        const char* typeName)
+{
+    if (mCompact) return false;
+    if ((fieldId & FIELD_COUNT_MASK) != FIELD_COUNT_PACKED) {
+        ALOGW("Field 0x%" PRIx64 " is not packed when writing packed %s vals.", fieldId, typeName);
+        return false;
+    }
+    if (n == 0) return true;
+    if (vals == NULL) return false;
+
+    const uint32_t id = (uint32_t)fieldId;
+    switch (fieldId & FIELD_TYPE_MASK) {
+        case FIELD_TYPE_DOUBLE:
+            writePackedFixed64Impl(id, vals, n,
+                    [](T v) { return bit_cast<double, uint64_t>((double)v); });
+            break;
+        case FIELD_TYPE_FLOAT:
+            writePackedFixed32Impl(id, vals, n,
+                    [](T v) { return bit_cast<float, uint32_t>((float)v); });
+            break;
+        case FIELD_TYPE_FIXED64:
+        case FIELD_TYPE_SFIXED64:
+            writePackedFixed64Impl(id, vals, n, [](T v) { return (uint64_t)(int64_t)v; });
+            break;
+        case FIELD_TYPE_FIXED32:
+        case FIELD_TYPE_SFIXED32:
+            writePackedFixed32Impl(id, vals, n, [](T v) { return (uint32_t)(int32_t)v; });
+            break;
+        case FIELD_TYPE_INT64:
+        case FIELD_TYPE_UINT64:
+            writePackedVarintImpl(id, vals, n, [](T v) { return (uint64_t)(int64_t)v; });
+            break;
+        case FIELD_TYPE_INT32:
+        case FIELD_TYPE_UINT32:
+        case FIELD_TYPE_ENUM:
+            // Same as writeInt32Impl, negative values are written as 32-bit varints.
+            writePackedVarintImpl(id, vals, n,
+                    [](T v) { return (uint64_t)(uint32_t)(int32_t)v; });
+            break;
+        case FIELD_TYPE_SINT64:
+            writePackedVarintImpl(id, vals, n, [](T v) {
+                int64_t i = (int64_t)v;
+                return ((uint64_t)i << 1) ^ (uint64_t)(i >> 63);
+            });
+            break;
+        case FIELD_TYPE_SINT32:
+            writePackedVarintImpl(id, vals, n, [](T v) {
+                int32_t i = (int32_t)v;
+                return (uint64_t)(((uint32_t)i << 1) ^ (uint32_t)(i >> 31));
+            });
+            break;
+        case FIELD_TYPE_BOOL:
+            writePackedVarintImpl(id, vals, n, [](T v) { return (uint64_t)(v != 0); });
+            break;
+        default:
+            ALOGW("Field type %" PRIu64 " is not supported when writing packed %s vals.",
+                    (fieldId & FIELD_TYPE_MASK) >> FIELD_TYPE_SHIFT, typeName);
+            return false;
+    }
+    return true;
+}
+
 } // util
 } // android
 
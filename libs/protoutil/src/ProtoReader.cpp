@@ -16,6 +16,7 @@
 #define LOG_TAG "libprotoutil"
 
 #include <android/util/ProtoReader.h>
+#include <android/util/protobuf.h>
 
 namespace android {
 namespace util {
@@ -26,5 +27,26 @@ ProtoReader::ProtoReader() {
 ProtoReader::~ProtoReader() {
 }
 
+bool
+ProtoReader::skipField(uint32_t fieldTag)
+{
+    switch (read_wire_type(fieldTag)) {
+        case WIRE_TYPE_VARINT:
+            readRawVarint();
+            return true;
+        case WIRE_TYPE_FIXED64:
+            move(8);
+            return true;
+        case WIRE_TYPE_LENGTH_DELIMITED:
+            move(readRawVarint());
+            return true;
+        case WIRE_TYPE_FIXED32:
+            move(4);
+            return true;
+        default:
+            return false;
+    }
+}
+
 } // util
 } // android
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "libprotoutil"
+
+#include <android/util/ProtoSpanReader.h>
+#include <android/util/protobuf.h>
+#include <cutils/log.h>
+
+namespace android {
+namespace util {
+
+ProtoSpanReader::ProtoSpanReader(const uint8_t* data, size_t size)
+        :mStatus(NO_ERROR),
+         mData(data),
+         mSize(data == NULL ? 0 : size),
+         mPos(0) {
+}
+
+ProtoSpanReader::ProtoSpanReader()
+        :ProtoSpanReader(NULL, 0) {
+}
+
+ProtoSpanReader::~ProtoSpanReader() {
+}
+
+void
+ProtoSpanReader::setSpan(const uint8_t* data, size_t size)
+{
+    mData = data;
+    mSize = data == NULL ? 0 : size;
+    mPos = 0;
+}
+
+ssize_t
+ProtoSpanReader::size() const
+{
+    return (ssize_t)mSize;
+}
+
+size_t
+ProtoSpanReader::bytesRead() const
+{
+    return mPos;
+}
+
+uint8_t const*
+ProtoSpanReader::readBuffer()
+{
+    return hasNext() ? mData + mPos : NULL;
+}
+
+size_t
+ProtoSpanReader::currentToRead()
+{
+    return mSize - mPos;
+}
+
+bool
+ProtoSpanReader::hasNext()
+{
+    return mStatus == NO_ERROR && mPos < mSize;
+}
+
+uint8_t
+ProtoSpanReader::next()
+{
+    if (!hasNext()) {
+        // Shouldn't get to here.  Always call hasNext() before calling next().
+        return 0;
+    }
+    return mData[mPos++];
+}
+
+uint64_t
+ProtoSpanReader::readRawVarint()
+{
+    if (!hasNext()) {
+        ALOGW("readRawVarint() called without hasNext() called first.");
+        mStatus = NOT_ENOUGH_DATA;
+        return 0;
+    }
+    const uint8_t* p = mData + mPos;
+    // Tags and small values are a single byte, so check for that first.
+    if (p[0] < 0x80) {
+        mPos++;
+        return p[0];
+    }
+
+    // The span is contiguous, so the only bound to check is how far the varint may go.
+    size_t limit = mSize - mPos < MAX_VARINT_SIZE ? mSize - mPos : MAX_VARINT_SIZE;
+    uint64_t val = 0;
+    for (size_t i = 0; i < limit; i++) {
+        val |= (uint64_t)(p[i] & 0x7F) << (7 * i);
+        if ((p[i] & 0x80) == 0) {
+            mPos += i + 1;
+            return val;
+        }
+    }
+    ALOGW("readRawVarint() ran past the end of the varint at %zu.", mPos);
+    mStatus = limit < MAX_VARINT_SIZE ? NOT_ENOUGH_DATA : BAD_VALUE;
+    mPos = mSize;
+    return 0;
+}
+
+void
+ProtoSpanReader::move(size_t amt)
+{
+    if (mStatus != NO_ERROR) {
+        return;
+    }
+    mPos = amt < mSize - mPos ? mPos + amt : mSize;
+}
+
+const uint8_t*
+ProtoSpanReader::readSpan(size_t size)
+{
+    if (mStatus != NO_ERROR || size > mSize - mPos) {
+        return NULL;
+    }
+    const uint8_t* span = mData + mPos;
+    mPos += size;
+    return span;
+}
+
+status_t
+ProtoSpanReader::getError() const {
+    return mStatus;
+}
+
+} // util
+} // android
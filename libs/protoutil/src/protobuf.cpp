@@ -34,27 +34,22 @@ read_field_id(uint32_t varint)
 size_t
 get_varint_size(uint64_t varint)
 {
-    size_t size = 1;
-    while ((varint & ~0x7F)) {
-        size++;
-        varint >>= 7;
-    }
-    return size;
+    // Each byte holds 7 bits of the value. OR in 1 so that 0 counts as one significant bit,
+    // since clz is undefined for 0.
+    size_t bits = 64 - __builtin_clzll(varint | 1);
+    return (bits + 6) / 7;
 }
 
 uint8_t*
 write_raw_varint(uint8_t* buf, uint64_t val)
 {
     uint8_t* p = buf;
-    while (true) {
-        if ((val & ~0x7F) == 0) {
-            *p++ = (uint8_t)val;
-            return p;
-        } else {
-            *p++ = (uint8_t)((val & 0x7F) | 0x80);
-            val >>= 7;
-        }
+    while (val >= 0x80) {
+        *p++ = (uint8_t)(val | 0x80);
+        val >>= 7;
     }
+    *p++ = (uint8_t)val;
+    return p;
 }
 
 uint8_t*
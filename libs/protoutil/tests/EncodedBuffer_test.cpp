@@ -118,6 +118,31 @@ TEST(EncodedBufferTest, Edit) {
     EXPECT_EQ(buffer->readRawFixed64(), UINT64_C(0x12345678de345678));
 }
 
+TEST(EncodedBufferTest, MoveForwardAcrossChunks) {
+    sp<EncodedBuffer> buffer = new EncodedBuffer(TEST_CHUNK_SIZE);
+    // Chunks are at least a page, so use enough data to overlap several of them.
+    const size_t chunk = buffer->currentToWrite();
+    const size_t size = 4 * chunk;
+    for (size_t i = 0; i < size; i++) {
+        buffer->writeRawByte(i % 251);
+    }
+    const size_t src = 100, dst = chunk + 7, amt = 2 * chunk;
+    buffer->moveForward(src, dst, amt);
+    const uint8_t marker[] = { 0xaa, 0xbb, 0xcc };
+    buffer->editRaw(chunk - 1, marker, sizeof(marker));
+
+    sp<ProtoReader> reader = buffer->read();
+    for (size_t i = 0; i < size; i++) {
+        uint8_t expected = i % 251;
+        if (i >= dst && i < dst + amt) {
+            expected = (i - dst + src) % 251;
+        } else if (i >= chunk - 1 && i < chunk - 1 + sizeof(marker)) {
+            expected = marker[i - (chunk - 1)];
+        }
+        ASSERT_EQ(reader->next(), expected) << "at " << i;
+    }
+}
+
 TEST(EncodedBufferTest, ReadSimple) {
     sp<EncodedBuffer> buffer = new EncodedBuffer(TEST_CHUNK_SIZE);
     for (size_t i = 0; i < TEST_CHUNK_3X_SIZE; i++) {
@@ -150,3 +175,23 @@ TEST(EncodedBufferTest, ReadVarint) {
     EXPECT_EQ(reader->size(), len);
     EXPECT_EQ(reader->readRawVarint(), val);
 }
+
+TEST(EncodedBufferTest, ChunksReused) {
+    uint8_t* chunk;
+    {
+        sp<EncodedBuffer> buffer = new EncodedBuffer();
+        chunk = buffer->writeBuffer();
+        ASSERT_NE(chunk, nullptr);
+        buffer->writeRawByte(1);
+    }
+    // The freed chunk backs the next buffer of the same chunk size on this thread.
+    sp<EncodedBuffer> buffer = new EncodedBuffer();
+    EXPECT_EQ(buffer->writeBuffer(), chunk);
+    buffer = nullptr;
+
+    EncodedBuffer::trimChunkCache();
+    buffer = new EncodedBuffer();
+    ASSERT_NE(buffer->writeBuffer(), nullptr);
+    buffer->writeRawByte(2);
+    EXPECT_EQ(buffer->readRawByte(), 2);
+}
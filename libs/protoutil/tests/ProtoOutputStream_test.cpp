@@ -316,6 +316,147 @@ TEST(ProtoOutputStreamTest, AdvancedEncoding) {
     EXPECT_FALSE(log2.has_data());
 }
 
+TEST(ProtoOutputStreamTest, CompileTimeFieldIds) {
+    ProtoOutputStream proto;
+    EXPECT_TRUE(proto.write<FIELD_TYPE_INT32 | PrimitiveProto::kValInt32FieldNumber>(-123));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_INT64 | PrimitiveProto::kValInt64FieldNumber>(-1LL));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_FLOAT | PrimitiveProto::kValFloatFieldNumber>(-23.5f));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_DOUBLE | PrimitiveProto::kValDoubleFieldNumber>(324.5));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_UINT64 | PrimitiveProto::kValUint64FieldNumber>(57));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_FIXED32 | PrimitiveProto::kValFixed32FieldNumber>(-20));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_BOOL | PrimitiveProto::kValBoolFieldNumber>(true));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_SFIXED64 | PrimitiveProto::kValSfixed64FieldNumber>(-54));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_SINT32 | PrimitiveProto::kValSint32FieldNumber>(-533));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_SINT64 | PrimitiveProto::kValSint64FieldNumber>(
+            -61224762453LL));
+    EXPECT_TRUE(proto.write<FIELD_TYPE_ENUM | PrimitiveProto::kValEnumFieldNumber>(2));
+
+    PrimitiveProto primitives;
+    ASSERT_TRUE(primitives.ParseFromString(flushToString(&proto)));
+    EXPECT_EQ(primitives.val_int32(), -123);
+    EXPECT_EQ(primitives.val_int64(), -1);
+    EXPECT_EQ(primitives.val_float(), -23.5f);
+    EXPECT_EQ(primitives.val_double(), 324.5);
+    EXPECT_EQ(primitives.val_uint64(), 57);
+    EXPECT_EQ(primitives.val_fixed32(), -20);
+    EXPECT_TRUE(primitives.val_bool());
+    EXPECT_EQ(primitives.val_sfixed64(), -54);
+    EXPECT_EQ(primitives.val_sint32(), -533);
+    EXPECT_EQ(primitives.val_sint64(), -61224762453LL);
+    EXPECT_EQ(primitives.val_enum(), PrimitiveProto_Count_TWO);
+}
+
+TEST(ProtoOutputStreamTest, Packed) {
+    // Enough values to span several chunks of the buffer.
+    std::vector<int64_t> longs;
+    for (int64_t i = 0; i < 5000; i++) {
+        longs.push_back(i * i * i * (i % 2 ? -1 : 1));
+    }
+    const int32_t ints[] = { 0, 1, -1, 300, INT32_MAX, INT32_MIN };
+    const uint32_t fixeds[] = { 0, 7, UINT32_MAX };
+    const double doubles[] = { 0.5, -324.25 };
+
+    ProtoOutputStream proto;
+    EXPECT_TRUE(proto.writePacked(FIELD_TYPE_INT32 | FIELD_COUNT_PACKED | PackedProto::kIntsFieldNumber,
+            ints, 6));
+    EXPECT_TRUE(proto.writePacked(FIELD_TYPE_INT64 | FIELD_COUNT_PACKED | PackedProto::kLongsFieldNumber,
+            longs.data(), longs.size()));
+    EXPECT_TRUE(proto.writePacked(FIELD_TYPE_SINT64 | FIELD_COUNT_PACKED | PackedProto::kSintsFieldNumber,
+            longs.data(), 100));
+    EXPECT_TRUE(proto.writePacked(FIELD_TYPE_FIXED32 | FIELD_COUNT_PACKED | PackedProto::kFixedsFieldNumber,
+            fixeds, 3));
+    EXPECT_TRUE(proto.writePacked(FIELD_TYPE_DOUBLE | FIELD_COUNT_PACKED | PackedProto::kDoublesFieldNumber,
+            doubles, 2));
+
+    PackedProto packed;
+    ASSERT_TRUE(packed.ParseFromString(flushToString(&proto)));
+    ASSERT_EQ(packed.ints_size(), 6);
+    for (int i = 0; i < 6; i++) {
+        EXPECT_EQ(packed.ints(i), ints[i]);
+    }
+    ASSERT_EQ(packed.longs_size(), (int)longs.size());
+    for (size_t i = 0; i < longs.size(); i++) {
+        EXPECT_EQ(packed.longs(i), longs[i]);
+    }
+    ASSERT_EQ(packed.sints_size(), 100);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(packed.sints(i), longs[i]);
+    }
+    ASSERT_EQ(packed.fixeds_size(), 3);
+    EXPECT_EQ(packed.fixeds(2), UINT32_MAX);
+    ASSERT_EQ(packed.doubles_size(), 2);
+    EXPECT_EQ(packed.doubles(1), -324.25);
+}
+
+TEST(ProtoOutputStreamTest, PackedInvalid) {
+    const int64_t longs[] = { 1, 2 };
+    ProtoOutputStream proto;
+    EXPECT_TRUE(proto.writePacked(FIELD_TYPE_INT64 | FIELD_COUNT_PACKED | PackedProto::kLongsFieldNumber,
+            longs, 0));
+    EXPECT_FALSE(proto.writePacked(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED | PackedProto::kLongsFieldNumber,
+            longs, 2));
+    EXPECT_FALSE(proto.writePacked(FIELD_TYPE_STRING | FIELD_COUNT_PACKED | PackedProto::kLongsFieldNumber,
+            longs, 2));
+    EXPECT_EQ(proto.size(), 0);
+}
+
+// Writes a tree of NestedProtos whose data sizes cover sizes that fit into the reserved
+// varint of in place sizes and sizes that don't, at several depths.
+static void writeNested(ProtoOutputStream* proto, int depth) {
+    const size_t sizes[] = { 0, 1, 127, 128, 16383 - 4, 16384, 70000 };
+    for (size_t size : sizes) {
+        uint64_t token = proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED
+                | NestedProto::kChildrenFieldNumber);
+        std::string data(size, 'a' + depth);
+        proto->write(FIELD_TYPE_BYTES | NestedProto::kDataFieldNumber, data.data(), data.size());
+        if (depth < 2 && size == 128) {
+            writeNested(proto, depth + 1);
+        }
+        proto->end(token);
+    }
+    // An empty message is dropped altogether.
+    proto->end(proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED
+            | NestedProto::kChildrenFieldNumber));
+}
+
+TEST(ProtoOutputStreamTest, InPlaceSizes) {
+    ProtoOutputStream compacted;
+    writeNested(&compacted, 0);
+    ProtoOutputStream inPlace(new EncodedBuffer(), true);
+    writeNested(&inPlace, 0);
+
+    NestedProto expected;
+    ASSERT_TRUE(expected.ParseFromString(flushToString(&compacted)));
+    NestedProto actual;
+    std::string content;
+    ASSERT_TRUE(inPlace.serializeToString(&content));
+    EXPECT_EQ(inPlace.size(), content.size());
+    ASSERT_TRUE(actual.ParseFromString(content));
+    ASSERT_EQ(expected.children_size(), 7);
+    EXPECT_EQ(expected.SerializeAsString(), actual.SerializeAsString());
+    EXPECT_EQ(expected.children(5).data().size(), 16384u);
+    EXPECT_EQ(actual.children(3).children(3).children(3).data(), std::string(128, 'c'));
+}
+
+TEST(ProtoOutputStreamTest, InPlaceSizesMixedWithRaw) {
+    ProtoOutputStream proto(new EncodedBuffer(), true);
+    proto.write(FIELD_TYPE_INT32 | ComplexProto::kIntsFieldNumber, 3);
+    uint64_t token = proto.start(FIELD_TYPE_MESSAGE | ComplexProto::kLogsFieldNumber);
+    proto.write(FIELD_TYPE_INT32 | ComplexProto::Log::kIdFieldNumber, 14);
+    proto.end(token);
+    proto.writeLengthDelimitedHeader(ComplexProto::kLogsFieldNumber, 2);
+    proto.writeRawByte((ComplexProto::Log::kIdFieldNumber << FIELD_ID_SHIFT) + WIRE_TYPE_VARINT);
+    proto.writeRawByte(15);
+
+    ComplexProto complex;
+    ASSERT_TRUE(complex.ParseFromString(iterateToString(&proto)));
+    ASSERT_EQ(complex.ints_size(), 1);
+    EXPECT_EQ(complex.ints(0), 3);
+    ASSERT_EQ(complex.logs_size(), 2);
+    EXPECT_EQ(complex.logs(0).id(), 14);
+    EXPECT_EQ(complex.logs(1).id(), 15);
+}
+
 TEST(ProtoOutputStreamTest, InvalidTypes) {
     ProtoOutputStream proto;
     EXPECT_FALSE(proto.write(FIELD_TYPE_UNKNOWN | PrimitiveProto::kValInt32FieldNumber, 790));
@@ -0,0 +1,112 @@
+// Copyright (C) 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <android/util/protobuf.h>
+#include <android/util/ProtoFileReader.h>
+#include <android/util/ProtoOutputStream.h>
+#include <android/util/ProtoSpanReader.h>
+#include <gtest/gtest.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using android::sp;
+using namespace android::base;
+using namespace android::util;
+
+static std::string makeProto() {
+    ProtoOutputStream proto;
+    proto.write(FIELD_TYPE_INT64 | 1, -1LL);
+    std::string bytes(100000, 'x');
+    proto.write(FIELD_TYPE_BYTES | 2, bytes.data(), bytes.size());
+    proto.write(FIELD_TYPE_FIXED32 | 3, 7);
+    proto.write(FIELD_TYPE_FIXED64 | 4, 8LL);
+    proto.write(FIELD_TYPE_UINT32 | 5, 150);
+    std::string out;
+    EXPECT_TRUE(proto.serializeToString(&out));
+    return out;
+}
+
+static void expectFields(const sp<ProtoReader>& reader) {
+    ASSERT_TRUE(reader->hasNext());
+    EXPECT_EQ(reader->readRawVarint(), (1u << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+    EXPECT_EQ(reader->readRawVarint(), UINT64_C(-1));
+
+    // The big field and the fixed ones are skipped without reading through them.
+    for (uint32_t id = 2; id <= 4; id++) {
+        uint32_t tag = reader->readRawVarint();
+        EXPECT_EQ(read_field_id(tag), id);
+        EXPECT_TRUE(reader->skipField(tag));
+    }
+
+    EXPECT_EQ(reader->readRawVarint(), (5u << FIELD_ID_SHIFT) | WIRE_TYPE_VARINT);
+    EXPECT_EQ(reader->readRawVarint(), UINT64_C(150));
+    EXPECT_FALSE(reader->hasNext());
+    EXPECT_EQ(reader->bytesRead(), (size_t)reader->size());
+}
+
+TEST(ProtoSpanReaderTest, ReadAndSkip) {
+    std::string data = makeProto();
+    sp<ProtoSpanReader> reader =
+            new ProtoSpanReader(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    EXPECT_EQ(reader->size(), (ssize_t)data.size());
+    expectFields(reader);
+    EXPECT_EQ(reader->getError(), android::NO_ERROR);
+}
+
+TEST(ProtoSpanReaderTest, ReadSpan) {
+    const uint8_t data[] = { 0x12, 0x03, 'a', 'b', 'c', 0x08, 0x01 };
+    sp<ProtoSpanReader> reader = new ProtoSpanReader(data, sizeof(data));
+    EXPECT_EQ(reader->readRawVarint(), UINT64_C(0x12));
+    size_t size = reader->readRawVarint();
+    const uint8_t* span = reader->readSpan(size);
+    ASSERT_EQ(span, data + 2);
+    EXPECT_EQ(reader->next(), 0x08);
+    EXPECT_EQ(reader->readSpan(2), nullptr);
+    EXPECT_EQ(reader->next(), 0x01);
+    EXPECT_FALSE(reader->hasNext());
+}
+
+TEST(ProtoSpanReaderTest, TruncatedVarint) {
+    const uint8_t data[] = { 0x96, 0x81 };
+    sp<ProtoSpanReader> reader = new ProtoSpanReader(data, sizeof(data));
+    EXPECT_EQ(reader->readRawVarint(), UINT64_C(0));
+    EXPECT_EQ(reader->getError(), android::NOT_ENOUGH_DATA);
+    EXPECT_FALSE(reader->hasNext());
+}
+
+TEST(ProtoMappedFileReaderTest, ReadFromOffset) {
+    std::string preamble = "preamble";
+    std::string data = makeProto();
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFd(preamble + data, tf.fd));
+    ASSERT_EQ(lseek(tf.fd, preamble.size(), SEEK_SET), (off_t)preamble.size());
+
+    sp<ProtoMappedFileReader> reader = new ProtoMappedFileReader(tf.fd);
+    ASSERT_EQ(reader->getError(), android::NO_ERROR);
+    EXPECT_EQ(reader->size(), (ssize_t)data.size());
+    expectFields(reader);
+}
+
+TEST(ProtoMappedFileReaderTest, NotAFile) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    sp<ProtoMappedFileReader> reader = new ProtoMappedFileReader(fds[0]);
+    EXPECT_NE(reader->getError(), android::NO_ERROR);
+    EXPECT_FALSE(reader->hasNext());
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -22,6 +22,9 @@ TEST(ProtobufTest, All) {
     EXPECT_EQ(read_field_id(UINT32_C(17)), 2);
     EXPECT_EQ(get_varint_size(UINT64_C(234134)), 3);
     EXPECT_EQ(get_varint_size(UINT64_C(-1)), 10);
+    EXPECT_EQ(get_varint_size(UINT64_C(0)), 1);
+    EXPECT_EQ(get_varint_size(UINT64_C(127)), 1);
+    EXPECT_EQ(get_varint_size(UINT64_C(128)), 2);
 
     constexpr uint8_t UNSET_BYTE = 0xAB;
 
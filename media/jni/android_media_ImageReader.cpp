@@ -175,15 +175,19 @@ BufferItem* JNIImageReaderContext::getBufferItem() {
     if (mBuffers.empty()) {
         return NULL;
     }
-    // Return a BufferItem pointer and remove it from the list
-    List<BufferItem*>::iterator it = mBuffers.begin();
+    // Return the most recently returned BufferItem pointer and remove it from the list, so a
+    // reader that keeps one or two images in flight keeps reusing the same items.
+    List<BufferItem*>::iterator it = --mBuffers.end();
     BufferItem* buffer = *it;
     mBuffers.erase(it);
     return buffer;
 }
 
 void JNIImageReaderContext::returnBufferItem(BufferItem* buffer) {
+    // Drop the references held by the item, so a pooled item does not keep the graphic buffer
+    // or the acquire fence fd alive until it is reused.
     buffer->mGraphicBuffer = nullptr;
+    buffer->mFence = Fence::NO_FENCE;
     mBuffers.push_back(buffer);
 }
 
@@ -598,7 +602,9 @@ static jint ImageReader_imageSetup(JNIEnv* env, jobject thiz, jobject image) {
 
     }
 
-    // Set SurfaceImage instance member variables
+    // Set SurfaceImage instance member variables. The buffer is not locked for CPU access here:
+    // that only happens once the planes are requested, so images that are only handed off as
+    // HardwareBuffers never wait for the acquire fence nor map the buffer.
     Image_setBufferItem(env, image, buffer);
     env->SetLongField(image, gSurfaceImageClassInfo.mTimestamp,
             static_cast<jlong>(buffer->mTimestamp));
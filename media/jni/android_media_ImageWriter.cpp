@@ -976,6 +976,9 @@ static jobjectArray Image_createSurfacePlanes(JNIEnv* env, jobject thiz,
     // Buildup buffer info: rowStride, pixelStride and byteBuffers.
     LockedImage lockedImg = LockedImage();
     Image_getLockedImage(env, thiz, &lockedImg);
+    if (env->ExceptionCheck()) {
+        return NULL;
+    }
 
     // Create all SurfacePlanes
     PublicFormat publicWriterFormat = static_cast<PublicFormat>(writerFormat);
@@ -986,16 +989,23 @@ static jobjectArray Image_createSurfacePlanes(JNIEnv* env, jobject thiz,
             return NULL;
         }
         byteBuffer = env->NewDirectByteBuffer(pData, dataSize);
-        if ((byteBuffer == NULL) && (env->ExceptionCheck() == false)) {
-            jniThrowException(env, "java/lang/IllegalStateException",
-                    "Failed to allocate ByteBuffer");
+        if (byteBuffer == NULL) {
+            if (env->ExceptionCheck() == false) {
+                jniThrowException(env, "java/lang/IllegalStateException",
+                        "Failed to allocate ByteBuffer");
+            }
             return NULL;
         }
 
         // Finally, create this SurfacePlane.
         jobject surfacePlane = env->NewObject(gSurfacePlaneClassInfo.clazz,
                     gSurfacePlaneClassInfo.ctor, thiz, rowStride, pixelStride, byteBuffer);
+        env->DeleteLocalRef(byteBuffer);
+        if (surfacePlane == NULL) {
+            return NULL;
+        }
         env->SetObjectArrayElement(surfacePlanes, i, surfacePlane);
+        env->DeleteLocalRef(surfacePlane);
     }
 
     return surfacePlanes;
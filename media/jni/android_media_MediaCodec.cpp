@@ -1593,11 +1593,11 @@ static void android_media_MediaCodec_queueInputBuffer(
             env, err, ACTION_CODE_FATAL, errorDetailMsg.empty() ? NULL : errorDetailMsg.c_str());
 }
 
+// Reads a MediaCodec.CryptoInfo without copying anything back to the Java heap: the subsample
+// counts are read in place and the key and IV are copied into the object itself, which also keeps
+// the subsamples of the common few-subsample access unit, so queueing one allocates nothing.
 struct NativeCryptoInfo {
-    NativeCryptoInfo(JNIEnv *env, jobject cryptoInfoObj)
-        : mEnv{env},
-          mIvObj{env, (jbyteArray)env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoIVID)},
-          mKeyObj{env, (jbyteArray)env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoKeyID)} {
+    NativeCryptoInfo(JNIEnv *env, jobject cryptoInfoObj) {
         mNumSubSamples = env->GetIntField(cryptoInfoObj, gFields.cryptoInfoNumSubSamplesID);
 
         ScopedLocalRef<jintArray> numBytesOfClearDataObj{env, (jintArray)env->GetObjectField(
@@ -1614,7 +1614,7 @@ struct NativeCryptoInfo {
         } else if (jmode == gCryptoModes.AesCbc) {
             mMode = CryptoPlugin::kMode_AES_CBC;
         }  else {
-            throwExceptionAsNecessary(env, INVALID_OPERATION);
+            mErr = INVALID_OPERATION;
             return;
         }
 
@@ -1648,17 +1648,25 @@ struct NativeCryptoInfo {
         } else if (CC_UNLIKELY(mNumSubSamples >= (signed)(INT32_MAX / sizeof(*mSubSamples))) ) {
             mErr = -EINVAL;
         } else {
+            if (mNumSubSamples <= kInlineSubSamples) {
+                mSubSamples = mInlineSubSamples;
+            } else {
+                mHeapSubSamples.reset(new CryptoPlugin::SubSample[mNumSubSamples]);
+                mSubSamples = mHeapSubSamples.get();
+            }
+
+            // The counts are only read, so the arrays are released without a copy back.
             jint *numBytesOfClearData =
                 (numBytesOfClearDataObj == nullptr)
                     ? nullptr
-                    : env->GetIntArrayElements(numBytesOfClearDataObj.get(), nullptr);
+                    : (jint *)env->GetPrimitiveArrayCritical(
+                            numBytesOfClearDataObj.get(), nullptr);
 
             jint *numBytesOfEncryptedData =
                 (numBytesOfEncryptedDataObj == nullptr)
                     ? nullptr
-                    : env->GetIntArrayElements(numBytesOfEncryptedDataObj.get(), nullptr);
-
-            mSubSamples = new CryptoPlugin::SubSample[mNumSubSamples];
+                    : (jint *)env->GetPrimitiveArrayCritical(
+                            numBytesOfEncryptedDataObj.get(), nullptr);
 
             for (jint i = 0; i < mNumSubSamples; ++i) {
                 mSubSamples[i].mNumBytesOfClearData =
@@ -1669,64 +1677,46 @@ struct NativeCryptoInfo {
             }
 
             if (numBytesOfEncryptedData != nullptr) {
-                env->ReleaseIntArrayElements(
-                        numBytesOfEncryptedDataObj.get(), numBytesOfEncryptedData, 0);
+                env->ReleasePrimitiveArrayCritical(
+                        numBytesOfEncryptedDataObj.get(), numBytesOfEncryptedData, JNI_ABORT);
                 numBytesOfEncryptedData = nullptr;
             }
 
             if (numBytesOfClearData != nullptr) {
-                env->ReleaseIntArrayElements(
-                        numBytesOfClearDataObj.get(), numBytesOfClearData, 0);
+                env->ReleasePrimitiveArrayCritical(
+                        numBytesOfClearDataObj.get(), numBytesOfClearData, JNI_ABORT);
                 numBytesOfClearData = nullptr;
             }
         }
 
-        if (mErr == OK && mKeyObj.get() != nullptr) {
-            if (env->GetArrayLength(mKeyObj.get()) != 16) {
-                mErr = -EINVAL;
-            } else {
-                mKey = env->GetByteArrayElements(mKeyObj.get(), nullptr);
-            }
+        if (mErr == OK) {
+            ScopedLocalRef<jbyteArray> keyObj{
+                env, (jbyteArray)env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoKeyID)};
+            mErr = readKeyOrIv(env, keyObj.get(), mKeyStorage, &mKey);
         }
 
-        if (mErr == OK && mIvObj.get() != nullptr) {
-            if (env->GetArrayLength(mIvObj.get()) != 16) {
-                mErr = -EINVAL;
-            } else {
-                mIv = env->GetByteArrayElements(mIvObj.get(), nullptr);
-            }
+        if (mErr == OK) {
+            ScopedLocalRef<jbyteArray> ivObj{
+                env, (jbyteArray)env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoIVID)};
+            mErr = readKeyOrIv(env, ivObj.get(), mIvStorage, &mIv);
         }
-
     }
 
     explicit NativeCryptoInfo(jint size)
-        : mIvObj{nullptr, nullptr},
-          mKeyObj{nullptr, nullptr},
-          mMode{CryptoPlugin::kMode_Unencrypted},
+        : mMode{CryptoPlugin::kMode_Unencrypted},
           mPattern{0, 0} {
-        mSubSamples = new CryptoPlugin::SubSample[1];
+        mSubSamples = mInlineSubSamples;
         mNumSubSamples = 1;
         mSubSamples[0].mNumBytesOfClearData = size;
         mSubSamples[0].mNumBytesOfEncryptedData = 0;
     }
 
-    ~NativeCryptoInfo() {
-        if (mIv != nullptr) {
-            mEnv->ReleaseByteArrayElements(mIvObj.get(), mIv, 0);
-        }
+    NativeCryptoInfo(const NativeCryptoInfo &) = delete;
+    NativeCryptoInfo &operator=(const NativeCryptoInfo &) = delete;
 
-        if (mKey != nullptr) {
-            mEnv->ReleaseByteArrayElements(mKeyObj.get(), mKey, 0);
-        }
+    static constexpr jint kInlineSubSamples = 16;
+    static constexpr jsize kKeyOrIvSize = 16;
 
-        if (mSubSamples != nullptr) {
-            delete[] mSubSamples;
-        }
-    }
-
-    JNIEnv *mEnv{nullptr};
-    ScopedLocalRef<jbyteArray> mIvObj;
-    ScopedLocalRef<jbyteArray> mKeyObj;
     status_t mErr{OK};
 
     CryptoPlugin::SubSample *mSubSamples{nullptr};
@@ -1735,6 +1725,24 @@ struct NativeCryptoInfo {
     jbyte *mKey{nullptr};
     enum CryptoPlugin::Mode mMode;
     CryptoPlugin::Pattern mPattern;
+
+private:
+    static status_t readKeyOrIv(JNIEnv *env, jbyteArray obj, jbyte *storage, jbyte **out) {
+        if (obj == nullptr) {
+            return OK;
+        }
+        if (env->GetArrayLength(obj) != kKeyOrIvSize) {
+            return -EINVAL;
+        }
+        env->GetByteArrayRegion(obj, 0, kKeyOrIvSize, storage);
+        *out = storage;
+        return OK;
+    }
+
+    CryptoPlugin::SubSample mInlineSubSamples[kInlineSubSamples];
+    std::unique_ptr<CryptoPlugin::SubSample[]> mHeapSubSamples;
+    jbyte mKeyStorage[kKeyOrIvSize];
+    jbyte mIvStorage[kKeyOrIvSize];
 };
 
 static void android_media_MediaCodec_queueSecureInputBuffer(
@@ -1754,150 +1762,27 @@ static void android_media_MediaCodec_queueSecureInputBuffer(
         return;
     }
 
-    jint numSubSamples =
-        env->GetIntField(cryptoInfoObj, gFields.cryptoInfoNumSubSamplesID);
-
-    jintArray numBytesOfClearDataObj =
-        (jintArray)env->GetObjectField(
-                cryptoInfoObj, gFields.cryptoInfoNumBytesOfClearDataID);
-
-    jintArray numBytesOfEncryptedDataObj =
-        (jintArray)env->GetObjectField(
-                cryptoInfoObj, gFields.cryptoInfoNumBytesOfEncryptedDataID);
-
-    jbyteArray keyObj =
-        (jbyteArray)env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoKeyID);
-
-    jbyteArray ivObj =
-        (jbyteArray)env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoIVID);
-
-    jint jmode = env->GetIntField(cryptoInfoObj, gFields.cryptoInfoModeID);
-    enum CryptoPlugin::Mode mode;
-    if (jmode == gCryptoModes.Unencrypted) {
-        mode = CryptoPlugin::kMode_Unencrypted;
-    } else if (jmode == gCryptoModes.AesCtr) {
-        mode = CryptoPlugin::kMode_AES_CTR;
-    } else if (jmode == gCryptoModes.AesCbc) {
-        mode = CryptoPlugin::kMode_AES_CBC;
-    }  else {
+    NativeCryptoInfo cryptoInfo{env, cryptoInfoObj};
+    if (cryptoInfo.mErr == INVALID_OPERATION) {
         throwExceptionAsNecessary(env, INVALID_OPERATION);
         return;
     }
 
-    jobject patternObj = env->GetObjectField(cryptoInfoObj, gFields.cryptoInfoPatternID);
-
-    CryptoPlugin::Pattern pattern;
-    if (patternObj == NULL) {
-        pattern.mEncryptBlocks = 0;
-        pattern.mSkipBlocks = 0;
-    } else {
-        pattern.mEncryptBlocks = env->GetIntField(patternObj, gFields.patternEncryptBlocksID);
-        pattern.mSkipBlocks = env->GetIntField(patternObj, gFields.patternSkipBlocksID);
-    }
-
-    status_t err = OK;
-
-    CryptoPlugin::SubSample *subSamples = NULL;
-    jbyte *key = NULL;
-    jbyte *iv = NULL;
-
-    if (numSubSamples <= 0) {
-        err = -EINVAL;
-    } else if (numBytesOfClearDataObj == NULL
-            && numBytesOfEncryptedDataObj == NULL) {
-        err = -EINVAL;
-    } else if (numBytesOfEncryptedDataObj != NULL
-            && env->GetArrayLength(numBytesOfEncryptedDataObj) < numSubSamples) {
-        err = -ERANGE;
-    } else if (numBytesOfClearDataObj != NULL
-            && env->GetArrayLength(numBytesOfClearDataObj) < numSubSamples) {
-        err = -ERANGE;
-    // subSamples array may silently overflow if number of samples are too large.  Use
-    // INT32_MAX as maximum allocation size may be less than SIZE_MAX on some platforms
-    } else if ( CC_UNLIKELY(numSubSamples >= (signed)(INT32_MAX / sizeof(*subSamples))) ) {
-        err = -EINVAL;
-    } else {
-        jboolean isCopy;
-
-        jint *numBytesOfClearData =
-            (numBytesOfClearDataObj == NULL)
-                ? NULL
-                : env->GetIntArrayElements(numBytesOfClearDataObj, &isCopy);
-
-        jint *numBytesOfEncryptedData =
-            (numBytesOfEncryptedDataObj == NULL)
-                ? NULL
-                : env->GetIntArrayElements(numBytesOfEncryptedDataObj, &isCopy);
-
-        subSamples = new CryptoPlugin::SubSample[numSubSamples];
-
-        for (jint i = 0; i < numSubSamples; ++i) {
-            subSamples[i].mNumBytesOfClearData =
-                (numBytesOfClearData == NULL) ? 0 : numBytesOfClearData[i];
-
-            subSamples[i].mNumBytesOfEncryptedData =
-                (numBytesOfEncryptedData == NULL)
-                    ? 0 : numBytesOfEncryptedData[i];
-        }
-
-        if (numBytesOfEncryptedData != NULL) {
-            env->ReleaseIntArrayElements(
-                    numBytesOfEncryptedDataObj, numBytesOfEncryptedData, 0);
-            numBytesOfEncryptedData = NULL;
-        }
-
-        if (numBytesOfClearData != NULL) {
-            env->ReleaseIntArrayElements(
-                    numBytesOfClearDataObj, numBytesOfClearData, 0);
-            numBytesOfClearData = NULL;
-        }
-    }
-
-    if (err == OK && keyObj != NULL) {
-        if (env->GetArrayLength(keyObj) != 16) {
-            err = -EINVAL;
-        } else {
-            jboolean isCopy;
-            key = env->GetByteArrayElements(keyObj, &isCopy);
-        }
-    }
-
-    if (err == OK && ivObj != NULL) {
-        if (env->GetArrayLength(ivObj) != 16) {
-            err = -EINVAL;
-        } else {
-            jboolean isCopy;
-            iv = env->GetByteArrayElements(ivObj, &isCopy);
-        }
-    }
-
+    status_t err = cryptoInfo.mErr;
     AString errorDetailMsg;
 
     if (err == OK) {
         err = codec->queueSecureInputBuffer(
                 index, offset,
-                subSamples, numSubSamples,
-                (const uint8_t *)key, (const uint8_t *)iv,
-                mode,
-                pattern,
+                cryptoInfo.mSubSamples, cryptoInfo.mNumSubSamples,
+                (const uint8_t *)cryptoInfo.mKey, (const uint8_t *)cryptoInfo.mIv,
+                cryptoInfo.mMode,
+                cryptoInfo.mPattern,
                 timestampUs,
                 flags,
                 &errorDetailMsg);
     }
 
-    if (iv != NULL) {
-        env->ReleaseByteArrayElements(ivObj, iv, 0);
-        iv = NULL;
-    }
-
-    if (key != NULL) {
-        env->ReleaseByteArrayElements(keyObj, key, 0);
-        key = NULL;
-    }
-
-    delete[] subSamples;
-    subSamples = NULL;
-
     throwExceptionAsNecessary(
             env, err, ACTION_CODE_FATAL, errorDetailMsg.empty() ? NULL : errorDetailMsg.c_str());
 }
@@ -2186,6 +2071,10 @@ static void android_media_MediaCodec_native_queueLinearBlock(
                 return NativeCryptoInfo{env, cryptoInfoObj};
             }
         }();
+        if (cryptoInfo.mErr != OK) {
+            throwExceptionAsNecessary(env, cryptoInfo.mErr);
+            return;
+        }
         err = codec->queueEncryptedLinearBlock(
                 index,
                 memory,
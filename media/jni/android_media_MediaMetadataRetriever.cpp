@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "MediaMetadataRetrieverJNI"
 
+#include <algorithm>
 #include <cmath>
 #include <assert.h>
 #include <utils/Log.h>
@@ -208,16 +209,35 @@ static void rotate0(T* dst, const T* src, size_t width, size_t height)
     memcpy(dst, src, width * height * sizeof(T));
 }
 
-template<typename T>
-static void rotate90(T* dst, const T* src, size_t width, size_t height)
+// A quarter turn writes each row of the source into a column of the destination. Rotate in square
+// tiles so that the destination rows written by a tile stay in the cache, rather than touching a
+// new cache line for every pixel of a source row.
+static constexpr size_t kRotateTileSize = 32;
+
+template<typename F>
+static void forEachTiledPixel(size_t width, size_t height, F rotatePixel)
 {
-    for (size_t i = 0; i < height; ++i) {
-        for (size_t j = 0; j < width; ++j) {
-            dst[j * height + height - 1 - i] = src[i * width + j];
+    for (size_t i0 = 0; i0 < height; i0 += kRotateTileSize) {
+        const size_t iEnd = std::min(i0 + kRotateTileSize, height);
+        for (size_t j0 = 0; j0 < width; j0 += kRotateTileSize) {
+            const size_t jEnd = std::min(j0 + kRotateTileSize, width);
+            for (size_t i = i0; i < iEnd; ++i) {
+                for (size_t j = j0; j < jEnd; ++j) {
+                    rotatePixel(i, j);
+                }
+            }
         }
     }
 }
 
+template<typename T>
+static void rotate90(T* dst, const T* src, size_t width, size_t height)
+{
+    forEachTiledPixel(width, height, [=](size_t i, size_t j) {
+        dst[j * height + height - 1 - i] = src[i * width + j];
+    });
+}
+
 template<typename T>
 static void rotate180(T* dst, const T* src, size_t width, size_t height)
 {
@@ -231,11 +251,9 @@ static void rotate180(T* dst, const T* src, size_t width, size_t height)
 template<typename T>
 static void rotate270(T* dst, const T* src, size_t width, size_t height)
 {
-    for (size_t i = 0; i < height; ++i) {
-        for (size_t j = 0; j < width; ++j) {
-            dst[(width - 1 - j) * height + i] = src[i * width + j];
-        }
-    }
+    forEachTiledPixel(width, height, [=](size_t i, size_t j) {
+        dst[(width - 1 - j) * height + i] = src[i * width + j];
+    });
 }
 
 template<typename T>
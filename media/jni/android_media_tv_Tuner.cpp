@@ -2966,30 +2966,44 @@ static DemuxFilterSettings getFilterConfiguration(
     return filterSettings;
 }
 
+// Copies up to `size` bytes from the FMQ straight into the Java array. The data is copied out of
+// the shared memory regions of the queue, so neither the whole Java array is pinned or copied, nor
+// is the data staged in between.
 static jint copyData(JNIEnv *env, std::unique_ptr<MQ>& mq, EventFlag* flag, jbyteArray buffer,
         jlong offset, jlong size) {
-    ALOGD("copyData, size=%ld, offset=%ld", (long) size, (long) offset);
-
     jlong available = mq->availableToRead();
-    ALOGD("copyData, available=%ld", (long) available);
     size = std::min(size, available);
+    ALOGV("copyData, size=%ld, offset=%ld, available=%ld", (long) size, (long) offset,
+            (long) available);
+    if (size <= 0) {
+        return 0;
+    }
+
+    MQ::MemTransaction tx;
+    if (!mq->beginRead(size, &tx)) {
+        jniThrowRuntimeException(env, "Failed to read FMQ");
+        return 0;
+    }
 
-    jboolean isCopy;
-    jbyte *dst = env->GetByteArrayElements(buffer, &isCopy);
-    ALOGD("copyData, isCopy=%d", isCopy);
-    if (dst == nullptr) {
-        jniThrowRuntimeException(env, "Failed to GetByteArrayElements");
+    auto first = tx.getFirstRegion();
+    jlong firstToRead = std::min(static_cast<jlong>(first.getLength()), size);
+    env->SetByteArrayRegion(buffer, offset, firstToRead,
+            reinterpret_cast<const jbyte*>(first.getAddress()));
+    if (!env->ExceptionCheck() && firstToRead < size) {
+        auto second = tx.getSecondRegion();
+        env->SetByteArrayRegion(buffer, offset + firstToRead, size - firstToRead,
+                reinterpret_cast<const jbyte*>(second.getAddress()));
+    }
+    if (env->ExceptionCheck()) {
+        // Leave the data in the queue, it has not been delivered.
         return 0;
     }
 
-    if (mq->read(reinterpret_cast<unsigned char*>(dst) + offset, size)) {
-        env->ReleaseByteArrayElements(buffer, dst, 0);
-        flag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
-    } else {
+    if (!mq->commitRead(size)) {
         jniThrowRuntimeException(env, "Failed to read FMQ");
-        env->ReleaseByteArrayElements(buffer, dst, 0);
         return 0;
     }
+    flag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
     return size;
 }
 
@@ -3515,21 +3529,35 @@ static jlong android_media_tv_Tuner_read_dvr_from_array(
     jlong available = dvrSp->mDvrMQ->availableToWrite();
     size = std::min(size, available);
 
-    jboolean isCopy;
-    jbyte *src = env->GetByteArrayElements(buffer, &isCopy);
-    if (src == nullptr) {
-        ALOGD("Failed to GetByteArrayElements");
+    if (size <= 0) {
         return 0;
     }
 
-    if (dvrSp->mDvrMQ->write(reinterpret_cast<unsigned char*>(src) + offset, size)) {
-        env->ReleaseByteArrayElements(buffer, src, 0);
-        dvrSp->mDvrMQEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
-    } else {
+    // Copy the data from the Java array straight into the shared memory regions of the FMQ.
+    MQ::MemTransaction tx;
+    if (!dvrSp->mDvrMQ->beginWrite(size, &tx)) {
+        ALOGD("Failed to write FMQ");
+        return 0;
+    }
+
+    auto first = tx.getFirstRegion();
+    jlong firstToWrite = std::min(static_cast<jlong>(first.getLength()), size);
+    env->GetByteArrayRegion(buffer, offset, firstToWrite,
+            reinterpret_cast<jbyte*>(first.getAddress()));
+    if (!env->ExceptionCheck() && firstToWrite < size) {
+        auto second = tx.getSecondRegion();
+        env->GetByteArrayRegion(buffer, offset + firstToWrite, size - firstToWrite,
+                reinterpret_cast<jbyte*>(second.getAddress()));
+    }
+    if (env->ExceptionCheck()) {
+        return 0;
+    }
+
+    if (!dvrSp->mDvrMQ->commitWrite(size)) {
         ALOGD("Failed to write FMQ");
-        env->ReleaseByteArrayElements(buffer, src, 0);
         return 0;
     }
+    dvrSp->mDvrMQEventFlag->wake(static_cast<uint32_t>(DemuxQueueNotifyBits::DATA_CONSUMED));
     return size;
 }
 
@@ -20,6 +20,12 @@
 
 #include "Sound.h"
 
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <tuple>
+
+#include <android-base/thread_annotations.h>
 #include <media/NdkMediaCodec.h>
 #include <media/NdkMediaExtractor.h>
 #include <media/NdkMediaFormat.h>
@@ -29,6 +35,86 @@ namespace android::soundpool {
 constexpr uint32_t kMaxSampleRate = 192000;
 constexpr size_t   kDefaultHeapSize = 1024 * 1024; // 1MB (compatible with low mem devices)
 
+struct Sound::Decoded {
+    sp<MemoryHeapBase>   heap;
+    sp<IMemory>          data;
+    size_t               sizeInBytes = 0;
+    uint32_t             sampleRate = 0;
+    int32_t              channelCount = 0;
+    audio_format_t       format = AUDIO_FORMAT_INVALID;
+    audio_channel_mask_t channelMask = AUDIO_CHANNEL_NONE;
+};
+
+namespace {
+
+/**
+ * Identifies what a sound is decoded from: the region of the file, and the
+ * modification time of the file so that a file rewritten in place is decoded anew.
+ */
+struct ContentKey {
+    dev_t   dev;
+    ino_t   ino;
+    int64_t mtimeNs;
+    int64_t offset;
+    int64_t length;
+
+    bool operator<(const ContentKey& other) const {
+        return std::tie(dev, ino, mtimeNs, offset, length)
+                < std::tie(other.dev, other.ino, other.mtimeNs, other.offset, other.length);
+    }
+};
+
+/**
+ * Decoded samples of the sounds loaded in this process, by content.
+ *
+ * Entries are weak: a decode stays cached while at least one Sound refers to it,
+ * so the same asset loaded by several SoundPools (e.g. UI clicks) is decoded and
+ * kept in memory once.
+ */
+class DecodedCache {
+public:
+    std::shared_ptr<const Sound::Decoded> find(const ContentKey& key) {
+        std::lock_guard lock(mLock);
+        auto it = mEntries.find(key);
+        if (it == mEntries.end()) return nullptr;
+        auto decoded = it->second.lock();
+        if (decoded == nullptr) mEntries.erase(it);
+        return decoded;
+    }
+
+    // Returns the entry already cached for key by a concurrent load, if any, else decoded.
+    std::shared_ptr<const Sound::Decoded> insert(
+            const ContentKey& key, std::shared_ptr<const Sound::Decoded> decoded) {
+        std::lock_guard lock(mLock);
+        for (auto it = mEntries.begin(); it != mEntries.end(); ) {
+            it = it->second.expired() ? mEntries.erase(it) : std::next(it);
+        }
+        auto& entry = mEntries[key];
+        if (auto existing = entry.lock()) return existing;
+        entry = decoded;
+        return decoded;
+    }
+
+private:
+    std::mutex mLock;
+    std::map<ContentKey, std::weak_ptr<const Sound::Decoded>> mEntries GUARDED_BY(mLock);
+};
+
+DecodedCache& decodedCache() {
+    static DecodedCache cache;
+    return cache;
+}
+
+bool getContentKey(int fd, int64_t offset, int64_t length, ContentKey* key) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    *key = {st.st_dev, st.st_ino,
+            (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec, offset, length};
+    return true;
+}
+
+} // namespace
+
 Sound::Sound(int32_t soundID, int fd, int64_t offset, int64_t length)
     : mSoundID(soundID)
     , mFd(fcntl(fd, F_DUPFD_CLOEXEC, (int)0 /* arg */)) // dup(fd) + close on exec to prevent leaks.
@@ -197,35 +283,55 @@ status_t Sound::doLoad()
     ALOGV("%s()", __func__);
     status_t status = NO_INIT;
     if (mFd.get() != -1) {
-        mHeap = new MemoryHeapBase(kDefaultHeapSize);
-
-        ALOGV("%s: start decode", __func__);
-        uint32_t sampleRate;
-        int32_t channelCount;
-        audio_format_t format;
-        audio_channel_mask_t channelMask;
-        status = decode(mFd.get(), mOffset, mLength, &sampleRate, &channelCount, &format,
-                        &channelMask, mHeap, &mSizeInBytes);
+        ContentKey key{};
+        const bool cacheable = getContentKey(mFd.get(), mOffset, mLength, &key);
+        std::shared_ptr<const Decoded> decoded;
+        if (cacheable) {
+            decoded = decodedCache().find(key);
+            ALOGV_IF(decoded != nullptr, "%s: reusing decoded samples", __func__);
+        }
+        if (decoded == nullptr) {
+            auto newDecoded = std::make_shared<Decoded>();
+            newDecoded->heap = new MemoryHeapBase(kDefaultHeapSize);
+
+            ALOGV("%s: start decode", __func__);
+            status = decode(mFd.get(), mOffset, mLength, &newDecoded->sampleRate,
+                            &newDecoded->channelCount, &newDecoded->format,
+                            &newDecoded->channelMask, newDecoded->heap,
+                            &newDecoded->sizeInBytes);
+
+            if (status != NO_ERROR) {
+                ALOGE("%s: unable to load sound", __func__);
+            } else if (newDecoded->sampleRate > kMaxSampleRate) {
+                ALOGE("%s: sample rate (%u) out of range", __func__, newDecoded->sampleRate);
+                status = BAD_VALUE;
+            } else if (newDecoded->channelCount < 1 || newDecoded->channelCount > FCC_8) {
+                ALOGE("%s: sample channel count (%d) out of range",
+                        __func__, newDecoded->channelCount);
+                status = BAD_VALUE;
+            } else {
+                // Correctly loaded, proper parameters
+                newDecoded->data = new MemoryBase(newDecoded->heap, 0, newDecoded->sizeInBytes);
+                decoded = std::move(newDecoded);
+                if (cacheable) {
+                    decoded = decodedCache().insert(key, std::move(decoded));
+                }
+            }
+        }
         ALOGV("%s: close(%d)", __func__, mFd.get());
         mFd.reset();  // close
 
-        if (status != NO_ERROR) {
-            ALOGE("%s: unable to load sound", __func__);
-        } else if (sampleRate > kMaxSampleRate) {
-            ALOGE("%s: sample rate (%u) out of range", __func__, sampleRate);
-            status = BAD_VALUE;
-        } else if (channelCount < 1 || channelCount > FCC_8) {
-            ALOGE("%s: sample channel count (%d) out of range", __func__, channelCount);
-            status = BAD_VALUE;
-        } else {
-            // Correctly loaded, proper parameters
+        if (decoded != nullptr) {
             ALOGV("%s: pointer = %p, sizeInBytes = %zu, sampleRate = %u, channelCount = %d",
-                  __func__, mHeap->getBase(), mSizeInBytes, sampleRate, channelCount);
-            mData = new MemoryBase(mHeap, 0, mSizeInBytes);
-            mSampleRate = sampleRate;
-            mChannelCount = channelCount;
-            mFormat = format;
-            mChannelMask = channelMask;
+                  __func__, decoded->heap->getBase(), decoded->sizeInBytes,
+                  decoded->sampleRate, decoded->channelCount);
+            mDecoded = decoded;
+            mData = decoded->data;
+            mSizeInBytes = decoded->sizeInBytes;
+            mSampleRate = decoded->sampleRate;
+            mChannelCount = decoded->channelCount;
+            mFormat = decoded->format;
+            mChannelMask = decoded->channelMask;
             mState = READY;  // this should be last, as it is an atomic sync point
             return NO_ERROR;
         }
@@ -233,7 +339,6 @@ status_t Sound::doLoad()
         ALOGE("%s: uninitialized fd, dup failed", __func__);
     }
     // ERROR handling
-    mHeap.clear();
     mState = DECODE_ERROR; // this should be last, as it is an atomic sync point
     return status;
 }
@@ -21,6 +21,8 @@
 #include <binder/MemoryHeapBase.h>
 #include <system/audio.h>
 
+#include <memory>
+
 namespace android::soundpool {
 
 class SoundDecoder;
@@ -73,6 +75,10 @@ public:
     uint8_t* getData() const { return static_cast<uint8_t*>(mData->unsecurePointer()); }
     sp<IMemory> getIMemory() const { return mData; }
 
+    // The decoded samples and their format. Sounds loaded from the same content
+    // in this process share one instance, see doLoad().
+    struct Decoded;
+
 private:
     status_t doLoad();  // only SoundDecoder accesses this.
 
@@ -87,7 +93,7 @@ private:
     const int64_t        mOffset; // int64_t to match java long, see off64_t
     const int64_t        mLength; // int64_t to match java long, see off64_t
     sp<IMemory>          mData;
-    sp<MemoryHeapBase>   mHeap;
+    std::shared_ptr<const Decoded> mDecoded; // keeps the shared decode cached while loaded
 };
 
 } // namespace android::soundpool
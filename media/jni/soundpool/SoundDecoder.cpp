@@ -20,6 +20,8 @@
 
 #include "SoundDecoder.h"
 
+#include <algorithm>
+
 namespace android::soundpool {
 
 // Maximum Samples that can be background decoded before we block the caller.
@@ -62,19 +64,22 @@ void SoundDecoder::run(int32_t id)
     ALOGV("%s(%d): entering", __func__, id);
     std::unique_lock lock(mLock);
     while (!mQuit) {
-        if (mSoundIDs.size() == 0) {
+        if (mRequests.size() == 0) {
             ALOGV("%s(%d): waiting", __func__, id);
             mQueueDataAvailable.wait_for(
                     lock, std::chrono::duration<int32_t, std::milli>(kWaitTimeBeforeCloseMs));
-            if (mSoundIDs.size() == 0) {
+            if (mRequests.size() == 0) {
                 break; // no new sound, exit this thread.
             }
             continue;
         }
-        const int32_t soundID = mSoundIDs.front();
-        mSoundIDs.pop_front();
+        // max_element() returns the first of equal elements, so equal priorities stay FIFO.
+        const auto next = std::max_element(mRequests.begin(), mRequests.end(),
+                [](const Request& a, const Request& b) { return a.priority < b.priority; });
+        const int32_t soundID = next->soundID;
+        mRequests.erase(next);
         mQueueSpaceAvailable.notify_one();
-        ALOGV("%s(%d): processing soundID: %d  size: %zu", __func__, id, soundID, mSoundIDs.size());
+        ALOGV("%s(%d): processing soundID: %d  size: %zu", __func__, id, soundID, mRequests.size());
         lock.unlock();
         std::shared_ptr<Sound> sound = mSoundManager->findSound(soundID);
         status_t status = NO_INIT;
@@ -88,22 +93,22 @@ void SoundDecoder::run(int32_t id)
     ALOGV("%s(%d): exiting", __func__, id);
 }
 
-void SoundDecoder::loadSound(int32_t soundID)
+void SoundDecoder::loadSound(int32_t soundID, int32_t priority)
 {
-    ALOGV("%s(%d)", __func__, soundID);
+    ALOGV("%s(%d, %d)", __func__, soundID, priority);
     size_t pendingSounds;
     {
         std::unique_lock lock(mLock);
-        while (mSoundIDs.size() == kMaxQueueSize) {
+        while (mRequests.size() == kMaxQueueSize) {
             if (mQuit) return;
-            ALOGV("%s: waiting soundID: %d size: %zu", __func__, soundID, mSoundIDs.size());
+            ALOGV("%s: waiting soundID: %d size: %zu", __func__, soundID, mRequests.size());
             mQueueSpaceAvailable.wait(lock);
         }
         if (mQuit) return;
-        mSoundIDs.push_back(soundID);
+        mRequests.push_back({soundID, priority});
         mQueueDataAvailable.notify_one();
-        ALOGV("%s: adding soundID: %d  size: %zu", __func__, soundID, mSoundIDs.size());
-        pendingSounds = mSoundIDs.size();
+        ALOGV("%s: adding soundID: %d  size: %zu", __func__, soundID, mRequests.size());
+        pendingSounds = mRequests.size();
     }
     // Launch threads as needed.  The "as needed" is weakly consistent as we release mLock.
     if (pendingSounds > mThreadPool->getActiveThreadCount()) {
@@ -113,4 +118,16 @@ void SoundDecoder::loadSound(int32_t soundID)
     }
 }
 
+void SoundDecoder::prioritize(int32_t soundID)
+{
+    ALOGV("%s(%d)", __func__, soundID);
+    std::lock_guard lock(mLock);
+    for (auto& request : mRequests) {
+        if (request.soundID == soundID) {
+            request.priority = INT32_MAX;
+            return;
+        }
+    }
+}
+
 } // end namespace android::soundpool
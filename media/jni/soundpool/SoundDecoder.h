@@ -30,7 +30,10 @@ class SoundDecoder {
 public:
     SoundDecoder(SoundManager* soundManager, size_t threads);
     ~SoundDecoder();
-    void loadSound(int32_t soundID) NO_THREAD_SAFETY_ANALYSIS; // uses unique_lock
+    // Sounds with a higher priority are decoded first, equal priorities in load order.
+    void loadSound(int32_t soundID, int32_t priority) NO_THREAD_SAFETY_ANALYSIS; // uses unique_lock
+    // Moves a queued sound ahead of the others, e.g. because somebody waits for it.
+    void prioritize(int32_t soundID);
     void quit();
 
 private:
@@ -44,7 +47,11 @@ private:
     std::condition_variable mQueueSpaceAvailable GUARDED_BY(mLock);
     std::condition_variable mQueueDataAvailable GUARDED_BY(mLock);
 
-    std::deque<int32_t>     mSoundIDs GUARDED_BY(mLock);
+    struct Request {
+        int32_t soundID;
+        int32_t priority;
+    };
+    std::deque<Request>     mRequests GUARDED_BY(mLock);
     bool                    mQuit GUARDED_BY(mLock) = false;
 };
 
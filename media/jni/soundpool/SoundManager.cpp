@@ -22,14 +22,28 @@
 
 #include <thread>
 
+#include <cutils/properties.h>
+
 #include "SoundDecoder.h"
 
 namespace android::soundpool {
 
-static const size_t kDecoderThreads = std::thread::hardware_concurrency() >= 4 ? 2 : 1;
+// Decoding is CPU bound and independent per sound, so use half of the cores.
+// The count may be overridden for tuning with the property below.
+static size_t getDecoderThreads()
+{
+    const int32_t threads = property_get_int32("media.soundpool.decoder_threads", 0);
+    if (threads > 0) return threads;
+    const unsigned cores = std::thread::hardware_concurrency();
+    return cores >= 4 ? cores / 2 : 1;
+}
+
+// The longest waitForLoad() blocks, also when asked to wait forever: a sound left in the
+// decoder queue when the decoder quits never finishes loading.
+static constexpr int32_t kMaxWaitForLoadMs = 10000;
 
 SoundManager::SoundManager()
-    : mDecoder{std::make_unique<SoundDecoder>(this, kDecoderThreads)}
+    : mDecoder{std::make_unique<SoundDecoder>(this, getDecoderThreads())}
 {
     ALOGV("%s()", __func__);
 }
@@ -63,7 +77,7 @@ int32_t SoundManager::load(int fd, int64_t offset, int64_t length, int32_t prior
     // the message queue emptying may block on SoundManager::findSound().
     //
     // It is theoretically possible that sound loads might decode out-of-order.
-    mDecoder->loadSound(soundID);
+    mDecoder->loadSound(soundID, priority);
     return soundID;
 }
 
@@ -91,9 +105,31 @@ void SoundManager::setCallback(SoundPool *soundPool, SoundPoolCallback* callback
     mCallbackHandler.setCallback(soundPool, callback, user);
 }
 
+bool SoundManager::waitForLoad(int32_t soundID, int32_t timeoutMs)
+{
+    ALOGV("%s(soundID=%d, timeoutMs=%d)", __func__, soundID, timeoutMs);
+    mDecoder->prioritize(soundID);
+    std::shared_ptr<Sound> sound;
+    const auto loaded = [&]() {
+        sound = findSound(soundID);
+        return sound == nullptr || sound->getState() != Sound::LOADING;
+    };
+    if (timeoutMs < 0 || timeoutMs > kMaxWaitForLoadMs) {
+        timeoutMs = kMaxWaitForLoadMs;
+    }
+    std::unique_lock lock(mLoadLock);
+    mLoadCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), loaded);
+    return sound != nullptr && sound->getState() == Sound::READY;
+}
+
 void SoundManager::notify(SoundPoolEvent event)
 {
     mCallbackHandler.notify(event);
+    if (event.mMsg == SoundPoolEvent::SOUND_LOADED) {
+        // Lock so that a waiter between checking the sound and waiting is not missed.
+        std::lock_guard lock(mLoadLock);
+        mLoadCondition.notify_all();
+    }
 }
 
 void* SoundManager::getUserData() const
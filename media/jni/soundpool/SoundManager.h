@@ -18,6 +18,7 @@
 
 #include "Sound.h"
 
+#include <condition_variable>
 #include <mutex>
 #include <unordered_map>
 
@@ -57,6 +58,11 @@ public:
     void setCallback(SoundPool* soundPool, SoundPoolCallback* callback, void* user);
     void* getUserData() const;
 
+    // Waits until soundID has loaded or failed to, for at most timeoutMs. Negative or longer
+    // timeouts are clamped to 10 seconds, so a sound that never loads can't block forever.
+    // Moves the sound ahead of the other pending loads. Returns true if the sound is ready.
+    bool waitForLoad(int32_t soundID, int32_t timeoutMs) NO_THREAD_SAFETY_ANALYSIS; // unique_lock
+
     // SoundPool and SoundDecoder access
     std::shared_ptr<Sound> findSound(int32_t soundID) const;
 
@@ -108,6 +114,10 @@ private:
     mutable std::mutex mSoundManagerLock;
     std::unordered_map<int, std::shared_ptr<Sound>> mSounds GUARDED_BY(mSoundManagerLock);
     int32_t mNextSoundID GUARDED_BY(mSoundManagerLock) = 0;
+
+    // Signalled after each SOUND_LOADED event, for waitForLoad().
+    std::mutex mLoadLock;
+    std::condition_variable mLoadCondition GUARDED_BY(mLoadLock);
 };
 
 } // namespace android::soundpool
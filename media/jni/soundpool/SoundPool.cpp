@@ -161,6 +161,24 @@ void SoundPool::mute(bool muting)
     mStreamManager.forEach([=](soundpool::Stream *stream) { stream->mute(muting); });
 }
 
+bool SoundPool::waitForLoad(int32_t soundID, int32_t timeoutMs)
+{
+    ALOGV("%s(%d, %d)", __func__, soundID, timeoutMs);
+    // No mApiLock: waiting must not block the other SoundPool calls.
+    return mSoundManager.waitForLoad(soundID, timeoutMs);
+}
+
+bool SoundPool::prepare(int32_t soundID)
+{
+    ALOGV("%s(%d)", __func__, soundID);
+    auto apiLock = kUseApiLock ? std::make_unique<std::lock_guard<std::mutex>>(mApiLock) : nullptr;
+    const std::shared_ptr<soundpool::Sound> sound = mSoundManager.findSound(soundID);
+    if (sound == nullptr || sound->getState() != soundpool::Sound::READY) {
+        return false;
+    }
+    return mStreamManager.prepare(sound);
+}
+
 void SoundPool::pause(int32_t streamID)
 {
     ALOGV("%s(%d)", __func__, streamID);
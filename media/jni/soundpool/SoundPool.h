@@ -55,6 +55,13 @@ public:
     // not exposed in the public Java API, used for internal playerSetVolume() muting.
     void mute(bool muting);
 
+    // not exposed in the public Java API, waits for a sound instead of a load callback.
+    bool waitForLoad(int32_t soundID, int32_t timeoutMs);
+
+    // not exposed in the public Java API, creates the AudioTrack of a loaded sound
+    // ahead of play() so that the first play() of the sound starts without delay.
+    bool prepare(int32_t soundID);
+
 private:
 
     // Constructor initialized variables
@@ -288,8 +288,6 @@ void Stream::play_l(const std::shared_ptr<Sound>& sound, int32_t nextStreamID,
                 priority, loop, rate);
 
         // initialize track
-        const audio_stream_type_t streamType =
-                AudioSystem::attributesToStreamType(*mStreamManager->getAttributes());
         const int32_t channelCount = sound->getChannelCount();
         const auto sampleRate = (uint32_t)lround(double(sound->getSampleRate()) * rate);
         size_t frameCount = 0;
@@ -317,27 +315,7 @@ void Stream::play_l(const std::shared_ptr<Sound>& sound, int32_t nextStreamID,
             // audio track while the new one is being started and avoids processing them with
             // wrong audio audio buffer size  (mAudioBufferSize)
             auto toggle = mToggle ^ 1;
-            void* userData = (void*)((uintptr_t)this | toggle);
-            audio_channel_mask_t soundChannelMask = sound->getChannelMask();
-            // When sound contains a valid channel mask, use it as is.
-            // Otherwise, use stream count to calculate channel mask.
-            audio_channel_mask_t channelMask = soundChannelMask != AUDIO_CHANNEL_NONE
-                    ? soundChannelMask : audio_channel_out_mask_from_count(channelCount);
-
-            // do not create a new audio track if current track is compatible with sound parameters
-
-            newTrack = new AudioTrack(streamType, sampleRate, sound->getFormat(),
-                    channelMask, sound->getIMemory(), AUDIO_OUTPUT_FLAG_FAST,
-                    staticCallback, userData,
-                    0 /*default notification frames*/, AUDIO_SESSION_ALLOCATE,
-                    AudioTrack::TRANSFER_DEFAULT,
-                    nullptr /*offloadInfo*/, -1 /*uid*/, -1 /*pid*/,
-                    mStreamManager->getAttributes(),
-                    false /*doNotReconnect*/, 1.0f /*maxRequiredSpeed*/,
-                    mStreamManager->getOpPackageName());
-            // Set caller name so it can be logged in destructor.
-            // MediaMetricsConstants.h: AMEDIAMETRICS_PROP_CALLERNAME_VALUE_SOUNDPOOL
-            newTrack->setCallerName("soundpool");
+            newTrack = createTrack_l(sound, sampleRate, toggle);
             oldTrack = mAudioTrack;
             status = newTrack->initCheck();
             if (status != NO_ERROR) {
@@ -382,6 +360,54 @@ exit:
     }
 }
 
+sp<AudioTrack> Stream::createTrack_l(
+        const std::shared_ptr<Sound>& sound, uint32_t sampleRate, int toggle)
+{
+    const audio_stream_type_t streamType =
+            AudioSystem::attributesToStreamType(*mStreamManager->getAttributes());
+    void* userData = (void*)((uintptr_t)this | toggle);
+    audio_channel_mask_t soundChannelMask = sound->getChannelMask();
+    // When sound contains a valid channel mask, use it as is.
+    // Otherwise, use stream count to calculate channel mask.
+    audio_channel_mask_t channelMask = soundChannelMask != AUDIO_CHANNEL_NONE
+            ? soundChannelMask : audio_channel_out_mask_from_count(sound->getChannelCount());
+
+    sp<AudioTrack> track = new AudioTrack(streamType, sampleRate, sound->getFormat(),
+            channelMask, sound->getIMemory(), AUDIO_OUTPUT_FLAG_FAST,
+            staticCallback, userData,
+            0 /*default notification frames*/, AUDIO_SESSION_ALLOCATE,
+            AudioTrack::TRANSFER_DEFAULT,
+            nullptr /*offloadInfo*/, -1 /*uid*/, -1 /*pid*/,
+            mStreamManager->getAttributes(),
+            false /*doNotReconnect*/, 1.0f /*maxRequiredSpeed*/,
+            mStreamManager->getOpPackageName());
+    // Set caller name so it can be logged in destructor.
+    // MediaMetricsConstants.h: AMEDIAMETRICS_PROP_CALLERNAME_VALUE_SOUNDPOOL
+    track->setCallerName("soundpool");
+    return track;
+}
+
+bool Stream::prepare(const std::shared_ptr<Sound>& sound)
+{
+    sp<AudioTrack> oldTrack;  // released outside of lock.
+    std::lock_guard lock(mLock);
+    if (mState != IDLE) return false;
+    if (mAudioTrack != nullptr && mSoundID == sound->getSoundID()) return true;
+
+    const int toggle = mToggle ^ 1;
+    sp<AudioTrack> newTrack = createTrack_l(sound, sound->getSampleRate(), toggle);
+    if (newTrack->initCheck() != NO_ERROR) {
+        ALOGE("%s: error creating AudioTrack", __func__);
+        return false;
+    }
+    ALOGV("%s: prepared track %p for sound %d", __func__, newTrack.get(), sound->getSoundID());
+    oldTrack = mAudioTrack;
+    mToggle = toggle;
+    mAudioTrack = newTrack;
+    mSoundID = sound->getSoundID();
+    return true;
+}
+
 /* static */
 void Stream::staticCallback(int event, void* user, void* info)
 {
@@ -93,6 +93,11 @@ public:
     // returns the pair stream if successful, nullptr otherwise
     Stream* playPairStream();
 
+    // Creates the AudioTrack for the sound on an IDLE stream without starting it,
+    // so that a later play of the sound only needs to start the track.
+    // returns true if the stream holds a track for the sound.
+    bool prepare(const std::shared_ptr<Sound>& sound);
+
     // These parameters are explicitly checked in the SoundPool class
     // so never deviate from the Java API specified values.
     void setVolume(int32_t streamID, float leftVolume, float rightVolume);
@@ -126,6 +131,8 @@ private:
     void play_l(const std::shared_ptr<Sound>& sound, int streamID,
             float leftVolume, float rightVolume, int priority, int loop, float rate,
             sp<AudioTrack> releaseTracks[2]) REQUIRES(mLock);
+    sp<AudioTrack> createTrack_l(const std::shared_ptr<Sound>& sound, uint32_t sampleRate,
+            int toggle) REQUIRES(mLock);
     void stop_l() REQUIRES(mLock);
     void setVolume_l(float leftVolume, float rightVolume) REQUIRES(mLock);
 
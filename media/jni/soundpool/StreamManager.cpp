@@ -259,6 +259,36 @@ int32_t StreamManager::queueForPlay(const std::shared_ptr<Sound> &sound,
     return streamID;
 }
 
+bool StreamManager::prepare(const std::shared_ptr<Sound> &sound)
+{
+    const int32_t soundID = sound->getSoundID();
+    ALOGV("%s(soundID=%d)", __func__, soundID);
+    Stream *stream = nullptr;
+    {
+        std::lock_guard lock(mStreamManagerLock);
+        for (auto available : mAvailableStreams) {
+            if (available->getSoundID() == soundID) {
+                return true; // queueForPlay() will pick this stream.
+            }
+            if (stream == nullptr || (stream->getSoundID() != 0 && available->getSoundID() == 0)) {
+                stream = available;
+            }
+        }
+        if (stream == nullptr) {
+            return false;
+        }
+        removeFromQueues_l(stream);
+        mProcessingStreams.emplace(stream);
+    }
+    // The AudioTrack is created without the lock, like in queueForPlay().
+    const bool prepared = stream->prepare(sound);
+    std::lock_guard lock(mStreamManagerLock);
+    mProcessingStreams.erase(stream);
+    mAvailableStreams.insert(stream);
+    sanityCheckQueue_l();
+    return prepared;
+}
+
 void StreamManager::moveToRestartQueue(
         Stream* stream, int32_t activeStreamIDToMatch)
 {
@@ -397,6 +397,11 @@ public:
             int32_t priority, int32_t loop, float rate)
             NO_THREAD_SAFETY_ANALYSIS; // uses unique_lock
 
+    // Creates an AudioTrack for the sound on an available stream ahead of play(),
+    // preferring streams without a track.  Returns true if an available stream
+    // holds a track for the sound.  This is locked.
+    bool prepare(const std::shared_ptr<Sound> &sound);
+
     ///////////////////////////////////////////////////////////////////////
     // Called from soundpool::Stream
 
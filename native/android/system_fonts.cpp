@@ -54,14 +54,6 @@ struct ParserState {
     XmlCharUniquePtr mLocale;
 };
 
-struct ASystemFontIterator {
-    XmlDocUniquePtr mXmlDoc;
-    ParserState state;
-
-    // The OEM customization XML.
-    XmlDocUniquePtr mCustomizationXmlDoc;
-};
-
 struct AFont {
     std::string mFilePath;
     std::unique_ptr<std::string> mLocale;
@@ -69,6 +61,13 @@ struct AFont {
     bool mItalic;
     uint32_t mCollectionIndex;
     std::vector<std::pair<uint32_t, float>> mAxes;
+    // Fonts of the system font catalog live as long as the process and are not freed on close.
+    bool mInCatalog = false;
+};
+
+struct ASystemFontIterator {
+    const std::vector<AFont>* mFonts;
+    size_t mNextIndex = 0;
 };
 
 struct AFontMatcher {
@@ -210,12 +209,64 @@ bool findFirstFontNode(const XmlDocUniquePtr& doc, ParserState* state) {
     return font != nullptr;
 }
 
+bool findNextFontNode(const XmlDocUniquePtr& xmlDoc, ParserState* state) {
+    if (state->mFontNode == nullptr) {
+        if (!xmlDoc) {
+            return false;  // Already at the end.
+        } else {
+            // First time to query font.
+            return findFirstFontNode(xmlDoc, state);
+        }
+    } else {
+        xmlNode* nextNode = nextSibling(state->mFontNode, FONT_TAG);
+        while (nextNode == nullptr) {
+            xmlNode* family = nextSibling(state->mFontNode->parent, FAMILY_TAG);
+            if (family == nullptr) {
+                break;
+            }
+            state->mLocale.reset(xmlGetProp(family, LOCALE_ATTR_NAME));
+            nextNode = firstElement(family, FONT_TAG);
+        }
+        state->mFontNode = nextNode;
+        return nextNode != nullptr;
+    }
+}
+
+void addAvailableFonts(const char* xmlPath, const std::string& pathPrefix,
+                       std::vector<AFont>* out) {
+    XmlDocUniquePtr xmlDoc(xmlReadFile(xmlPath, nullptr, 0));
+    if (!xmlDoc) {
+        return;
+    }
+    ParserState state;
+    while (findNextFontNode(xmlDoc, &state)) {
+        AFont font;
+        copyFont(xmlDoc, state, &font, pathPrefix);
+        if (isFontFileAvailable(font.mFilePath)) {
+            font.mInCatalog = true;
+            out->push_back(std::move(font));
+        }
+    }
+}
+
+// The font configuration files are read only, so they are parsed once per process and every
+// iterator walks the same catalog.
+const std::vector<AFont>& getSystemFontCatalog() {
+    static const std::vector<AFont>* catalog = [] {
+        std::vector<AFont>* fonts = new std::vector<AFont>();
+        addAvailableFonts("/system/etc/fonts.xml", "/system/fonts/", fonts);
+        // TODO: Filter only customizationType="new-named-family"
+        addAvailableFonts("/product/etc/fonts_customization.xml", "/product/fonts/", fonts);
+        return fonts;
+    }();
+    return *catalog;
+}
+
 }  // namespace
 
 ASystemFontIterator* ASystemFontIterator_open() {
     std::unique_ptr<ASystemFontIterator> ite(new ASystemFontIterator());
-    ite->mXmlDoc.reset(xmlReadFile("/system/etc/fonts.xml", nullptr, 0));
-    ite->mCustomizationXmlDoc.reset(xmlReadFile("/product/etc/fonts_customization.xml", nullptr, 0));
+    ite->mFonts = &getSystemFontCatalog();
     return ite.release();
 }
 
@@ -283,63 +334,18 @@ AFont* _Nonnull AFontMatcher_match(
     return result.release();
 }
 
-bool findNextFontNode(const XmlDocUniquePtr& xmlDoc, ParserState* state) {
-    if (state->mFontNode == nullptr) {
-        if (!xmlDoc) {
-            return false;  // Already at the end.
-        } else {
-            // First time to query font.
-            return findFirstFontNode(xmlDoc, state);
-        }
-    } else {
-        xmlNode* nextNode = nextSibling(state->mFontNode, FONT_TAG);
-        while (nextNode == nullptr) {
-            xmlNode* family = nextSibling(state->mFontNode->parent, FAMILY_TAG);
-            if (family == nullptr) {
-                break;
-            }
-            state->mLocale.reset(xmlGetProp(family, LOCALE_ATTR_NAME));
-            nextNode = firstElement(family, FONT_TAG);
-        }
-        state->mFontNode = nextNode;
-        return nextNode != nullptr;
-    }
-}
-
 AFont* ASystemFontIterator_next(ASystemFontIterator* ite) {
     LOG_ALWAYS_FATAL_IF(ite == nullptr, "nullptr has passed as iterator argument");
-    if (ite->mXmlDoc) {
-        if (!findNextFontNode(ite->mXmlDoc, &ite->state)) {
-            // Reached end of the XML file. Continue OEM customization.
-            ite->mXmlDoc.reset();
-        } else {
-            std::unique_ptr<AFont> font = std::make_unique<AFont>();
-            copyFont(ite->mXmlDoc, ite->state, font.get(), "/system/fonts/");
-            if (!isFontFileAvailable(font->mFilePath)) {
-                return ASystemFontIterator_next(ite);
-            }
-            return font.release();
-        }
+    if (ite->mNextIndex >= ite->mFonts->size()) {
+        return nullptr;
     }
-    if (ite->mCustomizationXmlDoc) {
-        // TODO: Filter only customizationType="new-named-family"
-        if (!findNextFontNode(ite->mCustomizationXmlDoc, &ite->state)) {
-            // Reached end of the XML file. Finishing
-            ite->mCustomizationXmlDoc.reset();
-            return nullptr;
-        } else {
-            std::unique_ptr<AFont> font = std::make_unique<AFont>();
-            copyFont(ite->mCustomizationXmlDoc, ite->state, font.get(), "/product/fonts/");
-            if (!isFontFileAvailable(font->mFilePath)) {
-                return ASystemFontIterator_next(ite);
-            }
-            return font.release();
-        }
-    }
-    return nullptr;
+    return const_cast<AFont*>(&(*ite->mFonts)[ite->mNextIndex++]);
 }
 
 void AFont_close(AFont* font) {
+    if (font != nullptr && font->mInCatalog) {
+        return;
+    }
     delete font;
 }
 
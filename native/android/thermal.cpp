@@ -16,6 +16,7 @@
 
 #define LOG_TAG "thermal"
 
+#include <atomic>
 #include <cerrno>
 #include <thread>
 
@@ -58,6 +59,10 @@ struct AThermalManager {
        sp<ThermalServiceListener> mServiceListener;
        std::vector<ListenerCallback> mListeners;
        std::mutex mMutex;
+       // The last status reported to the service listener, or -1 while none is registered.
+       // The service reports the current status as soon as a listener registers, so while one
+       // is registered the status can be answered without a binder call.
+       std::atomic<int32_t> mListenedStatus;
 };
 
 binder::Status ThermalServiceListener::onStatusChange(int32_t status) {
@@ -80,7 +85,8 @@ AThermalManager* AThermalManager::createAThermalManager() {
 
 AThermalManager::AThermalManager(sp<IThermalService> service)
     : mThermalSvc(service),
-      mServiceListener(nullptr) {
+      mServiceListener(nullptr),
+      mListenedStatus(-1) {
 }
 
 AThermalManager::~AThermalManager() {
@@ -96,6 +102,9 @@ AThermalManager::~AThermalManager() {
 
 status_t AThermalManager::notifyStateChange(int32_t status) {
     std::unique_lock<std::mutex> lock(mMutex);
+    if (mServiceListener != nullptr) {
+        mListenedStatus = status;
+    }
     AThermalStatus thermalStatus = static_cast<AThermalStatus>(status);
 
     for (auto listener : mListeners) {
@@ -169,10 +178,17 @@ status_t AThermalManager::removeListener(AThermal_StatusCallback callback, void
         return EPIPE;
     }
     mServiceListener = nullptr;
+    mListenedStatus = -1;
     return OK;
 }
 
 status_t AThermalManager::getCurrentThermalStatus(int32_t *status) {
+    const int32_t listenedStatus = mListenedStatus;
+    if (listenedStatus >= 0) {
+        *status = listenedStatus;
+        return OK;
+    }
+
     binder::Status ret = mThermalSvc->getCurrentThermalStatus(status);
 
     if (!ret.isOk()) {
@@ -17,7 +17,9 @@
 #define LOG_TAG "BatteryStatsService"
 //#define LOG_NDEBUG 0
 
+#include <algorithm>
 #include <climits>
+#include <deque>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
@@ -28,6 +30,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <unordered_map>
 #include <utility>
 
@@ -114,10 +119,91 @@ struct PowerHalDeathRecipient : virtual public hardware::hidl_death_recipient {
 
 sp<PowerHalDeathRecipient> gDeathRecipient = new PowerHalDeathRecipient();
 
+// Reads the reasons for the last resume and merges them into the form BatteryStats expects:
+// "<irq>:<name>[:<irq>:<name>...]", with "Abort" in place of the irq for aborted suspends.
+static bool readWakeupReasons(std::string* mergedReason) {
+    FILE *fp = fopen(LAST_RESUME_REASON, "re");
+    if (fp == NULL) {
+        ALOGE("Failed to open %s", LAST_RESUME_REASON);
+        return false;
+    }
+
+    ALOGV("Reading wakeup reasons");
+    mergedReason->clear();
+    char reasonline[128];
+    int i = 0;
+    while (fgets(reasonline, sizeof(reasonline), fp) != NULL) {
+        char* pos = reasonline;
+        char* endPos;
+        // First field is the index or 'Abort'.
+        int irq = (int)strtol(pos, &endPos, 10);
+        if (pos != endPos) {
+            // Write the irq number to the merged reason string.
+            if (i > 0) {
+                mergedReason->push_back(':');
+            }
+            mergedReason->append(std::to_string(irq));
+        } else {
+            // The first field is not an irq, it may be the word Abort.
+            const size_t abortPrefixLen = strlen("Abort:");
+            if (strncmp(pos, "Abort:", abortPrefixLen) != 0) {
+                // Ooops.
+                ALOGE("Bad reason line: %s", reasonline);
+                continue;
+            }
+
+            // Write 'Abort' to the merged reason string.
+            mergedReason->append(i == 0 ? "Abort" : ":Abort");
+            endPos = pos + abortPrefixLen;
+        }
+        pos = endPos;
+
+        // Skip whitespace; rest of the buffer is the reason string.
+        while (*pos == ' ') {
+            pos++;
+        }
+
+        // Chop newline at end.
+        mergedReason->push_back(':');
+        mergedReason->append(pos, strcspn(pos, "\n"));
+        i++;
+    }
+    ALOGV("Got %d reasons", i);
+
+    if (fclose(fp) != 0) {
+        ALOGE("Failed to close %s", LAST_RESUME_REASON);
+        return false;
+    }
+    return true;
+}
+
+// Wakeup reasons are read as soon as the suspend service reports the wakeup and queued for
+// nativeWaitWakeup, so a suspend that happens before BatteryStats gets to the last one does not
+// replace its reason with the next one's. A wakeup whose reasons could not be read is queued
+// as nullopt, so that nativeWaitWakeup still returns for it and reports the error.
+static constexpr size_t kMaxQueuedWakeups = 64;
+static std::mutex gWakeupMutex;
+static std::deque<std::optional<std::string>> gWakeupReasons;
+
 class WakeupCallback : public BnSuspendCallback {
    public:
     binder::Status notifyWakeup(bool success) override {
         ALOGI("In wakeup_callback: %s", success ? "resumed from suspend" : "suspend aborted");
+        std::optional<std::string> reason(std::in_place);
+        if (!readWakeupReasons(&*reason)) {
+            reason.reset();
+        }
+        {
+            std::lock_guard<std::mutex> lock(gWakeupMutex);
+            if (gWakeupReasons.size() >= kMaxQueuedWakeups) {
+                ALOGW("Dropping wakeup reason %s, BatteryStats is not keeping up",
+                        gWakeupReasons.front().value_or("<unreadable>").c_str());
+                gWakeupReasons.pop_front();
+                // The semaphore was posted for the dropped reason.
+                sem_trywait(&wakeup_sem);
+            }
+            gWakeupReasons.push_back(std::move(reason));
+        }
         int ret = sem_post(&wakeup_sem);
         if (ret < 0) {
             char buf[80];
@@ -157,8 +243,6 @@ static jint nativeWaitWakeup(JNIEnv *env, jobject clazz, jobject outBuf)
 
     // Wait for wakeup.
     ALOGV("Waiting for wakeup...");
-    // TODO(b/116747600): device can suspend and wakeup after sem_wait() finishes and before wakeup
-    // reason is recorded, i.e. BatteryStats might occasionally miss wakeup events.
     int ret = sem_wait(&wakeup_sem);
     if (ret < 0) {
         char buf[80];
@@ -168,81 +252,30 @@ static jint nativeWaitWakeup(JNIEnv *env, jobject clazz, jobject outBuf)
         return 0;
     }
 
-    FILE *fp = fopen(LAST_RESUME_REASON, "r");
-    if (fp == NULL) {
-        ALOGE("Failed to open %s", LAST_RESUME_REASON);
-        return -1;
-    }
-
-    char* mergedreason = (char*)env->GetDirectBufferAddress(outBuf);
-    int remainreasonlen = (int)env->GetDirectBufferCapacity(outBuf);
-
-    ALOGV("Reading wakeup reasons");
-    char* mergedreasonpos = mergedreason;
-    char reasonline[128];
-    int i = 0;
-    while (fgets(reasonline, sizeof(reasonline), fp) != NULL) {
-        char* pos = reasonline;
-        char* endPos;
-        int len;
-        // First field is the index or 'Abort'.
-        int irq = (int)strtol(pos, &endPos, 10);
-        if (pos != endPos) {
-            // Write the irq number to the merged reason string.
-            len = snprintf(mergedreasonpos, remainreasonlen, i == 0 ? "%d" : ":%d", irq);
-        } else {
-            // The first field is not an irq, it may be the word Abort.
-            const size_t abortPrefixLen = strlen("Abort:");
-            if (strncmp(pos, "Abort:", abortPrefixLen) != 0) {
-                // Ooops.
-                ALOGE("Bad reason line: %s", reasonline);
-                continue;
-            }
-
-            // Write 'Abort' to the merged reason string.
-            len = snprintf(mergedreasonpos, remainreasonlen, i == 0 ? "Abort" : ":Abort");
-            endPos = pos + abortPrefixLen;
-        }
-        pos = endPos;
-
-        if (len >= 0 && len < remainreasonlen) {
-            mergedreasonpos += len;
-            remainreasonlen -= len;
-        }
-
-        // Skip whitespace; rest of the buffer is the reason string.
-        while (*pos == ' ') {
-            pos++;
-        }
-
-        // Chop newline at end.
-        char* endpos = pos;
-        while (*endpos != 0) {
-            if (*endpos == '\n') {
-                *endpos = 0;
-                break;
-            }
-            endpos++;
+    std::string reason;
+    {
+        std::lock_guard<std::mutex> lock(gWakeupMutex);
+        if (gWakeupReasons.empty()) {
+            return 0;
         }
-
-        len = snprintf(mergedreasonpos, remainreasonlen, ":%s", pos);
-        if (len >= 0 && len < remainreasonlen) {
-            mergedreasonpos += len;
-            remainreasonlen -= len;
+        std::optional<std::string> front = std::move(gWakeupReasons.front());
+        gWakeupReasons.pop_front();
+        if (!front) {
+            // The reasons for this wakeup could not be read.
+            return -1;
         }
-        i++;
+        reason = std::move(*front);
     }
 
-    ALOGV("Got %d reasons", i);
-    if (i > 0) {
-        *mergedreasonpos = 0;
-    }
-
-    if (fclose(fp) != 0) {
-        ALOGE("Failed to close %s", LAST_RESUME_REASON);
-        return -1;
+    char* mergedreason = (char*)env->GetDirectBufferAddress(outBuf);
+    jlong capacity = env->GetDirectBufferCapacity(outBuf);
+    if (mergedreason == NULL || capacity <= 0) {
+        return 0;
     }
-    return mergedreasonpos - mergedreason;
+    size_t len = std::min(reason.size(), static_cast<size_t>(capacity - 1));
+    memcpy(mergedreason, reason.data(), len);
+    mergedreason[len] = 0;
+    return len;
 }
 
 // The caller must be holding gPowerHalMutex.
@@ -18,14 +18,21 @@
 //#define LOG_NDEBUG 0
 
 #include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <android-base/stringprintf.h>
 #include <android-base/file.h>
+#include <android-base/unique_fd.h>
 
 #include <nativehelper/JNIHelp.h>
 #include <android_runtime/AndroidRuntime.h>
@@ -35,20 +42,134 @@
 
 using android::base::StringPrintf;
 using android::base::WriteStringToFile;
+using android::base::unique_fd;
 
 #define SYNC_RECEIVED_WHILE_FROZEN (1)
 #define ASYNC_RECEIVED_WHILE_FROZEN (2)
 
+// Not yet in every set of kernel headers this is built against.
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+#ifndef __NR_process_madvise
+#define __NR_process_madvise 440
+#endif
+
 namespace android {
 
+// Number of VMAs advised with a single process_madvise call.
+static constexpr size_t kVmaBatchSize = 64;
+
+// Pages out a batch of VMAs. process_madvise stops at the first range it fails on, such as a
+// locked, PFN-mapped or since unmapped VMA, and returns the bytes advised up to that range, so
+// the call is resumed from the first range that was not advised and a range that fails on its
+// own is skipped.
+// Returns the number of bytes advised, or -1 with errno set when process_madvise cannot be used
+// on the process at all.
+static ssize_t pageOutVmas(int pidfd, struct iovec* vmas, size_t count) {
+    ssize_t total = 0;
+    size_t i = 0;
+    while (i < count) {
+        ssize_t advised = syscall(__NR_process_madvise, pidfd, &vmas[i], count - i,
+                                  MADV_PAGEOUT, 0);
+        if (advised < 0) {
+            if (errno != EINVAL && errno != ENOMEM) {
+                return -1;
+            }
+            i++;
+            continue;
+        }
+        total += advised;
+        const size_t first = i;
+        while (i < count && static_cast<size_t>(advised) >= vmas[i].iov_len) {
+            advised -= vmas[i].iov_len;
+            i++;
+        }
+        if (i < count && advised > 0) {
+            vmas[i].iov_base = static_cast<char*>(vmas[i].iov_base) + advised;
+            vmas[i].iov_len -= advised;
+        } else if (i == first) {
+            i++;
+        }
+    }
+    return total;
+}
+
+// Pages out the anonymous and file-backed memory of a process, walking its mappings once and
+// advising them in batches. The kernel's special mappings, [vdso], [vvar], [vectors] and
+// [vsyscall], cannot be paged out and are skipped.
+// Returns the number of bytes advised, or -1 with errno set when the process could not be opened
+// or process_madvise cannot be used on it.
+static ssize_t pageOutProcess(pid_t pid) {
+    unique_fd pidfd(syscall(__NR_pidfd_open, pid, 0));
+    if (pidfd < 0) {
+        return -1;
+    }
+
+    std::unique_ptr<FILE, decltype(&fclose)> maps(
+            fopen(StringPrintf("/proc/%d/maps", pid).c_str(), "re"), fclose);
+    if (!maps) {
+        return -1;
+    }
+
+    struct iovec vmas[kVmaBatchSize];
+    size_t count = 0;
+    ssize_t total = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), maps.get())) {
+        // A path longer than the line buffer is read in several pieces, only the first of which
+        // starts with an address range.
+        const bool complete = strchr(line, '\n') != nullptr;
+        uintptr_t start, end;
+        int nameOffset = 0;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " %*s %*s %*s %*s %n", &start, &end,
+                   &nameOffset) == 2 && nameOffset > 0
+                && strncmp(&line[nameOffset], "[v", 2) != 0) {
+            vmas[count].iov_base = reinterpret_cast<void*>(start);
+            vmas[count].iov_len = end - start;
+            if (++count == kVmaBatchSize) {
+                ssize_t advised = pageOutVmas(pidfd.get(), vmas, count);
+                if (advised < 0) {
+                    return -1;
+                }
+                total += advised;
+                count = 0;
+            }
+        }
+        while (!complete && fgets(line, sizeof(line), maps.get()) && !strchr(line, '\n')) {
+        }
+    }
+    if (count > 0) {
+        ssize_t advised = pageOutVmas(pidfd.get(), vmas, count);
+        if (advised < 0) {
+            return -1;
+        }
+        total += advised;
+    }
+    return total;
+}
+
 // This performs per-process reclaim on all processes belonging to non-app UIDs.
 // For the most part, these are non-zygote processes like Treble HALs, but it
 // also includes zygote-derived processes that run in system UIDs, like bluetooth
 // or potentially some mainline modules. The only process that should definitely
 // not be compacted is system_server, since compacting system_server around the
 // time of BOOT_COMPLETE could result in perceptible issues.
+//
+// Processes are paged out with process_madvise, which skips the mappings that cannot be
+// reclaimed and holds mmap_sem for one batch of ranges at a time. Kernels without it, and
+// processes it cannot be used on, fall back to the per-process reclaim file.
 static void com_android_server_am_CachedAppOptimizer_compactSystem(JNIEnv *, jobject) {
     std::unique_ptr<DIR, decltype(&closedir)> proc(opendir("/proc"), closedir);
+    if (!proc) {
+        ALOGW("Unable to open /proc: %s", strerror(errno));
+        return;
+    }
+
+    const pid_t selfPid = getpid();
+    bool useProcessMadvise = true;
+    size_t compacted = 0;
+    int64_t advisedBytes = 0;
     struct dirent* current;
     while ((current = readdir(proc.get()))) {
         if (current->d_type != DT_DIR) {
@@ -57,14 +178,15 @@ static void com_android_server_am_CachedAppOptimizer_compactSystem(JNIEnv *, job
 
         // don't compact system_server, rely on persistent compaction during screen off
         // in order to avoid mmap_sem-related stalls
-        if (atoi(current->d_name) == getpid()) {
+        const pid_t pid = atoi(current->d_name);
+        if (pid <= 0 || pid == selfPid) {
             continue;
         }
 
-        std::string status_name = StringPrintf("/proc/%s/status", current->d_name);
+        std::string status_name = StringPrintf("%s/status", current->d_name);
         struct stat status_info;
 
-        if (stat(status_name.c_str(), &status_info) != 0) {
+        if (fstatat(dirfd(proc.get()), status_name.c_str(), &status_info, 0) != 0) {
             // must be some other directory that isn't a pid
             continue;
         }
@@ -74,9 +196,30 @@ static void com_android_server_am_CachedAppOptimizer_compactSystem(JNIEnv *, job
             continue;
         }
 
+        if (useProcessMadvise) {
+            ssize_t advised = pageOutProcess(pid);
+            if (advised >= 0) {
+                advisedBytes += advised;
+                compacted++;
+                continue;
+            }
+            if (errno == ESRCH) {
+                // The process exited while it was being compacted.
+                continue;
+            }
+            if (errno == ENOSYS) {
+                useProcessMadvise = false;
+            }
+        }
+
         std::string reclaim_path = StringPrintf("/proc/%s/reclaim", current->d_name);
-        WriteStringToFile(std::string("all"), reclaim_path);
+        if (WriteStringToFile(std::string("all"), reclaim_path)) {
+            compacted++;
+        }
     }
+
+    ALOGV("Compacted %zu system processes, paged out %" PRId64 " bytes with process_madvise",
+          compacted, advisedBytes);
 }
 
 static void com_android_server_am_CachedAppOptimizer_enableFreezerInternal(
@@ -24,6 +24,7 @@
 #include <jni.h>
 #include <nativehelper/JNIHelp.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -43,8 +44,15 @@ static constexpr int PSI_HIGH_STALL_US = 50000;
 // stall tracking window size in us
 static constexpr int PSI_WINDOW_SIZE_US = 1000000;
 
+// how long a level is held after it was last triggered. A trigger fires at most once per
+// window, so a level that has not fired for a whole window is no longer being reached.
+static constexpr nsecs_t PSI_HOLD_NS = us2ns(PSI_WINDOW_SIZE_US);
+
 static int psi_epollfd = -1;
 
+// time each level was last triggered, 0 if never
+static nsecs_t last_event_ns[PRESSURE_LEVEL_COUNT + 1];
+
 static jint android_server_am_LowMemDetector_init(JNIEnv*, jobject) {
     int epollfd;
     int low_psi_fd;
@@ -90,55 +98,75 @@ low_fail:
     return -1;
 }
 
+// Reads the pending psi events without blocking, recording when each level was last triggered.
+// Returns the number of events read, or -1 if psi events are no longer available.
+static int read_psi_events(struct epoll_event* events, int nevents) {
+    int total = 0;
+    while (nevents > 0) {
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (int i = 0; i < nevents; i++) {
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                // should never happen unless psi got disabled in kernel
+                ALOGE("Memory pressure events are not available anymore");
+                return -1;
+            }
+            last_event_ns[events[i].data.u32] = now;
+        }
+        total += nevents;
+        nevents = epoll_wait(psi_epollfd, events, PRESSURE_LEVEL_COUNT, 0);
+    }
+    return total;
+}
+
+// Returns the highest level triggered within the hold time, and sets timeout_ms to when that
+// level lapses, or to -1 if there is no pressure.
+static uint32_t get_pressure_level(int* timeout_ms) {
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (uint32_t level = PRESSURE_HIGH; level > PRESSURE_NONE; level--) {
+        nsecs_t held = now - last_event_ns[level];
+        if (last_event_ns[level] != 0 && held < PSI_HOLD_NS) {
+            *timeout_ms = ns2ms(PSI_HOLD_NS - held) + 1;
+            return level;
+        }
+    }
+    *timeout_ms = -1;
+    return PRESSURE_NONE;
+}
+
 static jint android_server_am_LowMemDetector_waitForPressure(JNIEnv*, jobject) {
-    static uint32_t pressure_level = PRESSURE_NONE;
+    static uint32_t reported_level = PRESSURE_NONE;
     struct epoll_event events[PRESSURE_LEVEL_COUNT];
-    int nevents = 0;
 
     if (psi_epollfd < 0) {
         ALOGE("Memory pressure detector is not initialized");
         return -1;
     }
 
-    do {
-        if (pressure_level == PRESSURE_NONE) {
-            /* Wait for events with no timeout */
-            nevents = epoll_wait(psi_epollfd, events, PRESSURE_LEVEL_COUNT, -1);
-        } else {
-            // This is simpler than lmkd. Assume that the memory pressure
-            // state will stay high for at least 1s. Within that 1s window,
-            // the memory pressure state can go up due to a different FD
-            // becoming available or it can go down when that window expires.
-            // Accordingly, there's no polling: just epoll_wait with a 1s timeout.
-            nevents = epoll_wait(psi_epollfd, events, PRESSURE_LEVEL_COUNT, 1000);
-            if (nevents == 0) {
-                pressure_level = PRESSURE_NONE;
-                return pressure_level;
-            }
+    // Only return when the level changes. Each level is held for a window after it was last
+    // triggered, so pressure steps down through the levels still being reached instead of
+    // dropping to none and climbing back on the next trigger. Triggers that fired together are
+    // read before the level is worked out, so a burst across several levels makes one wakeup.
+    for (;;) {
+        int timeout_ms;
+        uint32_t level = get_pressure_level(&timeout_ms);
+        if (level != reported_level) {
+            reported_level = level;
+            return level;
         }
-        // keep waiting if interrupted
-    } while (nevents == -1 && errno == EINTR);
 
-    if (nevents == -1) {
-        ALOGE("epoll_wait failed while waiting for psi events: %s", strerror(errno));
-        return -1;
-    }
-
-    // reset pressure_level and raise it based on received events
-    pressure_level = PRESSURE_NONE;
-    for (int i = 0; i < nevents; i++) {
-        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
-            // should never happen unless psi got disabled in kernel
-            ALOGE("Memory pressure events are not available anymore");
+        int nevents = epoll_wait(psi_epollfd, events, PRESSURE_LEVEL_COUNT, timeout_ms);
+        if (nevents == -1) {
+            // keep waiting if interrupted
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("epoll_wait failed while waiting for psi events: %s", strerror(errno));
             return -1;
         }
-        // record the highest reported level
-        if (events[i].data.u32 > pressure_level) {
-            pressure_level = events[i].data.u32;
+        if (read_psi_events(events, nevents) < 0) {
+            return -1;
         }
     }
-
-    return pressure_level;
 }
 
 static const JNINativeMethod sMethods[] = {
@@ -20,6 +20,8 @@
 #include <inttypes.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <jni.h>
@@ -32,6 +34,7 @@
 #include <utils/Log.h>
 #include <utils/misc.h>
 
+#include "android-base/macros.h"
 #include "android-base/unique_fd.h"
 #include "bpf/BpfUtils.h"
 #include "netdbpf/BpfNetworkStats.h"
@@ -205,6 +208,37 @@ static int legacyReadNetworkStatsDetail(std::vector<stats_line>* lines,
     return 0;
 }
 
+// Hands out one Java string per distinct interface name. A snapshot has a row for every uid, tag
+// and set on each interface, but only a handful of interfaces, so the rows share their strings.
+class IfaceStrings {
+public:
+    explicit IfaceStrings(JNIEnv* env) : mEnv(env) {}
+
+    ~IfaceStrings() {
+        for (auto& entry : mStrings) {
+            mEnv->DeleteLocalRef(entry.second);
+        }
+    }
+
+    jstring get(const char* iface) {
+        auto it = mStrings.find(iface);
+        if (it != mStrings.end()) {
+            return it->second;
+        }
+        jstring string = mEnv->NewStringUTF(iface);
+        if (string != NULL) {
+            mStrings.emplace(iface, string);
+        }
+        return string;
+    }
+
+private:
+    JNIEnv* mEnv;
+    std::unordered_map<std::string, jstring> mStrings;
+
+    DISALLOW_COPY_AND_ASSIGN(IfaceStrings);
+};
+
 static int statsLinesToNetworkStats(JNIEnv* env, jclass clazz, jobject stats,
                             std::vector<stats_line>& lines) {
     int size = lines.size();
@@ -223,15 +257,6 @@ static int statsLinesToNetworkStats(JNIEnv* env, jclass clazz, jobject stats,
     ScopedIntArrayRW tag(env, get_int_array(env, stats,
             gNetworkStatsClassInfo.tag, size, grow));
     if (tag.get() == NULL) return -1;
-    ScopedIntArrayRW metered(env, get_int_array(env, stats,
-            gNetworkStatsClassInfo.metered, size, grow));
-    if (metered.get() == NULL) return -1;
-    ScopedIntArrayRW roaming(env, get_int_array(env, stats,
-            gNetworkStatsClassInfo.roaming, size, grow));
-    if (roaming.get() == NULL) return -1;
-    ScopedIntArrayRW defaultNetwork(env, get_int_array(env, stats,
-            gNetworkStatsClassInfo.defaultNetwork, size, grow));
-    if (defaultNetwork.get() == NULL) return -1;
     ScopedLongArrayRW rxBytes(env, get_long_array(env, stats,
             gNetworkStatsClassInfo.rxBytes, size, grow));
     if (rxBytes.get() == NULL) return -1;
@@ -244,13 +269,12 @@ static int statsLinesToNetworkStats(JNIEnv* env, jclass clazz, jobject stats,
     ScopedLongArrayRW txPackets(env, get_long_array(env, stats,
             gNetworkStatsClassInfo.txPackets, size, grow));
     if (txPackets.get() == NULL) return -1;
-    ScopedLongArrayRW operations(env, get_long_array(env, stats,
-            gNetworkStatsClassInfo.operations, size, grow));
-    if (operations.get() == NULL) return -1;
 
+    IfaceStrings ifaceStrings(env);
     for (int i = 0; i < size; i++) {
-        ScopedLocalRef<jstring> ifaceString(env, env->NewStringUTF(lines[i].iface));
-        env->SetObjectArrayElement(iface.get(), i, ifaceString.get());
+        jstring ifaceString = ifaceStrings.get(lines[i].iface);
+        if (ifaceString == NULL) return -1;
+        env->SetObjectArrayElement(iface.get(), i, ifaceString);
 
         uid[i] = lines[i].uid;
         set[i] = lines[i].set;
@@ -264,20 +288,30 @@ static int statsLinesToNetworkStats(JNIEnv* env, jclass clazz, jobject stats,
 
     env->SetIntField(stats, gNetworkStatsClassInfo.size, size);
     if (grow) {
+        // The arrays that are not filled in here only need to be replaced when growing, so they
+        // are not pinned and copied back on every read.
+        ScopedLocalRef<jintArray> metered(env, env->NewIntArray(size));
+        if (metered.get() == NULL) return -1;
+        ScopedLocalRef<jintArray> roaming(env, env->NewIntArray(size));
+        if (roaming.get() == NULL) return -1;
+        ScopedLocalRef<jintArray> defaultNetwork(env, env->NewIntArray(size));
+        if (defaultNetwork.get() == NULL) return -1;
+        ScopedLocalRef<jlongArray> operations(env, env->NewLongArray(size));
+        if (operations.get() == NULL) return -1;
+
         env->SetIntField(stats, gNetworkStatsClassInfo.capacity, size);
         env->SetObjectField(stats, gNetworkStatsClassInfo.iface, iface.get());
         env->SetObjectField(stats, gNetworkStatsClassInfo.uid, uid.getJavaArray());
         env->SetObjectField(stats, gNetworkStatsClassInfo.set, set.getJavaArray());
         env->SetObjectField(stats, gNetworkStatsClassInfo.tag, tag.getJavaArray());
-        env->SetObjectField(stats, gNetworkStatsClassInfo.metered, metered.getJavaArray());
-        env->SetObjectField(stats, gNetworkStatsClassInfo.roaming, roaming.getJavaArray());
-        env->SetObjectField(stats, gNetworkStatsClassInfo.defaultNetwork,
-                defaultNetwork.getJavaArray());
+        env->SetObjectField(stats, gNetworkStatsClassInfo.metered, metered.get());
+        env->SetObjectField(stats, gNetworkStatsClassInfo.roaming, roaming.get());
+        env->SetObjectField(stats, gNetworkStatsClassInfo.defaultNetwork, defaultNetwork.get());
         env->SetObjectField(stats, gNetworkStatsClassInfo.rxBytes, rxBytes.getJavaArray());
         env->SetObjectField(stats, gNetworkStatsClassInfo.rxPackets, rxPackets.getJavaArray());
         env->SetObjectField(stats, gNetworkStatsClassInfo.txBytes, txBytes.getJavaArray());
         env->SetObjectField(stats, gNetworkStatsClassInfo.txPackets, txPackets.getJavaArray());
-        env->SetObjectField(stats, gNetworkStatsClassInfo.operations, operations.getJavaArray());
+        env->SetObjectField(stats, gNetworkStatsClassInfo.operations, operations.get());
     }
     return 0;
 }
@@ -297,8 +331,9 @@ static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats, jstr
             }
         }
     }
+    // Most reads return about as many rows as the last one did.
     std::vector<stats_line> lines;
-
+    lines.reserve(env->GetIntField(stats, gNetworkStatsClassInfo.size));
 
     if (useBpfStats) {
         if (parseBpfNetworkStatsDetail(&lines, limitIfaces, limitTag, limitUid) < 0)
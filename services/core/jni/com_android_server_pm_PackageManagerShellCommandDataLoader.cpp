@@ -649,6 +649,8 @@ private:
             return;
         }
         CHECK(mIfs);
+        // Several readers waiting on the same block are reported separately, request it once.
+        std::unordered_set<uint64_t> requestedBlocks;
         for (auto&& pendingRead : pendingReads) {
             const android::dataloader::FileId& fileId = pendingRead.id;
             const auto blockIdx = static_cast<BlockIdx>(pendingRead.block);
@@ -661,6 +663,10 @@ private:
                       android::incfs::toString(fileId).c_str());
                 continue;
             }
+            const uint64_t blockKey = (uint64_t(uint16_t(fileIdx)) << 32) | uint32_t(blockIdx);
+            if (!requestedBlocks.insert(blockKey).second) {
+                continue;
+            }
             if (mRequestedFiles.insert(fileIdx).second &&
                 !sendRequest(mOutFd, PREFETCH, fileIdx, blockIdx)) {
                 mRequestedFiles.erase(fileIdx);
@@ -60,6 +60,15 @@ int enableFsverity(JNIEnv* env, jobject /* clazz */, jstring filePath, jbyteArra
     arg.sig_size = signature_bytes.size();
     arg.sig_ptr = reinterpret_cast<uintptr_t>(signature_bytes.get());
 
+    // The kernel builds the Merkle tree by reading the file one page at a time, which without
+    // readahead is one small synchronous read per block. Start reading the whole file in large
+    // requests first, so the hashing mostly finds its pages already cached. This is only a hint;
+    // enabling fs-verity does not depend on it.
+    struct stat st;
+    if (fstat(rfd.get(), &st) == 0 && st.st_size > 0) {
+        posix_fadvise(rfd.get(), 0, st.st_size, POSIX_FADV_WILLNEED);
+    }
+
     if (ioctl(rfd.get(), FS_IOC_ENABLE_VERITY, &arg) < 0) {
         return errno;
     }
@@ -70,9 +79,13 @@ int enableFsverity(JNIEnv* env, jobject /* clazz */, jstring filePath, jbyteArra
 // 0 if it is not present, 1 if is present, and -errno if there was an error.
 int statxForFsverity(JNIEnv *env, jobject /* clazz */, jstring filePath) {
     ScopedUtfChars path(env, filePath);
+    if (path.c_str() == nullptr) {
+        return -EINVAL;
+    }
 
+    // Only the attributes are needed, and those are returned whatever the mask asks for.
     struct statx out = {};
-    if (statx(AT_FDCWD, path.c_str(), 0 /* flags */, STATX_ALL, &out) != 0) {
+    if (statx(AT_FDCWD, path.c_str(), 0 /* flags */, 0 /* mask */, &out) != 0) {
         return -errno;
     }
 
@@ -119,7 +119,7 @@ static bool initializePowerStats() {
         }
 
         // construct lookup table of powerEntityId to power entity name
-        for (auto info : infos) {
+        for (const auto& info : infos) {
             gEntityNames.emplace(info.powerEntityId, info.powerEntityName);
         }
     });
@@ -134,13 +134,13 @@ static bool initializePowerStats() {
         }
 
         // construct lookup table of powerEntityId, powerEntityStateId to power entity state name
-        for (auto stateSpace : stateSpaces) {
-            std::unordered_map<uint32_t, std::string> stateNames = {};
-            for (auto state : stateSpace.states) {
+        for (const auto& stateSpace : stateSpaces) {
+            std::unordered_map<uint32_t, std::string>& stateNames =
+                    gStateNames[stateSpace.powerEntityId];
+            for (const auto& state : stateSpace.states) {
                 stateNames.emplace(state.powerEntityStateId,
                     state.powerEntityStateName);
             }
-            gStateNames.emplace(stateSpace.powerEntityId, stateNames);
         }
     });
     if (!checkResultLocked(ret, __func__)) {
@@ -170,7 +170,12 @@ static bool getPowerStatsHalLocked() {
             ALOGW("Unable to link to power.stats HAL death notifications");
             // We should still continue even though linking failed
         }
-        return initializePowerStats();
+        // The names are only fetched along with a new handle, so drop the handle if they could
+        // not be fetched and retry on the next pull rather than pulling without them.
+        if (!initializePowerStats()) {
+            deinitPowerStatsLocked();
+            return false;
+        }
     }
     return true;
 }
@@ -192,16 +197,24 @@ static AStatsManager_PullAtomCallbackReturn getIPowerStatsDataLocked(int32_t ato
                     success = false;
                     return;
                 }
-                for (auto result : results) {
-                    for (auto stateResidency : result.stateResidencyData) {
+                for (const auto& result : results) {
+                    auto entityName = gEntityNames.find(result.powerEntityId);
+                    auto stateNames = gStateNames.find(result.powerEntityId);
+                    if (entityName == gEntityNames.end() || stateNames == gStateNames.end()) {
+                        ALOGW("Unknown power entity %u", result.powerEntityId);
+                        continue;
+                    }
+                    for (const auto& stateResidency : result.stateResidencyData) {
+                        auto stateName = stateNames->second.find(stateResidency.powerEntityStateId);
+                        if (stateName == stateNames->second.end()) {
+                            ALOGW("Unknown state %u of power entity %u",
+                                  stateResidency.powerEntityStateId, result.powerEntityId);
+                            continue;
+                        }
                         AStatsEvent* event = AStatsEventList_addStatsEvent(data);
                         AStatsEvent_setAtomId(event, android::util::SUBSYSTEM_SLEEP_STATE);
-                        AStatsEvent_writeString(event,
-                                                gEntityNames.at(result.powerEntityId).c_str());
-                        AStatsEvent_writeString(event,
-                                                gStateNames.at(result.powerEntityId)
-                                                        .at(stateResidency.powerEntityStateId)
-                                                        .c_str());
+                        AStatsEvent_writeString(event, entityName->second.c_str());
+                        AStatsEvent_writeString(event, stateName->second.c_str());
                         AStatsEvent_writeInt64(event, stateResidency.totalStateEntryCount);
                         AStatsEvent_writeInt64(event, stateResidency.totalTimeInStateMs);
                         AStatsEvent_build(event);
@@ -291,11 +304,10 @@ static AStatsManager_PullAtomCallbackReturn getIPowerDataLocked(int32_t atomTag,
             return AStatsManager_PULL_SKIP;
         }
 
-        // Trying to cast to IPower 1.1, this will succeed only for devices supporting 1.1
-        sp<android::hardware::power::V1_1::IPower> gPowerHal_1_1 =
-                android::hardware::power::V1_1::IPower::castFrom(gPowerHalV1_0);
-        if (gPowerHal_1_1 != nullptr) {
-            ret = gPowerHal_1_1->getSubsystemLowPowerStats(
+        // gPowerHalV1_1 is only set on devices supporting IPower 1.1. It was cast along with
+        // the handle, as each cast is a transaction with the HAL.
+        if (gPowerHalV1_1 != nullptr) {
+            ret = gPowerHalV1_1->getSubsystemLowPowerStats(
                     [&data](hidl_vec<PowerStateSubsystem> subsystems, Status status) {
                         if (status != Status::SUCCESS) return;
 
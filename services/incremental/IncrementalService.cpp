@@ -18,6 +18,7 @@
 
 #include "IncrementalService.h"
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/no_destructor.h>
 #include <android-base/properties.h>
@@ -28,6 +29,7 @@
 #include <sys/stat.h>
 #include <uuid/uuid.h>
 
+#include <algorithm>
 #include <charconv>
 #include <ctime>
 #include <iterator>
@@ -65,6 +67,12 @@ struct Constants {
     static constexpr auto libSuffix = ".so"sv;
     static constexpr auto blockSize = 4096;
     static constexpr auto systemPackage = "android"sv;
+    static constexpr auto readProfilesDir = "read_profiles"sv;
+    static constexpr size_t maxReadSequenceSize = 64 * 1024;
+    static constexpr size_t prefetchBlocks = 64;
+    static constexpr size_t maxPendingPrefetches = 256;
+    static constexpr size_t maxReadProfiles = 512;
+    static constexpr auto readProfileMaxAge = 30 * 24h;
 };
 
 static const Constants& constants() {
@@ -174,6 +182,17 @@ std::string makeBindMdName() {
     return name;
 }
 
+static std::string readProfileName(const incfs::FileId& fileId) {
+    static constexpr char kHexChars[] = "0123456789abcdef";
+    std::string name;
+    name.reserve(sizeof(fileId.data) * 2);
+    for (unsigned char c : fileId.data) {
+        name += kHexChars[c >> 4];
+        name += kHexChars[c & 0xf];
+    }
+    return name;
+}
+
 static bool checkReadLogsDisabledMarker(std::string_view root) {
     const auto markerPath = path::c_str(path::join(root, constants().readLogsDisabledMarkerName));
     struct stat st;
@@ -286,14 +305,18 @@ IncrementalService::IncrementalService(ServiceManagerWrapper&& sm, std::string_v
     CHECK(mTimedQueue) << "TimedQueue is unavailable";
 
     mJobQueue.reserve(16);
-    mJobProcessor = std::thread([this]() {
-        mJni->initializeForCurrentThread();
-        runJobProcessing();
-    });
+    mJobProcessors.reserve(kJobProcessorCount);
+    for (int i = 0; i < kJobProcessorCount; ++i) {
+        mJobProcessors.emplace_back([this]() {
+            mJni->initializeForCurrentThread();
+            runJobProcessing();
+        });
+    }
     mCmdLooperThread = std::thread([this]() {
         mJni->initializeForCurrentThread();
         runCmdLooper();
     });
+    mPrefetchProcessor = std::thread([this]() { runPrefetching(); });
 
     const auto mountedRootNames = adoptMountedInstances();
     mountExistingImages(mountedRootNames);
@@ -305,7 +328,15 @@ IncrementalService::~IncrementalService() {
         mRunning = false;
     }
     mJobCondition.notify_all();
-    mJobProcessor.join();
+    for (auto&& processor : mJobProcessors) {
+        processor.join();
+    }
+    {
+        std::lock_guard lock(mPrefetchMutex);
+        mPrefetchQueue.clear();
+    }
+    mPrefetchCondition.notify_all();
+    mPrefetchProcessor.join();
     mLooper->wake();
     mCmdLooperThread.join();
     mTimedQueue->stop();
@@ -1242,6 +1273,7 @@ void IncrementalService::mountExistingImages(
         PLOG(WARNING) << "Couldn't open the root incremental dir " << mIncrementalDir;
         return;
     }
+    std::vector<std::string> roots;
     while (auto entry = ::readdir(dir.get())) {
         if (entry->d_type != DT_DIR) {
             continue;
@@ -1253,10 +1285,27 @@ void IncrementalService::mountExistingImages(
         if (mountedRootNames.find(name) != mountedRootNames.end()) {
             continue;
         }
-        const auto root = path::join(mIncrementalDir, name);
-        if (!mountExistingImage(root)) {
-            IncFsMount::cleanupFilesystem(root);
+        roots.push_back(path::join(mIncrementalDir, name));
+    }
+
+    // Mounts are independent of each other: restore them in parallel so that a single slow
+    // mount doesn't hold all the others back after a reboot.
+    std::atomic<size_t> next = 0;
+    auto restore = [this, &roots, &next]() {
+        for (auto i = next++; i < roots.size(); i = next++) {
+            if (!mountExistingImage(roots[i])) {
+                IncFsMount::cleanupFilesystem(roots[i]);
+            }
         }
+    };
+    std::vector<std::thread> workers;
+    const auto workerCount = std::min<size_t>(roots.size(), kJobProcessorCount);
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back(restore);
+    }
+    restore();
+    for (auto&& worker : workers) {
+        worker.join();
     }
 }
 
@@ -1286,7 +1335,10 @@ bool IncrementalService::mountExistingImage(std::string_view root) {
     }
 
     ifs->mountId = mount.storage().id();
-    mNextId = std::max(mNextId, ifs->mountId + 1);
+    {
+        std::lock_guard l(mLock);
+        mNextId = std::max(mNextId, ifs->mountId + 1);
+    }
 
     // Check if marker file present.
     if (checkReadLogsDisabledMarker(mountTarget)) {
@@ -1337,6 +1389,7 @@ bool IncrementalService::mountExistingImage(std::string_view root) {
                                  << root;
                     continue;
                 }
+                std::lock_guard l(mLock);
                 auto [_, inserted] = mMounts.try_emplace(storageId, ifs);
                 if (!inserted) {
                     LOG(WARNING) << "Ignoring storage with duplicate id " << storageId
@@ -1357,14 +1410,13 @@ bool IncrementalService::mountExistingImage(std::string_view root) {
     }
 
     int bindCount = 0;
-    {
+    for (auto&& bp : bindPoints) {
+        // Only hold the lock for the records, the bind mounts of other mounts may go in between.
         std::unique_lock l(mLock, std::defer_lock);
-        for (auto&& bp : bindPoints) {
-            bindCount += !addBindMountWithMd(*ifs, bp.second.storage_id(), std::move(bp.first),
-                                             std::move(*bp.second.mutable_source_subdir()),
-                                             std::move(*bp.second.mutable_dest_path()),
-                                             BindKind::Permanent, l);
-        }
+        bindCount += !addBindMountWithMd(*ifs, bp.second.storage_id(), std::move(bp.first),
+                                         std::move(*bp.second.mutable_source_subdir()),
+                                         std::move(*bp.second.mutable_dest_path()),
+                                         BindKind::Permanent, l);
     }
 
     if (bindCount == 0) {
@@ -1373,7 +1425,8 @@ bool IncrementalService::mountExistingImage(std::string_view root) {
         return false;
     }
 
-    // not locking here at all: we're still in the constructor, no other calls can happen
+    // Other mounts are being restored in parallel, so the map still needs the lock.
+    std::lock_guard l(mLock);
     mMounts[ifs->mountId] = std::move(ifs);
     return true;
 }
@@ -1666,10 +1719,15 @@ bool IncrementalService::waitForNativeBinariesExtraction(StorageId storage) {
     }
 
     std::unique_lock lock(mJobMutex);
+    ++mAwaitedJobsMounts[mount];
     mJobCondition.wait(lock, [this, mount] {
         return !mRunning ||
-                (mPendingJobsMount != mount && mJobQueue.find(mount) == mJobQueue.end());
+                (mPendingJobsMounts.find(mount) == mPendingJobsMounts.end() &&
+                 mJobQueue.find(mount) == mJobQueue.end());
     });
+    if (auto it = mAwaitedJobsMounts.find(mount); --it->second == 0) {
+        mAwaitedJobsMounts.erase(it);
+    }
     return mRunning;
 }
 
@@ -1678,16 +1736,36 @@ bool IncrementalService::perfLoggingEnabled() {
     return enabled;
 }
 
+auto IncrementalService::nextJobsLocked() -> JobMap::iterator {
+    // Jobs of a single mount run in order, so skip the mounts another processor works on.
+    auto next = mJobQueue.end();
+    for (auto it = mJobQueue.begin(); it != mJobQueue.end(); ++it) {
+        if (mPendingJobsMounts.find(it->first) != mPendingJobsMounts.end()) {
+            continue;
+        }
+        if (mAwaitedJobsMounts.find(it->first) != mAwaitedJobsMounts.end()) {
+            return it;
+        }
+        if (next == mJobQueue.end()) {
+            next = it;
+        }
+    }
+    return next;
+}
+
 void IncrementalService::runJobProcessing() {
     for (;;) {
         std::unique_lock lock(mJobMutex);
-        mJobCondition.wait(lock, [this]() { return !mRunning || !mJobQueue.empty(); });
+        auto it = mJobQueue.end();
+        mJobCondition.wait(lock, [this, &it]() {
+            return !mRunning || (it = nextJobsLocked()) != mJobQueue.end();
+        });
         if (!mRunning) {
             return;
         }
 
-        auto it = mJobQueue.begin();
-        mPendingJobsMount = it->first;
+        const auto mount = it->first;
+        mPendingJobsMounts.insert(mount);
         auto queue = std::move(it->second);
         mJobQueue.erase(it);
         lock.unlock();
@@ -1697,7 +1775,7 @@ void IncrementalService::runJobProcessing() {
         }
 
         lock.lock();
-        mPendingJobsMount = kInvalidStorageId;
+        mPendingJobsMounts.erase(mount);
         lock.unlock();
         mJobCondition.notify_all();
     }
@@ -1769,6 +1847,104 @@ void IncrementalService::removeTimedJobs(MountId id) {
     mTimedQueue->removeJobs(id);
 }
 
+std::string IncrementalService::readProfilePath(std::string_view fileName) const {
+    return path::join(mIncrementalDir, constants().readProfilesDir, fileName);
+}
+
+// Read profiles are rewritten whenever their file is read again, so the ones that were not
+// modified for a while belong to APKs that are gone or no longer used.
+void IncrementalService::trimReadProfiles() {
+    const auto dirPath = path::join(mIncrementalDir, constants().readProfilesDir);
+    const auto dir = openDir(dirPath);
+    if (!dir) {
+        return;
+    }
+    const auto now = std::chrono::system_clock::now();
+    std::vector<std::pair<std::chrono::system_clock::time_point, std::string>> profiles;
+    while (auto entry = ::readdir(dir.get())) {
+        if (entry->d_type != DT_REG) {
+            continue;
+        }
+        struct stat st;
+        if (::fstatat(::dirfd(dir.get()), entry->d_name, &st, 0)) {
+            continue;
+        }
+        const auto modified = std::chrono::system_clock::from_time_t(st.st_mtime);
+        if (now - modified > constants().readProfileMaxAge) {
+            ::unlinkat(::dirfd(dir.get()), entry->d_name, 0);
+            continue;
+        }
+        profiles.emplace_back(modified, entry->d_name);
+    }
+    if (profiles.size() <= constants().maxReadProfiles) {
+        return;
+    }
+    const auto excess = profiles.size() - constants().maxReadProfiles;
+    std::partial_sort(profiles.begin(), profiles.begin() + excess, profiles.end());
+    for (size_t i = 0; i < excess; ++i) {
+        ::unlinkat(::dirfd(dir.get()), profiles[i].second.c_str(), 0);
+    }
+}
+
+void IncrementalService::prefetchBlocks(MountId id, FileId fileId,
+                                        std::vector<BlockIndex>&& blocks) {
+    {
+        std::lock_guard lock(mPrefetchMutex);
+        if (!mRunning || mPrefetchQueue.size() >= constants().maxPendingPrefetches) {
+            return;
+        }
+        mPrefetchQueue.push_back({id, fileId, std::move(blocks)});
+    }
+    mPrefetchCondition.notify_all();
+}
+
+void IncrementalService::cancelPrefetches(MountId id) {
+    std::lock_guard lock(mPrefetchMutex);
+    mPrefetchQueue.erase(std::remove_if(mPrefetchQueue.begin(), mPrefetchQueue.end(),
+                                        [id](const auto& request) {
+                                            return request.mountId == id;
+                                        }),
+                         mPrefetchQueue.end());
+    if (mPrefetchingMount == id) {
+        mPrefetchCancelled = true;
+    }
+}
+
+void IncrementalService::runPrefetching() {
+    for (;;) {
+        std::unique_lock lock(mPrefetchMutex);
+        mPrefetchCondition.wait(lock, [this]() { return !mRunning || !mPrefetchQueue.empty(); });
+        if (!mRunning) {
+            return;
+        }
+
+        auto request = std::move(mPrefetchQueue.front());
+        mPrefetchQueue.pop_front();
+        mPrefetchingMount = request.mountId;
+        mPrefetchCancelled = false;
+        lock.unlock();
+
+        const auto ifs = getIfs(request.mountId);
+        if (!ifs) {
+            continue;
+        }
+        const auto fd = mIncFs->openForSpecialOps(ifs->control, request.fileId);
+        if (!fd.ok()) {
+            continue;
+        }
+        // Touching a block that is not loaded yet turns it into a pending read, which is how the
+        // data loader learns what to stream next. Loaded blocks come straight from the disk.
+        // Each read may wait for the data loader, so cancellation is checked before every block.
+        char byte;
+        for (auto block : request.blocks) {
+            if (!mRunning || mPrefetchCancelled ||
+                ::pread64(fd.get(), &byte, 1, off64_t(block) * constants().blockSize) < 0) {
+                break;
+            }
+        }
+    }
+}
+
 IncrementalService::DataLoaderStub::DataLoaderStub(IncrementalService& service, MountId id,
                                                    DataLoaderParamsParcel&& params,
                                                    FileSystemControlParcel&& control,
@@ -1805,6 +1981,8 @@ void IncrementalService::DataLoaderStub::cleanupResources() {
     auto now = Clock::now();
     {
         std::unique_lock lock(mMutex);
+        mService.cancelPrefetches(id());
+        saveReadProfiles();
         mHealthPath.clear();
         unregisterFromPendingReads();
         resetHealthControl();
@@ -2145,12 +2323,89 @@ BootClockTsUs IncrementalService::DataLoaderStub::getOldestPendingReadTs() {
     LOG(DEBUG) << id() << ": pendingReads: " << control.pendingReads() << ", "
                << pendingReads.size() << ": " << pendingReads.front().bootClockTsUs;
 
+    recordPendingReads(pendingReads);
+
     for (auto&& pendingRead : pendingReads) {
         result = std::min(result, pendingRead.bootClockTsUs);
     }
     return result;
 }
 
+void IncrementalService::DataLoaderStub::recordPendingReads(
+        const std::vector<incfs::ReadInfo>& pendingReads) {
+    for (auto&& pendingRead : pendingReads) {
+        auto [it, inserted] = mFileReads.try_emplace(readProfileName(pendingRead.id));
+        auto& file = it->second;
+        if (inserted) {
+            // First wait on this file: pick up what an earlier install of it read.
+            std::string content;
+            metadata::ReadProfile profile;
+            if (base::ReadFileToString(mService.readProfilePath(it->first), &content) &&
+                profile.ParseFromString(content)) {
+                file.profile.assign(profile.blocks().begin(), profile.blocks().end());
+                for (size_t i = 0; i < file.profile.size(); ++i) {
+                    file.positions.try_emplace(file.profile[i], i);
+                }
+            }
+        }
+
+        const auto block = pendingRead.block;
+        if (file.sequence.size() < constants().maxReadSequenceSize &&
+            file.seen.insert(block).second) {
+            file.sequence.push_back(block);
+        }
+
+        // Ask for the blocks that followed this one last time, unless they were requested already.
+        const auto position = file.positions.find(block);
+        if (position == file.positions.end()) {
+            continue;
+        }
+        const auto from = std::max(position->second + 1, file.prefetchedUntil);
+        const auto until = std::min(file.profile.size(),
+                                    position->second + 1 + constants().prefetchBlocks);
+        if (from >= until) {
+            continue;
+        }
+        file.prefetchedUntil = until;
+        mService.prefetchBlocks(id(), pendingRead.id,
+                                {file.profile.begin() + from, file.profile.begin() + until});
+    }
+}
+
+void IncrementalService::DataLoaderStub::saveReadProfiles() {
+    if (mFileReads.empty()) {
+        return;
+    }
+    const auto dir = path::join(mService.mIncrementalDir, constants().readProfilesDir);
+    if (!mkdirOrLog(dir, 0770)) {
+        return;
+    }
+    for (auto&& [name, file] : mFileReads) {
+        // Blocks this mount waited for go first, followed by the rest of the earlier profile.
+        metadata::ReadProfile profile;
+        for (auto block : file.sequence) {
+            profile.add_blocks(block);
+        }
+        for (auto block : file.profile) {
+            if (size_t(profile.blocks_size()) >= constants().maxReadSequenceSize) {
+                break;
+            }
+            if (file.seen.find(block) == file.seen.end()) {
+                profile.add_blocks(block);
+            }
+        }
+        const auto path = mService.readProfilePath(name);
+        const auto tmpPath = path + ".tmp";
+        if (!base::WriteStringToFile(profile.SerializeAsString(), tmpPath) ||
+            ::rename(tmpPath.c_str(), path.c_str())) {
+            PLOG(WARNING) << id() << ": failed to save read profile " << path;
+            ::unlink(tmpPath.c_str());
+        }
+    }
+    mFileReads.clear();
+    mService.trimReadProfiles();
+}
+
 void IncrementalService::DataLoaderStub::registerForPendingReads() {
     const auto pendingReadsFd = mHealthControl.pendingReads();
     if (pendingReadsFd < 0) {
@@ -31,6 +31,7 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <limits>
 #include <map>
@@ -80,6 +81,9 @@ public:
 
     static constexpr BootClockTsUs kMaxBootClockTsUs = std::numeric_limits<BootClockTsUs>::max();
 
+    // Number of threads running the queued jobs; each one works on a different mount at a time.
+    static constexpr int kJobProcessorCount = 4;
+
     enum CreateOptions {
         TemporaryBind = 1,
         PermanentBind = 2,
@@ -224,6 +228,9 @@ private:
         void registerForPendingReads();
         void unregisterFromPendingReads();
 
+        void recordPendingReads(const std::vector<incfs::ReadInfo>& pendingReads);
+        void saveReadProfiles();
+
         IncrementalService& mService;
 
         std::mutex mMutex;
@@ -245,6 +252,18 @@ private:
             BootClockTsUs kernelTsUs;
         } mHealthBase = {TimePoint::max(), kMaxBootClockTsUs};
         StorageHealthCheckParams mHealthCheckParams;
+
+        // Reads of a single file that had to wait for the data loader.
+        struct FileReads {
+            // Blocks in the order they were first waited for by this mount.
+            std::vector<BlockIndex> sequence;
+            std::unordered_set<BlockIndex> seen;
+            // Sequence saved by an earlier mount of the same file, and the position of its blocks.
+            std::vector<BlockIndex> profile;
+            std::unordered_map<BlockIndex, size_t> positions;
+            size_t prefetchedUntil = 0;
+        };
+        std::unordered_map<std::string, FileReads> mFileReads;
     };
     using DataLoaderStubPtr = sp<DataLoaderStub>;
 
@@ -297,6 +316,7 @@ private:
     using IfsMountPtr = std::shared_ptr<IncFsMount>;
     using MountMap = std::unordered_map<MountId, IfsMountPtr>;
     using BindPathMap = std::map<std::string, IncFsMount::BindMap::iterator, path::PathLess>;
+    using JobMap = std::unordered_map<MountId, std::vector<Job>>;
 
     static bool perfLoggingEnabled();
 
@@ -346,6 +366,7 @@ private:
     void onAppOpChanged(const std::string& packageName);
 
     void runJobProcessing();
+    JobMap::iterator nextJobsLocked();
     void extractZipFile(const IfsMountPtr& ifs, ZipArchiveHandle zipFile, ZipEntry& entry,
                         const incfs::FileId& libFileId, std::string_view targetLibPath,
                         Clock::time_point scheduledTs);
@@ -355,6 +376,12 @@ private:
     void addTimedJob(MountId id, Milliseconds after, Job what);
     void removeTimedJobs(MountId id);
 
+    std::string readProfilePath(std::string_view fileName) const;
+    void trimReadProfiles();
+    void prefetchBlocks(MountId id, FileId fileId, std::vector<BlockIndex>&& blocks);
+    void cancelPrefetches(MountId id);
+    void runPrefetching();
+
 private:
     const std::unique_ptr<VoldServiceWrapper> mVold;
     const std::unique_ptr<DataLoaderManagerWrapper> mDataLoaderManager;
@@ -378,11 +405,26 @@ private:
 
     std::atomic_bool mRunning{true};
 
-    std::unordered_map<MountId, std::vector<Job>> mJobQueue;
-    MountId mPendingJobsMount = kInvalidStorageId;
+    JobMap mJobQueue;
+    // Mounts whose jobs are running right now, and mounts somebody is waiting for, which go first.
+    std::unordered_set<MountId> mPendingJobsMounts;
+    std::unordered_map<MountId, int> mAwaitedJobsMounts;
     std::condition_variable mJobCondition;
     std::mutex mJobMutex;
-    std::thread mJobProcessor;
+    std::vector<std::thread> mJobProcessors;
+
+    struct PrefetchRequest {
+        MountId mountId;
+        FileId fileId;
+        std::vector<BlockIndex> blocks;
+    };
+    std::deque<PrefetchRequest> mPrefetchQueue;
+    // The mount of the request being prefetched, and whether it has been cancelled since.
+    MountId mPrefetchingMount = kInvalidStorageId;
+    std::atomic_bool mPrefetchCancelled{false};
+    std::condition_variable mPrefetchCondition;
+    std::mutex mPrefetchMutex;
+    std::thread mPrefetchProcessor;
 
     std::thread mCmdLooperThread;
 };
@@ -20,6 +20,8 @@
 #include <binder/ParcelFileDescriptor.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <utils/Log.h>
 
 #include <chrono>
@@ -377,7 +379,10 @@ class MockJniWrapper : public JniWrapper {
 public:
     MOCK_CONST_METHOD0(initializeForCurrentThread, void());
 
-    MockJniWrapper() { EXPECT_CALL(*this, initializeForCurrentThread()).Times(2); }
+    MockJniWrapper() {
+        EXPECT_CALL(*this, initializeForCurrentThread())
+                .Times(IncrementalService::kJobProcessorCount + 1);
+    }
 };
 
 class MockLooperWrapper : public LooperWrapper {
@@ -905,6 +910,115 @@ TEST_F(IncrementalServiceTest, testStartDataLoaderUnhealthyStorage) {
     ASSERT_EQ(IStorageHealthListener::HEALTH_STATUS_OK, listener->mStatus);
 }
 
+TEST_F(IncrementalServiceTest, testReadProfileSavedAndPrefetched) {
+    mVold->mountIncFsSuccess();
+    mIncFs->makeFileSuccess();
+    mIncFs->openMountSuccess();
+    mVold->bindMountSuccess();
+    mDataLoaderManager->bindToDataLoaderSuccess();
+    mDataLoaderManager->getDataLoaderSuccess();
+
+    FileId fileId = {};
+    fileId.data[0] = 0x12;
+    auto pendingReadsOf = [fileId](std::vector<BlockIndex> blocks) {
+        return [fileId, blocks](const Control&, std::chrono::milliseconds,
+                                std::vector<incfs::ReadInfo>* pendingReadsBuffer) {
+            for (auto block : blocks) {
+                incfs::ReadInfo read = {};
+                read.id = fileId;
+                read.block = block;
+                pendingReadsBuffer->push_back(read);
+            }
+            return android::incfs::WaitResult::HaveData;
+        };
+    };
+
+    // The first install waits for blocks 5, 6 and 7 and saves them when the storage goes away.
+    ON_CALL(*mIncFs, waitForPendingReads(_, _, _)).WillByDefault(Invoke(pendingReadsOf({5, 6, 7})));
+    TemporaryDir tempDir;
+    int storageId = mIncrementalService->createStorage(tempDir.path, std::move(mDataLoaderParcel),
+                                                       IncrementalService::CreateOptions::CreateNew,
+                                                       {}, {}, {});
+    ASSERT_GE(storageId, 0);
+    mIncrementalService->deleteStorage(storageId);
+
+    std::string content;
+    ASSERT_TRUE(base::ReadFileToString(std::string(mRootDir.path) +
+                                               "/read_profiles/12000000000000000000000000000000",
+                                       &content));
+    metadata::ReadProfile profile;
+    ASSERT_TRUE(profile.ParseFromString(content));
+    ASSERT_EQ(3, profile.blocks_size());
+    EXPECT_EQ(5, profile.blocks(0));
+    EXPECT_EQ(6, profile.blocks(1));
+    EXPECT_EQ(7, profile.blocks(2));
+
+    // The next install of the same file touches the blocks that followed the one it waits for.
+    std::promise<FileId> prefetched;
+    EXPECT_CALL(*mIncFs, openForSpecialOps(_, _))
+            .WillOnce(Invoke([&prefetched](const Control&, FileId id) {
+                prefetched.set_value(id);
+                return base::unique_fd();
+            }));
+    ON_CALL(*mIncFs, waitForPendingReads(_, _, _))
+            .WillByDefault(Return(android::incfs::WaitResult::Timeout));
+    TemporaryDir otherDir;
+    DataLoaderParamsParcel params;
+    params.packageName = "com.test";
+    storageId = mIncrementalService->createStorage(otherDir.path, std::move(params),
+                                                   IncrementalService::CreateOptions::CreateNew,
+                                                   {}, {}, {});
+    ASSERT_GE(storageId, 0);
+    ON_CALL(*mIncFs, waitForPendingReads(_, _, _)).WillByDefault(Invoke(pendingReadsOf({5})));
+    ASSERT_NE(nullptr, mLooper->mCallback);
+    mLooper->mCallback(-1, -1, mLooper->mCallbackData);
+
+    auto future = prefetched.get_future();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(1s));
+    EXPECT_EQ(0x12, future.get().data[0]);
+}
+
+TEST_F(IncrementalServiceTest, testStaleReadProfilesRemoved) {
+    mVold->mountIncFsSuccess();
+    mIncFs->makeFileSuccess();
+    mIncFs->openMountSuccess();
+    mVold->bindMountSuccess();
+    mDataLoaderManager->bindToDataLoaderSuccess();
+    mDataLoaderManager->getDataLoaderSuccess();
+
+    // A profile that was not used for two months.
+    const auto profilesDir = std::string(mRootDir.path) + "/read_profiles";
+    ASSERT_EQ(0, ::mkdir(profilesDir.c_str(), 0770));
+    const auto stalePath = profilesDir + "/34000000000000000000000000000000";
+    ASSERT_TRUE(base::WriteStringToFile("", stalePath));
+    const auto staleTime = ::time(nullptr) - 60 * 24 * 60 * 60;
+    const struct timeval times[2] = {{staleTime, 0}, {staleTime, 0}};
+    ASSERT_EQ(0, ::utimes(stalePath.c_str(), times));
+
+    FileId fileId = {};
+    fileId.data[0] = 0x12;
+    ON_CALL(*mIncFs, waitForPendingReads(_, _, _))
+            .WillByDefault(Invoke([fileId](const Control&, std::chrono::milliseconds,
+                                           std::vector<incfs::ReadInfo>* pendingReadsBuffer) {
+                incfs::ReadInfo read = {};
+                read.id = fileId;
+                read.block = 5;
+                pendingReadsBuffer->push_back(read);
+                return android::incfs::WaitResult::HaveData;
+            }));
+    TemporaryDir tempDir;
+    int storageId = mIncrementalService->createStorage(tempDir.path, std::move(mDataLoaderParcel),
+                                                       IncrementalService::CreateOptions::CreateNew,
+                                                       {}, {}, {});
+    ASSERT_GE(storageId, 0);
+    mIncrementalService->deleteStorage(storageId);
+
+    // Saving the new profile drops the stale one.
+    struct stat st;
+    EXPECT_EQ(0, ::stat((profilesDir + "/12000000000000000000000000000000").c_str(), &st));
+    EXPECT_NE(0, ::stat(stalePath.c_str(), &st));
+}
+
 TEST_F(IncrementalServiceTest, testSetIncFsMountOptionsSuccess) {
     mVold->mountIncFsSuccess();
     mIncFs->makeFileSuccess();
@@ -24,8 +24,10 @@
 #include "androidfw/AssetManager2.h"
 #include "androidfw/ResourceTypes.h"
 
+#include <cstdlib>
 #include <iostream>
 #include <locale>
+#include <unordered_set>
 
 #include "android-base/stringprintf.h"
 
@@ -71,17 +73,46 @@ class ResXmlVisitorAdapter {
   ResXMLParser* parser_;
 };
 
-bool CanCompileLayout(ResXMLParser* parser) {
+bool CanCompileLayout(ResXMLParser* parser, std::string* message = nullptr) {
   ResXmlVisitorAdapter adapter{parser};
   LayoutValidationVisitor visitor;
   adapter.Accept(&visitor);
 
+  if (message != nullptr) {
+    *message = visitor.message();
+  }
   return visitor.can_compile();
 }
 
 namespace {
+// The layouts selected for compilation, as given in ApkLayoutCompilerOptions::layouts.
+class LayoutSelection {
+ public:
+  explicit LayoutSelection(const std::vector<std::string>& layouts) {
+    for (const auto& layout : layouts) {
+      char* end = nullptr;
+      const unsigned long resid = std::strtoul(layout.c_str(), &end, /*base=*/0);
+      if (!layout.empty() && *end == '\0') {
+        resids_.insert(static_cast<uint32_t>(resid));
+      } else {
+        names_.insert(layout);
+      }
+    }
+  }
+
+  bool Contains(const std::string& name, uint32_t resid) const {
+    return (names_.empty() && resids_.empty()) || names_.count(name) > 0 ||
+           (resid != 0 && resids_.count(resid) > 0);
+  }
+
+ private:
+  std::unordered_set<std::string> names_;
+  std::unordered_set<uint32_t> resids_;
+};
+
 void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& assets,
-                             CompilationTarget target, std::ostream& target_out) {
+                             CompilationTarget target, std::ostream& target_out,
+                             const ApkLayoutCompilerOptions& options) {
   android::AssetManager2 resources;
   resources.SetApkAssets({assets.get()});
 
@@ -99,6 +130,11 @@ void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& as
   dex::ClassBuilder compiled_view{
       dex_file.MakeClass(StringPrintf("%s.CompiledView", package_name.c_str()))};
   std::vector<dex::MethodBuilder> methods;
+  const LayoutSelection selection{options.layouts};
+  size_t num_layouts = 0;
+  size_t num_compiled = 0;
+  // Bytes of instructions generated for the compiled layouts.
+  size_t code_size = 0;
 
   assets->GetAssetsProvider()->ForEachFile("res/", [&](const android::StringPiece& s,
                                                        android::FileType) {
@@ -107,21 +143,38 @@ void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& as
       assets->GetAssetsProvider()->ForEachFile(path, [&](const android::StringPiece& layout_file,
                                                          android::FileType) {
         auto layout_path = StringPrintf("%s%s", path.c_str(), layout_file.to_string().c_str());
+        const std::string layout_name = startop::util::FindLayoutNameFromFilename(layout_path);
+        num_layouts++;
+        if (!selection.Contains(layout_name,
+                                resources.GetResourceId(layout_name, "layout", package_name))) {
+          if (options.report != nullptr) {
+            *options.report << "skipped " << layout_path << ": not selected\n";
+          }
+          return;
+        }
+
         android::ApkAssetsCookie cookie = android::kInvalidCookie;
         auto asset = resources.OpenNonAsset(layout_path, android::Asset::ACCESS_RANDOM, &cookie);
         CHECK(asset);
         CHECK(android::kInvalidCookie != cookie);
         const auto dynamic_ref_table = resources.GetDynamicRefTableForCookie(cookie);
         CHECK(nullptr != dynamic_ref_table);
+        // The asset outlives the tree, so the tree can parse the asset's buffer in place.
         android::ResXMLTree xml_tree{dynamic_ref_table};
         xml_tree.setTo(asset->getBuffer(/*wordAligned=*/true),
                        asset->getLength(),
-                       /*copy_data=*/true);
+                       /*copy_data=*/false);
         android::ResXMLParser parser{xml_tree};
         parser.restart();
-        if (CanCompileLayout(&parser)) {
+        std::string message;
+        if (!CanCompileLayout(&parser, &message)) {
+          LOG(WARNING) << "Skipping " << layout_path << ": " << message;
+          if (options.report != nullptr) {
+            *options.report << "skipped " << layout_path << ": " << message << "\n";
+          }
+        } else {
+          num_compiled++;
           parser.restart();
-          const std::string layout_name = startop::util::FindLayoutNameFromFilename(layout_path);
           ResXmlVisitorAdapter adapter{&parser};
           switch (target) {
             case CompilationTarget::kDex: {
@@ -135,7 +188,13 @@ void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& as
               LayoutCompilerVisitor visitor{&builder};
               adapter.Accept(&visitor);
               builder.Finish();
-              methods.back().Encode();
+              const size_t method_size =
+                  methods.back().Encode()->code->instructions.size() * sizeof(::dex::u2);
+              code_size += method_size;
+              if (options.report != nullptr) {
+                *options.report << "compiled " << layout_path << ": " << method_size
+                                << " bytes of code\n";
+              }
               break;
             }
             case CompilationTarget::kJavaLanguage: {
@@ -144,6 +203,9 @@ void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& as
               LayoutCompilerVisitor visitor{&builder};
               adapter.Accept(&visitor);
               builder.Finish();
+              if (options.report != nullptr) {
+                *options.report << "compiled " << layout_path << "\n";
+              }
               break;
             }
           }
@@ -152,6 +214,12 @@ void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& as
     }
   });
 
+  LOG(INFO) << "Compiled " << num_compiled << " of " << num_layouts << " layouts";
+  if (options.report != nullptr && target == CompilationTarget::kDex) {
+    *options.report << "total: " << num_compiled << " of " << num_layouts << " layouts, "
+                    << code_size << " bytes of code\n";
+  }
+
   if (target == CompilationTarget::kDex) {
     slicer::MemView image{dex_file.CreateImage()};
     target_out.write(image.ptr<const char>(), image.size());
@@ -160,16 +228,16 @@ void CompileApkAssetsLayouts(const std::unique_ptr<const android::ApkAssets>& as
 }  // namespace
 
 void CompileApkLayouts(const std::string& filename, CompilationTarget target,
-                       std::ostream& target_out) {
+                       std::ostream& target_out, const ApkLayoutCompilerOptions& options) {
   auto assets = android::ApkAssets::Load(filename);
-  CompileApkAssetsLayouts(assets, target, target_out);
+  CompileApkAssetsLayouts(assets, target, target_out, options);
 }
 
 void CompileApkLayoutsFd(android::base::unique_fd fd, CompilationTarget target,
-                         std::ostream& target_out) {
+                         std::ostream& target_out, const ApkLayoutCompilerOptions& options) {
   constexpr const char* friendly_name{"viewcompiler assets"};
   auto assets = android::ApkAssets::LoadFromFd(std::move(fd), friendly_name);
-  CompileApkAssetsLayouts(assets, target, target_out);
+  CompileApkAssetsLayouts(assets, target, target_out, options);
 }
 
 }  // namespace startop
@@ -17,7 +17,9 @@
 #ifndef APK_LAYOUT_COMPILER_H_
 #define APK_LAYOUT_COMPILER_H_
 
+#include <ostream>
 #include <string>
+#include <vector>
 
 #include "android-base/unique_fd.h"
 
@@ -25,10 +27,20 @@ namespace startop {
 
 enum class CompilationTarget { kJavaLanguage, kDex };
 
+struct ApkLayoutCompilerOptions {
+  // The layouts to compile, by name ("activity_main") or resource id ("0x7f0b001c"). If empty,
+  // every layout that can be compiled is. Compiled layouts cost DEX space, so this is meant for
+  // the layouts a startup profile shows are inflated on the critical path.
+  std::vector<std::string> layouts;
+  // If set, a line is written here for each layout in the APK with whether it was compiled, and
+  // either the size of its generated code or the reason it was skipped.
+  std::ostream* report{nullptr};
+};
+
 void CompileApkLayouts(const std::string& filename, CompilationTarget target,
-                       std::ostream& target_out);
+                       std::ostream& target_out, const ApkLayoutCompilerOptions& options = {});
 void CompileApkLayoutsFd(android::base::unique_fd fd, CompilationTarget target,
-                         std::ostream& target_out);
+                         std::ostream& target_out, const ApkLayoutCompilerOptions& options = {});
 
 }  // namespace startop
 
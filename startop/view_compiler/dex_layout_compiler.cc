@@ -115,13 +115,19 @@ void DexViewBuilder::Start() {
 void DexViewBuilder::Finish() {}
 
 namespace {
+// Resolves the class of a view tag the way PhoneLayoutInflater does, which tries the android.widget,
+// android.webkit and android.app packages before android.view. Only android.widget holds more
+// than a handful of views, so the few others are listed here.
 std::string ResolveName(const std::string& name) {
-  if (name == "View") return "android.view.View";
-  if (name == "ViewGroup") return "android.view.ViewGroup";
-  if (name.find('.') == std::string::npos) {
-    return StringPrintf("android.widget.%s", name.c_str());
+  if (name.find('.') != std::string::npos) {
+    return name;
   }
-  return name;
+  if (name == "WebView") return "android.webkit.WebView";
+  if (name == "View" || name == "ViewGroup" || name == "ViewStub" || name == "SurfaceView" ||
+      name == "TextureView") {
+    return StringPrintf("android.view.%s", name.c_str());
+  }
+  return StringPrintf("android.widget.%s", name.c_str());
 }
 }  // namespace
 
@@ -37,6 +37,12 @@ void LayoutValidationVisitor::VisitStartTag(const std::u16string& name) {
     message_ = "Fragment tags are not supported";
     can_compile_ = false;
   }
+  if (0 == name.compare(u"requestFocus") || 0 == name.compare(u"tag") ||
+      0 == name.compare(u"blink")) {
+    // These are handled by LayoutInflater itself and do not name a view class.
+    message_ = "requestFocus, tag and blink tags are not supported";
+    can_compile_ = false;
+  }
 }
 
 }  // namespace startop
\ No newline at end of file
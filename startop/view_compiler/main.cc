@@ -50,8 +50,14 @@ constexpr char kStdoutFilename[]{"stdout"};
 DEFINE_bool(apk, false, "Compile layouts in an APK");
 DEFINE_bool(dex, false, "Generate a DEX file instead of Java");
 DEFINE_int32(infd, -1, "Read input from the given file descriptor");
+DEFINE_string(layouts, "",
+              "With --apk, only compile these comma separated layout names or resource ids");
+DEFINE_string(layouts_file, "",
+              "With --apk, only compile the layout names or resource ids listed in this file, one "
+              "per line");
 DEFINE_string(out, kStdoutFilename, "Where to write the generated class");
 DEFINE_string(package, "", "The package name for the generated class (required)");
+DEFINE_string(report, "", "With --apk, write which layouts were compiled or skipped to this file");
 
 template <typename Visitor>
 class XmlVisitorAdapter : public XMLVisitor {
@@ -91,6 +97,30 @@ void CompileLayout(XMLDocument* xml, Builder* builder) {
   xml->Accept(&adapter);
 }
 
+// Collects the layouts selected with --layouts and --layouts_file.
+bool ReadLayoutSelection(std::vector<string>* layouts) {
+  std::istringstream list{FLAGS_layouts};
+  for (string layout; std::getline(list, layout, ',');) {
+    if (!layout.empty()) {
+      layouts->push_back(layout);
+    }
+  }
+
+  if (!FLAGS_layouts_file.empty()) {
+    std::ifstream file{FLAGS_layouts_file};
+    if (!file) {
+      LOG(ERROR) << "Could not open " << FLAGS_layouts_file;
+      return false;
+    }
+    for (string layout; std::getline(file, layout);) {
+      if (!layout.empty() && layout[0] != '#') {
+        layouts->push_back(layout);
+      }
+    }
+  }
+  return true;
+}
+
 }  // end namespace
 
 int main(int argc, char** argv) {
@@ -120,16 +150,25 @@ int main(int argc, char** argv) {
   if (FLAGS_apk) {
     const startop::CompilationTarget target =
         FLAGS_dex ? startop::CompilationTarget::kDex : startop::CompilationTarget::kJavaLanguage;
+    startop::ApkLayoutCompilerOptions options;
+    if (!ReadLayoutSelection(&options.layouts)) {
+      return 1;
+    }
+    std::ofstream report;
+    if (!FLAGS_report.empty()) {
+      report.open(FLAGS_report);
+      options.report = &report;
+    }
     if (FLAGS_infd >= 0) {
       startop::CompileApkLayoutsFd(
-          android::base::unique_fd{FLAGS_infd}, target, is_stdout ? std::cout : outfile);
+          android::base::unique_fd{FLAGS_infd}, target, is_stdout ? std::cout : outfile, options);
     } else {
       if (argc < 2) {
         gflags::ShowUsageWithFlags(argv[kProgramName]);
         return 1;
       }
       const char* const filename = argv[kFileNameParam];
-      startop::CompileApkLayouts(filename, target, is_stdout ? std::cout : outfile);
+      startop::CompileApkLayouts(filename, target, is_stdout ? std::cout : outfile, options);
     }
     return 0;
   }
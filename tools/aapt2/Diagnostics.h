@@ -20,6 +20,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "android-base/macros.h"
 #include "androidfw/StringPiece.h"
@@ -150,6 +152,30 @@ class SourcePathDiagnostics : public IDiagnostics {
   DISALLOW_COPY_AND_ASSIGN(SourcePathDiagnostics);
 };
 
+// Holds on to messages until they are replayed to another IDiagnostics. Lets work done on
+// another thread report in a deterministic order.
+class BufferedDiagnostics : public IDiagnostics {
+ public:
+  BufferedDiagnostics() = default;
+
+  void Log(Level level, DiagMessageActual& actual_msg) override {
+    messages_.emplace_back(level, actual_msg);
+  }
+
+  // Logs the held messages to diag, in the order they came in, and drops them.
+  void Replay(IDiagnostics* diag) {
+    for (auto& entry : messages_) {
+      diag->Log(entry.first, entry.second);
+    }
+    messages_.clear();
+  }
+
+ private:
+  std::vector<std::pair<Level, DiagMessageActual>> messages_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferedDiagnostics);
+};
+
 }  // namespace aapt
 
 #endif /* AAPT_DIAGNOSTICS_H */
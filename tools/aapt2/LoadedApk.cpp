@@ -16,6 +16,8 @@
 
 #include "LoadedApk.h"
 
+#include "google/protobuf/arena.h"
+
 #include "ResourceValues.h"
 #include "ValueVisitor.h"
 #include "format/Archive.h"
@@ -72,7 +74,8 @@ static ApkFormat DetermineApkFormat(io::IFileCollection* apk) {
   }
 }
 
-std::unique_ptr<LoadedApk> LoadedApk::LoadApkFromPath(const StringPiece& path, IDiagnostics* diag) {
+std::unique_ptr<LoadedApk> LoadedApk::LoadApkFromPath(const StringPiece& path, IDiagnostics* diag,
+                                                      bool load_resource_table) {
   Source source(path);
   std::string error;
   std::unique_ptr<io::ZipFileCollection> apk = io::ZipFileCollection::Create(path, &error);
@@ -84,9 +87,9 @@ std::unique_ptr<LoadedApk> LoadedApk::LoadApkFromPath(const StringPiece& path, I
   ApkFormat apkFormat = DetermineApkFormat(apk.get());
   switch (apkFormat) {
     case ApkFormat::kBinary:
-      return LoadBinaryApkFromFileCollection(source, std::move(apk), diag);
+      return LoadBinaryApkFromFileCollection(source, std::move(apk), diag, load_resource_table);
     case ApkFormat::kProto:
-      return LoadProtoApkFromFileCollection(source, std::move(apk), diag);
+      return LoadProtoApkFromFileCollection(source, std::move(apk), diag, load_resource_table);
     default:
       diag->Error(DiagMessage(path) << "could not identify format of APK");
       return {};
@@ -94,27 +97,31 @@ std::unique_ptr<LoadedApk> LoadedApk::LoadApkFromPath(const StringPiece& path, I
 }
 
 std::unique_ptr<LoadedApk> LoadedApk::LoadProtoApkFromFileCollection(
-    const Source& source, unique_ptr<io::IFileCollection> collection, IDiagnostics* diag) {
+    const Source& source, unique_ptr<io::IFileCollection> collection, IDiagnostics* diag,
+    bool load_resource_table) {
   std::unique_ptr<ResourceTable> table;
 
-  io::IFile* table_file = collection->FindFile(kProtoResourceTablePath);
+  io::IFile* table_file =
+      load_resource_table ? collection->FindFile(kProtoResourceTablePath) : nullptr;
   if (table_file != nullptr) {
-    pb::ResourceTable pb_table;
     std::unique_ptr<io::InputStream> in = table_file->OpenInputStream();
     if (in == nullptr) {
       diag->Error(DiagMessage(source) << "failed to open " << kProtoResourceTablePath);
       return {};
     }
 
+    ::google::protobuf::Arena arena;
+    pb::ResourceTable* pb_table =
+        ::google::protobuf::Arena::CreateMessage<pb::ResourceTable>(&arena);
     io::ProtoInputStreamReader proto_reader(in.get());
-    if (!proto_reader.ReadMessage(&pb_table)) {
+    if (!proto_reader.ReadMessage(pb_table)) {
       diag->Error(DiagMessage(source) << "failed to read " << kProtoResourceTablePath);
       return {};
     }
 
     std::string error;
     table = util::make_unique<ResourceTable>(/** validate_resources **/ false);
-    if (!DeserializeTableFromPb(pb_table, collection.get(), table.get(), &error)) {
+    if (!DeserializeTableFromPb(*pb_table, collection.get(), table.get(), &error)) {
       diag->Error(DiagMessage(source)
                   << "failed to deserialize " << kProtoResourceTablePath << ": " << error);
       return {};
@@ -152,10 +159,12 @@ std::unique_ptr<LoadedApk> LoadedApk::LoadProtoApkFromFileCollection(
 }
 
 std::unique_ptr<LoadedApk> LoadedApk::LoadBinaryApkFromFileCollection(
-    const Source& source, unique_ptr<io::IFileCollection> collection, IDiagnostics* diag) {
+    const Source& source, unique_ptr<io::IFileCollection> collection, IDiagnostics* diag,
+    bool load_resource_table) {
   std::unique_ptr<ResourceTable> table;
 
-  io::IFile* table_file = collection->FindFile(kApkResourceTablePath);
+  io::IFile* table_file =
+      load_resource_table ? collection->FindFile(kApkResourceTablePath) : nullptr;
   if (table_file != nullptr) {
     table = util::make_unique<ResourceTable>(/** validate_resources **/ false);
     std::unique_ptr<io::IData> data = table_file->OpenAsData();
@@ -37,6 +37,7 @@
 #include "cmd/Link.h"
 #include "cmd/Optimize.h"
 #include "io/FileStream.h"
+#include "process/SymbolTable.h"
 #include "trace/TraceBuffer.h"
 #include "util/Files.h"
 #include "util/Util.h"
@@ -108,6 +109,9 @@ class DaemonCommand : public Command {
   int Action(const std::vector<std::string>& arguments) override {
     TRACE_FLUSH_ARGS(trace_folder_ ? trace_folder_.value() : "", "daemon", arguments);
     text::Printer printer(out_);
+
+    // Commands tend to include the same framework and libraries, so don't load them every time.
+    AssetManagerSymbolSource::SetCacheApkAssets(true);
     std::cout << "Ready" << std::endl;
 
     while (true) {
@@ -139,6 +143,7 @@ class DaemonCommand : public Command {
       }
       std::cerr << "Done" << std::endl;
     }
+    AssetManagerSymbolSource::SetCacheApkAssets(false);
     std::cout << "Exiting daemon" << std::endl;
 
     return 0;
@@ -385,6 +385,7 @@ bool ResourceParser::FlattenXmlSubtree(
 }
 
 bool ResourceParser::Parse(xml::XmlPullParser* parser) {
+  Arena::Scope arena_scope(&table_->arena);
   bool error = false;
   const size_t depth = parser->depth();
   while (xml::XmlPullParser::NextChildNode(parser, depth)) {
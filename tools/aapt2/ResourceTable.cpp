@@ -146,9 +146,30 @@ ResourceTableType* ResourceTablePackage::FindOrCreateType(ResourceType type,
   return types.emplace(iter, std::move(new_type))->get();
 }
 
+ResourceEntry* ResourceTableType::FindFirstEntryNamed(const StringPiece& name) {
+  if (indexed_version_ != entries.version()) {
+    entries_by_name_.clear();
+    entries_by_name_.reserve(entries.size());
+    for (auto iter = entries.cbegin(); iter != entries.cend(); ++iter) {
+      // Entries are sorted, so this keeps the first of those that share a name.
+      entries_by_name_.emplace((*iter)->name, iter->get());
+    }
+    indexed_version_ = entries.version();
+  }
+
+  auto iter = entries_by_name_.find(name);
+  return iter != entries_by_name_.end() ? iter->second : nullptr;
+}
+
 ResourceEntry* ResourceTableType::FindEntry(const StringPiece& name, const Maybe<uint16_t> id) {
-  const auto last = entries.end();
-  auto iter = std::lower_bound(entries.begin(), last, std::make_pair(name, id),
+  ResourceEntry* entry = FindFirstEntryNamed(name);
+  if (entry == nullptr || !id || id == entry->id) {
+    return entry;
+  }
+
+  // Only entries that share a name with another entry get here.
+  const auto last = entries.cend();
+  auto iter = std::lower_bound(entries.cbegin(), last, std::make_pair(name, id),
       less_than_struct_with_name_and_id<ResourceEntry>);
   if (iter != last && name == (*iter)->name && (!id || id == (*iter)->id)) {
     return iter->get();
@@ -158,8 +179,13 @@ ResourceEntry* ResourceTableType::FindEntry(const StringPiece& name, const Maybe
 
 ResourceEntry* ResourceTableType::FindOrCreateEntry(const StringPiece& name,
                                                     const Maybe<uint16_t > id) {
-  auto last = entries.end();
-  auto iter = std::lower_bound(entries.begin(), last, std::make_pair(name, id),
+  ResourceEntry* first_entry = FindFirstEntryNamed(name);
+  if (first_entry != nullptr && (!id || id == first_entry->id)) {
+    return first_entry;
+  }
+
+  const auto last = entries.cend();
+  auto iter = std::lower_bound(entries.cbegin(), last, std::make_pair(name, id),
                                less_than_struct_with_name_and_id<ResourceEntry>);
   if (iter != last && name == (*iter)->name && (!id || id == (*iter)->id)) {
     return iter->get();
@@ -167,7 +193,18 @@ ResourceEntry* ResourceTableType::FindOrCreateEntry(const StringPiece& name,
 
   auto new_entry = new ResourceEntry(name);
   new_entry->id = id;
-  return entries.emplace(iter, std::move(new_entry))->get();
+  auto inserted = entries.emplace(iter, std::unique_ptr<ResourceEntry>(new_entry));
+  // The index was up to date before the insertion, so it only needs the new entry.
+  ResourceEntry* entry = inserted->get();
+  if (first_entry == nullptr) {
+    entries_by_name_.emplace(entry->name, entry);
+  } else if (inserted == entries.cbegin() || (*(inserted - 1))->name != entry->name) {
+    // The new entry sorts before the others with its name.
+    entries_by_name_.erase(first_entry->name);
+    entries_by_name_.emplace(entry->name, entry);
+  }
+  indexed_version_ = entries.version();
+  return entry;
 }
 
 ResourceConfigValue* ResourceEntry::FindValue(const ConfigDescription& config) {
@@ -643,6 +680,7 @@ Maybe<ResourceTable::SearchResult> ResourceTable::FindResource(const ResourceNam
 
 std::unique_ptr<ResourceTable> ResourceTable::Clone() const {
   std::unique_ptr<ResourceTable> new_table = util::make_unique<ResourceTable>();
+  Arena::Scope arena_scope(&new_table->arena);
   for (const auto& pkg : packages) {
     ResourceTablePackage* new_pkg = new_table->CreatePackage(pkg->name, pkg->id);
     for (const auto& type : pkg->types) {
@@ -23,6 +23,7 @@
 #include "Source.h"
 #include "StringPool.h"
 #include "io/File.h"
+#include "util/Arena.h"
 
 #include "android-base/macros.h"
 #include "androidfw/ConfigDescription.h"
@@ -150,6 +151,58 @@ class ResourceEntry {
   DISALLOW_COPY_AND_ASSIGN(ResourceEntry);
 };
 
+// The entries of a ResourceTableType, kept sorted by name and ID. Every call that can add, remove
+// or reorder entries, including taking a mutable iterator, bumps the version, so that the type
+// knows when its index of the entries is out of date.
+class ResourceEntryList {
+ public:
+  using value_type = std::unique_ptr<ResourceEntry>;
+  using iterator = std::vector<value_type>::iterator;
+  using const_iterator = std::vector<value_type>::const_iterator;
+
+  iterator begin() {
+    version_++;
+    return entries_.begin();
+  }
+  iterator end() {
+    version_++;
+    return entries_.end();
+  }
+  const_iterator begin() const { return entries_.begin(); }
+  const_iterator end() const { return entries_.end(); }
+  const_iterator cbegin() const { return entries_.cbegin(); }
+  const_iterator cend() const { return entries_.cend(); }
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+  iterator emplace(const_iterator pos, value_type entry) {
+    version_++;
+    return entries_.emplace(pos, std::move(entry));
+  }
+  iterator erase(const_iterator pos) {
+    version_++;
+    return entries_.erase(pos);
+  }
+  iterator erase(const_iterator first, const_iterator last) {
+    version_++;
+    return entries_.erase(first, last);
+  }
+
+  ResourceEntryList& operator=(std::vector<value_type>&& entries) {
+    version_++;
+    entries_ = std::move(entries);
+    return *this;
+  }
+
+  uint64_t version() const { return version_; }
+
+ private:
+  std::vector<value_type> entries_;
+  // Starts past 0, the version of an index that was never built.
+  uint64_t version_ = 1;
+};
+
 // Represents a resource type (eg. string, drawable, layout, etc.) containing resource entries.
 class ResourceTableType {
  public:
@@ -163,7 +216,7 @@ class ResourceTableType {
   Visibility::Level visibility_level = Visibility::Level::kUndefined;
 
   // List of resources for this type.
-  std::vector<std::unique_ptr<ResourceEntry>> entries;
+  ResourceEntryList entries;
 
   explicit ResourceTableType(const ResourceType type) : type(type) {}
 
@@ -173,7 +226,15 @@ class ResourceTableType {
                                    Maybe<uint16_t> id = Maybe<uint16_t>());
 
  private:
+  // Returns the first entry in `entries` with the given name, or nullptr if there is none.
+  ResourceEntry* FindFirstEntryNamed(const android::StringPiece& name);
+
   DISALLOW_COPY_AND_ASSIGN(ResourceTableType);
+
+  // Index of the first entry with each name, for types with many entries. Changes made to `entries`
+  // directly bump its version, and the index is then rebuilt on the next lookup.
+  std::unordered_map<android::StringPiece, ResourceEntry*> entries_by_name_;
+  uint64_t indexed_version_ = 0;
 };
 
 class ResourceTablePackage {
@@ -269,6 +330,11 @@ class ResourceTable {
 
   std::unique_ptr<ResourceTable> Clone() const;
 
+  // The arena the values of this table are allocated from while it is parsed, loaded or cloned.
+  // NOTE: `arena` must come before `packages` so that it is destroyed after the values in it.
+  // Values are cloned, never moved, into other tables, so none of them outlive the table.
+  Arena arena;
+
   // The string pool used by this resource table. Values that reference strings must use
   // this pool to create their strings.
   // NOTE: `string_pool` must come before `packages` so that it is destroyed after.
@@ -27,6 +27,8 @@
 using ::android::ConfigDescription;
 using ::android::StringPiece;
 using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::Ne;
 using ::testing::NotNull;
 using ::testing::StrEq;
 
@@ -372,4 +374,37 @@ TEST(ResourceTableTest, AllowDuplictaeResourcesNames) {
   ASSERT_THAT(entry2->visibility.level, Visibility::Level::kPrivate);
 }
 
+TEST(ResourceTableTest, FindEntryAfterEntriesChange) {
+  ResourceTableType type(ResourceType::kString);
+  ResourceEntry* foo = type.FindOrCreateEntry("foo");
+  ResourceEntry* bar = type.FindOrCreateEntry("bar");
+  ASSERT_THAT(type.FindOrCreateEntry("foo"), Eq(foo));
+  ASSERT_THAT(type.entries.size(), Eq(2u));
+
+  // Entries removed from the vector directly are no longer found.
+  type.entries.erase(std::remove_if(type.entries.begin(), type.entries.end(),
+                                    [&](const std::unique_ptr<ResourceEntry>& entry) {
+                                      return entry.get() == foo;
+                                    }),
+                     type.entries.end());
+  EXPECT_THAT(type.FindEntry("foo"), IsNull());
+  EXPECT_THAT(type.FindEntry("bar"), Eq(bar));
+
+  // Replacing the entries with as many others is noticed, although the size stays the same.
+  std::vector<std::unique_ptr<ResourceEntry>> replacement;
+  replacement.push_back(util::make_unique<ResourceEntry>("qux"));
+  ResourceEntry* qux = replacement.back().get();
+  type.entries = std::move(replacement);
+  EXPECT_THAT(type.FindEntry("bar"), IsNull());
+  EXPECT_THAT(type.FindEntry("qux"), Eq(qux));
+
+  // Of the entries sharing a name, the one with the lowest ID comes first.
+  ResourceEntry* baz_high = type.FindOrCreateEntry("baz", 0x0002);
+  ResourceEntry* baz_low = type.FindOrCreateEntry("baz", 0x0001);
+  EXPECT_THAT(baz_low, Ne(baz_high));
+  EXPECT_THAT(type.FindEntry("baz"), Eq(baz_low));
+  EXPECT_THAT(type.FindEntry("baz", 0x0002), Eq(baz_high));
+  EXPECT_THAT(type.FindEntry("baz", 0x0003), IsNull());
+}
+
 }  // namespace aapt
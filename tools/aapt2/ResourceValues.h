@@ -30,6 +30,7 @@
 #include "StringPool.h"
 #include "io/File.h"
 #include "text/Printer.h"
+#include "util/Arena.h"
 #include "util/Maybe.h"
 
 namespace aapt {
@@ -42,7 +43,8 @@ class ConstValueVisitor;
 // type specific operations is to check the Value's type() and
 // cast it to the appropriate subclass. This isn't super clean,
 // but it is the simplest strategy.
-class Value {
+// Values are allocated from the arena of the current Arena::Scope, if any.
+class Value : public ArenaObject {
  public:
   virtual ~Value() = default;
 
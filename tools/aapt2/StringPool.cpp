@@ -17,6 +17,8 @@
 #include "StringPool.h"
 
 #include <algorithm>
+#include <deque>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -205,32 +207,58 @@ StringPool::StyleRef StringPool::MakeRef(const StyleString& str) {
 }
 
 StringPool::StyleRef StringPool::MakeRef(const StyleString& str, const Context& context) {
-  std::unique_ptr<StyleEntry> entry(new StyleEntry());
-  entry->value = str.str;
-  entry->context = context;
-  entry->index_ = styles_.size();
-  entry->ref_ = 0;
+  std::vector<Span> spans;
+  spans.reserve(str.spans.size());
   for (const aapt::Span& span : str.spans) {
-    entry->spans.emplace_back(Span{MakeRef(span.name), span.first_char, span.last_char});
+    spans.emplace_back(Span{MakeRef(span.name), span.first_char, span.last_char});
   }
-
-  StyleEntry* borrow = entry.get();
-  styles_.emplace_back(std::move(entry));
-  return StyleRef(borrow);
+  return MakeStyleRefImpl(str.str, std::move(spans), context);
 }
 
 StringPool::StyleRef StringPool::MakeRef(const StyleRef& ref) {
+  std::vector<Span> spans;
+  spans.reserve(ref.entry_->spans.size());
+  for (const Span& span : ref.entry_->spans) {
+    spans.emplace_back(Span{MakeRef(*span.name), span.first_char, span.last_char});
+  }
+  return MakeStyleRefImpl(ref.entry_->value, std::move(spans), ref.entry_->context);
+}
+
+static bool SpansEqual(const std::vector<StringPool::Span>& a,
+                       const std::vector<StringPool::Span>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].name != b[i].name || a[i].first_char != b[i].first_char
+        || a[i].last_char != b[i].last_char) {
+      return false;
+    }
+  }
+  return true;
+}
+
+StringPool::StyleRef StringPool::MakeStyleRefImpl(const std::string& str, std::vector<Span> spans,
+                                                  const Context& context) {
+  // Styles are reference counted like strings, so equal styles can share an entry.
+  auto range = indexed_styles_.equal_range(str);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if (context.priority == iter->second->context.priority
+        && SpansEqual(spans, iter->second->spans)) {
+      return StyleRef(iter->second);
+    }
+  }
+
   std::unique_ptr<StyleEntry> entry(new StyleEntry());
-  entry->value = ref.entry_->value;
-  entry->context = ref.entry_->context;
+  entry->value = str;
+  entry->context = context;
   entry->index_ = styles_.size();
   entry->ref_ = 0;
-  for (const Span& span : ref.entry_->spans) {
-    entry->spans.emplace_back(Span{MakeRef(*span.name), span.first_char, span.last_char});
-  }
+  entry->spans = std::move(spans);
 
   StyleEntry* borrow = entry.get();
   styles_.emplace_back(std::move(entry));
+  indexed_styles_.insert(std::make_pair(StringPiece(borrow->value), borrow));
   return StyleRef(borrow);
 }
 
@@ -261,6 +289,8 @@ void StringPool::Merge(StringPool&& pool) {
   pool.strings_.clear();
   indexed_strings_.insert(pool.indexed_strings_.begin(), pool.indexed_strings_.end());
   pool.indexed_strings_.clear();
+  indexed_styles_.insert(pool.indexed_styles_.begin(), pool.indexed_styles_.end());
+  pool.indexed_styles_.clear();
 
   ReAssignIndices();
 }
@@ -270,29 +300,39 @@ void StringPool::HintWillAdd(size_t string_count, size_t style_count) {
   styles_.reserve(styles_.size() + style_count);
 }
 
-void StringPool::Prune() {
-  const auto iter_end = indexed_strings_.end();
-  auto index_iter = indexed_strings_.begin();
-  while (index_iter != iter_end) {
-    if (index_iter->second->ref_ <= 0) {
-      index_iter = indexed_strings_.erase(index_iter);
-    } else {
-      ++index_iter;
+// Drops the entries with no references from entries and from index, and renumbers the rest, in
+// one pass. Only the index entries of the dropped entries are looked up.
+template <typename E>
+void StringPool::PruneEntries(std::vector<std::unique_ptr<E>>* entries,
+                              std::unordered_multimap<StringPiece, E*>* index) {
+  size_t kept = 0;
+  for (size_t i = 0; i < entries->size(); i++) {
+    std::unique_ptr<E>& entry = (*entries)[i];
+    if (entry->ref_ <= 0) {
+      auto range = index->equal_range(entry->value);
+      for (auto iter = range.first; iter != range.second; ++iter) {
+        if (iter->second == entry.get()) {
+          index->erase(iter);
+          break;
+        }
+      }
+      entry.reset();
+      continue;
     }
-  }
 
-  auto end_iter2 =
-      std::remove_if(strings_.begin(), strings_.end(),
-                     [](const std::unique_ptr<Entry>& entry) -> bool { return entry->ref_ <= 0; });
-  auto end_iter3 = std::remove_if(
-      styles_.begin(), styles_.end(),
-      [](const std::unique_ptr<StyleEntry>& entry) -> bool { return entry->ref_ <= 0; });
-
-  // Remove the entries at the end or else we'll be accessing a deleted string from the StyleEntry.
-  strings_.erase(end_iter2, strings_.end());
-  styles_.erase(end_iter3, styles_.end());
+    entry->index_ = kept;
+    if (kept != i) {
+      (*entries)[kept] = std::move(entry);
+    }
+    kept++;
+  }
+  entries->resize(kept);
+}
 
-  ReAssignIndices();
+void StringPool::Prune() {
+  // Prune the styles first, since they hold references to the strings naming their spans.
+  PruneEntries(&styles_, &indexed_styles_);
+  PruneEntries(&strings_, &indexed_strings_);
 }
 
 template <typename E>
@@ -300,19 +340,57 @@ static void SortEntries(
     std::vector<std::unique_ptr<E>>& entries,
     const std::function<int(const StringPool::Context&, const StringPool::Context&)>& cmp) {
   using UEntry = std::unique_ptr<E>;
+  auto value_less = [](const UEntry& a, const UEntry& b) -> bool { return a->value < b->value; };
 
-  if (cmp != nullptr) {
-    std::sort(entries.begin(), entries.end(), [&cmp](const UEntry& a, const UEntry& b) -> bool {
-      int r = cmp(a->context, b->context);
-      if (r == 0) {
-        r = a->value.compare(b->value);
-      }
-      return r < 0;
-    });
-  } else {
-    std::sort(entries.begin(), entries.end(),
-              [](const UEntry& a, const UEntry& b) -> bool { return a->value < b->value; });
+  if (cmp == nullptr) {
+    std::sort(entries.begin(), entries.end(), value_less);
+    return;
   }
+
+  // A pool has few distinct contexts, so rank them once, and bucket the entries by the rank of
+  // their context. Only the values are compared within each bucket.
+  auto context_less = [&cmp](const StringPool::Context* a, const StringPool::Context* b) -> bool {
+    return cmp(*a, *b) < 0;
+  };
+  using ContextRanks = std::map<const StringPool::Context*, size_t, decltype(context_less)>;
+  ContextRanks ranks(context_less);
+  std::vector<typename ContextRanks::iterator> entry_ranks;
+  entry_ranks.reserve(entries.size());
+  for (const UEntry& entry : entries) {
+    // Entries added together usually share a context, so avoid the lookup for runs of them.
+    if (entry_ranks.empty() || cmp(*entry_ranks.back()->first, entry->context) != 0) {
+      entry_ranks.push_back(ranks.emplace(&entry->context, 0).first);
+    } else {
+      entry_ranks.push_back(entry_ranks.back());
+    }
+  }
+
+  std::vector<size_t> bucket_starts;
+  bucket_starts.reserve(ranks.size() + 1);
+  for (auto& rank : ranks) {
+    rank.second = bucket_starts.size();
+    bucket_starts.push_back(0);
+  }
+  bucket_starts.push_back(0);
+
+  for (const auto& rank : entry_ranks) {
+    bucket_starts[rank->second + 1]++;
+  }
+  for (size_t i = 1; i < bucket_starts.size(); i++) {
+    bucket_starts[i] += bucket_starts[i - 1];
+  }
+
+  std::vector<UEntry> sorted(entries.size());
+  std::vector<size_t> bucket_ends(bucket_starts.begin(), bucket_starts.end() - 1);
+  for (size_t i = 0; i < entries.size(); i++) {
+    sorted[bucket_ends[entry_ranks[i]->second]++] = std::move(entries[i]);
+  }
+
+  for (size_t i = 0; i + 1 < bucket_starts.size(); i++) {
+    std::sort(sorted.begin() + bucket_starts[i], sorted.begin() + bucket_starts[i + 1],
+              value_less);
+  }
+  entries = std::move(sorted);
 }
 
 void StringPool::Sort(const std::function<int(const Context&, const Context&)>& cmp) {
@@ -364,41 +442,61 @@ static size_t EncodedLengthUnits(size_t length) {
 
 const std::string kStringTooLarge = "STRING_TOO_LARGE";
 
-static bool EncodeString(const std::string& str, const bool utf8, BigBuffer* out,
-                         IDiagnostics* diag) {
+namespace {
+
+// A string of the pool as it will be encoded, with the lengths that go before it.
+struct EncodedString {
+  // The UTF-8 (or Modified UTF-8) string to write.
+  const std::string* value;
+
+  // The length of the string in UTF-16 code units.
+  size_t utf16_length;
+
+  // The number of bytes the string takes up in the pool, lengths and terminator included.
+  size_t size;
+};
+
+}  // namespace
+
+// Works out how the string is encoded and how much space it takes, so that all the strings of a
+// pool can be written into a single block. Strings rewritten to Modified UTF-8 are kept alive in
+// modified_strings. Returns false and encodes kStringTooLarge instead if the string is too long.
+static bool MeasureString(const std::string& str, const bool utf8,
+                          std::deque<std::string>* modified_strings, EncodedString* out,
+                          IDiagnostics* diag) {
   if (utf8) {
-    const std::string& encoded = util::Utf8ToModifiedUtf8(str);
+    // Only strings with 4 byte codepoints need to be rewritten to Modified UTF-8.
+    const std::string* encoded = &str;
+    if (std::any_of(str.begin(), str.end(), [](char c) { return ((uint8_t) c >> 4) == 0xF; })) {
+      modified_strings->push_back(util::Utf8ToModifiedUtf8(str));
+      encoded = &modified_strings->back();
+    }
+
     const ssize_t utf16_length = utf8_to_utf16_length(
-        reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size());
+        reinterpret_cast<const uint8_t*>(encoded->data()), encoded->size());
     CHECK(utf16_length >= 0);
 
     // Make sure the lengths to be encoded do not exceed the maximum length that
     // can be encoded using chars
-    if ((((size_t)encoded.size()) > EncodeLengthMax<char>())
+    if ((((size_t)encoded->size()) > EncodeLengthMax<char>())
         || (((size_t)utf16_length) > EncodeLengthMax<char>())) {
 
       diag->Error(DiagMessage() << "string too large to encode using UTF-8 "
           << "written instead as '" << kStringTooLarge << "'");
 
-      EncodeString(kStringTooLarge, utf8, out, diag);
+      MeasureString(kStringTooLarge, utf8, modified_strings, out, diag);
       return false;
     }
 
-    const size_t total_size = EncodedLengthUnits<char>(utf16_length)
-        + EncodedLengthUnits<char>(encoded.size()) + encoded.size() + 1;
-
-    char* data = out->NextBlock<char>(total_size);
-
-    // First encode the UTF16 string length.
-    data = EncodeLength(data, utf16_length);
-
-    // Now encode the size of the real UTF8 string.
-    data = EncodeLength(data, encoded.size());
-    strncpy(data, encoded.data(), encoded.size());
+    out->value = encoded;
+    out->utf16_length = utf16_length;
+    out->size = EncodedLengthUnits<char>(utf16_length)
+        + EncodedLengthUnits<char>(encoded->size()) + encoded->size() + 1;
 
   } else {
-    const std::u16string encoded = util::Utf8ToUtf16(str);
-    const ssize_t utf16_length = encoded.size();
+    // Invalid UTF-8 is written as an empty string.
+    const ssize_t utf16_length = std::max<ssize_t>(0, utf8_to_utf16_length(
+        reinterpret_cast<const uint8_t*>(str.data()), str.size()));
 
     // Make sure the length to be encoded does not exceed the maximum possible
     // length that can be encoded
@@ -406,29 +504,44 @@ static bool EncodeString(const std::string& str, const bool utf8, BigBuffer* out
       diag->Error(DiagMessage() << "string too large to encode using UTF-16 "
           << "written instead as '" << kStringTooLarge << "'");
 
-      EncodeString(kStringTooLarge, utf8, out, diag);
+      MeasureString(kStringTooLarge, utf8, modified_strings, out, diag);
       return false;
     }
 
-    // Total number of 16-bit words to write.
-    const size_t total_size = EncodedLengthUnits<char16_t>(utf16_length)
-        + encoded.size() + 1;
+    out->value = &str;
+    out->utf16_length = utf16_length;
+    out->size = (EncodedLengthUnits<char16_t>(utf16_length) + utf16_length + 1)
+        * sizeof(char16_t);
+  }
+
+  return true;
+}
 
-    char16_t* data = out->NextBlock<char16_t>(total_size);
+// Writes the measured string to data, which is zeroed and str.size bytes long.
+static void EncodeString(const EncodedString& str, const bool utf8, uint8_t* data) {
+  if (utf8) {
+    char* chars = reinterpret_cast<char*>(data);
 
-    // Encode the actual UTF16 string length.
-    data = EncodeLength(data, utf16_length);
-    const size_t byte_length = encoded.size() * sizeof(char16_t);
+    // First encode the UTF16 string length.
+    chars = EncodeLength(chars, str.utf16_length);
 
-    // NOTE: For some reason, strncpy16(data, entry->value.data(),
-    // entry->value.size()) truncates the string.
-    memcpy(data, encoded.data(), byte_length);
+    // Now encode the size of the real UTF8 string.
+    chars = EncodeLength(chars, str.value->size());
+    strncpy(chars, str.value->data(), str.value->size());
+
+  } else {
+    char16_t* chars = reinterpret_cast<char16_t*>(data);
 
-    // The null-terminating character is already here due to the block of data
-    // being set to 0s on allocation.
+    // Encode the actual UTF16 string length.
+    chars = EncodeLength(chars, str.utf16_length);
+    if (str.utf16_length > 0) {
+      utf8_to_utf16(reinterpret_cast<const uint8_t*>(str.value->data()), str.value->size(),
+                    chars, str.utf16_length + 1);
+    }
   }
 
-  return true;
+  // The null-terminating character is already here due to the block of data
+  // being set to 0s on allocation.
 }
 
 bool StringPool::Flatten(BigBuffer* out, const StringPool& pool, bool utf8,
@@ -451,15 +564,33 @@ bool StringPool::Flatten(BigBuffer* out, const StringPool& pool, bool utf8,
   const size_t before_strings_index = out->size();
   header->stringsStart = before_strings_index - start_index;
 
+  // Measure every string first, so that the offsets are known and the strings can be written
+  // into a single block.
+  std::vector<EncodedString> encoded(pool.size());
+  std::deque<std::string> modified_strings;
+  size_t strings_size = 0;
+  auto measure = [&](const std::string& value, EncodedString* out_encoded) {
+    no_error = MeasureString(value, utf8, &modified_strings, out_encoded, diag) && no_error;
+    *indices++ = strings_size;
+    strings_size += out_encoded->size;
+  };
+
   // Styles always come first.
+  auto encoded_iter = encoded.begin();
   for (const std::unique_ptr<StyleEntry>& entry : pool.styles_) {
-    *indices++ = out->size() - before_strings_index;
-    no_error = EncodeString(entry->value, utf8, out, diag) && no_error;
+    measure(entry->value, &*encoded_iter++);
   }
 
   for (const std::unique_ptr<Entry>& entry : pool.strings_) {
-    *indices++ = out->size() - before_strings_index;
-    no_error = EncodeString(entry->value, utf8, out, diag) && no_error;
+    measure(entry->value, &*encoded_iter++);
+  }
+
+  if (strings_size != 0) {
+    uint8_t* data = out->NextBlock<uint8_t>(strings_size);
+    for (const EncodedString& str : encoded) {
+      EncodeString(str, utf8, data);
+      data += str.size;
+    }
   }
 
   out->Align4();
@@ -171,11 +171,13 @@ class StringPool {
   // Adds a string from another string pool. Returns a reference to the string in the string pool.
   Ref MakeRef(const Ref& ref);
 
-  // Adds a style to the string pool and returns a reference to it.
+  // Adds a style to the string pool, unless an equal style already exists. Returns a reference to
+  // the style in the pool.
   StyleRef MakeRef(const StyleString& str);
 
-  // Adds a style to the string pool with a context object that can be used when sorting the string
-  // pool. Returns a reference to the style in the string pool.
+  // Adds a style to the string pool, unless an equal style already exists, with a context object
+  // that can be used when sorting the string pool. Returns a reference to the style in the string
+  // pool.
   StyleRef MakeRef(const StyleString& str, const Context& context);
 
   // Adds a style from another string pool. Returns a reference to the style in the string pool.
@@ -200,6 +202,7 @@ class StringPool {
   // Sorts the strings according to their Context using some comparison function.
   // Equal Contexts are further sorted by string value, lexicographically.
   // If no comparison function is provided, values are only sorted lexicographically.
+  // The comparison function is called about once per string, to find the distinct Contexts.
   void Sort(const std::function<int(const Context&, const Context&)>& cmp = nullptr);
 
   // Removes any strings that have no references.
@@ -211,11 +214,18 @@ class StringPool {
   static bool Flatten(BigBuffer* out, const StringPool& pool, bool utf8, IDiagnostics* diag);
 
   Ref MakeRefImpl(const android::StringPiece& str, const Context& context, bool unique);
+  StyleRef MakeStyleRefImpl(const std::string& str, std::vector<Span> spans,
+                            const Context& context);
   void ReAssignIndices();
 
+  template <typename E>
+  static void PruneEntries(std::vector<std::unique_ptr<E>>* entries,
+                           std::unordered_multimap<android::StringPiece, E*>* index);
+
   std::vector<std::unique_ptr<Entry>> strings_;
   std::vector<std::unique_ptr<StyleEntry>> styles_;
   std::unordered_multimap<android::StringPiece, Entry*> indexed_strings_;
+  std::unordered_multimap<android::StringPiece, StyleEntry*> indexed_styles_;
 };
 
 }  // namespace aapt
@@ -182,6 +182,59 @@ TEST(StringPoolTest, DoNotDedupeStyleWithSameStringAsNonStyle) {
   EXPECT_THAT(ref.index(), Ne(style_ref.index()));
 }
 
+TEST(StringPoolTest, DedupeEqualStyles) {
+  StringPool pool;
+
+  StringPool::StyleRef ref_a = pool.MakeRef(StyleString{{"android"}, {Span{{"b"}, 2, 6}}});
+  StringPool::StyleRef ref_b = pool.MakeRef(StyleString{{"android"}, {Span{{"b"}, 2, 6}}});
+  StringPool::StyleRef ref_c = pool.MakeRef(StyleString{{"android"}, {Span{{"i"}, 2, 6}}});
+  StringPool::StyleRef ref_d = pool.MakeRef(StyleString{{"android"}, {Span{{"b"}, 0, 6}}});
+
+  EXPECT_THAT(ref_b.index(), Eq(ref_a.index()));
+  EXPECT_THAT(ref_c.index(), Ne(ref_a.index()));
+  EXPECT_THAT(ref_d.index(), Ne(ref_a.index()));
+  EXPECT_THAT(ref_d.index(), Ne(ref_c.index()));
+}
+
+TEST(StringPoolTest, PruneStylesAndTheirSpanNames) {
+  StringPool pool;
+
+  StringPool::Ref ref_a = pool.MakeRef("foo");
+  {
+    StringPool::StyleRef ref_b = pool.MakeRef(StyleString{{"android"}, {Span{{"b"}, 2, 6}}});
+    EXPECT_THAT(pool.size(), Eq(3u));
+  }
+
+  pool.Prune();
+  EXPECT_THAT(pool.size(), Eq(1u));
+  EXPECT_THAT(ref_a.index(), Eq(0u));
+
+  // The pruned style is no longer shared.
+  StringPool::StyleRef ref_c = pool.MakeRef(StyleString{{"android"}, {Span{{"b"}, 2, 6}}});
+  EXPECT_THAT(ref_c.index(), Eq(0u));
+  EXPECT_THAT(pool.size(), Eq(3u));
+}
+
+TEST(StringPoolTest, SortByContextThenValue) {
+  StringPool pool;
+  const StringPool::Context high(StringPool::Context::kHighPriority);
+  const StringPool::Context low(StringPool::Context::kLowPriority);
+
+  StringPool::Ref ref_a = pool.MakeRef("b", low);
+  StringPool::Ref ref_b = pool.MakeRef("c", high);
+  StringPool::Ref ref_c = pool.MakeRef("a", low);
+  StringPool::Ref ref_d = pool.MakeRef("d");
+
+  pool.Sort([](const StringPool::Context& a, const StringPool::Context& b) -> int {
+    return util::compare(a.priority, b.priority);
+  });
+
+  EXPECT_THAT(ref_b.index(), Eq(0u));
+  EXPECT_THAT(ref_d.index(), Eq(1u));
+  EXPECT_THAT(ref_c.index(), Eq(2u));
+  EXPECT_THAT(ref_a.index(), Eq(3u));
+}
+
 TEST(StringPoolTest, StylesAndStringsAreSeparateAfterSorting) {
   StringPool pool;
 
@@ -17,7 +17,10 @@
 #include "Compile.h"
 
 #include <dirent.h>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include "android-base/errors.h"
 #include "android-base/file.h"
@@ -30,10 +33,12 @@
 #include "Diagnostics.h"
 #include "ResourceParser.h"
 #include "ResourceTable.h"
+#include "ResourceUtils.h"
 #include "cmd/Util.h"
 #include "compile/IdAssigner.h"
 #include "compile/InlineXmlFormatParser.h"
 #include "compile/Png.h"
+#include "compile/PngCache.h"
 #include "compile/PseudolocaleGenerator.h"
 #include "compile/XmlIdCollector.h"
 #include "format/Archive.h"
@@ -481,6 +486,23 @@ static bool CompilePng(IAaptContext* context, const CompileOptions& options,
     // Ensure that we only keep the chunks we care about if we end up
     // using the original PNG instead of the crunched one.
     const StringPiece content(reinterpret_cast<const char*>(data->data()), data->size());
+
+    // The container header depends on where the file is, so only the PNG itself is cached.
+    std::string cache_key;
+    if (options.png_cache_dir) {
+      cache_key = PngCache::GetKey(content, path_data.extension == "9.png");
+      std::string cached_png;
+      if (PngCache(options.png_cache_dir.value()).Get(cache_key, &cached_png)) {
+        if (context->IsVerbose()) {
+          context->GetDiagnostics()->Note(DiagMessage(path_data.source)
+                                          << "using cached crunched PNG");
+        }
+        io::StringInputStream cached_png_in(cached_png);
+        return WriteHeaderAndDataToWriter(output_path, res_file, &cached_png_in, writer,
+            context->GetDiagnostics());
+      }
+    }
+
     PngChunkFilter png_chunk_filter(content);
     std::unique_ptr<Image> image = ReadPng(context, path_data.source, &png_chunk_filter);
     if (!image) {
@@ -540,6 +562,12 @@ static bool CompilePng(IAaptContext* context, const CompileOptions& options,
       buffer.AppendBuffer(std::move(filtered_png_buffer));
     }
 
+    if (!cache_key.empty() && !PngCache(options.png_cache_dir.value()).Put(cache_key, buffer)) {
+      context->GetDiagnostics()->Warn(DiagMessage(path_data.source)
+                                      << "failed to store crunched PNG in "
+                                      << options.png_cache_dir.value());
+    }
+
     if (context->IsVerbose()) {
       // For debugging only, use the legacy PNG cruncher and compare the resulting file sizes.
       // This will help catch exotic cases where the new code may generate larger PNGs.
@@ -643,77 +671,263 @@ class CompileContext : public IAaptContext {
   bool verbose_ = false;
 };
 
-int Compile(IAaptContext* context, io::IFileCollection* inputs, IArchiveWriter* output_writer,
-             CompileOptions& options) {
-  TRACE_CALL();
-  bool error = false;
+// Compiles a single input file, found in a collection with the given directory separator.
+// Returns false if the file failed to compile.
+static bool CompileInput(IAaptContext* context, const CompileOptions& options, io::IFile* file,
+                         const char dir_sep, IArchiveWriter* output_writer) {
+  std::string path = file->GetSource().path;
 
-  // Iterate over the input files in a stable, platform-independent manner
-  auto file_iterator  = inputs->Iterator();
-  while (file_iterator->HasNext()) {
-    auto file = file_iterator->Next();
-    std::string path = file->GetSource().path;
+  // Skip hidden input files
+  if (file::IsHidden(path)) {
+    return true;
+  }
+
+  if (!options.res_zip && !IsValidFile(context, path)) {
+    return false;
+  }
 
-    // Skip hidden input files
-    if (file::IsHidden(path)) {
-      continue;
+  // Only measure the input when it is reported, since measuring may mean reading it.
+  size_t input_size = 0;
+  if (IsProfiling()) {
+    if (std::unique_ptr<io::IData> data = file->OpenAsData()) {
+      input_size = data->size();
     }
+  }
+  TRACE_NAME_BYTES("CompileInput " + path, input_size);
 
-    if (!options.res_zip && !IsValidFile(context, path)) {
-      error = true;
-      continue;
+  // Extract resource type information from the full path
+  std::string err_str;
+  ResourcePathData path_data;
+  if (auto maybe_path_data = ExtractResourcePathData(path, dir_sep, &err_str)) {
+    path_data = maybe_path_data.value();
+  } else {
+    context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << err_str);
+    return false;
+  }
+
+  // Determine how to compile the file based on its type.
+  auto compile_func = &CompileFile;
+  if (path_data.resource_dir == "values" && path_data.extension == "xml") {
+    compile_func = &CompileTable;
+    // We use a different extension (not necessary anymore, but avoids altering the existing
+    // build system logic).
+    path_data.extension = "arsc";
+
+  } else if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
+    if (*type != ResourceType::kRaw) {
+      if (*type == ResourceType::kXml || path_data.extension == "xml") {
+        compile_func = &CompileXml;
+      } else if ((!options.no_png_crunch && path_data.extension == "png")
+                 || path_data.extension == "9.png") {
+        compile_func = &CompilePng;
+      }
+    }
+  } else {
+    context->GetDiagnostics()->Error(DiagMessage()
+        << "invalid file path '" << path_data.source << "'");
+    return false;
+  }
+
+  // Treat periods as a reserved character that should not be present in a file name
+  // Legacy support for AAPT which did not reserve periods
+  if (compile_func != &CompileFile && !options.legacy_mode
+      && std::count(path_data.name.begin(), path_data.name.end(), '.') != 0) {
+    context->GetDiagnostics()->Error(DiagMessage(file->GetSource())
+                                                  << "file name cannot contain '.' other than for"
+                                                  << " specifying the extension");
+    return false;
+  }
+
+  const std::string out_path = BuildIntermediateContainerFilename(path_data);
+  if (!compile_func(context, options, path_data, file, output_writer, out_path)) {
+    context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << "file failed to compile");
+    return false;
+  }
+  return true;
+}
+
+// Keeps the entries written to it in memory until they are written to another archive, so that
+// inputs compiled concurrently can still be added to the output in input order.
+class BufferedArchiveWriter : public IArchiveWriter {
+ public:
+  BufferedArchiveWriter() = default;
+
+  bool WriteFile(const StringPiece& path, uint32_t flags, io::InputStream* in) override {
+    if (!StartEntry(path, flags)) {
+      return false;
     }
 
-    // Extract resource type information from the full path
-    std::string err_str;
-    ResourcePathData path_data;
-    if (auto maybe_path_data = ExtractResourcePathData(path, inputs->GetDirSeparator(), &err_str)) {
-      path_data = maybe_path_data.value();
-    } else {
-      context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << err_str);
-      error = true;
-      continue;
-    }
-
-    // Determine how to compile the file based on its type.
-    auto compile_func = &CompileFile;
-    if (path_data.resource_dir == "values" && path_data.extension == "xml") {
-      compile_func = &CompileTable;
-      // We use a different extension (not necessary anymore, but avoids altering the existing
-      // build system logic).
-      path_data.extension = "arsc";
-
-    } else if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
-      if (*type != ResourceType::kRaw) {
-        if (*type == ResourceType::kXml || path_data.extension == "xml") {
-          compile_func = &CompileXml;
-        } else if ((!options.no_png_crunch && path_data.extension == "png")
-                   || path_data.extension == "9.png") {
-          compile_func = &CompilePng;
+    const void* data = nullptr;
+    size_t len = 0;
+    while (in->Next(&data, &len)) {
+      if (!Write(data, static_cast<int>(len))) {
+        return false;
+      }
+    }
+
+    if (in->HadError()) {
+      error_ = in->GetError();
+      return false;
+    }
+
+    return FinishEntry();
+  }
+
+  bool StartEntry(const StringPiece& path, uint32_t flags) override {
+    if (entry_open_) {
+      return false;
+    }
+    entries_.push_back(Entry{path.to_string(), flags, {}});
+    entry_open_ = true;
+    return true;
+  }
+
+  bool Write(const void* data, int len) override {
+    if (!entry_open_) {
+      return false;
+    }
+    entries_.back().data.append(static_cast<const char*>(data), len);
+    return true;
+  }
+
+  bool FinishEntry() override {
+    if (!entry_open_) {
+      return false;
+    }
+    entry_open_ = false;
+    return true;
+  }
+
+  bool HadError() const override {
+    return !error_.empty();
+  }
+
+  std::string GetError() const override {
+    return error_;
+  }
+
+  // Writes the finished entries to writer in the order they were written here, then drops them.
+  bool WriteTo(IArchiveWriter* writer, IDiagnostics* diag) {
+    bool ok = true;
+    for (const Entry& entry : entries_) {
+      io::StringInputStream in(entry.data);
+      if (!writer->WriteFile(entry.path, entry.flags, &in)) {
+        diag->Error(DiagMessage(entry.path) << "failed to write: " << writer->GetError());
+        ok = false;
+        break;
+      }
+    }
+    entries_.clear();
+    return ok;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BufferedArchiveWriter);
+
+  struct Entry {
+    std::string path;
+    uint32_t flags;
+    std::string data;
+  };
+
+  std::vector<Entry> entries_;
+  bool entry_open_ = false;
+  std::string error_;
+};
+
+// Compiles the inputs on options.jobs threads. The diagnostics and output of each input are held
+// until those of every input before it are done, so both come out in the same order as they
+// would when compiling serially.
+static bool CompileConcurrently(IAaptContext* context, const CompileOptions& options,
+                                const std::vector<io::IFile*>& files, const char dir_sep,
+                                IArchiveWriter* output_writer) {
+  struct Task {
+    BufferedDiagnostics diag;
+    BufferedArchiveWriter writer;
+    bool ok = false;
+    bool done = false;
+  };
+  std::vector<Task> tasks(files.size());
+
+  // Workers stay at most this many inputs ahead of the output, to bound the memory held.
+  const size_t window = options.jobs * 4;
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t next = 0;
+  size_t written = 0;
+
+  auto worker = [&]() {
+    while (true) {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return next == files.size() || next < written + window; });
+        if (next == files.size()) {
+          return;
         }
+        i = next++;
       }
-    } else {
-      context->GetDiagnostics()->Error(DiagMessage()
-          << "invalid file path '" << path_data.source << "'");
-      error = true;
-      continue;
+
+      Task& task = tasks[i];
+      TaskContext task_context(context, &task.diag);
+      bool ok = CompileInput(&task_context, options, files[i], dir_sep, &task.writer);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      task.ok = ok;
+      task.done = true;
+      cv.notify_all();
     }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < options.jobs; i++) {
+    threads.emplace_back(worker);
+  }
 
-    // Treat periods as a reserved character that should not be present in a file name
-    // Legacy support for AAPT which did not reserve periods
-    if (compile_func != &CompileFile && !options.legacy_mode
-        && std::count(path_data.name.begin(), path_data.name.end(), '.') != 0) {
+  bool error = false;
+  for (size_t i = 0; i < files.size(); i++) {
+    Task& task = tasks[i];
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return task.done; });
+    }
+    task.diag.Replay(context->GetDiagnostics());
+    if (!task.ok || !task.writer.WriteTo(output_writer, context->GetDiagnostics())) {
       error = true;
-      context->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                    << "file name cannot contain '.' other than for"
-                                                    << " specifying the extension");
-      continue;
     }
 
-    const std::string out_path = BuildIntermediateContainerFilename(path_data);
-    if (!compile_func(context, options, path_data, file, output_writer, out_path)) {
-      context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << "file failed to compile");
-      error = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    written = i + 1;
+    cv.notify_all();
+  }
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return !error;
+}
+
+int Compile(IAaptContext* context, io::IFileCollection* inputs, IArchiveWriter* output_writer,
+             CompileOptions& options) {
+  TRACE_CALL();
+  bool error = false;
+
+  // Iterate over the input files in a stable, platform-independent manner
+  std::vector<io::IFile*> files;
+  auto file_iterator  = inputs->Iterator();
+  while (file_iterator->HasNext()) {
+    files.push_back(file_iterator->Next());
+  }
+
+  // Every values file rewrites the text symbols, so they are only written serially, in order.
+  if (options.jobs > 1 && files.size() > 1 && !options.generate_text_symbols_path) {
+    error = !CompileConcurrently(context, options, files, inputs->GetDirSeparator(),
+                                 output_writer);
+  } else {
+    for (io::IFile* file : files) {
+      if (!CompileInput(context, options, file, inputs->GetDirSeparator(), output_writer)) {
+        error = true;
+      }
     }
   }
 
@@ -722,6 +936,7 @@ int Compile(IAaptContext* context, io::IFileCollection* inputs, IArchiveWriter*
 
 int CompileCommand::Action(const std::vector<std::string>& args) {
   TRACE_FLUSH(trace_folder_? trace_folder_.value() : "", "CompileCommand::Action");
+  TRACE_PROFILE(profile_output_ ? profile_output_.value() : "", "compile");
   CompileContext context(diagnostic_);
   context.SetVerbose(options_.verbose);
 
@@ -740,6 +955,22 @@ int CompileCommand::Action(const std::vector<std::string>& args) {
     }
   }
 
+  if (options_.png_cache_dir && !file::mkdirs(options_.png_cache_dir.value())) {
+    context.GetDiagnostics()->Error(DiagMessage(options_.png_cache_dir.value())
+                                    << "failed to create PNG cache directory");
+    return 1;
+  }
+
+  if (jobs_) {
+    const Maybe<uint32_t> maybe_jobs = ResourceUtils::ParseInt(jobs_.value());
+    if (!maybe_jobs || maybe_jobs.value() == 0) {
+      context.GetDiagnostics()->Error(DiagMessage() << "--jobs '" << jobs_.value()
+                                                    << "' is not a positive integer");
+      return 1;
+    }
+    options_.jobs = maybe_jobs.value();
+  }
+
   std::unique_ptr<io::IFileCollection> file_collection;
 
   // Collect the resources files to compile
@@ -31,6 +31,8 @@ struct CompileOptions {
   Maybe<std::string> res_dir;
   Maybe<std::string> res_zip;
   Maybe<std::string> generate_text_symbols_path;
+  // Where crunched PNGs are cached across compilations, if anywhere.
+  Maybe<std::string> png_cache_dir;
   Maybe<Visibility::Level> visibility;
   bool pseudolocalize = false;
   bool no_png_crunch = false;
@@ -38,6 +40,8 @@ struct CompileOptions {
   // See comments on aapt::ResourceParserOptions.
   bool preserve_visibility_of_styleables = false;
   bool verbose = false;
+  // Number of threads compiling inputs at once.
+  size_t jobs = 1;
 };
 
 /** Parses flags and compiles resources to be used in linking.  */
@@ -56,6 +60,8 @@ class CompileCommand : public Command {
     AddOptionalSwitch("--pseudo-localize", "Generate resources for pseudo-locales "
         "(en-XA and ar-XB)", &options_.pseudolocalize);
     AddOptionalSwitch("--no-crunch", "Disables PNG processing", &options_.no_png_crunch);
+    AddOptionalFlag("--png-cache", "Directory in which to cache crunched PNGs, so that unchanged\n"
+        "PNGs are not crunched again", &options_.png_cache_dir, Command::kPath);
     AddOptionalSwitch("--legacy", "Treat errors that used to be valid in AAPT as warnings",
         &options_.legacy_mode);
     AddOptionalSwitch("--preserve-visibility-of-styleables",
@@ -67,8 +73,14 @@ class CompileCommand : public Command {
         "Sets the visibility of the compiled resources to the specified\n"
             "level. Accepted levels: public, private, default", &visibility_);
     AddOptionalSwitch("-v", "Enables verbose logging", &options_.verbose);
+    AddOptionalFlag("--jobs", "Number of inputs to compile concurrently. Defaults to 1.\n"
+        "Ignored with --output-text-symbols.", &jobs_);
     AddOptionalFlag("--trace-folder", "Generate systrace json trace fragment to specified folder.",
                     &trace_folder_);
+    AddOptionalFlag("--profile-output",
+        "Write a Chrome trace and a JSON summary of the time spent in each phase, the\n"
+            "time spent compiling each input and the peak memory use to the specified folder.",
+        &profile_output_, Command::kPath);
   }
 
   int Action(const std::vector<std::string>& args) override;
@@ -77,7 +89,9 @@ class CompileCommand : public Command {
   IDiagnostics* diagnostic_;
   CompileOptions options_;
   Maybe<std::string> visibility_;
+  Maybe<std::string> jobs_;
   Maybe<std::string> trace_folder_;
+  Maybe<std::string> profile_output_;
 };
 
 int Compile(IAaptContext* context, io::IFileCollection* inputs, IArchiveWriter* output_writer,
@@ -140,6 +140,54 @@ TEST_F(CompilerTest, DirInput) {
   ASSERT_EQ(::android::base::utf8::unlink(kOutputFlata.c_str()), 0);
 }
 
+TEST_F(CompilerTest, DirInputJobs) {
+  StdErrDiagnostics diag;
+  const std::string kResDir = BuildPath({android::base::Dirname(android::base::GetExecutablePath()),
+                                         "integration-tests", "CompileTest", "DirInput", "res"});
+  const std::string kOutputFlata =
+      BuildPath({android::base::Dirname(android::base::GetExecutablePath()), "integration-tests",
+                 "CompileTest", "DirInput", "compiled.flata"});
+  const std::string kJobsOutputFlata =
+      BuildPath({android::base::Dirname(android::base::GetExecutablePath()), "integration-tests",
+                 "CompileTest", "DirInput", "compiled_jobs.flata"});
+  ::android::base::utf8::unlink(kOutputFlata.c_str());
+  ::android::base::utf8::unlink(kJobsOutputFlata.c_str());
+
+  ASSERT_EQ(CompileCommand(&diag).Execute({"--dir", kResDir, "-o", kOutputFlata}, &std::cerr), 0);
+  ASSERT_EQ(CompileCommand(&diag).Execute({"--dir", kResDir, "-o", kJobsOutputFlata,
+                                           "--jobs", "4"}, &std::cerr), 0);
+
+  {
+    // The entries come out the same, in the same order, as when compiling serially
+    std::string err;
+    std::unique_ptr<io::ZipFileCollection> zip = io::ZipFileCollection::Create(kOutputFlata, &err);
+    ASSERT_NE(zip, nullptr) << err;
+    std::unique_ptr<io::ZipFileCollection> jobs_zip =
+        io::ZipFileCollection::Create(kJobsOutputFlata, &err);
+    ASSERT_NE(jobs_zip, nullptr) << err;
+
+    auto iter = zip->Iterator();
+    auto jobs_iter = jobs_zip->Iterator();
+    while (iter->HasNext()) {
+      ASSERT_TRUE(jobs_iter->HasNext());
+      io::IFile* file = iter->Next();
+      io::IFile* jobs_file = jobs_iter->Next();
+      EXPECT_EQ(file->GetSource().path, jobs_file->GetSource().path);
+
+      std::unique_ptr<io::IData> data = file->OpenAsData();
+      std::unique_ptr<io::IData> jobs_data = jobs_file->OpenAsData();
+      ASSERT_NE(data, nullptr);
+      ASSERT_NE(jobs_data, nullptr);
+      EXPECT_EQ(std::string(reinterpret_cast<const char*>(data->data()), data->size()),
+                std::string(reinterpret_cast<const char*>(jobs_data->data()), jobs_data->size()));
+    }
+    EXPECT_FALSE(jobs_iter->HasNext());
+    ASSERT_NE(jobs_zip->FindFile("drawable_image.png.flat"), nullptr);
+  }
+  ASSERT_EQ(::android::base::utf8::unlink(kOutputFlata.c_str()), 0);
+  ASSERT_EQ(::android::base::utf8::unlink(kJobsOutputFlata.c_str()), 0);
+}
+
 TEST_F(CompilerTest, ZipInput) {
   StdErrDiagnostics diag;
   std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
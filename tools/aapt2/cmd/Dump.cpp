@@ -314,6 +314,10 @@ int DumpTableCommand::Dump(LoadedApk* apk) {
     GetPrinter()->Println("Binary APK");
   }
 
+  if (stream_) {
+    return DumpStreaming(apk);
+  }
+
   ResourceTable* table = apk->GetResourceTable();
   if (!table) {
     GetDiagnostics()->Error(DiagMessage() << "Failed to retrieve resource table");
@@ -327,6 +331,45 @@ int DumpTableCommand::Dump(LoadedApk* apk) {
   return 0;
 }
 
+int DumpTableCommand::DumpStreaming(LoadedApk* apk) {
+  if (apk->GetApkFormat() != ApkFormat::kBinary) {
+    GetDiagnostics()->Error(DiagMessage(apk->GetSource())
+                            << "--stream is only supported for binary APKs");
+    return 1;
+  }
+
+  DumpTableOptions options;
+  options.package = package_;
+  options.type = type_;
+  options.show_values = !no_values_;
+  if (config_) {
+    android::ConfigDescription config;
+    if (!android::ConfigDescription::Parse(config_.value(), &config)) {
+      GetDiagnostics()->Error(DiagMessage() << "invalid config '" << config_.value() << "'");
+      return 1;
+    }
+    options.config = config;
+  }
+
+  io::IFile* table_file = apk->GetFileCollection()->FindFile(kApkResourceTablePath);
+  if (!table_file) {
+    GetDiagnostics()->Error(DiagMessage(apk->GetSource()) << "no resources.arsc found");
+    return 1;
+  }
+
+  std::unique_ptr<io::IData> data = table_file->OpenAsData();
+  if (!data) {
+    GetDiagnostics()->Error(DiagMessage(apk->GetSource()) << "failed to open resources.arsc");
+    return 1;
+  }
+
+  if (!DumpTableStreaming(data->data(), data->size(), table_file->GetSource(), options,
+                          GetPrinter(), GetDiagnostics())) {
+    return 1;
+  }
+  return 0;
+}
+
 int DumpXmlStringsCommand::Dump(LoadedApk* apk) {
   DumpContext context;
   bool error = false;
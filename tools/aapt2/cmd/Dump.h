@@ -21,6 +21,7 @@
 #include "Debug.h"
 #include "LoadedApk.h"
 #include "dump/DumpManifest.h"
+#include "dump/DumpTable.h"
 
 namespace aapt {
 
@@ -61,6 +62,11 @@ class DumpApkCommand : public Command {
   /** Perform the dump operation on the apk. */
   virtual int Dump(LoadedApk* apk) = 0;
 
+  /** Whether the dump operation uses the resource table, which is otherwise not loaded. */
+  virtual bool NeedsResourceTable() {
+    return true;
+  }
+
   int Action(const std::vector<std::string>& args) final {
     if (args.size() < 1) {
       diag_->Error(DiagMessage() << "No dump apk specified.");
@@ -69,7 +75,7 @@ class DumpApkCommand : public Command {
 
     bool error = false;
     for (auto apk : args) {
-      auto loaded_apk = LoadedApk::LoadApkFromPath(apk, diag_);
+      auto loaded_apk = LoadedApk::LoadApkFromPath(apk, diag_, NeedsResourceTable());
       if (!loaded_apk) {
         error = true;
         continue;
@@ -202,13 +208,32 @@ class DumpTableCommand : public DumpApkCommand {
     SetDescription("Print the contents of the resource table from the APK.");
     AddOptionalSwitch("--no-values", "Suppresses output of values when displaying resource tables.",
                       &no_values_);
+    AddOptionalSwitch("--stream",
+        "Prints the values of a binary resource table by configuration while reading\n"
+            "it, rather than loading the whole table first. This uses far less memory.",
+        &stream_);
+    AddOptionalFlag("--package", "With --stream, only prints the resources of this package.",
+        &package_);
+    AddOptionalFlag("--type", "With --stream, only prints the resources of this type.", &type_);
+    AddOptionalFlag("--config", "With --stream, only prints the values of this configuration.",
+        &config_);
     AddOptionalSwitch("-v", "Enables verbose logging.", &verbose_);
   }
 
   int Dump(LoadedApk* apk) override;
 
+  bool NeedsResourceTable() override {
+    return !stream_;
+  }
+
  private:
+  int DumpStreaming(LoadedApk* apk);
+
   bool no_values_ = false;
+  bool stream_ = false;
+  Maybe<std::string> package_;
+  Maybe<std::string> type_;
+  Maybe<std::string> config_;
   bool verbose_ = false;
 };
 
@@ -222,6 +247,10 @@ class DumpXmlStringsCommand : public DumpApkCommand {
 
   int Dump(LoadedApk* apk) override;
 
+  bool NeedsResourceTable() override {
+    return false;
+  }
+
  private:
   std::vector<std::string> files_;
 };
@@ -236,6 +265,10 @@ class DumpXmlTreeCommand : public DumpApkCommand {
 
   int Dump(LoadedApk* apk) override;
 
+  bool NeedsResourceTable() override {
+    return false;
+  }
+
  private:
   std::vector<std::string> files_;
 };
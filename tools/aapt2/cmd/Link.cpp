@@ -20,15 +20,19 @@
 #include <cinttypes>
 
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "android-base/errors.h"
 #include "android-base/file.h"
+#include "android-base/scopeguard.h"
 #include "android-base/stringprintf.h"
 #include "androidfw/Locale.h"
 #include "androidfw/StringPiece.h"
+#include "google/protobuf/arena.h"
 
 #include "AppInfo.h"
 #include "Debug.h"
@@ -50,6 +54,7 @@
 #include "io/BigBufferStream.h"
 #include "io/FileStream.h"
 #include "io/FileSystem.h"
+#include "io/StringStream.h"
 #include "io/Util.h"
 #include "io/ZipArchive.h"
 #include "java/JavaClassGenerator.h"
@@ -68,6 +73,7 @@
 #include "process/SymbolTable.h"
 #include "split/TableSplitter.h"
 #include "trace/TraceBuffer.h"
+#include "util/FileCache.h"
 #include "util/Files.h"
 #include "xml/XmlDom.h"
 
@@ -220,6 +226,15 @@ class FeatureSplitSymbolTableDelegate : public DefaultSymbolTableDelegate {
   IAaptContext* context_;
 };
 
+static bool FlattenXmlToBuffer(IAaptContext* context, const xml::XmlResource& xml_res,
+                               bool keep_raw_values, bool utf16, BigBuffer* out_buffer) {
+  XmlFlattenerOptions options = {};
+  options.keep_raw_values = keep_raw_values;
+  options.use_utf16 = utf16;
+  XmlFlattener flattener(out_buffer, options);
+  return flattener.Consume(context, &xml_res);
+}
+
 static bool FlattenXml(IAaptContext* context, const xml::XmlResource& xml_res,
                        const StringPiece& path, bool keep_raw_values, bool utf16,
                        OutputFormat format, IArchiveWriter* writer) {
@@ -233,11 +248,7 @@ static bool FlattenXml(IAaptContext* context, const xml::XmlResource& xml_res,
   switch (format) {
     case OutputFormat::kApk: {
       BigBuffer buffer(1024);
-      XmlFlattenerOptions options = {};
-      options.keep_raw_values = keep_raw_values;
-      options.use_utf16 = utf16;
-      XmlFlattener flattener(&buffer, options);
-      if (!flattener.Consume(context, &xml_res)) {
+      if (!FlattenXmlToBuffer(context, xml_res, keep_raw_values, utf16, &buffer)) {
         return false;
       }
 
@@ -282,6 +293,15 @@ struct ResourceFileFlattenerOptions {
   OutputFormat output_format = OutputFormat::kApk;
   std::unordered_set<std::string> extensions_to_not_compress;
   Maybe<std::regex> regex_to_not_compress;
+
+  // Where linked XML files are cached across links, if anywhere.
+  Maybe<std::string> xml_cache_dir;
+
+  // Identifies the APKs linked against, for the keys of cached XML files.
+  std::string xml_cache_includes;
+
+  // Number of threads linking XML files at once.
+  size_t jobs = 1;
 };
 
 // A sampling of public framework resource IDs.
@@ -343,16 +363,45 @@ class ResourceFileFlattener {
     // The file to copy as-is.
     io::IFile* file_to_copy;
 
-    // The XML to process and flatten.
+    // The format of file_to_copy when it is XML to process and flatten, or kUnknown when the file
+    // is copied as-is.
+    ResourceFile::Type xml_type = ResourceFile::Type::kUnknown;
+
+    // The name and source of the XML, set on xml_to_flatten when it is loaded.
+    ResourceName xml_name;
+    Source xml_source;
+
+    // The XML to process and flatten. It is only loaded when it is processed, and dropped after.
     std::unique_ptr<xml::XmlResource> xml_to_flatten;
 
     // The destination to write this file to.
     std::string dst_path;
+
+    // The key of the linked XML in the cache, if it can be cached.
+    std::string xml_cache_key;
+
+    // Whether the linked XML was found in the cache, when looked up ahead of time.
+    bool xml_cache_hit = false;
+    std::string cached_xml;
+
+    // What linking logged, when the XML was linked ahead of time on a worker thread.
+    std::unique_ptr<BufferedDiagnostics> link_diagnostics;
+    bool linked = false;
   };
 
+  bool LoadXmlToFlatten(FileOperation* file_op, IDiagnostics* diag);
+
+  template <typename FileOperations>
+  void LinkXmlFilesConcurrently(FileOperations* file_ops, FileCache* xml_cache);
+
   std::vector<std::unique_ptr<xml::XmlResource>> LinkAndVersionXmlFile(ResourceTable* table,
                                                                        FileOperation* file_op);
 
+  std::string BuildXmlCacheEnvironmentKey(const ResourceTable& table);
+
+  bool WriteCachedXmlFile(FileOperation* file_op, const std::string& cached,
+                          IArchiveWriter* archive_writer);
+
   ResourceFileFlattenerOptions options_;
   IAaptContext* context_;
   proguard::KeepSet* keep_set_;
@@ -429,15 +478,11 @@ std::vector<T> make_singleton_vec(T&& val) {
   return vec;
 }
 
-std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVersionXmlFile(
-    ResourceTable* table, FileOperation* file_op) {
-  TRACE_CALL();
-  xml::XmlResource* doc = file_op->xml_to_flatten.get();
-  const Source& src = doc->file.source;
-
-  if (context_->IsVerbose()) {
-    context_->GetDiagnostics()->Note(DiagMessage()
-                                     << "linking " << src.path << " (" << doc->file.name << ")");
+static bool LinkXmlFile(IAaptContext* context, xml::XmlResource* doc,
+                        bool do_not_fail_on_missing_resources) {
+  if (context->IsVerbose()) {
+    context->GetDiagnostics()->Note(DiagMessage() << "linking " << doc->file.source.path << " ("
+                                                  << doc->file.name << ")");
   }
 
   // First, strip out any tools namespace attributes. AAPT stripped them out early, which means
@@ -445,7 +490,116 @@ std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVer
   xml::StripAndroidStudioAttributes(doc->root.get());
 
   XmlReferenceLinker xml_linker;
-  if (!options_.do_not_fail_on_missing_resources && !xml_linker.Consume(context_, doc)) {
+  return do_not_fail_on_missing_resources || xml_linker.Consume(context, doc);
+}
+
+// Loads the XML of file_op into xml_to_flatten, with the name and source of its entry.
+bool ResourceFileFlattener::LoadXmlToFlatten(FileOperation* file_op, IDiagnostics* diag) {
+  TRACE_CALL();
+  io::IFile* file = file_op->file_to_copy;
+  std::unique_ptr<io::IData> data = file->OpenAsData();
+  if (!data) {
+    diag->Error(DiagMessage(file->GetSource()) << "failed to open file");
+    return false;
+  }
+
+  std::unique_ptr<xml::XmlResource> doc;
+  if (file_op->xml_type == ResourceFile::Type::kProtoXml) {
+    ::google::protobuf::Arena arena;
+    pb::XmlNode* pb_xml_node = ::google::protobuf::Arena::CreateMessage<pb::XmlNode>(&arena);
+    if (!pb_xml_node->ParseFromArray(data->data(), static_cast<int>(data->size()))) {
+      diag->Error(DiagMessage(file->GetSource()) << "failed to parse proto XML");
+      return false;
+    }
+
+    std::string error;
+    doc = DeserializeXmlResourceFromPb(*pb_xml_node, &error);
+    if (doc == nullptr) {
+      diag->Error(DiagMessage(file->GetSource()) << "failed to deserialize proto XML: " << error);
+      return false;
+    }
+  } else {
+    std::string error_str;
+    doc = xml::Inflate(data->data(), data->size(), &error_str);
+    if (doc == nullptr) {
+      diag->Error(DiagMessage(file->GetSource()) << "failed to parse binary XML: " << error_str);
+      return false;
+    }
+  }
+
+  doc->file.config = file_op->config;
+  doc->file.source = file_op->xml_source;
+  doc->file.name = file_op->xml_name;
+  file_op->xml_to_flatten = std::move(doc);
+  return true;
+}
+
+// Links the XML files of file_ops on options_.jobs threads, ahead of flattening them in order.
+// Each file's diagnostics are held until then. Files found in the XML cache are not loaded or
+// linked here.
+template <typename FileOperations>
+void ResourceFileFlattener::LinkXmlFilesConcurrently(FileOperations* file_ops,
+                                                     FileCache* xml_cache) {
+  TRACE_CALL();
+  std::vector<FileOperation*> xml_file_ops;
+  for (auto& map_entry : *file_ops) {
+    if (map_entry.second.xml_type != ResourceFile::Type::kUnknown) {
+      xml_file_ops.push_back(&map_entry.second);
+    }
+  }
+
+  const size_t thread_count = std::min(options_.jobs, xml_file_ops.size());
+  if (thread_count <= 1) {
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < xml_file_ops.size(); i = next++) {
+      FileOperation* file_op = xml_file_ops[i];
+      if (!file_op->xml_cache_key.empty()
+          && xml_cache->Get(file_op->xml_cache_key, &file_op->cached_xml)) {
+        file_op->xml_cache_hit = true;
+        continue;
+      }
+
+      file_op->link_diagnostics = util::make_unique<BufferedDiagnostics>();
+      if (!LoadXmlToFlatten(file_op, file_op->link_diagnostics.get())) {
+        continue;
+      }
+
+      TaskContext task_context(context_, file_op->link_diagnostics.get());
+      file_op->linked = LinkXmlFile(&task_context, file_op->xml_to_flatten.get(),
+                                    options_.do_not_fail_on_missing_resources);
+    }
+  };
+
+  // Symbols are looked up from every thread, and held on to while in use.
+  SymbolTable* symbols = context_->GetExternalSymbols();
+  symbols->SetShared(true);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  symbols->SetShared(false);
+}
+
+std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVersionXmlFile(
+    ResourceTable* table, FileOperation* file_op) {
+  TRACE_CALL();
+  xml::XmlResource* doc = file_op->xml_to_flatten.get();
+
+  if (file_op->link_diagnostics != nullptr) {
+    // Already linked on a worker thread.
+    file_op->link_diagnostics->Replay(context_->GetDiagnostics());
+    if (!file_op->linked) {
+      return {};
+    }
+  } else if (!LinkXmlFile(context_, doc, options_.do_not_fail_on_missing_resources)) {
     return {};
   }
 
@@ -484,6 +638,75 @@ std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVer
   return xml_compat_versioner.Process(context_, doc, api_range);
 }
 
+// Builds the part of the keys of cached XML files that is the same for all of them: the options
+// and everything about the table and the included APKs that linking can depend on, which is the
+// names, IDs and visibility of resources, the configurations they have and attribute definitions.
+// Changing the value of a string or a color, say, does not change this.
+std::string ResourceFileFlattener::BuildXmlCacheEnvironmentKey(const ResourceTable& table) {
+  TRACE_CALL();
+  CacheKeyBuilder key;
+  key.Add(options_.no_auto_version)
+      .Add(options_.no_version_vectors)
+      .Add(options_.no_version_transitions)
+      .Add(options_.no_xml_namespaces)
+      .Add(options_.keep_raw_values)
+      .Add(options_.do_not_fail_on_missing_resources)
+      .Add(options_.xml_cache_includes)
+      .Add(static_cast<uint64_t>(context_->GetPackageType()))
+      .Add(context_->GetCompilationPackage())
+      .Add(context_->GetPackageId())
+      .Add(static_cast<uint64_t>(context_->GetMinSdkVersion()));
+
+  for (const auto& pkg : table.packages) {
+    key.Add(pkg->name).Add(pkg->id.value_or_default(0));
+    for (const auto& type : pkg->types) {
+      key.Add(to_string(type->type)).Add(type->id.value_or_default(0));
+      for (const auto& entry : type->entries) {
+        key.Add(entry->name)
+            .Add(entry->id.value_or_default(0))
+            .Add(static_cast<uint64_t>(entry->visibility.level));
+        for (const auto& config_value : entry->values) {
+          key.Add(config_value->config.to_string()).Add(config_value->product);
+          const Attribute* attr = ValueCast<Attribute>(config_value->value.get());
+          if (attr == nullptr) {
+            continue;
+          }
+          key.Add(attr->type_mask)
+              .Add(static_cast<uint32_t>(attr->min_int))
+              .Add(static_cast<uint32_t>(attr->max_int));
+          for (const Attribute::Symbol& symbol : attr->symbols) {
+            key.Add(symbol.symbol.name ? symbol.symbol.name.value().to_string() : "")
+                .Add(symbol.symbol.id ? symbol.symbol.id.value().id : 0u)
+                .Add(symbol.value)
+                .Add(symbol.type);
+          }
+        }
+      }
+    }
+  }
+  return key.Build();
+}
+
+// Writes out a linked XML file found in the cache. Proguard rules only depend on the names and
+// raw values in the XML, so they are collected from the unlinked XML.
+bool ResourceFileFlattener::WriteCachedXmlFile(FileOperation* file_op, const std::string& cached,
+                                               IArchiveWriter* archive_writer) {
+  xml::XmlResource* doc = file_op->xml_to_flatten.get();
+  if (context_->IsVerbose()) {
+    context_->GetDiagnostics()->Note(DiagMessage() << "using cached " << doc->file.source.path
+                                                   << " (" << doc->file.name << ")");
+  }
+
+  xml::StripAndroidStudioAttributes(doc->root.get());
+  if (options_.update_proguard_spec && !proguard::CollectProguardRules(context_, doc, keep_set_)) {
+    return false;
+  }
+
+  io::StringInputStream cached_in(cached);
+  return io::CopyInputStreamToArchive(context_, &cached_in, file_op->dst_path,
+                                      ArchiveEntry::kCompress, archive_writer);
+}
+
 ResourceFile::Type XmlFileTypeForOutputFormat(OutputFormat format) {
   switch (format) {
     case OutputFormat::kApk:
@@ -506,6 +729,14 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
 
   proguard::CollectResourceReferences(context_, table, keep_set_);
 
+  // Proto XML is only written for bundles, which are not built incrementally.
+  std::unique_ptr<FileCache> xml_cache;
+  std::string xml_cache_environment;
+  if (options_.xml_cache_dir && options_.output_format == OutputFormat::kApk) {
+    xml_cache = util::make_unique<FileCache>(options_.xml_cache_dir.value());
+    xml_cache_environment = BuildXmlCacheEnvironmentKey(*table);
+  }
+
   for (auto& pkg : table->packages) {
     CHECK(!pkg->name.empty()) << "Packages must have names when being linked";
 
@@ -541,44 +772,32 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
           if (type->type != ResourceType::kRaw &&
               (file_ref->type == ResourceFile::Type::kBinaryXml ||
                file_ref->type == ResourceFile::Type::kProtoXml)) {
-            std::unique_ptr<io::IData> data = file->OpenAsData();
-            if (!data) {
-              context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                << "failed to open file");
-              return false;
-            }
+            file_op.xml_type = file_ref->type;
+            file_op.xml_name = ResourceName(pkg->name, type->type, entry->name);
+            file_op.xml_source = file_ref->GetSource();
 
-            if (file_ref->type == ResourceFile::Type::kProtoXml) {
-              pb::XmlNode pb_xml_node;
-              if (!pb_xml_node.ParseFromArray(data->data(), static_cast<int>(data->size()))) {
+            if (xml_cache != nullptr) {
+              std::unique_ptr<io::IData> data = file->OpenAsData();
+              if (!data) {
                 context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                  << "failed to parse proto XML");
+                                                  << "failed to open file");
                 return false;
               }
 
-              std::string error;
-              file_op.xml_to_flatten = DeserializeXmlResourceFromPb(pb_xml_node, &error);
-              if (file_op.xml_to_flatten == nullptr) {
-                context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                  << "failed to deserialize proto XML: " << error);
-                return false;
-              }
-            } else {
-              std::string error_str;
-              file_op.xml_to_flatten = xml::Inflate(data->data(), data->size(), &error_str);
-              if (file_op.xml_to_flatten == nullptr) {
-                context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                  << "failed to parse binary XML: " << error_str);
-                return false;
+              // Versioning depends on the other configurations of the entry.
+              CacheKeyBuilder key;
+              key.Add(xml_cache_environment)
+                  .Add(StringPiece(reinterpret_cast<const char*>(data->data()), data->size()))
+                  .Add(file_op.dst_path)
+                  .Add(config_value->config.to_string());
+              for (const auto& other_config_value : entry->values) {
+                key.Add(other_config_value->config.to_string());
               }
+              file_op.xml_cache_key = key.Build();
             }
 
             // Update the type that this file will be written as.
             file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
-
-            file_op.xml_to_flatten->file.config = config_value->config;
-            file_op.xml_to_flatten->file.source = file_ref->GetSource();
-            file_op.xml_to_flatten->file.name = ResourceName(pkg->name, type->type, entry->name);
           }
 
           // NOTE(adamlesinski): Explicitly construct a StringPiece here, or
@@ -591,12 +810,35 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
         }
       }
 
+      if (options_.jobs > 1) {
+        LinkXmlFilesConcurrently(&config_sorted_files, xml_cache.get());
+      }
+
       // Now flatten the sorted values.
       for (auto& map_entry : config_sorted_files) {
         const ConfigDescription& config = map_entry.first.first;
         FileOperation& file_op = map_entry.second;
 
-        if (file_op.xml_to_flatten) {
+        if (file_op.xml_type != ResourceFile::Type::kUnknown) {
+          // Only one XML file is held in memory at a time, unless they were linked concurrently.
+          auto drop_xml = ::android::base::make_scope_guard([&]() {
+            file_op.xml_to_flatten.reset();
+            file_op.cached_xml.clear();
+          });
+
+          if (file_op.xml_to_flatten == nullptr) {
+            if (file_op.link_diagnostics != nullptr) {
+              // Failed to load on a worker thread.
+              file_op.link_diagnostics->Replay(context_->GetDiagnostics());
+              error = true;
+              continue;
+            }
+            if (!LoadXmlToFlatten(&file_op, context_->GetDiagnostics())) {
+              error = true;
+              continue;
+            }
+          }
+
           // Check minimum sdk versions supported for drawables
           auto drawable_entry = kDrawableVersions.find(file_op.xml_to_flatten->root->name);
           if (drawable_entry != kDrawableVersions.end()) {
@@ -611,6 +853,15 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
             }
           }
 
+          if (!file_op.xml_cache_key.empty() && !file_op.xml_cache_hit && !file_op.link_diagnostics
+              && xml_cache->Get(file_op.xml_cache_key, &file_op.cached_xml)) {
+            file_op.xml_cache_hit = true;
+          }
+          if (file_op.xml_cache_hit) {
+            error |= !WriteCachedXmlFile(&file_op, file_op.cached_xml, archive_writer);
+            continue;
+          }
+
           std::vector<std::unique_ptr<xml::XmlResource>> versioned_docs =
               LinkAndVersionXmlFile(table, &file_op);
           if (versioned_docs.empty()) {
@@ -618,6 +869,27 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
             continue;
           }
 
+          // Only files that weren't versioned into new configurations are cached, since those
+          // add resources to the table.
+          if (!file_op.xml_cache_key.empty() && versioned_docs.size() == 1
+              && versioned_docs[0]->file.config == file_op.config) {
+            BigBuffer buffer(1024);
+            if (!FlattenXmlToBuffer(context_, *versioned_docs[0], options_.keep_raw_values,
+                                    false /*utf16*/, &buffer)) {
+              error = true;
+              continue;
+            }
+            if (!xml_cache->Put(file_op.xml_cache_key, buffer)) {
+              context_->GetDiagnostics()->Warn(DiagMessage(versioned_docs[0]->file.source)
+                                               << "failed to cache linked XML in "
+                                               << options_.xml_cache_dir.value());
+            }
+            io::BigBufferInputStream buffer_in(&buffer);
+            error |= !io::CopyInputStreamToArchive(context_, &buffer_in, file_op.dst_path,
+                                                   ArchiveEntry::kCompress, archive_writer);
+            continue;
+          }
+
           for (std::unique_ptr<xml::XmlResource>& doc : versioned_docs) {
             std::string dst_path = file_op.dst_path;
             if (doc->file.config != file_op.config) {
@@ -1062,7 +1334,9 @@ class Linker {
     if (options_.output_to_directory) {
       return CreateDirectoryArchiveWriter(context_->GetDiagnostics(), out);
     } else {
-      return CreateZipFileArchiveWriter(context_->GetDiagnostics(), out);
+      ZipFileArchiveWriterOptions writer_options;
+      writer_options.jobs = options_.jobs;
+      return CreateZipFileArchiveWriter(context_->GetDiagnostics(), out, writer_options);
     }
   }
 
@@ -1093,51 +1367,117 @@ class Linker {
     return false;
   }
 
-  bool WriteJavaFile(ResourceTable* table, const StringPiece& package_name_to_generate,
-                     const StringPiece& out_package, const JavaClassGeneratorOptions& java_options,
-                     const Maybe<std::string>& out_text_symbols_path = {}) {
-    if (!options_.generate_java_class_path && !out_text_symbols_path) {
+  // An R class to generate, along with the R.txt to write for it, if any.
+  struct JavaFileRequest {
+    std::string package_name_to_generate;
+    std::string out_package;
+    JavaClassGeneratorOptions options;
+    Maybe<std::string> out_text_symbols_path;
+  };
+
+  // Generates the R class and R.txt of request in memory, and only writes the files whose contents
+  // changed, so that unchanged files keep their modification times.
+  bool WriteJavaFile(const JavaFileRequest& request, IAaptContext* context) {
+    if (!options_.generate_java_class_path && !request.out_text_symbols_path) {
       return true;
     }
 
     std::string out_path;
-    std::unique_ptr<io::FileOutputStream> fout;
+    std::string java_contents;
+    std::unique_ptr<io::StringOutputStream> java_out;
     if (options_.generate_java_class_path) {
       out_path = options_.generate_java_class_path.value();
-      file::AppendPath(&out_path, file::PackageToPath(out_package));
+      file::AppendPath(&out_path, file::PackageToPath(request.out_package));
       if (!file::mkdirs(out_path)) {
-        context_->GetDiagnostics()->Error(DiagMessage()
-                                          << "failed to create directory '" << out_path << "'");
+        context->GetDiagnostics()->Error(DiagMessage()
+                                         << "failed to create directory '" << out_path << "'");
         return false;
       }
 
       file::AppendPath(&out_path, "R.java");
+      java_out = util::make_unique<io::StringOutputStream>(&java_contents);
+    }
 
-      fout = util::make_unique<io::FileOutputStream>(out_path);
-      if (fout->HadError()) {
-        context_->GetDiagnostics()->Error(DiagMessage() << "failed writing to '" << out_path
-                                                        << "': " << fout->GetError());
+    std::string text_contents;
+    std::unique_ptr<io::StringOutputStream> text_out;
+    if (request.out_text_symbols_path) {
+      text_out = util::make_unique<io::StringOutputStream>(&text_contents);
+    }
+
+    JavaClassGenerator generator(context, &final_table_, request.options);
+    if (!generator.Generate(request.package_name_to_generate, request.out_package, java_out.get(),
+                            text_out.get())) {
+      context->GetDiagnostics()->Error(DiagMessage(out_path) << generator.GetError());
+      return false;
+    }
+
+    std::string error;
+    if (java_out) {
+      java_out->Flush();
+      if (!file::WriteFileIfChanged(out_path, java_contents, &error)) {
+        context->GetDiagnostics()->Error(DiagMessage() << "failed writing to '" << out_path
+                                                       << "': " << error);
         return false;
       }
     }
 
-    std::unique_ptr<io::FileOutputStream> fout_text;
-    if (out_text_symbols_path) {
-      fout_text = util::make_unique<io::FileOutputStream>(out_text_symbols_path.value());
-      if (fout_text->HadError()) {
-        context_->GetDiagnostics()->Error(DiagMessage()
-                                          << "failed writing to '" << out_text_symbols_path.value()
-                                          << "': " << fout_text->GetError());
+    if (text_out) {
+      text_out->Flush();
+      if (!file::WriteFileIfChanged(request.out_text_symbols_path.value(), text_contents,
+                                    &error)) {
+        context->GetDiagnostics()->Error(DiagMessage()
+                                         << "failed writing to '"
+                                         << request.out_text_symbols_path.value() << "': "
+                                         << error);
         return false;
       }
     }
+    return true;
+  }
 
-    JavaClassGenerator generator(context_, table, java_options);
-    if (!generator.Generate(package_name_to_generate, out_package, fout.get(), fout_text.get())) {
-      context_->GetDiagnostics()->Error(DiagMessage(out_path) << generator.GetError());
-      return false;
+  // Writes the R classes of requests on options_.jobs threads. Diagnostics are reported in the
+  // order of the requests.
+  bool WriteJavaFiles(const std::vector<JavaFileRequest>& requests) {
+    const size_t thread_count = std::min(options_.jobs, requests.size());
+    if (thread_count <= 1) {
+      for (const JavaFileRequest& request : requests) {
+        if (!WriteJavaFile(request, context_)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    std::vector<std::unique_ptr<BufferedDiagnostics>> diagnostics(requests.size());
+    std::vector<char> written(requests.size(), false);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+      for (size_t i = next++; i < requests.size(); i = next++) {
+        diagnostics[i] = util::make_unique<BufferedDiagnostics>();
+        TaskContext task_context(context_, diagnostics[i].get());
+        written[i] = WriteJavaFile(requests[i], &task_context);
+      }
+    };
+
+    // Attributes of styleables are looked up from every thread.
+    SymbolTable* symbols = context_->GetExternalSymbols();
+    symbols->SetShared(true);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+      thread.join();
     }
+    symbols->SetShared(false);
 
+    for (size_t i = 0; i < requests.size(); i++) {
+      diagnostics[i]->Replay(context_->GetDiagnostics());
+      if (!written[i]) {
+        return false;
+      }
+    }
     return true;
   }
 
@@ -1145,6 +1485,7 @@ class Linker {
     TRACE_CALL();
     // The set of packages whose R class to call in the main classes onResourcesLoaded callback.
     std::vector<std::string> packages_to_callback;
+    std::vector<JavaFileRequest> requests;
 
     JavaClassGeneratorOptions template_options;
     template_options.types = JavaClassGeneratorOptions::SymbolTypes::kAll;
@@ -1159,8 +1500,8 @@ class Linker {
       template_options.rewrite_callback_options = OnResourcesLoadedCallbackOptions{};
     }
 
-    const StringPiece actual_package = context_->GetCompilationPackage();
-    StringPiece output_package = context_->GetCompilationPackage();
+    const std::string actual_package = context_->GetCompilationPackage();
+    std::string output_package = context_->GetCompilationPackage();
     if (options_.custom_java_package) {
       // Override the output java package to the custom one.
       output_package = options_.custom_java_package.value();
@@ -1174,10 +1515,8 @@ class Linker {
       // to the original package, and private and public symbols to the private package.
       JavaClassGeneratorOptions options = template_options;
       options.types = JavaClassGeneratorOptions::SymbolTypes::kPublicPrivate;
-      if (!WriteJavaFile(&final_table_, actual_package, options_.private_symbols.value(),
-                         options)) {
-        return false;
-      }
+      requests.push_back(
+          JavaFileRequest{actual_package, options_.private_symbols.value(), options, {}});
     }
 
     // Generate copies of the original package R class but with different package names.
@@ -1187,9 +1526,7 @@ class Linker {
 
       JavaClassGeneratorOptions options = template_options;
       options.types = JavaClassGeneratorOptions::SymbolTypes::kAll;
-      if (!WriteJavaFile(&final_table_, actual_package, extra_package, options)) {
-        return false;
-      }
+      requests.push_back(JavaFileRequest{actual_package, extra_package, options, {}});
     }
 
     // Generate R classes for each package that was merged (static library).
@@ -1199,9 +1536,7 @@ class Linker {
 
       JavaClassGeneratorOptions options = template_options;
       options.types = JavaClassGeneratorOptions::SymbolTypes::kAll;
-      if (!WriteJavaFile(&final_table_, package, package, options)) {
-        return false;
-      }
+      requests.push_back(JavaFileRequest{package, package, options, {}});
     }
 
     // Generate the main public R class.
@@ -1217,12 +1552,9 @@ class Linker {
           std::move(packages_to_callback);
     }
 
-    if (!WriteJavaFile(&final_table_, actual_package, output_package, options,
-                       options_.generate_text_symbols_path)) {
-      return false;
-    }
-
-    return true;
+    requests.push_back(JavaFileRequest{actual_package, output_package, options,
+                                       options_.generate_text_symbols_path});
+    return WriteJavaFiles(requests);
   }
 
   bool WriteManifestJavaFile(xml::XmlResource* manifest_xml) {
@@ -1265,19 +1597,16 @@ class Linker {
 
     file::AppendPath(&out_path, "Manifest.java");
 
-    io::FileOutputStream fout(out_path);
-    if (fout.HadError()) {
-      context_->GetDiagnostics()->Error(DiagMessage() << "failed to open '" << out_path
-                                                      << "': " << fout.GetError());
-      return false;
-    }
-
-    ClassDefinition::WriteJavaFile(manifest_class.get(), package_utf8, true, &fout);
-    fout.Flush();
+    // Like R.java, Manifest.java is only rewritten when its contents change.
+    std::string contents;
+    io::StringOutputStream out(&contents);
+    ClassDefinition::WriteJavaFile(manifest_class.get(), package_utf8, true, &out);
+    out.Flush();
 
-    if (fout.HadError()) {
+    std::string error;
+    if (!file::WriteFileIfChanged(out_path, contents, &error)) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed writing to '" << out_path
-                                                      << "': " << fout.GetError());
+                                                      << "': " << error);
       return false;
     }
     return true;
@@ -1454,7 +1783,6 @@ class Linker {
   // All other file types are ignored. This is because these files could be coming from a zip,
   // where we could have other files like classes.dex.
   bool MergeFile(io::IFile* file, bool override) {
-    TRACE_CALL();
     const Source& src = file->GetSource();
 
     if (util::EndsWith(src.path, ".xml") || util::EndsWith(src.path, ".png")) {
@@ -1472,20 +1800,17 @@ class Linker {
       }
     }
 
-    std::unique_ptr<io::InputStream> input_stream = file->OpenInputStream();
-    if (input_stream == nullptr) {
+    // Map the file rather than reading it, so that tables are parsed straight from the mapping
+    // and compiled files are not read until they are flattened.
+    std::unique_ptr<io::IData> data = file->OpenAsData();
+    if (data == nullptr) {
       context_->GetDiagnostics()->Error(DiagMessage(src) << "failed to open file");
       return false;
     }
-
-    if (input_stream->HadError()) {
-      context_->GetDiagnostics()->Error(DiagMessage(src)
-                                        << "failed to open file: " << input_stream->GetError());
-      return false;
-    }
+    TRACE_NAME_BYTES("MergeFile " + src.path, data->size());
 
     ContainerReaderEntry* entry;
-    ContainerReader reader(input_stream.get());
+    ContainerReader reader(data.get());
 
     if (reader.HadError()) {
       context_->GetDiagnostics()->Error(DiagMessage(src)
@@ -1496,8 +1821,10 @@ class Linker {
     while ((entry = reader.Next()) != nullptr) {
       if (entry->Type() == ContainerEntryType::kResTable) {
         TRACE_NAME(std::string("Process ResTable:") + file->GetSource().path);
-        pb::ResourceTable pb_table;
-        if (!entry->GetResTable(&pb_table)) {
+        ::google::protobuf::Arena arena;
+        pb::ResourceTable* pb_table =
+            ::google::protobuf::Arena::CreateMessage<pb::ResourceTable>(&arena);
+        if (!entry->GetResTable(pb_table)) {
           context_->GetDiagnostics()->Error(DiagMessage(src) << "failed to read resource table: "
                                                              << entry->GetError());
           return false;
@@ -1505,7 +1832,7 @@ class Linker {
 
         ResourceTable table;
         std::string error;
-        if (!DeserializeTableFromPb(pb_table, nullptr /*files*/, &table, &error)) {
+        if (!DeserializeTableFromPb(*pb_table, nullptr /*files*/, &table, &error)) {
           context_->GetDiagnostics()->Error(DiagMessage(src)
                                             << "failed to deserialize resource table: " << error);
           return false;
@@ -1664,6 +1991,19 @@ class Linker {
     }
   }
 
+  // Identifies the APKs linked against by their paths, sizes and modification times.
+  std::string GetIncludesCacheKey() {
+    CacheKeyBuilder key;
+    for (const std::string& path : options_.include_paths) {
+      key.Add(path);
+      struct stat st;
+      if (stat(path.c_str(), &st) == 0) {
+        key.Add(static_cast<uint64_t>(st.st_size)).Add(static_cast<uint64_t>(st.st_mtime));
+      }
+    }
+    return key.Build();
+  }
+
   // Writes the AndroidManifest, ResourceTable, and all XML files referenced by the ResourceTable
   // to the IArchiveWriter.
   bool WriteApk(IArchiveWriter* writer, proguard::KeepSet* keep_set, xml::XmlResource* manifest,
@@ -1698,6 +2038,11 @@ class Linker {
         static_cast<bool>(options_.generate_proguard_rules_path);
     file_flattener_options.output_format = options_.output_format;
     file_flattener_options.do_not_fail_on_missing_resources = options_.merge_only;
+    file_flattener_options.xml_cache_dir = options_.incremental_cache_dir;
+    file_flattener_options.jobs = options_.jobs;
+    if (options_.incremental_cache_dir) {
+      file_flattener_options.xml_cache_includes = GetIncludesCacheKey();
+    }
 
     ResourceFileFlattener file_flattener(file_flattener_options, context_, keep_set);
     if (!file_flattener.Flatten(table, writer)) {
@@ -2000,7 +2345,7 @@ class Linker {
     }
 
     if (!options_.no_resource_deduping) {
-      ResourceDeduper deduper;
+      ResourceDeduper deduper(options_.jobs);
       if (!deduper.Consume(context_, &final_table_)) {
         context_->GetDiagnostics()->Error(DiagMessage() << "failed deduping resources");
         return 1;
@@ -2180,6 +2525,7 @@ class Linker {
 
 int LinkCommand::Action(const std::vector<std::string>& args) {
   TRACE_FLUSH(trace_folder_ ? trace_folder_.value() : "", "LinkCommand::Action");
+  TRACE_PROFILE(profile_output_ ? profile_output_.value() : "", "link");
   LinkContext context(diag_);
 
   // Expand all argument-files passed into the command line. These start with '@'.
@@ -2242,6 +2588,17 @@ int LinkCommand::Action(const std::vector<std::string>& args) {
     options_.output_format = OutputFormat::kProto;
   }
 
+  if (jobs_) {
+    const Maybe<uint32_t> maybe_jobs = ResourceUtils::ParseInt(jobs_.value());
+    if (!maybe_jobs || maybe_jobs.value() == 0) {
+      context.GetDiagnostics()->Error(DiagMessage() << "--jobs '" << jobs_.value()
+                                                    << "' is not a positive integer");
+      return 1;
+    }
+    options_.jobs = maybe_jobs.value();
+    options_.table_flattener_options.jobs = options_.jobs;
+  }
+
   if (package_id_) {
     if (context.GetPackageType() != PackageType::kApp) {
       context.GetDiagnostics()->Error(
@@ -2347,6 +2704,12 @@ int LinkCommand::Action(const std::vector<std::string>& args) {
     options_.no_version_transitions = true;
   }
 
+  if (options_.incremental_cache_dir && !file::mkdirs(options_.incremental_cache_dir.value())) {
+    context.GetDiagnostics()->Error(DiagMessage(options_.incremental_cache_dir.value())
+                                    << "failed to create incremental cache directory");
+    return 1;
+  }
+
   Linker cmd(&context, options_);
   return cmd.Run(arg_list);
 }
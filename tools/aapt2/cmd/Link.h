@@ -87,6 +87,12 @@ struct LinkOptions {
   SerializeTableOptions proto_table_flattener_options;
   bool keep_raw_values = false;
 
+  // Where linked XML files are cached across links, if anywhere.
+  Maybe<std::string> incremental_cache_dir;
+
+  // Number of threads linking XML files at once, and deflating the entries of the APK.
+  size_t jobs = 1;
+
   // Split APK options.
   TableSplitterOptions table_splitter_options;
   std::vector<SplitConstraints> split_constraints;
@@ -303,6 +309,19 @@ class LinkCommand : public Command {
     AddOptionalFlag("--trace-folder",
         "Generate systrace json trace fragment to specified folder.",
         &trace_folder_);
+    AddOptionalFlag("--profile-output",
+        "Write a Chrome trace and a JSON summary of the time spent in each phase, the\n"
+            "time spent merging each input and the peak memory use to the specified folder.",
+        &profile_output_, Command::kPath);
+    AddOptionalFlag("--incremental-cache",
+        "Directory in which to cache linked XML files. XML files that are unchanged\n"
+            "since a previous link, and whose resource references still resolve to the\n"
+            "same IDs, are copied from there instead of being linked again.",
+        &options_.incremental_cache_dir, Command::kPath);
+    AddOptionalFlag("--jobs",
+        "Number of XML files to link, resource table configurations to flatten, and APK\n"
+            "entries to compress, concurrently. Defaults to 1.",
+        &jobs_);
     AddOptionalSwitch("--merge-only",
         "Only merge the resources, without verifying resource references. This flag\n"
             "should only be used together with the --static-lib flag.",
@@ -332,6 +351,8 @@ class LinkCommand : public Command {
   Maybe<std::string> stable_id_file_path_;
   std::vector<std::string> split_args_;
   Maybe<std::string> trace_folder_;
+  Maybe<std::string> profile_output_;
+  Maybe<std::string> jobs_;
 };
 
 }// namespace aapt
@@ -317,4 +317,116 @@ TEST_F(LinkTest, AppInfoWithUsesSplit) {
   ASSERT_TRUE(Link(link_args, feature2_files_dir, &diag));
 }
 
+TEST_F(LinkTest, IncrementalCacheReusesLinkedXml) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  const std::string cache_dir = GetTestPath("cache");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/xml/test.xml"), R"(<Item text="@string/foo"/>)",
+                          compiled_files_dir, &diag));
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="foo">first</string></resources>)",
+                          compiled_files_dir, &diag));
+
+  const std::string out_apk = GetTestPath("out.apk");
+  std::vector<std::string> link_args = {
+      "--manifest", GetDefaultManifest(),
+      "--incremental-cache", cache_dir,
+      "-o", out_apk,
+  };
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  Maybe<std::vector<std::string>> cached_files = file::FindFiles(cache_dir, &diag, nullptr);
+  ASSERT_TRUE(cached_files);
+  EXPECT_THAT(cached_files.value().size(), Eq(1u));
+
+  // Changing the value of the string leaves its ID, and so the linked XML, the same.
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="foo">second</string></resources>)",
+                          compiled_files_dir, &diag));
+  const std::string out_apk2 = GetTestPath("out2.apk");
+  link_args = {
+      "--manifest", GetDefaultManifest(),
+      "--incremental-cache", cache_dir,
+      "-o", out_apk2,
+  };
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  cached_files = file::FindFiles(cache_dir, &diag, nullptr);
+  ASSERT_TRUE(cached_files);
+  EXPECT_THAT(cached_files.value().size(), Eq(1u));
+
+  std::unique_ptr<LoadedApk> apk = LoadedApk::LoadApkFromPath(out_apk, &diag);
+  std::unique_ptr<LoadedApk> apk2 = LoadedApk::LoadApkFromPath(out_apk2, &diag);
+  std::unique_ptr<io::IData> data = OpenFileAsData(apk.get(), "res/xml/test.xml");
+  std::unique_ptr<io::IData> data2 = OpenFileAsData(apk2.get(), "res/xml/test.xml");
+  ASSERT_THAT(data, Ne(nullptr));
+  ASSERT_THAT(data2, Ne(nullptr));
+  EXPECT_THAT(std::string(reinterpret_cast<const char*>(data2->data()), data2->size()),
+              Eq(std::string(reinterpret_cast<const char*>(data->data()), data->size())));
+
+  android::ResXMLTree tree;
+  AssertLoadXml(apk2.get(), data2.get(), &tree);
+}
+
+TEST_F(LinkTest, JobsLinkXmlTheSame) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources>
+                               <string name="foo">foo</string>
+                               <attr name="bar" format="integer"/>
+                             </resources>)",
+                          compiled_files_dir, &diag));
+  for (int i = 0; i < 8; i++) {
+    ASSERT_TRUE(CompileFile(GetTestPath(android::base::StringPrintf("res/xml/test%d.xml", i)),
+                            R"(<Item xmlns:app="http://schemas.android.com/apk/res-auto"
+                                     text="@string/foo" app:bar="42"/>)",
+                            compiled_files_dir, &diag));
+  }
+
+  const std::string out_apk = GetTestPath("out.apk");
+  std::vector<std::string> link_args = {
+      "--manifest", GetDefaultManifest(),
+      "-o", out_apk,
+  };
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  const std::string jobs_out_apk = GetTestPath("jobs_out.apk");
+  link_args = {
+      "--manifest", GetDefaultManifest(),
+      "--jobs", "4",
+      "-o", jobs_out_apk,
+  };
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  std::unique_ptr<LoadedApk> apk = LoadedApk::LoadApkFromPath(out_apk, &diag);
+  std::unique_ptr<LoadedApk> jobs_apk = LoadedApk::LoadApkFromPath(jobs_out_apk, &diag);
+  for (int i = 0; i < 8; i++) {
+    const std::string path = android::base::StringPrintf("res/xml/test%d.xml", i);
+    std::unique_ptr<io::IData> data = OpenFileAsData(apk.get(), path);
+    std::unique_ptr<io::IData> jobs_data = OpenFileAsData(jobs_apk.get(), path);
+    ASSERT_THAT(data, Ne(nullptr));
+    ASSERT_THAT(jobs_data, Ne(nullptr));
+    EXPECT_THAT(std::string(reinterpret_cast<const char*>(jobs_data->data()), jobs_data->size()),
+                Eq(std::string(reinterpret_cast<const char*>(data->data()), data->size())));
+  }
+}
+
+TEST_F(LinkTest, JobsReportLinkErrors) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(CompileFile(GetTestPath(android::base::StringPrintf("res/xml/test%d.xml", i)),
+                            R"(<Item text="@string/missing"/>)", compiled_files_dir, &diag));
+  }
+
+  const std::string out_apk = GetTestPath("out.apk");
+  std::vector<std::string> link_args = {
+      "--manifest", GetDefaultManifest(),
+      "--jobs", "4",
+      "-o", out_apk,
+  };
+  ASSERT_FALSE(Link(link_args, compiled_files_dir, &diag));
+}
+
 }  // namespace aapt
@@ -145,7 +145,7 @@ class Optimizer {
       return 1;
     }
 
-    ResourceDeduper deduper;
+    ResourceDeduper deduper(options_.archive_writer_options.jobs);
     if (!deduper.Consume(context_, apk->GetResourceTable())) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed deduping resources");
       return 1;
@@ -191,8 +191,8 @@ class Optimizer {
       // Generate an AndroidManifest.xml for each split.
       std::unique_ptr<xml::XmlResource> split_manifest =
           GenerateSplitManifest(options_.app_info, *split_constraints_iter);
-      std::unique_ptr<IArchiveWriter> split_writer =
-          CreateZipFileArchiveWriter(context_->GetDiagnostics(), *path_iter);
+      std::unique_ptr<IArchiveWriter> split_writer = CreateZipFileArchiveWriter(
+          context_->GetDiagnostics(), *path_iter, options_.archive_writer_options);
       if (!split_writer) {
         return 1;
       }
@@ -209,7 +209,9 @@ class Optimizer {
       MultiApkGenerator generator{apk.get(), context_};
       MultiApkGeneratorOptions generator_options = {
           options_.output_dir.value(), options_.apk_artifacts.value(),
-          options_.table_flattener_options, options_.kept_artifacts};
+          options_.table_flattener_options, options_.kept_artifacts,
+          options_.archive_writer_options};
+      generator_options.jobs = options_.archive_writer_options.jobs;
       if (!generator.FromBaseApk(generator_options)) {
         return 1;
       }
@@ -217,7 +219,8 @@ class Optimizer {
 
     if (options_.output_path) {
       std::unique_ptr<IArchiveWriter> writer =
-          CreateZipFileArchiveWriter(context_->GetDiagnostics(), options_.output_path.value());
+          CreateZipFileArchiveWriter(context_->GetDiagnostics(), options_.output_path.value(),
+                                     options_.archive_writer_options);
       if (!apk->WriteToArchive(context_, options_.table_flattener_options, writer.get())) {
         return 1;
       }
@@ -419,6 +422,16 @@ int OptimizeCommand::Action(const std::vector<std::string>& args) {
     return 1;
   }
 
+  if (jobs_) {
+    const Maybe<uint32_t> maybe_jobs = ResourceUtils::ParseInt(jobs_.value());
+    if (!maybe_jobs || maybe_jobs.value() == 0) {
+      diag->Error(DiagMessage() << "--jobs '" << jobs_.value() << "' is not a positive integer");
+      return 1;
+    }
+    options_.archive_writer_options.jobs = maybe_jobs.value();
+    options_.table_flattener_options.jobs = maybe_jobs.value();
+  }
+
   std::unique_ptr<LoadedApk> apk = LoadedApk::LoadApkFromPath(apk_path, context.GetDiagnostics());
   if (!apk) {
     return 1;
@@ -20,6 +20,7 @@
 #include "AppInfo.h"
 #include "Command.h"
 #include "configuration/ConfigurationParser.h"
+#include "format/Archive.h"
 #include "format/binary/TableFlattener.h"
 #include "split/TableSplitter.h"
 
@@ -61,6 +62,9 @@ struct OptimizeOptions {
 
   // Path to the output map of original resource paths to shortened paths.
   Maybe<std::string> shortened_paths_map_path;
+
+  // How the output APKs are written.
+  ZipFileArchiveWriterOptions archive_writer_options;
 };
 
 class OptimizeCommand : public Command {
@@ -111,6 +115,13 @@ class OptimizeCommand : public Command {
     AddOptionalFlag("--resource-path-shortening-map",
         "Path to output the map of old resource paths to shortened paths.",
         &options_.shortened_paths_map_path);
+    AddOptionalFlag("--jobs", "Number of output artifacts to generate, resource table\n"
+            "configurations to flatten, and APK entries to compress, concurrently. Defaults to 1.",
+        &jobs_);
+    AddOptionalSwitch("--reuse-compressed-entries",
+        "Copies entries that are compressed in the input APK without recompressing them.\n"
+            "This is faster, but keeps the compression level of the input APK.",
+        &options_.archive_writer_options.reuse_compressed_entries);
     AddOptionalSwitch("-v", "Enables verbose logging", &verbose_);
   }
 
@@ -125,6 +136,7 @@ class OptimizeCommand : public Command {
   Maybe<std::string> config_path_;
   Maybe<std::string> resources_config_path_;
   Maybe<std::string> target_densities_;
+  Maybe<std::string> jobs_;
   std::vector<std::string> configs_;
   std::vector<std::string> split_args_;
   std::unordered_set<std::string> kept_artifacts_;
@@ -25,12 +25,64 @@
 #include "Diagnostics.h"
 #include "SdkConstants.h"
 #include "filter/ConfigFilter.h"
+#include "process/IResourceTableConsumer.h"
 #include "split/TableSplitter.h"
 #include "util/Maybe.h"
 #include "xml/XmlDom.h"
 
 namespace aapt {
 
+// The context of work done on a worker thread. Everything but the diagnostics comes from the
+// context of the whole command.
+class TaskContext : public IAaptContext {
+ public:
+  TaskContext(IAaptContext* context, IDiagnostics* diagnostics)
+      : context_(context), diagnostics_(diagnostics) {
+  }
+
+  PackageType GetPackageType() override {
+    return context_->GetPackageType();
+  }
+
+  bool IsVerbose() override {
+    return context_->IsVerbose();
+  }
+
+  IDiagnostics* GetDiagnostics() override {
+    return diagnostics_;
+  }
+
+  NameMangler* GetNameMangler() override {
+    return context_->GetNameMangler();
+  }
+
+  const std::string& GetCompilationPackage() override {
+    return context_->GetCompilationPackage();
+  }
+
+  uint8_t GetPackageId() override {
+    return context_->GetPackageId();
+  }
+
+  SymbolTable* GetExternalSymbols() override {
+    return context_->GetExternalSymbols();
+  }
+
+  int GetMinSdkVersion() override {
+    return context_->GetMinSdkVersion();
+  }
+
+  const std::set<std::string>& GetSplitNameDependencies() override {
+    return context_->GetSplitNameDependencies();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TaskContext);
+
+  IAaptContext* context_;
+  IDiagnostics* diagnostics_;
+};
+
 // Parses a configuration density (ex. hdpi, xxhdpi, 234dpi, anydpi, etc).
 // Returns Nothing and logs a human friendly error message if the string was not legal.
 Maybe<uint16_t> ParseTargetDensityParameter(const android::StringPiece& arg, IDiagnostics* diag);
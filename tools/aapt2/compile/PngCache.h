@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_COMPILE_PNGCACHE_H
+#define AAPT_COMPILE_PNGCACHE_H
+
+#include <string>
+
+#include "androidfw/StringPiece.h"
+
+#include "util/FileCache.h"
+
+namespace aapt {
+
+// An on-disk cache of crunched PNGs, addressed by the contents of the source PNG, so that
+// unchanged images are not crunched again on every build.
+class PngCache : public FileCache {
+ public:
+  using FileCache::FileCache;
+
+  // Returns the key of the crunched form of the PNG with the given contents.
+  static std::string GetKey(const android::StringPiece& content, bool nine_patch);
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_COMPILE_PNGCACHE_H
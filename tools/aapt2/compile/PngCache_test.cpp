@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/PngCache.h"
+
+#include <cstring>
+
+#include "test/Fixture.h"
+#include "test/Test.h"
+
+namespace aapt {
+
+using PngCacheTest = TestDirectoryFixture;
+
+TEST_F(PngCacheTest, KeyDependsOnContentAndNinePatch) {
+  EXPECT_EQ(PngCache::GetKey("png", false), PngCache::GetKey("png", false));
+  EXPECT_NE(PngCache::GetKey("png", false), PngCache::GetKey("pnh", false));
+  EXPECT_NE(PngCache::GetKey("png", false), PngCache::GetKey("png", true));
+}
+
+TEST_F(PngCacheTest, PutThenGet) {
+  PngCache cache(GetTestDirectory().to_string());
+  const std::string key = PngCache::GetKey("source", false);
+
+  std::string data;
+  EXPECT_FALSE(cache.Get(key, &data));
+
+  BigBuffer buffer(4);
+  memcpy(buffer.NextBlock<char>(6), "crunch", 6);
+  memcpy(buffer.NextBlock<char>(3), "ed!", 3);
+  ASSERT_TRUE(cache.Put(key, buffer));
+  ASSERT_TRUE(cache.Get(key, &data));
+  EXPECT_EQ("crunched!", data);
+
+  // Storing the same entry again leaves it intact.
+  ASSERT_TRUE(cache.Put(key, buffer));
+  ASSERT_TRUE(cache.Get(key, &data));
+  EXPECT_EQ("crunched!", data);
+}
+
+}  // namespace aapt
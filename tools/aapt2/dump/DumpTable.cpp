@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DumpTable.h"
+
+#include <sstream>
+
+#include "android-base/macros.h"
+#include "android-base/stringprintf.h"
+#include "androidfw/ResourceTypes.h"
+#include "androidfw/TypeWrappers.h"
+
+#include "Resource.h"
+#include "ResourceUtils.h"
+#include "ResourceValues.h"
+#include "StringPool.h"
+#include "format/binary/BinaryResourceParser.h"
+#include "format/binary/ResChunkPullParser.h"
+#include "util/Util.h"
+
+using ::android::ConfigDescription;
+using ::android::ResChunk_header;
+using ::android::ResStringPool;
+using ::android::ResTable_entry;
+using ::android::ResTable_header;
+using ::android::ResTable_map;
+using ::android::ResTable_map_entry;
+using ::android::ResTable_package;
+using ::android::ResTable_type;
+using ::android::ResTable_typeSpec;
+using ::android::Res_value;
+using ::android::TypeVariant;
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+namespace {
+
+class StreamingTableDumper {
+ public:
+  StreamingTableDumper(const Source& source, const DumpTableOptions& options,
+                       text::Printer* printer, IDiagnostics* diag)
+      : source_(source), options_(options), printer_(printer), diag_(diag) {
+  }
+
+  bool DumpTable(const void* data, size_t size) {
+    ResChunkPullParser parser(data, size);
+    if (!ResChunkPullParser::IsGoodEvent(parser.Next())) {
+      diag_->Error(DiagMessage(source_) << "corrupt resources.arsc: " << parser.error());
+      return false;
+    }
+
+    const ResTable_header* table_header = ConvertTo<ResTable_header>(parser.chunk());
+    if (util::DeviceToHost16(parser.chunk()->type) != android::RES_TABLE_TYPE || !table_header) {
+      diag_->Error(DiagMessage(source_) << "corrupt ResTable_header chunk");
+      return false;
+    }
+
+    ResChunkPullParser table_parser(GetChunkData(&table_header->header),
+                                    GetChunkDataLen(&table_header->header));
+    while (ResChunkPullParser::IsGoodEvent(table_parser.Next())) {
+      switch (util::DeviceToHost16(table_parser.chunk()->type)) {
+        case android::RES_STRING_POOL_TYPE:
+          if (value_pool_.getError() == android::NO_INIT) {
+            if (value_pool_.setTo(table_parser.chunk(),
+                                  util::DeviceToHost32(table_parser.chunk()->size))
+                != android::NO_ERROR) {
+              diag_->Error(DiagMessage(source_) << "corrupt string pool in ResTable");
+              return false;
+            }
+          }
+          break;
+
+        case android::RES_TABLE_PACKAGE_TYPE:
+          if (!DumpPackage(table_parser.chunk())) {
+            return false;
+          }
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    if (table_parser.event() == ResChunkPullParser::Event::kBadDocument) {
+      diag_->Error(DiagMessage(source_) << "corrupt resource table: " << table_parser.error());
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(StreamingTableDumper);
+
+  bool DumpPackage(const ResChunk_header* chunk) {
+    constexpr size_t kMinPackageSize =
+        sizeof(ResTable_package) - sizeof(ResTable_package::typeIdOffset);
+    const ResTable_package* package_header = ConvertTo<ResTable_package, kMinPackageSize>(chunk);
+    if (!package_header) {
+      diag_->Error(DiagMessage(source_) << "corrupt ResTable_package chunk");
+      return false;
+    }
+
+    const size_t name_len = strnlen16(reinterpret_cast<const char16_t*>(package_header->name),
+                                      arraysize(package_header->name));
+    std::u16string package_name;
+    for (size_t i = 0; i < name_len; i++) {
+      package_name += static_cast<char16_t>(util::DeviceToHost16(package_header->name[i]));
+    }
+    package_name_ = util::Utf16ToUtf8(package_name);
+    if (options_.package && options_.package.value() != package_name_) {
+      return true;
+    }
+
+    package_id_ = util::DeviceToHost32(package_header->id);
+    printer_->Print("Package name=");
+    printer_->Print(package_name_);
+    printer_->Println(StringPrintf(" id=%02x", package_id_));
+
+    type_pool_.uninit();
+    key_pool_.uninit();
+
+    printer_->Indent();
+    ResChunkPullParser parser(GetChunkData(&package_header->header),
+                              GetChunkDataLen(&package_header->header));
+    bool dumped = true;
+    while (dumped && ResChunkPullParser::IsGoodEvent(parser.Next())) {
+      switch (util::DeviceToHost16(parser.chunk()->type)) {
+        case android::RES_STRING_POOL_TYPE: {
+          ResStringPool* pool = type_pool_.getError() == android::NO_INIT ? &type_pool_
+                                                                          : &key_pool_;
+          if (pool->setTo(parser.chunk(), util::DeviceToHost32(parser.chunk()->size))
+              != android::NO_ERROR) {
+            diag_->Error(DiagMessage(source_) << "corrupt string pool in ResTable_package");
+            dumped = false;
+          }
+        } break;
+
+        case android::RES_TABLE_TYPE_SPEC_TYPE:
+          dumped = DumpTypeSpec(parser.chunk());
+          break;
+
+        case android::RES_TABLE_TYPE_TYPE:
+          dumped = DumpType(parser.chunk());
+          break;
+
+        default:
+          break;
+      }
+    }
+    if (in_type_) {
+      printer_->Undent();
+      in_type_ = false;
+    }
+    printer_->Undent();
+
+    if (dumped && parser.event() == ResChunkPullParser::Event::kBadDocument) {
+      diag_->Error(DiagMessage(source_) << "corrupt ResTable_package: " << parser.error());
+      return false;
+    }
+    return dumped;
+  }
+
+  bool IsTypeDumped(uint8_t type_id) {
+    return !options_.type || options_.type.value() == GetTypeName(type_id);
+  }
+
+  std::string GetTypeName(uint8_t type_id) {
+    return type_id == 0 ? std::string() : util::GetString(type_pool_, type_id - 1);
+  }
+
+  bool DumpTypeSpec(const ResChunk_header* chunk) {
+    const ResTable_typeSpec* type_spec = ConvertTo<ResTable_typeSpec>(chunk);
+    if (!type_spec || type_pool_.getError() != android::NO_ERROR) {
+      diag_->Error(DiagMessage(source_) << "corrupt ResTable_typeSpec chunk");
+      return false;
+    }
+
+    if (!IsTypeDumped(type_spec->id)) {
+      return true;
+    }
+
+    // The type spec comes before the configurations of its type, which are indented under it.
+    if (in_type_) {
+      printer_->Undent();
+    }
+    in_type_ = true;
+    printer_->Print("type ");
+    printer_->Print(GetTypeName(type_spec->id));
+    printer_->Println(StringPrintf(" id=%02x entryCount=%u", type_spec->id,
+                                   util::DeviceToHost32(type_spec->entryCount)));
+    printer_->Indent();
+    return true;
+  }
+
+  bool DumpType(const ResChunk_header* chunk) {
+    const ResTable_type* type = ConvertTo<ResTable_type, kResTableTypeMinSize>(chunk);
+    if (!type || type_pool_.getError() != android::NO_ERROR
+        || key_pool_.getError() != android::NO_ERROR) {
+      diag_->Error(DiagMessage(source_) << "corrupt ResTable_type chunk");
+      return false;
+    }
+
+    if (!IsTypeDumped(type->id)) {
+      return true;
+    }
+
+    ConfigDescription config;
+    config.copyFromDtoH(type->config);
+    if (options_.config && options_.config.value() != config) {
+      return true;
+    }
+
+    const std::string type_name = GetTypeName(type->id);
+    const ResourceType* parsed_type = ParseResourceType(type_name);
+    const ResourceType resource_type = parsed_type ? *parsed_type : ResourceType::kUnknown;
+
+    printer_->Print("config (");
+    printer_->Print(config.to_string());
+    printer_->Println(")");
+    printer_->Indent();
+    TypeVariant tv(type);
+    for (auto it = tv.beginEntries(); it != tv.endEntries(); ++it) {
+      const ResTable_entry* entry = *it;
+      if (!entry) {
+        continue;
+      }
+
+      const ResourceId id(package_id_, type->id, static_cast<uint16_t>(it.index()));
+      printer_->Print("resource ");
+      printer_->Print(id.to_string());
+      printer_->Print(" ");
+      printer_->Print(type_name);
+      printer_->Print("/");
+      printer_->Print(util::GetString(key_pool_, util::DeviceToHost32(entry->key.index)));
+      if (util::DeviceToHost16(entry->flags) & ResTable_entry::FLAG_PUBLIC) {
+        printer_->Print(" PUBLIC");
+      }
+      printer_->Println();
+
+      if (options_.show_values) {
+        printer_->Indent();
+        DumpEntryValue(resource_type, config, entry,
+                       reinterpret_cast<const uint8_t*>(type) +
+                           util::DeviceToHost32(type->header.size));
+        printer_->Undent();
+      }
+    }
+    printer_->Undent();
+    return true;
+  }
+
+  // The entry header itself is checked by TypeVariant; the value or map that follows it must
+  // end before chunk_end, the end of its ResTable_type chunk.
+  void DumpEntryValue(const ResourceType& type, const ConfigDescription& config,
+                      const ResTable_entry* entry, const uint8_t* chunk_end) {
+    const uint8_t* entry_start = reinterpret_cast<const uint8_t*>(entry);
+    const size_t available = chunk_end - entry_start;
+    const size_t entry_size = util::DeviceToHost16(entry->size);
+    if (!(util::DeviceToHost16(entry->flags) & ResTable_entry::FLAG_COMPLEX)) {
+      if (entry_size < sizeof(ResTable_entry) || entry_size > available ||
+          sizeof(Res_value) > available - entry_size) {
+        diag_->Warn(DiagMessage(source_) << "value past the end of ResTable_type chunk");
+        return;
+      }
+      const Res_value* value = reinterpret_cast<const Res_value*>(entry_start + entry_size);
+      printer_->Println(FormatValue(type, config, *value));
+      return;
+    }
+
+    const ResTable_map_entry* map = static_cast<const ResTable_map_entry*>(entry);
+    if (sizeof(ResTable_map_entry) > available || entry_size < sizeof(ResTable_map_entry) ||
+        entry_size > available ||
+        uint64_t(util::DeviceToHost32(map->count)) * sizeof(ResTable_map) >
+            available - entry_size) {
+      diag_->Warn(DiagMessage(source_) << "map past the end of ResTable_type chunk");
+      return;
+    }
+    if (util::DeviceToHost32(map->parent.ident) != 0) {
+      printer_->Println(StringPrintf("parent=0x%08x", util::DeviceToHost32(map->parent.ident)));
+    }
+    for (const ResTable_map& map_entry : map) {
+      printer_->Print(StringPrintf("0x%08x=", util::DeviceToHost32(map_entry.name.ident)));
+      printer_->Println(FormatValue(type, config, map_entry.value));
+    }
+  }
+
+  // Formats a value the way the values of a loaded table are printed. The strings of the value
+  // live in a pool of their own, which is dropped along with the value.
+  std::string FormatValue(const ResourceType& type, const ConfigDescription& config,
+                          const Res_value& value) {
+    StringPool pool;
+    std::unique_ptr<Item> item = ResourceUtils::ParseBinaryResValue(type, config, value_pool_,
+                                                                    value, &pool);
+    if (!item) {
+      return StringPrintf("(unknown type 0x%02x) 0x%08x", value.dataType,
+                          util::DeviceToHost32(value.data));
+    }
+    std::ostringstream out;
+    item->Print(&out);
+    return out.str();
+  }
+
+  const Source& source_;
+  const DumpTableOptions& options_;
+  text::Printer* printer_;
+  IDiagnostics* diag_;
+
+  ResStringPool value_pool_;
+  ResStringPool type_pool_;
+  ResStringPool key_pool_;
+  std::string package_name_;
+  uint32_t package_id_ = 0;
+  // Whether the configurations printed are indented under a type.
+  bool in_type_ = false;
+};
+
+}  // namespace
+
+bool DumpTableStreaming(const void* data, size_t size, const Source& source,
+                        const DumpTableOptions& options, text::Printer* printer,
+                        IDiagnostics* diag) {
+  StreamingTableDumper dumper(source, options, printer, diag);
+  return dumper.DumpTable(data, size);
+}
+
+}  // namespace aapt
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT2_DUMP_TABLE_H
+#define AAPT2_DUMP_TABLE_H
+
+#include <string>
+
+#include "androidfw/ConfigDescription.h"
+
+#include "Diagnostics.h"
+#include "Source.h"
+#include "text/Printer.h"
+#include "util/Maybe.h"
+
+namespace aapt {
+
+struct DumpTableOptions {
+  /** Only output the resources of the package with this name. */
+  Maybe<std::string> package;
+  /** Only output the resources of the type with this name. */
+  Maybe<std::string> type;
+  /** Only output the values of this configuration. */
+  Maybe<android::ConfigDescription> config;
+  /** Output the values of the resources, and not only their names. */
+  bool show_values = true;
+};
+
+/**
+ * Print the binary resource table in data while walking its chunks, without loading it into a
+ * ResourceTable. Values are printed by configuration, in the order they are laid out in the table,
+ * so memory use does not grow with the size of the table.
+ */
+bool DumpTableStreaming(const void* data, size_t size, const Source& source,
+                        const DumpTableOptions& options, text::Printer* printer,
+                        IDiagnostics* diag);
+
+}  // namespace aapt
+
+#endif  // AAPT2_DUMP_TABLE_H
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dump/DumpTable.h"
+
+#include "format/binary/TableFlattener.h"
+#include "io/StringStream.h"
+#include "test/Test.h"
+
+using ::aapt::io::StringOutputStream;
+using ::android::Res_value;
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+namespace aapt {
+
+class DumpTableTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    context_ =
+        test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+    std::unique_ptr<ResourceTable> table =
+        test::ResourceTableBuilder()
+            .SetPackageId("com.app.test", 0x7f)
+            .AddValue("com.app.test:integer/one", ResourceId(0x7f020000),
+                      util::make_unique<BinaryPrimitive>(uint8_t(Res_value::TYPE_INT_DEC), 1u))
+            .AddValue("com.app.test:integer/one", test::ParseConfigOrDie("land"),
+                      ResourceId(0x7f020000),
+                      util::make_unique<BinaryPrimitive>(uint8_t(Res_value::TYPE_INT_DEC), 2u))
+            .AddString("com.app.test:string/hello", ResourceId(0x7f030000), "hello")
+            .Build();
+
+    BigBuffer buffer(1024);
+    TableFlattener flattener({}, &buffer);
+    ASSERT_TRUE(flattener.Consume(context_.get(), table.get()));
+    table_data_ = buffer.to_string();
+  }
+
+  std::string Dump(const DumpTableOptions& options) {
+    std::string output;
+    StringOutputStream out(&output);
+    text::Printer printer(&out);
+    EXPECT_TRUE(DumpTableStreaming(table_data_.data(), table_data_.size(), Source("test.arsc"),
+                                   options, &printer, context_->GetDiagnostics()));
+    out.Flush();
+    return output;
+  }
+
+ protected:
+  std::unique_ptr<IAaptContext> context_;
+  std::string table_data_;
+};
+
+TEST_F(DumpTableTest, DumpsEveryConfiguration) {
+  const std::string output = Dump({});
+  EXPECT_THAT(output, HasSubstr("Package name=com.app.test id=7f"));
+  EXPECT_THAT(output, HasSubstr("type integer id=02"));
+  EXPECT_THAT(output, HasSubstr("config (land)"));
+  EXPECT_THAT(output, HasSubstr("resource 0x7f020000 integer/one"));
+  EXPECT_THAT(output, HasSubstr("resource 0x7f030000 string/hello"));
+  EXPECT_THAT(output, HasSubstr("hello"));
+}
+
+TEST_F(DumpTableTest, FiltersTypesAndConfigurations) {
+  DumpTableOptions options;
+  options.type = std::string("integer");
+  options.config = test::ParseConfigOrDie("land");
+  const std::string output = Dump(options);
+  EXPECT_THAT(output, HasSubstr("config (land)"));
+  EXPECT_THAT(output, HasSubstr("resource 0x7f020000 integer/one"));
+  EXPECT_THAT(output, Not(HasSubstr("config ()")));
+  EXPECT_THAT(output, Not(HasSubstr("string/hello")));
+
+  options = {};
+  options.package = std::string("com.other");
+  EXPECT_THAT(Dump(options), Not(HasSubstr("Package name=com.app.test")));
+}
+
+}  // namespace aapt
@@ -16,9 +16,14 @@
 
 #include "format/Archive.h"
 
+#include <condition_variable>
 #include <cstdio>
+#include <deque>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "android-base/errors.h"
@@ -26,7 +31,9 @@
 #include "android-base/utf8.h"
 #include "androidfw/StringPiece.h"
 #include "ziparchive/zip_writer.h"
+#include "zlib.h"
 
+#include "trace/TraceBuffer.h"
 #include "util/Files.h"
 
 using ::android::StringPiece;
@@ -242,6 +249,7 @@ class ZipFileWriter : public IArchiveWriter {
 
   virtual ~ZipFileWriter() {
     if (writer_) {
+      TRACE_NAME("ZipFileWriter::Finish");
       writer_->Finish();
     }
   }
@@ -254,6 +262,417 @@ class ZipFileWriter : public IArchiveWriter {
   std::string error_;
 };
 
+// Writes the ZIP format directly instead of through ZipWriter, so that entries can be deflated on
+// worker threads while the ones before them are written out, and so that entries which are
+// already deflated can be copied as they are. Every entry is held in memory until it is written,
+// which lets its local header carry the final CRC-32 and sizes. Errors that happen after an
+// entry was accepted are reported by the next call, or logged when the writer is destroyed.
+class StreamingZipFileWriter : public IArchiveWriter {
+ public:
+  StreamingZipFileWriter(IDiagnostics* diag, const ZipFileArchiveWriterOptions& options)
+      : diag_(diag), options_(options) {}
+
+  bool Open(const StringPiece& path) {
+    path_ = path.to_string();
+    file_ = {::android::base::utf8::fopen(path_.c_str(), "w+b"), fclose};
+    if (!file_) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+
+    if (options_.jobs > 1) {
+      for (size_t i = 0; i < options_.jobs; i++) {
+        workers_.emplace_back([this]() { DeflateEntries(); });
+      }
+    }
+    return true;
+  }
+
+  bool StartEntry(const StringPiece& path, uint32_t flags) override {
+    if (!file_ || HadError()) {
+      return false;
+    }
+
+    current_entry_ = util::make_unique<Entry>();
+    current_entry_->path = path.to_string();
+    current_entry_->flags = flags;
+    return true;
+  }
+
+  bool Write(const void* data, int len) override {
+    if (!current_entry_) {
+      error_ = "no entry started";
+      return false;
+    }
+    current_entry_->data.append(static_cast<const char*>(data), len);
+    return true;
+  }
+
+  bool FinishEntry() override {
+    if (!current_entry_) {
+      error_ = "no entry started";
+      return false;
+    }
+    return AddEntry(std::move(current_entry_));
+  }
+
+  bool WriteFile(const StringPiece& path, uint32_t flags, io::InputStream* in) override {
+    if (!StartEntry(path, flags)) {
+      return false;
+    }
+
+    const void* data = nullptr;
+    size_t len = 0;
+    while (in->Next(&data, &len)) {
+      current_entry_->data.append(static_cast<const char*>(data), len);
+    }
+
+    if (in->HadError()) {
+      error_ = in->GetError();
+      current_entry_ = {};
+      return false;
+    }
+
+    // Check to see if the file was compressed enough. This is preserving behavior of AAPT.
+    current_entry_->store_if_incompressible = in->CanRewind();
+    return FinishEntry();
+  }
+
+  bool CanWriteCompressedFile() const override {
+    return options_.reuse_compressed_entries;
+  }
+
+  bool WriteCompressedFile(const StringPiece& path, const void* data, size_t compressed_size,
+                           uint32_t crc32, size_t uncompressed_size) override {
+    if (!StartEntry(path, ArchiveEntry::kCompress)) {
+      return false;
+    }
+
+    current_entry_->data.assign(static_cast<const char*>(data), compressed_size);
+    current_entry_->method = kDeflated;
+    current_entry_->crc32 = crc32;
+    current_entry_->uncompressed_size = uncompressed_size;
+    current_entry_->done = true;
+    return FinishEntry();
+  }
+
+  bool HadError() const override {
+    return !error_.empty();
+  }
+
+  std::string GetError() const override {
+    return error_;
+  }
+
+  virtual ~StreamingZipFileWriter() {
+    if (file_ && !HadError() && !Finish()) {
+      diag_->Error(DiagMessage(path_) << "failed to write archive: " << error_);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      todo_.clear();
+      stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(StreamingZipFileWriter);
+
+  static constexpr uint16_t kStored = 0u;
+  static constexpr uint16_t kDeflated = 8u;
+  static constexpr uint16_t kVersion = 20u;
+
+  // DOS date of 1980-01-01, the earliest a ZIP entry can have. ZipWriter uses the same when it
+  // is not given a time, which keeps the output reproducible.
+  static constexpr uint16_t kDosDate = (1u << 5) | 1u;
+
+  static constexpr uint32_t kLocalFileHeaderSignature = 0x04034b50u;
+  static constexpr uint32_t kCentralDirectorySignature = 0x02014b50u;
+  static constexpr uint32_t kEndOfCentralDirectorySignature = 0x06054b50u;
+  static constexpr size_t kLocalFileHeaderSize = 30u;
+
+  // Entries that can be waiting to be written, per thread deflating them.
+  static constexpr size_t kPendingEntriesPerJob = 4u;
+
+  struct Entry {
+    std::string path;
+    uint32_t flags = 0u;
+
+    // The input data until the entry is deflated, and then the data to write.
+    std::string data;
+    uint16_t method = kStored;
+    uint32_t crc32 = 0u;
+    size_t uncompressed_size = 0u;
+    bool store_if_incompressible = false;
+
+    // Set by whichever thread deflates the entry, under lock_.
+    bool done = false;
+    std::string error;
+  };
+
+  struct DirectoryRecord {
+    std::string path;
+    uint16_t method;
+    uint32_t crc32;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint32_t offset;
+  };
+
+  static void PutUint16(uint16_t value, std::string* out) {
+    out->push_back(static_cast<char>(value & 0xffu));
+    out->push_back(static_cast<char>(value >> 8u));
+  }
+
+  static void PutUint32(uint32_t value, std::string* out) {
+    PutUint16(static_cast<uint16_t>(value & 0xffffu), out);
+    PutUint16(static_cast<uint16_t>(value >> 16u), out);
+  }
+
+  // Computes the CRC-32 of the entry, and deflates it if it was added with kCompress.
+  static void Deflate(Entry* entry) {
+    const std::string& input = entry->data;
+    if (input.size() > std::numeric_limits<uint32_t>::max()) {
+      entry->error = "entry " + entry->path + " is too large";
+      return;
+    }
+
+    entry->uncompressed_size = input.size();
+    entry->crc32 = ::crc32(0u, reinterpret_cast<const Bytef*>(input.data()),
+                           static_cast<uInt>(input.size()));
+    if ((entry->flags & ArchiveEntry::kCompress) == 0) {
+      return;
+    }
+
+    // Negative window bits for raw deflate data, at the same level ZipWriter uses.
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      entry->error = "failed to initialize deflate";
+      return;
+    }
+
+    std::string output(deflateBound(&stream, static_cast<uLong>(input.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+      entry->error = "failed to deflate " + entry->path;
+      return;
+    }
+
+    if (entry->store_if_incompressible &&
+        output.size() + (output.size() / 10) > entry->uncompressed_size) {
+      // The file was not compressed enough, store it uncompressed.
+      return;
+    }
+    entry->data.swap(output);
+    entry->method = kDeflated;
+  }
+
+  void DeflateEntries() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+      work_available_.wait(lock, [this]() { return stopping_ || !todo_.empty(); });
+      if (todo_.empty()) {
+        return;
+      }
+
+      Entry* entry = todo_.front();
+      todo_.pop_front();
+      lock.unlock();
+      Deflate(entry);
+      lock.lock();
+      entry->done = true;
+      entry_done_.notify_all();
+    }
+  }
+
+  bool AddEntry(std::unique_ptr<Entry> entry) {
+    Entry* added = entry.get();
+    pending_.push_back(std::move(entry));
+    if (!added->done) {
+      if (workers_.empty()) {
+        Deflate(added);
+        added->done = true;
+      } else {
+        {
+          std::lock_guard<std::mutex> lock(lock_);
+          todo_.push_back(added);
+        }
+        work_available_.notify_one();
+      }
+    }
+    return WritePendingEntries(options_.jobs * kPendingEntriesPerJob);
+  }
+
+  // Writes out entries in the order they were added, until at most max_pending are left waiting on
+  // the workers.
+  bool WritePendingEntries(size_t max_pending) {
+    while (!pending_.empty()) {
+      Entry* entry = pending_.front().get();
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        if (!entry->done) {
+          if (pending_.size() <= max_pending) {
+            return true;
+          }
+          entry_done_.wait(lock, [entry]() { return entry->done; });
+        }
+      }
+
+      bool result = WriteEntry(*entry);
+      pending_.pop_front();
+      if (!result) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool WriteBytes(const std::string& bytes) {
+    if (fwrite(bytes.data(), 1, bytes.size(), file_.get()) != bytes.size()) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    offset_ += bytes.size();
+    return true;
+  }
+
+  bool WriteEntry(const Entry& entry) {
+    if (!entry.error.empty()) {
+      error_ = entry.error;
+      return false;
+    }
+
+    // Entries in the central directory and their offsets are limited to 16 and 32 bits without
+    // ZIP64, which ZipWriter does not write either.
+    if (records_.size() >= std::numeric_limits<uint16_t>::max() ||
+        entry.path.size() > std::numeric_limits<uint16_t>::max() ||
+        offset_ + kLocalFileHeaderSize + entry.path.size() + entry.data.size() >
+            std::numeric_limits<uint32_t>::max()) {
+      error_ = "archive is too large";
+      return false;
+    }
+
+    // Align the data of the entry with padding in the extra field, as ZipWriter::kAlign32 does.
+    size_t padding = 0u;
+    if (entry.flags & ArchiveEntry::kAlign) {
+      padding = (4u - (offset_ + kLocalFileHeaderSize + entry.path.size()) % 4u) % 4u;
+    }
+
+    DirectoryRecord record;
+    record.path = entry.path;
+    record.method = entry.method;
+    record.crc32 = entry.crc32;
+    record.compressed_size = static_cast<uint32_t>(entry.data.size());
+    record.uncompressed_size = static_cast<uint32_t>(entry.uncompressed_size);
+    record.offset = static_cast<uint32_t>(offset_);
+
+    std::string header;
+    PutUint32(kLocalFileHeaderSignature, &header);
+    PutUint16(kVersion, &header);
+    PutUint16(0u, &header);  // General purpose flags.
+    PutUint16(record.method, &header);
+    PutUint16(0u, &header);  // Modification time.
+    PutUint16(kDosDate, &header);
+    PutUint32(record.crc32, &header);
+    PutUint32(record.compressed_size, &header);
+    PutUint32(record.uncompressed_size, &header);
+    PutUint16(static_cast<uint16_t>(entry.path.size()), &header);
+    PutUint16(static_cast<uint16_t>(padding), &header);
+    header += entry.path;
+    header.append(padding, '\0');
+    if (!WriteBytes(header) || !WriteBytes(entry.data)) {
+      return false;
+    }
+    records_.push_back(std::move(record));
+    return true;
+  }
+
+  bool Finish() {
+    TRACE_CALL();
+    if (!WritePendingEntries(0u)) {
+      return false;
+    }
+
+    const uint64_t directory_offset = offset_;
+    std::string directory;
+    for (const DirectoryRecord& record : records_) {
+      PutUint32(kCentralDirectorySignature, &directory);
+      PutUint16(kVersion, &directory);  // Version made by.
+      PutUint16(kVersion, &directory);  // Version needed to extract.
+      PutUint16(0u, &directory);
+      PutUint16(record.method, &directory);
+      PutUint16(0u, &directory);
+      PutUint16(kDosDate, &directory);
+      PutUint32(record.crc32, &directory);
+      PutUint32(record.compressed_size, &directory);
+      PutUint32(record.uncompressed_size, &directory);
+      PutUint16(static_cast<uint16_t>(record.path.size()), &directory);
+      PutUint16(0u, &directory);  // Extra field length.
+      PutUint16(0u, &directory);  // Comment length.
+      PutUint16(0u, &directory);  // Disk number.
+      PutUint16(0u, &directory);  // Internal attributes.
+      PutUint32(0u, &directory);  // External attributes.
+      PutUint32(record.offset, &directory);
+      directory += record.path;
+    }
+
+    const size_t directory_size = directory.size();
+    if (directory_offset + directory_size > std::numeric_limits<uint32_t>::max()) {
+      error_ = "archive is too large";
+      return false;
+    }
+
+    PutUint32(kEndOfCentralDirectorySignature, &directory);
+    PutUint16(0u, &directory);  // Disk number.
+    PutUint16(0u, &directory);  // Disk with the central directory.
+    PutUint16(static_cast<uint16_t>(records_.size()), &directory);
+    PutUint16(static_cast<uint16_t>(records_.size()), &directory);
+    PutUint32(static_cast<uint32_t>(directory_size), &directory);
+    PutUint32(static_cast<uint32_t>(directory_offset), &directory);
+    PutUint16(0u, &directory);  // Comment length.
+    if (!WriteBytes(directory)) {
+      return false;
+    }
+
+    if (fflush(file_.get()) != 0) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return true;
+  }
+
+  IDiagnostics* diag_;
+  ZipFileArchiveWriterOptions options_;
+  std::string path_;
+  std::unique_ptr<FILE, decltype(fclose)*> file_ = {nullptr, fclose};
+  std::string error_;
+  uint64_t offset_ = 0u;
+  std::vector<DirectoryRecord> records_;
+  std::unique_ptr<Entry> current_entry_;
+
+  // Entries that have been added but not written yet, in order. Only used by the calling thread.
+  std::deque<std::unique_ptr<Entry>> pending_;
+
+  std::vector<std::thread> workers_;
+  std::mutex lock_;
+  std::condition_variable work_available_;
+  std::condition_variable entry_done_;
+  std::deque<Entry*> todo_;
+  bool stopping_ = false;
+};
+
 }  // namespace
 
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
@@ -276,4 +695,19 @@ std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(IDiagnostics* diag,
   return std::move(writer);
 }
 
+std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(
+    IDiagnostics* diag, const StringPiece& path, const ZipFileArchiveWriterOptions& options) {
+  if (options.jobs <= 1 && !options.reuse_compressed_entries) {
+    return CreateZipFileArchiveWriter(diag, path);
+  }
+
+  std::unique_ptr<StreamingZipFileWriter> writer =
+      util::make_unique<StreamingZipFileWriter>(diag, options);
+  if (!writer->Open(path)) {
+    diag->Error(DiagMessage(path) << writer->GetError());
+    return {};
+  }
+  return std::move(writer);
+}
+
 }  // namespace aapt
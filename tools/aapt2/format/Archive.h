@@ -62,6 +62,20 @@ class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
   // valid between calls to StartEntry and FinishEntry.
   virtual bool Write(const void* buffer, int size) = 0;
 
+  // Returns whether WriteCompressedFile() is supported, so that entries already deflated in
+  // another archive can be copied without inflating and deflating them again.
+  virtual bool CanWriteCompressedFile() const {
+    return false;
+  }
+
+  // Writes an entry from raw deflated data, along with the CRC-32 and size of the inflated data.
+  // Only valid if CanWriteCompressedFile() returns true.
+  virtual bool WriteCompressedFile(const android::StringPiece& path, const void* data,
+                                   size_t compressed_size, uint32_t crc32,
+                                   size_t uncompressed_size) {
+    return false;
+  }
+
   // Returns true if there was an error writing to the archive.
   // The resulting error message can be retrieved from GetError().
   virtual bool HadError() const = 0;
@@ -76,6 +90,21 @@ std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
 std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(IDiagnostics* diag,
                                                            const android::StringPiece& path);
 
+struct ZipFileArchiveWriterOptions {
+  // Number of threads that deflate entries. Entries are still written in the order they are
+  // added, but the writer may hold on to a few of them before writing them out.
+  size_t jobs = 1;
+
+  // Whether entries that were deflated in an input archive are copied as they are, rather than
+  // inflated and deflated again. This is faster, but the entries keep the compression level of
+  // the input.
+  bool reuse_compressed_entries = false;
+};
+
+std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(
+    IDiagnostics* diag, const android::StringPiece& path,
+    const ZipFileArchiveWriterOptions& options);
+
 }  // namespace aapt
 
 #endif /* AAPT_FORMAT_ARCHIVE_H */
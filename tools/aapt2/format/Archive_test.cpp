@@ -57,6 +57,15 @@ std::unique_ptr<IArchiveWriter> MakeZipFileWriter(const std::string& output_path
   return CreateZipFileArchiveWriter(&diag, output_path);
 }
 
+std::unique_ptr<IArchiveWriter> MakeZipFileWriter(const std::string& output_path,
+                                                  const ZipFileArchiveWriterOptions& options) {
+  file::mkdirs(file::GetStem(output_path).to_string());
+  std::remove(output_path.c_str());
+
+  StdErrDiagnostics diag;
+  return CreateZipFileArchiveWriter(&diag, output_path, options);
+}
+
 void VerifyDirectory(const std::string& path, const std::string& file, const uint8_t array[]) {
   std::string file_path = file::BuildPath({path, file});
   auto buffer = std::make_unique<char[]>(kTestDataLength);
@@ -206,4 +215,70 @@ TEST_F(ArchiveTest, ZipFileWriteFileError) {
   ASSERT_EQ("ZipFileWriteFileError", writer->GetError());
 }
 
+TEST_F(ArchiveTest, ZipFileJobsWriteFileSuccess) {
+  std::string output_path = GetTestPath("output.apk");
+  ZipFileArchiveWriterOptions options;
+  options.jobs = 4;
+  std::unique_ptr<IArchiveWriter> writer = MakeZipFileWriter(output_path, options);
+
+  std::vector<std::unique_ptr<uint8_t[]>> arrays;
+  for (int i = 0; i < 32; i++) {
+    arrays.push_back(MakeTestArray());
+    auto copy = std::make_unique<uint8_t[]>(kTestDataLength);
+    std::copy(arrays.back().get(), arrays.back().get() + kTestDataLength, copy.get());
+    TestData input(copy, kTestDataLength);
+
+    uint32_t flags = (i % 2 == 0) ? ArchiveEntry::kCompress : ArchiveEntry::kAlign;
+    ASSERT_TRUE(writer->WriteFile("test" + std::to_string(i), flags, &input));
+  }
+  ASSERT_FALSE(writer->HadError());
+  writer.reset();
+
+  for (int i = 0; i < 32; i++) {
+    VerifyZipFile(output_path, "test" + std::to_string(i), arrays[i].get());
+  }
+}
+
+TEST_F(ArchiveTest, ZipFileReuseCompressedEntries) {
+  std::string input_path = GetTestPath("input.apk");
+  std::string output_path = GetTestPath("output.apk");
+
+  // Repeat the same bytes so that the entry is worth compressing.
+  auto data = std::make_unique<uint8_t[]>(kTestDataLength);
+  std::fill(data.get(), data.get() + kTestDataLength, 0x42);
+  auto data_copy = std::make_unique<uint8_t[]>(kTestDataLength);
+  std::copy(data.get(), data.get() + kTestDataLength, data_copy.get());
+  TestData input(data_copy, kTestDataLength);
+
+  std::unique_ptr<IArchiveWriter> input_writer = MakeZipFileWriter(input_path);
+  ASSERT_TRUE(input_writer->WriteFile("test", ArchiveEntry::kCompress, &input));
+  input_writer.reset();
+
+  std::unique_ptr<io::ZipFileCollection> input_zip =
+      io::ZipFileCollection::Create(input_path, nullptr);
+  ASSERT_NE(nullptr, input_zip);
+  io::IFile* file = input_zip->FindFile("test");
+  ASSERT_NE(nullptr, file);
+  ASSERT_TRUE(file->WasCompressed());
+
+  uint32_t crc32 = 0u;
+  size_t uncompressed_size = 0u;
+  std::unique_ptr<io::IData> compressed = file->OpenCompressedAsData(&crc32, &uncompressed_size);
+  ASSERT_NE(nullptr, compressed);
+  ASSERT_EQ(kTestDataLength, uncompressed_size);
+
+  ZipFileArchiveWriterOptions options;
+  options.reuse_compressed_entries = true;
+  std::unique_ptr<IArchiveWriter> writer = MakeZipFileWriter(output_path, options);
+  ASSERT_TRUE(writer->CanWriteCompressedFile());
+  ASSERT_TRUE(writer->WriteCompressedFile("test", compressed->data(), compressed->size(), crc32,
+                                          uncompressed_size));
+  ASSERT_FALSE(writer->HadError());
+  writer.reset();
+
+  VerifyZipFile(output_path, "test", data.get());
+  std::unique_ptr<io::ZipFileCollection> zip = io::ZipFileCollection::Create(output_path, nullptr);
+  ASSERT_TRUE(zip->FindFile("test")->WasCompressed());
+}
+
 }  // namespace aapt
@@ -93,6 +93,7 @@ BinaryResourceParser::BinaryResourceParser(IDiagnostics* diag, ResourceTable* ta
 }
 
 bool BinaryResourceParser::Parse() {
+  Arena::Scope arena_scope(&table_->arena);
   ResChunkPullParser parser(data_, data_len_);
 
   if (!ResChunkPullParser::IsGoodEvent(parser.Next())) {
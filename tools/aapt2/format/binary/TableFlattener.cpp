@@ -17,8 +17,10 @@
 #include "format/binary/TableFlattener.h"
 
 #include <algorithm>
+#include <atomic>
 #include <numeric>
 #include <sstream>
+#include <thread>
 #include <type_traits>
 
 #include "android-base/logging.h"
@@ -230,6 +232,15 @@ class MapFlattenVisitor : public ValueVisitor {
   size_t entry_count_ = 0;
 };
 
+// A ResTable_type chunk to flatten, holding the values of a type for one configuration.
+struct ConfigChunk {
+  const ResourceTableType* type;
+  const ConfigDescription* config;
+  size_t num_total_entries;
+  std::vector<FlatEntry>* entries;
+  BigBuffer buffer{512};
+};
+
 struct OverlayableChunk {
   std::string actor;
   Source source;
@@ -241,14 +252,15 @@ class PackageFlattener {
   PackageFlattener(IAaptContext* context, ResourceTablePackage* package,
                    const std::map<size_t, std::string>* shared_libs, bool use_sparse_entries,
                    bool collapse_key_stringpool,
-                   const std::set<ResourceName>& name_collapse_exemptions)
+                   const std::set<ResourceName>& name_collapse_exemptions, size_t jobs)
       : context_(context),
         diag_(context->GetDiagnostics()),
         package_(package),
         shared_libs_(shared_libs),
         use_sparse_entries_(use_sparse_entries),
         collapse_key_stringpool_(collapse_key_stringpool),
-        name_collapse_exemptions_(name_collapse_exemptions) {
+        name_collapse_exemptions_(name_collapse_exemptions),
+        jobs_(jobs) {
   }
 
   bool FlattenPackage(BigBuffer* buffer) {
@@ -341,9 +353,12 @@ class PackageFlattener {
     return true;
   }
 
+  // Flattens the values of a type for one configuration. This only reads the table and the
+  // context, other than sorting the styles being flattened, so the configurations can be flattened
+  // on several threads at once. On failure, out_failed_entry is set to the entry that failed.
   bool FlattenConfig(const ResourceTableType* type, const ConfigDescription& config,
                      const size_t num_total_entries, std::vector<FlatEntry>* entries,
-                     BigBuffer* buffer) {
+                     BigBuffer* buffer, const FlatEntry** out_failed_entry) {
     CHECK(num_total_entries != 0);
     CHECK(num_total_entries <= std::numeric_limits<uint16_t>::max());
 
@@ -361,10 +376,7 @@ class PackageFlattener {
       CHECK(static_cast<size_t>(flat_entry.entry->id.value()) < num_total_entries);
       offsets[flat_entry.entry->id.value()] = values_buffer.size();
       if (!FlattenValue(&flat_entry, &values_buffer)) {
-        diag_->Error(DiagMessage()
-                     << "failed to flatten resource '"
-                     << ResourceNameRef(package_->name, type->type, flat_entry.entry->name)
-                     << "' for configuration '" << config << "'");
+        *out_failed_entry = &flat_entry;
         return false;
       }
     }
@@ -605,8 +617,18 @@ class PackageFlattener {
     // this order.
     std::vector<ResourceTableType*> sorted_types = CollectAndSortTypes();
 
+    // The type and key strings are added, and the type specs are written, in order. The values of
+    // each configuration are then flattened into buffers of their own, which are appended after
+    // the spec of their type.
+    std::vector<BigBuffer> type_spec_buffers;
+    std::vector<size_t> type_config_chunk_ends;
+    std::vector<std::map<ConfigDescription, std::vector<FlatEntry>>> type_config_entries(
+        sorted_types.size());
+    std::vector<ConfigChunk> config_chunks;
+
     size_t expected_type_id = 1;
-    for (ResourceTableType* type : sorted_types) {
+    for (size_t type_index = 0; type_index < sorted_types.size(); type_index++) {
+      ResourceTableType* type = sorted_types[type_index];
       // If there is a gap in the type IDs, fill in the StringPool
       // with empty values until we reach the ID we expect.
       while (type->id.value() > expected_type_id) {
@@ -623,7 +645,8 @@ class PackageFlattener {
         continue;
       }
 
-      if (!FlattenTypeSpec(type, &sorted_entries, buffer)) {
+      type_spec_buffers.emplace_back(256);
+      if (!FlattenTypeSpec(type, &sorted_entries, &type_spec_buffers.back())) {
         return false;
       }
 
@@ -636,7 +659,8 @@ class PackageFlattener {
       // each
       // configuration available. Here we reverse this to match the binary
       // table.
-      std::map<ConfigDescription, std::vector<FlatEntry>> config_to_entry_list_map;
+      std::map<ConfigDescription, std::vector<FlatEntry>>& config_to_entry_list_map =
+          type_config_entries[type_index];
 
       // hardcoded string uses characters which make it an invalid resource name
       const std::string obfuscated_resource_name = "0_resource_name_obfuscated";
@@ -658,12 +682,59 @@ class PackageFlattener {
         }
       }
 
-      // Flatten a configuration value.
       for (auto& entry : config_to_entry_list_map) {
-        if (!FlattenConfig(type, entry.first, num_entries, &entry.second, buffer)) {
-          return false;
+        config_chunks.emplace_back();
+        ConfigChunk& chunk = config_chunks.back();
+        chunk.type = type;
+        chunk.config = &entry.first;
+        chunk.num_total_entries = num_entries;
+        chunk.entries = &entry.second;
+      }
+      type_config_chunk_ends.push_back(config_chunks.size());
+    }
+
+    // Flatten the configuration values.
+    std::vector<const FlatEntry*> failed_entries(config_chunks.size(), nullptr);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&]() {
+      for (size_t i = next++; i < config_chunks.size() && !failed; i = next++) {
+        ConfigChunk& chunk = config_chunks[i];
+        if (!FlattenConfig(chunk.type, *chunk.config, chunk.num_total_entries, chunk.entries,
+                           &chunk.buffer, &failed_entries[i])) {
+          failed = true;
         }
       }
+    };
+
+    const size_t thread_count = std::min(jobs_, config_chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    for (size_t i = 0; i < config_chunks.size(); i++) {
+      if (failed_entries[i] != nullptr) {
+        const ConfigChunk& chunk = config_chunks[i];
+        diag_->Error(DiagMessage()
+                     << "failed to flatten resource '"
+                     << ResourceNameRef(package_->name, chunk.type->type,
+                                        failed_entries[i]->entry->name)
+                     << "' for configuration '" << *chunk.config << "'");
+        return false;
+      }
+    }
+
+    size_t chunk_index = 0;
+    for (size_t i = 0; i < type_spec_buffers.size(); i++) {
+      buffer->AppendBuffer(std::move(type_spec_buffers[i]));
+      for (; chunk_index < type_config_chunk_ends[i]; chunk_index++) {
+        buffer->AppendBuffer(std::move(config_chunks[chunk_index].buffer));
+      }
     }
     return true;
   }
@@ -705,6 +776,7 @@ class PackageFlattener {
   StringPool key_pool_;
   bool collapse_key_stringpool_;
   const std::set<ResourceName>& name_collapse_exemptions_;
+  size_t jobs_;
 };
 
 }  // namespace
@@ -752,7 +824,7 @@ bool TableFlattener::Consume(IAaptContext* context, ResourceTable* table) {
 
     PackageFlattener flattener(context, package.get(), &table->included_packages_,
                                options_.use_sparse_entries, options_.collapse_key_stringpool,
-                               options_.name_collapse_exemptions);
+                               options_.name_collapse_exemptions, options_.jobs);
     if (!flattener.FlattenPackage(&package_buffer)) {
       return false;
     }
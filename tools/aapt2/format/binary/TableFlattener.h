@@ -47,6 +47,9 @@ struct TableFlattenerOptions {
 
   // Map from original resource paths to shortened resource paths.
   std::map<std::string, std::string> shortened_path_map;
+
+  // The number of threads on which the values of each configuration of each type are flattened.
+  size_t jobs = 1;
 };
 
 class TableFlattener : public IResourceTableConsumer {
@@ -201,6 +201,36 @@ TEST_F(TableFlattenerTest, FlattenFullyLinkedTable) {
                      Res_value::TYPE_STRING, (uint32_t)idx, 0u));
 }
 
+TEST_F(TableFlattenerTest, FlattenConcurrentlyMatchesSerialOutput) {
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.test", 0x7f)
+          .AddSimple("com.app.test:id/one", ResourceId(0x7f020000))
+          .AddSimple("com.app.test:id/two", ResourceId(0x7f020001))
+          .AddValue("com.app.test:integer/one", ResourceId(0x7f030000),
+                    util::make_unique<BinaryPrimitive>(uint8_t(Res_value::TYPE_INT_DEC), 1u))
+          .AddValue("com.app.test:integer/one", test::ParseConfigOrDie("v1"),
+                    ResourceId(0x7f030000),
+                    util::make_unique<BinaryPrimitive>(uint8_t(Res_value::TYPE_INT_DEC), 2u))
+          .AddValue("com.app.test:integer/one", test::ParseConfigOrDie("land"),
+                    ResourceId(0x7f030000),
+                    util::make_unique<BinaryPrimitive>(uint8_t(Res_value::TYPE_INT_DEC), 3u))
+          .AddString("com.app.test:string/test", ResourceId(0x7f050000), "foo")
+          .AddString("com.app.test:string/test", ResourceId(0x7f050000),
+                     test::ParseConfigOrDie("fr"), "bar")
+          .Build();
+
+  std::string serial_contents;
+  ASSERT_TRUE(Flatten(context_.get(), {}, table.get(), &serial_contents));
+
+  TableFlattenerOptions options;
+  options.jobs = 4;
+  std::string concurrent_contents;
+  ASSERT_TRUE(Flatten(context_.get(), options, table.get(), &concurrent_contents));
+
+  EXPECT_EQ(serial_contents, concurrent_contents);
+}
+
 TEST_F(TableFlattenerTest, FlattenEntriesWithGapsInIds) {
   std::unique_ptr<ResourceTable> table =
       test::ResourceTableBuilder()
@@ -541,6 +541,7 @@ bool DeserializeTableFromPb(const pb::ResourceTable& pb_table, io::IFileCollecti
   // causes errors when qualifying it with android::
   using namespace android;
 
+  Arena::Scope arena_scope(&out_table->arena);
   ResStringPool source_pool;
   if (pb_table.has_source_pool()) {
     status_t result = source_pool.setTo(pb_table.source_pool().data().data(),
@@ -58,6 +58,14 @@ class IFile {
     return false;
   }
 
+  // Returns the raw deflated bytes of the file if it was compressed, and sets the CRC-32 and
+  // size of the inflated data. Returns nullptr if the file was not deflated or can't be read
+  // without inflating it.
+  virtual std::unique_ptr<IData> OpenCompressedAsData(uint32_t* out_crc32,
+                                                      size_t* out_uncompressed_size) {
+    return {};
+  }
+
  private:
   // Any segments created from this IFile need to be owned by this IFile, so
   // keep them
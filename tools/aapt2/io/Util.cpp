@@ -54,6 +54,26 @@ bool CopyFileToArchive(IAaptContext* context, io::IFile* file, const std::string
 
 bool CopyFileToArchivePreserveCompression(IAaptContext* context, io::IFile* file,
                                           const std::string& out_path, IArchiveWriter* writer) {
+  if (file->WasCompressed() && writer->CanWriteCompressedFile()) {
+    uint32_t crc32 = 0u;
+    size_t uncompressed_size = 0u;
+    std::unique_ptr<io::IData> data = file->OpenCompressedAsData(&crc32, &uncompressed_size);
+    if (data) {
+      if (context->IsVerbose()) {
+        context->GetDiagnostics()->Note(DiagMessage() << "copying compressed " << out_path
+                                                      << " to archive");
+      }
+
+      if (!writer->WriteCompressedFile(out_path, data->data(), data->size(), crc32,
+                                       uncompressed_size)) {
+        context->GetDiagnostics()->Error(DiagMessage() << "failed to write " << out_path
+                                                       << " to archive: " << writer->GetError());
+        return false;
+      }
+      return true;
+    }
+  }
+
   uint32_t compression_flags = file->WasCompressed() ? ArchiveEntry::kCompress : 0u;
   return CopyFileToArchive(context, file, out_path, compression_flags, writer);
 }
@@ -76,6 +76,26 @@ bool ZipFile::WasCompressed() {
   return zip_entry_.method != kCompressStored;
 }
 
+std::unique_ptr<IData> ZipFile::OpenCompressedAsData(uint32_t* out_crc32,
+                                                     size_t* out_uncompressed_size) {
+  if (zip_entry_.method != kCompressDeflated || zip_entry_.compressed_length == 0) {
+    return {};
+  }
+
+  int fd = GetFileDescriptor(zip_handle_);
+
+  android::FileMap file_map;
+  bool result = file_map.create(nullptr, fd, zip_entry_.offset,
+                                zip_entry_.compressed_length, true);
+  if (!result) {
+    return {};
+  }
+
+  *out_crc32 = zip_entry_.crc32;
+  *out_uncompressed_size = zip_entry_.uncompressed_length;
+  return util::make_unique<MmappedData>(std::move(file_map));
+}
+
 ZipFileCollectionIterator::ZipFileCollectionIterator(
     ZipFileCollection* collection)
     : current_(collection->files_.begin()), end_(collection->files_.end()) {}
@@ -38,6 +38,8 @@ class ZipFile : public IFile {
   std::unique_ptr<io::InputStream> OpenInputStream() override;
   const Source& GetSource() const override;
   bool WasCompressed() override;
+  std::unique_ptr<IData> OpenCompressedAsData(uint32_t* out_crc32,
+                                              size_t* out_uncompressed_size) override;
 
  private:
   ::ZipArchiveHandle zip_handle_;
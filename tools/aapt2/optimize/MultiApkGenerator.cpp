@@ -17,8 +17,11 @@
 #include "MultiApkGenerator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <regex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "androidfw/ConfigDescription.h"
 #include "androidfw/StringPiece.h"
@@ -131,13 +134,8 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
   std::unordered_set<std::string> filtered_artifacts;
   std::unordered_set<std::string> kept_artifacts;
 
-  // For now, just write out the stripped APK since ABI splitting doesn't modify anything else.
+  std::vector<const OutputArtifact*> artifacts;
   for (const OutputArtifact& artifact : options.apk_artifacts) {
-    FilterChain filters;
-
-    ContextWrapper wrapped_context{context_};
-    wrapped_context.SetSource(artifact.name);
-
     if (!options.kept_artifacts.empty()) {
       const auto& it = artifacts_to_keep.find(artifact.name);
       if (it == artifacts_to_keep.end()) {
@@ -151,41 +149,63 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
         kept_artifacts.insert(artifact.name);
       }
     }
+    artifacts.push_back(&artifact);
+  }
 
-    std::unique_ptr<ResourceTable> table =
-        FilterTable(context_, artifact, *apk_->GetResourceTable(), &filters);
-    if (!table) {
-      return false;
-    }
-
-    IDiagnostics* diag = wrapped_context.GetDiagnostics();
-
-    std::unique_ptr<XmlResource> manifest;
-    if (!UpdateManifest(artifact, &manifest, diag)) {
-      diag->Error(DiagMessage() << "could not update AndroidManifest.xml for output artifact");
-      return false;
-    }
+  if (!artifacts.empty() && !file::mkdirs(options.out_dir)) {
+    GetDiagnostics()->Warn(DiagMessage() << "could not create out dir: " << options.out_dir);
+  }
 
-    std::string out = options.out_dir;
-    if (!file::mkdirs(out)) {
-      diag->Warn(DiagMessage() << "could not create out dir: " << out);
+  const size_t thread_count = std::min(options.jobs, artifacts.size());
+  if (thread_count <= 1) {
+    for (const OutputArtifact* artifact : artifacts) {
+      if (!GenerateArtifact(context_, *artifact, options)) {
+        return false;
+      }
     }
-    file::AppendPath(&out, artifact.name);
+  } else {
+    // The threads writing the artifacts share the threads flattening their tables and
+    // compressing their entries.
+    MultiApkGeneratorOptions artifact_options = options;
+    artifact_options.archive_writer_options.jobs =
+        std::max<size_t>(1, options.archive_writer_options.jobs / thread_count);
+    artifact_options.table_flattener_options.jobs =
+        std::max<size_t>(1, options.table_flattener_options.jobs / thread_count);
+
+    std::vector<std::unique_ptr<BufferedDiagnostics>> diagnostics(artifacts.size());
+    std::vector<char> generated(artifacts.size(), false);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&]() {
+      for (size_t i = next++; i < artifacts.size() && !failed; i = next++) {
+        diagnostics[i] = util::make_unique<BufferedDiagnostics>();
+        TaskContext task_context(context_, diagnostics[i].get());
+        generated[i] = GenerateArtifact(&task_context, *artifacts[i], artifact_options);
+        if (!generated[i]) {
+          failed = true;
+        }
+      }
+    };
 
-    if (context_->IsVerbose()) {
-      diag->Note(DiagMessage() << "Generating split: " << out);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; i++) {
+      threads.emplace_back(worker);
     }
-
-    std::unique_ptr<IArchiveWriter> writer = CreateZipFileArchiveWriter(diag, out);
-
-    if (context_->IsVerbose()) {
-      diag->Note(DiagMessage() << "Writing output: " << out);
+    worker();
+    for (std::thread& thread : threads) {
+      thread.join();
     }
 
-    filters.AddFilter(util::make_unique<SignatureFilter>());
-    if (!apk_->WriteToArchive(&wrapped_context, table.get(), options.table_flattener_options,
-                              &filters, writer.get(), manifest.get())) {
-      return false;
+    // Log what each artifact logged in artifact order, up to the first that failed. Artifacts
+    // that were not started after a failure have nothing to log.
+    for (size_t i = 0; i < artifacts.size(); i++) {
+      if (diagnostics[i] == nullptr) {
+        continue;
+      }
+      diagnostics[i]->Replay(GetDiagnostics());
+      if (!generated[i]) {
+        return false;
+      }
     }
   }
 
@@ -216,6 +236,46 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
   return true;
 }
 
+bool MultiApkGenerator::GenerateArtifact(IAaptContext* context, const OutputArtifact& artifact,
+                                         const MultiApkGeneratorOptions& options) {
+  FilterChain filters;
+
+  ContextWrapper wrapped_context{context};
+  wrapped_context.SetSource(artifact.name);
+
+  std::unique_ptr<ResourceTable> table =
+      FilterTable(context, artifact, *apk_->GetResourceTable(), &filters);
+  if (!table) {
+    return false;
+  }
+
+  IDiagnostics* diag = wrapped_context.GetDiagnostics();
+
+  std::unique_ptr<XmlResource> manifest;
+  if (!UpdateManifest(artifact, &manifest, diag)) {
+    diag->Error(DiagMessage() << "could not update AndroidManifest.xml for output artifact");
+    return false;
+  }
+
+  std::string out = options.out_dir;
+  file::AppendPath(&out, artifact.name);
+
+  if (context->IsVerbose()) {
+    diag->Note(DiagMessage() << "Generating split: " << out);
+  }
+
+  std::unique_ptr<IArchiveWriter> writer =
+      CreateZipFileArchiveWriter(diag, out, options.archive_writer_options);
+
+  if (context->IsVerbose()) {
+    diag->Note(DiagMessage() << "Writing output: " << out);
+  }
+
+  filters.AddFilter(util::make_unique<SignatureFilter>());
+  return apk_->WriteToArchive(&wrapped_context, table.get(), options.table_flattener_options,
+                              &filters, writer.get(), manifest.get());
+}
+
 std::unique_ptr<ResourceTable> MultiApkGenerator::FilterTable(IAaptContext* context,
                                                               const OutputArtifact& artifact,
                                                               const ResourceTable& old_table,
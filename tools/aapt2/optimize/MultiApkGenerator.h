@@ -27,6 +27,7 @@
 #include "Diagnostics.h"
 #include "LoadedApk.h"
 #include "configuration/ConfigurationParser.h"
+#include "format/Archive.h"
 
 namespace aapt {
 
@@ -35,6 +36,10 @@ struct MultiApkGeneratorOptions {
   std::vector<configuration::OutputArtifact> apk_artifacts;
   TableFlattenerOptions table_flattener_options;
   std::unordered_set<std::string> kept_artifacts;
+  ZipFileArchiveWriterOptions archive_writer_options;
+
+  // Number of artifacts generated concurrently.
+  size_t jobs = 1;
 };
 
 /**
@@ -47,7 +52,8 @@ class MultiApkGenerator {
 
   /**
    * Writes a set of APKs to the provided output directory. Each APK is a subset fo the base APK and
-   * represents an artifact in the post processing configuration.
+   * represents an artifact in the post processing configuration. With more than one job, artifacts
+   * are filtered and written concurrently, and their diagnostics are logged in artifact order.
    */
   bool FromBaseApk(const MultiApkGeneratorOptions& options);
 
@@ -65,6 +71,13 @@ class MultiApkGenerator {
   bool UpdateManifest(const configuration::OutputArtifact& artifact,
                       std::unique_ptr<xml::XmlResource>* updated_manifest, IDiagnostics* diag);
 
+  /**
+   * Filters the base APK for the artifact and writes it to the output directory. Only reads the
+   * base APK, so that artifacts can be generated on several threads at once.
+   */
+  bool GenerateArtifact(IAaptContext* context, const configuration::OutputArtifact& artifact,
+                        const MultiApkGeneratorOptions& options);
+
   /**
    * Adds the <screen> elements to the parent node for the provided density configuration.
    */
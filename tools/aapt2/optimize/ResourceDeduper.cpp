@@ -17,9 +17,14 @@
 #include "optimize/ResourceDeduper.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unordered_map>
 
 #include "DominatorTree.h"
 #include "ResourceTable.h"
+#include "ValueVisitor.h"
 #include "trace/TraceBuffer.h"
 
 using android::ConfigDescription;
@@ -28,6 +33,102 @@ namespace aapt {
 
 namespace {
 
+// Hashes the parts of a value that Value::Equals compares, so that values which are equal always
+// hash the same. Values with different hashes can then be told apart without comparing them.
+class ValueHasher : public ConstValueVisitor {
+ public:
+  using ConstValueVisitor::Visit;
+
+  void Visit(const Reference* ref) override {
+    Combine(1);
+    Combine(static_cast<size_t>(ref->reference_type));
+    Combine(ref->id ? ref->id.value().id : 0u);
+    if (ref->name) {
+      Combine(std::hash<std::string>()(ref->name.value().entry));
+    }
+  }
+
+  void Visit(const RawString* str) override {
+    Combine(2);
+    Combine(std::hash<std::string>()(*str->value));
+  }
+
+  void Visit(const String* str) override {
+    Combine(3);
+    Combine(std::hash<std::string>()(*str->value));
+  }
+
+  void Visit(const StyledString* str) override {
+    Combine(4);
+    Combine(std::hash<std::string>()(str->value->value));
+  }
+
+  void Visit(const FileReference* file) override {
+    Combine(5);
+    Combine(std::hash<std::string>()(*file->path));
+  }
+
+  void Visit(const Id* /*id*/) override {
+    Combine(6);
+  }
+
+  void Visit(const BinaryPrimitive* primitive) override {
+    Combine(7);
+    Combine(primitive->value.dataType);
+    Combine(primitive->value.data);
+  }
+
+  void Visit(const Attribute* attr) override {
+    Combine(8);
+    Combine(attr->type_mask);
+    Combine(attr->symbols.size());
+  }
+
+  void Visit(const Style* style) override {
+    Combine(9);
+    Combine(style->entries.size());
+    if (style->parent) {
+      Visit(&style->parent.value());
+    }
+  }
+
+  void Visit(const Array* array) override {
+    Combine(10);
+    for (const auto& element : array->elements) {
+      element->Accept(this);
+    }
+  }
+
+  void Visit(const Plural* plural) override {
+    Combine(11);
+    for (const auto& value : plural->values) {
+      if (value) {
+        value->Accept(this);
+      } else {
+        Combine(0);
+      }
+    }
+  }
+
+  void Visit(const Styleable* styleable) override {
+    Combine(12);
+    for (const Reference& entry : styleable->entries) {
+      Visit(&entry);
+    }
+  }
+
+  size_t hash() const {
+    return hash_;
+  }
+
+ private:
+  void Combine(size_t value) {
+    hash_ = hash_ * 31 + value;
+  }
+
+  size_t hash_ = 17;
+};
+
 /**
  * Remove duplicated key-value entries from dominated resources.
  *
@@ -56,7 +157,7 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
     if (!node_value || !parent_value) {
       return;
     }
-    if (!node_value->value->Equals(parent_value->value.get())) {
+    if (!ValuesEqual(node_value->value.get(), parent_value->value.get())) {
       return;
     }
 
@@ -70,7 +171,7 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
         continue;
       }
       if (node_configuration.IsCompatibleWith(sibling_value->config) &&
-          !node_value->value->Equals(sibling_value->value.get())) {
+          !ValuesEqual(node_value->value.get(), sibling_value->value.get())) {
         // The configurations are compatible, but the value is
         // different, so we can't remove this value.
         return;
@@ -90,8 +191,26 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
  private:
   DISALLOW_COPY_AND_ASSIGN(DominatedKeyValueRemover);
 
+  // Compares the hashes of the values before comparing the values themselves. The hash of each
+  // value is computed once, since a value is compared with each of its siblings.
+  bool ValuesEqual(const Value* a, const Value* b) {
+    return Hash(a) == Hash(b) && a->Equals(b);
+  }
+
+  size_t Hash(const Value* value) {
+    auto iter = hashes_.find(value);
+    if (iter != hashes_.end()) {
+      return iter->second;
+    }
+    ValueHasher hasher;
+    value->Accept(&hasher);
+    hashes_.emplace(value, hasher.hash());
+    return hasher.hash();
+  }
+
   IAaptContext* context_;
   ResourceEntry* entry_;
+  std::unordered_map<const Value*, size_t> hashes_;
 };
 
 static void DedupeEntry(IAaptContext* context, ResourceEntry* entry) {
@@ -113,13 +232,33 @@ static void DedupeEntry(IAaptContext* context, ResourceEntry* entry) {
 
 bool ResourceDeduper::Consume(IAaptContext* context, ResourceTable* table) {
   TRACE_CALL();
+  std::vector<ResourceEntry*> entries;
   for (auto& package : table->packages) {
     for (auto& type : package->types) {
       for (auto& entry : type->entries) {
-        DedupeEntry(context, entry.get());
+        entries.push_back(entry.get());
       }
     }
   }
+
+  // Entries are deduped independently of each other. Removals are only noted in verbose mode, and
+  // are then deduped in order so that the notes are too.
+  const size_t thread_count = context->IsVerbose() ? 1 : std::min(jobs_, entries.size());
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < entries.size(); i = next++) {
+      DedupeEntry(context, entries[i]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
   return true;
 }
 
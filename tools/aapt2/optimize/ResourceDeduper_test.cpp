@@ -63,6 +63,35 @@ TEST(ResourceDeduperTest, SameValuesAreDeduped) {
   EXPECT_THAT(table, Not(HasValue("android:string/dedupe3", en_v21_config)));
 }
 
+TEST(ResourceDeduperTest, SameValuesAreDedupedConcurrently) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  const ConfigDescription default_config = {};
+  const ConfigDescription ldrtl_config = test::ParseConfigOrDie("ldrtl");
+  const ConfigDescription land_config = test::ParseConfigOrDie("land");
+
+  test::ResourceTableBuilder builder;
+  for (int i = 0; i < 16; i++) {
+    const std::string name = "android:string/dedupe" + std::to_string(i);
+    builder.AddString(name, ResourceId{}, default_config, "dedupe")
+        .AddString(name, ResourceId{}, ldrtl_config, "dedupe")
+        .AddString(name, ResourceId{}, land_config, i % 2 == 0 ? "dedupe" : "keep");
+  }
+  std::unique_ptr<ResourceTable> table = builder.Build();
+
+  ASSERT_TRUE(ResourceDeduper(4).Consume(context.get(), table.get()));
+  for (int i = 0; i < 16; i++) {
+    const std::string name = "android:string/dedupe" + std::to_string(i);
+    EXPECT_THAT(table, HasValue(name, default_config));
+    if (i % 2 == 0) {
+      EXPECT_THAT(table, Not(HasValue(name, ldrtl_config)));
+      EXPECT_THAT(table, Not(HasValue(name, land_config)));
+    } else {
+      EXPECT_THAT(table, HasValue(name, ldrtl_config));
+      EXPECT_THAT(table, HasValue(name, land_config));
+    }
+  }
+}
+
 TEST(ResourceDeduperTest, DifferentValuesAreKept) {
   std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
   const ConfigDescription default_config = {};
@@ -16,7 +16,12 @@
 
 #include "process/SymbolTable.h"
 
+#include <sys/stat.h>
+
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <unordered_set>
 
 #include "android-base/logging.h"
 #include "android-base/stringprintf.h"
@@ -55,6 +60,14 @@ void SymbolTable::SetDelegate(std::unique_ptr<ISymbolTableDelegate> delegate) {
   cache_.clear();
 }
 
+void SymbolTable::SetShared(bool shared) {
+  std::lock_guard<std::mutex> lock(lock_);
+  shared_ = shared;
+  if (!shared) {
+    retained_.clear();
+  }
+}
+
 void SymbolTable::AppendSource(std::unique_ptr<ISymbolSource> source) {
   sources_.push_back(std::move(source));
 
@@ -82,8 +95,13 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
     name_with_package = &name_with_package_impl.value();
   }
 
+  std::lock_guard<std::mutex> lock(lock_);
+
   // We store the name unmangled in the cache, so look it up as-is.
   if (const std::shared_ptr<Symbol>& s = cache_.get(*name_with_package)) {
+    if (shared_) {
+      retained_.insert(s);
+    }
     return s.get();
   }
 
@@ -114,13 +132,21 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
     id_cache_.put(shared_symbol->id.value(), shared_symbol);
   }
 
+  if (shared_) {
+    retained_.insert(shared_symbol);
+  }
+
   // Returns the raw pointer. Callers are not expected to hold on to this
   // between calls to Find*.
   return shared_symbol.get();
 }
 
 const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
+  std::lock_guard<std::mutex> lock(lock_);
   if (const std::shared_ptr<Symbol>& s = id_cache_.get(id)) {
+    if (shared_) {
+      retained_.insert(s);
+    }
     return s.get();
   }
 
@@ -134,6 +160,9 @@ const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
   // doesn't support unique_ptr.
   std::shared_ptr<Symbol> shared_symbol(std::move(symbol));
   id_cache_.put(id, shared_symbol);
+  if (shared_) {
+    retained_.insert(shared_symbol);
+  }
 
   // Returns the raw pointer. Callers are not expected to hold on to this
   // between calls to Find*.
@@ -217,13 +246,63 @@ std::unique_ptr<SymbolTable::Symbol> ResourceTableSymbolSource::FindByName(
   return symbol;
 }
 
+namespace {
+
+struct CachedApkAssets {
+  // Tells whether the file changed since it was loaded.
+  off_t size;
+  time_t mtime;
+  std::shared_ptr<const ApkAssets> apk;
+};
+
+std::mutex sApkAssetsCacheLock;
+bool sCacheApkAssets = false;
+std::map<std::string, CachedApkAssets> sApkAssetsCache;
+
+}  // namespace
+
+void AssetManagerSymbolSource::SetCacheApkAssets(bool cache) {
+  std::lock_guard<std::mutex> lock(sApkAssetsCacheLock);
+  sCacheApkAssets = cache;
+  if (!cache) {
+    sApkAssetsCache.clear();
+  }
+}
+
+static std::shared_ptr<const ApkAssets> LoadApkAssets(const std::string& path) {
+  std::lock_guard<std::mutex> lock(sApkAssetsCacheLock);
+  struct stat st;
+  if (!sCacheApkAssets || stat(path.c_str(), &st) != 0) {
+    return ApkAssets::Load(path);
+  }
+
+  auto iter = sApkAssetsCache.find(path);
+  if (iter != sApkAssetsCache.end()) {
+    if (iter->second.size == st.st_size && iter->second.mtime == st.st_mtime) {
+      return iter->second.apk;
+    }
+    sApkAssetsCache.erase(iter);
+  }
+
+  std::shared_ptr<const ApkAssets> apk = ApkAssets::Load(path);
+  if (apk != nullptr) {
+    sApkAssetsCache[path] = CachedApkAssets{st.st_size, st.st_mtime, apk};
+  }
+  return apk;
+}
+
 bool AssetManagerSymbolSource::AddAssetPath(const StringPiece& path) {
   TRACE_CALL();
-  if (std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(path.data())) {
+  if (std::shared_ptr<const ApkAssets> apk = LoadApkAssets(path.to_string())) {
     apk_assets_.push_back(std::move(apk));
 
+    // The index is rebuilt with the new APK on the next lookup.
+    std::lock_guard<std::mutex> lock(index_lock_);
+    index_.store(nullptr, std::memory_order_release);
+    index_storage_.reset();
+
     std::vector<const ApkAssets*> apk_assets;
-    for (const std::unique_ptr<const ApkAssets>& apk_asset : apk_assets_) {
+    for (const std::shared_ptr<const ApkAssets>& apk_asset : apk_assets_) {
       apk_assets.push_back(apk_asset.get());
     }
 
@@ -251,7 +330,7 @@ bool AssetManagerSymbolSource::IsPackageDynamic(uint32_t packageId,
     return true;
   }
 
-  for (const std::unique_ptr<const ApkAssets>& assets : apk_assets_) {
+  for (const std::shared_ptr<const ApkAssets>& assets : apk_assets_) {
     for (const std::unique_ptr<const android::LoadedPackage>& loaded_package
          : assets->GetLoadedArsc()->GetPackages()) {
       if (package_name == loaded_package->GetPackageName() && loaded_package->IsDynamic()) {
@@ -322,60 +401,144 @@ static std::unique_ptr<SymbolTable::Symbol> LookupAttributeInTable(
   return s;
 }
 
-std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByName(
-    const ResourceName& name) {
-  const std::string mangled_entry = NameMangler::MangleEntry(name.package, name.entry);
+static Maybe<ResourceName> GetResourceName(android::AssetManager2& am,
+                                           ResourceId id) {
+  android::AssetManager2::ResourceName name;
+  if (!am.GetResourceName(id.id, &name)) {
+    return {};
+  }
+  return ResourceUtils::ToResourceName(name);
+}
 
-  bool found = false;
-  ResourceId res_id = 0;
-  uint32_t type_spec_flags;
-  ResourceName real_name;
+const AssetManagerSymbolSource::Index& AssetManagerSymbolSource::GetIndex() {
+  if (const Index* index = index_.load(std::memory_order_acquire)) {
+    return *index;
+  }
 
-  // There can be mangled resources embedded within other packages. Here we will
-  // look into each package and look-up the mangled name until we find the resource.
-  asset_manager_.ForEachPackage([&](const std::string& package_name, uint8_t id) -> bool {
-    real_name = ResourceName(name.package, name.type, name.entry);
-    if (package_name != name.package) {
-      real_name.entry = mangled_entry;
-      real_name.package = package_name;
-    }
+  std::lock_guard<std::mutex> lock(index_lock_);
+  if (index_storage_ == nullptr) {
+    index_storage_ = BuildIndex();
+    index_.store(index_storage_.get(), std::memory_order_release);
+  }
+  return *index_storage_;
+}
 
-    res_id = asset_manager_.GetResourceId(real_name.to_string());
-    if (res_id.is_valid_static() && asset_manager_.GetResourceFlags(res_id.id, &type_spec_flags)) {
-      found = true;
-      return false;
-    }
+std::unique_ptr<const AssetManagerSymbolSource::Index> AssetManagerSymbolSource::BuildIndex() {
+  TRACE_CALL();
+  std::unique_ptr<Index> index = util::make_unique<Index>();
 
+  std::map<std::string, uint8_t> assigned_package_ids;
+  asset_manager_.ForEachPackage([&](const std::string& package_name, uint8_t id) -> bool {
+    index->package_names.push_back(package_name);
+    assigned_package_ids.insert(std::make_pair(package_name, id));
     return true;
   });
 
-  if (!found) {
-    return {};
+  // Walk the resources of the packages in the order they were added, so that the resource the
+  // AssetManager would pick comes first when several packages define the same name.
+  std::unordered_set<uint32_t> seen_ids;
+  for (const std::shared_ptr<const ApkAssets>& assets : apk_assets_) {
+    for (const std::unique_ptr<const android::LoadedPackage>& loaded_package
+         : assets->GetLoadedArsc()->GetPackages()) {
+      auto package_id = assigned_package_ids.find(loaded_package->GetPackageName());
+      if (package_id == assigned_package_ids.end()) {
+        continue;
+      }
+
+      const bool is_dynamic = IsPackageDynamic(package_id->second,
+                                               loaded_package->GetPackageName());
+      for (uint32_t resid : *loaded_package) {
+        const ResourceId id((resid & 0x00ffffffu) | (uint32_t(package_id->second) << 24));
+        if (!id.is_valid_static() || !seen_ids.insert(id.id).second) {
+          continue;
+        }
+
+        IndexEntry entry;
+        Maybe<ResourceName> name = GetResourceName(asset_manager_, id);
+        if (!name || !asset_manager_.GetResourceFlags(id.id, &entry.type_spec_flags)) {
+          continue;
+        }
+
+        entry.name = std::move(name.value());
+        entry.id = id;
+        entry.is_dynamic = is_dynamic;
+        if (entry.name.type == ResourceType::kAttr
+            || entry.name.type == ResourceType::kAttrPrivate) {
+          entry.attribute_symbol = LookupAttributeInTable(asset_manager_, id);
+        }
+        index->entries.push_back(std::move(entry));
+      }
+    }
   }
 
+  const std::vector<IndexEntry>& entries = index->entries;
+  for (size_t i = 0; i < entries.size(); i++) {
+    index->by_name.push_back(i);
+    index->by_id.push_back(i);
+  }
+  std::stable_sort(index->by_name.begin(), index->by_name.end(), [&](size_t a, size_t b) {
+    return entries[a].name < entries[b].name;
+  });
+  std::sort(index->by_id.begin(), index->by_id.end(), [&](size_t a, size_t b) {
+    return entries[a].id < entries[b].id;
+  });
+  return index;
+}
+
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::MakeSymbol(
+    const IndexEntry& entry, bool is_attribute) {
   std::unique_ptr<SymbolTable::Symbol> s;
-  if (real_name.type == ResourceType::kAttr) {
-    s = LookupAttributeInTable(asset_manager_, res_id);
+  if (is_attribute) {
+    if (entry.attribute_symbol == nullptr) {
+      return {};
+    }
+    s = util::make_unique<SymbolTable::Symbol>(*entry.attribute_symbol);
   } else {
     s = util::make_unique<SymbolTable::Symbol>();
-    s->id = res_id;
-    s->is_dynamic = IsPackageDynamic(ResourceId(res_id).package_id(), real_name.package);
+    s->id = entry.id;
+    s->is_dynamic = entry.is_dynamic;
   }
-
-  if (s) {
-    s->is_public = (type_spec_flags & android::ResTable_typeSpec::SPEC_PUBLIC) != 0;
-    return s;
-  }
-  return {};
+  s->is_public = (entry.type_spec_flags & android::ResTable_typeSpec::SPEC_PUBLIC) != 0;
+  return s;
 }
 
-static Maybe<ResourceName> GetResourceName(android::AssetManager2& am,
-                                           ResourceId id) {
-  android::AssetManager2::ResourceName name;
-  if (!am.GetResourceName(id.id, &name)) {
-    return {};
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByName(
+    const ResourceName& name) {
+  const Index& index = GetIndex();
+  auto find_entry = [&](const ResourceName& real_name) -> const IndexEntry* {
+    auto iter = std::lower_bound(index.by_name.begin(), index.by_name.end(), real_name,
+                                 [&](size_t i, const ResourceName& n) {
+                                   return index.entries[i].name < n;
+                                 });
+    if (iter == index.by_name.end() || index.entries[*iter].name != real_name) {
+      return nullptr;
+    }
+    return &index.entries[*iter];
+  };
+
+  const std::string mangled_entry = NameMangler::MangleEntry(name.package, name.entry);
+
+  // There can be mangled resources embedded within other packages. Here we will
+  // look into each package and look-up the mangled name until we find the resource.
+  for (const std::string& package_name : index.package_names) {
+    ResourceName real_name(name.package, name.type, name.entry);
+    if (package_name != name.package) {
+      real_name.entry = mangled_entry;
+      real_name.package = package_name;
+    }
+
+    const IndexEntry* entry = find_entry(real_name);
+    if (entry == nullptr && real_name.type == ResourceType::kAttr) {
+      // Private attributes of libraries are sometimes encoded under '^attr-private'.
+      real_name.type = ResourceType::kAttrPrivate;
+      entry = find_entry(real_name);
+    }
+
+    if (entry != nullptr) {
+      return MakeSymbol(*entry, name.type == ResourceType::kAttr);
+    }
   }
-  return ResourceUtils::ToResourceName(name);
+  return {};
 }
 
 std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindById(
@@ -385,36 +548,17 @@ std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindById(
     return {};
   }
 
-  if (apk_assets_.empty()) {
+  const Index& index = GetIndex();
+  auto iter = std::lower_bound(index.by_id.begin(), index.by_id.end(), id,
+                               [&](size_t i, ResourceId other) {
+                                 return index.entries[i].id < other;
+                               });
+  if (iter == index.by_id.end() || index.entries[*iter].id != id) {
     return {};
   }
 
-  Maybe<ResourceName> maybe_name = GetResourceName(asset_manager_, id);
-  if (!maybe_name) {
-    return {};
-  }
-
-
-  uint32_t type_spec_flags = 0;
-  if (!asset_manager_.GetResourceFlags(id.id, &type_spec_flags)) {
-    return {};
-  }
-
-  ResourceName& name = maybe_name.value();
-  std::unique_ptr<SymbolTable::Symbol> s;
-  if (name.type == ResourceType::kAttr) {
-    s = LookupAttributeInTable(asset_manager_, id);
-  } else {
-    s = util::make_unique<SymbolTable::Symbol>();
-    s->id = id;
-    s->is_dynamic = IsPackageDynamic(ResourceId(id).package_id(), name.package);
-  }
-
-  if (s) {
-    s->is_public = (type_spec_flags & android::ResTable_typeSpec::SPEC_PUBLIC) != 0;
-    return s;
-  }
-  return {};
+  const IndexEntry& entry = index.entries[*iter];
+  return MakeSymbol(entry, entry.name.type == ResourceType::kAttr);
 }
 
 std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByReference(
@@ -18,7 +18,10 @@
 #define AAPT_PROCESS_SYMBOLTABLE_H
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_set>
 #include <vector>
 
 #include "android-base/macros.h"
@@ -86,7 +89,11 @@ class SymbolTable {
   // cause the existing cache to be cleared.
   void PrependSource(std::unique_ptr<ISymbolSource> source);
 
-  // NOTE: Never hold on to the result between calls to FindByXXX. The
+  // While shared, lookups may be made from several threads at once, and their results stay valid
+  // until sharing ends, rather than until the next lookup. Sources must not be added meanwhile.
+  void SetShared(bool shared);
+
+  // NOTE: Never hold on to the result between calls to FindByXXX, unless the table is shared. The
   // results are stored in a cache which may evict entries on subsequent calls.
   const Symbol* FindByName(const ResourceName& name);
 
@@ -110,6 +117,13 @@ class SymbolTable {
   android::LruCache<ResourceName, std::shared_ptr<Symbol>> cache_;
   android::LruCache<ResourceId, std::shared_ptr<Symbol>> id_cache_;
 
+  // Serializes lookups, since neither the caches nor the sources are thread-safe.
+  std::mutex lock_;
+  bool shared_ = false;
+
+  // Every symbol returned while shared, so that none is freed on eviction while still in use.
+  std::unordered_set<std::shared_ptr<Symbol>> retained_;
+
   DISALLOW_COPY_AND_ASSIGN(SymbolTable);
 };
 
@@ -192,6 +206,11 @@ class AssetManagerSymbolSource : public ISymbolSource {
  public:
   AssetManagerSymbolSource() = default;
 
+  // Makes the sources in this process share the APKs they load, and keep them loaded for as long
+  // as the files on disk are unchanged. Meant for long-running processes, like the daemon, that
+  // link against the same framework and libraries over and over.
+  static void SetCacheApkAssets(bool cache);
+
   bool AddAssetPath(const android::StringPiece& path);
   std::map<size_t, std::string> GetAssignedPackageIds() const;
   bool IsPackageDynamic(uint32_t packageId, const std::string& package_name) const;
@@ -207,8 +226,40 @@ class AssetManagerSymbolSource : public ISymbolSource {
   }
 
  private:
+  struct IndexEntry {
+    ResourceName name;
+    ResourceId id;
+    uint32_t type_spec_flags = 0;
+    bool is_dynamic = false;
+
+    // The symbol of an attribute, resolved from its bag. Null if the bag could not be resolved.
+    std::unique_ptr<SymbolTable::Symbol> attribute_symbol;
+  };
+
+  // The resources of the APKs added with AddAssetPath(), sorted for binary search. The index is
+  // built on the first lookup and never changes afterwards, so lookups only read it and may run
+  // concurrently without taking a lock.
+  struct Index {
+    // The names of the packages, in the order in which the AssetManager searches them.
+    std::vector<std::string> package_names;
+    std::vector<IndexEntry> entries;
+
+    // Indices into `entries`, sorted by name (and by load order for equal names), and by ID.
+    std::vector<size_t> by_name;
+    std::vector<size_t> by_id;
+  };
+
+  const Index& GetIndex();
+  std::unique_ptr<const Index> BuildIndex();
+  static std::unique_ptr<SymbolTable::Symbol> MakeSymbol(const IndexEntry& entry,
+                                                         bool is_attribute);
+
   android::AssetManager2 asset_manager_;
-  std::vector<std::unique_ptr<const android::ApkAssets>> apk_assets_;
+  std::vector<std::shared_ptr<const android::ApkAssets>> apk_assets_;
+
+  std::mutex index_lock_;
+  std::atomic<const Index*> index_{nullptr};
+  std::unique_ptr<const Index> index_storage_;
 
   DISALLOW_COPY_AND_ASSIGN(AssetManagerSymbolSource);
 };
@@ -16,6 +16,9 @@
 
 #include "process/SymbolTable.h"
 
+#include <atomic>
+#include <thread>
+
 #include "SdkConstants.h"
 #include "format/binary/TableFlattener.h"
 #include "test/Test.h"
@@ -134,4 +137,103 @@ TEST_F(SymbolTableTestFixture, FindByNameWhenSymbolIsMangledInResTable) {
   EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("com.android.other:id/foo")), IsNull());
 }
 
+TEST_F(SymbolTableTestFixture, CachedApkAssetsAreShared) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+      R"(<?xml version="1.0" encoding="utf-8"?>
+         <resources>
+             <item type="id" name="foo"/>
+        </resources>)",
+        compiled_files_dir, &diag));
+
+  const std::string out_apk = GetTestPath("out.apk");
+  std::vector<std::string> link_args = {
+      "--manifest", GetDefaultManifest("com.android.app"),
+      "-o", out_apk,
+  };
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  AssetManagerSymbolSource uncached_source;
+  AssetManagerSymbolSource other_uncached_source;
+  ASSERT_TRUE(uncached_source.AddAssetPath(out_apk));
+  ASSERT_TRUE(other_uncached_source.AddAssetPath(out_apk));
+  EXPECT_THAT(uncached_source.GetAssetManager()->GetApkAssets()[0],
+              Ne(other_uncached_source.GetAssetManager()->GetApkAssets()[0]));
+
+  AssetManagerSymbolSource::SetCacheApkAssets(true);
+  AssetManagerSymbolSource cached_source;
+  AssetManagerSymbolSource other_cached_source;
+  ASSERT_TRUE(cached_source.AddAssetPath(out_apk));
+  ASSERT_TRUE(other_cached_source.AddAssetPath(out_apk));
+  EXPECT_THAT(cached_source.GetAssetManager()->GetApkAssets()[0],
+              Eq(other_cached_source.GetAssetManager()->GetApkAssets()[0]));
+  AssetManagerSymbolSource::SetCacheApkAssets(false);
+
+  EXPECT_THAT(cached_source.FindByName(test::ParseNameOrDie("com.android.app:id/foo")),
+              NotNull());
+}
+
+TEST_F(SymbolTableTestFixture, FindSymbolsConcurrentlyInAssetManager) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+      R"(<?xml version="1.0" encoding="utf-8"?>
+         <resources>
+             <item type="id" name="foo"/>
+             <attr name="bar">
+                 <enum name="one" value="1"/>
+                 <enum name="two" value="2"/>
+             </attr>
+        </resources>)",
+        compiled_files_dir, &diag));
+
+  const std::string out_apk = GetTestPath("out.apk");
+  std::vector<std::string> link_args = {
+      "--manifest", GetDefaultManifest("com.android.app"),
+      "-o", out_apk,
+  };
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  AssetManagerSymbolSource source;
+  ASSERT_TRUE(source.AddAssetPath(out_apk));
+
+  std::unique_ptr<SymbolTable::Symbol> attr =
+      source.FindByName(test::ParseNameOrDie("com.android.app:attr/bar"));
+  ASSERT_THAT(attr, NotNull());
+  ASSERT_TRUE(attr->id);
+  ASSERT_THAT(attr->attribute, NotNull());
+  EXPECT_THAT(attr->attribute->symbols.size(), Eq(2u));
+
+  std::unique_ptr<SymbolTable::Symbol> id =
+      source.FindByName(test::ParseNameOrDie("com.android.app:id/foo"));
+  ASSERT_THAT(id, NotNull());
+  ASSERT_TRUE(id->id);
+  EXPECT_THAT(id->attribute, IsNull());
+
+  std::vector<std::thread> threads;
+  std::atomic<size_t> failures{0};
+  for (size_t i = 0; i < 4; i++) {
+    threads.emplace_back([&]() {
+      for (size_t j = 0; j < 100; j++) {
+        std::unique_ptr<SymbolTable::Symbol> s = source.FindById(attr->id.value());
+        if (s == nullptr || s->attribute == nullptr || s->attribute->symbols.size() != 2u) {
+          failures++;
+        }
+        s = source.FindById(id->id.value());
+        if (s == nullptr || s->id != id->id) {
+          failures++;
+        }
+        if (source.FindByName(test::ParseNameOrDie("com.android.app:id/missing")) != nullptr) {
+          failures++;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(failures.load(), Eq(0u));
+}
+
 }  // namespace aapt
@@ -16,13 +16,22 @@
 
 #include "TraceBuffer.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
 #include <inttypes.h>
 
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
 #include "android-base/utf8.h"
 
 #include "util/Files.h"
@@ -37,27 +46,58 @@ constexpr char kEnd = 'E';
 
 struct TracePoint {
   pid_t tid;
+  // Tells apart the begin and end events of threads compiling concurrently.
+  size_t thread;
   int64_t time;
   std::string tag;
   char type;
+  // The size of the input processed, or -1 if the event is not about an input.
+  int64_t bytes;
+  // The peak memory use of the process so far, or -1 if not profiling.
+  int64_t peak_rss_kb;
 };
 
+std::mutex traces_lock;
 std::vector<TracePoint> traces;
 
+// The number of profiles being collected.
+std::atomic<int> profiling(0);
+std::atomic<int> profile_count(0);
+
 int64_t GetTime() noexcept {
   auto now = std::chrono::steady_clock::now();
   return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
 }
 
+int64_t GetPeakRssKb() noexcept {
+#ifdef _WIN32
+  return -1;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return -1;
+  }
+#ifdef __APPLE__
+  // Reported in bytes rather than kilobytes.
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
 } // namespace anonymous
 
-void AddWithTime(const std::string& tag, char type, int64_t time) noexcept {
-  TracePoint t = {getpid(), time, tag, type};
+void AddWithTime(const std::string& tag, char type, int64_t time, int64_t bytes = -1) noexcept {
+  const int64_t peak_rss_kb = profiling > 0 ? GetPeakRssKb() : -1;
+  TracePoint t = {getpid(), std::hash<std::thread::id>()(std::this_thread::get_id()), time, tag,
+                  type, bytes, peak_rss_kb};
+  std::lock_guard<std::mutex> lock(traces_lock);
   traces.emplace_back(t);
 }
 
-void Add(const std::string& tag, char type) noexcept {
-  AddWithTime(tag, type, GetTime());
+void Add(const std::string& tag, char type, int64_t bytes = -1) noexcept {
+  AddWithTime(tag, type, GetTime(), bytes);
 }
 
 
@@ -76,16 +116,177 @@ void Flush(const std::string& basePath) {
     return;
   }
 
+  std::lock_guard<std::mutex> lock(traces_lock);
   for(const TracePoint& trace : traces) {
-    fprintf(f, "{\"ts\" : \"%" PRIu64 "\", \"ph\" : \"%c\", \"tid\" : \"%d\" , \"pid\" : \"%d\", "
-            "\"name\" : \"%s\" },\n", trace.time, trace.type, 0, trace.tid, trace.tag.c_str());
+    fprintf(f, "{\"ts\" : \"%" PRIu64 "\", \"ph\" : \"%c\", \"tid\" : \"%zu\" , \"pid\" : \"%d\", "
+            "\"name\" : \"%s\" },\n", trace.time, trace.type, trace.thread, trace.tid,
+            trace.tag.c_str());
   }
   fclose(f);
   traces.clear();
 }
 
+namespace {
+
+std::string EscapeJson(const std::string& str) {
+  std::string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      escaped += buf;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+struct PhaseStats {
+  std::string name;
+  int64_t count = 0;
+  int64_t total_us = 0;
+  int64_t max_us = 0;
+  int64_t peak_rss_kb = -1;
+};
+
+struct InputStats {
+  std::string name;
+  int64_t duration_us;
+  int64_t bytes;
+  int64_t peak_rss_kb;
+};
+
+void WriteChromeTrace(const std::string& path, const std::vector<TracePoint>& events) {
+  FILE* f = android::base::utf8::fopen(path.c_str(), "w");
+  if (f == nullptr) {
+    return;
+  }
+
+  // Thread hashes are too large for the trace viewer, so number the threads instead.
+  std::map<size_t, size_t> thread_ids;
+  fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (size_t i = 0; i < events.size(); i++) {
+    const TracePoint& event = events[i];
+    const size_t thread_id = thread_ids.emplace(event.thread, thread_ids.size() + 1).first->second;
+    fprintf(f, "  {\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %" PRId64 ", \"pid\": %d, "
+            "\"tid\": %zu, \"args\": {", EscapeJson(event.tag).c_str(), event.type, event.time,
+            event.tid, thread_id);
+    const char* separator = "";
+    if (event.bytes >= 0) {
+      fprintf(f, "\"bytes\": %" PRId64, event.bytes);
+      separator = ", ";
+    }
+    if (event.peak_rss_kb >= 0) {
+      fprintf(f, "%s\"peak_rss_kb\": %" PRId64, separator, event.peak_rss_kb);
+    }
+    fprintf(f, "}}%s\n", i + 1 < events.size() ? "," : "");
+  }
+  fprintf(f, "]}\n");
+  fclose(f);
+}
+
+// Sums up the time spent in each traced phase and on each input. Phases are aggregated by name,
+// and include the time of the phases nested in them.
+void WriteSummary(const std::string& path, const std::string& name,
+                  const std::vector<TracePoint>& events) {
+  std::map<std::string, PhaseStats> phases_by_name;
+  std::vector<InputStats> inputs;
+  std::map<size_t, std::vector<const TracePoint*>> open_events;
+  int64_t peak_rss_kb = -1;
+  for (const TracePoint& event : events) {
+    peak_rss_kb = std::max(peak_rss_kb, event.peak_rss_kb);
+    std::vector<const TracePoint*>& open = open_events[event.thread];
+    if (event.type == kBegin) {
+      open.push_back(&event);
+      continue;
+    }
+    if (open.empty()) {
+      continue;
+    }
+
+    const TracePoint* begin = open.back();
+    open.pop_back();
+    const int64_t duration_us = event.time - begin->time;
+    if (begin->bytes >= 0) {
+      inputs.push_back(InputStats{begin->tag, duration_us, begin->bytes, event.peak_rss_kb});
+      continue;
+    }
+
+    PhaseStats& phase = phases_by_name[begin->tag];
+    phase.name = begin->tag;
+    phase.count++;
+    phase.total_us += duration_us;
+    phase.max_us = std::max(phase.max_us, duration_us);
+    phase.peak_rss_kb = std::max(phase.peak_rss_kb, event.peak_rss_kb);
+  }
+
+  std::vector<PhaseStats> phases;
+  for (auto& entry : phases_by_name) {
+    phases.push_back(std::move(entry.second));
+  }
+  std::sort(phases.begin(), phases.end(), [](const PhaseStats& a, const PhaseStats& b) {
+    return a.total_us > b.total_us;
+  });
+  std::sort(inputs.begin(), inputs.end(), [](const InputStats& a, const InputStats& b) {
+    return a.duration_us > b.duration_us;
+  });
+
+  FILE* f = android::base::utf8::fopen(path.c_str(), "w");
+  if (f == nullptr) {
+    return;
+  }
+
+  const int64_t duration_us = events.empty() ? 0 : events.back().time - events.front().time;
+  fprintf(f, "{\n  \"command\": \"%s\",\n  \"duration_us\": %" PRId64 ",\n"
+          "  \"peak_rss_kb\": %" PRId64 ",\n  \"phases\": [\n", EscapeJson(name).c_str(),
+          duration_us, peak_rss_kb);
+  for (size_t i = 0; i < phases.size(); i++) {
+    const PhaseStats& phase = phases[i];
+    fprintf(f, "    {\"name\": \"%s\", \"count\": %" PRId64 ", \"total_us\": %" PRId64 ", "
+            "\"max_us\": %" PRId64 ", \"peak_rss_kb\": %" PRId64 "}%s\n",
+            EscapeJson(phase.name).c_str(), phase.count, phase.total_us, phase.max_us,
+            phase.peak_rss_kb, i + 1 < phases.size() ? "," : "");
+  }
+  fprintf(f, "  ],\n  \"inputs\": [\n");
+  for (size_t i = 0; i < inputs.size(); i++) {
+    const InputStats& input = inputs[i];
+    fprintf(f, "    {\"name\": \"%s\", \"duration_us\": %" PRId64 ", \"bytes\": %" PRId64 ", "
+            "\"peak_rss_kb\": %" PRId64 "}%s\n", EscapeJson(input.name).c_str(),
+            input.duration_us, input.bytes, input.peak_rss_kb, i + 1 < inputs.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+}
+
+} // namespace
+
+// Writes the events from first_event on as a Chrome trace and a summary, to files in folder named
+// after the command, the process and the number of profiles the process has written.
+void WriteProfile(const std::string& folder, const std::string& name, size_t first_event) {
+  std::vector<TracePoint> events;
+  {
+    std::lock_guard<std::mutex> lock(traces_lock);
+    events.assign(traces.begin() + std::min(first_event, traces.size()), traces.end());
+  }
+
+  std::stringstream s;
+  s << folder << aapt::file::sDirSep << "profile_aapt2_" << name << "_" << getpid() << "_"
+    << profile_count++;
+  WriteChromeTrace(s.str() + ".trace.json", events);
+  WriteSummary(s.str() + ".summary.json", name, events);
+}
+
 } // namespace tracebuffer
 
+bool IsProfiling() {
+  return tracebuffer::profiling > 0;
+}
+
 void BeginTrace(const std::string& tag) {
   tracebuffer::Add(tag, tracebuffer::kBegin);
 }
@@ -109,6 +310,10 @@ Trace::Trace(const std::string& tag, const std::vector<android::StringPiece>& ar
   tracebuffer::Add(s.str(), tracebuffer::kBegin);
 }
 
+Trace::Trace(const std::string& tag, uint64_t bytes) {
+  tracebuffer::Add(tag, tracebuffer::kBegin, static_cast<int64_t>(bytes));
+}
+
 Trace::~Trace() {
   tracebuffer::Add("", tracebuffer::kEnd);
 }
@@ -147,5 +352,26 @@ FlushTrace::~FlushTrace() {
   tracebuffer::Flush(basepath_);
 }
 
-} // namespace aapt
+ProfileTrace::ProfileTrace(const std::string& folder, const std::string& name)
+    : folder_(folder), name_(name) {
+  if (folder_.empty()) {
+    return;
+  }
+  tracebuffer::profiling++;
+  {
+    std::lock_guard<std::mutex> lock(tracebuffer::traces_lock);
+    first_event_ = tracebuffer::traces.size();
+  }
+  tracebuffer::Add(name_, tracebuffer::kBegin);
+}
 
+ProfileTrace::~ProfileTrace() {
+  if (folder_.empty()) {
+    return;
+  }
+  tracebuffer::Add("", tracebuffer::kEnd);
+  tracebuffer::WriteProfile(folder_, name_, first_event_);
+  tracebuffer::profiling--;
+}
+
+} // namespace aapt
@@ -17,6 +17,7 @@
 #ifndef AAPT_TRACEBUFFER_H
 #define AAPT_TRACEBUFFER_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -26,13 +27,15 @@ namespace aapt {
 
 // Record timestamps for beginning and end of a task and generate systrace json fragments.
 // This is an in-process ftrace which has the advantage of being platform independent.
-// These methods are NOT thread-safe since aapt2 is not multi-threaded.
+// Events are recorded under a lock, since inputs may be processed on several threads.
 
 // Convenience RIAA object to automatically finish an event when object goes out of scope.
 class Trace {
 public:
   Trace(const std::string& tag);
   Trace(const std::string& tag, const std::vector<android::StringPiece>& args);
+  // Traces the processing of an input of the given size, listed by file in profiles.
+  Trace(const std::string& tag, uint64_t bytes);
   ~Trace();
 };
 
@@ -54,11 +57,31 @@ private:
   std::string basepath_;
 };
 
+// Profiles a command. While a profile is collected, every event also records the peak memory use
+// of the process so far. When the object goes out of scope, the events traced since it was created
+// are written to the folder as a Chrome trace, along with a JSON summary of the time spent in each
+// phase and on each input. Nothing is collected when the folder is empty.
+class ProfileTrace {
+public:
+  ProfileTrace(const std::string& folder, const std::string& name);
+  ~ProfileTrace();
+private:
+  std::string folder_;
+  std::string name_;
+  size_t first_event_ = 0;
+};
+
+// Whether a profile is being collected, for measurements only worth taking then.
+bool IsProfiling();
+
 #define TRACE_CALL() Trace __t(__func__)
 #define TRACE_NAME(tag) Trace __t(tag)
 #define TRACE_NAME_ARGS(tag, args) Trace __t(tag, args)
+#define TRACE_NAME_BYTES(tag, bytes) Trace __t(tag, static_cast<uint64_t>(bytes))
 
 #define TRACE_FLUSH(basename, tag) FlushTrace __t(basename, tag)
 #define TRACE_FLUSH_ARGS(basename, tag, args) FlushTrace __t(basename, tag, args)
+
+#define TRACE_PROFILE(folder, name) ProfileTrace __p(folder, name)
 } // namespace aapt
 #endif //AAPT_TRACEBUFFER_H
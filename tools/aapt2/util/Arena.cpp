@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/Arena.h"
+
+#include <map>
+#include <mutex>
+
+#include "android-base/logging.h"
+
+namespace aapt {
+
+namespace {
+
+constexpr size_t kAlignment = alignof(std::max_align_t);
+
+thread_local Arena* sCurrentArena = nullptr;
+
+// The blocks of every live arena, keyed by their start and mapped to their end, so that deleting
+// an ArenaObject can tell whether its memory belongs to an arena without a per-object header.
+class BlockRegistry {
+ public:
+  void Add(const uint8_t* start, size_t size) {
+    std::lock_guard<std::mutex> lock(lock_);
+    blocks_[start] = start + size;
+  }
+
+  void Remove(const uint8_t* start) {
+    std::lock_guard<std::mutex> lock(lock_);
+    blocks_.erase(start);
+  }
+
+  bool Contains(const void* ptr) {
+    const uint8_t* p = static_cast<const uint8_t*>(ptr);
+    std::lock_guard<std::mutex> lock(lock_);
+    auto iter = blocks_.upper_bound(p);
+    if (iter == blocks_.begin()) {
+      return false;
+    }
+    --iter;
+    return p < iter->second;
+  }
+
+ private:
+  std::mutex lock_;
+  std::map<const uint8_t*, const uint8_t*> blocks_;
+};
+
+BlockRegistry& GetBlockRegistry() {
+  // Never destroyed, arenas may be destroyed during static destruction.
+  static BlockRegistry* registry = new BlockRegistry();
+  return *registry;
+}
+
+}  // namespace
+
+Arena::Arena(size_t block_size) : block_size_(block_size) {
+  CHECK(block_size > 0) << "arena blocks must not be empty";
+}
+
+Arena::~Arena() {
+  BlockRegistry& registry = GetBlockRegistry();
+  for (const auto& block : blocks_) {
+    registry.Remove(block.get());
+  }
+}
+
+uint8_t* Arena::AllocateBlock(size_t size) {
+  blocks_.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[size]));
+  allocated_bytes_ += size;
+  GetBlockRegistry().Add(blocks_.back().get(), size);
+  return blocks_.back().get();
+}
+
+void* Arena::Allocate(size_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  if (size > remaining_) {
+    // Large objects get a block of their own, so that they do not waste the rest of the current
+    // block.
+    if (size > block_size_ / 4) {
+      return AllocateBlock(size);
+    }
+    next_ = AllocateBlock(block_size_);
+    remaining_ = block_size_;
+  }
+
+  void* ptr = next_;
+  next_ += size;
+  remaining_ -= size;
+  return ptr;
+}
+
+Arena::Scope::Scope(Arena* arena) : previous_(sCurrentArena) {
+  sCurrentArena = arena;
+}
+
+Arena::Scope::~Scope() {
+  sCurrentArena = previous_;
+}
+
+void* ArenaObject::operator new(size_t size) {
+  if (sCurrentArena != nullptr) {
+    return sCurrentArena->Allocate(size);
+  }
+  return ::operator new(size);
+}
+
+void ArenaObject::operator delete(void* ptr) {
+  // Objects allocated from an arena are freed along with the blocks of the arena.
+  if (ptr != nullptr && !GetBlockRegistry().Contains(ptr)) {
+    ::operator delete(ptr);
+  }
+}
+
+}  // namespace aapt
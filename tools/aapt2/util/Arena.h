@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UTIL_ARENA_H
+#define AAPT_UTIL_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "android-base/macros.h"
+
+namespace aapt {
+
+// Hands out memory for ArenaObjects from large blocks, instead of allocating each object on its
+// own. Deleting an ArenaObject runs its destructor but leaves its memory alone; the blocks are
+// freed all at once when the arena is destroyed.
+//
+// Objects allocated from an arena must therefore not outlive it. Each ResourceTable owns the
+// arena of its values, and values are cloned, never moved, into another table.
+//
+// An arena must only be allocated from by one thread at a time, but the objects allocated from it
+// may be deleted on any thread.
+class Arena {
+ public:
+  static constexpr size_t kDefaultBlockSize = 32u * 1024u;
+
+  explicit Arena(size_t block_size = kDefaultBlockSize);
+  ~Arena();
+
+  // The number of bytes of blocks allocated by this arena.
+  size_t allocated_bytes() const {
+    return allocated_bytes_;
+  }
+
+  // Makes ArenaObjects created on this thread be allocated from `arena` until the scope ends.
+  // Scopes may be nested; a null arena makes objects be allocated on the heap again.
+  class Scope {
+   public:
+    explicit Scope(Arena* arena);
+    ~Scope();
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(Scope);
+
+    Arena* previous_;
+  };
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+
+  friend class ArenaObject;
+
+  void* Allocate(size_t size);
+  uint8_t* AllocateBlock(size_t size);
+
+  const size_t block_size_;
+  std::vector<std::unique_ptr<uint8_t[]>> blocks_;
+  uint8_t* next_ = nullptr;
+  size_t remaining_ = 0;
+  size_t allocated_bytes_ = 0;
+};
+
+// Base of the classes whose instances are allocated from the arena of the current Arena::Scope,
+// if there is one, and on the heap otherwise.
+class ArenaObject {
+ public:
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
+  static void* operator new(size_t, void* ptr) {
+    return ptr;
+  }
+
+  static void operator delete(void*, void*) {
+  }
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_UTIL_ARENA_H
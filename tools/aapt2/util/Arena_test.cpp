@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/Arena.h"
+
+#include "ResourceTable.h"
+#include "ResourceValues.h"
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::Gt;
+
+namespace aapt {
+
+TEST(ArenaTest, AllocatesObjectsFromTheArenaInScope) {
+  Arena arena(1024);
+  EXPECT_THAT(arena.allocated_bytes(), Eq(0u));
+
+  std::unique_ptr<Id> heap_id = util::make_unique<Id>();
+  EXPECT_THAT(arena.allocated_bytes(), Eq(0u));
+
+  std::unique_ptr<Id> first_id;
+  std::unique_ptr<Id> second_id;
+  {
+    Arena::Scope scope(&arena);
+    first_id = util::make_unique<Id>();
+    second_id = util::make_unique<Id>();
+  }
+  EXPECT_THAT(arena.allocated_bytes(), Eq(1024u));
+
+  const uint8_t* first = reinterpret_cast<const uint8_t*>(first_id.get());
+  const uint8_t* second = reinterpret_cast<const uint8_t*>(second_id.get());
+  EXPECT_THAT(second, Gt(first));
+  EXPECT_TRUE(second - first < 1024);
+
+  std::unique_ptr<Id> other_heap_id = util::make_unique<Id>();
+  EXPECT_THAT(arena.allocated_bytes(), Eq(1024u));
+}
+
+TEST(ArenaTest, NestedScopesRestoreThePreviousArena) {
+  Arena outer(1024);
+  Arena inner(1024);
+
+  std::unique_ptr<Id> inner_id;
+  std::unique_ptr<Id> heap_id;
+  std::unique_ptr<Id> outer_id;
+  {
+    Arena::Scope outer_scope(&outer);
+    {
+      Arena::Scope inner_scope(&inner);
+      inner_id = util::make_unique<Id>();
+      {
+        Arena::Scope heap_scope(nullptr);
+        heap_id = util::make_unique<Id>();
+      }
+    }
+    outer_id = util::make_unique<Id>();
+  }
+
+  EXPECT_THAT(inner.allocated_bytes(), Eq(1024u));
+  EXPECT_THAT(outer.allocated_bytes(), Eq(1024u));
+}
+
+namespace {
+
+class CountedObject : public ArenaObject {
+ public:
+  explicit CountedObject(int* destroyed) : destroyed_(destroyed) {
+  }
+
+  ~CountedObject() {
+    (*destroyed_)++;
+  }
+
+ private:
+  int* destroyed_;
+};
+
+}  // namespace
+
+TEST(ArenaTest, DeletingAnObjectOnlyRunsItsDestructor) {
+  int destroyed = 0;
+  Arena arena(1024);
+  {
+    Arena::Scope scope(&arena);
+    std::unique_ptr<CountedObject> first = util::make_unique<CountedObject>(&destroyed);
+    std::unique_ptr<CountedObject> second = util::make_unique<CountedObject>(&destroyed);
+  }
+  EXPECT_THAT(destroyed, Eq(2));
+  EXPECT_THAT(arena.allocated_bytes(), Eq(1024u));
+
+  // Heap objects are still freed on their own once the arena is gone.
+  std::unique_ptr<CountedObject> heap_object = util::make_unique<CountedObject>(&destroyed);
+  heap_object = {};
+  EXPECT_THAT(destroyed, Eq(3));
+}
+
+TEST(ArenaTest, LargeObjectsGetTheirOwnBlock) {
+  Arena arena(64);
+  std::unique_ptr<String> value;
+  StringPool pool;
+  {
+    Arena::Scope scope(&arena);
+    value = util::make_unique<String>(pool.MakeRef("hello"));
+  }
+  EXPECT_THAT(*value->value, Eq("hello"));
+  EXPECT_THAT(arena.allocated_bytes(), Gt(0u));
+  value = {};
+}
+
+TEST(ArenaTest, ClonedTableDoesNotShareTheArena) {
+  std::unique_ptr<ResourceTable> table = util::make_unique<ResourceTable>();
+  std::unique_ptr<ResourceTable> clone;
+  {
+    Arena::Scope scope(&table->arena);
+    ASSERT_TRUE(table->AddResource(test::ParseNameOrDie("com.app.a:string/foo"),
+                                   android::ConfigDescription{}, "",
+                                   util::make_unique<String>(table->string_pool.MakeRef("foo")),
+                                   test::GetDiagnostics()));
+    clone = table->Clone();
+  }
+  table = {};
+
+  String* value = test::GetValue<String>(clone.get(), "com.app.a:string/foo");
+  ASSERT_NE(value, nullptr);
+  EXPECT_THAT(*value->value, Eq("foo"));
+  EXPECT_THAT(clone->arena.allocated_bytes(), Gt(0u));
+}
+
+}  // namespace aapt
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/FileCache.h"
+
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "android-base/file.h"
+#include "android-base/stringprintf.h"
+#include "android-base/utf8.h"
+
+#include "util/Files.h"
+#include "util/Util.h"
+
+using ::android::StringPiece;
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+CacheKeyBuilder::CacheKeyBuilder() {
+  SHA256_Init(&sha_);
+  Add(util::GetToolFingerprint());
+}
+
+void CacheKeyBuilder::Hash(const void* data, size_t len) {
+  // A cached entry is used in place of the real output, so the key is a cryptographic digest
+  // that two different inputs can't be made to share.
+  SHA256_Update(&sha_, data, len);
+  size_ += len;
+}
+
+CacheKeyBuilder& CacheKeyBuilder::Add(const StringPiece& data) {
+  Add(static_cast<uint64_t>(data.size()));
+  Hash(data.data(), data.size());
+  return *this;
+}
+
+CacheKeyBuilder& CacheKeyBuilder::Add(uint64_t value) {
+  uint8_t bytes[sizeof(value)];
+  for (size_t i = 0; i < sizeof(value); i++) {
+    bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+  Hash(bytes, sizeof(bytes));
+  return *this;
+}
+
+std::string CacheKeyBuilder::Build() const {
+  SHA256_CTX sha = sha_;
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  SHA256_Final(digest, &sha);
+  std::string key;
+  for (uint8_t byte : digest) {
+    key += StringPrintf("%02x", byte);
+  }
+  return key + StringPrintf("-%" PRIu64, size_);
+}
+
+bool FileCache::Get(const std::string& key, std::string* out_data) const {
+  std::string path = dir_;
+  file::AppendPath(&path, key);
+  return android::base::ReadFileToString(path, out_data);
+}
+
+bool FileCache::Put(const std::string& key, const BigBuffer& data) const {
+  std::string path = dir_;
+  file::AppendPath(&path, key);
+
+  // Write to a file of our own and move it into place, so that readers never see a partial entry.
+  const std::string tmp_path =
+      StringPrintf("%s.%d.%zu.tmp", path.c_str(), getpid(),
+                   std::hash<std::thread::id>()(std::this_thread::get_id()));
+  if (!android::base::WriteStringToFile(data.to_string(), tmp_path)) {
+    android::base::utf8::unlink(tmp_path.c_str());
+    return false;
+  }
+
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    // Another build may have just stored the same entry.
+    android::base::utf8::unlink(tmp_path.c_str());
+    return file::GetFileType(path) == file::FileType::kRegular;
+  }
+  return true;
+}
+
+}  // namespace aapt
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UTIL_FILECACHE_H
+#define AAPT_UTIL_FILECACHE_H
+
+#include <string>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+#include "openssl/sha.h"
+
+#include "util/BigBuffer.h"
+
+namespace aapt {
+
+// Builds the key of a cache entry out of everything that the cached data depends on. Each part is
+// hashed along with its length, so parts can't run into each other. The aapt2 version is always
+// part of the key, since the output of aapt2 changes along with it.
+class CacheKeyBuilder {
+ public:
+  CacheKeyBuilder();
+
+  CacheKeyBuilder& Add(const android::StringPiece& data);
+  CacheKeyBuilder& Add(uint64_t value);
+
+  // Returns the key, usable as a file name.
+  std::string Build() const;
+
+ private:
+  void Hash(const void* data, size_t len);
+
+  SHA256_CTX sha_;
+  uint64_t size_ = 0;
+};
+
+// An on-disk cache of build outputs, stored in files named after their keys. Entries are written
+// atomically, so a cache directory can be shared by concurrent builds.
+class FileCache {
+ public:
+  explicit FileCache(const std::string& dir) : dir_(dir) {
+  }
+
+  // Reads the data stored under key into out_data. Returns false on a miss.
+  bool Get(const std::string& key, std::string* out_data) const;
+
+  // Stores data under key. Returns false if it could not be written, in which case the cache is
+  // left as it was.
+  bool Put(const std::string& key, const BigBuffer& data) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileCache);
+
+  std::string dir_;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_UTIL_FILECACHE_H
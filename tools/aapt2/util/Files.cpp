@@ -279,6 +279,23 @@ bool AppendSetArgsFromFile(const StringPiece& path, std::unordered_set<std::stri
   return true;
 }
 
+bool WriteFileIfChanged(const std::string& path, const StringPiece& contents,
+                        std::string* out_error) {
+  std::string existing_contents;
+  if (GetFileType(path) == FileType::kRegular && ReadFileToString(path, &existing_contents)
+      && contents == existing_contents) {
+    return true;
+  }
+
+  if (!android::base::WriteStringToFile(contents.to_string(), path)) {
+    if (out_error) {
+      *out_error = SystemErrorCodeToString(errno);
+    }
+    return false;
+  }
+  return true;
+}
+
 bool FileFilter::SetPattern(const StringPiece& pattern) {
   pattern_tokens_ = util::SplitAndLowercase(pattern, ':');
   return true;
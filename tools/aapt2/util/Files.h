@@ -91,6 +91,11 @@ bool AppendArgsFromFile(const android::StringPiece& path, std::vector<std::strin
 bool AppendSetArgsFromFile(const android::StringPiece& path,
                         std::unordered_set<std::string>* out_argset, std::string* out_error);
 
+// Writes contents to the file at path, unless the file already holds exactly these contents. An
+// unchanged file keeps its modification time, so build steps that depend on it are not rerun.
+bool WriteFileIfChanged(const std::string& path, const android::StringPiece& contents,
+                        std::string* out_error);
+
 // Filter that determines which resource files/directories are
 // processed by AAPT. Takes a pattern string supplied by the user.
 // Pattern format is specified in the FileFilter::SetPattern() method.
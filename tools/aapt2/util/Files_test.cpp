@@ -16,11 +16,16 @@
 
 #include "util/Files.h"
 
+#include <sys/stat.h>
+#include <utime.h>
+
 #include <sstream>
 
+#include "android-base/file.h"
 #include "android-base/stringprintf.h"
 #include "android-base/utf8.h"
 
+#include "test/Fixture.h"
 #include "test/Test.h"
 
 using ::android::base::StringPrintf;
@@ -101,5 +106,30 @@ TEST_F(FilesTest, WindowsMkdirsLongPathMissingDrive) {
 }
 #endif
 
+using WriteFileIfChangedTest = TestDirectoryFixture;
+
+TEST_F(WriteFileIfChangedTest, OnlyRewritesChangedFiles) {
+  const std::string path = GetTestPath("R.java");
+  std::string error;
+  ASSERT_TRUE(WriteFileIfChanged(path, "class R {}", &error)) << error;
+
+  // Age the file, so that a rewrite would show in its modification time.
+  struct utimbuf old_time = {1000, 1000};
+  ASSERT_EQ(utime(path.c_str(), &old_time), 0);
+
+  ASSERT_TRUE(WriteFileIfChanged(path, "class R {}", &error)) << error;
+  struct stat st;
+  ASSERT_EQ(stat(path.c_str(), &st), 0);
+  EXPECT_EQ(st.st_mtime, 1000);
+
+  ASSERT_TRUE(WriteFileIfChanged(path, "class R { int a; }", &error)) << error;
+  ASSERT_EQ(stat(path.c_str(), &st), 0);
+  EXPECT_NE(st.st_mtime, 1000);
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &contents));
+  EXPECT_EQ(contents, "class R { int a; }");
+}
+
 }  // namespace files
 }  // namespace aapt